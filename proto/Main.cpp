@@ -5,6 +5,7 @@
 #include "Module/Module.h"
 #include "Resource/Resources.h"
 #include "State/States.h"
+#include "States/TestAnimationState.h"
 #include "States/TestEntityState.h"
 #include "States/TestPaletteState.h"
 #include "States/TestUiState.h"
@@ -36,6 +37,7 @@ public:
 		auto states = std::make_shared<ff::States>();
 		//states->AddTop(std::make_shared<TestUiState>(_uiGlobals.get()));
 		//states->AddTop(std::make_shared<TestEntityState>(globals));
+		//states->AddTop(std::make_shared<TestAnimationState>(globals));
 		//states->AddTop(std::make_shared<TestPaletteState>(globals));
 		states->AddTop(std::make_shared<TitleState>(globals));
 		states->AddTop(_uiGlobals);
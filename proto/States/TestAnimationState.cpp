@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "Globals/AppGlobals.h"
+#include "Graph/Anim/Animation.h"
+#include "Graph/Anim/AnimationBatch.h"
+#include "Graph/Anim/KeyFrames.h"
+#include "Graph/Anim/Transform.h"
+#include "Graph/Font/SpriteFont.h"
+#include "Graph/GraphDevice.h"
+#include "Graph/RenderTarget/RenderDepth.h"
+#include "Graph/RenderTarget/RenderTarget.h"
+#include "Graph/Render/Renderer.h"
+#include "Graph/Render/RendererActive.h"
+#include "Graph/Sprite/Sprite.h"
+#include "States/TestAnimationState.h"
+#include "Types/Timer.h"
+#include "Value/Values.h"
+
+static const ff::RectFloat WORLD_RECT(0, 0, 1920, 1080);
+static const size_t BENCH_PLAYER_COUNT = 50000;
+static const size_t BENCH_ANIMATION_COUNT = 20;
+static const size_t BENCH_FRAME_COUNT = 120;
+
+TestAnimationState::TestAnimationState(ff::AppGlobals* globals)
+	: _render(globals->GetGraph()->CreateRenderer())
+	, _viewport(WORLD_RECT.Size())
+	, _spriteResource(L"TestSprites.Player")
+	, _fontResource(L"TestFont2")
+	, _benchFrame(0)
+	, _benchAdvanceSeconds{ 0, 0 }
+	, _benchRenderSeconds{ 0, 0 }
+	, _benchAdvanceMs{ 0, 0 }
+	, _benchRenderMs{ 0, 0 }
+{
+}
+
+std::shared_ptr<ff::State> TestAnimationState::Advance(ff::AppGlobals* globals)
+{
+	CreatePlayers();
+
+	ff::Timer timer;
+	for (ff::IAnimationPlayer* player : _players)
+	{
+		player->AdvanceAnimation();
+	}
+
+	_benchAdvanceSeconds[0] += timer.Tick();
+
+	_batch.Advance();
+	_benchAdvanceSeconds[1] += timer.Tick();
+
+	return nullptr;
+}
+
+void TestAnimationState::Render(ff::AppGlobals* globals, ff::IRenderTarget* target, ff::IRenderDepth* depth)
+{
+	noAssertRet(_players.Size());
+
+	ff::RectFloat view = _viewport.GetView(target);
+	ff::RendererActive render = _render->BeginRender(target, depth, view, WORLD_RECT);
+	noAssertRet(render);
+
+	size_t useBatch = _benchFrame++ & 1;
+	ff::Timer timer;
+
+	if (useBatch)
+	{
+		_batch.Render(render);
+	}
+	else
+	{
+		for (size_t i = 0; i < _players.Size(); i++)
+		{
+			_players[i]->RenderAnimation(render, _playerPositions[i]);
+		}
+	}
+
+	_benchRenderSeconds[useBatch] += timer.Tick();
+
+	if (_benchFrame == ::BENCH_FRAME_COUNT)
+	{
+		for (size_t i = 0; i < 2; i++)
+		{
+			_benchAdvanceMs[i] = _benchAdvanceSeconds[i] * 1000.0 / ::BENCH_FRAME_COUNT;
+			_benchRenderMs[i] = _benchRenderSeconds[i] * 1000.0 / (::BENCH_FRAME_COUNT / 2);
+			_benchAdvanceSeconds[i] = 0;
+			_benchRenderSeconds[i] = 0;
+		}
+
+		_benchFrame = 0;
+	}
+
+	ff::ISpriteFont* font = _fontResource.Flush();
+	ff::String text = ff::String::format_new(
+		L"%lu players, %lu anims: players advance %.3fms render %.3fms, batch advance %.3fms render %.3fms",
+		_players.Size(), _animations.Size(),
+		_benchAdvanceMs[0], _benchRenderMs[0],
+		_benchAdvanceMs[1], _benchRenderMs[1]);
+	font->DrawText(render, text, ff::Transform::Create(ff::PointFloat(20, 1040)), ff::GetColorBlack());
+}
+
+void TestAnimationState::CreatePlayers()
+{
+	noAssertRet(_players.IsEmpty());
+
+	ff::ISprite* sprite = _spriteResource.Flush();
+	ff::KeyFrames::MethodType loopSpline = ff::SetFlags(ff::KeyFrames::MethodType::BoundsLoop, ff::KeyFrames::MethodType::InterpolateSpline);
+
+	for (size_t i = 0; i < ::BENCH_ANIMATION_COUNT; i++)
+	{
+		float length = 30.0f + i * 3.0f;
+		float radius = 10.0f + i * 2.0f;
+
+		ff::CreateKeyFrames visualKeys(ff::String(L"visual"), 0, length);
+		visualKeys.AddFrame(0, ff::Value::New<ff::ObjectValue>(sprite));
+
+		ff::CreateKeyFrames positionKeys(ff::String(L"position"), 0, length, loopSpline);
+		positionKeys.AddFrame(0, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(radius, 0)));
+		positionKeys.AddFrame(length / 4, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0, radius)));
+		positionKeys.AddFrame(length / 2, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(-radius, 0)));
+		positionKeys.AddFrame(length * 3 / 4, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0, -radius)));
+		positionKeys.AddFrame(length, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(radius, 0)));
+
+		ff::CreateKeyFrames scaleKeys(ff::String(L"scale"), 0, length, loopSpline);
+		scaleKeys.AddFrame(0, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0.25f, 0.25f)));
+		scaleKeys.AddFrame(length / 2, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0.5f, 0.5f)));
+		scaleKeys.AddFrame(length, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0.25f, 0.25f)));
+
+		ff::CreateKeyFrames colorKeys(ff::String(L"color"), 0, length, loopSpline);
+		colorKeys.AddFrame(0, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(1, 1, 1, 1)));
+		colorKeys.AddFrame(length / 2, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(i / 20.0f, 0.5f, 1, 1)));
+		colorKeys.AddFrame(length, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(1, 1, 1, 1)));
+
+		ff::CreateAnimation create(length, ff::ADVANCES_PER_SECOND_F, loopSpline);
+		create.AddKeys(visualKeys);
+		create.AddKeys(positionKeys);
+		create.AddKeys(scaleKeys);
+		create.AddKeys(colorKeys);
+		create.AddVisual(0, length, 1, loopSpline,
+			ff::String(L"visual"), ff::String(L"color"), ff::String(L"position"), ff::String(L"scale"), ff::String());
+
+		_animations.Push(create.Create());
+	}
+
+	_players.Reserve(::BENCH_PLAYER_COUNT);
+	_playerPositions.Reserve(::BENCH_PLAYER_COUNT);
+
+	for (size_t i = 0; i < ::BENCH_PLAYER_COUNT; i++)
+	{
+		ff::IAnimation* animation = _animations[i % _animations.Size()];
+		ff::Transform position = ff::Transform::Create(ff::PointFloat((float)(std::rand() % 1920), (float)(std::rand() % 1080)));
+		float startFrame = (float)(std::rand() % 60);
+
+		_players.Push(animation->CreateAnimationPlayer(startFrame));
+		_playerPositions.Push(position);
+		_batch.Add(animation, position, startFrame);
+	}
+}
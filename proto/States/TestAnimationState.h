@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Graph/Anim/AnimationBatch.h"
+#include "Graph/RenderTarget/Viewport.h"
+#include "Resource/ResourceValue.h"
+#include "State/State.h"
+
+namespace ff
+{
+	class IAnimation;
+	class IAnimationPlayer;
+	class IRenderDepth;
+	class IRenderer;
+	class ISprite;
+	class ISpriteFont;
+}
+
+// Benchmarks many players sharing a few animations, one COM player each vs. an AnimationBatch
+class TestAnimationState : public ff::State
+{
+public:
+	TestAnimationState(ff::AppGlobals* globals);
+
+	virtual std::shared_ptr<ff::State> Advance(ff::AppGlobals* globals) override;
+	virtual void Render(ff::AppGlobals* globals, ff::IRenderTarget* target, ff::IRenderDepth* depth) override;
+
+private:
+	void CreatePlayers();
+
+	std::unique_ptr<ff::IRenderer> _render;
+	ff::Viewport _viewport;
+	ff::TypedResource<ff::ISprite> _spriteResource;
+	ff::TypedResource<ff::ISpriteFont> _fontResource;
+	ff::Vector<ff::ComPtr<ff::IAnimation>> _animations;
+	ff::Vector<ff::ComPtr<ff::IAnimationPlayer>> _players;
+	ff::Vector<ff::Transform> _playerPositions;
+	ff::AnimationBatch _batch;
+
+	// Both paths advance every frame, rendering alternates between them
+	size_t _benchFrame;
+	double _benchAdvanceSeconds[2];
+	double _benchRenderSeconds[2];
+	double _benchAdvanceMs[2];
+	double _benchRenderMs[2];
+};
@@ -98,17 +98,21 @@ void TestEntityState::Render(ff::AppGlobals* globals, ff::IRenderTarget* target,
 	ff::RendererActive render = _render->BeginRender(target, depth, view, WORLD_RECT);
 	render->PushPalette(_palette);
 
+	_renderSprites.Clear();
+	_renderTransforms.Clear();
+
 	for (const RenderSystemEntry& entry : _renderEntityBucket->GetEntries())
 	{
-		render->DrawSprite(
-			entry.GetComponent<VisualComponent>()->sprite,
-			ff::Transform::Create(
-				entry.GetComponent<PositionComponent>()->position,
-				entry.GetComponent<VisualComponent>()->scale,
-				entry.GetComponent<VisualComponent>()->rotate,
-				entry.GetComponent<VisualComponent>()->color));
+		_renderSprites.Push(entry.GetComponent<VisualComponent>()->sprite);
+		_renderTransforms.Push(ff::Transform::Create(
+			entry.GetComponent<PositionComponent>()->position,
+			entry.GetComponent<VisualComponent>()->scale,
+			entry.GetComponent<VisualComponent>()->rotate,
+			entry.GetComponent<VisualComponent>()->color));
 	}
 
+	render->DrawSprites(_renderSprites.Data(), _renderTransforms.ConstData(), _renderSprites.Size());
+
 	ff::ISpriteFont* font = _fontResource.Flush();
 	ff::String text = ff::String::format_new(L"Entities:%lu", _renderEntityBucket->GetEntries().Size());
 	font->DrawText(render, text, ff::Transform::Create(ff::PointFloat(20, 1040)), ff::GetColorBlack());
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Entity/EntityDomain.h"
+#include "Graph/Anim/Transform.h"
 #include "Graph/RenderTarget/Viewport.h"
 #include "Resource/ResourceValue.h"
 #include "State/State.h"
@@ -39,4 +40,6 @@ private:
 	ff::TypedResource<ff::ISpriteList> _paletteSpritesResource;
 	ff::TypedResource<ff::ISpriteFont> _fontResource;
 	ff::ComPtr<ff::IPalette> _palette;
+	ff::Vector<ff::ISprite*> _renderSprites;
+	ff::Vector<ff::Transform> _renderTransforms;
 };
@@ -14,13 +14,25 @@
 #include "States/TestFontState.h"
 #include "String/StringUtil.h"
 #include "Thread/ThreadPool.h"
+#include "Types/Timer.h"
+
+static const size_t BENCH_DRAW_COUNT = 1000;
+static const size_t BENCH_STRING_COUNT = 200;
+static const size_t BENCH_FRAME_COUNT = 120;
 
 TestFontState::TestFontState()
 	: _createdSpriteFont(false)
+	, _benchFrame(0)
+	, _benchSeconds{ 0, 0 }
+	, _benchAverageMs{ 0, 0 }
 {
 	ff::IGraphDevice *graph = ff::AppGlobals::Get()->GetGraph();
 	_render = graph->CreateRenderer();
 
+	for (size_t i = 0; i < ::BENCH_STRING_COUNT; i++)
+	{
+		_benchStrings.Push(ff::String::format_new(L"Score: %lu, Item #%lu 'AVATAR'", i * 1234, i));
+	}
 }
 
 TestFontState::~TestFontState()
@@ -57,7 +69,38 @@ void TestFontState::Render(ff::AppGlobals *context, ff::IRenderTarget *target, f
 
 		render->DrawOutlineRectangle(ff::RectFloat(20, 20, 20 + size.x, 20 + size.y), ff::GetColorYellow(), 1, true);
 		render->DrawOutlineRectangle(ff::RectFloat(20, 200, 20 + size2.x, 200 + size2.y), ff::GetColorYellow(), 1, true);
+
+		RenderBenchmark(render, font2);
+	}
+}
+
+void TestFontState::RenderBenchmark(ff::IRendererActive* render, ff::ISpriteFont* font)
+{
+	size_t noCache = _benchFrame++ & 1;
+	ff::SpriteFontOptions options = noCache ? ff::SpriteFontOptions::NoCache : ff::SpriteFontOptions::None;
+	ff::Timer timer;
+
+	for (size_t i = 0; i < ::BENCH_DRAW_COUNT; i++)
+	{
+		ff::PointFloat pos(20.0f + (i % 5) * 250.0f, 300.0f + (i / 5) * 2.0f);
+		font->DrawText(render, _benchStrings[i % ::BENCH_STRING_COUNT], ff::Transform::Create(pos, ff::PointFloat(0.5f, 0.5f)), ff::GetColorNone(), options);
+	}
+
+	_benchSeconds[noCache] += timer.Tick();
+
+	if (_benchFrame == ::BENCH_FRAME_COUNT)
+	{
+		for (size_t i = 0; i < 2; i++)
+		{
+			_benchAverageMs[i] = _benchSeconds[i] * 1000.0 / (::BENCH_FRAME_COUNT / 2);
+			_benchSeconds[i] = 0;
+		}
+
+		_benchFrame = 0;
 	}
+
+	ff::String text = ff::String::format_new(L"%lu strings: cached %.3fms, uncached %.3fms", ::BENCH_DRAW_COUNT, _benchAverageMs[0], _benchAverageMs[1]);
+	font->DrawText(render, text, ff::Transform::Create(ff::PointFloat(20, 260), ff::PointFloat::Ones(), 0.0f, ff::GetColorWhite()), ff::GetColorBlack());
 }
 
 void TestFontState::CreateSpriteFont()
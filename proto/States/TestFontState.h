@@ -6,6 +6,7 @@
 namespace ff
 {
 	class IRenderDepth;
+	class IRendererActive;
 	class IRenderer;
 	class IResources;
 	class ISpriteFont;
@@ -22,10 +23,17 @@ public:
 
 private:
 	void CreateSpriteFont();
+	void RenderBenchmark(ff::IRendererActive* render, ff::ISpriteFont* font);
 
 	bool _createdSpriteFont;
 	std::unique_ptr<ff::IRenderer> _render;
 	ff::ComPtr<ff::IResources> _resources;
 	ff::TypedResource<ff::ISpriteFont> _font;
 	ff::TypedResource<ff::ISpriteFont> _font2;
+
+	// Layout cache benchmark, alternates frames with and without the cache
+	ff::Vector<ff::String> _benchStrings;
+	size_t _benchFrame;
+	double _benchSeconds[2];
+	double _benchAverageMs[2];
 };
@@ -7,15 +7,20 @@
 #include "Dict/DictPersist.h"
 #include "Dict/DictVisitor.h"
 #include "Dict/JsonPersist.h"
+#include "Globals/Log.h"
 #include "Globals/DesktopGlobals.h"
 #include "Globals/GlobalsScope.h"
+#include "Graph/DirectXUtil.h"
+#include "Graph/Font/SpriteFont.h"
 #include "Graph/GraphDevice.h"
 #include "Graph/GraphFactory.h"
+#include "Graph/Texture/TextureCompress.h"
 #include "Globals/ProcessGlobals.h"
 #include "MainUtilInclude.h"
 #include "Resource/Resources.h"
 #include "Resource/ResourcePersist.h"
 #include "String/StringUtil.h"
+#include "Thread/ThreadUtil.h"
 #include "Types/Timer.h"
 #include "Value/Values.h"
 #include "Windows/FileUtil.h"
@@ -28,8 +33,10 @@ static ff::ModuleFactory CreateThisModule(s_moduleName, s_moduleId, ff::GetDelay
 static void ShowUsage()
 {
 	std::wcerr << L"Resource packer usage:" << std::endl;
-	std::wcerr << L"    respack.exe -in \"input file\" [-out \"output file\"] [-ref \"types.dll\"] [-debug] [-force]" << std::endl;
+	std::wcerr << L"    respack.exe -in \"input file\" [-out \"output file\"] [-ref \"types.dll\"] [-debug] [-force] [-verbose] [-threads count] [-scaling]" << std::endl;
 	std::wcerr << L"    respack.exe -dump \"pack file\"" << std::endl;
+	std::wcerr << L"    respack.exe -texbench \"PNG directory\"" << std::endl;
+	std::wcerr << L"    respack.exe -pngbench \"PNG directory\"" << std::endl;
 }
 
 static bool TestLoadResources(const ff::Dict &dict)
@@ -69,6 +76,221 @@ static bool TestLoadResources(const ff::Dict &dict)
 	return true;
 }
 
+// Builds the resources with 1 to 16 threads and reports the total and per-font build times
+static bool ReportThreadScaling(ff::StringRef inputFile, bool debug)
+{
+	const size_t threadCounts[] = { 1, 2, 4, 8, 16 };
+	const size_t threadCountSize = _countof(threadCounts);
+
+	// Font name and its total build seconds for each thread count
+	typedef std::pair<ff::String, std::array<double, threadCountSize>> FontSeconds;
+	ff::Vector<FontSeconds> fontSeconds;
+
+	ff::EnableSpriteFontBuildTimes(true);
+	ff::TakeSpriteFontBuildTimes();
+
+	for (size_t i = 0; i < threadCountSize; i++)
+	{
+		size_t threadCount = threadCounts[i];
+		std::wcout << L"ResPack: Building with " << threadCount << L" thread(s)" << std::endl;
+
+		ff::SetParallelThreadCount(threadCount);
+		ff::Timer timer;
+		ff::Vector<ff::String> errors;
+		ff::Dict dict = ff::LoadResourcesFromFile(inputFile, debug, errors);
+		double seconds = timer.Tick();
+		assertRetVal(errors.IsEmpty(), false);
+
+		std::wcout <<
+			L"ResPack: Time: " <<
+			std::fixed <<
+			std::setprecision(3) <<
+			seconds <<
+			L"s (" << threadCount << L" thread(s))" <<
+			std::endl;
+
+		for (const ff::SpriteFontBuildTime& buildTime : ff::TakeSpriteFontBuildTimes())
+		{
+			std::wcout << ff::String::format_new(
+				L"ResPack:   Font %s: %lu glyphs, rasterize:%.1fms, optimize:%.1fms, outline:%.1fms, total:%.1fms",
+				buildTime._name.c_str(),
+				buildTime._glyphs,
+				buildTime._rasterizeSeconds * 1000.0,
+				buildTime._optimizeSeconds * 1000.0,
+				buildTime._outlineSeconds * 1000.0,
+				buildTime._totalSeconds * 1000.0).c_str() << std::endl;
+
+			if (buildTime._outlinePackedPeakTextures)
+			{
+				std::wcout << ff::String::format_new(
+					L"ResPack:   Font %s outline: before:%.1fms, %lu peak textures, after:%.1fms, %lu peak textures",
+					buildTime._name.c_str(),
+					buildTime._outlinePerTextureSeconds * 1000.0,
+					buildTime._outlinePerTexturePeakTextures,
+					buildTime._outlinePackedSeconds * 1000.0,
+					buildTime._outlinePackedPeakTextures).c_str() << std::endl;
+			}
+
+			size_t font = 0;
+			while (font < fontSeconds.Size() && fontSeconds[font].first != buildTime._name)
+			{
+				font++;
+			}
+
+			if (font == fontSeconds.Size())
+			{
+				fontSeconds.Push(FontSeconds(buildTime._name, std::array<double, threadCountSize>{}));
+			}
+
+			fontSeconds[font].second[i] += buildTime._totalSeconds;
+		}
+	}
+
+	ff::EnableSpriteFontBuildTimes(false);
+	ff::SetParallelThreadCount(0);
+
+	for (const FontSeconds& font : fontSeconds)
+	{
+		const std::array<double, threadCountSize>& seconds = font.second;
+		ff::String line = ff::String::format_new(L"ResPack: Font scaling %s:", font.first.c_str());
+
+		for (size_t i = 0; i < threadCountSize; i++)
+		{
+			line.append(ff::String::format_new(L" %lu:%.1fms (%.2fx)",
+				threadCounts[i],
+				seconds[i] * 1000.0,
+				seconds[i] > 0 ? seconds[0] / seconds[i] : 0.0));
+		}
+
+		std::wcout << line.c_str() << std::endl;
+	}
+
+	return true;
+}
+
+static double GetMegabytesPerSecond(size_t bytes, double seconds)
+{
+	return (seconds > 0) ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+}
+
+static ff::Vector<ff::String> GetPngFiles(ff::StringRef dir)
+{
+	ff::Vector<ff::String> dirs;
+	ff::Vector<ff::String> files;
+	ff::Vector<ff::String> paths;
+	assertRetVal(ff::GetDirectoryContents(dir, dirs, files), paths);
+
+	for (ff::StringRef file : files)
+	{
+		ff::String ext = ff::GetPathExtension(file);
+		ff::LowerCaseInPlace(ext);
+
+		if (ext == L"png")
+		{
+			ff::String path = dir;
+			ff::AppendPathTail(path, file);
+			paths.Push(path);
+		}
+	}
+
+	return paths;
+}
+
+// Encodes each PNG in a directory with every compressed format and quality, without using the texture cache
+static bool ReportTextureCompression(ff::StringRef dir)
+{
+	const wchar_t* formats[] = { L"bc1", L"bc3", L"bc7" };
+	const wchar_t* compressions[] = { L"fast", L"default", L"best" };
+
+	for (ff::StringRef path : ::GetPngFiles(dir))
+	{
+		ff::String file = ff::GetPathTail(path);
+
+		for (const wchar_t* format : formats)
+		{
+			for (const wchar_t* compression : compressions)
+			{
+				ff::TextureCompressionReport report;
+				if (!ff::MeasureTextureCompression(path, ff::ParseDxgiTextureFormat(ff::String(format)), ff::ParseTextureCompression(ff::String(compression)), report))
+				{
+					std::wcout << L"ResPack: " << file << L": skipped, size must be a multiple of 4" << std::endl;
+					break;
+				}
+
+				std::wcout <<
+					L"ResPack: " << file << L" " << format << L" " << compression << L": " <<
+					std::fixed <<
+					std::setprecision(2) <<
+					::GetMegabytesPerSecond(report._imageBytes, report._seconds) << L"MB/s, " <<
+					report._psnr << L"dB PSNR" <<
+					std::endl;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Decodes each PNG in a directory to premultiplied BGRA, with and without full size temporary images
+static bool ReportTextureDecode(ff::StringRef dir)
+{
+	const double megabyte = 1024.0 * 1024.0;
+	DXGI_FORMAT format = ff::ParseDxgiTextureFormat(ff::String(L"bgra32"));
+	ff::Vector<ff::String> paths = ::GetPngFiles(dir);
+	ff::Vector<ff::TextureDecodeReport> reports;
+	reports.Resize(paths.Size());
+
+	double serialSeconds = 0;
+	size_t totalBytes = 0;
+
+	for (size_t i = 0; i < paths.Size(); i++)
+	{
+		ff::TextureDecodeReport& report = reports[i];
+		assertRetVal(ff::MeasureTextureDecode(paths[i], format, true, report), false);
+
+		serialSeconds += report._convertSeconds + report._directSeconds;
+		totalBytes += report._imageBytes * 2;
+
+		std::wcout <<
+			L"ResPack: " << ff::GetPathTail(paths[i]) << L": " <<
+			std::fixed <<
+			std::setprecision(2) <<
+			L"convert:" << ::GetMegabytesPerSecond(report._imageBytes, report._convertSeconds) << L"MB/s " <<
+			report._convertPeakBytes / megabyte << L"MB peak, " <<
+			L"direct:" << ::GetMegabytesPerSecond(report._imageBytes, report._directSeconds) << L"MB/s " <<
+			report._directPeakBytes / megabyte << L"MB peak" <<
+			std::endl;
+	}
+
+	// Same work again, with every file decoding at once like a sprite list does
+	std::atomic_bool failed = false;
+	ff::Timer timer;
+
+	ff::ParallelFor(paths.Size(), [&paths, &reports, &failed, format](size_t i)
+		{
+			if (!ff::MeasureTextureDecode(paths[i], format, true, reports[i]))
+			{
+				failed = true;
+			}
+		});
+
+	double parallelSeconds = timer.Tick();
+	assertRetVal(!failed, false);
+
+	if (paths.Size())
+	{
+		std::wcout <<
+			L"ResPack: " << paths.Size() << L" files, " <<
+			std::fixed <<
+			std::setprecision(2) <<
+			L"serial:" << ::GetMegabytesPerSecond(totalBytes, serialSeconds) << L"MB/s, " <<
+			L"parallel:" << ::GetMegabytesPerSecond(totalBytes, parallelSeconds) << L"MB/s" <<
+			std::endl;
+	}
+
+	return true;
+}
+
 static bool CompileResourcePack(ff::StringRef inputFile, ff::StringRef outputFile, bool debug)
 {
 	ff::Vector<ff::String> errors;
@@ -239,6 +461,9 @@ int wmain()
 	bool force = false;
 	bool verbose = false;
 	bool dumpBin = false;
+	bool scaling = false;
+	ff::String textureBenchDir;
+	ff::String decodeBenchDir;
 
 	for (size_t i = 1; i < args.Size(); i++)
 	{
@@ -278,6 +503,25 @@ int wmain()
 		{
 			verbose = true;
 		}
+		else if (arg == L"-threads" && i + 1 < args.Size())
+		{
+			ff::SetParallelThreadCount((size_t)std::wcstoul(args[++i].c_str(), nullptr, 10));
+		}
+		else if (arg == L"-scaling")
+		{
+			scaling = true;
+			verbose = true;
+		}
+		else if (arg == L"-texbench" && i + 1 < args.Size())
+		{
+			textureBenchDir = ff::GetCurrentDirectory();
+			ff::AppendPathTail(textureBenchDir, args[++i]);
+		}
+		else if (arg == L"-pngbench" && i + 1 < args.Size())
+		{
+			decodeBenchDir = ff::GetCurrentDirectory();
+			ff::AppendPathTail(decodeBenchDir, args[++i]);
+		}
 		else
 		{
 			ShowUsage();
@@ -296,6 +540,16 @@ int wmain()
 		return DumpFile(dumpFile, dumpBin);
 	}
 
+	if (textureBenchDir.size())
+	{
+		return ::ReportTextureCompression(textureBenchDir) ? 0 : 5;
+	}
+
+	if (decodeBenchDir.size())
+	{
+		return ::ReportTextureDecode(decodeBenchDir) ? 0 : 5;
+	}
+
 	if (inputFile.empty())
 	{
 		ShowUsage();
@@ -349,6 +603,25 @@ int wmain()
 		return 4;
 	}
 
+	if (verbose)
+	{
+		globals.GetGlobals().GetLog().SetConsoleOutput(true);
+	}
+
+	if (scaling)
+	{
+		if (!::ReportThreadScaling(inputFile, debug))
+		{
+			std::wcerr << L"ResPack: FAILED" << std::endl;
+			return 5;
+		}
+
+		timer.Reset();
+	}
+
+	// Only the real build uses the compressed texture cache, scaling measures the encoder every time
+	ff::EnableTextureCompressionCache(true);
+
 	if (!::CompileResourcePack(inputFile, outputFile, debug))
 	{
 		std::wcerr << L"ResPack: FAILED" << std::endl;
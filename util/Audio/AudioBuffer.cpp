@@ -1,16 +1,20 @@
 #include "pch.h"
 #include "Audio/AudioBuffer.h"
+#include "Audio/AudioFactory.h"
+#include "Audio/AudioPcmCache.h"
 #include "Data/Data.h"
 #include "Data/DataFile.h"
 #include "Data/DataPersist.h"
 #include "Data/DataWriterReader.h"
 #include "Data/SavedData.h"
 #include "Dict/Dict.h"
+#include "Globals/ProcessGlobals.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
 #include "String/StringUtil.h"
 #include "Value/Values.h"
 
+static ff::StaticString PROP_COMPRESS(L"compress");
 static ff::StaticString PROP_DATA(L"data");
 static ff::StaticString PROP_FILE(L"file");
 static ff::StaticString PROP_FORMAT(L"format");
@@ -122,7 +126,7 @@ public:
 
 	// IAudioBuffer functions
 	virtual const WAVEFORMATEX& GetFormat() const override;
-	virtual ff::IData* GetData() const override;
+	virtual ff::ComPtr<ff::IData> GetData() const override;
 
 	// IResourcePersist
 	virtual bool LoadFromSource(const ff::Dict& dict) override;
@@ -132,6 +136,8 @@ public:
 private:
 	WAVEFORMATEX _format;
 	ff::ComPtr<ff::IData> _data;
+	std::shared_ptr<ff::AudioPcmClip> _clip;
+	bool _compress;
 };
 
 BEGIN_INTERFACES(AudioBuffer)
@@ -145,7 +151,9 @@ static ff::ModuleStartup RegisterAudioBuffer([](ff::Module& module)
 	});
 
 AudioBuffer::AudioBuffer()
+	: _compress(false)
 {
+	ff::ZeroObject(_format);
 }
 
 AudioBuffer::~AudioBuffer()
@@ -157,9 +165,9 @@ const WAVEFORMATEX& AudioBuffer::GetFormat() const
 	return _format;
 }
 
-ff::IData* AudioBuffer::GetData() const
+ff::ComPtr<ff::IData> AudioBuffer::GetData() const
 {
-	return _data;
+	return _clip ? _clip->GetData() : _data;
 }
 
 bool AudioBuffer::LoadFromSource(const ff::Dict& dict)
@@ -176,6 +184,7 @@ bool AudioBuffer::LoadFromSource(const ff::Dict& dict)
 
 	_data = waveHelper._data;
 	_format = waveHelper._format;
+	_compress = dict.Get<ff::BoolValue>(PROP_COMPRESS);
 
 	assertRetVal(_data && _format.wFormatTag != 0, false);
 
@@ -184,17 +193,36 @@ bool AudioBuffer::LoadFromSource(const ff::Dict& dict)
 
 bool AudioBuffer::LoadFromCache(const ff::Dict& dict)
 {
-	_data = dict.Get<ff::DataValue>(PROP_DATA);
+	ff::ComPtr<ff::ISavedData> savedData = dict.Get<ff::SavedDataValue>(PROP_DATA);
 	ff::ComPtr<ff::IData> formatData = dict.Get<ff::DataValue>(PROP_FORMAT);
-	assertRetVal(_data && formatData && formatData->GetSize() == sizeof(_format), false);
+	assertRetVal(savedData && formatData && formatData->GetSize() == sizeof(_format), false);
 	_format = *(const WAVEFORMATEX*)formatData->GetMem();
+	_compress = dict.Get<ff::BoolValue>(PROP_COMPRESS);
+
+	// Identical sounds from any resource pack share their PCM, which gets decompressed on the thread pool now
+	_clip = ff::ProcessGlobals::Get()->GetAudioFactory()->GetPcmCache().Add(_format, savedData, _compress);
+	assertRetVal(_clip, false);
 
 	return true;
 }
 
 bool AudioBuffer::SaveToCache(ff::Dict& dict)
 {
-	dict.Set<ff::DataValue>(PROP_DATA, _data);
+	ff::ComPtr<ff::IData> data = GetData();
+	assertRetVal(data, false);
+
+	if (_compress)
+	{
+		ff::ComPtr<ff::ISavedData> savedData;
+		assertRetVal(ff::CreateLoadedDataFromMemory(data, true, &savedData), false);
+		dict.Set<ff::SavedDataValue>(PROP_DATA, savedData);
+		dict.Set<ff::BoolValue>(PROP_COMPRESS, true);
+	}
+	else
+	{
+		dict.Set<ff::DataValue>(PROP_DATA, data);
+	}
+
 	dict.Set<ff::DataValue>(PROP_FORMAT, &_format, sizeof(_format));
 
 	return true;
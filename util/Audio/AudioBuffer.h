@@ -9,6 +9,6 @@ namespace ff
 	{
 	public:
 		virtual const WAVEFORMATEX& GetFormat() const = 0;
-		virtual IData* GetData() const = 0;
+		virtual ComPtr<IData> GetData() const = 0; // keep a reference while the data plays
 	};
 }
@@ -0,0 +1,296 @@
+#include "pch.h"
+#include "Audio/AudioDecoder.h"
+#include "Audio/AudioStream.h"
+#include "Data/DataPersist.h"
+#include "Data/DataWriterReader.h"
+#include "Data/Stream.h"
+
+static const size_t MAX_DECODER_CHANNELS = 8;
+
+static constexpr DWORD MakeFourCC(char ch0, char ch1, char ch2, char ch3)
+{
+	return
+		(DWORD)ch0 |
+		((DWORD)ch1 << 8) |
+		((DWORD)ch2 << 16) |
+		((DWORD)ch3 << 24);
+}
+
+ff::AudioWavDecoder::AudioWavDecoder()
+	: _dataStart(0)
+	, _frameCount(0)
+	, _frame(0)
+	, _channels(0)
+	, _sampleRate(0)
+	, _float(false)
+{
+}
+
+bool ff::AudioWavDecoder::Init(IDataReader* reader)
+{
+	assertRetVal(reader && !_reader, false);
+
+	DWORD id, size, waveId;
+	assertRetVal(ff::LoadData(reader, id) && id == ::MakeFourCC('R', 'I', 'F', 'F'), false);
+	assertRetVal(ff::LoadData(reader, size) && ff::LoadData(reader, waveId) && waveId == ::MakeFourCC('W', 'A', 'V', 'E'), false);
+
+	WAVEFORMATEX format{};
+	size_t dataSize = 0;
+
+	while (!dataSize && reader->GetPos() + 8 <= reader->GetSize())
+	{
+		assertRetVal(ff::LoadData(reader, id) && ff::LoadData(reader, size), false);
+		size_t chunkStart = reader->GetPos();
+
+		if (id == ::MakeFourCC('f', 'm', 't', ' '))
+		{
+			assertRetVal(size >= sizeof(PCMWAVEFORMAT), false);
+			const BYTE* bytes = reader->Read(size);
+			assertRetVal(bytes, false);
+			std::memcpy(&format, bytes, sizeof(PCMWAVEFORMAT));
+
+			// The sub format GUID starts with the real format tag
+			if (format.wFormatTag == WAVE_FORMAT_EXTENSIBLE && size >= sizeof(WAVEFORMATEXTENSIBLE))
+			{
+				format.wFormatTag = (WORD)reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(bytes)->SubFormat.Data1;
+			}
+		}
+		else if (id == ::MakeFourCC('d', 'a', 't', 'a'))
+		{
+			_dataStart = chunkStart;
+			dataSize = std::min<size_t>(size, reader->GetSize() - chunkStart);
+		}
+
+		// Chunks are padded to an even size
+		assertRetVal(dataSize || reader->SetPos(chunkStart + size + (size & 1)), false);
+	}
+
+	_float = (format.wFormatTag == WAVE_FORMAT_IEEE_FLOAT && format.wBitsPerSample == 32);
+	bool isPcm16 = (format.wFormatTag == WAVE_FORMAT_PCM && format.wBitsPerSample == 16);
+	assertRetVal((_float || isPcm16) && format.nChannels && format.nChannels <= ::MAX_DECODER_CHANNELS && format.nSamplesPerSec, false);
+	assertRetVal(dataSize, false);
+
+	_reader = reader;
+	_channels = format.nChannels;
+	_sampleRate = format.nSamplesPerSec;
+	_frameCount = dataSize / (_channels * (_float ? sizeof(float) : sizeof(INT16)));
+
+	return SetPosition(0);
+}
+
+size_t ff::AudioWavDecoder::GetChannels() const
+{
+	return _channels;
+}
+
+size_t ff::AudioWavDecoder::GetSampleRate() const
+{
+	return _sampleRate;
+}
+
+size_t ff::AudioWavDecoder::GetFrameCount() const
+{
+	return _frameCount;
+}
+
+size_t ff::AudioWavDecoder::Decode(float* samples, size_t frameCount)
+{
+	frameCount = std::min(frameCount, _frameCount - _frame);
+	noAssertRetVal(frameCount && _reader, 0);
+
+	size_t sampleCount = frameCount * _channels;
+	const BYTE* bytes = _reader->Read(sampleCount * (_float ? sizeof(float) : sizeof(INT16)));
+	assertRetVal(bytes, 0);
+
+	if (_float)
+	{
+		std::memcpy(samples, bytes, sampleCount * sizeof(float));
+	}
+	else
+	{
+		const INT16* source = reinterpret_cast<const INT16*>(bytes);
+		for (size_t i = 0; i < sampleCount; i++)
+		{
+			samples[i] = source[i] * (1.0f / 32768.0f);
+		}
+	}
+
+	_frame += frameCount;
+	return frameCount;
+}
+
+bool ff::AudioWavDecoder::SetPosition(size_t frame)
+{
+	assertRetVal(_reader, false);
+
+	_frame = std::min(frame, _frameCount);
+	return _reader->SetPos(_dataStart + _frame * _channels * (_float ? sizeof(float) : sizeof(INT16)));
+}
+
+ff::AudioMediaDecoder::AudioMediaDecoder()
+	: _pendingPos(0)
+	, _frameCount(0)
+	, _channels(0)
+	, _sampleRate(0)
+	, _ended(false)
+{
+}
+
+bool ff::AudioMediaDecoder::Init(IDataReader* reader, StringRef mimeType)
+{
+	assertRetVal(reader && !_mediaReader, false);
+
+	ff::ComPtr<IMFByteStream> mediaByteStream;
+	assertRetVal(ff::CreateReadStream(reader, mimeType, &mediaByteStream), false);
+
+	ff::ComPtr<IMFSourceResolver> sourceResolver;
+	assertHrRetVal(::MFCreateSourceResolver(&sourceResolver), false);
+
+	ff::ComPtr<IUnknown> mediaSourceUnknown;
+	MF_OBJECT_TYPE mediaSourceObjectType = MF_OBJECT_MEDIASOURCE;
+	DWORD mediaSourceFlags = MF_RESOLUTION_MEDIASOURCE | MF_RESOLUTION_READ | MF_RESOLUTION_DISABLE_LOCAL_PLUGINS;
+	assertHrRetVal(sourceResolver->CreateObjectFromByteStream(mediaByteStream, nullptr, mediaSourceFlags, nullptr, &mediaSourceObjectType, &mediaSourceUnknown), false);
+
+	ff::ComPtr<IMFMediaSource> mediaSource;
+	assertRetVal(mediaSource.QueryFrom(mediaSourceUnknown), false);
+
+	// No async callback, samples are read on the decoding thread
+	ff::ComPtr<IMFSourceReader> mediaReader;
+	assertHrRetVal(::MFCreateSourceReaderFromMediaSource(mediaSource, nullptr, &mediaReader), false);
+	assertHrRetVal(mediaReader->SetStreamSelection(MF_SOURCE_READER_ALL_STREAMS, false), false);
+	assertHrRetVal(mediaReader->SetStreamSelection(MF_SOURCE_READER_FIRST_AUDIO_STREAM, true), false);
+
+	ff::ComPtr<IMFMediaType> mediaType;
+	assertHrRetVal(::MFCreateMediaType(&mediaType), false);
+	assertHrRetVal(mediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio), false);
+	assertHrRetVal(mediaType->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_Float), false);
+	assertHrRetVal(mediaReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, nullptr, mediaType), false);
+
+	ff::ComPtr<IMFMediaType> actualMediaType;
+	assertHrRetVal(mediaReader->GetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, &actualMediaType), false);
+
+	UINT32 channels = 0;
+	UINT32 sampleRate = 0;
+	assertHrRetVal(actualMediaType->GetUINT32(MF_MT_AUDIO_NUM_CHANNELS, &channels), false);
+	assertHrRetVal(actualMediaType->GetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, &sampleRate), false);
+	assertRetVal(channels && channels <= ::MAX_DECODER_CHANNELS && sampleRate, false);
+
+	PROPVARIANT durationValue;
+	assertHrRetVal(mediaReader->GetPresentationAttribute(MF_SOURCE_READER_MEDIASOURCE, MF_PD_DURATION, &durationValue), false);
+
+	_mediaReader = mediaReader;
+	_channels = channels;
+	_sampleRate = sampleRate;
+	_frameCount = (size_t)(durationValue.uhVal.QuadPart * sampleRate / 10000000);
+
+	return true;
+}
+
+size_t ff::AudioMediaDecoder::GetChannels() const
+{
+	return _channels;
+}
+
+size_t ff::AudioMediaDecoder::GetSampleRate() const
+{
+	return _sampleRate;
+}
+
+size_t ff::AudioMediaDecoder::GetFrameCount() const
+{
+	return _frameCount;
+}
+
+size_t ff::AudioMediaDecoder::Decode(float* samples, size_t frameCount)
+{
+	size_t sampleCount = frameCount * _channels;
+	size_t done = 0;
+
+	while (done < sampleCount)
+	{
+		if (_pendingPos == _pending.Size() && !ReadSample())
+		{
+			break;
+		}
+
+		size_t count = std::min(sampleCount - done, _pending.Size() - _pendingPos);
+		std::memcpy(samples + done, _pending.Data() + _pendingPos, count * sizeof(float));
+		_pendingPos += count;
+		done += count;
+	}
+
+	return done / _channels;
+}
+
+bool ff::AudioMediaDecoder::SetPosition(size_t frame)
+{
+	assertRetVal(_mediaReader && _sampleRate, false);
+
+	PROPVARIANT value;
+	::PropVariantInit(&value);
+	value.vt = VT_I8;
+	value.hVal.QuadPart = (LONGLONG)((UINT64)frame * 10000000 / _sampleRate);
+
+	HRESULT hr = _mediaReader->SetCurrentPosition(GUID_NULL, value);
+	::PropVariantClear(&value);
+	assertHrRetVal(hr, false);
+
+	_pending.Clear();
+	_pendingPos = 0;
+	_ended = false;
+
+	return true;
+}
+
+bool ff::AudioMediaDecoder::ReadSample()
+{
+	_pending.Clear();
+	_pendingPos = 0;
+
+	while (!_ended && _pending.IsEmpty() && _mediaReader)
+	{
+		DWORD streamFlags = 0;
+		LONGLONG timestamp = 0;
+		ff::ComPtr<IMFSample> sample;
+		assertHrRetVal(_mediaReader->ReadSample(MF_SOURCE_READER_FIRST_AUDIO_STREAM, 0, nullptr, &streamFlags, &timestamp, &sample), false);
+
+		_ended = (streamFlags & (MF_SOURCE_READERF_ENDOFSTREAM | MF_SOURCE_READERF_ERROR)) != 0;
+
+		ff::ComPtr<IMFMediaBuffer> mediaBuffer;
+		BYTE* data = nullptr;
+		DWORD dataSize = 0;
+
+		if (sample &&
+			SUCCEEDED(sample->ConvertToContiguousBuffer(&mediaBuffer)) &&
+			SUCCEEDED(mediaBuffer->Lock(&data, nullptr, &dataSize)))
+		{
+			// Only whole frames
+			size_t sampleCount = dataSize / sizeof(float) / _channels * _channels;
+			_pending.Resize(sampleCount);
+			std::memcpy(_pending.Data(), data, sampleCount * sizeof(float));
+			mediaBuffer->Unlock();
+		}
+	}
+
+	return !_pending.IsEmpty();
+}
+
+std::unique_ptr<ff::IAudioDecoder> ff::CreateAudioDecoder(IAudioStream* stream)
+{
+	assertRetVal(stream, nullptr);
+
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(stream->CreateReader(&reader), nullptr);
+
+	ff::StringRef mimeType = stream->GetMimeType();
+	if (mimeType == L"audio/wav" || mimeType == L"audio/x-wav" || mimeType == L"audio/wave")
+	{
+		std::unique_ptr<ff::AudioWavDecoder> decoder = std::make_unique<ff::AudioWavDecoder>();
+		assertRetVal(decoder->Init(reader), nullptr);
+		return decoder;
+	}
+
+	std::unique_ptr<ff::AudioMediaDecoder> decoder = std::make_unique<ff::AudioMediaDecoder>();
+	assertRetVal(decoder->Init(reader, mimeType), nullptr);
+	return decoder;
+}
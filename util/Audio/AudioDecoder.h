@@ -0,0 +1,74 @@
+#pragma once
+
+namespace ff
+{
+	class IAudioStream;
+	class IDataReader;
+
+	// Decodes music into interleaved float samples. Decoders are only used by one thread at a time,
+	// but that thread doesn't have to be the one that created it.
+	class __declspec(novtable) IAudioDecoder
+	{
+	public:
+		virtual ~IAudioDecoder() { }
+
+		virtual size_t GetChannels() const = 0;
+		virtual size_t GetSampleRate() const = 0;
+		virtual size_t GetFrameCount() const = 0; // zero when it isn't known
+		virtual size_t Decode(float* samples, size_t frameCount) = 0; // returns zero at the end
+		virtual bool SetPosition(size_t frame) = 0;
+	};
+
+	// Reads 16-bit PCM or 32-bit float WAV files, without Media Foundation
+	class AudioWavDecoder : public IAudioDecoder
+	{
+	public:
+		UTIL_API AudioWavDecoder();
+		UTIL_API bool Init(IDataReader* reader);
+
+		// IAudioDecoder
+		virtual size_t GetChannels() const override;
+		virtual size_t GetSampleRate() const override;
+		virtual size_t GetFrameCount() const override;
+		virtual size_t Decode(float* samples, size_t frameCount) override;
+		virtual bool SetPosition(size_t frame) override;
+
+	private:
+		ComPtr<IDataReader> _reader;
+		size_t _dataStart;
+		size_t _frameCount;
+		size_t _frame;
+		size_t _channels;
+		size_t _sampleRate;
+		bool _float;
+	};
+
+	// Uses a synchronous Media Foundation source reader for MP3 and anything else it understands
+	class AudioMediaDecoder : public IAudioDecoder
+	{
+	public:
+		AudioMediaDecoder();
+		bool Init(IDataReader* reader, StringRef mimeType);
+
+		// IAudioDecoder
+		virtual size_t GetChannels() const override;
+		virtual size_t GetSampleRate() const override;
+		virtual size_t GetFrameCount() const override;
+		virtual size_t Decode(float* samples, size_t frameCount) override;
+		virtual bool SetPosition(size_t frame) override;
+
+	private:
+		bool ReadSample();
+
+		ComPtr<IMFSourceReader> _mediaReader;
+		ff::Vector<float> _pending;
+		size_t _pendingPos;
+		size_t _frameCount;
+		size_t _channels;
+		size_t _sampleRate;
+		bool _ended;
+	};
+
+	// Picks a decoder based on the stream's MIME type
+	UTIL_API std::unique_ptr<IAudioDecoder> CreateAudioDecoder(IAudioStream* stream);
+}
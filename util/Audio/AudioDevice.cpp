@@ -3,7 +3,9 @@
 #include "Audio/AudioDeviceChild.h"
 #include "Audio/AudioEffect.h"
 #include "Audio/AudioFactory.h"
+#include "Audio/AudioPcmCache.h"
 #include "Audio/AudioPlaying.h"
+#include "Audio/AudioVoicePool.h"
 #include "COM/ComAlloc.h"
 #include "Globals/ThreadGlobals.h"
 
@@ -12,6 +14,7 @@ class __declspec(uuid("039ec1dd-9e1a-4d08-9678-7937a0671d9a"))
 	: public ff::ComBase
 	, public ff::IAudioDevice
 	, public ff::IXAudioDevice
+	, public ff::IAudioVoicePoolBackend
 {
 public:
 	DECLARE_HEADER(AudioDevice);
@@ -41,8 +44,13 @@ public:
 	virtual void RemovePlaying(ff::IAudioPlaying* child) override;
 
 	virtual ff::IXAudioDevice* AsXAudioDevice() override;
+	virtual ff::IMixerAudioDevice* AsMixerAudioDevice() override;
 	virtual IXAudio2* GetAudio() const override;
 	virtual IXAudio2Voice* GetVoice(ff::AudioVoiceType type) const override;
+	virtual ff::AudioVoicePool* GetVoicePool() override;
+
+	// IAudioVoicePoolBackend
+	virtual ff::IAudioPoolVoice* CreateVoice(const WAVEFORMATEX& format) override;
 
 private:
 	ff::Mutex _mutex;
@@ -50,6 +58,7 @@ private:
 	IXAudio2MasteringVoice* _masterVoice;
 	IXAudio2SubmixVoice* _effectVoice;
 	IXAudio2SubmixVoice* _musicVoice;
+	ff::AudioVoicePool _voicePool;
 	ff::Vector<ff::IAudioDeviceChild*> _children;
 	ff::Vector<ff::IAudioPlaying*> _playing;
 	ff::Vector<ff::IAudioPlaying*> _paused;
@@ -80,6 +89,7 @@ AudioDevice::AudioDevice()
 	: _masterVoice(nullptr)
 	, _effectVoice(nullptr)
 	, _musicVoice(nullptr)
+	, _voicePool(this)
 	, _channels(0)
 	, _sampleRate(0)
 	, _advances(0)
@@ -168,6 +178,10 @@ bool AudioDevice::IsValid() const
 
 void AudioDevice::Destroy()
 {
+	// Pooled effect voices send to the effect voice, so they must go first.
+	// They are destroyed by child work items, which the loop below finishes right away.
+	_voicePool.Clear();
+
 	for (size_t i = 0; i < _children.Size(); i++)
 	{
 		_children[i]->Reset();
@@ -244,10 +258,15 @@ void AudioDevice::SetVolume(ff::AudioVoiceType type, float volume)
 
 void AudioDevice::AdvanceEffects()
 {
-	// Check if speakers were plugged in every two seconds
-	if (++_advances % 120 == 0 && !IsValid())
+	// Check if speakers were plugged in every two seconds, and free sounds that are kept compressed
+	if (++_advances % 120 == 0)
 	{
-		Reset();
+		if (!IsValid())
+		{
+			Reset();
+		}
+
+		_factory->GetPcmCache().Trim();
 	}
 
 	for (auto i = _playing.crbegin(); i != _playing.crend(); i++)
@@ -307,6 +326,11 @@ ff::IXAudioDevice* AudioDevice::AsXAudioDevice()
 	return this;
 }
 
+ff::IMixerAudioDevice* AudioDevice::AsMixerAudioDevice()
+{
+	return nullptr;
+}
+
 IXAudio2* AudioDevice::GetAudio() const
 {
 	return _factory->AsXAudioFactory()->GetAudio();
@@ -330,6 +354,25 @@ IXAudio2Voice* AudioDevice::GetVoice(ff::AudioVoiceType type) const
 	}
 }
 
+ff::AudioVoicePool* AudioDevice::GetVoicePool()
+{
+	return &_voicePool;
+}
+
+ff::IAudioPoolVoice* AudioDevice::CreateVoice(const WAVEFORMATEX& format)
+{
+	noAssertRetVal(_effectVoice, nullptr);
+
+	ff::XAudioPoolVoice* voice = new ff::XAudioPoolVoice();
+	if (!voice->Init(this, _effectVoice, format))
+	{
+		voice->Destroy();
+		assertRetVal(false, nullptr);
+	}
+
+	return voice;
+}
+
 void AudioDevice::AddChild(ff::IAudioDeviceChild* child)
 {
 	ff::LockMutex lock(_mutex);
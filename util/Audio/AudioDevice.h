@@ -2,10 +2,14 @@
 
 namespace ff
 {
+	class AudioMixer;
+	class AudioVoicePool;
 	class IAudioDeviceChild;
 	class IAudioPlaying;
+	class IMixerAudioDevice;
 	class IThreadDispatch;
 	class IXAudioDevice;
+	struct AudioMixerSource;
 
 	enum class AudioVoiceType
 	{
@@ -39,6 +43,7 @@ namespace ff
 		virtual void RemovePlaying(IAudioPlaying* child) = 0;
 
 		virtual IXAudioDevice* AsXAudioDevice() = 0;
+		virtual IMixerAudioDevice* AsMixerAudioDevice() = 0;
 	};
 
 	class IXAudioDevice
@@ -46,5 +51,18 @@ namespace ff
 	public:
 		virtual IXAudio2* GetAudio() const = 0;
 		virtual IXAudio2Voice* GetVoice(AudioVoiceType type) const = 0;
+		virtual AudioVoicePool* GetVoicePool() = 0;
+	};
+
+	class IMixerAudioDevice
+	{
+	public:
+		virtual AudioMixer* GetMixer() = 0;
+
+		// The owner is kept alive until the mixer is done reading the source data
+		virtual size_t PlayEffect(const AudioMixerSource& source, IUnknown* owner, float volume, float freqRatio, bool startPlaying) = 0;
+
+		// Only for devices that don't render in real time
+		virtual bool RenderFrames(size_t frameCount) = 0;
 	};
 }
@@ -2,7 +2,9 @@
 #include "Audio/AudioDevice.h"
 #include "Audio/AudioBuffer.h"
 #include "Audio/AudioEffect.h"
+#include "Audio/AudioMixer.h"
 #include "Audio/AudioPlaying.h"
+#include "Audio/AudioVoicePool.h"
 #include "Data/Data.h"
 #include "Data/DataPersist.h"
 #include "Dict/Dict.h"
@@ -25,8 +27,7 @@ static ff::StaticString PROP_LOOP_LENGTH(L"loopLength");
 static ff::StaticString PROP_LOOP_COUNT(L"loopCount");
 static ff::StaticString PROP_VOLUME(L"volume");
 static ff::StaticString PROP_FREQ(L"freq");
-
-void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source);
+static ff::StaticString PROP_PRIORITY(L"priority");
 
 class __declspec(uuid("86764238-1c06-418c-bb2f-b1989beb6c91"))
 	AudioEffect
@@ -67,6 +68,7 @@ private:
 	size_t _loopCount;
 	float _volume;
 	float _freqRatio;
+	int _priority;
 };
 
 BEGIN_INTERFACES(AudioEffect)
@@ -84,11 +86,13 @@ class __declspec(uuid("30002677-efc1-4446-8ab3-d66ed2be3800"))
 	: public ff::ComBase
 	, public ff::IAudioPlaying
 	, public IXAudio2VoiceCallback
+	, public ff::IAudioPoolVoiceOwner
 {
 public:
 	DECLARE_HEADER(AudioEffectPlaying);
 
-	bool Init(ff::IAudioBuffer* pBuffer, IXAudio2SourceVoice* source, bool bStartPlaying);
+	bool Init(ff::IAudioBuffer* pBuffer, ff::IData* data, ff::XAudioPoolVoice* voice, void* context, bool bStartPlaying);
+	bool Init(ff::IAudioBuffer* pBuffer, ff::IData* data, ff::AudioMixer* mixer, size_t mixerVoice, bool bStartPlaying);
 	void SetEffect(AudioEffect* pEffect);
 
 	virtual HRESULT _Construct(IUnknown* unkOuter) override;
@@ -126,13 +130,22 @@ public:
 	COM_FUNC_VOID OnLoopEnd(void* pBufferContext) override;
 	COM_FUNC_VOID OnVoiceError(void* pBufferContext, HRESULT error) override;
 
+	// IAudioPoolVoiceOwner
+	virtual void OnVoiceStolen(ff::IAudioPoolVoice* voice) override;
+
 private:
 	void OnBufferEnd();
+	void ReleaseVoice();
+	bool HasVoice() const;
 
 	ff::ComPtr<ff::IAudioDevice> _device;
 	ff::ComPtr<ff::IAudioBuffer> _buffer;
+	ff::ComPtr<ff::IData> _data;
 	AudioEffect* _effect;
+	ff::XAudioPoolVoice* _voice;
 	IXAudio2SourceVoice* _source;
+	ff::AudioMixer* _mixer;
+	size_t _mixerVoice;
 	bool _paused;
 	bool _done;
 };
@@ -144,6 +157,9 @@ END_INTERFACES()
 // STATIC_DATA (object)
 static ff::PoolAllocator<ff::ComObject<AudioEffectPlaying>> s_audioEffectPlayingAllocator;
 
+// STATIC_DATA (pod)
+static std::atomic<size_t> s_playContext;
+
 static HRESULT CreateAudioEffectPlaying(IUnknown* unkOuter, REFGUID clsid, REFGUID iid, void** ppObj)
 {
 	assertRetVal(clsid == GUID_NULL || clsid == __uuidof(AudioEffectPlaying), E_INVALIDARG);
@@ -161,6 +177,7 @@ AudioEffect::AudioEffect()
 	, _loopCount(0)
 	, _volume(1)
 	, _freqRatio(1)
+	, _priority(0)
 {
 }
 
@@ -203,47 +220,74 @@ bool AudioEffect::Play(bool startPlaying, float volume, float freqRatio, ff::IAu
 		assertRetVal(bufferRes, false);
 	}
 
-	ff::ComPtr<AudioEffectPlaying, ff::IAudioPlaying> pPlaying;
-	IXAudio2SourceVoice* source = nullptr;
+	// Shared PCM can be freed when nothing plays it, so each play keeps a reference
+	ff::ComPtr<ff::IData> data = bufferRes->GetData();
+	assertRetVal(data, false);
 
+	ff::ComPtr<AudioEffectPlaying, ff::IAudioPlaying> pPlaying;
 	assertHrRetVal(CreateAudioEffectPlaying(_device, GUID_NULL, __uuidof(AudioEffectPlaying), (void**)&pPlaying), false);
 
-	XAUDIO2_SEND_DESCRIPTOR send;
-	send.Flags = 0;
-	send.pOutputVoice = _device->AsXAudioDevice()->GetVoice(ff::AudioVoiceType::EFFECTS);
+	if (_device->AsMixerAudioDevice())
+	{
+		ff::AudioMixerSource source;
+		assertRetVal(source.Init(bufferRes->GetFormat(), data->GetMem(), data->GetSize()), false);
+		source._playStart = _start;
+		source._playLength = _length;
+		source._loopStart = _loopStart;
+		source._loopLength = _loopLength;
+		source._loopCount = _loopCount;
+
+		size_t voice = _device->AsMixerAudioDevice()->PlayEffect(source, data, _volume * volume, _freqRatio * freqRatio, startPlaying);
+		noAssertRetVal(voice, false);
+
+		if (!pPlaying->Init(bufferRes, data, _device->AsMixerAudioDevice()->GetMixer(), voice, startPlaying))
+		{
+			pPlaying->Reset();
+			assertRetVal(false, false);
+		}
 
-	XAUDIO2_VOICE_SENDS sends;
-	sends.SendCount = 1;
-	sends.pSends = &send;
+		pPlaying->SetEffect(this);
+		_playing.Push(pPlaying);
 
-	assertHrRetVal(_device->AsXAudioDevice()->GetAudio()->CreateSourceVoice(
-		&source,
-		&bufferRes->GetFormat(),
-		0, // flags
-		XAUDIO2_DEFAULT_FREQ_RATIO,
-		pPlaying, // callback
-		&sends, // send list
-		nullptr), false); // effect chain
+		if (playing)
+		{
+			*playing = pPlaying.Detach();
+		}
+
+		return true;
+	}
+
+	// Voices come from the device's pool, so rapid-fire effects don't create one every time
+	ff::AudioVoicePool* pool = _device->AsXAudioDevice()->GetVoicePool();
+	ff::XAudioPoolVoice* voice = static_cast<ff::XAudioPoolVoice*>(pool->Acquire(bufferRes->GetFormat(), _priority, pPlaying));
+	noAssertRetVal(voice, false);
+
+	IXAudio2SourceVoice* source = voice->GetSource();
+	void* context = reinterpret_cast<void*>(++s_playContext);
 
 	XAUDIO2_BUFFER buffer;
 	buffer.Flags = XAUDIO2_END_OF_STREAM;
-	buffer.AudioBytes = (DWORD)bufferRes->GetData()->GetSize();
-	buffer.pAudioData = bufferRes->GetData()->GetMem();
+	buffer.AudioBytes = (DWORD)data->GetSize();
+	buffer.pAudioData = data->GetMem();
 	buffer.PlayBegin = (DWORD)_start;
 	buffer.PlayLength = (DWORD)_length;
 	buffer.LoopBegin = (DWORD)_loopStart;
 	buffer.LoopLength = (DWORD)_loopLength;
 	buffer.LoopCount = (_loopCount == ff::INVALID_SIZE) ? XAUDIO2_LOOP_INFINITE : (DWORD)_loopCount;
-	buffer.pContext = nullptr;
+	buffer.pContext = context;
+
+	if (!pPlaying->Init(bufferRes, data, voice, context, false) || FAILED(source->SubmitSourceBuffer(&buffer)))
+	{
+		pPlaying->Reset();
+		assertRetVal(false, false);
+	}
 
-	assertHrRetVal(source->SubmitSourceBuffer(&buffer), false);
 	source->SetVolume(_volume * volume);
 	source->SetFrequencyRatio(_freqRatio * freqRatio);
 
-	if (!pPlaying->Init(bufferRes, source, startPlaying))
+	if (startPlaying)
 	{
-		source->DestroyVoice();
-		assertRetVal(false, false);
+		pPlaying->Resume();
 	}
 
 	pPlaying->SetEffect(this);
@@ -305,6 +349,7 @@ bool AudioEffect::LoadFromCache(const ff::Dict& dict)
 	_loopCount = dict.Get<ff::SizeValue>(PROP_LOOP_COUNT);
 	_volume = dict.Get<ff::FloatValue>(PROP_VOLUME, 1.0f);
 	_freqRatio = dict.Get<ff::FloatValue>(PROP_FREQ, 1.0f);
+	_priority = dict.Get<ff::IntValue>(PROP_PRIORITY, 0);
 
 	return true;
 }
@@ -319,13 +364,17 @@ bool AudioEffect::SaveToCache(ff::Dict& dict)
 	dict.Set<ff::SizeValue>(PROP_LOOP_COUNT, _loopCount);
 	dict.Set<ff::FloatValue>(PROP_VOLUME, _volume);
 	dict.Set<ff::FloatValue>(PROP_FREQ, _freqRatio);
+	dict.Set<ff::IntValue>(PROP_PRIORITY, _priority);
 
 	return true;
 }
 
 AudioEffectPlaying::AudioEffectPlaying()
 	: _effect(nullptr)
+	, _voice(nullptr)
 	, _source(nullptr)
+	, _mixer(nullptr)
+	, _mixerVoice(0)
 	, _paused(true)
 	, _done(false)
 {
@@ -358,13 +407,19 @@ void AudioEffectPlaying::_DeleteThis()
 
 bool AudioEffectPlaying::Init(
 	ff::IAudioBuffer* pBuffer,
-	IXAudio2SourceVoice* source,
+	ff::IData* data,
+	ff::XAudioPoolVoice* voice,
+	void* context,
 	bool bStartPlaying)
 {
-	assertRetVal(pBuffer && source, false);
+	assertRetVal(pBuffer && data && voice && voice->GetSource(), false);
 
 	_buffer = pBuffer;
-	_source = source;
+	_data = data;
+	_voice = voice;
+	_source = voice->GetSource();
+	_voice->SetData(data);
+	_voice->SetCallback(this, context);
 
 	if (bStartPlaying)
 	{
@@ -374,6 +429,25 @@ bool AudioEffectPlaying::Init(
 	return true;
 }
 
+bool AudioEffectPlaying::Init(
+	ff::IAudioBuffer* pBuffer,
+	ff::IData* data,
+	ff::AudioMixer* mixer,
+	size_t mixerVoice,
+	bool bStartPlaying)
+{
+	assertRetVal(pBuffer && data && mixer && mixerVoice, false);
+
+	// The mixer already started the voice if needed
+	_buffer = pBuffer;
+	_data = data;
+	_mixer = mixer;
+	_mixerVoice = mixerVoice;
+	_paused = !bStartPlaying;
+
+	return true;
+}
+
 void AudioEffectPlaying::SetEffect(AudioEffect* pEffect)
 {
 	_effect = pEffect;
@@ -381,17 +455,17 @@ void AudioEffectPlaying::SetEffect(AudioEffect* pEffect)
 
 bool AudioEffectPlaying::IsPlaying() const
 {
-	return _source && !_paused && !_done;
+	return HasVoice() && !_paused && !_done;
 }
 
 bool AudioEffectPlaying::IsPaused() const
 {
-	return _source && _paused && !_done;
+	return HasVoice() && _paused && !_done;
 }
 
 bool AudioEffectPlaying::IsStopped() const
 {
-	return !_source || _done;
+	return !HasVoice() || _done;
 }
 
 bool AudioEffectPlaying::IsMusic() const
@@ -401,7 +475,12 @@ bool AudioEffectPlaying::IsMusic() const
 
 void AudioEffectPlaying::Advance()
 {
-	if (_done && _source)
+	if (_mixerVoice && !_done && _mixer->IsVoiceDone(_mixerVoice))
+	{
+		_done = true;
+	}
+
+	if (_done && (HasVoice() || _effect))
 	{
 		OnBufferEnd();
 	}
@@ -409,7 +488,11 @@ void AudioEffectPlaying::Advance()
 
 void AudioEffectPlaying::Stop()
 {
-	if (_source && !_done)
+	if (_mixerVoice && !_done)
+	{
+		_mixer->Stop(_mixerVoice);
+	}
+	else if (_source && !_done)
 	{
 		_source->Stop();
 		_source->FlushSourceBuffers();
@@ -418,7 +501,12 @@ void AudioEffectPlaying::Stop()
 
 void AudioEffectPlaying::Pause()
 {
-	if (_source && !_done)
+	if (_mixerVoice && !_done)
+	{
+		// Still playing when the mixer's command queue is full
+		_paused = _mixer->Pause(_mixerVoice);
+	}
+	else if (_source && !_done)
 	{
 		_source->Stop();
 		_paused = true;
@@ -429,8 +517,15 @@ void AudioEffectPlaying::Resume()
 {
 	if (IsPaused())
 	{
-		_source->Start();
-		_paused = false;
+		if (_mixerVoice)
+		{
+			_paused = !_mixer->Resume(_mixerVoice);
+		}
+		else
+		{
+			_source->Start();
+			_paused = false;
+		}
 	}
 }
 
@@ -476,13 +571,7 @@ ff::IAudioDevice* AudioEffectPlaying::GetDevice() const
 
 bool AudioEffectPlaying::Reset()
 {
-	if (_source)
-	{
-		IXAudio2SourceVoice* source = _source;
-		_source = nullptr;
-		source->DestroyVoice();
-	}
-
+	ReleaseVoice();
 	return true;
 }
 
@@ -519,13 +608,34 @@ void AudioEffectPlaying::OnBufferEnd()
 		_effect = nullptr;
 	}
 
-	if (_source)
+	ReleaseVoice();
+}
+
+void AudioEffectPlaying::ReleaseVoice()
+{
+	if (_mixerVoice)
 	{
-		::DestroyVoiceAsync(_device, _source);
+		// The mixer device keeps the buffer until the voice is really done
+		_mixer->Stop(_mixerVoice);
+		_mixer = nullptr;
+		_mixerVoice = 0;
+	}
+
+	if (_voice)
+	{
+		ff::XAudioPoolVoice* voice = _voice;
+		_voice = nullptr;
 		_source = nullptr;
+
+		_device->AsXAudioDevice()->GetVoicePool()->Release(voice);
 	}
 }
 
+bool AudioEffectPlaying::HasVoice() const
+{
+	return _source || _mixerVoice;
+}
+
 void AudioEffectPlaying::OnLoopEnd(void* pBufferContext)
 {
 }
@@ -534,3 +644,13 @@ void AudioEffectPlaying::OnVoiceError(void* pBufferContext, HRESULT error)
 {
 	assertSz(false, L"XAudio2 voice error");
 }
+
+void AudioEffectPlaying::OnVoiceStolen(ff::IAudioPoolVoice* voice)
+{
+	assert(voice == _voice);
+
+	// Advance will finish up on the game thread, without giving the voice back
+	_voice = nullptr;
+	_source = nullptr;
+	_done = true;
+}
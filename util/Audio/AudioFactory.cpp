@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Audio/AudioDevice.h"
 #include "Audio/AudioFactory.h"
+#include "Audio/AudioPcmCache.h"
 #include "COM/ComAlloc.h"
 #include "Globals/ProcessGlobals.h"
 
@@ -17,12 +18,15 @@ public:
 	virtual IXAudio2* GetAudio() override;
 
 	virtual ff::ComPtr<ff::IAudioDevice> CreateDevice() override;
+	virtual ff::ComPtr<ff::IAudioDevice> CreateMixerDevice(std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime) override;
 	virtual size_t GetDeviceCount() const override;
 	virtual ff::IAudioDevice* GetDevice(size_t nIndex) const override;
 
 	virtual void AddChild(ff::IAudioDevice* child) override;
 	virtual void RemoveChild(ff::IAudioDevice* child) override;
 
+	virtual ff::AudioPcmCache& GetPcmCache() override;
+
 	virtual ff::IXAudioFactory* AsXAudioFactory() override;
 
 private:
@@ -30,6 +34,7 @@ private:
 	ff::ComPtr<IXAudio2> _audio;
 	ff::Vector<ff::IAudioDevice*> _devices;
 	ff::IAudioDevice* _defaultDevice;
+	ff::AudioPcmCache _pcmCache;
 };
 
 BEGIN_INTERFACES(AudioFactory)
@@ -37,6 +42,7 @@ BEGIN_INTERFACES(AudioFactory)
 END_INTERFACES()
 
 bool CreateAudioDevice(ff::IAudioFactory* factory, ff::StringRef name, size_t channels, size_t sampleRate, ff::IAudioDevice** device);
+bool CreateMixerAudioDevice(ff::IAudioFactory* factory, std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime, ff::IAudioDevice** device);
 
 ff::ComPtr<ff::IAudioFactory> ff::CreateAudioFactory()
 {
@@ -93,6 +99,14 @@ ff::ComPtr<ff::IAudioDevice> AudioFactory::CreateDevice()
 	return pDevice;
 }
 
+ff::ComPtr<ff::IAudioDevice> AudioFactory::CreateMixerDevice(std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime)
+{
+	ff::ComPtr<ff::IAudioDevice> pDevice;
+	assertRetVal(::CreateMixerAudioDevice(this, sink, channels, sampleRate, realTime, &pDevice), false);
+
+	return pDevice;
+}
+
 size_t AudioFactory::GetDeviceCount() const
 {
 	return _devices.Size();
@@ -119,6 +133,11 @@ void AudioFactory::RemoveChild(ff::IAudioDevice* child)
 	verify(_devices.DeleteItem(child));
 }
 
+ff::AudioPcmCache& AudioFactory::GetPcmCache()
+{
+	return _pcmCache;
+}
+
 ff::IXAudioFactory* AudioFactory::AsXAudioFactory()
 {
 	return this;
@@ -2,7 +2,9 @@
 
 namespace ff
 {
+	class AudioPcmCache;
 	class IAudioDevice;
+	class IAudioMixerSink;
 	class IXAudioFactory;
 
 	class __declspec(uuid("90cc78de-7832-436f-8325-d3d2e2ee4330")) __declspec(novtable)
@@ -10,12 +12,15 @@ namespace ff
 	{
 	public:
 		virtual ComPtr<IAudioDevice> CreateDevice() = 0;
+		virtual ComPtr<IAudioDevice> CreateMixerDevice(std::shared_ptr<IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime) = 0;
 		virtual size_t GetDeviceCount() const = 0;
 		virtual IAudioDevice* GetDevice(size_t nIndex) const = 0;
 
 		virtual void AddChild(IAudioDevice* child) = 0;
 		virtual void RemoveChild(IAudioDevice* child) = 0;
 
+		virtual AudioPcmCache& GetPcmCache() = 0;
+
 		virtual IXAudioFactory* AsXAudioFactory() = 0;
 	};
 
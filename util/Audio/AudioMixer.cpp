@@ -0,0 +1,716 @@
+#include "pch.h"
+#include "Audio/AudioMixer.h"
+#include "Data/DataWriterReader.h"
+
+#ifdef _XM_SSE_INTRINSICS_
+#include <intrin.h>
+#endif
+
+static const size_t MAX_SOURCE_CHANNELS = 8;
+static const size_t VOICE_SLOT_BITS = 16;
+static const size_t VOICE_SLOT_MASK = (1 << VOICE_SLOT_BITS) - 1;
+static const float FRACTION_SCALE = 1.0f / 4294967296.0f;
+
+static float GetFraction(UINT64 pos)
+{
+	return (float)(UINT32)pos * FRACTION_SCALE;
+}
+
+#ifdef _XM_SSE_INTRINSICS_
+// SSE2 is always available, these handle the common mono and stereo cases two or four frames at a time
+
+static size_t ResampleMixStereoSse2(const float* source, UINT64& pos, UINT64 step, float* dest, size_t count, float& volume, float volumeStep)
+{
+	size_t i = 0;
+
+	for (; i + 2 <= count; i += 2, pos += step * 2, volume += volumeStep * 2)
+	{
+		UINT64 pos1 = pos + step;
+		__m128 v0 = _mm_loadu_ps(source + (pos >> 32) * 2);
+		__m128 v1 = _mm_loadu_ps(source + (pos1 >> 32) * 2);
+		__m128 a = _mm_movelh_ps(v0, v1);
+		__m128 b = _mm_movehl_ps(v1, v0);
+
+		float f0 = ::GetFraction(pos);
+		float f1 = ::GetFraction(pos1);
+		__m128 frac = _mm_setr_ps(f0, f0, f1, f1);
+		__m128 vol = _mm_setr_ps(volume, volume, volume + volumeStep, volume + volumeStep);
+
+		__m128 sample = _mm_mul_ps(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), frac)), vol);
+		_mm_storeu_ps(dest + i * 2, _mm_add_ps(_mm_loadu_ps(dest + i * 2), sample));
+	}
+
+	return i;
+}
+
+static size_t ResampleMixMonoSse2(const float* source, UINT64& pos, UINT64 step, float* dest, size_t destChannels, size_t count, float& volume, float volumeStep)
+{
+	const __m128 volumeSteps = _mm_setr_ps(0, volumeStep, volumeStep * 2, volumeStep * 3);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4, pos += step * 4, volume += volumeStep * 4)
+	{
+		UINT64 pos1 = pos + step;
+		UINT64 pos2 = pos1 + step;
+		UINT64 pos3 = pos2 + step;
+		const float* s0 = source + (pos >> 32);
+		const float* s1 = source + (pos1 >> 32);
+		const float* s2 = source + (pos2 >> 32);
+		const float* s3 = source + (pos3 >> 32);
+
+		__m128 a = _mm_setr_ps(s0[0], s1[0], s2[0], s3[0]);
+		__m128 b = _mm_setr_ps(s0[1], s1[1], s2[1], s3[1]);
+		__m128 frac = _mm_setr_ps(::GetFraction(pos), ::GetFraction(pos1), ::GetFraction(pos2), ::GetFraction(pos3));
+		__m128 vol = _mm_add_ps(_mm_set1_ps(volume), volumeSteps);
+		__m128 sample = _mm_mul_ps(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), frac)), vol);
+
+		if (destChannels == 1)
+		{
+			_mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), sample));
+		}
+		else
+		{
+			float* d = dest + i * 2;
+			_mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_unpacklo_ps(sample, sample)));
+			_mm_storeu_ps(d + 4, _mm_add_ps(_mm_loadu_ps(d + 4), _mm_unpackhi_ps(sample, sample)));
+		}
+	}
+
+	return i;
+}
+
+static size_t MixRowSse2(const float* source, float* dest, size_t count, float volume)
+{
+	const __m128 vol = _mm_set1_ps(volume);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(_mm_loadu_ps(source + i), vol)));
+	}
+
+	return i;
+}
+
+static size_t ConvertPcm16RowSse2(const INT16* source, float* dest, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+
+	return i;
+}
+#endif
+
+static void ConvertRow(const void* source, bool isFloat, float* dest, size_t count)
+{
+	if (isFloat)
+	{
+		std::memcpy(dest, source, count * sizeof(float));
+		return;
+	}
+
+	const INT16* source16 = reinterpret_cast<const INT16*>(source);
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	i = ::ConvertPcm16RowSse2(source16, dest, count);
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = source16[i] * (1.0f / 32768.0f);
+	}
+}
+
+void ff::ResampleMixRow(const float* source, size_t sourceChannels, UINT64 pos, UINT64 step,
+	float* dest, size_t destChannels, size_t count, float volume, float volumeStep)
+{
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	if (sourceChannels == 2 && destChannels == 2)
+	{
+		i = ::ResampleMixStereoSse2(source, pos, step, dest, count, volume, volumeStep);
+	}
+	else if (sourceChannels == 1 && destChannels <= 2)
+	{
+		i = ::ResampleMixMonoSse2(source, pos, step, dest, destChannels, count, volume, volumeStep);
+	}
+#endif
+
+	for (; i < count; i++, pos += step, volume += volumeStep)
+	{
+		const float* a = source + (pos >> 32) * sourceChannels;
+		const float* b = a + sourceChannels;
+		float frac = ::GetFraction(pos);
+		float* d = dest + i * destChannels;
+
+		if (sourceChannels == 2 && destChannels == 1)
+		{
+			float left = a[0] + (b[0] - a[0]) * frac;
+			float right = a[1] + (b[1] - a[1]) * frac;
+			d[0] += (left + right) * 0.5f * volume;
+			continue;
+		}
+
+		for (size_t c = 0; c < destChannels; c++)
+		{
+			size_t sc = c % sourceChannels;
+			d[c] += (a[sc] + (b[sc] - a[sc]) * frac) * volume;
+		}
+	}
+}
+
+void ff::MixRow(const float* source, float* dest, size_t channels, size_t count, float volume, float volumeStep)
+{
+	if (!volumeStep)
+	{
+		size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+		i = ::MixRowSse2(source, dest, count * channels, volume);
+#endif
+		for (; i < count * channels; i++)
+		{
+			dest[i] += source[i] * volume;
+		}
+
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++, volume += volumeStep)
+	{
+		for (size_t c = 0; c < channels; c++)
+		{
+			dest[i * channels + c] += source[i * channels + c] * volume;
+		}
+	}
+}
+
+ff::AudioMixerSource::AudioMixerSource()
+	: _data(nullptr)
+	, _frameCount(0)
+	, _channels(0)
+	, _sampleRate(0)
+	, _float(false)
+	, _playStart(0)
+	, _playLength(0)
+	, _loopStart(0)
+	, _loopLength(0)
+	, _loopCount(0)
+{
+}
+
+bool ff::AudioMixerSource::Init(const WAVEFORMATEX& format, const void* data, size_t byteSize)
+{
+	bool isFloat = (format.wFormatTag == WAVE_FORMAT_IEEE_FLOAT && format.wBitsPerSample == 32);
+	bool isPcm16 = (format.wFormatTag == WAVE_FORMAT_PCM && format.wBitsPerSample == 16);
+	noAssertRetVal(isFloat || isPcm16, false);
+	assertRetVal(data && format.nChannels && format.nChannels <= ::MAX_SOURCE_CHANNELS && format.nSamplesPerSec, false);
+
+	_data = data;
+	_channels = format.nChannels;
+	_sampleRate = format.nSamplesPerSec;
+	_float = isFloat;
+	_frameCount = byteSize / (_channels * (isFloat ? sizeof(float) : sizeof(INT16)));
+
+	return true;
+}
+
+ff::AudioNullSink::AudioNullSink(size_t channels)
+	: _channels(channels)
+	, _frameCount(0)
+	, _peak(0)
+{
+}
+
+size_t ff::AudioNullSink::GetFrameCount() const
+{
+	return _frameCount;
+}
+
+float ff::AudioNullSink::GetPeak() const
+{
+	return _peak;
+}
+
+bool ff::AudioNullSink::Write(const float* samples, size_t frameCount)
+{
+	for (size_t i = 0; i < frameCount * _channels; i++)
+	{
+		_peak = std::max(_peak, std::abs(samples[i]));
+	}
+
+	_frameCount += frameCount;
+	return true;
+}
+
+ff::AudioWavSink::AudioWavSink(IDataWriter* writer, size_t channels, size_t sampleRate)
+	: _writer(writer)
+	, _start(writer ? writer->GetPos() : 0)
+	, _channels(channels)
+	, _sampleRate(sampleRate)
+	, _dataBytes(0)
+{
+	verify(WriteHeader());
+}
+
+ff::AudioWavSink::~AudioWavSink()
+{
+	Finish();
+}
+
+bool ff::AudioWavSink::Finish()
+{
+	assertRetVal(_writer, false);
+
+	size_t pos = _writer->GetPos();
+	assertRetVal(_writer->SetPos(_start) && WriteHeader() && _writer->SetPos(pos), false);
+
+	return true;
+}
+
+bool ff::AudioWavSink::Write(const float* samples, size_t frameCount)
+{
+	assertRetVal(_writer, false);
+
+	size_t bytes = frameCount * _channels * sizeof(float);
+	assertRetVal(_writer->Write(samples, bytes), false);
+	_dataBytes += bytes;
+
+	return true;
+}
+
+bool ff::AudioWavSink::WriteHeader()
+{
+	assertRetVal(_writer, false);
+
+	WAVEFORMATEX format{};
+	format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	format.nChannels = (WORD)_channels;
+	format.nSamplesPerSec = (DWORD)_sampleRate;
+	format.wBitsPerSample = 32;
+	format.nBlockAlign = (WORD)(_channels * sizeof(float));
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+	const DWORD formatSize = sizeof(WAVEFORMATEX);
+	const DWORD factSize = sizeof(DWORD);
+	const DWORD frameCount = (DWORD)(_dataBytes / format.nBlockAlign);
+	const DWORD dataSize = (DWORD)_dataBytes;
+	const DWORD riffSize = 4 + (8 + formatSize) + (8 + factSize) + (8 + dataSize);
+
+	return
+		_writer->Write("RIFF", 4) && _writer->Write(&riffSize, 4) && _writer->Write("WAVE", 4) &&
+		_writer->Write("fmt ", 4) && _writer->Write(&formatSize, 4) && _writer->Write(&format, formatSize) &&
+		_writer->Write("fact", 4) && _writer->Write(&factSize, 4) && _writer->Write(&frameCount, 4) &&
+		_writer->Write("data", 4) && _writer->Write(&dataSize, 4);
+}
+
+void ff::AudioMixer::Ramp::Set(float value, size_t rampFrames)
+{
+	_target = value;
+	_framesLeft = rampFrames;
+
+	if (rampFrames)
+	{
+		_step = (value - _value) / rampFrames;
+	}
+	else
+	{
+		_value = value;
+		_step = 0;
+	}
+}
+
+size_t ff::AudioMixer::Ramp::GetFrames(size_t maxFrames) const
+{
+	return _framesLeft ? std::min(_framesLeft, maxFrames) : maxFrames;
+}
+
+void ff::AudioMixer::Ramp::Advance(size_t frames)
+{
+	if (_framesLeft)
+	{
+		assert(frames <= _framesLeft);
+		_framesLeft -= frames;
+		_value = _framesLeft ? _value + _step * frames : _target;
+		_step = _framesLeft ? _step : 0;
+	}
+}
+
+ff::AudioMixer::AudioMixer(size_t channels, size_t sampleRate, size_t maxVoices)
+	: _channels(channels)
+	, _sampleRate(sampleRate)
+	, _doneIds(new std::atomic<size_t>[maxVoices])
+	, _nextVoice(0)
+	, _nextGeneration(1)
+	, _commands(COMMAND_COUNT)
+{
+	assert(channels && sampleRate && maxVoices && maxVoices <= ::VOICE_SLOT_MASK);
+
+	_voiceIds.Resize(maxVoices);
+	_voices.Resize(maxVoices);
+	_scratch.Resize(SCRATCH_FRAMES * ::MAX_SOURCE_CHANNELS);
+	_output.Resize(BLOCK_FRAMES * channels);
+
+	for (size_t i = 0; i < maxVoices; i++)
+	{
+		_doneIds[i] = 0;
+		_voiceIds[i] = 0;
+		_voices[i]._id = 0;
+		_voices[i]._active = false;
+	}
+
+	for (size_t i = 0; i < _countof(_buses); i++)
+	{
+		_buses[i].Resize(BLOCK_FRAMES * channels);
+		_busRamps[i] = Ramp{ 1, 1, 0, 0 };
+		_busVolumes[i] = 1;
+	}
+}
+
+ff::AudioMixer::~AudioMixer()
+{
+}
+
+size_t ff::AudioMixer::GetChannels() const
+{
+	return _channels;
+}
+
+size_t ff::AudioMixer::GetSampleRate() const
+{
+	return _sampleRate;
+}
+
+size_t ff::AudioMixer::Play(const AudioMixerSource& source, AudioVoiceType bus, float volume, float freqRatio, bool startPlaying)
+{
+	assertRetVal(source._data && source._frameCount, 0);
+
+	for (size_t i = 0; i < _voiceIds.Size(); i++)
+	{
+		size_t slot = (_nextVoice + i) % _voiceIds.Size();
+		if (!_voiceIds[slot] || _doneIds[slot] == _voiceIds[slot])
+		{
+			// Generations wrap around, but zero is skipped so IDs are never zero
+			size_t generation = _nextGeneration++ & (SIZE_MAX >> ::VOICE_SLOT_BITS);
+			generation = generation ? generation : (_nextGeneration++ & (SIZE_MAX >> ::VOICE_SLOT_BITS));
+			size_t id = (generation << ::VOICE_SLOT_BITS) | slot;
+
+			Command command{};
+			command._type = CommandType::Play;
+			command._voice = id;
+			command._value = volume;
+			command._freqRatio = freqRatio;
+			command._source = source;
+			command._bus = bus;
+			command._startPlaying = startPlaying;
+			noAssertRetVal(_commands.Push(command), 0);
+
+			_voiceIds[slot] = id;
+			_nextVoice = slot + 1;
+
+			return id;
+		}
+	}
+
+	// Too many voices
+	return 0;
+}
+
+bool ff::AudioMixer::Stop(size_t voice)
+{
+	// Nothing to do for voices that are already done
+	noAssertRetVal(!IsVoiceDone(voice), true);
+
+	Command command{};
+	command._type = CommandType::Stop;
+	command._voice = voice;
+	return _commands.Push(command);
+}
+
+bool ff::AudioMixer::Pause(size_t voice)
+{
+	noAssertRetVal(!IsVoiceDone(voice), true);
+
+	Command command{};
+	command._type = CommandType::Pause;
+	command._voice = voice;
+	return _commands.Push(command);
+}
+
+bool ff::AudioMixer::Resume(size_t voice)
+{
+	noAssertRetVal(!IsVoiceDone(voice), true);
+
+	Command command{};
+	command._type = CommandType::Resume;
+	command._voice = voice;
+	return _commands.Push(command);
+}
+
+bool ff::AudioMixer::SetVolume(size_t voice, float volume, double rampSeconds)
+{
+	noAssertRetVal(!IsVoiceDone(voice), true);
+
+	Command command{};
+	command._type = CommandType::SetVolume;
+	command._voice = voice;
+	command._value = volume;
+	command._rampFrames = (size_t)(std::max(rampSeconds, 0.0) * _sampleRate);
+	return _commands.Push(command);
+}
+
+bool ff::AudioMixer::SetFreqRatio(size_t voice, float freqRatio)
+{
+	noAssertRetVal(!IsVoiceDone(voice), true);
+
+	Command command{};
+	command._type = CommandType::SetFreqRatio;
+	command._voice = voice;
+	command._freqRatio = freqRatio;
+	return _commands.Push(command);
+}
+
+bool ff::AudioMixer::IsVoiceDone(size_t voice) const
+{
+	size_t slot = voice & ::VOICE_SLOT_MASK;
+	return !voice || slot >= _voiceIds.Size() || _voiceIds[slot] != voice || _doneIds[slot] == voice;
+}
+
+float ff::AudioMixer::GetBusVolume(AudioVoiceType bus) const
+{
+	return _busVolumes[(size_t)bus];
+}
+
+bool ff::AudioMixer::SetBusVolume(AudioVoiceType bus, float volume, double rampSeconds)
+{
+	volume = std::max<float>(0, volume);
+	volume = std::min<float>(1, volume);
+
+	Command command{};
+	command._type = CommandType::SetBusVolume;
+	command._bus = bus;
+	command._value = volume;
+	command._rampFrames = (size_t)(std::max(rampSeconds, 0.0) * _sampleRate);
+	noAssertRetVal(_commands.Push(command), false);
+
+	_busVolumes[(size_t)bus] = volume;
+	return true;
+}
+
+void ff::AudioMixer::Render(float* output, size_t frameCount)
+{
+	RunCommands();
+
+	for (size_t done = 0; done < frameCount; )
+	{
+		size_t count = std::min(frameCount - done, BLOCK_FRAMES);
+		RenderBlock(output + done * _channels, count);
+		done += count;
+	}
+}
+
+bool ff::AudioMixer::Render(IAudioMixerSink* sink, size_t frameCount)
+{
+	assertRetVal(sink, false);
+	RunCommands();
+
+	for (size_t done = 0; done < frameCount; )
+	{
+		size_t count = std::min(frameCount - done, BLOCK_FRAMES);
+		RenderBlock(_output.Data(), count);
+		assertRetVal(sink->Write(_output.Data(), count), false);
+		done += count;
+	}
+
+	return true;
+}
+
+void ff::AudioMixer::RunCommands()
+{
+	for (Command command; _commands.Pop(command); )
+	{
+		RunCommand(command);
+	}
+}
+
+void ff::AudioMixer::RunCommand(const Command& command)
+{
+	if (command._type == CommandType::SetBusVolume)
+	{
+		_busRamps[(size_t)command._bus].Set(command._value, command._rampFrames);
+		return;
+	}
+
+	if (command._type == CommandType::Play)
+	{
+		Voice& voice = _voices[command._voice & ::VOICE_SLOT_MASK];
+		const AudioMixerSource& source = command._source;
+
+		voice._source = source;
+		voice._bus = command._bus;
+		voice._id = command._voice;
+		voice._pos = (UINT64)source._playStart << 32;
+		voice._loopsLeft = source._loopCount;
+		voice._volume = Ramp{ command._value, command._value, 0, 0 };
+		voice._active = true;
+		voice._paused = !command._startPlaying;
+		SetFreqRatio(voice, command._freqRatio);
+
+		if (source._playStart >= source._frameCount)
+		{
+			FinishVoice(voice);
+		}
+
+		return;
+	}
+
+	Voice* voice = GetVoice(command._voice);
+	noAssertRet(voice);
+
+	switch (command._type)
+	{
+	case CommandType::Stop:
+		FinishVoice(*voice);
+		break;
+
+	case CommandType::Pause:
+		voice->_paused = true;
+		break;
+
+	case CommandType::Resume:
+		voice->_paused = false;
+		break;
+
+	case CommandType::SetVolume:
+		voice->_volume.Set(command._value, command._rampFrames);
+		break;
+
+	case CommandType::SetFreqRatio:
+		SetFreqRatio(*voice, command._freqRatio);
+		break;
+	}
+}
+
+ff::AudioMixer::Voice* ff::AudioMixer::GetVoice(size_t id)
+{
+	Voice& voice = _voices[id & ::VOICE_SLOT_MASK];
+	return (voice._active && voice._id == id) ? &voice : nullptr;
+}
+
+void ff::AudioMixer::FinishVoice(Voice& voice)
+{
+	voice._active = false;
+	_doneIds[voice._id & ::VOICE_SLOT_MASK].store(voice._id, std::memory_order_release);
+}
+
+void ff::AudioMixer::SetFreqRatio(Voice& voice, float freqRatio)
+{
+	freqRatio = std::max(freqRatio, 1.0f / 1024.0f);
+	freqRatio = std::min(freqRatio, 1024.0f);
+
+	double step = (double)freqRatio * voice._source._sampleRate / _sampleRate * 4294967296.0;
+	voice._step = std::max<UINT64>((UINT64)step, 1);
+}
+
+void ff::AudioMixer::MixVoice(Voice& voice, size_t frameCount)
+{
+	const AudioMixerSource& source = voice._source;
+	const size_t playEnd = source._playLength ? std::min(source._playStart + source._playLength, source._frameCount) : source._frameCount;
+	const size_t loopEnd = source._loopLength ? std::min(source._loopStart + source._loopLength, playEnd) : playEnd;
+	float* dest = _buses[(size_t)voice._bus].Data();
+
+	for (size_t done = 0; done < frameCount && voice._active; )
+	{
+		bool looping = voice._loopsLeft && loopEnd > source._loopStart;
+		size_t regionEnd = looping ? loopEnd : playEnd;
+		size_t frame = (size_t)(voice._pos >> 32);
+
+		if (frame >= regionEnd)
+		{
+			if (!looping)
+			{
+				FinishVoice(voice);
+				break;
+			}
+
+			voice._pos -= (UINT64)(loopEnd - source._loopStart) << 32;
+			voice._loopsLeft -= (voice._loopsLeft != ff::INVALID_SIZE) ? 1 : 0;
+			continue;
+		}
+
+		// Stop at the end of the region, and convert no more source frames than fit in the scratch buffer
+		UINT64 left = ((UINT64)regionEnd << 32) - voice._pos;
+		size_t count = (size_t)std::min<UINT64>((left + voice._step - 1) / voice._step, frameCount - done);
+		count = (size_t)std::min<UINT64>(count, std::max<UINT64>(((UINT64)(SCRATCH_FRAMES - 3) << 32) / voice._step, 1));
+		count = voice._volume.GetFrames(count);
+
+		size_t lastFrame = (size_t)((voice._pos + (count - 1) * voice._step) >> 32);
+		ConvertSource(voice, frame, lastFrame - frame + 2, regionEnd, looping ? source._loopStart : regionEnd - 1);
+
+		ff::ResampleMixRow(_scratch.Data(), source._channels, (UINT32)voice._pos, voice._step,
+			dest + done * _channels, _channels, count, voice._volume._value, voice._volume._step);
+
+		voice._pos += count * voice._step;
+		voice._volume.Advance(count);
+		done += count;
+	}
+}
+
+void ff::AudioMixer::ConvertSource(const Voice& voice, size_t start, size_t count, size_t regionEnd, size_t wrapFrame)
+{
+	const AudioMixerSource& source = voice._source;
+	const size_t sampleSize = source._float ? sizeof(float) : sizeof(INT16);
+	const BYTE* data = reinterpret_cast<const BYTE*>(source._data);
+	size_t inside = std::min(count, regionEnd - start);
+
+	::ConvertRow(data + start * source._channels * sampleSize, source._float, _scratch.Data(), inside * source._channels);
+
+	// The frame after the end of the region, for interpolation
+	for (size_t i = inside; i < count; i++)
+	{
+		::ConvertRow(data + wrapFrame * source._channels * sampleSize, source._float, _scratch.Data() + i * source._channels, source._channels);
+	}
+}
+
+void ff::AudioMixer::MixBus(const float* source, float* dest, size_t frameCount, Ramp& ramp)
+{
+	for (size_t done = 0; done < frameCount; )
+	{
+		size_t count = ramp.GetFrames(frameCount - done);
+		ff::MixRow(source + done * _channels, dest + done * _channels, _channels, count, ramp._value, ramp._step);
+		ramp.Advance(count);
+		done += count;
+	}
+}
+
+void ff::AudioMixer::RenderBlock(float* output, size_t frameCount)
+{
+	for (ff::Vector<float>& bus : _buses)
+	{
+		std::memset(bus.Data(), 0, frameCount * _channels * sizeof(float));
+	}
+
+	for (Voice& voice : _voices)
+	{
+		if (voice._active && !voice._paused)
+		{
+			MixVoice(voice, frameCount);
+		}
+	}
+
+	float* master = _buses[(size_t)AudioVoiceType::MASTER].Data();
+	MixBus(_buses[(size_t)AudioVoiceType::EFFECTS].Data(), master, frameCount, _busRamps[(size_t)AudioVoiceType::EFFECTS]);
+	MixBus(_buses[(size_t)AudioVoiceType::MUSIC].Data(), master, frameCount, _busRamps[(size_t)AudioVoiceType::MUSIC]);
+
+	std::memset(output, 0, frameCount * _channels * sizeof(float));
+	MixBus(master, output, frameCount, _busRamps[(size_t)AudioVoiceType::MASTER]);
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "Audio/AudioDevice.h"
+#include "Types/SpscRing.h"
+
+namespace ff
+{
+	class IDataWriter;
+
+	// Wave data for a mixer voice, which must stay valid until the voice is done.
+	// Frame counts work like XAUDIO2_BUFFER: zero lengths mean "until the end", INVALID_SIZE loops forever.
+	struct AudioMixerSource
+	{
+		UTIL_API AudioMixerSource();
+		UTIL_API bool Init(const WAVEFORMATEX& format, const void* data, size_t byteSize);
+
+		const void* _data;
+		size_t _frameCount;
+		size_t _channels;
+		size_t _sampleRate;
+		bool _float; // otherwise 16-bit PCM
+		size_t _playStart;
+		size_t _playLength;
+		size_t _loopStart;
+		size_t _loopLength;
+		size_t _loopCount;
+	};
+
+	// Where the mixer sends interleaved float samples
+	class __declspec(novtable) IAudioMixerSink
+	{
+	public:
+		virtual bool Write(const float* samples, size_t frameCount) = 0;
+	};
+
+	// Throws samples away, but remembers how many there were and how loud they got
+	class AudioNullSink : public IAudioMixerSink
+	{
+	public:
+		UTIL_API AudioNullSink(size_t channels);
+
+		UTIL_API size_t GetFrameCount() const;
+		UTIL_API float GetPeak() const;
+
+		// IAudioMixerSink
+		virtual bool Write(const float* samples, size_t frameCount) override;
+
+	private:
+		size_t _channels;
+		std::atomic<size_t> _frameCount;
+		float _peak;
+	};
+
+	// Writes a 32-bit float WAV file, the header sizes are fixed by Finish
+	class AudioWavSink : public IAudioMixerSink
+	{
+	public:
+		UTIL_API AudioWavSink(IDataWriter* writer, size_t channels, size_t sampleRate);
+		UTIL_API ~AudioWavSink();
+
+		UTIL_API bool Finish();
+
+		// IAudioMixerSink
+		virtual bool Write(const float* samples, size_t frameCount) override;
+
+	private:
+		bool WriteHeader();
+
+		ComPtr<IDataWriter> _writer;
+		size_t _start;
+		size_t _channels;
+		size_t _sampleRate;
+		size_t _dataBytes;
+	};
+
+	// Mixes voices into float32 buses on the CPU, for running without an audio device and offline rendering.
+	// The control functions are only called by one thread (the game thread) and they never block, they
+	// send commands to Render through a lock-free queue. Render is only called by one thread too.
+	// When the queue is full the control functions return false (Play returns zero) and nothing changes,
+	// so Render or RunCommands must be called often enough to keep up.
+	class AudioMixer
+	{
+	public:
+		UTIL_API AudioMixer(size_t channels, size_t sampleRate, size_t maxVoices = 256);
+		UTIL_API ~AudioMixer();
+
+		UTIL_API size_t GetChannels() const;
+		UTIL_API size_t GetSampleRate() const;
+
+		// Control, voice IDs are never zero
+		UTIL_API size_t Play(const AudioMixerSource& source, AudioVoiceType bus, float volume, float freqRatio, bool startPlaying = true);
+		UTIL_API bool Stop(size_t voice);
+		UTIL_API bool Pause(size_t voice);
+		UTIL_API bool Resume(size_t voice);
+		UTIL_API bool SetVolume(size_t voice, float volume, double rampSeconds = 0);
+		UTIL_API bool SetFreqRatio(size_t voice, float freqRatio);
+		UTIL_API bool IsVoiceDone(size_t voice) const;
+		UTIL_API float GetBusVolume(AudioVoiceType bus) const;
+		UTIL_API bool SetBusVolume(AudioVoiceType bus, float volume, double rampSeconds = 0);
+
+		// Mixing, Render runs queued commands first. RunCommands is for when nothing is rendered for a while.
+		UTIL_API void Render(float* output, size_t frameCount);
+		UTIL_API bool Render(IAudioMixerSink* sink, size_t frameCount);
+		UTIL_API void RunCommands();
+
+	private:
+		enum class CommandType
+		{
+			Play,
+			Stop,
+			Pause,
+			Resume,
+			SetVolume,
+			SetFreqRatio,
+			SetBusVolume,
+		};
+
+		struct Command
+		{
+			CommandType _type;
+			size_t _voice;
+			float _value;
+			float _freqRatio;
+			size_t _rampFrames;
+			AudioMixerSource _source;
+			AudioVoiceType _bus;
+			bool _startPlaying;
+		};
+
+		struct Ramp
+		{
+			void Set(float value, size_t rampFrames);
+			size_t GetFrames(size_t maxFrames) const;
+			void Advance(size_t frames);
+
+			float _value;
+			float _target;
+			float _step;
+			size_t _framesLeft;
+		};
+
+		struct Voice
+		{
+			AudioMixerSource _source;
+			AudioVoiceType _bus;
+			size_t _id;
+			UINT64 _pos; // 32.32 fixed point source frame
+			UINT64 _step;
+			size_t _loopsLeft;
+			Ramp _volume;
+			bool _active;
+			bool _paused;
+		};
+
+		void RunCommand(const Command& command);
+		Voice* GetVoice(size_t id);
+		void FinishVoice(Voice& voice);
+		void SetFreqRatio(Voice& voice, float freqRatio);
+		void MixVoice(Voice& voice, size_t frameCount);
+		void ConvertSource(const Voice& voice, size_t start, size_t count, size_t regionEnd, size_t wrapFrame);
+		void MixBus(const float* source, float* dest, size_t frameCount, Ramp& ramp);
+		void RenderBlock(float* output, size_t frameCount);
+
+		static const size_t BLOCK_FRAMES = 512;
+		static const size_t SCRATCH_FRAMES = 4096;
+		static const size_t COMMAND_COUNT = 1024;
+
+		size_t _channels;
+		size_t _sampleRate;
+
+		// Control thread
+		std::unique_ptr<std::atomic<size_t>[]> _doneIds;
+		ff::Vector<size_t> _voiceIds;
+		size_t _nextVoice;
+		size_t _nextGeneration;
+		float _busVolumes[3];
+
+		// Command queue
+		ff::SpscRing<Command> _commands;
+
+		// Render thread
+		ff::Vector<Voice> _voices;
+		ff::Vector<float> _buses[3];
+		ff::Vector<float> _scratch;
+		ff::Vector<float> _output;
+		Ramp _busRamps[3];
+	};
+
+	// Kernels, exposed for testing. Sources are interleaved with one extra frame at the end for interpolation.
+	// Positions are 32.32 fixed point, and the volume changes by volumeStep after each frame.
+	UTIL_API void ResampleMixRow(const float* source, size_t sourceChannels, UINT64 pos, UINT64 step,
+		float* dest, size_t destChannels, size_t count, float volume, float volumeStep);
+	UTIL_API void MixRow(const float* source, float* dest, size_t channels, size_t count, float volume, float volumeStep);
+}
@@ -1,12 +1,14 @@
 #include "pch.h"
+#include "Audio/AudioDecoder.h"
 #include "Audio/AudioDevice.h"
 #include "Audio/AudioEffect.h"
+#include "Audio/AudioMusicStream.h"
 #include "Audio/AudioPlaying.h"
 #include "Audio/AudioStream.h"
 #include "Data/DataPersist.h"
 #include "Data/DataWriterReader.h"
-#include "Data/Stream.h"
 #include "Dict/Dict.h"
+#include "Globals/Log.h"
 #include "Globals/ProcessGlobals.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
@@ -21,7 +23,6 @@
 #define DEBUG_THIS_FILE 0 // DEBUG
 
 class AudioMusicPlaying;
-class AudioSourceReaderCallback;
 
 static ff::StaticString PROP_MP3(L"mp3");
 static ff::StaticString PROP_VOLUME(L"volume");
@@ -76,7 +77,6 @@ class __declspec(uuid("4900158e-fcdd-4179-b85e-63aa12f6ee1f"))
 	: public ff::ComBase
 	, public ff::IAudioPlaying
 	, public IXAudio2VoiceCallback
-	, public IMFSourceReaderCallback
 {
 public:
 	DECLARE_HEADER(AudioMusicPlaying);
@@ -129,38 +129,26 @@ public:
 	COM_FUNC_VOID OnLoopEnd(void* pBufferContext) override;
 	COM_FUNC_VOID OnVoiceError(void* pBufferContext, HRESULT error) override;
 
-	// IMFSourceReaderCallback
-	COM_FUNC OnReadSample(HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags, LONGLONG llTimestamp, IMFSample* pSample) override;
-	COM_FUNC OnFlush(DWORD dwStreamIndex) override;
-	COM_FUNC OnEvent(DWORD dwStreamIndex, IMFMediaEvent* pEvent) override;
-
 private:
 	bool AsyncInit();
 	void StartAsyncWork();
 	void RunAsyncWork();
 	void CancelAsync();
-	void StartReadSample();
+	void SubmitBuffers();
 	void OnMusicDone();
 	void UpdateSourceVolume(IXAudio2SourceVoice* source);
 
-	static const size_t MAX_BUFFERS = 2;
+	// Decoding runs ahead on its own thread, XAudio2 only gets a few small buffers at a time
+	static const size_t SUBMIT_BUFFERS = 3;
+	static constexpr double SUBMIT_SECONDS = 0.02;
+	static constexpr double DECODE_AHEAD_SECONDS = 0.5;
 
-	struct BufferInfo
+	struct SubmitBuffer
 	{
-		ff::Vector<BYTE> _buffer;
-		LONGLONG _startTime;
-		LONGLONG _duration;
+		ff::Vector<float> _samples;
+		size_t _startFrame;
 		UINT64 _startSamples;
-		DWORD _streamIndex;
-		DWORD _streamFlags;
-	};
-
-	enum class MediaState
-	{
-		None,
-		Reading,
-		Flushing,
-		Done,
+		bool _queued;
 	};
 
 	ff::Mutex _mutex;
@@ -169,12 +157,11 @@ private:
 	LONGLONG _desiredPosition;
 	ff::WinHandle _asyncEvent; // set when there is no async action running
 	ff::WinHandle _stopEvent; // set when everything should stop
-	ff::List<BufferInfo> _bufferInfos;
+	SubmitBuffer _submitBuffers[SUBMIT_BUFFERS];
 
 	ff::ComPtr<ff::IAudioDevice> _device;
 	ff::ComPtr<ff::IAudioStream> _stream;
-	ff::ComPtr<IMFSourceReader> _mediaReader;
-	ff::ComPtr<AudioSourceReaderCallback, IMFSourceReaderCallback> _mediaCallback;
+	std::shared_ptr<ff::AudioMusicStream> _musicStream;
 	IXAudio2SourceVoice* _source;
 	AudioMusic* _parent;
 
@@ -186,28 +173,10 @@ private:
 	ff::Timer _fadeTimer;
 	bool _loop;
 	bool _startPlaying;
-	MediaState _mediaState;
-};
-
-class __declspec(uuid("4d0dc5e5-d387-48a1-8f97-8002bc1adf90"))
-	AudioSourceReaderCallback : public ff::ComBase, public IMFSourceReaderCallback
-{
-public:
-	DECLARE_HEADER(AudioSourceReaderCallback);
-
-	void SetParent(AudioMusicPlaying* parent);
-
-	// IMFSourceReaderCallback
-	COM_FUNC OnReadSample(HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags, LONGLONG llTimestamp, IMFSample* pSample) override;
-	COM_FUNC OnFlush(DWORD dwStreamIndex) override;
-	COM_FUNC OnEvent(DWORD dwStreamIndex, IMFMediaEvent* pEvent) override;
-
-private:
-	ff::Mutex _mutex;
-	AudioMusicPlaying* _parent;
+	bool _seeking; // the game thread is seeking the stream without holding the lock, so nothing else can read it
 };
 
-void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source);
+void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source, std::function<void()>&& onDestroyed = nullptr);
 
 BEGIN_INTERFACES(AudioMusic)
 	HAS_INTERFACE(ff::IAudioEffect)
@@ -216,11 +185,6 @@ END_INTERFACES()
 
 BEGIN_INTERFACES(AudioMusicPlaying)
 	HAS_INTERFACE(ff::IAudioPlaying)
-	HAS_INTERFACE(IMFSourceReaderCallback)
-END_INTERFACES()
-
-BEGIN_INTERFACES(AudioSourceReaderCallback)
-	HAS_INTERFACE(IMFSourceReaderCallback)
 END_INTERFACES()
 
 static ff::ModuleStartup Register([](ff::Module& module)
@@ -265,7 +229,7 @@ void AudioMusic::OnMusicDone(AudioMusicPlaying* playing)
 
 bool AudioMusic::Play(bool startPlaying, float volume, float freqRatio, ff::IAudioPlaying** obj)
 {
-	noAssertRetVal(_device->IsValid() && _streamRes.GetObject(), false);
+	noAssertRetVal(_device->IsValid() && _device->AsXAudioDevice() && _streamRes.GetObject(), false);
 
 	ff::ComPtr<AudioMusicPlaying, ff::IAudioPlaying> playing;
 	assertHrRetVal(ff::ComAllocator<AudioMusicPlaying>::CreateInstance(_device, &playing), false);
@@ -351,13 +315,17 @@ AudioMusicPlaying::AudioMusicPlaying()
 	, _fadeScale(0)
 	, _loop(false)
 	, _startPlaying(false)
-	, _mediaState(MediaState::None)
+	, _seeking(false)
 {
 	_asyncEvent = ff::CreateEvent(true);
 	_stopEvent = ff::CreateEvent();
 
-	_mediaCallback = new ff::ComObject<AudioSourceReaderCallback>();
-	_mediaCallback->SetParent(this);
+	for (SubmitBuffer& buffer : _submitBuffers)
+	{
+		buffer._startFrame = 0;
+		buffer._startSamples = (UINT64)-1;
+		buffer._queued = false;
+	}
 }
 
 AudioMusicPlaying::~AudioMusicPlaying()
@@ -382,11 +350,6 @@ void AudioMusicPlaying::_Destruct()
 {
 	Reset();
 
-	if (_mediaCallback)
-	{
-		_mediaCallback->SetParent(nullptr);
-	}
-
 	ff::ComBase::_Destruct();
 }
 
@@ -399,7 +362,7 @@ bool AudioMusicPlaying::Init(AudioMusic* parent, ff::IAudioStream* stream, bool
 {
 	assert(ff::GetGameThreadDispatch()->IsCurrentThread());
 	assertRetVal(_state == State::MUSIC_INVALID, false);
-	assertRetVal(stream && _device && _device->AsXAudioDevice()->GetAudio(), false);
+	assertRetVal(stream && _device && _device->AsXAudioDevice() && _device->AsXAudioDevice()->GetAudio(), false);
 
 	_state = State::MUSIC_INIT;
 	_parent = parent;
@@ -424,56 +387,30 @@ void AudioMusicPlaying::RunAsyncWork()
 		verify(AsyncInit());
 	}
 
-	StartReadSample();
-
 	::SetEvent(_asyncEvent);
 }
 
 bool AudioMusicPlaying::AsyncInit()
 {
-	assertRetVal(_stream && _mediaCallback && !_source && !_mediaReader, false);
-
-	ff::ComPtr<ff::IDataReader> reader;
-	assertRetVal(_stream->CreateReader(&reader), false);
+	assertRetVal(_stream && !_source && !_musicStream, false);
 
-	ff::ComPtr<IMFByteStream> mediaByteStream;
-	assertRetVal(ff::CreateReadStream(reader, _stream->GetMimeType(), &mediaByteStream), false);
+	std::unique_ptr<ff::IAudioDecoder> decoder = ff::CreateAudioDecoder(_stream);
+	assertRetVal(decoder, false);
 
-	ff::ComPtr<IMFSourceResolver> sourceResolver;
-	assertHrRetVal(::MFCreateSourceResolver(&sourceResolver), false);
+	const size_t channels = decoder->GetChannels();
+	const size_t sampleRate = decoder->GetSampleRate();
+	const size_t frameCount = decoder->GetFrameCount();
 
-	ff::ComPtr<IUnknown> mediaSourceUnknown;
-	MF_OBJECT_TYPE mediaSourceObjectType = MF_OBJECT_MEDIASOURCE;
-	DWORD mediaSourceFlags = MF_RESOLUTION_MEDIASOURCE | MF_RESOLUTION_READ | MF_RESOLUTION_DISABLE_LOCAL_PLUGINS;
-	assertHrRetVal(sourceResolver->CreateObjectFromByteStream(mediaByteStream, nullptr, mediaSourceFlags, nullptr, &mediaSourceObjectType, &mediaSourceUnknown), false);
+	WAVEFORMATEX waveFormat{};
+	waveFormat.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	waveFormat.nChannels = (WORD)channels;
+	waveFormat.nSamplesPerSec = (DWORD)sampleRate;
+	waveFormat.wBitsPerSample = 32;
+	waveFormat.nBlockAlign = (WORD)(channels * sizeof(float));
+	waveFormat.nAvgBytesPerSec = waveFormat.nSamplesPerSec * waveFormat.nBlockAlign;
 
-	ff::ComPtr<IMFMediaSource> mediaSource;
-	assertRetVal(mediaSource.QueryFrom(mediaSourceUnknown), false);
-
-	ff::ComPtr<IMFAttributes> mediaAttributes;
-	assertHrRetVal(::MFCreateAttributes(&mediaAttributes, 1), false);
-	assertHrRetVal(mediaAttributes->SetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, _mediaCallback.Interface()), false);
-
-	ff::ComPtr<IMFSourceReader> mediaReader;
-	assertHrRetVal(::MFCreateSourceReaderFromMediaSource(mediaSource, mediaAttributes, &mediaReader), false);
-	assertHrRetVal(mediaReader->SetStreamSelection(MF_SOURCE_READER_ALL_STREAMS, false), false);
-	assertHrRetVal(mediaReader->SetStreamSelection(MF_SOURCE_READER_FIRST_AUDIO_STREAM, true), false);
-
-	ff::ComPtr<IMFMediaType> mediaType;
-	assertHrRetVal(::MFCreateMediaType(&mediaType), false);
-	assertHrRetVal(mediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio), false);
-	assertHrRetVal(mediaType->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_Float), false);
-	assertHrRetVal(mediaReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, nullptr, mediaType), false);
-
-	ff::ComPtr<IMFMediaType> actualMediaType;
-	assertHrRetVal(mediaReader->GetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, &actualMediaType), false);
-
-	WAVEFORMATEX* waveFormat = nullptr;
-	UINT waveFormatLength = 0;
-	assertHrRetVal(::MFCreateWaveFormatExFromMFMediaType(actualMediaType, &waveFormat, &waveFormatLength), false);
-
-	PROPVARIANT durationValue;
-	assertHrRetVal(mediaReader->GetPresentationAttribute(MF_SOURCE_READER_MEDIASOURCE, MF_PD_DURATION, &durationValue), false);
+	std::shared_ptr<ff::AudioMusicStream> musicStream = std::make_shared<ff::AudioMusicStream>(std::move(decoder), DECODE_AHEAD_SECONDS);
+	musicStream->SetLoop(_loop);
 
 	XAUDIO2_SEND_DESCRIPTOR sendDesc{ 0 };
 	sendDesc.pOutputVoice = _device->AsXAudioDevice()->GetVoice(ff::AudioVoiceType::MUSIC);
@@ -485,15 +422,12 @@ bool AudioMusicPlaying::AsyncInit()
 	IXAudio2SourceVoice* source = nullptr;
 	HRESULT hr = _device->AsXAudioDevice()->GetAudio()->CreateSourceVoice(
 		&source,
-		waveFormat,
+		&waveFormat,
 		0, // flags
 		XAUDIO2_DEFAULT_FREQ_RATIO,
 		this, // callback,
 		&sends);
 
-	::CoTaskMemFree(waveFormat);
-	waveFormat = nullptr;
-
 	if (FAILED(hr))
 	{
 		if (source)
@@ -506,26 +440,39 @@ bool AudioMusicPlaying::AsyncInit()
 
 	ff::LockMutex lock(_mutex);
 
-	_duration = (LONGLONG)durationValue.uhVal.QuadPart;
+	_duration = (LONGLONG)((UINT64)frameCount * 10000000 / sampleRate);
 
-	if (_desiredPosition >= 0 && _desiredPosition <= _duration)
+	if (_state == State::MUSIC_INIT)
 	{
-		PROPVARIANT value;
-		::PropVariantInit(&value);
+		size_t submitFrames = (size_t)(SUBMIT_SECONDS * sampleRate);
+		for (SubmitBuffer& buffer : _submitBuffers)
+		{
+			buffer._samples.Resize(submitFrames * channels);
+		}
 
-		value.vt = VT_I8;
-		value.hVal.QuadPart = _desiredPosition;
-		verifyHr(mediaReader->SetCurrentPosition(GUID_NULL, value));
+		if (_desiredPosition > 0 && _desiredPosition <= _duration)
+		{
+			verify(musicStream->Seek((size_t)(_desiredPosition * sampleRate / 10000000)));
+		}
 
-		::PropVariantClear(&value);
-	}
+		// Enough is decoded right away to fill the first buffers
+		musicStream->Start(submitFrames * SUBMIT_BUFFERS);
 
-	if (_state == State::MUSIC_INIT)
-	{
 		UpdateSourceVolume(source);
 		source->SetFrequencyRatio(_freqRatio);
 		_source = source;
-		_mediaReader = mediaReader;
+		_musicStream = musicStream;
+
+		SubmitBuffers();
+
+		_state = State::MUSIC_PAUSED;
+
+		if (_startPlaying)
+		{
+			_startPlaying = false;
+			_source->Start();
+			_state = State::MUSIC_PLAYING;
+		}
 	}
 	else
 	{
@@ -698,13 +645,11 @@ double AudioMusicPlaying::GetPosition() const
 		XAUDIO2_VOICE_DETAILS details;
 		_source->GetVoiceDetails(&details);
 
-		BufferInfo* info = (BufferInfo*)state.pCurrentBufferContext;
-		if (info && info->_startSamples != (UINT64)-1)
+		const SubmitBuffer* buffer = (const SubmitBuffer*)state.pCurrentBufferContext;
+		if (buffer && buffer->_startSamples != (UINT64)-1)
 		{
-			double sampleSeconds = (state.SamplesPlayed > info->_startSamples)
-				? (state.SamplesPlayed - info->_startSamples) / (double)details.InputSampleRate
-				: 0.0;
-			pos = sampleSeconds + (info->_startTime / 10000000.0);
+			UINT64 frame = buffer->_startFrame + ((state.SamplesPlayed > buffer->_startSamples) ? state.SamplesPlayed - buffer->_startSamples : 0);
+			pos = frame / (double)details.InputSampleRate;
 		}
 		else
 		{
@@ -724,23 +669,40 @@ double AudioMusicPlaying::GetPosition() const
 
 bool AudioMusicPlaying::SetPosition(double value)
 {
+	assert(ff::GetGameThreadDispatch()->IsCurrentThread());
+
 	ff::LockMutex lock(_mutex);
 
-	assertRetVal(_state != State::MUSIC_DONE, false);
+	assertRetVal(_state != State::MUSIC_DONE && !_seeking, false);
 
 	_desiredPosition = (LONGLONG)(value * 10000000.0);
 
-	if (_mediaReader && _mediaState != MediaState::Flushing)
-	{
-		_mediaState = MediaState::Flushing;
+	// Before init is done, the init will seek
+	noAssertRetVal(_musicStream && _source && _desiredPosition >= 0 && _desiredPosition <= _duration, true);
 
-		if (FAILED(_mediaReader->Flush(MF_SOURCE_READER_FIRST_AUDIO_STREAM)))
-		{
-			_mediaState = MediaState::None;
-			assertRetVal(false, false);
-		}
+	// Seeking stops the decoding thread and decodes the first buffers again, the XAudio2 callbacks
+	// can't wait for that. They don't touch the stream until the seek is done.
+	_seeking = true;
+	std::shared_ptr<ff::AudioMusicStream> musicStream = _musicStream;
+	IXAudio2SourceVoice* source = _source;
+	size_t frame = (size_t)(_desiredPosition * musicStream->GetSampleRate() / 10000000);
+	size_t prefillFrames = _submitBuffers[0]._samples.Size() / musicStream->GetChannels() * SUBMIT_BUFFERS;
+	lock.Unlock();
+
+	// Buffers that XAudio2 already has are thrown away, only the game thread changes the source
+	source->Stop();
+	source->FlushSourceBuffers();
+	bool seeked = musicStream->Seek(frame, prefillFrames);
+
+	ff::LockMutex seekLock(_mutex);
+	_seeking = false;
+
+	if (_state == State::MUSIC_PLAYING)
+	{
+		_source->Start();
 	}
 
+	assertRetVal(seeked, false);
 	return true;
 }
 
@@ -802,6 +764,12 @@ bool AudioMusicPlaying::Reset()
 		source->DestroyVoice();
 	}
 
+	if (_musicStream)
+	{
+		_musicStream->Stop();
+		_musicStream = nullptr;
+	}
+
 	_state = State::MUSIC_DONE;
 	return true;
 }
@@ -809,6 +777,8 @@ bool AudioMusicPlaying::Reset()
 void AudioMusicPlaying::OnVoiceProcessingPassStart(UINT32 BytesRequired)
 {
 	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
+
+	SubmitBuffers();
 }
 
 void AudioMusicPlaying::OnVoiceProcessingPassEnd()
@@ -819,11 +789,6 @@ void AudioMusicPlaying::OnVoiceProcessingPassEnd()
 void AudioMusicPlaying::OnStreamEnd()
 {
 	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-
-	ff::LockMutex lock(_mutex);
-	_state = State::MUSIC_DONE;
-
-	// Loop?
 }
 
 void AudioMusicPlaying::OnBufferStart(void* pBufferContext)
@@ -832,174 +797,50 @@ void AudioMusicPlaying::OnBufferStart(void* pBufferContext)
 
 	ff::LockMutex lock(_mutex);
 
-	if (_bufferInfos.Size() == MAX_BUFFERS)
-	{
-		// Reuse buffers
-		assert(_bufferInfos.GetLast() == pBufferContext);
-		_bufferInfos.MoveToBack(*_bufferInfos.GetFirst());
-	}
-
-	if (!_bufferInfos.IsEmpty())
+	if (_source)
 	{
 		XAUDIO2_VOICE_STATE state;
 		_source->GetState(&state);
 
-		BufferInfo* info = _bufferInfos.GetFirst();
-		assert(state.pCurrentBufferContext == info);
-		info->_startSamples = state.SamplesPlayed;
+		SubmitBuffer* buffer = (SubmitBuffer*)pBufferContext;
+		buffer->_startSamples = state.SamplesPlayed;
 	}
-
-	StartReadSample();
 }
 
 void AudioMusicPlaying::OnBufferEnd(void* pBufferContext)
-{
-	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-}
-
-void AudioMusicPlaying::OnLoopEnd(void* pBufferContext)
-{
-	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-}
-
-void AudioMusicPlaying::OnVoiceError(void* pBufferContext, HRESULT error)
-{
-	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-
-	assertSz(false, L"XAudio2 voice error");
-}
-
-HRESULT AudioMusicPlaying::OnReadSample(
-	HRESULT hrStatus,
-	DWORD dwStreamIndex,
-	DWORD dwStreamFlags,
-	LONGLONG llTimestamp,
-	IMFSample* pSample)
 {
 	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
 
 	ff::LockMutex lock(_mutex);
 
-	noAssertRetVal(_mediaState == MediaState::Reading, S_OK);
-	bool endOfStream = (dwStreamFlags & MF_SOURCE_READERF_ENDOFSTREAM) != 0;
-	_mediaState = endOfStream ? MediaState::Done : MediaState::None;
+	SubmitBuffer* buffer = (SubmitBuffer*)pBufferContext;
+	buffer->_queued = false;
 
-	if (_source && _state != State::MUSIC_DONE)
+	if (_state == State::MUSIC_PLAYING && _musicStream && !_seeking && _musicStream->IsDone())
 	{
-		ff::ComPtr<IMFMediaBuffer> mediaBuffer;
-		BufferInfo* bufferInfo = nullptr;
-		BYTE* data = nullptr;
-		DWORD dataSize = 0;
-
-		if (pSample && SUCCEEDED(hrStatus) &&
-			SUCCEEDED(pSample->ConvertToContiguousBuffer(&mediaBuffer)) &&
-			SUCCEEDED(mediaBuffer->Lock(&data, nullptr, &dataSize)))
+		bool queued = false;
+		for (const SubmitBuffer& buffer : _submitBuffers)
 		{
-			if (_bufferInfos.Size() < MAX_BUFFERS)
-			{
-				_bufferInfos.Push(BufferInfo());
-			}
-
-			bufferInfo = _bufferInfos.GetLast();
-			bufferInfo->_buffer.Resize(dataSize);
-			bufferInfo->_startTime = llTimestamp;
-			bufferInfo->_startSamples = (UINT64)-1;
-			bufferInfo->_streamIndex = dwStreamIndex;
-			bufferInfo->_streamFlags = dwStreamFlags;
-
-			if (FAILED(pSample->GetSampleDuration(&bufferInfo->_duration)))
-			{
-				bufferInfo->_duration = 0;
-			}
-
-			std::memcpy(bufferInfo->_buffer.Data(), data, dataSize);
-
-			mediaBuffer->Unlock();
+			queued = queued || buffer._queued;
 		}
 
-		if (bufferInfo)
-		{
-			XAUDIO2_BUFFER buffer;
-			ff::ZeroObject(buffer);
-			buffer.AudioBytes = (UINT)bufferInfo->_buffer.Size();
-			buffer.pAudioData = bufferInfo->_buffer.Data();
-			buffer.pContext = bufferInfo;
-			buffer.Flags = endOfStream ? XAUDIO2_END_OF_STREAM : 0;
-			verifyHr(_source->SubmitSourceBuffer(&buffer));
-#if DEBUG_THIS_FILE
-			ff::Log::DebugTraceF(L"AudioMusicPlaying::OnReadSample, Size:%lu, Time:%lu-%lu\n",
-				bufferInfo->_buffer.Size(),
-				llTimestamp,
-				llTimestamp + bufferInfo->_duration);
-#endif
-			if (_state == State::MUSIC_INIT)
-			{
-				_state = State::MUSIC_PAUSED;
-
-				if (_startPlaying)
-				{
-					_startPlaying = false;
-					_source->Start();
-					_state = State::MUSIC_PLAYING;
-				}
-			}
-		}
-		else if (_state == State::MUSIC_INIT)
+		if (!queued)
 		{
 			_state = State::MUSIC_DONE;
 		}
-		else
-		{
-			_source->Discontinuity();
-		}
 	}
-
-	return S_OK;
 }
 
-HRESULT AudioMusicPlaying::OnFlush(DWORD dwStreamIndex)
+void AudioMusicPlaying::OnLoopEnd(void* pBufferContext)
 {
 	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-
-	ff::LockMutex lock(_mutex);
-
-	assert(_mediaState == MediaState::Flushing);
-	_mediaState = MediaState::None;
-
-#if DEBUG_THIS_FILE
-	ff::Log::DebugTraceF(L"AudioMusicPlaying::OnFlush\n");
-#endif
-
-	if (_desiredPosition >= 0 && _desiredPosition <= _duration)
-	{
-		if (_source)
-		{
-			_startPlaying = _startPlaying || (_state == State::MUSIC_PLAYING);
-			_source->Stop();
-			_source->FlushSourceBuffers();
-			_state = State::MUSIC_INIT;
-		}
-
-		PROPVARIANT value;
-		::PropVariantInit(&value);
-		value.vt = VT_I8;
-		value.hVal.QuadPart = _desiredPosition;
-
-		verifyHr(_mediaReader->SetCurrentPosition(GUID_NULL, value));
-
-		::PropVariantClear(&value);
-	}
-
-	StartReadSample();
-
-	return S_OK;
 }
 
-HRESULT AudioMusicPlaying::OnEvent(DWORD dwStreamIndex, IMFMediaEvent* pEvent)
+void AudioMusicPlaying::OnVoiceError(void* pBufferContext, HRESULT error)
 {
 	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
 
-	return S_OK;
+	assertSz(false, L"XAudio2 voice error");
 }
 
 void AudioMusicPlaying::StartAsyncWork()
@@ -1023,27 +864,39 @@ void AudioMusicPlaying::CancelAsync()
 	::ResetEvent(_stopEvent);
 }
 
-void AudioMusicPlaying::StartReadSample()
+// Moves decoded music into any buffers that XAudio2 is done with. When decoding falls behind,
+// the voice runs dry and the stream counts an underrun, but playback picks up on the next pass.
+void AudioMusicPlaying::SubmitBuffers()
 {
-	assert(!ff::GetGameThreadDispatch()->IsCurrentThread());
-
 	ff::LockMutex lock(_mutex);
-	HRESULT hr = E_FAIL;
 
-	noAssertRet(_mediaState == MediaState::None);
+	noAssertRet(_source && _musicStream && _state != State::MUSIC_DONE && !_seeking);
+	const size_t channels = _musicStream->GetChannels();
 
-	if (_mediaReader)
+	for (SubmitBuffer& buffer : _submitBuffers)
 	{
-		_mediaState = MediaState::Reading;
+		if (!buffer._queued)
+		{
+			size_t startFrame = _musicStream->GetPosition();
+			size_t frames = _musicStream->Read(buffer._samples.Data(), buffer._samples.Size() / channels);
+			if (!frames)
+			{
+				break;
+			}
 
-		hr = _mediaReader->ReadSample(
-			MF_SOURCE_READER_FIRST_AUDIO_STREAM,
-			0, nullptr, nullptr, nullptr, nullptr);
-	}
+			XAUDIO2_BUFFER xbuffer;
+			ff::ZeroObject(xbuffer);
+			xbuffer.AudioBytes = (UINT32)(frames * channels * sizeof(float));
+			xbuffer.pAudioData = reinterpret_cast<const BYTE*>(buffer._samples.Data());
+			xbuffer.pContext = &buffer;
 
-	if (FAILED(hr) && _source)
-	{
-		_source->Discontinuity();
+			if (SUCCEEDED(_source->SubmitSourceBuffer(&xbuffer)))
+			{
+				buffer._startFrame = startFrame;
+				buffer._startSamples = (UINT64)-1;
+				buffer._queued = true;
+			}
+		}
 	}
 }
 
@@ -1065,74 +918,30 @@ void AudioMusicPlaying::OnMusicDone()
 		::DestroyVoiceAsync(_device, _source);
 		_source = nullptr;
 	}
-}
-
-void AudioMusicPlaying::UpdateSourceVolume(IXAudio2SourceVoice* source)
-{
-	assert(source == _source || !ff::GetGameThreadDispatch()->IsCurrentThread());
-
-	if (source)
-	{
-		source->SetVolume(_volume * _playVolume * _fadeVolume);
-	}
-}
-
-AudioSourceReaderCallback::AudioSourceReaderCallback()
-	: _parent(nullptr)
-{
-}
-
-AudioSourceReaderCallback::~AudioSourceReaderCallback()
-{
-	assert(!_parent);
-}
 
-void AudioSourceReaderCallback::SetParent(AudioMusicPlaying* parent)
-{
-	ff::LockMutex lock(_mutex);
-	_parent = parent;
-}
-
-HRESULT AudioSourceReaderCallback::OnReadSample(
-	HRESULT hrStatus,
-	DWORD dwStreamIndex,
-	DWORD dwStreamFlags,
-	LONGLONG llTimestamp,
-	IMFSample* pSample)
-{
-	ff::LockMutex lock(_mutex);
-
-	if (_parent)
+	if (_musicStream)
 	{
-		ff::ComPtr<IUnknown> keepAlive = _parent->_GetUnknown();
-		return _parent->OnReadSample(hrStatus, dwStreamIndex, dwStreamFlags, llTimestamp, pSample);
-	}
-
-	return S_OK;
-}
-
-HRESULT AudioSourceReaderCallback::OnFlush(DWORD dwStreamIndex)
-{
-	ff::LockMutex lock(_mutex);
+		ff::AudioMusicStreamStats stats = _musicStream->GetStats();
+		if (stats._underruns)
+		{
+			ff::Log::DebugTraceF(L"[ff/audio] Music underruns: %lu, missing frames: %lu\r\n", stats._underruns, stats._underrunFrames);
+		}
 
-	if (_parent)
-	{
-		ff::ComPtr<IUnknown> keepAlive = _parent->_GetUnknown();
-		return _parent->OnFlush(dwStreamIndex);
+		// Waiting for the decoding thread to stop could make the game thread hitch
+		std::shared_ptr<ff::AudioMusicStream> musicStream = std::move(_musicStream);
+		ff::GetThreadPool()->AddTask([musicStream]()
+			{
+				musicStream->Stop();
+			});
 	}
-
-	return S_OK;
 }
 
-HRESULT AudioSourceReaderCallback::OnEvent(DWORD dwStreamIndex, IMFMediaEvent* pEvent)
+void AudioMusicPlaying::UpdateSourceVolume(IXAudio2SourceVoice* source)
 {
-	ff::LockMutex lock(_mutex);
+	assert(source == _source || !ff::GetGameThreadDispatch()->IsCurrentThread());
 
-	if (_parent)
+	if (source)
 	{
-		ff::ComPtr<IUnknown> keepAlive = _parent->_GetUnknown();
-		return _parent->OnEvent(dwStreamIndex, pEvent);
+		source->SetVolume(_volume * _playVolume * _fadeVolume);
 	}
-
-	return S_OK;
 }
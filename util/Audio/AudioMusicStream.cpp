@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "Audio/AudioDecoder.h"
+#include "Audio/AudioMusicStream.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/ThreadUtil.h"
+
+ff::AudioMusicStream::AudioMusicStream(std::unique_ptr<IAudioDecoder>&& decoder, double bufferSeconds)
+	: _decoder(std::move(decoder))
+	, _ring(std::max((size_t)(bufferSeconds * _decoder->GetSampleRate()), CHUNK_FRAMES) * _decoder->GetChannels())
+	, _channels(_decoder->GetChannels())
+	, _sampleRate(_decoder->GetSampleRate())
+	, _frameCount(_decoder->GetFrameCount())
+	, _capacityFrames(_ring.GetCapacity() / _channels)
+	, _loop(false)
+	, _running(false)
+	, _stopping(false)
+	, _decodeDone(false)
+	, _position(0)
+	, _decodedFrames(0)
+	, _readFrames(0)
+	, _underruns(0)
+	, _underrunFrames(0)
+{
+	assert(_channels && _sampleRate);
+
+	_chunk.Resize(CHUNK_FRAMES * _channels);
+	_spaceEvent = ff::CreateEvent(false, false);
+	_stoppedEvent = ff::CreateEvent();
+}
+
+ff::AudioMusicStream::~AudioMusicStream()
+{
+	Stop();
+}
+
+size_t ff::AudioMusicStream::GetChannels() const
+{
+	return _channels;
+}
+
+size_t ff::AudioMusicStream::GetSampleRate() const
+{
+	return _sampleRate;
+}
+
+void ff::AudioMusicStream::SetLoop(bool loop)
+{
+	assertRet(!_running);
+	_loop = loop;
+}
+
+void ff::AudioMusicStream::Start(size_t prefillFrames)
+{
+	assertRet(!_running);
+
+	prefillFrames = std::min(prefillFrames, _capacityFrames);
+	while (!_decodeDone && _ring.GetReadCount() / _channels < prefillFrames)
+	{
+		DecodeChunk(prefillFrames - _ring.GetReadCount() / _channels);
+	}
+
+	_running = true;
+	_stopping = false;
+
+	ff::GetThreadPool()->AddThread([this]()
+		{
+			DecodeThread();
+		});
+}
+
+void ff::AudioMusicStream::Stop()
+{
+	if (_running)
+	{
+		_stopping = true;
+		::SetEvent(_spaceEvent);
+		ff::WaitForEventAndReset(_stoppedEvent);
+		_running = false;
+	}
+}
+
+bool ff::AudioMusicStream::Seek(size_t frame, size_t prefillFrames)
+{
+	bool running = _running;
+	Stop();
+
+	_ring.Clear();
+	_decodeDone = false;
+	_position = _frameCount ? std::min(frame, _frameCount) : frame;
+	bool status = _decoder->SetPosition(_position);
+
+	if (running)
+	{
+		Start(prefillFrames);
+	}
+
+	assertRetVal(status, false);
+	return true;
+}
+
+size_t ff::AudioMusicStream::Read(float* samples, size_t frameCount)
+{
+	// Checked before reading, so that a short read right before the end isn't an underrun
+	bool decodeDone = _decodeDone;
+	size_t count = _ring.Read(samples, frameCount * _channels) / _channels;
+
+	if (count)
+	{
+		size_t position = _position + count;
+		_position = (_loop && _frameCount) ? position % _frameCount : position;
+		_readFrames += count;
+
+		::SetEvent(_spaceEvent);
+	}
+
+	if (count < frameCount && !decodeDone)
+	{
+		_underruns++;
+		_underrunFrames += frameCount - count;
+	}
+
+	return count;
+}
+
+bool ff::AudioMusicStream::IsDone() const
+{
+	return _decodeDone && _ring.IsEmpty();
+}
+
+size_t ff::AudioMusicStream::GetPosition() const
+{
+	return _position;
+}
+
+float ff::AudioMusicStream::GetFillLevel() const
+{
+	return (float)(_ring.GetReadCount() / _channels) / _capacityFrames;
+}
+
+ff::AudioMusicStreamStats ff::AudioMusicStream::GetStats() const
+{
+	AudioMusicStreamStats stats;
+	stats._capacityFrames = _capacityFrames;
+	stats._bufferedFrames = _ring.GetReadCount() / _channels;
+	stats._decodedFrames = _decodedFrames;
+	stats._readFrames = _readFrames;
+	stats._underruns = _underruns;
+	stats._underrunFrames = _underrunFrames;
+
+	return stats;
+}
+
+bool ff::AudioMusicStream::DecodeChunk(size_t maxFrames)
+{
+	size_t frames = _decoder->Decode(_chunk.Data(), std::min(maxFrames, CHUNK_FRAMES));
+
+	// Loop back to the start, unless there's nothing there either
+	if (!frames && _loop && _decoder->SetPosition(0))
+	{
+		frames = _decoder->Decode(_chunk.Data(), std::min(maxFrames, CHUNK_FRAMES));
+	}
+
+	if (!frames)
+	{
+		_decodeDone = true;
+		return false;
+	}
+
+	verify(_ring.Write(_chunk.Data(), frames * _channels) == frames * _channels);
+	_decodedFrames += frames;
+
+	return true;
+}
+
+void ff::AudioMusicStream::DecodeThread()
+{
+	::SetThreadDescription(::GetCurrentThread(), L"ff : Music Decoder");
+
+	// Decoding waits until a whole chunk fits, so that it doesn't decode tiny pieces
+	const size_t minFrames = std::min(CHUNK_FRAMES, _capacityFrames / 2);
+
+	while (!_stopping && !_decodeDone)
+	{
+		size_t space = _ring.GetWriteCount() / _channels;
+		if (space < minFrames)
+		{
+			::WaitForSingleObject(_spaceEvent, 10);
+		}
+		else
+		{
+			DecodeChunk(space);
+		}
+	}
+
+	::SetEvent(_stoppedEvent);
+}
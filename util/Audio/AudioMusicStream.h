@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Types/SpscRing.h"
+#include "Windows/Handles.h"
+
+namespace ff
+{
+	class IAudioDecoder;
+
+	struct AudioMusicStreamStats
+	{
+		size_t _capacityFrames;
+		size_t _bufferedFrames;
+		size_t _decodedFrames;
+		size_t _readFrames;
+		size_t _underruns; // reads that didn't get every frame they wanted
+		size_t _underrunFrames;
+	};
+
+	// Decodes music ahead of playback on its own thread, into a lock-free ring that the audio thread
+	// reads from. Read is only called by one thread, and the decoding thread is the only writer.
+	class AudioMusicStream
+	{
+	public:
+		UTIL_API AudioMusicStream(std::unique_ptr<IAudioDecoder>&& decoder, double bufferSeconds = 0.5);
+		UTIL_API ~AudioMusicStream();
+
+		UTIL_API size_t GetChannels() const;
+		UTIL_API size_t GetSampleRate() const;
+		UTIL_API void SetLoop(bool loop);
+
+		// Decoding, prefill frames are decoded on the calling thread before Start returns
+		UTIL_API void Start(size_t prefillFrames = 0);
+		UTIL_API void Stop();
+		UTIL_API bool Seek(size_t frame, size_t prefillFrames = 0); // nothing can be reading during a seek
+
+		// Reading
+		UTIL_API size_t Read(float* samples, size_t frameCount);
+		UTIL_API bool IsDone() const;
+		UTIL_API size_t GetPosition() const; // source frame of the next read
+		UTIL_API float GetFillLevel() const;
+		UTIL_API AudioMusicStreamStats GetStats() const;
+
+	private:
+		bool DecodeChunk(size_t maxFrames);
+		void DecodeThread();
+
+		static constexpr size_t CHUNK_FRAMES = 1024;
+
+		std::unique_ptr<IAudioDecoder> _decoder;
+		ff::SpscRing<float> _ring;
+		ff::Vector<float> _chunk;
+		ff::WinHandle _spaceEvent;
+		ff::WinHandle _stoppedEvent;
+		size_t _channels;
+		size_t _sampleRate;
+		size_t _frameCount;
+		size_t _capacityFrames;
+		bool _loop;
+		bool _running;
+		std::atomic<bool> _stopping;
+		std::atomic<bool> _decodeDone;
+		std::atomic<size_t> _position;
+		std::atomic<size_t> _decodedFrames;
+		std::atomic<size_t> _readFrames;
+		std::atomic<size_t> _underruns;
+		std::atomic<size_t> _underrunFrames;
+	};
+}
@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "Audio/AudioPcmCache.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Data/SavedData.h"
+#include "Thread/ThreadPool.h"
+
+ff::AudioPcmClip::AudioPcmClip(const WAVEFORMATEX& format, ISavedData* savedData, bool keepCompressed)
+	: _format(format)
+	, _savedData(savedData)
+	, _savedSize(savedData->GetSavedSize())
+	, _preloads(0)
+	, _demandLoads(0)
+	, _trimmed(0)
+	, _keepCompressed(keepCompressed)
+	, _used(false)
+{
+}
+
+ff::AudioPcmClip::~AudioPcmClip()
+{
+}
+
+ff::ComPtr<ff::IData> ff::AudioPcmClip::GetData()
+{
+	ff::LockMutex lock(_mutex);
+	_used = true;
+
+	if (!_data)
+	{
+		assertRetVal(Load(false), nullptr);
+	}
+
+	return _data;
+}
+
+const WAVEFORMATEX& ff::AudioPcmClip::GetFormat() const
+{
+	return _format;
+}
+
+bool ff::AudioPcmClip::IsLoaded() const
+{
+	ff::LockMutex lock(_mutex);
+	return _data != nullptr;
+}
+
+bool ff::AudioPcmClip::IsKeptCompressed() const
+{
+	return _keepCompressed;
+}
+
+bool ff::AudioPcmClip::Load(bool preload)
+{
+	ff::LockMutex lock(_mutex);
+	noAssertRetVal(!_data, true);
+
+	// Loading a clone leaves the saved bytes alone, so the PCM can be freed later
+	ff::ComPtr<ff::ISavedData> savedData;
+	assertRetVal(_savedData->Clone(&savedData), false);
+
+	_data = savedData->Load();
+	assertRetVal(_data, false);
+
+	if (preload)
+	{
+		_preloads++;
+	}
+	else
+	{
+		_demandLoads++;
+	}
+
+	return true;
+}
+
+bool ff::AudioPcmClip::Trim()
+{
+	ff::LockMutex lock(_mutex);
+
+	bool used = _used;
+	_used = false;
+
+	noAssertRetVal(_keepCompressed && _data && !used, false);
+
+	// Playing voices keep their own reference to the data
+	_data.Interface()->AddRef();
+	noAssertRetVal(_data.Interface()->Release() == 1, false);
+
+	_data = nullptr;
+	_trimmed++;
+
+	return true;
+}
+
+bool ff::AudioPcmClip::IsSameSound(const WAVEFORMATEX& format, ISavedData* savedData, const BYTE* savedBytes) const
+{
+	noAssertRetVal(!std::memcmp(&_format, &format, sizeof(format)), false);
+	noAssertRetVal(_savedSize == savedData->GetSavedSize() && _savedData->GetFullSize() == savedData->GetFullSize(), false);
+	noAssertRetVal(_savedData->IsCompressed() == savedData->IsCompressed(), false);
+
+	ff::ComPtr<ff::ISavedData> clone;
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(_savedData->Clone(&clone) && clone->CreateSavedDataReader(&reader), false);
+
+	const BYTE* bytes = reader->Read(_savedSize);
+	return bytes && !std::memcmp(bytes, savedBytes, _savedSize);
+}
+
+ff::AudioPcmCache::AudioPcmCache()
+	: _pendingPreloads(0)
+	, _sharedAdds(0)
+{
+}
+
+ff::AudioPcmCache::~AudioPcmCache()
+{
+	WaitForPreloads();
+}
+
+std::shared_ptr<ff::AudioPcmClip> ff::AudioPcmCache::Add(const WAVEFORMATEX& format, ISavedData* savedData, bool keepCompressed)
+{
+	assertRetVal(savedData, nullptr);
+
+	// Hashing the saved bytes means that nothing has to be decompressed to find a duplicate
+	ff::ComPtr<ff::ISavedData> clone;
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(savedData->Clone(&clone) && clone->CreateSavedDataReader(&reader), nullptr);
+
+	size_t savedSize = clone->GetSavedSize();
+	const BYTE* savedBytes = reader->Read(savedSize);
+	assertRetVal(savedBytes, nullptr);
+
+	ff::hash_t hash = ff::HashBytes(savedBytes, savedSize);
+	std::shared_ptr<ff::AudioPcmClip> clip;
+	{
+		ff::LockMutex lock(_mutex);
+		RemoveExpired();
+
+		for (const ClipKeyValue* i = _clips.GetKey(hash); i; i = _clips.GetNextDupeKey(*i))
+		{
+			std::shared_ptr<ff::AudioPcmClip> existingClip = i->GetValue().lock();
+			if (existingClip && existingClip->IsSameSound(format, clone, savedBytes))
+			{
+				_sharedAdds++;
+				return existingClip;
+			}
+		}
+
+		clip = std::make_shared<ff::AudioPcmClip>(format, clone, keepCompressed);
+		_clips.InsertKey(hash, clip);
+	}
+
+	if (!keepCompressed)
+	{
+		Preload(clip);
+	}
+
+	return clip;
+}
+
+void ff::AudioPcmCache::WaitForPreloads()
+{
+	ff::LockMutex lock(_mutex);
+
+	while (_pendingPreloads)
+	{
+		_mutex.WaitForCondition(_preloadCondition);
+	}
+}
+
+size_t ff::AudioPcmCache::Trim()
+{
+	ff::LockMutex lock(_mutex);
+	size_t count = 0;
+
+	for (const ClipKeyValue& i : _clips)
+	{
+		std::shared_ptr<ff::AudioPcmClip> clip = i.GetValue().lock();
+		if (clip && clip->Trim())
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+ff::AudioPcmCacheStats ff::AudioPcmCache::GetStats() const
+{
+	ff::LockMutex lock(_mutex);
+
+	ff::AudioPcmCacheStats stats{};
+	stats._sharedAdds = _sharedAdds;
+
+	for (const ClipKeyValue& i : _clips)
+	{
+		std::shared_ptr<ff::AudioPcmClip> clip = i.GetValue().lock();
+		if (clip)
+		{
+			ff::LockMutex clipLock(clip->_mutex);
+
+			stats._clipCount++;
+			stats._loadedCount += clip->_data ? 1 : 0;
+			stats._compressedCount += clip->_keepCompressed ? 1 : 0;
+			stats._pcmBytes += clip->_data ? clip->_data->GetSize() : 0;
+			stats._savedBytes += clip->_savedSize;
+			stats._preloads += clip->_preloads;
+			stats._demandLoads += clip->_demandLoads;
+			stats._trimmed += clip->_trimmed;
+		}
+	}
+
+	return stats;
+}
+
+void ff::AudioPcmCache::Preload(std::shared_ptr<AudioPcmClip> clip)
+{
+	{
+		ff::LockMutex lock(_mutex);
+		_pendingPreloads++;
+	}
+
+	// Sounds that get unloaded before their turn don't need to be decompressed
+	std::weak_ptr<AudioPcmClip> weakClip = clip;
+	ff::GetThreadPool()->AddTask([this, weakClip]()
+		{
+			std::shared_ptr<AudioPcmClip> clip = weakClip.lock();
+			if (clip)
+			{
+				verify(clip->Load(true));
+				clip = nullptr;
+			}
+
+			ff::LockMutex lock(_mutex);
+			_pendingPreloads--;
+			_preloadCondition.WakeAll();
+		});
+}
+
+void ff::AudioPcmCache::RemoveExpired()
+{
+	ff::Vector<const ClipKeyValue*, 32> expired;
+
+	for (const ClipKeyValue& i : _clips)
+	{
+		if (i.GetValue().expired())
+		{
+			expired.Push(&i);
+		}
+	}
+
+	for (const ClipKeyValue* i : expired)
+	{
+		_clips.DeleteKey(*i);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+namespace ff
+{
+	class IData;
+	class ISavedData;
+
+	struct AudioPcmCacheStats
+	{
+		size_t _clipCount;
+		size_t _loadedCount;
+		size_t _compressedCount; // clips that are only decompressed while they are used
+		size_t _sharedAdds; // adds that found the same sound already in the cache
+		size_t _pcmBytes;
+		size_t _savedBytes;
+		size_t _preloads;
+		size_t _demandLoads; // plays that had to wait for decompression
+		size_t _trimmed;
+	};
+
+	// PCM for one sound, shared by every wave resource with the same saved bytes
+	class AudioPcmClip
+	{
+	public:
+		UTIL_API AudioPcmClip(const WAVEFORMATEX& format, ISavedData* savedData, bool keepCompressed);
+		UTIL_API ~AudioPcmClip();
+
+		// Decompresses on the calling thread when it wasn't preloaded. Keep the data while it plays.
+		UTIL_API ComPtr<IData> GetData();
+		UTIL_API const WAVEFORMATEX& GetFormat() const;
+		UTIL_API bool IsLoaded() const;
+		UTIL_API bool IsKeptCompressed() const;
+
+	private:
+		friend class AudioPcmCache;
+
+		bool Load(bool preload);
+		bool Trim();
+		bool IsSameSound(const WAVEFORMATEX& format, ISavedData* savedData, const BYTE* savedBytes) const;
+
+		Mutex _mutex;
+		WAVEFORMATEX _format;
+		ComPtr<ISavedData> _savedData;
+		ComPtr<IData> _data;
+		size_t _savedSize;
+		size_t _preloads;
+		size_t _demandLoads;
+		size_t _trimmed;
+		bool _keepCompressed;
+		bool _used;
+	};
+
+	// Process-wide cache of decompressed sound effects, keyed by a hash of their saved bytes, so that
+	// identical clips in different resource packs only get loaded once. Clips are decompressed on the
+	// thread pool as soon as they are added, except for kept-compressed ones, which only get decompressed
+	// when they play and are freed again by Trim.
+	class AudioPcmCache
+	{
+	public:
+		UTIL_API AudioPcmCache();
+		UTIL_API ~AudioPcmCache();
+
+		UTIL_API std::shared_ptr<AudioPcmClip> Add(const WAVEFORMATEX& format, ISavedData* savedData, bool keepCompressed);
+		UTIL_API void WaitForPreloads();
+
+		// Frees kept-compressed clips that aren't playing and weren't used since the last trim.
+		// Returns how many were freed.
+		UTIL_API size_t Trim();
+		UTIL_API AudioPcmCacheStats GetStats() const;
+
+	private:
+		void Preload(std::shared_ptr<AudioPcmClip> clip);
+		void RemoveExpired();
+
+		typedef ff::KeyValue<ff::hash_t, std::weak_ptr<AudioPcmClip>> ClipKeyValue;
+
+		Mutex _mutex;
+		Condition _preloadCondition;
+		ff::Map<ff::hash_t, std::weak_ptr<AudioPcmClip>, ff::NonHasher<ff::hash_t>> _clips;
+		size_t _pendingPreloads;
+		size_t _sharedAdds;
+	};
+}
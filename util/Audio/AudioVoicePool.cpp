@@ -0,0 +1,400 @@
+#include "pch.h"
+#include "Audio/AudioDevice.h"
+#include "Audio/AudioVoicePool.h"
+#include "Data/Data.h"
+
+void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source, std::function<void()>&& onDestroyed);
+
+static ff::hash_t HashWaveFormat(const WAVEFORMATEX& format)
+{
+	// Extensible formats have extra bytes after the struct
+	size_t size = sizeof(WAVEFORMATEX) + (format.wFormatTag != WAVE_FORMAT_PCM ? format.cbSize : 0);
+	return ff::HashBytes(&format, size);
+}
+
+// Called without the pool lock, so that nothing waits on XAudio2 while holding it
+static void DestroyVoices(const ff::Vector<ff::IAudioPoolVoice*>& voices)
+{
+	for (ff::IAudioPoolVoice* voice : voices)
+	{
+		voice->Destroy();
+	}
+}
+
+ff::AudioVoicePool::AudioVoicePool(IAudioVoicePoolBackend* backend, size_t defaultLimit)
+	: _backend(backend)
+	, _defaultLimit(defaultLimit)
+	, _sequence(0)
+	, _stats{}
+{
+	assert(backend && defaultLimit);
+}
+
+ff::AudioVoicePool::~AudioVoicePool()
+{
+	Clear();
+}
+
+void ff::AudioVoicePool::SetDefaultLimit(size_t limit)
+{
+	assertRet(limit);
+
+	ff::LockMutex lock(_mutex);
+	_defaultLimit = limit;
+}
+
+void ff::AudioVoicePool::SetLimit(const WAVEFORMATEX& format, size_t limit)
+{
+	assertRet(limit);
+
+	ff::Vector<IAudioPoolVoice*> destroyVoices;
+	{
+		ff::LockMutex lock(_mutex);
+		hash_t formatHash;
+		FormatVoices& voices = GetFormatVoices(format, formatHash);
+		voices._limit = limit;
+
+		// Extra idle voices aren't needed anymore, active ones go away when they are released
+		while (voices._idle.Size() && voices._idle.Size() + voices._activeCount > limit)
+		{
+			destroyVoices.Push(voices._idle.Pop());
+		}
+	}
+
+	::DestroyVoices(destroyVoices);
+}
+
+ff::IAudioPoolVoice* ff::AudioVoicePool::Acquire(const WAVEFORMATEX& format, int priority, IAudioPoolVoiceOwner* owner)
+{
+	assertRetVal(owner, nullptr);
+
+	ff::Vector<IAudioPoolVoice*> destroyVoices;
+	IAudioPoolVoice* voice = nullptr;
+	{
+		ff::LockMutex lock(_mutex);
+		UpdateDraining(destroyVoices);
+
+		hash_t formatHash;
+		FormatVoices& voices = GetFormatVoices(format, formatHash);
+
+		if (voices._idle.Size())
+		{
+			voice = voices._idle.Pop();
+			_stats._hits++;
+		}
+		else if (voices._activeCount < voices._limit)
+		{
+			voice = CreateVoice(format);
+		}
+		else if (IAudioPoolVoice* stolenVoice = StealVoice(formatHash, priority))
+		{
+			// The stolen voice can't be handed over until it's done with the old owner's buffers
+			stolenVoice->Reset();
+			voices._draining.Push(stolenVoice);
+			UpdateDraining(destroyVoices);
+			_stats._steals++;
+
+			if (voices._idle.Size())
+			{
+				voice = voices._idle.Pop();
+			}
+			else
+			{
+				voice = CreateVoice(format);
+			}
+		}
+		else
+		{
+			_stats._failures++;
+		}
+
+		if (voice)
+		{
+			_active.SetKey(voice, ActiveVoice{ formatHash, owner, priority, ++_sequence });
+			voices._activeCount++;
+		}
+	}
+
+	::DestroyVoices(destroyVoices);
+	return voice;
+}
+
+void ff::AudioVoicePool::Release(IAudioPoolVoice* voice)
+{
+	noAssertRet(voice);
+
+	ff::Vector<IAudioPoolVoice*> destroyVoices;
+	{
+		ff::LockMutex lock(_mutex);
+		auto iter = _active.GetKey(voice);
+		assertRet(iter);
+
+		FormatVoices& voices = _formats.GetKey(iter->GetValue()._format)->GetEditableValue();
+		_active.DeleteKey(*iter);
+
+		voice->Reset();
+		voices._activeCount--;
+		voices._draining.Push(voice);
+
+		UpdateDraining(destroyVoices);
+	}
+
+	::DestroyVoices(destroyVoices);
+}
+
+void ff::AudioVoicePool::Clear()
+{
+	ff::Vector<IAudioPoolVoice*> destroyVoices;
+	{
+		ff::LockMutex lock(_mutex);
+
+		for (const ff::KeyValue<IAudioPoolVoice*, ActiveVoice>& kv : _active)
+		{
+			kv.GetValue()._owner->OnVoiceStolen(kv.GetKey());
+			destroyVoices.Push(kv.GetKey());
+		}
+
+		for (const ff::KeyValue<hash_t, FormatVoices>& kv : _formats)
+		{
+			destroyVoices.Push(kv.GetValue()._idle.Data(), kv.GetValue()._idle.Size());
+			destroyVoices.Push(kv.GetValue()._draining.Data(), kv.GetValue()._draining.Size());
+		}
+
+		_active.Clear();
+		_formats.Clear();
+	}
+
+	// Destroying a voice waits for XAudio2 to stop using it, so buffers that are still queued stay valid
+	::DestroyVoices(destroyVoices);
+}
+
+ff::AudioVoicePoolStats ff::AudioVoicePool::GetStats() const
+{
+	ff::LockMutex lock(_mutex);
+
+	AudioVoicePoolStats stats = _stats;
+	stats._activeCount = _active.Size();
+
+	for (const ff::KeyValue<hash_t, FormatVoices>& kv : _formats)
+	{
+		stats._idleCount += kv.GetValue()._idle.Size();
+		stats._drainingCount += kv.GetValue()._draining.Size();
+	}
+
+	return stats;
+}
+
+ff::AudioVoicePool::FormatVoices& ff::AudioVoicePool::GetFormatVoices(const WAVEFORMATEX& format, hash_t& formatHash)
+{
+	formatHash = ::HashWaveFormat(format);
+
+	auto iter = _formats.GetKey(formatHash);
+	if (!iter)
+	{
+		iter = _formats.SetKey(formatHash, FormatVoices{ _defaultLimit, 0 });
+	}
+
+	return iter->GetEditableValue();
+}
+
+ff::IAudioPoolVoice* ff::AudioVoicePool::StealVoice(hash_t formatHash, int priority)
+{
+	const ff::KeyValue<IAudioPoolVoice*, ActiveVoice>* best = nullptr;
+
+	for (const ff::KeyValue<IAudioPoolVoice*, ActiveVoice>& kv : _active)
+	{
+		const ActiveVoice& active = kv.GetValue();
+
+		if (active._format == formatHash && active._priority <= priority && (!best ||
+			active._priority < best->GetValue()._priority ||
+			(active._priority == best->GetValue()._priority && active._sequence < best->GetValue()._sequence)))
+		{
+			best = &kv;
+		}
+	}
+
+	noAssertRetVal(best, nullptr);
+
+	IAudioPoolVoice* voice = best->GetKey();
+	IAudioPoolVoiceOwner* owner = best->GetValue()._owner;
+
+	_active.DeleteKey(*best);
+	_formats.GetKey(formatHash)->GetEditableValue()._activeCount--;
+	owner->OnVoiceStolen(voice);
+
+	return voice;
+}
+
+ff::IAudioPoolVoice* ff::AudioVoicePool::CreateVoice(const WAVEFORMATEX& format)
+{
+	IAudioPoolVoice* voice = _backend->CreateVoice(format);
+	assertRetVal(voice, nullptr);
+	_stats._creates++;
+
+	return voice;
+}
+
+void ff::AudioVoicePool::UpdateDraining(ff::Vector<IAudioPoolVoice*>& destroyVoices)
+{
+	for (const ff::KeyValue<hash_t, FormatVoices>& kv : _formats)
+	{
+		FormatVoices& voices = kv.GetEditableValue();
+
+		for (size_t i = voices._draining.Size(); i > 0; i--)
+		{
+			IAudioPoolVoice* voice = voices._draining[i - 1];
+			if (voice->IsDone())
+			{
+				voices._draining.Delete(i - 1);
+
+				if (voices._idle.Size() + voices._activeCount < voices._limit)
+				{
+					voices._idle.Push(voice);
+				}
+				else
+				{
+					destroyVoices.Push(voice);
+				}
+			}
+		}
+	}
+}
+
+ff::XAudioPoolVoice::XAudioPoolVoice()
+	: _device(nullptr)
+	, _source(nullptr)
+	, _callback(nullptr)
+	, _context(nullptr)
+{
+}
+
+ff::XAudioPoolVoice::~XAudioPoolVoice()
+{
+	assert(!_source);
+}
+
+bool ff::XAudioPoolVoice::Init(IAudioDevice* device, IXAudio2Voice* output, const WAVEFORMATEX& format)
+{
+	IXAudio2* audio = device ? device->AsXAudioDevice()->GetAudio() : nullptr;
+	assertRetVal(audio && output && !_source, false);
+	_device = device;
+
+	XAUDIO2_SEND_DESCRIPTOR send;
+	send.Flags = 0;
+	send.pOutputVoice = output;
+
+	XAUDIO2_VOICE_SENDS sends;
+	sends.SendCount = 1;
+	sends.pSends = &send;
+
+	assertHrRetVal(audio->CreateSourceVoice(
+		&_source,
+		&format,
+		0, // flags
+		XAUDIO2_DEFAULT_FREQ_RATIO,
+		this, // callback
+		&sends, // send list
+		nullptr), false); // effect chain
+
+	return true;
+}
+
+IXAudio2SourceVoice* ff::XAudioPoolVoice::GetSource() const
+{
+	return _source;
+}
+
+void ff::XAudioPoolVoice::SetCallback(IXAudio2VoiceCallback* callback, void* context)
+{
+	ff::LockMutex lock(_mutex);
+	_callback = callback;
+	_context = context;
+}
+
+void ff::XAudioPoolVoice::SetData(IData* data)
+{
+	_data = data;
+}
+
+void ff::XAudioPoolVoice::Reset()
+{
+	SetCallback(nullptr, nullptr);
+
+	if (_source)
+	{
+		// Stopping and flushing happens later on the audio thread, so the data is kept until IsDone
+		_source->Stop();
+		_source->FlushSourceBuffers();
+		_source->SetVolume(1);
+		_source->SetFrequencyRatio(1);
+	}
+}
+
+bool ff::XAudioPoolVoice::IsDone()
+{
+	if (_source)
+	{
+		XAUDIO2_VOICE_STATE state;
+		_source->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED);
+		noAssertRetVal(!state.BuffersQueued, false);
+	}
+
+	_data = nullptr;
+	return true;
+}
+
+void ff::XAudioPoolVoice::Destroy()
+{
+	SetCallback(nullptr, nullptr);
+
+	if (_source)
+	{
+		// XAudio2 can still call back into this voice or read its data until DestroyVoice returns
+		IXAudio2SourceVoice* source = _source;
+		_source = nullptr;
+
+		::DestroyVoiceAsync(_device, source, [this]()
+			{
+				delete this;
+			});
+	}
+	else
+	{
+		delete this;
+	}
+}
+
+void ff::XAudioPoolVoice::OnVoiceProcessingPassStart(UINT32 BytesRequired)
+{
+}
+
+void ff::XAudioPoolVoice::OnVoiceProcessingPassEnd()
+{
+}
+
+void ff::XAudioPoolVoice::OnStreamEnd()
+{
+}
+
+void ff::XAudioPoolVoice::OnBufferStart(void* pBufferContext)
+{
+}
+
+void ff::XAudioPoolVoice::OnBufferEnd(void* pBufferContext)
+{
+	ff::LockMutex lock(_mutex);
+
+	if (_callback && pBufferContext == _context)
+	{
+		_callback->OnBufferEnd(pBufferContext);
+	}
+}
+
+void ff::XAudioPoolVoice::OnLoopEnd(void* pBufferContext)
+{
+}
+
+void ff::XAudioPoolVoice::OnVoiceError(void* pBufferContext, HRESULT error)
+{
+	assertSz(false, L"XAudio2 voice error");
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+namespace ff
+{
+	class IAudioDevice;
+	class IData;
+
+	class __declspec(novtable) IAudioPoolVoice
+	{
+	public:
+		// Stops playing and drops any buffers, the voice may still be reading them until IsDone
+		virtual void Reset() = 0;
+		virtual bool IsDone() = 0;
+		virtual void Destroy() = 0;
+	};
+
+	class __declspec(novtable) IAudioPoolVoiceOwner
+	{
+	public:
+		// The voice was given to someone else, it must not be used or released anymore
+		virtual void OnVoiceStolen(IAudioPoolVoice* voice) = 0;
+	};
+
+	class __declspec(novtable) IAudioVoicePoolBackend
+	{
+	public:
+		virtual IAudioPoolVoice* CreateVoice(const WAVEFORMATEX& format) = 0;
+	};
+
+	struct AudioVoicePoolStats
+	{
+		size_t _activeCount;
+		size_t _idleCount;
+		size_t _drainingCount;
+		size_t _hits;
+		size_t _creates;
+		size_t _steals;
+		size_t _failures; // every voice was busy with something more important
+	};
+
+	// Reuses voices for sound effects, so that rapid-fire effects don't create and destroy a voice every time.
+	// Voices are kept per wave format. When a format reaches its limit, the voice with the lowest priority,
+	// then the oldest one, is stolen from whatever was playing on it. Released and stolen voices only go back
+	// to the idle list once they are done with their old buffers, until then they don't count toward the limit.
+	class AudioVoicePool
+	{
+	public:
+		UTIL_API AudioVoicePool(IAudioVoicePoolBackend* backend, size_t defaultLimit = 32);
+		UTIL_API ~AudioVoicePool();
+
+		UTIL_API void SetDefaultLimit(size_t limit);
+		UTIL_API void SetLimit(const WAVEFORMATEX& format, size_t limit);
+
+		UTIL_API IAudioPoolVoice* Acquire(const WAVEFORMATEX& format, int priority, IAudioPoolVoiceOwner* owner);
+		UTIL_API void Release(IAudioPoolVoice* voice);
+
+		// Destroys every voice, owners of active voices are told that they were stolen
+		UTIL_API void Clear();
+		UTIL_API AudioVoicePoolStats GetStats() const;
+
+	private:
+		struct FormatVoices
+		{
+			size_t _limit;
+			size_t _activeCount;
+			ff::Vector<IAudioPoolVoice*> _idle;
+			ff::Vector<IAudioPoolVoice*> _draining;
+		};
+
+		struct ActiveVoice
+		{
+			hash_t _format;
+			IAudioPoolVoiceOwner* _owner;
+			int _priority;
+			size_t _sequence;
+		};
+
+		FormatVoices& GetFormatVoices(const WAVEFORMATEX& format, hash_t& formatHash);
+		IAudioPoolVoice* CreateVoice(const WAVEFORMATEX& format);
+		IAudioPoolVoice* StealVoice(hash_t formatHash, int priority);
+		void UpdateDraining(ff::Vector<IAudioPoolVoice*>& destroyVoices);
+
+		Mutex _mutex;
+		IAudioVoicePoolBackend* _backend;
+		ff::Map<hash_t, FormatVoices> _formats;
+		ff::Map<IAudioPoolVoice*, ActiveVoice> _active;
+		size_t _defaultLimit;
+		size_t _sequence;
+		AudioVoicePoolStats _stats;
+	};
+
+	// Pooled XAudio2 source voice. XAudio2 callbacks are set when the voice is created, so they
+	// go through this object to whoever is using the voice now. Buffer callbacks only get through
+	// when their context matches the current one, since a flush from the last owner can arrive late.
+	// The data being played stays referenced until XAudio2 has no buffers queued, or the voice is destroyed.
+	class XAudioPoolVoice : public IAudioPoolVoice, public IXAudio2VoiceCallback
+	{
+	public:
+		XAudioPoolVoice();
+		~XAudioPoolVoice();
+
+		bool Init(IAudioDevice* device, IXAudio2Voice* output, const WAVEFORMATEX& format);
+		IXAudio2SourceVoice* GetSource() const;
+		void SetCallback(IXAudio2VoiceCallback* callback, void* context);
+		void SetData(IData* data);
+
+		// IAudioPoolVoice
+		virtual void Reset() override;
+		virtual bool IsDone() override;
+		virtual void Destroy() override;
+
+		// IXAudio2VoiceCallback
+		COM_FUNC_VOID OnVoiceProcessingPassStart(UINT32 BytesRequired) override;
+		COM_FUNC_VOID OnVoiceProcessingPassEnd() override;
+		COM_FUNC_VOID OnStreamEnd() override;
+		COM_FUNC_VOID OnBufferStart(void* pBufferContext) override;
+		COM_FUNC_VOID OnBufferEnd(void* pBufferContext) override;
+		COM_FUNC_VOID OnLoopEnd(void* pBufferContext) override;
+		COM_FUNC_VOID OnVoiceError(void* pBufferContext, HRESULT error) override;
+
+	private:
+		Mutex _mutex;
+		IAudioDevice* _device;
+		IXAudio2SourceVoice* _source;
+		ComPtr<IData> _data;
+		IXAudio2VoiceCallback* _callback;
+		void* _context;
+	};
+}
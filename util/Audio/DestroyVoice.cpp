@@ -14,7 +14,7 @@ class __declspec(uuid("3638c79d-784e-4ded-830e-26e400fa5af5"))
 public:
 	DECLARE_HEADER(DestroyVoiceWorkItem);
 
-	bool Init(IXAudio2SourceVoice* source);
+	bool Init(IXAudio2SourceVoice* source, std::function<void()>&& onDestroyed);
 
 	virtual HRESULT _Construct(IUnknown* unkOuter) override;
 	virtual void _DeleteThis() override;
@@ -27,6 +27,7 @@ private:
 	ff::Mutex _mutex;
 	ff::ComPtr<ff::IAudioDevice> _device;
 	IXAudio2SourceVoice* _source;
+	std::function<void()> _onDestroyed;
 };
 
 BEGIN_INTERFACES(DestroyVoiceWorkItem)
@@ -44,26 +45,32 @@ static HRESULT CreateDestroyVoiceWorkItemNoInit(IUnknown* unkOuter, REFGUID clsi
 	return myObj->QueryInterface(iid, obj);
 }
 
-static bool CreateDestroyVoiceWorkItem(ff::IAudioDevice* device, IXAudio2SourceVoice* source, DestroyVoiceWorkItem** obj)
+static bool CreateDestroyVoiceWorkItem(ff::IAudioDevice* device, IXAudio2SourceVoice* source, std::function<void()>& onDestroyed, DestroyVoiceWorkItem** obj)
 {
 	assertRetVal(obj, false);
 
 	ff::ComPtr<DestroyVoiceWorkItem> myObj;
 	assertHrRetVal(::CreateDestroyVoiceWorkItemNoInit(device, GUID_NULL, __uuidof(DestroyVoiceWorkItem), (void**)&myObj), false);
-	assertRetVal(myObj->Init(source), false);
+	assertRetVal(myObj->Init(source, std::move(onDestroyed)), false);
 
 	*obj = myObj.Detach();
 	return true;
 }
 
-void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source)
+// onDestroyed is called after XAudio2 is completely done with the voice, on whatever thread destroyed it
+void DestroyVoiceAsync(ff::IAudioDevice* device, IXAudio2SourceVoice* source, std::function<void()>&& onDestroyed)
 {
 	assertRet(device && source);
 
 	ff::ComPtr<DestroyVoiceWorkItem> obj;
-	if (!::CreateDestroyVoiceWorkItem(device, source, &obj))
+	if (!::CreateDestroyVoiceWorkItem(device, source, onDestroyed, &obj))
 	{
 		source->DestroyVoice();
+
+		if (onDestroyed)
+		{
+			onDestroyed();
+		}
 	}
 }
 
@@ -95,10 +102,11 @@ void DestroyVoiceWorkItem::_DeleteThis()
 	s_destroyVoiceAllocator.Delete(static_cast<ff::ComObject<DestroyVoiceWorkItem>*>(this));
 }
 
-bool DestroyVoiceWorkItem::Init(IXAudio2SourceVoice* source)
+bool DestroyVoiceWorkItem::Init(IXAudio2SourceVoice* source, std::function<void()>&& onDestroyed)
 {
 	assertRetVal(_device && source, false);
 	_source = source;
+	_onDestroyed = std::move(onDestroyed);
 
 	ff::ComPtr<DestroyVoiceWorkItem> keepAlive = this;
 	ff::GetThreadPool()->AddTask([keepAlive]()
@@ -123,6 +131,12 @@ bool DestroyVoiceWorkItem::Reset()
 		{
 			_source->DestroyVoice();
 			_source = nullptr;
+
+			if (_onDestroyed)
+			{
+				_onDestroyed();
+				_onDestroyed = nullptr;
+			}
 		}
 	}
 
@@ -0,0 +1,382 @@
+#include "pch.h"
+#include "Audio/AudioDevice.h"
+#include "Audio/AudioDeviceChild.h"
+#include "Audio/AudioFactory.h"
+#include "Audio/AudioMixer.h"
+#include "Audio/AudioPlaying.h"
+#include "COM/ComAlloc.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
+#include "Windows/Handles.h"
+
+// Audio device that mixes effects on the CPU and sends the samples to a sink, so that
+// games can run without XAudio2 (servers, tests, or recording to a file).
+// Music streams still need XAudio2 and don't play on this device.
+class __declspec(uuid("f1d6b9a4-3c7e-4b0e-9d52-6a8e1c7f24b3"))
+	MixerAudioDevice
+	: public ff::ComBase
+	, public ff::IAudioDevice
+	, public ff::IMixerAudioDevice
+{
+public:
+	DECLARE_HEADER(MixerAudioDevice);
+
+	virtual HRESULT _Construct(IUnknown* unkOuter) override;
+	bool Init(std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime);
+
+	// IAudioDevice functions
+	virtual bool IsValid() const override;
+	virtual void Destroy() override;
+	virtual bool Reset() override;
+
+	virtual void Stop() override;
+	virtual void Start() override;
+
+	virtual float GetVolume(ff::AudioVoiceType type) const override;
+	virtual void SetVolume(ff::AudioVoiceType type, float volume) override;
+
+	virtual void AdvanceEffects() override;
+	virtual void StopEffects() override;
+	virtual void PauseEffects() override;
+	virtual void ResumeEffects() override;
+
+	virtual void AddChild(ff::IAudioDeviceChild* child) override;
+	virtual void RemoveChild(ff::IAudioDeviceChild* child) override;
+	virtual void AddPlaying(ff::IAudioPlaying* child) override;
+	virtual void RemovePlaying(ff::IAudioPlaying* child) override;
+
+	virtual ff::IXAudioDevice* AsXAudioDevice() override;
+	virtual ff::IMixerAudioDevice* AsMixerAudioDevice() override;
+
+	// IMixerAudioDevice
+	virtual ff::AudioMixer* GetMixer() override;
+	virtual size_t PlayEffect(const ff::AudioMixerSource& source, IUnknown* owner, float volume, float freqRatio, bool startPlaying) override;
+	virtual bool RenderFrames(size_t frameCount) override;
+
+private:
+	struct VoiceData
+	{
+		size_t _voice;
+		ff::ComPtr<IUnknown> _owner;
+	};
+
+	void RenderThread();
+
+	static const size_t RENDER_FRAMES_PER_SECOND = 100;
+
+	ff::Mutex _mutex;
+	ff::Mutex _renderMutex; // Rendering, and running commands outside of a render
+	ff::ComPtr<ff::IAudioFactory> _factory;
+	std::unique_ptr<ff::AudioMixer> _mixer;
+	std::shared_ptr<ff::IAudioMixerSink> _sink;
+	ff::Vector<VoiceData> _voiceData;
+	ff::Vector<ff::IAudioDeviceChild*> _children;
+	ff::Vector<ff::IAudioPlaying*> _playing;
+	ff::Vector<ff::IAudioPlaying*> _paused;
+	ff::WinHandle _stopEvent;
+	ff::WinHandle _stoppedEvent;
+	bool _realTime;
+	bool _running;
+};
+
+BEGIN_INTERFACES(MixerAudioDevice)
+	HAS_INTERFACE(ff::IAudioDevice)
+END_INTERFACES()
+
+bool CreateMixerAudioDevice(ff::IAudioFactory* factory, std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime, ff::IAudioDevice** device)
+{
+	assertRetVal(device, false);
+	*device = nullptr;
+
+	ff::ComPtr<MixerAudioDevice, ff::IAudioDevice> pDevice;
+	assertHrRetVal(ff::ComAllocator<MixerAudioDevice>::CreateInstance(factory, &pDevice), false);
+	assertRetVal(pDevice->Init(sink, channels, sampleRate, realTime), false);
+
+	*device = pDevice.Detach();
+	return true;
+}
+
+MixerAudioDevice::MixerAudioDevice()
+	: _realTime(false)
+	, _running(false)
+{
+}
+
+MixerAudioDevice::~MixerAudioDevice()
+{
+	assert(!_children.Size());
+
+	Destroy();
+
+	if (_factory)
+	{
+		_factory->RemoveChild(this);
+	}
+}
+
+HRESULT MixerAudioDevice::_Construct(IUnknown* unkOuter)
+{
+	assertRetVal(_factory.QueryFrom(unkOuter), E_INVALIDARG);
+	_factory->AddChild(this);
+
+	return ff::ComBase::_Construct(unkOuter);
+}
+
+bool MixerAudioDevice::Init(std::shared_ptr<ff::IAudioMixerSink> sink, size_t channels, size_t sampleRate, bool realTime)
+{
+	assertRetVal(sink && !_mixer, false);
+
+	_mixer = std::make_unique<ff::AudioMixer>(channels ? channels : 2, sampleRate ? sampleRate : 48000);
+	_sink = sink;
+	_realTime = realTime;
+	_stopEvent = ff::CreateEvent();
+	_stoppedEvent = ff::CreateEvent();
+
+	Start();
+
+	return true;
+}
+
+bool MixerAudioDevice::IsValid() const
+{
+	return true;
+}
+
+void MixerAudioDevice::Destroy()
+{
+	for (size_t i = 0; i < _children.Size(); i++)
+	{
+		_children[i]->Reset();
+	}
+
+	Stop();
+
+	// Nothing is rendering now, and the next render stops these voices before reading their data
+	ff::LockMutex lock(_mutex);
+
+	for (const VoiceData& data : _voiceData)
+	{
+		if (!_mixer->Stop(data._voice))
+		{
+			// The render thread is stopped, so make room in the command queue here
+			ff::LockMutex renderLock(_renderMutex);
+			_mixer->RunCommands();
+			verify(_mixer->Stop(data._voice));
+		}
+	}
+
+	_voiceData.Clear();
+}
+
+bool MixerAudioDevice::Reset()
+{
+	Destroy();
+	Start();
+
+	return true;
+}
+
+void MixerAudioDevice::Stop()
+{
+	StopEffects();
+
+	if (_running)
+	{
+		_running = false;
+		::SetEvent(_stopEvent);
+		ff::WaitForEventAndReset(_stoppedEvent);
+		::ResetEvent(_stopEvent);
+	}
+}
+
+void MixerAudioDevice::Start()
+{
+	if (_realTime && !_running)
+	{
+		_running = true;
+
+		ff::GetThreadPool()->AddThread([this]()
+			{
+				RenderThread();
+			});
+	}
+}
+
+float MixerAudioDevice::GetVolume(ff::AudioVoiceType type) const
+{
+	return _mixer->GetBusVolume(type);
+}
+
+void MixerAudioDevice::SetVolume(ff::AudioVoiceType type, float volume)
+{
+	if (!_mixer->SetBusVolume(type, volume))
+	{
+		// The command queue is full, so make room for the volume change
+		ff::LockMutex renderLock(_renderMutex);
+		_mixer->RunCommands();
+		verify(_mixer->SetBusVolume(type, volume));
+	}
+}
+
+void MixerAudioDevice::AdvanceEffects()
+{
+	for (auto i = _playing.crbegin(); i != _playing.crend(); i++)
+	{
+		(*i)->Advance();
+	}
+
+	if (!_realTime)
+	{
+		// Commands would otherwise wait for the next RenderFrames, and the queue could fill up before then
+		ff::LockMutex renderLock(_renderMutex);
+		_mixer->RunCommands();
+	}
+
+	// Sources can go away once the mixer is done with them
+	ff::LockMutex lock(_mutex);
+
+	for (size_t i = _voiceData.Size(); i > 0; i--)
+	{
+		if (_mixer->IsVoiceDone(_voiceData[i - 1]._voice))
+		{
+			_voiceData.Delete(i - 1);
+		}
+	}
+}
+
+void MixerAudioDevice::StopEffects()
+{
+	for (size_t i = 0; i < _playing.Size(); i++)
+	{
+		_playing[i]->Stop();
+	}
+}
+
+void MixerAudioDevice::PauseEffects()
+{
+	ff::Vector<ff::IAudioPlaying*> paused;
+
+	for (size_t i = 0; i < _playing.Size(); i++)
+	{
+		ff::IAudioPlaying* playing = _playing[i];
+		if (!playing->IsPaused())
+		{
+			paused.Push(playing);
+			playing->Pause();
+		}
+	}
+
+	ff::LockMutex lock(_mutex);
+
+	for (ff::IAudioPlaying* playing : paused)
+	{
+		if (!_paused.Contains(playing))
+		{
+			_paused.Push(playing);
+		}
+	}
+}
+
+void MixerAudioDevice::ResumeEffects()
+{
+	ff::LockMutex lock(_mutex);
+	ff::Vector<ff::IAudioPlaying*> paused = std::move(_paused);
+	lock.Unlock();
+
+	for (ff::IAudioPlaying* playing : paused)
+	{
+		playing->Resume();
+	}
+}
+
+void MixerAudioDevice::AddChild(ff::IAudioDeviceChild* child)
+{
+	ff::LockMutex lock(_mutex);
+
+	assert(child && _children.Find(child) == ff::INVALID_SIZE);
+	_children.Push(child);
+}
+
+void MixerAudioDevice::RemoveChild(ff::IAudioDeviceChild* child)
+{
+	ff::LockMutex lock(_mutex);
+
+	verify(_children.DeleteItem(child));
+}
+
+void MixerAudioDevice::AddPlaying(ff::IAudioPlaying* child)
+{
+	ff::LockMutex lock(_mutex);
+
+	assert(child && _playing.Find(child) == ff::INVALID_SIZE);
+	_playing.Push(child);
+}
+
+void MixerAudioDevice::RemovePlaying(ff::IAudioPlaying* child)
+{
+	ff::LockMutex lock(_mutex);
+
+	_paused.DeleteItem(child);
+	verify(_playing.DeleteItem(child));
+}
+
+ff::IXAudioDevice* MixerAudioDevice::AsXAudioDevice()
+{
+	return nullptr;
+}
+
+ff::IMixerAudioDevice* MixerAudioDevice::AsMixerAudioDevice()
+{
+	return this;
+}
+
+ff::AudioMixer* MixerAudioDevice::GetMixer()
+{
+	return _mixer.get();
+}
+
+size_t MixerAudioDevice::PlayEffect(const ff::AudioMixerSource& source, IUnknown* owner, float volume, float freqRatio, bool startPlaying)
+{
+	size_t voice = _mixer->Play(source, ff::AudioVoiceType::EFFECTS, volume, freqRatio, startPlaying);
+	noAssertRetVal(voice, 0);
+
+	ff::LockMutex lock(_mutex);
+	_voiceData.Push(VoiceData{ voice, owner });
+
+	return voice;
+}
+
+bool MixerAudioDevice::RenderFrames(size_t frameCount)
+{
+	assertRetVal(!_realTime, false);
+
+	ff::LockMutex renderLock(_renderMutex);
+	return _mixer->Render(_sink.get(), frameCount);
+}
+
+void MixerAudioDevice::RenderThread()
+{
+	::SetThreadDescription(::GetCurrentThread(), L"ff : Audio Mixer");
+
+	const size_t blockFrames = _mixer->GetSampleRate() / RENDER_FRAMES_PER_SECOND;
+	size_t renderedFrames = 0;
+	ff::Timer timer;
+
+	// Stays one block ahead of the clock, and waits on the stop event between blocks
+	do
+	{
+		timer.Tick();
+		size_t dueFrames = (size_t)(timer.GetClockSeconds() * _mixer->GetSampleRate()) + blockFrames;
+
+		while (renderedFrames + blockFrames <= dueFrames)
+		{
+			ff::LockMutex renderLock(_renderMutex);
+			verify(_mixer->Render(_sink.get(), blockFrames));
+			renderedFrames += blockFrames;
+		}
+	}
+	while (::WaitForSingleObject(_stopEvent, (DWORD)(1000 / RENDER_FRAMES_PER_SECOND / 2)) == WAIT_TIMEOUT);
+
+	::SetEvent(_stoppedEvent);
+}
@@ -22,6 +22,12 @@ bool ff::AssertCore(const wchar_t* szExp, const wchar_t* szText, const wchar_t*
 		szFile ? szFile : L"",
 		nLine);
 
+	// Text that was traced on the way to the assert must not wait for the log's flush thread
+	if (ff::ProcessGlobals::Exists())
+	{
+		ff::ProcessGlobals::Get()->GetLog().Flush();
+	}
+
 	bool mainThread =
 		ff::GetMainThreadDispatch() &&
 		ff::GetMainThreadDispatch()->IsCurrentThread();
@@ -198,8 +198,16 @@ void ff::SmallDict::Reserve(size_t newAllocated, bool allowEmptySpace)
 			newAllocated = std::max<size_t>(ff::NearestPowerOfTwo(newAllocated), 4);
 		}
 
-		size_t byteSize = sizeof(Data) + newAllocated * sizeof(Entry) - sizeof(Entry);
+		size_t byteSize = GetDataByteSize(newAllocated);
 		_data = (Data*)_aligned_realloc(_data, byteSize, alignof(Data));
+
+		if (oldAllocated)
+		{
+			ff::TrackMemoryFree(ff::MemoryTag::Dict, GetDataByteSize(oldAllocated));
+		}
+
+		ff::TrackMemoryAlloc(ff::MemoryTag::Dict, byteSize);
+
 		_data->allocated = newAllocated;
 		_data->size = oldAllocated ? _data->size : 0;
 	}
@@ -213,8 +221,17 @@ void ff::SmallDict::Clear()
 		_data->entries[i].value->Release();
 	}
 
-	_aligned_free(_data);
-	_data = nullptr;
+	if (_data)
+	{
+		ff::TrackMemoryFree(ff::MemoryTag::Dict, GetDataByteSize(_data->allocated));
+		_aligned_free(_data);
+		_data = nullptr;
+	}
+}
+
+size_t ff::SmallDict::GetDataByteSize(size_t allocated)
+{
+	return sizeof(Data) + allocated * sizeof(Entry) - sizeof(Entry);
 }
 
 ff::StringCache& ff::SmallDict::GetAtomizer() const
@@ -36,6 +36,7 @@ namespace ff
 
 	private:
 		ff::StringCache& GetAtomizer() const;
+		static size_t GetDataByteSize(size_t allocated);
 
 		struct Entry
 		{
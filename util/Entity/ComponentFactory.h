@@ -51,7 +51,7 @@ template<typename T>
 std::unique_ptr<ff::ComponentFactory> ff::ComponentFactory::Create()
 {
 	return std::make_unique<ComponentFactory>(
-		std::make_unique<ff::BytePoolAllocator<sizeof(T), alignof(T), false>>(),
+		std::make_unique<ff::BytePoolAllocator<sizeof(T), alignof(T), false>>(L"Component", ff::MemoryTag::Component),
 		[](void* component, const void* sourceComponent)
 		{
 			::new(component) T(*reinterpret_cast<const T*>(sourceComponent));
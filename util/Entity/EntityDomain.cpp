@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Entity/EntityDomain.h"
+#include "Globals/Profiler.h"
 
 ff::EntityDomain::EntityDomain()
 	: _lastEntityHash(0)
@@ -88,6 +89,8 @@ void ff::EntityDomain::DeleteEntity(Entity entity)
 
 void ff::EntityDomain::DeleteEntities()
 {
+	PROFILE_ZONE(L"Delete entities");
+
 	while (_entities.Size())
 	{
 		DeleteEntity(_entities.GetLast());
@@ -470,6 +473,7 @@ void ff::EntityDomain::TriggerEvent(hash_t eventId, void* args)
 void ff::EntityDomain::TriggerEvent(EventHandlerEntry* eventEntry, Entity entity, void* args)
 {
 	assertRet(eventEntry && eventEntry->_eventId != ENTITY_EVENT_ANY);
+	PROFILE_ZONE(L"Entity event");
 
 	// Call listeners for the specific entity first
 	if (entity)
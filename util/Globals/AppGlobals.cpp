@@ -7,12 +7,14 @@
 #include "Dict/DictPersist.h"
 #include "Globals/GlobalsScope.h"
 #include "Globals/ProcessGlobals.h"
+#include "Globals/Profiler.h"
 #include "Globals/AppGlobals.h"
 #include "Graph/GraphDevice.h"
 #include "Graph/GraphFactory.h"
 #include "Graph/RenderTarget/RenderDepth.h"
 #include "Graph/RenderTarget/RenderTargetWindow.h"
 #include "Graph/State/GraphContext11.h"
+#include "Graph/Texture/TextureResidency.h"
 #include "Input/DeviceEvent.h"
 #include "Input/Joystick/JoystickInput.h"
 #include "Resource/ResourcePersist.h"
@@ -533,6 +535,7 @@ bool ff::AppGlobals::InitializeGraphics()
 
 	::WriteLog(L"APP_INIT_DIRECT3D");
 	assertRetVal(_graph = ff::ProcessGlobals::Get()->GetGraphicFactory()->CreateDevice(), false);
+	_graph->GetTextureResidency().SetBudget(_helper->GetTextureBudget(this));
 
 	return true;
 }
@@ -733,6 +736,7 @@ void ff::AppGlobals::GameThread()
 
 	_gameState->SaveState(this);
 	_gameState = nullptr;
+	RemoveDebugPage(&_graph->GetTextureResidency());
 	_helper->OnGameThreadShutdown(this);
 	_gameLoopDispatch->Flush();
 	_gameLoopDispatch = nullptr;
@@ -745,6 +749,7 @@ void ff::AppGlobals::EnsureGameState()
 	if (_debugPageState == nullptr)
 	{
 		_debugPageState = std::make_shared<DebugPageState>(this);
+		AddDebugPage(&_graph->GetTextureResidency());
 	}
 
 	_helper->OnGameThreadInitialized(this);
@@ -861,6 +866,9 @@ void ff::AppGlobals::KillPendingInput()
 
 void ff::AppGlobals::FrameAdvanceAndRender()
 {
+	ff::ProfileFrame();
+	PROFILE_ZONE(L"Frame");
+
 	FrameAdvanceResources();
 
 	AdvanceType advanceType = FrameStartTimer();
@@ -871,7 +879,10 @@ void ff::AppGlobals::FrameAdvanceAndRender()
 			FrameAdvanceResources();
 		}
 
-		_gameState->Advance(this);
+		{
+			PROFILE_ZONE(L"Advance");
+			_gameState->Advance(this);
+		}
 
 		if (_frameTime._advanceCount > 0 && _frameTime._advanceCount <= _frameTime._advanceTime.size())
 		{
@@ -885,6 +896,8 @@ void ff::AppGlobals::FrameAdvanceAndRender()
 
 void ff::AppGlobals::FrameAdvanceResources()
 {
+	PROFILE_ZONE(L"Advance input");
+
 	_gameLoopDispatch->Flush();
 	_graphCommands.Flush(this);
 
@@ -1006,6 +1019,8 @@ bool ff::AppGlobals::FrameAdvanceTimer(AdvanceType advanceType)
 
 void ff::AppGlobals::FrameRender(AdvanceType advanceType)
 {
+	PROFILE_ZONE(L"Render");
+
 	_gameState->OnFrameRendering(this, advanceType);
 
 	_target->Clear();
@@ -1013,6 +1028,7 @@ void ff::AppGlobals::FrameRender(AdvanceType advanceType)
 
 	_frameTime._renderTime = _timer.GetCurrentStoredRawTime();
 	_frameTime._graphCounters = _graph->ResetDrawCount();
+	_graph->GetTextureResidency().AdvanceFrame();
 	_globalTime._renderCount++;
 
 	_gameState->OnFrameRendered(this, advanceType, _target, _depth);
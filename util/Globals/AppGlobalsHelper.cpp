@@ -38,6 +38,11 @@ ff::AdvanceType ff::IAppGlobalsHelper::GetAdvanceType(ff::AppGlobals* globals)
 	return ff::AdvanceType::Running;
 }
 
+size_t ff::IAppGlobalsHelper::GetTextureBudget(ff::AppGlobals* globals)
+{
+	return 0;
+}
+
 ff::String ff::IAppGlobalsHelper::GetWindowName()
 {
 	return ff::GetMainModule()->GetName();
@@ -24,6 +24,7 @@ namespace ff
 		UTIL_API virtual std::shared_ptr<State> CreateInitialState(AppGlobals* globals);
 		UTIL_API virtual double GetTimeScale(AppGlobals* globals);
 		UTIL_API virtual AdvanceType GetAdvanceType(AppGlobals* globals);
+		UTIL_API virtual size_t GetTextureBudget(AppGlobals* globals); // bytes, zero means no budget
 		UTIL_API virtual String GetWindowName();
 	};
 }
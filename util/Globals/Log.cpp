@@ -3,15 +3,462 @@
 #include "Data/DataWriterReader.h"
 #include "Globals/Log.h"
 #include "Globals/ProcessGlobals.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/SpscRing.h"
+#include "Types/Timer.h"
 #include "Windows/FileUtil.h"
 
+static const size_t LOG_THREAD_BUFFER_SIZE = 64 * 1024;
+static const size_t LOG_MAX_RECORD_SIZE = 4096;
+static const size_t LOG_MAX_SPEC_LENGTH = 48;
+static const DWORD LOG_FLUSH_MS = 20;
+static std::atomic<UINT64> s_nextLogId = 1;
+
+enum LogRecordType : UINT16
+{
+	LOG_RECORD_TEXT, // payload is the text without a null terminator
+	LOG_RECORD_FORMAT, // payload is the format string with a null terminator, then the captured arguments
+};
+
+// Every record size is a multiple of two bytes, so text in the payload is always aligned
+struct LogRecordHeader
+{
+	INT64 _time;
+	UINT32 _size; // payload bytes after the header
+	LogRecordType _type;
+	UINT16 _newLine;
+};
+
+enum LogArgType
+{
+	LOG_ARG_NONE, // %%
+	LOG_ARG_INT32,
+	LOG_ARG_INT64,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_POINTER,
+	LOG_ARG_WIDE_STRING, // captured as UINT32 length, then the chars and a null terminator
+	LOG_ARG_NARROW_STRING, // same, but padded to an even byte count
+};
+
+struct LogFormatSpec
+{
+	const wchar_t* _end; // after the conversion character
+	LogArgType _type;
+	size_t _stars; // width and precision that come from int arguments
+};
+
+static const UINT32 LOG_NULL_STRING = 0xFFFFFFFF;
+
+struct ff::LogThreadBuffer
+{
+	LogThreadBuffer()
+		: _ring(LOG_THREAD_BUFFER_SIZE)
+		, _abandoned(false)
+		, _closed(false)
+	{
+	}
+
+	ff::SpscRing<BYTE> _ring;
+	std::atomic<bool> _abandoned; // the thread exited, so delete the buffer once it's empty
+	std::atomic<bool> _closed; // the log stopped reading this buffer
+};
+
+struct LogThreadCacheEntry
+{
+	UINT64 _logId;
+	std::shared_ptr<ff::LogThreadBuffer> _buffer;
+};
+
+// Each thread remembers its buffer for every log that it wrote to
+class LogThreadCache
+{
+public:
+	~LogThreadCache()
+	{
+		for (LogThreadCacheEntry& entry : _entries)
+		{
+			entry._buffer->_abandoned = true;
+		}
+	}
+
+	ff::Vector<LogThreadCacheEntry> _entries;
+};
+
+static thread_local LogThreadCache s_logThreadCache;
+
+// Understands the Microsoft wide printf syntax: %[flags][width][.precision][size]type
+static bool ParseFormatSpec(const wchar_t* start, LogFormatSpec& spec)
+{
+	const wchar_t* p = start + 1;
+	spec._stars = 0;
+
+	if (*p == L'%')
+	{
+		spec._end = p + 1;
+		spec._type = LOG_ARG_NONE;
+		return true;
+	}
+
+	while (*p == L'-' || *p == L'+' || *p == L' ' || *p == L'#' || *p == L'0')
+	{
+		p++;
+	}
+
+	// Width, then precision
+	for (bool precision = false; ; precision = true)
+	{
+		if (*p == L'*')
+		{
+			spec._stars++;
+			p++;
+		}
+		else
+		{
+			while (*p >= L'0' && *p <= L'9')
+			{
+				p++;
+			}
+		}
+
+		if (precision || *p != L'.')
+		{
+			break;
+		}
+
+		p++;
+	}
+
+	size_t intSize = sizeof(int);
+	bool narrow = false;
+	bool wide = false;
+
+	switch (*p)
+	{
+	case L'h':
+		p += (p[1] == L'h') ? 2 : 1;
+		narrow = true;
+		break;
+
+	case L'l':
+		if (p[1] == L'l')
+		{
+			intSize = sizeof(long long);
+			p++;
+		}
+		p++;
+		wide = true;
+		break;
+
+	case L'w':
+		p++;
+		wide = true;
+		break;
+
+	case L'L':
+		p++;
+		break;
+
+	case L'j':
+		intSize = sizeof(intmax_t);
+		p++;
+		break;
+
+	case L'z':
+		intSize = sizeof(size_t);
+		p++;
+		break;
+
+	case L't':
+		intSize = sizeof(ptrdiff_t);
+		p++;
+		break;
+
+	case L'I':
+		if (p[1] == L'6' && p[2] == L'4')
+		{
+			intSize = sizeof(INT64);
+			p += 3;
+		}
+		else if (p[1] == L'3' && p[2] == L'2')
+		{
+			intSize = sizeof(INT32);
+			p += 3;
+		}
+		else
+		{
+			intSize = sizeof(size_t);
+			p++;
+		}
+		break;
+	}
+
+	switch (*p)
+	{
+	case L'd': case L'i': case L'o': case L'u': case L'x': case L'X':
+		spec._type = (intSize == sizeof(INT64)) ? LOG_ARG_INT64 : LOG_ARG_INT32;
+		break;
+
+	case L'c': case L'C':
+		spec._type = LOG_ARG_INT32;
+		break;
+
+	case L'e': case L'E': case L'f': case L'F': case L'g': case L'G': case L'a': case L'A':
+		spec._type = LOG_ARG_DOUBLE;
+		break;
+
+	case L'p':
+		spec._type = LOG_ARG_POINTER;
+		break;
+
+	case L's':
+		spec._type = narrow ? LOG_ARG_NARROW_STRING : LOG_ARG_WIDE_STRING;
+		break;
+
+	case L'S':
+		spec._type = wide ? LOG_ARG_WIDE_STRING : LOG_ARG_NARROW_STRING;
+		break;
+
+	default:
+		// %n, %Z, and anything unknown get formatted by the caller
+		return false;
+	}
+
+	spec._end = p + 1;
+	return (size_t)(spec._end - start) <= LOG_MAX_SPEC_LENGTH;
+}
+
+template<typename T>
+static bool CaptureValue(BYTE*& pos, BYTE* end, T value)
+{
+	noAssertRetVal((size_t)(end - pos) >= sizeof(T), false);
+	std::memcpy(pos, &value, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
+
+template<typename CharT>
+static bool CaptureString(BYTE*& pos, BYTE* end, const CharT* str)
+{
+	size_t len = str ? std::char_traits<CharT>::length(str) : 0;
+	size_t bytes = (len + 1) * sizeof(CharT);
+	bytes += bytes % 2;
+
+	noAssertRetVal(::CaptureValue<UINT32>(pos, end, str ? (UINT32)len : LOG_NULL_STRING), false);
+	noAssertRetVal((size_t)(end - pos) >= bytes, false);
+
+	std::memset(pos, 0, bytes);
+	if (len)
+	{
+		std::memcpy(pos, str, len * sizeof(CharT));
+	}
+
+	pos += bytes;
+	return true;
+}
+
+// Returns the record size, or zero if the arguments have to be formatted right away
+static size_t CaptureFormat(BYTE* record, const wchar_t* format, va_list args, bool newLine)
+{
+	BYTE* end = record + LOG_MAX_RECORD_SIZE;
+	BYTE* pos = record + sizeof(LogRecordHeader);
+	size_t formatBytes = (wcslen(format) + 1) * sizeof(wchar_t);
+
+	noAssertRetVal((size_t)(end - pos) >= formatBytes, 0);
+	std::memcpy(pos, format, formatBytes);
+	pos += formatBytes;
+
+	for (const wchar_t* p = wcschr(format, L'%'); p; p = wcschr(p, L'%'))
+	{
+		LogFormatSpec spec;
+		noAssertRetVal(::ParseFormatSpec(p, spec), 0);
+		p = spec._end;
+
+		for (size_t i = 0; i < spec._stars; i++)
+		{
+			noAssertRetVal(::CaptureValue(pos, end, va_arg(args, int)), 0);
+		}
+
+		switch (spec._type)
+		{
+		case LOG_ARG_INT32:
+			noAssertRetVal(::CaptureValue(pos, end, va_arg(args, INT32)), 0);
+			break;
+
+		case LOG_ARG_INT64:
+			noAssertRetVal(::CaptureValue(pos, end, va_arg(args, INT64)), 0);
+			break;
+
+		case LOG_ARG_DOUBLE:
+			noAssertRetVal(::CaptureValue(pos, end, va_arg(args, double)), 0);
+			break;
+
+		case LOG_ARG_POINTER:
+			noAssertRetVal(::CaptureValue(pos, end, va_arg(args, void*)), 0);
+			break;
+
+		case LOG_ARG_WIDE_STRING:
+			noAssertRetVal(::CaptureString(pos, end, va_arg(args, const wchar_t*)), 0);
+			break;
+
+		case LOG_ARG_NARROW_STRING:
+			noAssertRetVal(::CaptureString(pos, end, va_arg(args, const char*)), 0);
+			break;
+		}
+	}
+
+	size_t size = pos - record;
+	LogRecordHeader header{ ff::Timer::GetCurrentRawTime(), (UINT32)(size - sizeof(LogRecordHeader)), LOG_RECORD_FORMAT, (UINT16)newLine };
+	std::memcpy(record, &header, sizeof(header));
+
+	return size;
+}
+
+template<typename T>
+static T ReadValue(const BYTE*& pos)
+{
+	T value;
+	std::memcpy(&value, pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+template<typename CharT>
+static const CharT* ReadString(const BYTE*& pos)
+{
+	UINT32 len = ::ReadValue<UINT32>(pos);
+	const CharT* str = (len != LOG_NULL_STRING) ? (const CharT*)pos : nullptr;
+
+	// A null string was captured as an empty one
+	size_t bytes = (str ? len + 1 : 1) * sizeof(CharT);
+	pos += bytes + bytes % 2;
+
+	return str;
+}
+
+static void FormatArgs(const wchar_t* format, const BYTE* args, ff::String& output)
+{
+	std::array<wchar_t, 1024> buffer;
+	std::array<wchar_t, LOG_MAX_SPEC_LENGTH * 2> specText;
+	const wchar_t* literal = format;
+
+	for (const wchar_t* p = wcschr(format, L'%'); p; p = wcschr(p, L'%'))
+	{
+		output.append(literal, p);
+
+		LogFormatSpec spec;
+		verify(::ParseFormatSpec(p, spec));
+
+		// Put the captured width and precision right into the spec
+		wchar_t* spec2 = specText.data();
+		for (const wchar_t* p2 = p; p2 != spec._end; p2++)
+		{
+			if (*p2 != L'*')
+			{
+				*spec2++ = *p2;
+				continue;
+			}
+
+			int value = ::ReadValue<int>(args);
+			if (value < 0 && spec2[-1] == L'.')
+			{
+				// Negative precision is the same as no precision
+				spec2--;
+			}
+			else
+			{
+				spec2 += _snwprintf_s(spec2, specText.data() + specText.size() - spec2, _TRUNCATE, L"%d", value);
+			}
+		}
+
+		*spec2 = 0;
+		wchar_t* out = buffer.data();
+		int count = 0;
+
+		switch (spec._type)
+		{
+		case LOG_ARG_NONE:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data());
+			break;
+
+		case LOG_ARG_INT32:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadValue<INT32>(args));
+			break;
+
+		case LOG_ARG_INT64:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadValue<INT64>(args));
+			break;
+
+		case LOG_ARG_DOUBLE:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadValue<double>(args));
+			break;
+
+		case LOG_ARG_POINTER:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadValue<void*>(args));
+			break;
+
+		case LOG_ARG_WIDE_STRING:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadString<wchar_t>(args));
+			break;
+
+		case LOG_ARG_NARROW_STRING:
+			count = _snwprintf_s(out, buffer.size(), _TRUNCATE, specText.data(), ::ReadString<char>(args));
+			break;
+		}
+
+		output.append(out, (count >= 0) ? (size_t)count : wcslen(out));
+		literal = p = spec._end;
+	}
+
+	output.append(literal);
+}
+
+static void FormatRecord(const BYTE* record, ff::String& output)
+{
+	LogRecordHeader header;
+	std::memcpy(&header, record, sizeof(header));
+	const BYTE* payload = record + sizeof(header);
+
+	switch (header._type)
+	{
+	case LOG_RECORD_TEXT:
+		output.append((const wchar_t*)payload, header._size / sizeof(wchar_t));
+		break;
+
+	case LOG_RECORD_FORMAT:
+		{
+			const wchar_t* format = (const wchar_t*)payload;
+			::FormatArgs(format, payload + (wcslen(format) + 1) * sizeof(wchar_t), output);
+		}
+		break;
+	}
+
+	if (header._newLine)
+	{
+		output.append(L"\r\n", 2);
+	}
+}
+
+static INT64 GetRecordTime(const BYTE* record)
+{
+	INT64 time;
+	std::memcpy(&time, record + offsetof(LogRecordHeader, _time), sizeof(time));
+	return time;
+}
+
 ff::Log::Log()
 	: _console(false)
+	, _id(s_nextLogId++)
+	, _async(false)
+	, _dropped(0)
+	, _droppedReported(0)
+	, _flushing(false)
 {
 }
 
 ff::Log::~Log()
 {
+	StopFlushThread();
+	Flush();
 }
 
 bool ff::Log::GetConsoleOutput() const
@@ -47,6 +494,9 @@ bool ff::Log::AddWriter(IDataWriter* pWriter)
 	ff::LockMutex lock(_mutex);
 
 	assertRetVal(_writers.Find(pWriter) == ff::INVALID_SIZE, false);
+
+	// Older text doesn't go to the new writer
+	FlushBuffers();
 	_writers.Push(pWriter);
 
 	return true;
@@ -60,6 +510,8 @@ bool ff::Log::RemoveWriter(IDataWriter* writer)
 
 	size_t i = _writers.Find(writer);
 	assertRetVal(i != ff::INVALID_SIZE, false);
+
+	FlushBuffers();
 	_writers.Delete(i);
 
 	return true;
@@ -69,34 +521,67 @@ void ff::Log::RemoveAllWriters()
 {
 	ff::LockMutex lock(_mutex);
 
+	FlushBuffers();
 	_writers.Clear();
 }
 
-void ff::Log::Trace(const wchar_t* szText)
+bool ff::Log::StartFlushThread()
 {
-	assertRet(szText);
+	ff::LockMutex lock(_mutex);
+	noAssertRetVal(!_async, true);
 
-	if (!_writers.IsEmpty())
+	_flushEvent = ff::CreateEvent(false, false);
+	_stoppedEvent = ff::CreateEvent();
+	assertRetVal(_flushEvent && _stoppedEvent, false);
+
+	_async = true;
+	if (!::TrySubmitThreadpoolCallback(Log::FlushThreadCallback, this, nullptr))
 	{
-		ff::LockMutex lock(_mutex);
+		_async = false;
+		assertRetVal(false, false);
+	}
 
-		if (!_writers.IsEmpty())
-		{
-			DWORD nBytes = (DWORD)(wcslen(szText) * sizeof(wchar_t));
+	return true;
+}
 
-			for (IDataWriter* writer : _writers)
-			{
-				writer->Write(szText, nBytes);
-			}
-		}
+void ff::Log::StopFlushThread()
+{
+	{
+		ff::LockMutex lock(_mutex);
+		noAssertRet(_async);
+		_async = false;
 	}
 
-	if (_console)
+	::SetEvent(_flushEvent);
+	ff::WaitForHandle(_stoppedEvent);
+
+	ff::LockMutex lock(_mutex);
+
+	// Threads that saw _async before it changed can still write to their buffers. Closed buffers are
+	// kept until their threads let go of them, and every synchronous trace or flush reads them first.
+	for (const auto& buffer : _buffers)
 	{
-		std::wcout << szText;
+		buffer->_closed = true;
 	}
 
-	DebugTrace(szText);
+	FlushBuffers();
+}
+
+void ff::Log::Flush()
+{
+	ff::LockMutex lock(_mutex);
+	FlushBuffers();
+}
+
+size_t ff::Log::GetDroppedCount() const
+{
+	return _dropped.load(std::memory_order_relaxed);
+}
+
+void ff::Log::Trace(const wchar_t* szText)
+{
+	assertRet(szText);
+	TraceText(szText, wcslen(szText), false);
 }
 
 void ff::Log::TraceF(const wchar_t* szFormat, ...)
@@ -109,16 +594,12 @@ void ff::Log::TraceF(const wchar_t* szFormat, ...)
 
 void ff::Log::TraceV(const wchar_t* szFormat, va_list args)
 {
-	wchar_t sz[1024];
-	_vsnwprintf_s(sz, _countof(sz), _TRUNCATE, szFormat, args);
-	Trace(sz);
+	TraceFormat(szFormat, args, false);
 }
 
 void ff::Log::TraceLine(const wchar_t* szText)
 {
-	String finalText(szText ? szText : L"");
-	finalText += L"\r\n";
-	Trace(finalText.c_str());
+	TraceText(szText ? szText : L"", szText ? wcslen(szText) : 0, true);
 }
 
 void ff::Log::TraceLineF(const wchar_t* szFormat, ...)
@@ -131,9 +612,7 @@ void ff::Log::TraceLineF(const wchar_t* szFormat, ...)
 
 void ff::Log::TraceLineV(const wchar_t* szFormat, va_list args)
 {
-	wchar_t sz[1024];
-	_vsnwprintf_s(sz, _countof(sz), _TRUNCATE, szFormat, args);
-	TraceLine(sz);
+	TraceFormat(szFormat, args, true);
 }
 
 void ff::Log::TraceSpaces(size_t nSpaces)
@@ -200,3 +679,247 @@ void ff::Log::DebugTraceV(const wchar_t* szFormat, va_list args)
 	DebugTrace(buffer.data());
 #endif
 }
+
+bool ff::Log::HasOutput() const
+{
+#ifdef _DEBUG
+	return true;
+#else
+	return _console || !_writers.IsEmpty();
+#endif
+}
+
+void ff::Log::TraceText(const wchar_t* text, size_t chars, bool newLine)
+{
+	noAssertRet(HasOutput());
+
+	LogThreadBuffer* buffer = _async ? GetThreadBuffer() : nullptr;
+	if (!buffer)
+	{
+		ff::LockMutex lock(_mutex);
+		FlushBuffers();
+		WriteText(text, chars);
+
+		if (newLine)
+		{
+			WriteText(L"\r\n", 2);
+		}
+
+		return;
+	}
+
+	// Long text is split over multiple records
+	const size_t maxChars = (LOG_MAX_RECORD_SIZE - sizeof(LogRecordHeader)) / sizeof(wchar_t);
+	std::array<BYTE, LOG_MAX_RECORD_SIZE> record;
+
+	do
+	{
+		size_t recordChars = std::min(chars, maxChars);
+		LogRecordHeader header{ ff::Timer::GetCurrentRawTime(), (UINT32)(recordChars * sizeof(wchar_t)), LOG_RECORD_TEXT, (UINT16)(newLine && recordChars == chars) };
+		std::memcpy(record.data(), &header, sizeof(header));
+		std::memcpy(record.data() + sizeof(header), text, header._size);
+
+		PushRecord(buffer, record.data(), sizeof(header) + header._size);
+		text += recordChars;
+		chars -= recordChars;
+	}
+	while (chars);
+}
+
+void ff::Log::TraceFormat(const wchar_t* format, va_list args, bool newLine)
+{
+	assertRet(format);
+	noAssertRet(HasOutput());
+
+	LogThreadBuffer* buffer = _async ? GetThreadBuffer() : nullptr;
+	if (buffer)
+	{
+		std::array<BYTE, LOG_MAX_RECORD_SIZE> record;
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		size_t size = ::CaptureFormat(record.data(), format, argsCopy, newLine);
+		va_end(argsCopy);
+
+		if (size)
+		{
+			PushRecord(buffer, record.data(), size);
+			return;
+		}
+	}
+
+	wchar_t sz[1024];
+	_vsnwprintf_s(sz, _countof(sz), _TRUNCATE, format, args);
+	TraceText(sz, wcslen(sz), newLine);
+}
+
+bool ff::Log::PushRecord(LogThreadBuffer* buffer, const BYTE* record, size_t size)
+{
+	ff::SpscRing<BYTE>& ring = buffer->_ring;
+	size_t space = ring.GetWriteCount();
+
+	if (space < size)
+	{
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	verify(ring.Write(record, size) == size);
+
+	// Wake up the flush thread early when the buffer gets half full
+	size_t half = ring.GetCapacity() / 2;
+	if (space >= half && space - size < half)
+	{
+		::SetEvent(_flushEvent);
+	}
+
+	return true;
+}
+
+ff::LogThreadBuffer* ff::Log::GetThreadBuffer()
+{
+	for (const LogThreadCacheEntry& entry : s_logThreadCache._entries)
+	{
+		if (entry._logId == _id && !entry._buffer->_closed.load(std::memory_order_relaxed))
+		{
+			return entry._buffer.get();
+		}
+	}
+
+	return AddThreadBuffer();
+}
+
+ff::LogThreadBuffer* ff::Log::AddThreadBuffer()
+{
+	ff::Vector<LogThreadCacheEntry>& entries = s_logThreadCache._entries;
+	for (size_t i = entries.Size(); i > 0; i--)
+	{
+		if (entries[i - 1]._buffer->_closed)
+		{
+			entries.Delete(i - 1);
+		}
+	}
+
+	std::shared_ptr<LogThreadBuffer> buffer = std::make_shared<LogThreadBuffer>();
+	{
+		ff::LockMutex lock(_mutex);
+		noAssertRetVal(_async, nullptr);
+		_buffers.Push(buffer);
+	}
+
+	entries.Push(LogThreadCacheEntry{ _id, buffer });
+	return buffer.get();
+}
+
+void ff::Log::FlushBuffers()
+{
+	noAssertRet(!_flushing);
+	_flushing = true;
+
+	_flushBytes.Clear();
+	_flushRecords.Clear();
+	_flushText.clear();
+
+	for (size_t i = 0; i < _buffers.Size(); )
+	{
+		LogThreadBuffer* buffer = _buffers[i].get();
+		bool abandoned = buffer->_abandoned.load(std::memory_order_acquire);
+
+		// A closed buffer that's only referenced here can't get any more records
+		if (buffer->_closed.load(std::memory_order_relaxed) && _buffers[i].use_count() == 1)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			abandoned = true;
+		}
+
+		size_t count = buffer->_ring.GetReadCount();
+
+		if (count)
+		{
+			size_t start = _flushBytes.Size();
+			_flushBytes.Resize(start + count);
+			buffer->_ring.Read(_flushBytes.Data(start, count), count);
+		}
+
+		if (abandoned)
+		{
+			_buffers.Delete(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	for (size_t pos = 0; pos < _flushBytes.Size(); )
+	{
+		LogRecordHeader header;
+		std::memcpy(&header, _flushBytes.Data(pos, sizeof(header)), sizeof(header));
+		_flushRecords.Push(pos);
+		pos += sizeof(header) + header._size;
+	}
+
+	// Records from each thread are already in order, this only interleaves the threads
+	const BYTE* bytes = _flushBytes.ConstData();
+	std::stable_sort(_flushRecords.begin(), _flushRecords.end(), [bytes](size_t lhs, size_t rhs)
+		{
+			return ::GetRecordTime(bytes + lhs) < ::GetRecordTime(bytes + rhs);
+		});
+
+	for (size_t pos : _flushRecords)
+	{
+		::FormatRecord(bytes + pos, _flushText);
+	}
+
+	size_t dropped = _dropped.load(std::memory_order_relaxed);
+	if (dropped != _droppedReported)
+	{
+		_flushText.append(ff::String::format_new(L"Log: Dropped %lu messages\r\n", dropped - _droppedReported));
+		_droppedReported = dropped;
+	}
+
+	if (_flushText.size())
+	{
+		WriteText(_flushText.c_str(), _flushText.size());
+	}
+
+	_flushing = false;
+}
+
+// The text is always null terminated at chars
+void ff::Log::WriteText(const wchar_t* text, size_t chars)
+{
+	noAssertRet(chars);
+
+	for (IDataWriter* writer : _writers)
+	{
+		writer->Write(text, chars * sizeof(wchar_t));
+	}
+
+	if (_console)
+	{
+		std::wcout.write(text, chars);
+	}
+
+	DebugTrace(text);
+}
+
+void ff::Log::FlushThreadCallback(PTP_CALLBACK_INSTANCE instance, void* context)
+{
+	::CallbackMayRunLong(instance);
+	::DisassociateCurrentThreadFromCallback(instance);
+	::SetThreadDescription(::GetCurrentThread(), L"ff : Log Flush");
+
+	Log* log = (Log*)context;
+	log->FlushThread();
+}
+
+void ff::Log::FlushThread()
+{
+	while (_async)
+	{
+		::WaitForSingleObject(_flushEvent, LOG_FLUSH_MS);
+		Flush();
+	}
+
+	::SetEvent(_stoppedEvent);
+}
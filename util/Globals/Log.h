@@ -1,9 +1,16 @@
 #pragma once
 
+#include "Windows/Handles.h"
+
 namespace ff
 {
 	class IDataWriter;
+	struct LogThreadBuffer;
 
+	// Tracing is synchronous unless the flush thread is started, which is opt-in because a crash loses whatever
+	// hasn't been flushed yet. Then tracing only copies the text or the format string and its arguments into a
+	// lock-free buffer for the calling thread. The flush thread does the formatting and writing. Each thread
+	// buffer has a fixed size, anything that doesn't fit gets dropped and counted. Asserts flush right away.
 	class Log
 	{
 	public:
@@ -18,6 +25,11 @@ namespace ff
 		UTIL_API bool RemoveWriter(IDataWriter* writer);
 		UTIL_API void RemoveAllWriters();
 
+		UTIL_API bool StartFlushThread();
+		UTIL_API void StopFlushThread(); // everything is written synchronously after this, including late records from other threads
+		UTIL_API void Flush(); // writes whatever is waiting in the thread buffers
+		UTIL_API size_t GetDroppedCount() const;
+
 		UTIL_API void Trace(const wchar_t* szText);
 		UTIL_API void TraceF(const wchar_t* szFormat, ...);
 		UTIL_API void TraceV(const wchar_t* szFormat, va_list args);
@@ -35,8 +47,35 @@ namespace ff
 		UTIL_API static void DebugTraceV(const wchar_t* szFormat, va_list args);
 
 	private:
+		bool HasOutput() const;
+		void TraceText(const wchar_t* text, size_t chars, bool newLine);
+		void TraceFormat(const wchar_t* format, va_list args, bool newLine);
+		bool PushRecord(LogThreadBuffer* buffer, const BYTE* record, size_t size);
+		LogThreadBuffer* GetThreadBuffer();
+		LogThreadBuffer* AddThreadBuffer();
+
+		// Must be called with _mutex locked, does nothing when called again while flushing (from an assert)
+		void FlushBuffers();
+		void WriteText(const wchar_t* text, size_t chars);
+
+		static void CALLBACK FlushThreadCallback(PTP_CALLBACK_INSTANCE instance, void* context);
+		void FlushThread();
+
 		ff::Mutex _mutex;
 		bool _console;
 		ff::Vector<ComPtr<IDataWriter>> _writers;
+
+		// Async state
+		UINT64 _id;
+		std::atomic<bool> _async;
+		std::atomic<size_t> _dropped;
+		size_t _droppedReported;
+		bool _flushing;
+		ff::WinHandle _flushEvent;
+		ff::WinHandle _stoppedEvent;
+		ff::Vector<std::shared_ptr<LogThreadBuffer>> _buffers;
+		ff::Vector<BYTE> _flushBytes;
+		ff::Vector<size_t> _flushRecords;
+		ff::String _flushText;
 	};
 }
@@ -94,6 +94,7 @@ void ff::ProcessGlobals::Shutdown()
 	_stringCache.Clear();
 
 	ff::ProcessShutdown::OnShutdown(*this);
+	_log.StopFlushThread();
 	ff::ComBaseEx::DumpComObjects();
 	ff::UnhookCrtMemAlloc();
 }
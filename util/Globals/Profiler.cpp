@@ -0,0 +1,399 @@
+#include "pch.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Profiler.h"
+#include "Types/SpscRing.h"
+#include "Types/Timer.h"
+
+static const size_t PROFILE_THREAD_BUFFER_SIZE = 16384; // events
+static const size_t PROFILE_STATS_FRAMES = 60;
+
+struct ProfileEvent
+{
+	INT64 _time;
+	const ff::ProfileZone* _zone;
+	bool _begin;
+};
+
+struct ProfileOpenZone
+{
+	const ff::ProfileZone* _zone;
+	INT64 _time;
+	INT64 _childTime;
+};
+
+struct ProfileThreadBuffer
+{
+	ProfileThreadBuffer()
+		: _ring(PROFILE_THREAD_BUFFER_SIZE)
+		, _threadId(::GetCurrentThreadId())
+		, _openCount(0)
+		, _abandoned(false)
+	{
+	}
+
+	ff::SpscRing<ProfileEvent> _ring;
+	DWORD _threadId;
+	size_t _openCount; // only used by the thread, the ring always has space to end these zones
+	std::atomic<bool> _abandoned; // the thread exited, so delete the buffer once it's empty
+	ff::Vector<ProfileOpenZone> _stack; // only used by ProfileFrame()
+};
+
+struct ProfileZoneTotals
+{
+	INT64 _self;
+	INT64 _total;
+	size_t _calls;
+};
+
+struct ProfileCaptureEvent
+{
+	INT64 _time;
+	const ff::ProfileZone* _zone; // null at the start of each frame
+	DWORD _threadId;
+	bool _begin;
+};
+
+struct ProfileState
+{
+	ProfileState()
+		: _statsFrames(0)
+		, _captureFramesLeft(0)
+		, _captureStarting(false)
+		, _capturing(false)
+		, _enabledBeforeCapture(false)
+	{
+	}
+
+	ff::Mutex _mutex;
+	ff::Vector<std::shared_ptr<ProfileThreadBuffer>> _buffers;
+	ff::Map<const ff::ProfileZone*, ProfileZoneTotals> _totals;
+	ff::Vector<ff::ProfileZoneStats> _stats;
+	size_t _statsFrames;
+
+	ff::Vector<ProfileCaptureEvent> _capture;
+	size_t _captureFramesLeft;
+	bool _captureStarting;
+	bool _capturing;
+	bool _enabledBeforeCapture;
+};
+
+// Lets the profiler know when a thread exits
+class ProfileThreadLocal
+{
+public:
+	~ProfileThreadLocal()
+	{
+		if (_buffer)
+		{
+			_buffer->_abandoned = true;
+		}
+	}
+
+	std::shared_ptr<ProfileThreadBuffer> _buffer;
+};
+
+static std::atomic<bool> s_profileEnabled = false;
+static std::atomic<size_t> s_profileDropped = 0;
+static thread_local ProfileThreadLocal s_profileThread;
+
+static ProfileState& GetProfileState()
+{
+	static ProfileState s_state;
+	return s_state;
+}
+
+static ProfileThreadBuffer* AddProfileThreadBuffer()
+{
+	s_profileThread._buffer = std::make_shared<ProfileThreadBuffer>();
+
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+	state._buffers.Push(s_profileThread._buffer);
+
+	return s_profileThread._buffer.get();
+}
+
+static void AddEvent(ProfileState& state, ProfileThreadBuffer& buffer, const ProfileEvent& event)
+{
+	if (state._capturing)
+	{
+		state._capture.Push(ProfileCaptureEvent{ event._time, event._zone, buffer._threadId, event._begin });
+	}
+
+	if (event._begin)
+	{
+		buffer._stack.Push(ProfileOpenZone{ event._zone, event._time, 0 });
+		return;
+	}
+
+	assertRet(!buffer._stack.IsEmpty() && buffer._stack.GetLast()._zone == event._zone);
+	ProfileOpenZone open = buffer._stack.GetLast();
+	buffer._stack.Delete(buffer._stack.Size() - 1);
+
+	INT64 total = event._time - open._time;
+	auto i = state._totals.GetKey(open._zone);
+	ProfileZoneTotals& totals = (i ? i : state._totals.SetKey(open._zone, ProfileZoneTotals{ 0 }))->GetEditableValue();
+	totals._self += total - open._childTime;
+	totals._total += total;
+	totals._calls++;
+
+	if (!buffer._stack.IsEmpty())
+	{
+		buffer._stack.GetLast()._childTime += total;
+	}
+}
+
+static void ReadThreadEvents(ProfileState& state, ProfileThreadBuffer& buffer)
+{
+	std::array<ProfileEvent, 256> events;
+
+	for (size_t count = buffer._ring.Read(events.data(), events.size()); count; count = buffer._ring.Read(events.data(), events.size()))
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			::AddEvent(state, buffer, events[i]);
+		}
+	}
+}
+
+static void UpdateStats(ProfileState& state)
+{
+	double frames = (double)state._statsFrames;
+	double secondsScale = 1.0 / (ff::Timer::GetRawFreqStatic() * frames);
+
+	state._stats.Clear();
+
+	for (auto i : state._totals)
+	{
+		const ProfileZoneTotals& totals = i.GetValue();
+		state._stats.Push(ff::ProfileZoneStats{ i.GetKey(), totals._self * secondsScale, totals._total * secondsScale, totals._calls / frames });
+	}
+
+	std::sort(state._stats.begin(), state._stats.end(), [](const ff::ProfileZoneStats& lhs, const ff::ProfileZoneStats& rhs)
+		{
+			return lhs._selfSeconds > rhs._selfSeconds;
+		});
+
+	state._totals.Clear();
+	state._statsFrames = 0;
+}
+
+static void AppendJsonString(ff::String& json, const wchar_t* text)
+{
+	json.append(1, L'\"');
+
+	for (const wchar_t* ch = text ? text : L""; *ch; ch++)
+	{
+		if (*ch == L'\"' || *ch == L'\\')
+		{
+			json.append(1, L'\\');
+			json.append(1, *ch);
+		}
+		else if (*ch < 0x20 || *ch >= 0x80)
+		{
+			// Keeps the whole file ASCII
+			json.append(ff::String::format_new(L"\\u%04x", (unsigned int)*ch));
+		}
+		else
+		{
+			json.append(1, *ch);
+		}
+	}
+
+	json.append(1, L'\"');
+}
+
+void ff::EnableProfiling(bool enable)
+{
+	s_profileEnabled = enable;
+}
+
+bool ff::IsProfilingEnabled()
+{
+	return s_profileEnabled;
+}
+
+bool ff::ProfileBegin(const ProfileZone& zone)
+{
+	noAssertRetVal(s_profileEnabled.load(std::memory_order_relaxed), false);
+
+	ProfileThreadBuffer* buffer = s_profileThread._buffer.get();
+	if (!buffer)
+	{
+		buffer = ::AddProfileThreadBuffer();
+	}
+
+	if (buffer->_ring.GetWriteCount() < buffer->_openCount + 2)
+	{
+		s_profileDropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	buffer->_openCount++;
+	buffer->_ring.Push(ProfileEvent{ ff::Timer::GetCurrentRawTime(), &zone, true });
+
+	return true;
+}
+
+void ff::ProfileEnd(const ProfileZone& zone)
+{
+	ProfileThreadBuffer* buffer = s_profileThread._buffer.get();
+	assertRet(buffer && buffer->_openCount);
+
+	buffer->_openCount--;
+	verify(buffer->_ring.Push(ProfileEvent{ ff::Timer::GetCurrentRawTime(), &zone, false }));
+}
+
+void ff::ProfileFrame()
+{
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+	INT64 frameTime = ff::Timer::GetCurrentRawTime();
+
+	for (size_t i = 0; i < state._buffers.Size(); )
+	{
+		ProfileThreadBuffer& buffer = *state._buffers[i];
+		bool abandoned = buffer._abandoned.load(std::memory_order_acquire);
+		::ReadThreadEvents(state, buffer);
+
+		if (abandoned)
+		{
+			state._buffers.Delete(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if (++state._statsFrames >= PROFILE_STATS_FRAMES)
+	{
+		::UpdateStats(state);
+	}
+
+	if (state._capturing && !--state._captureFramesLeft)
+	{
+		state._capturing = false;
+		s_profileEnabled = state._enabledBeforeCapture;
+	}
+	else if (state._captureStarting)
+	{
+		state._captureStarting = false;
+		state._capturing = true;
+	}
+
+	if (state._capturing)
+	{
+		state._capture.Push(ProfileCaptureEvent{ frameTime, nullptr, ::GetCurrentThreadId(), true });
+	}
+}
+
+ff::Vector<ff::ProfileZoneStats> ff::GetProfileZoneStats(size_t maxCount)
+{
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+
+	ff::Vector<ff::ProfileZoneStats> stats;
+	stats.Push(state._stats.ConstData(), std::min(maxCount, state._stats.Size()));
+	return stats;
+}
+
+size_t ff::GetProfileDroppedCount()
+{
+	return s_profileDropped;
+}
+
+void ff::StartProfileCapture(size_t frameCount)
+{
+	assertRet(frameCount);
+
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+
+	if (!state._captureStarting && !state._capturing)
+	{
+		state._enabledBeforeCapture = s_profileEnabled;
+	}
+
+	state._capture.Clear();
+	state._captureFramesLeft = frameCount;
+	state._captureStarting = true;
+	state._capturing = false;
+	s_profileEnabled = true;
+}
+
+bool ff::IsProfileCapturing()
+{
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+
+	return state._captureStarting || state._capturing;
+}
+
+bool ff::SaveProfileCapture(IDataWriter* writer)
+{
+	assertRetVal(writer, false);
+
+	ProfileState& state = ::GetProfileState();
+	ff::LockMutex lock(state._mutex);
+
+	// Zones that started or ended outside of the capture are left out
+	ff::Map<DWORD, ff::Vector<size_t>> threadStacks;
+	INT64 startTime = state._capture.Size() ? state._capture[0]._time : 0;
+	double microsecondsScale = 1000000.0 / ff::Timer::GetRawFreqStatic();
+	ff::String json(L"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	bool firstEvent = true;
+
+	for (size_t i = 0; i < state._capture.Size(); i++)
+	{
+		const ProfileCaptureEvent& event = state._capture[i];
+		ff::String eventJson(L"{\"name\":");
+
+		if (!event._zone)
+		{
+			eventJson.append(ff::String::format_new(L"\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%lu}",
+				(event._time - startTime) * microsecondsScale,
+				event._threadId));
+		}
+		else if (event._begin)
+		{
+			auto iter = threadStacks.GetKey(event._threadId);
+			(iter ? iter : threadStacks.SetKey(event._threadId, ff::Vector<size_t>()))->GetEditableValue().Push(i);
+			continue;
+		}
+		else
+		{
+			auto iter = threadStacks.GetKey(event._threadId);
+			if (!iter || iter->GetValue().IsEmpty())
+			{
+				continue;
+			}
+
+			ff::Vector<size_t>& stack = iter->GetEditableValue();
+			const ProfileCaptureEvent& beginEvent = state._capture[stack.GetLast()];
+			stack.Delete(stack.Size() - 1);
+
+			::AppendJsonString(eventJson, event._zone->_name);
+			eventJson.append(ff::String::format_new(L",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lu}",
+				(beginEvent._time - startTime) * microsecondsScale,
+				(event._time - beginEvent._time) * microsecondsScale,
+				event._threadId));
+		}
+
+		json.append(firstEvent ? L"\n" : L",\n");
+		json.append(eventJson);
+		firstEvent = false;
+	}
+
+	json.append(L"\n]}\n");
+
+	ff::Vector<char> text;
+	text.Reserve(json.size());
+
+	for (wchar_t ch : json)
+	{
+		text.Push((char)ch);
+	}
+
+	return writer->Write(text.ConstData(), text.ByteSize());
+}
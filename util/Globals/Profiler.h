@@ -0,0 +1,78 @@
+#pragma once
+
+// Define as 0 in a project to compile its profile zones out
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+namespace ff
+{
+	class IDataWriter;
+
+	// Each PROFILE_ZONE has a static one of these, so the name pointer is the zone's identity
+	struct ProfileZone
+	{
+		const wchar_t* _name;
+	};
+
+	// Averaged over the frames of the last stats window
+	struct ProfileZoneStats
+	{
+		const ProfileZone* _zone;
+		double _selfSeconds; // per frame, without nested zones
+		double _totalSeconds; // per frame
+		double _calls; // per frame
+	};
+
+	// Zones are recorded into a lock-free buffer for each thread, ProfileFrame() reads them all
+	UTIL_API void EnableProfiling(bool enable);
+	UTIL_API bool IsProfilingEnabled();
+	UTIL_API bool ProfileBegin(const ProfileZone& zone); // false if the zone isn't being recorded
+	UTIL_API void ProfileEnd(const ProfileZone& zone);
+	UTIL_API void ProfileFrame(); // call once at the start of each frame
+	UTIL_API Vector<ProfileZoneStats> GetProfileZoneStats(size_t maxCount); // slowest self time first
+	UTIL_API size_t GetProfileDroppedCount();
+
+	// Captures every zone for the next frames, and enables profiling until then
+	UTIL_API void StartProfileCapture(size_t frameCount);
+	UTIL_API bool IsProfileCapturing();
+	UTIL_API bool SaveProfileCapture(IDataWriter* writer); // Chrome trace event JSON
+
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const ProfileZone& zone)
+			: _zone(zone)
+			, _recorded(ff::ProfileBegin(zone))
+		{
+		}
+
+		~ProfileScope()
+		{
+			if (_recorded)
+			{
+				ff::ProfileEnd(_zone);
+			}
+		}
+
+		ProfileScope(const ProfileScope& rhs) = delete;
+		ProfileScope& operator=(const ProfileScope& rhs) = delete;
+
+	private:
+		const ProfileZone& _zone;
+		bool _recorded;
+	};
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#if PROFILE_ENABLED
+#define PROFILE_ZONE(name) \
+	static const ff::ProfileZone PROFILE_CONCAT(s_profileZone, __LINE__){ name }; \
+	ff::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(s_profileZone, __LINE__))
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTIONW__)
@@ -10,6 +10,7 @@
 #include "Graph/Sprite/Sprite.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
+#include "Thread/Mutex.h"
 #include "Value/Values.h"
 
 static ff::StaticString PROP_COLOR(L"color");
@@ -131,6 +132,7 @@ public:
 	virtual float GetFramesPerSecond() const override;
 	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
 	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
 	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
 	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
 
@@ -153,6 +155,19 @@ private:
 		ff::KeyFrames* _positionKeys;
 		ff::KeyFrames* _scaleKeys;
 		ff::KeyFrames* _rotateKeys;
+
+		// Visual key index to _bakedVisuals index, empty when the visuals can't be baked
+		ff::Vector<size_t> _bakedKeys;
+		size_t _bakedDefault;
+	};
+
+	// Key frame cursors live on the stack of each render call, the animation itself is shared by all players
+	struct VisualCursors
+	{
+		size_t _position;
+		size_t _scale;
+		size_t _rotate;
+		size_t _color;
 	};
 
 	struct EventInfo
@@ -175,7 +190,42 @@ private:
 	bool LoadKeys(const ff::Dict& values, bool fromCache);
 
 	typedef ff::Vector<ff::ComPtr<ff::IAnimation>, 4> CachedVisuals;
+
+	enum class BakeState
+	{
+		None,
+		Baked,
+		Loading, // a visual resource is still loading, baking is tried again once the loads finish
+		Failed, // a visual isn't valid, so rendering always uses the unbaked visuals
+	};
+
+	// Scratch space for RenderFrames, reused so that rendering many instances doesn't allocate.
+	// The animation is shared by all players, so scratch belongs to the rendering thread instead.
+	struct BatchScratch
+	{
+		ff::Vector<ff::Transform> _positions;
+		ff::Vector<float> _frames;
+		ff::Vector<const CachedVisuals*> _visuals;
+		ff::Vector<ff::Transform> _visualPositions;
+		ff::Vector<float> _visualFrames;
+		ff::Vector<size_t> _groups;
+		ff::Vector<ff::Transform> _sortedPositions;
+		ff::Vector<float> _sortedFrames;
+		ff::Vector<float> _childFrames;
+	};
+
+	static BatchScratch& AcquireBatchScratch();
+	static void ReleaseBatchScratch();
+	static bool ResolveVisuals(const ff::ValuePtr& value, CachedVisuals& visuals);
+	static void FindLoadingResources(const ff::ValuePtr& value, ff::Vector<ff::SharedResourceValue>& loading);
 	const CachedVisuals* GetCachedVisuals(const ff::ValuePtr& value);
+	const CachedVisuals* GetFrameVisuals(const VisualInfo& info, float visualFrame, bool baked, const ff::Dict* params);
+	bool BakeVisuals();
+	bool TryBakeVisuals();
+	bool BakeVisualsFailed(const ff::ValuePtr& value);
+	size_t BakeVisualValue(const ff::ValuePtr& value);
+	void GetVisualTransform(const VisualInfo& info, float visualFrame, const ff::Transform& renderTransform, const ff::Dict* params, VisualCursors& cursors, ff::Transform& visualTransform);
+	void RenderBatchVisuals(ff::IRendererActive* render, const ff::Dict* params, BatchScratch& scratch);
 
 	float _length;
 	float _fps;
@@ -183,9 +233,19 @@ private:
 	ff::Vector<VisualInfo> _visuals;
 	ff::Vector<EventInfo> _events;
 	ff::Map<ff::hash_t, ff::KeyFrames, ff::NonHasher<ff::hash_t>> _keys;
-	mutable ff::Map<ff::ValuePtr, CachedVisuals> _cachedVisuals;
+	ff::Map<ff::ValuePtr, CachedVisuals> _cachedVisuals; // for visuals that aren't baked, uses _bakeMutex
+
+	// Visuals resolved once, so that rendering doesn't hash values or lock _cachedVisuals
+	ff::Vector<ff::ValuePtr> _bakedValues;
+	ff::Vector<CachedVisuals> _bakedVisuals;
+	ff::Vector<ff::SharedResourceValue> _bakeLoading;
+	std::atomic<BakeState> _bakeState;
+	ff::Mutex _bakeMutex;
 };
 
+// Visuals can be animations that batch their own visuals, so each nesting level gets its own scratch
+static thread_local size_t s_batchScratchDepth = 0;
+
 BEGIN_INTERFACES(Animation)
 	HAS_INTERFACE(ff::IAnimation)
 	HAS_INTERFACE(ff::IResourcePersist)
@@ -200,6 +260,7 @@ Animation::Animation()
 	: _length(0)
 	, _fps(ff::ADVANCES_PER_SECOND_F)
 	, _method(ff::KeyFrames::MethodType::None)
+	, _bakeState(BakeState::None)
 {
 }
 
@@ -214,6 +275,7 @@ void Animation::RenderFrame(ff::IRendererActive* render, const ff::Transform& po
 		return;
 	}
 
+	bool baked = BakeVisuals();
 	bool pushTransform = (position._rotation != 0);
 	const ff::Transform& renderTransform = pushTransform ? ff::Transform::Identity() : position;
 
@@ -234,70 +296,222 @@ void Animation::RenderFrame(ff::IRendererActive* render, const ff::Transform& po
 			continue;
 		}
 
-		const CachedVisuals* visuals = GetCachedVisuals(info._visualKeys ? info._visualKeys->GetValue(visualFrame, params) : nullptr);
+		const CachedVisuals* visuals = GetFrameVisuals(info, visualFrame, baked, params);
 		if (!visuals || visuals->IsEmpty())
 		{
 			continue;
 		}
 
-		ff::Transform visualTransform = renderTransform;
+		ff::Transform visualTransform;
+		VisualCursors cursors{};
+		GetVisualTransform(info, visualFrame, renderTransform, params, cursors, visualTransform);
 
-		if (info._positionKeys)
+		for (const ff::ComPtr<ff::IAnimation>& animVisual : *visuals)
 		{
-			ff::ValuePtrT<ff::PointFloatValue> value = info._positionKeys->GetValue(visualFrame, params);
-			if (value)
-			{
-				visualTransform._position += value.GetValue() * renderTransform._scale;
-			}
+			float visualAnimFrame = (_fps != 0.0f) ? visualFrame * animVisual->GetFramesPerSecond() / _fps : 0.0f;
+			animVisual->RenderFrame(render, visualTransform, visualAnimFrame, params);
 		}
+	}
+
+	if (pushTransform)
+	{
+		render->GetWorldMatrixStack().PopMatrix();
+	}
+}
+
+Animation::BatchScratch& Animation::AcquireBatchScratch()
+{
+	// Pointers, so that growing the vector doesn't move scratch that an outer level is using
+	static thread_local ff::Vector<std::unique_ptr<BatchScratch>> s_batchScratch;
 
-		if (info._scaleKeys)
+	if (s_batchScratchDepth == s_batchScratch.Size())
+	{
+		s_batchScratch.Push(std::make_unique<BatchScratch>());
+	}
+
+	return *s_batchScratch[s_batchScratchDepth++];
+}
+
+void Animation::ReleaseBatchScratch()
+{
+	assert(s_batchScratchDepth > 0);
+	s_batchScratchDepth--;
+}
+
+void Animation::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	bool baked = BakeVisuals();
+	BatchScratch& scratch = AcquireBatchScratch();
+	scratch._positions.Clear();
+	scratch._frames.Clear();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float frame = frames[i];
+		if (!ff::KeyFrames::AdjustFrame(frame, 0.0f, _length, _method))
 		{
-			ff::ValuePtrT<ff::PointFloatValue> value = info._scaleKeys->GetValue(visualFrame, params);
-			if (value)
-			{
-				visualTransform._scale *= value.GetValue();
-			}
+			continue;
+		}
+
+		if (positions[i]._rotation != 0)
+		{
+			// Rotated instances need their own world matrix
+			RenderFrame(render, positions[i], frames[i], params);
+			continue;
 		}
 
-		if (info._rotateKeys)
+		scratch._positions.Push(positions[i]);
+		scratch._frames.Push(frame);
+	}
+
+	for (const VisualInfo& info : _visuals)
+	{
+		VisualCursors cursors{};
+		scratch._visuals.Clear();
+		scratch._visualPositions.Clear();
+		scratch._visualFrames.Clear();
+
+		for (size_t i = 0; i < scratch._frames.Size(); i++)
 		{
-			ff::ValuePtrT<ff::FloatValue> value = info._rotateKeys->GetValue(visualFrame, params);
-			if (value)
+			float visualFrame = scratch._frames[i] - info._start;
+			if (!ff::KeyFrames::AdjustFrame(visualFrame, 0.0f, info._length, info._method))
+			{
+				continue;
+			}
+
+			const CachedVisuals* visuals = GetFrameVisuals(info, visualFrame, baked, params);
+			if (!visuals || visuals->IsEmpty())
 			{
-				visualTransform._rotation += value.GetValue();
+				continue;
 			}
+
+			scratch._visuals.Push(visuals);
+			scratch._visualFrames.Push(visualFrame);
+			scratch._visualPositions.Push(ff::Transform());
+			GetVisualTransform(info, visualFrame, scratch._positions[i], params, cursors, scratch._visualPositions.GetLast());
 		}
 
-		if (info._colorKeys)
+		RenderBatchVisuals(render, params, scratch);
+	}
+
+	ReleaseBatchScratch();
+}
+
+void Animation::RenderBatchVisuals(ff::IRendererActive* render, const ff::Dict* params, BatchScratch& scratch)
+{
+	noAssertRet(scratch._visuals.Size());
+
+	// Instances usually share a few distinct visuals (like flipbook frames), so group them with a counting sort
+	ff::Vector<const CachedVisuals*, 16> groupVisuals;
+	ff::Vector<size_t, 16> groupStarts;
+	scratch._groups.Resize(scratch._visuals.Size());
+
+	for (size_t i = 0, group = 0; i < scratch._visuals.Size(); i++)
+	{
+		if (group >= groupVisuals.Size() || groupVisuals[group] != scratch._visuals[i])
 		{
-			ff::ValuePtr value = info._colorKeys->GetValue(visualFrame, params);
-			ff::ValuePtrT<ff::RectFloatValue> rectValue = value;
-			ff::ValuePtrT<ff::IntValue> intValue = value;
+			auto iter = std::find(groupVisuals.begin(), groupVisuals.end(), scratch._visuals[i]);
+			group = iter - groupVisuals.begin();
 
-			if (rectValue)
+			if (iter == groupVisuals.end())
 			{
-				DirectX::XMStoreFloat4(&visualTransform._color,
-					DirectX::XMVectorMultiply(
-						DirectX::XMLoadFloat4(&visualTransform._color),
-						DirectX::XMLoadFloat4((const DirectX::XMFLOAT4*) & rectValue.GetValue())));
+				groupVisuals.Push(scratch._visuals[i]);
+				groupStarts.Push(0);
 			}
-			else if (intValue)
+		}
+
+		scratch._groups[i] = group;
+		groupStarts[group]++;
+	}
+
+	for (size_t i = 0, start = 0; i < groupStarts.Size(); i++)
+	{
+		size_t groupCount = groupStarts[i];
+		groupStarts[i] = start;
+		start += groupCount;
+	}
+
+	groupStarts.Push(scratch._visuals.Size());
+	scratch._sortedPositions.Resize(scratch._visuals.Size());
+	scratch._sortedFrames.Resize(scratch._visuals.Size());
+
+	ff::Vector<size_t, 16> groupNext = groupStarts;
+	for (size_t i = 0; i < scratch._visuals.Size(); i++)
+	{
+		size_t dest = groupNext[scratch._groups[i]]++;
+		scratch._sortedPositions[dest] = scratch._visualPositions[i];
+		scratch._sortedFrames[dest] = scratch._visualFrames[i];
+	}
+
+	for (size_t group = 0; group < groupVisuals.Size(); group++)
+	{
+		size_t start = groupStarts[group];
+		size_t count = groupStarts[group + 1] - start;
+
+		for (const ff::ComPtr<ff::IAnimation>& animVisual : *groupVisuals[group])
+		{
+			float frameScale = (_fps != 0.0f) ? animVisual->GetFramesPerSecond() / _fps : 0.0f;
+			scratch._childFrames.Resize(count);
+
+			for (size_t i = 0; i < count; i++)
 			{
-				ff::PaletteIndexToColor(intValue.GetValue(), visualTransform._color);
+				scratch._childFrames[i] = scratch._sortedFrames[start + i] * frameScale;
 			}
+
+			animVisual->RenderFrames(render, scratch._sortedPositions.ConstData() + start, scratch._childFrames.ConstData(), count, params);
 		}
+	}
+}
 
-		for (const ff::ComPtr<ff::IAnimation>& animVisual : *visuals)
+void Animation::GetVisualTransform(const VisualInfo& info, float visualFrame, const ff::Transform& renderTransform, const ff::Dict* params, VisualCursors& cursors, ff::Transform& visualTransform)
+{
+	visualTransform = renderTransform;
+
+	if (info._positionKeys)
+	{
+		ff::PointFloat value;
+		if (info._positionKeys->GetValue(visualFrame, value, params, &cursors._position))
 		{
-			float visualAnimFrame = (_fps != 0.0f) ? visualFrame * animVisual->GetFramesPerSecond() / _fps : 0.0f;
-			animVisual->RenderFrame(render, visualTransform, visualAnimFrame, params);
+			visualTransform._position += value * renderTransform._scale;
 		}
 	}
 
-	if (pushTransform)
+	if (info._scaleKeys)
 	{
-		render->GetWorldMatrixStack().PopMatrix();
+		ff::PointFloat value;
+		if (info._scaleKeys->GetValue(visualFrame, value, params, &cursors._scale))
+		{
+			visualTransform._scale *= value;
+		}
+	}
+
+	if (info._rotateKeys)
+	{
+		float value;
+		if (info._rotateKeys->GetValue(visualFrame, value, params, &cursors._rotate))
+		{
+			visualTransform._rotation += value;
+		}
+	}
+
+	if (info._colorKeys)
+	{
+		ff::RectFloat rectValue;
+		if (info._colorKeys->GetValue(visualFrame, rectValue, params, &cursors._color))
+		{
+			DirectX::XMStoreFloat4(&visualTransform._color,
+				DirectX::XMVectorMultiply(
+					DirectX::XMLoadFloat4(&visualTransform._color),
+					DirectX::XMLoadFloat4((const DirectX::XMFLOAT4*) & rectValue)));
+		}
+		else
+		{
+			ff::ValuePtrT<ff::IntValue> intValue = info._colorKeys->GetValue(visualFrame, params);
+			if (intValue)
+			{
+				ff::PaletteIndexToColor(intValue.GetValue(), visualTransform._color);
+			}
+		}
 	}
 }
 
@@ -480,6 +694,9 @@ bool Animation::Load(const ff::Dict& dict, bool fromCache)
 	assertRetVal(LoadVisuals(dict.Get<ff::ValueVectorValue>(::PROP_VISUALS), fromCache), false);
 	assertRetVal(LoadEvents(dict.Get<ff::ValueVectorValue>(::PROP_EVENTS), fromCache), false);
 
+	// Referenced resources may still be loading, in which case the first render will try again
+	BakeVisuals();
+
 	return true;
 }
 
@@ -581,46 +798,212 @@ bool Animation::LoadKeys(const ff::Dict& values, bool fromCache)
 	return true;
 }
 
+bool Animation::ResolveVisuals(const ff::ValuePtr& value, CachedVisuals& visuals)
+{
+	noAssertRetVal(value, false);
+
+	ff::ComPtr<ff::IAnimation> anim;
+	if (anim.QueryFrom(value->GetComObject()))
+	{
+		visuals.Push(std::move(anim));
+		return true;
+	}
+
+	noAssertRetVal(value->IsType<ff::ValueVectorValue>(), false);
+
+	bool valid = true;
+	visuals.Reserve(value->GetValue<ff::ValueVectorValue>().Size());
+
+	for (ff::ValuePtr childValue : value->GetValue<ff::ValueVectorValue>())
+	{
+		ff::ComPtr<ff::IAnimation> anim;
+		if (anim.QueryFrom(childValue->GetComObject()))
+		{
+			visuals.Push(anim);
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	return valid;
+}
+
+void Animation::FindLoadingResources(const ff::ValuePtr& value, ff::Vector<ff::SharedResourceValue>& loading)
+{
+	if (value && value->IsType<ff::SharedResourceWrapperValue>())
+	{
+		ff::SharedResourceValue res = value->GetValue<ff::SharedResourceWrapperValue>();
+		if (res && !res->IsValid())
+		{
+			res = res->GetNewValue();
+		}
+
+		if (res && res->GetLoadingOwner())
+		{
+			loading.Push(res);
+		}
+	}
+	else if (value && value->IsType<ff::ValueVectorValue>())
+	{
+		for (const ff::ValuePtr& childValue : value->GetValue<ff::ValueVectorValue>())
+		{
+			FindLoadingResources(childValue, loading);
+		}
+	}
+}
+
 const Animation::CachedVisuals* Animation::GetCachedVisuals(const ff::ValuePtr& value)
 {
 	noAssertRetVal(value, nullptr);
 
+	// Entries are never removed, so the returned pointer stays valid after unlocking
+	ff::LockMutex lock(_bakeMutex);
 	auto i = _cachedVisuals.GetKey(value);
 	if (!i)
 	{
 		CachedVisuals visuals;
+		if (!ResolveVisuals(value, visuals))
+		{
+			assertSz(false, L"Not a valid animation visual");
+			noAssertRetVal(visuals.Size(), nullptr);
+		}
 
-		ff::ComPtr<ff::IAnimation> anim;
-		if (anim.QueryFrom(value->GetComObject()))
+		i = _cachedVisuals.SetKey(ff::ValuePtr(value), std::move(visuals));
+	}
+
+	return &i->GetValue();
+}
+
+const Animation::CachedVisuals* Animation::GetFrameVisuals(const VisualInfo& info, float visualFrame, bool baked, const ff::Dict* params)
+{
+	noAssertRetVal(info._visualKeys, nullptr);
+
+	if (baked && info._bakedKeys.Size())
+	{
+		size_t key = info._visualKeys->GetStepKeyIndex(visualFrame);
+		size_t index = (key != ff::INVALID_SIZE) ? info._bakedKeys[key] : info._bakedDefault;
+		return (index != ff::INVALID_SIZE) ? &_bakedVisuals[index] : nullptr;
+	}
+
+	return GetCachedVisuals(info._visualKeys->GetValue(visualFrame, params));
+}
+
+bool Animation::BakeVisuals()
+{
+	BakeState state = _bakeState.load(std::memory_order_acquire);
+	if (state == BakeState::Baked)
+	{
+		return true;
+	}
+
+	// Another thread is baking, so render unbaked instead of waiting for it
+	if (state == BakeState::Failed || !_bakeMutex.TryEnter())
+	{
+		return false;
+	}
+
+	bool baked = TryBakeVisuals();
+	_bakeMutex.Leave();
+
+	return baked;
+}
+
+bool Animation::TryBakeVisuals()
+{
+	BakeState state = _bakeState.load(std::memory_order_relaxed);
+	if (state == BakeState::Baked || state == BakeState::Failed)
+	{
+		return state == BakeState::Baked;
+	}
+
+	// Loaded resources get replaced by their final value, so wait until every one has been
+	for (const ff::SharedResourceValue& res : _bakeLoading)
+	{
+		noAssertRetVal(!res->IsValid(), false);
+	}
+
+	_bakeLoading.Clear();
+	_bakedValues.Clear();
+	_bakedVisuals.Clear();
+
+	for (VisualInfo& info : _visuals)
+	{
+		info._bakedKeys.Clear();
+		info._bakedDefault = ff::INVALID_SIZE;
+
+		const ff::KeyFrames* keys = info._visualKeys;
+		if (!keys)
 		{
-			visuals.Push(std::move(anim));
+			continue;
 		}
-		else if (value->IsType<ff::ValueVectorValue>())
+
+		// Strings are "param:" references that can change with each render
+		bool usesParams = false;
+		for (size_t i = 0; i < keys->GetKeyCount() && !usesParams; i++)
 		{
-			visuals.Reserve(value->GetValue<ff::ValueVectorValue>().Size());
+			usesParams = keys->GetKeyValue(i)->IsType<ff::StringValue>();
+		}
 
-			for (ff::ValuePtr childValue : value->GetValue<ff::ValueVectorValue>())
+		if (usesParams)
+		{
+			continue;
+		}
+
+		info._bakedKeys.Reserve(keys->GetKeyCount());
+
+		for (size_t i = 0; i < keys->GetKeyCount(); i++)
+		{
+			size_t index = BakeVisualValue(keys->GetKeyValue(i));
+			if (index == ff::INVALID_SIZE)
 			{
-				ff::ComPtr<ff::IAnimation> anim;
-				if (anim.QueryFrom(childValue->GetComObject()))
-				{
-					visuals.Push(anim);
-				}
-				else
-				{
-					assertSz(false, L"Not a valid animation visual");
-				}
+				return BakeVisualsFailed(keys->GetKeyValue(i));
 			}
+
+			info._bakedKeys.Push(index);
 		}
-		else
+
+		const ff::ValuePtr& defaultValue = keys->GetDefaultValue();
+		if (defaultValue && !defaultValue->IsType<ff::NullValue>())
 		{
-			assertSzRetVal(false, L"Not a valid animation visual", nullptr);
+			info._bakedDefault = BakeVisualValue(defaultValue);
+			if (info._bakedDefault == ff::INVALID_SIZE)
+			{
+				return BakeVisualsFailed(defaultValue);
+			}
 		}
+	}
 
-		i = _cachedVisuals.SetKey(ff::ValuePtr(value), std::move(visuals));
+	_bakeState.store(BakeState::Baked, std::memory_order_release);
+	return true;
+}
+
+bool Animation::BakeVisualsFailed(const ff::ValuePtr& value)
+{
+	// Only a visual that is still loading can resolve later, anything else would fail the same way every time
+	FindLoadingResources(value, _bakeLoading);
+	_bakeState.store(_bakeLoading.IsEmpty() ? BakeState::Failed : BakeState::Loading, std::memory_order_release);
+
+	return false;
+}
+
+size_t Animation::BakeVisualValue(const ff::ValuePtr& value)
+{
+	for (size_t i = 0; i < _bakedValues.Size(); i++)
+	{
+		if (_bakedValues[i] == value)
+		{
+			return i;
+		}
 	}
 
-	return &i->GetValue();
+	CachedVisuals visuals;
+	noAssertRetVal(ResolveVisuals(value, visuals), ff::INVALID_SIZE);
+
+	_bakedValues.Push(value);
+	_bakedVisuals.Push(std::move(visuals));
+	return _bakedVisuals.Size() - 1;
 }
 
 ff::CreateAnimation::CreateAnimation(float length, float fps, KeyFrames::MethodType method)
@@ -30,6 +30,9 @@ namespace ff
 		virtual float GetFramesPerSecond() const = 0;
 		virtual void GetFrameEvents(float start, float end, bool includeStart, ItemCollector<AnimationEvent>& events) = 0;
 		virtual void RenderFrame(IRendererActive* render, const Transform& position, float frame, const Dict* params = nullptr) = 0;
+		// Renders many instances at once. Instances don't stack in array order: each visual of the animation is drawn
+		// for all instances before the next visual, and instances that show the same visual at that moment are drawn together.
+		virtual void RenderFrames(IRendererActive* render, const Transform* positions, const float* frames, size_t count, const Dict* params = nullptr) = 0;
 		virtual ValuePtr GetFrameValue(hash_t name, float frame, const Dict* params = nullptr) = 0;
 		virtual ComPtr<IAnimationPlayer> CreateAnimationPlayer(float startFrame = 0, float timeScale = 1, const Dict* params = nullptr) = 0;
 	};
@@ -47,13 +50,13 @@ namespace ff
 	class CreateAnimation
 	{
 	public:
-		CreateAnimation(float length, float fps = ff::ADVANCES_PER_SECOND_F, KeyFrames::MethodType method = KeyFrames::MethodType::Default);
-		CreateAnimation(const CreateAnimation& rhs);
-		CreateAnimation(CreateAnimation&& rhs);
+		UTIL_API CreateAnimation(float length, float fps = ff::ADVANCES_PER_SECOND_F, KeyFrames::MethodType method = KeyFrames::MethodType::Default);
+		UTIL_API CreateAnimation(const CreateAnimation& rhs);
+		UTIL_API CreateAnimation(CreateAnimation&& rhs);
 
-		void AddKeys(const CreateKeyFrames& key);
-		void AddEvent(float frame, StringRef name, IAudioEffect* effect, const Dict* properties);
-		void AddVisual(
+		UTIL_API void AddKeys(const CreateKeyFrames& key);
+		UTIL_API void AddEvent(float frame, StringRef name, IAudioEffect* effect, const Dict* properties);
+		UTIL_API void AddVisual(
 			float start,
 			float length,
 			float speed,
@@ -64,7 +67,7 @@ namespace ff
 			StringRef scaleKeys,
 			StringRef rotateKeys);
 
-		ComPtr<IAnimation> Create() const;
+		UTIL_API ComPtr<IAnimation> Create() const;
 
 	private:
 		Dict _dict;
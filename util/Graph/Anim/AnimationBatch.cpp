@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "Graph/Anim/Animation.h"
+#include "Graph/Anim/AnimationBatch.h"
+#include "Graph/Render/RendererActive.h"
+
+template<typename T>
+static void DeleteUnordered(ff::Vector<T>& vec, size_t index)
+{
+	if (index + 1 < vec.Size())
+	{
+		vec[index] = std::move(vec.GetLast());
+	}
+
+	vec.Pop();
+}
+
+ff::AnimationBatch::AnimationBatch()
+{
+}
+
+ff::AnimationBatch::~AnimationBatch()
+{
+}
+
+size_t ff::AnimationBatch::Add(IAnimation* animation, const Transform& position, float startFrame, float speed, const Dict* params)
+{
+	assertRetVal(animation && speed > 0.0, ff::INVALID_SIZE);
+
+	size_t group = GetGroup(animation, params);
+	_groups[group]._playerCount++;
+
+	_playerGroups.Push(group);
+	_starts.Push(startFrame);
+	_frames.Push(startFrame);
+	_fps.Push(speed * animation->GetFramesPerSecond());
+	_advances.Push(0.0f);
+	_positions.Push(position);
+
+	return _playerGroups.Size() - 1;
+}
+
+void ff::AnimationBatch::Remove(size_t index)
+{
+	assertRet(index < _playerGroups.Size());
+
+	_groups[_playerGroups[index]]._playerCount--;
+
+	::DeleteUnordered(_playerGroups, index);
+	::DeleteUnordered(_starts, index);
+	::DeleteUnordered(_frames, index);
+	::DeleteUnordered(_fps, index);
+	::DeleteUnordered(_advances, index);
+	::DeleteUnordered(_positions, index);
+}
+
+void ff::AnimationBatch::Clear()
+{
+	_groups.Clear();
+	_playerGroups.Clear();
+	_starts.Clear();
+	_frames.Clear();
+	_fps.Clear();
+	_advances.Clear();
+	_positions.Clear();
+}
+
+size_t ff::AnimationBatch::GetCount() const
+{
+	return _playerGroups.Size();
+}
+
+void ff::AnimationBatch::SetPosition(size_t index, const Transform& position)
+{
+	_positions[index] = position;
+}
+
+const ff::Transform& ff::AnimationBatch::GetPosition(size_t index) const
+{
+	return _positions[index];
+}
+
+float ff::AnimationBatch::GetCurrentFrame(size_t index) const
+{
+	return _frames[index];
+}
+
+ff::IAnimation* ff::AnimationBatch::GetAnimation(size_t index) const
+{
+	return _groups[_playerGroups[index]]._animation;
+}
+
+void ff::AnimationBatch::Advance(ItemCollector<AnimationEvent>* frameEvents)
+{
+	size_t count = _playerGroups.Size();
+	float* frames = _frames.Data();
+	float* advances = _advances.Data();
+	const float* starts = _starts.ConstData();
+	const float* fps = _fps.ConstData();
+
+	if (frameEvents)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			bool firstAdvance = !advances[i];
+			float beginFrame = frames[i];
+			advances[i] += 1.0f;
+			frames[i] = starts[i] + (advances[i] * fps[i] / ff::ADVANCES_PER_SECOND_F);
+
+			_groups[_playerGroups[i]]._animation->GetFrameEvents(beginFrame, frames[i], firstAdvance, *frameEvents);
+		}
+	}
+	else
+	{
+		// Same math as AnimationPlayer, in a loop that the compiler can vectorize
+		for (size_t i = 0; i < count; i++)
+		{
+			advances[i] += 1.0f;
+			frames[i] = starts[i] + (advances[i] * fps[i] / ff::ADVANCES_PER_SECOND_F);
+		}
+	}
+}
+
+void ff::AnimationBatch::Render(IRendererActive* render)
+{
+	noAssertRet(_playerGroups.Size());
+
+	// Sort players by group so that each animation renders all of its players at once
+
+	_groupStarts.Resize(_groups.Size());
+	for (size_t i = 0, start = 0; i < _groups.Size(); i++)
+	{
+		_groupStarts[i] = start;
+		start += _groups[i]._playerCount;
+	}
+
+	_sortedPositions.Resize(_playerGroups.Size());
+	_sortedFrames.Resize(_playerGroups.Size());
+
+	for (size_t i = 0; i < _playerGroups.Size(); i++)
+	{
+		size_t dest = _groupStarts[_playerGroups[i]]++;
+		_sortedPositions[dest] = _positions[i];
+		_sortedFrames[dest] = _frames[i];
+	}
+
+	for (size_t i = 0, start = 0; i < _groups.Size(); i++)
+	{
+		const Group& group = _groups[i];
+		if (group._playerCount)
+		{
+			const Dict* params = !group._params.IsEmpty() ? &group._params : nullptr;
+			group._animation->RenderFrames(render, _sortedPositions.ConstData() + start, _sortedFrames.ConstData() + start, group._playerCount, params);
+			start += group._playerCount;
+		}
+	}
+}
+
+size_t ff::AnimationBatch::GetGroup(IAnimation* animation, const Dict* params)
+{
+	// Params are compared by value, a pointer could be reused for different params
+	bool noParams = !params || params->IsEmpty();
+
+	for (size_t i = 0; i < _groups.Size(); i++)
+	{
+		const Group& group = _groups[i];
+		if (group._animation == animation && (noParams ? group._params.IsEmpty() : group._params == *params))
+		{
+			return i;
+		}
+	}
+
+	Group group;
+	group._animation = animation;
+	group._playerCount = 0;
+
+	if (params)
+	{
+		group._params = *params;
+	}
+
+	_groups.Push(std::move(group));
+	return _groups.Size() - 1;
+}
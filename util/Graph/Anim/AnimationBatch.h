@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Dict/Dict.h"
+#include "Graph/Anim/Animation.h"
+#include "Graph/Anim/Transform.h"
+
+namespace ff
+{
+	class IAnimation;
+	class IRendererActive;
+
+	// Plays many instances of a few animations, like a crowd of identical entities.
+	// Player state is stored in flat arrays and all instances of an animation render with one call.
+	//
+	// Stacking order is NOT the order that players were added. Render draws one group (animation and params) at a time,
+	// in the order that each group was first added, so every player of a later group draws on top of every player
+	// of an earlier group. Within a group, players draw in index order. Use separate batches (or AnimationPlayer)
+	// when players of different animations must overlap in a specific order.
+	class AnimationBatch
+	{
+	public:
+		UTIL_API AnimationBatch();
+		UTIL_API ~AnimationBatch();
+
+		// Returns the index of the new player. Players of the same animation with equal params share a group, the params are copied.
+		UTIL_API size_t Add(IAnimation* animation, const Transform& position, float startFrame = 0, float speed = 1, const Dict* params = nullptr);
+		// The last player moves into the removed index, which also moves it earlier in its group's stacking order
+		UTIL_API void Remove(size_t index);
+		UTIL_API void Clear();
+		UTIL_API size_t GetCount() const;
+
+		UTIL_API void SetPosition(size_t index, const Transform& position);
+		UTIL_API const Transform& GetPosition(size_t index) const;
+		UTIL_API float GetCurrentFrame(size_t index) const;
+		UTIL_API IAnimation* GetAnimation(size_t index) const;
+
+		UTIL_API void Advance(ItemCollector<AnimationEvent>* frameEvents = nullptr);
+		// Draws group by group, see the stacking order note above
+		UTIL_API void Render(IRendererActive* render);
+
+	private:
+		AnimationBatch(const AnimationBatch& rhs) = delete;
+		AnimationBatch& operator=(const AnimationBatch& rhs) = delete;
+
+		struct Group
+		{
+			ComPtr<IAnimation> _animation;
+			Dict _params;
+			size_t _playerCount;
+		};
+
+		size_t GetGroup(IAnimation* animation, const Dict* params);
+
+		Vector<Group> _groups;
+
+		// Player state
+		Vector<size_t> _playerGroups;
+		Vector<float> _starts;
+		Vector<float> _frames;
+		Vector<float> _fps;
+		Vector<float> _advances;
+		Vector<Transform> _positions;
+
+		// Scratch space for rendering, sorted by group
+		Vector<size_t> _groupStarts;
+		Vector<Transform> _sortedPositions;
+		Vector<float> _sortedFrames;
+	};
+}
@@ -27,7 +27,8 @@ bool ff::KeyFrames::KeyFrame::operator<(const KeyFrame& rhs) const
 }
 
 ff::KeyFrames::KeyFrames()
-	: _start(0)
+	: _track{}
+	, _start(0)
 	, _length(0)
 	, _method(MethodType::None)
 {
@@ -36,6 +37,7 @@ ff::KeyFrames::KeyFrames()
 ff::KeyFrames::KeyFrames(const KeyFrames& rhs)
 	: _name(rhs._name)
 	, _keys(rhs._keys)
+	, _track(rhs._track)
 	, _default(rhs._default)
 	, _start(rhs._start)
 	, _length(rhs._length)
@@ -46,6 +48,7 @@ ff::KeyFrames::KeyFrames(const KeyFrames& rhs)
 ff::KeyFrames::KeyFrames(KeyFrames&& rhs)
 	: _name(std::move(rhs._name))
 	, _keys(std::move(rhs._keys))
+	, _track(std::move(rhs._track))
 	, _default(std::move(rhs._default))
 	, _start(rhs._start)
 	, _length(rhs._length)
@@ -79,6 +82,114 @@ ff::ValuePtr ff::KeyFrames::GetValue(float frame, const Dict* params)
 	return _default && !_default->IsType<ff::NullValue>() ? _default : nullptr;
 }
 
+template<typename T, typename ValueT>
+bool ff::KeyFrames::GetTypedValue(TrackType type, float frame, T& value, const Dict* params, size_t* cursor)
+{
+	static_assert(sizeof(T) <= sizeof(DirectX::XMFLOAT4), "Typed key frame values must fit in a vector");
+
+	if (_track._type != type)
+	{
+		// Not compiled, so use the boxed values
+		ff::ValuePtrT<ValueT> boxedValue = GetValue(frame, params);
+		noAssertRetVal(boxedValue, false);
+
+		value = boxedValue.GetValue();
+		return true;
+	}
+
+	DirectX::XMFLOAT4 trackValue;
+	noAssertRetVal(GetTrackValue(frame, trackValue, cursor), false);
+
+	std::memcpy(&value, &trackValue, sizeof(T));
+	return true;
+}
+
+template<>
+bool ff::KeyFrames::GetValue<float>(float frame, float& value, const Dict* params, size_t* cursor)
+{
+	return GetTypedValue<float, ff::FloatValue>(TrackType::Float, frame, value, params, cursor);
+}
+
+template<>
+bool ff::KeyFrames::GetValue<ff::PointFloat>(float frame, PointFloat& value, const Dict* params, size_t* cursor)
+{
+	return GetTypedValue<ff::PointFloat, ff::PointFloatValue>(TrackType::PointFloat, frame, value, params, cursor);
+}
+
+template<>
+bool ff::KeyFrames::GetValue<ff::RectFloat>(float frame, RectFloat& value, const Dict* params, size_t* cursor)
+{
+	return GetTypedValue<ff::RectFloat, ff::RectFloatValue>(TrackType::RectFloat, frame, value, params, cursor);
+}
+
+// The keys are shared by every player, so the cursor is owned by the caller and nothing here is written during playback
+size_t ff::KeyFrames::FindTrackKey(float frame, size_t* cursor) const
+{
+	const ff::Vector<float>& frames = _track._frames;
+
+	if (cursor)
+	{
+		// Playback is usually monotonic, so try the last segment and the one after it before searching
+		for (size_t i = *cursor; i < *cursor + 2 && i < frames.Size(); i++)
+		{
+			if (frame <= frames[i] && (i == 0 || frame > frames[i - 1]))
+			{
+				*cursor = i;
+				return i;
+			}
+		}
+	}
+
+	size_t i = std::lower_bound(frames.begin(), frames.end(), frame) - frames.begin();
+	if (cursor)
+	{
+		*cursor = std::min(i, frames.Size() - 1);
+	}
+
+	return i;
+}
+
+bool ff::KeyFrames::GetTrackValue(float frame, DirectX::XMFLOAT4& value, size_t* cursor) const
+{
+	if (!_track._frames.Size() || !AdjustFrame(frame, _start, _length, _method))
+	{
+		value = _track._default;
+		return _track._hasDefault;
+	}
+
+	size_t keyIndex = FindTrackKey(frame, cursor);
+	if (keyIndex == 0 || (keyIndex < _track._frames.Size() && _track._frames[keyIndex] == frame))
+	{
+		value = _track._values[keyIndex];
+	}
+	else if (keyIndex == _track._frames.Size())
+	{
+		value = _track._values.GetLast();
+	}
+	else
+	{
+		float prevFrame = _track._frames[keyIndex - 1];
+		float time = (frame - prevFrame) / (_track._frames[keyIndex] - prevFrame);
+
+		DirectX::XMVECTOR v1 = DirectX::XMLoadFloat4(&_track._values[keyIndex - 1]);
+		DirectX::XMVECTOR v2 = DirectX::XMLoadFloat4(&_track._values[keyIndex]);
+
+		if (_track._spline)
+		{
+			DirectX::XMStoreFloat4(&value, DirectX::XMVectorHermite(
+				v1, DirectX::XMLoadFloat4(&_track._tangents[keyIndex - 1]),
+				v2, DirectX::XMLoadFloat4(&_track._tangents[keyIndex]),
+				time));
+		}
+		else
+		{
+			DirectX::XMStoreFloat4(&value, DirectX::XMVectorLerp(v1, v2, time));
+		}
+	}
+
+	return true;
+}
+
 float ff::KeyFrames::GetStart() const
 {
 	return _start;
@@ -94,6 +205,31 @@ ff::StringRef ff::KeyFrames::GetName() const
 	return _name;
 }
 
+size_t ff::KeyFrames::GetStepKeyIndex(float frame) const
+{
+	noAssertRetVal(_keys.Size() && AdjustFrame(frame, _start, _length, _method), ff::INVALID_SIZE);
+
+	// Same key that GetValue returns when the values can't be interpolated
+	const KeyFrame& findKey = *reinterpret_cast<const KeyFrame*>(&frame);
+	size_t i = std::lower_bound(_keys.cbegin(), _keys.cend(), findKey) - _keys.cbegin();
+	return (i == 0 || (i < _keys.Size() && _keys[i]._frame == frame)) ? i : i - 1;
+}
+
+size_t ff::KeyFrames::GetKeyCount() const
+{
+	return _keys.Size();
+}
+
+const ff::ValuePtr& ff::KeyFrames::GetKeyValue(size_t index) const
+{
+	return _keys[index]._value;
+}
+
+const ff::ValuePtr& ff::KeyFrames::GetDefaultValue() const
+{
+	return _default;
+}
+
 ff::KeyFrames ff::KeyFrames::LoadFromSource(ff::StringRef name, const Dict& dict, ff::IResourceLoadListener* loadListener)
 {
 	KeyFrames frames;
@@ -163,6 +299,7 @@ bool ff::KeyFrames::LoadFromCacheInternal(const Dict& dict)
 		_keys.Push(std::move(key));
 	}
 
+	CompileTrack();
 	return true;
 }
 
@@ -296,9 +433,99 @@ bool ff::KeyFrames::LoadFromSourceInternal(ff::StringRef name, const Dict& dict,
 		}
 	}
 
+	CompileTrack();
+	return true;
+}
+
+static bool GetTrackValue(const ff::ValuePtr& value, DirectX::XMFLOAT4& output)
+{
+	output = DirectX::XMFLOAT4(0, 0, 0, 0);
+
+	if (value->IsType<ff::FloatValue>())
+	{
+		output.x = value->GetValue<ff::FloatValue>();
+	}
+	else if (value->IsType<ff::PointFloatValue>())
+	{
+		const ff::PointFloat& point = value->GetValue<ff::PointFloatValue>();
+		output.x = point.x;
+		output.y = point.y;
+	}
+	else if (value->IsType<ff::RectFloatValue>())
+	{
+		std::memcpy(&output, &value->GetValue<ff::RectFloatValue>(), sizeof(output));
+	}
+	else
+	{
+		return false;
+	}
+
 	return true;
 }
 
+void ff::KeyFrames::CompileTrack()
+{
+	_track = Track{};
+
+	noAssertRet(_keys.Size());
+	ValuePtr firstValue = _keys[0]._value;
+
+	TrackType type = TrackType::None;
+	if (firstValue->IsType<ff::FloatValue>())
+	{
+		type = TrackType::Float;
+	}
+	else if (firstValue->IsType<ff::PointFloatValue>())
+	{
+		type = TrackType::PointFloat;
+	}
+	else if (firstValue->IsType<ff::RectFloatValue>())
+	{
+		type = TrackType::RectFloat;
+	}
+
+	noAssertRet(type != TrackType::None);
+
+	// Every key must interpolate the same way as the boxed values, or the keys stay boxed
+
+	size_t splineCount = 0;
+	for (const KeyFrame& key : _keys)
+	{
+		noAssertRet(key._value->IsSameType(firstValue));
+		splineCount += (key._tangentValue && key._tangentValue->IsSameType(firstValue)) ? 1 : 0;
+	}
+
+	noAssertRet(splineCount == 0 || splineCount == _keys.Size());
+
+	bool hasDefault = _default && !_default->IsType<ff::NullValue>();
+	noAssertRet(!hasDefault || _default->IsSameType(firstValue));
+
+	Track track{};
+	track._type = type;
+	track._spline = splineCount != 0;
+	track._hasDefault = hasDefault && ::GetTrackValue(_default, track._default);
+	track._frames.Reserve(_keys.Size());
+	track._values.Reserve(_keys.Size());
+	track._tangents.Reserve(track._spline ? _keys.Size() : 0);
+
+	for (const KeyFrame& key : _keys)
+	{
+		DirectX::XMFLOAT4 value;
+		verify(::GetTrackValue(key._value, value));
+
+		track._frames.Push(key._frame);
+		track._values.Push(value);
+
+		if (track._spline)
+		{
+			verify(::GetTrackValue(key._tangentValue, value));
+			track._tangents.Push(value);
+		}
+	}
+
+	_track = std::move(track);
+}
+
 ff::ValuePtr ff::KeyFrames::Interpolate(const KeyFrame& lhs, const KeyFrame& rhs, float time, const Dict* params)
 {
 	ValuePtr value = lhs._value;
@@ -12,14 +12,25 @@ namespace ff
 	class KeyFrames
 	{
 	public:
-		KeyFrames(const KeyFrames& rhs);
-		KeyFrames(KeyFrames&& rhs);
+		UTIL_API KeyFrames(const KeyFrames& rhs);
+		UTIL_API KeyFrames(KeyFrames&& rhs);
+
+		UTIL_API ValuePtr GetValue(float frame, const Dict* params = nullptr);
+
+		// Typed values (float, PointFloat, RectFloat) don't allocate when all keys have that type.
+		// The optional cursor belongs to the caller (like a player) and speeds up monotonic playback, it starts at zero.
+		template<typename T> bool GetValue(float frame, T& value, const Dict* params = nullptr, size_t* cursor = nullptr);
 
-		ValuePtr GetValue(float frame, const Dict* params = nullptr);
 		float GetStart() const;
 		float GetLength() const;
 		ff::StringRef GetName() const;
 
+		// Values that can't interpolate (like visuals) can be looked up by key index instead of by value
+		UTIL_API size_t GetStepKeyIndex(float frame) const; // INVALID_SIZE means the default value
+		UTIL_API size_t GetKeyCount() const;
+		UTIL_API const ValuePtr& GetKeyValue(size_t index) const;
+		const ValuePtr& GetDefaultValue() const;
+
 		static KeyFrames LoadFromSource(ff::StringRef name, const Dict& dict, IResourceLoadListener* loadListener = nullptr);
 		static KeyFrames LoadFromCache(const Dict& dict);
 		Dict SaveToCache() const;
@@ -54,13 +65,38 @@ namespace ff
 			ValuePtr _tangentValue;
 		};
 
+		enum class TrackType
+		{
+			None,
+			Float,
+			PointFloat,
+			RectFloat,
+		};
+
+		// Keys compiled into flat arrays when they all have the same interpolatable type
+		struct Track
+		{
+			ff::Vector<float> _frames;
+			ff::Vector<DirectX::XMFLOAT4> _values;
+			ff::Vector<DirectX::XMFLOAT4> _tangents;
+			DirectX::XMFLOAT4 _default;
+			TrackType _type;
+			bool _spline;
+			bool _hasDefault;
+		};
+
 		KeyFrames();
 		bool LoadFromCacheInternal(const Dict& dict);
 		bool LoadFromSourceInternal(ff::StringRef name, const Dict& dict, IResourceLoadListener* loadListener);
 		ValuePtr Interpolate(const KeyFrame& lhs, const KeyFrame& rhs, float time, const Dict* params);
+		void CompileTrack();
+		size_t FindTrackKey(float frame, size_t* cursor) const;
+		bool GetTrackValue(float frame, DirectX::XMFLOAT4& value, size_t* cursor) const;
+		template<typename T, typename ValueT> bool GetTypedValue(TrackType type, float frame, T& value, const Dict* params, size_t* cursor);
 
 		ff::String _name;
 		ff::Vector<KeyFrame> _keys;
+		Track _track;
 		ValuePtr _default;
 		float _start;
 		float _length;
@@ -70,16 +106,20 @@ namespace ff
 	class CreateKeyFrames
 	{
 	public:
-		CreateKeyFrames(ff::StringRef name, float start, float length, KeyFrames::MethodType method = KeyFrames::MethodType::Default, ValuePtr defaultValue = nullptr);
-		CreateKeyFrames(const CreateKeyFrames& rhs);
-		CreateKeyFrames(CreateKeyFrames&& rhs);
+		UTIL_API CreateKeyFrames(ff::StringRef name, float start, float length, KeyFrames::MethodType method = KeyFrames::MethodType::Default, ValuePtr defaultValue = nullptr);
+		UTIL_API CreateKeyFrames(const CreateKeyFrames& rhs);
+		UTIL_API CreateKeyFrames(CreateKeyFrames&& rhs);
 
-		void AddFrame(float frame, ValuePtr value);
-		KeyFrames Create() const;
+		UTIL_API void AddFrame(float frame, ValuePtr value);
+		UTIL_API KeyFrames Create() const;
 		Dict CreateSourceDict(StringOut name) const;
 
 	private:
 		Dict _dict;
 		Vector<ValuePtr> _values;
 	};
+
+	template<> UTIL_API bool KeyFrames::GetValue<float>(float frame, float& value, const Dict* params, size_t* cursor);
+	template<> UTIL_API bool KeyFrames::GetValue<PointFloat>(float frame, PointFloat& value, const Dict* params, size_t* cursor);
+	template<> UTIL_API bool KeyFrames::GetValue<RectFloat>(float frame, RectFloat& value, const Dict* params, size_t* cursor);
 }
@@ -7,7 +7,9 @@
 #include "Graph/Texture/PaletteData.h"
 #include "Graph/Texture/PngImage.h"
 #include "Graph/Texture/Texture.h"
+#include "Graph/Texture/TextureCompress.h"
 #include "String/StringUtil.h"
+#include "Types/Timer.h"
 #include "Windows/FileUtil.h"
 
 __declspec(align(16)) static const float s_identityMatrix[] =
@@ -124,6 +126,8 @@ bool ff::IsCompressedFormat(TextureFormat format)
 	case ff::TextureFormat::BC1_SRGB:
 	case ff::TextureFormat::BC2_SRGB:
 	case ff::TextureFormat::BC3_SRGB:
+	case ff::TextureFormat::BC7:
+	case ff::TextureFormat::BC7_SRGB:
 		return true;
 	}
 }
@@ -184,6 +188,8 @@ DXGI_FORMAT ff::ConvertTextureFormat(ff::TextureFormat format)
 	case ff::TextureFormat::BC1_SRGB: return DXGI_FORMAT_BC1_UNORM_SRGB;
 	case ff::TextureFormat::BC2_SRGB: return DXGI_FORMAT_BC2_UNORM_SRGB;
 	case ff::TextureFormat::BC3_SRGB: return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case ff::TextureFormat::BC7: return DXGI_FORMAT_BC7_UNORM;
+	case ff::TextureFormat::BC7_SRGB: return DXGI_FORMAT_BC7_UNORM_SRGB;
 	}
 }
 
@@ -208,6 +214,8 @@ ff::TextureFormat ff::ConvertTextureFormat(DXGI_FORMAT format)
 	case DXGI_FORMAT_BC1_UNORM_SRGB: return ff::TextureFormat::BC1_SRGB;
 	case DXGI_FORMAT_BC2_UNORM_SRGB: return ff::TextureFormat::BC2_SRGB;
 	case DXGI_FORMAT_BC3_UNORM_SRGB: return ff::TextureFormat::BC3_SRGB;
+	case DXGI_FORMAT_BC7_UNORM: return ff::TextureFormat::BC7;
+	case DXGI_FORMAT_BC7_UNORM_SRGB: return ff::TextureFormat::BC7_SRGB;
 	}
 }
 
@@ -235,6 +243,10 @@ DXGI_FORMAT ff::ParseDxgiTextureFormat(ff::StringRef szFormat)
 	{
 		format = DXGI_FORMAT_BC3_UNORM;
 	}
+	else if (szFormat == L"bc7")
+	{
+		format = DXGI_FORMAT_BC7_UNORM;
+	}
 	else if (szFormat == L"pal" || szFormat == L"palette")
 	{
 		format = DXGI_FORMAT_R8_UINT;
@@ -260,6 +272,47 @@ ff::TextureFormat ff::ParseTextureFormat(StringRef szFormat)
 	return ff::ConvertTextureFormat(ParseDxgiTextureFormat(szFormat));
 }
 
+void ff::PremultiplyAlphaRow(BYTE* pixels, size_t count)
+{
+	size_t i = 0;
+
+#ifdef _XM_SSE_INTRINSICS_
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi16(128);
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i* cur = reinterpret_cast<__m128i*>(pixels + i * 4);
+		__m128i source = _mm_loadu_si128(cur);
+		__m128i lo = _mm_unpacklo_epi8(source, zero);
+		__m128i hi = _mm_unpackhi_epi8(source, zero);
+		__m128i loAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m128i hiAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+		// x * a / 255, rounded
+		lo = _mm_add_epi16(_mm_mullo_epi16(lo, loAlpha), half);
+		hi = _mm_add_epi16(_mm_mullo_epi16(hi, hiAlpha), half);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		__m128i result = _mm_packus_epi16(lo, hi);
+		result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, source));
+		_mm_storeu_si128(cur, result);
+	}
+#endif
+
+	for (BYTE* cur = pixels + i * 4; i < count; i++, cur += 4)
+	{
+		unsigned int alpha = cur[3];
+		for (size_t h = 0; h < 3; h++)
+		{
+			unsigned int value = cur[h] * alpha + 128;
+			cur[h] = (BYTE)((value + (value >> 8)) >> 8);
+		}
+	}
+}
+
 static bool IsSoftwareAdapter(IDXGIAdapterX* adapter)
 {
 	assertRetVal(adapter, true);
@@ -551,14 +604,15 @@ ff::SpriteType ff::GetSpriteTypeForImage(const DirectX::ScratchImage& scratch, c
 	return newType;
 }
 
-static DirectX::ScratchImage LoadTexturePng(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch)
+static DirectX::ScratchImage LoadTexturePng(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch, ff::TextureCompression compression, bool premultiply)
 {
 	DirectX::ScratchImage scratchFinal;
 	ff::ComPtr<ff::IData> pngData;
 	assertRetVal(ff::ReadWholeFileMemMapped(path, &pngData), scratchFinal);
 	ff::PngImageReader png(pngData->GetMem(), pngData->GetSize());
 	{
-		std::unique_ptr<DirectX::ScratchImage> scratchTemp = png.Read(format);
+		// Rows are converted to the final format while decoding, only compressed formats need another pass
+		std::unique_ptr<DirectX::ScratchImage> scratchTemp = png.Read(format, premultiply);
 		if (scratchTemp)
 		{
 			scratchFinal = std::move(*scratchTemp);
@@ -615,15 +669,8 @@ static DirectX::ScratchImage LoadTexturePng(ff::StringRef path, DXGI_FORMAT form
 
 	if (DirectX::IsCompressed(format))
 	{
-		DirectX::ScratchImage scratchNew;
-		assertHrRetVal(DirectX::Compress(
-			scratchFinal.GetImages(),
-			scratchFinal.GetImageCount(),
-			scratchFinal.GetMetadata(),
-			format,
-			DirectX::TEX_COMPRESS_DEFAULT,
-			0, // alpharef
-			scratchNew), DirectX::ScratchImage());
+		DirectX::ScratchImage scratchNew = ff::CompressTextureData(scratchFinal, format, compression);
+		assertRetVal(scratchNew.GetImageCount(), DirectX::ScratchImage());
 
 		scratchFinal = std::move(scratchNew);
 	}
@@ -669,7 +716,7 @@ static DirectX::ScratchImage LoadTexturePal(ff::StringRef path, DXGI_FORMAT form
 	return scratchFinal;
 }
 
-DirectX::ScratchImage ff::LoadTextureData(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch)
+DirectX::ScratchImage ff::LoadTextureData(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch, TextureCompression compression, bool premultiply)
 {
 	ff::String pathExt = ff::GetPathExtension(path);
 	ff::LowerCaseInPlace(pathExt);
@@ -680,7 +727,7 @@ DirectX::ScratchImage ff::LoadTextureData(ff::StringRef path, DXGI_FORMAT format
 	}
 	else if (pathExt == L"png")
 	{
-		return ::LoadTexturePng(path, format, mips, paletteScratch);
+		return ::LoadTexturePng(path, format, mips, paletteScratch, compression, premultiply);
 	}
 	else
 	{
@@ -688,7 +735,7 @@ DirectX::ScratchImage ff::LoadTextureData(ff::StringRef path, DXGI_FORMAT format
 	}
 }
 
-DirectX::ScratchImage ff::ConvertTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, size_t mips)
+DirectX::ScratchImage ff::ConvertTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, size_t mips, TextureCompression compression)
 {
 	assertRetVal(data.GetImageCount(), DirectX::ScratchImage());
 
@@ -756,15 +803,8 @@ DirectX::ScratchImage ff::ConvertTextureData(const DirectX::ScratchImage& data,
 
 		if (DirectX::IsCompressed(format))
 		{
-			DirectX::ScratchImage scratchNew;
-			assertHrRetVal(DirectX::Compress(
-				scratchFinal.GetImages(),
-				scratchFinal.GetImageCount(),
-				scratchFinal.GetMetadata(),
-				format,
-				DirectX::TEX_COMPRESS_DEFAULT,
-				0, // alpharef
-				scratchNew), DirectX::ScratchImage());
+			DirectX::ScratchImage scratchNew = ff::CompressTextureData(scratchFinal, format, compression);
+			assertRetVal(scratchNew.GetImageCount(), DirectX::ScratchImage());
 
 			scratchFinal = std::move(scratchNew);
 		}
@@ -787,6 +827,53 @@ DirectX::ScratchImage ff::ConvertTextureData(const DirectX::ScratchImage& data,
 	return scratchFinal;
 }
 
+bool ff::MeasureTextureDecode(StringRef path, DXGI_FORMAT format, bool premultiply, TextureDecodeReport& report)
+{
+	report = TextureDecodeReport{};
+
+	ff::ComPtr<ff::IData> pngData;
+	assertRetVal(ff::ReadWholeFileMemMapped(path, &pngData), false);
+
+	// The old way: a whole RGBA image, then a whole converted image, then a whole premultiplied image
+	ff::Timer timer;
+	{
+		ff::PngImageReader png(pngData->GetMem(), pngData->GetSize());
+		std::unique_ptr<DirectX::ScratchImage> scratch = png.Read(DXGI_FORMAT_R8G8B8A8_UNORM);
+		assertRetVal(scratch, false);
+
+		report._imageBytes = scratch->GetPixelsSize();
+		report._convertPeakBytes = scratch->GetPixelsSize();
+
+		if (scratch->GetMetadata().format != format)
+		{
+			DirectX::ScratchImage scratchNew;
+			assertHrRetVal(DirectX::Convert(*scratch->GetImages(), format, DirectX::TEX_FILTER_DEFAULT, 0, scratchNew), false);
+			report._convertPeakBytes = scratch->GetPixelsSize() + scratchNew.GetPixelsSize();
+			*scratch = std::move(scratchNew);
+		}
+
+		if (premultiply)
+		{
+			DirectX::ScratchImage scratchNew;
+			assertHrRetVal(DirectX::PremultiplyAlpha(*scratch->GetImages(), DirectX::TEX_PMALPHA_DEFAULT, scratchNew), false);
+			report._convertPeakBytes = std::max(report._convertPeakBytes, scratch->GetPixelsSize() + scratchNew.GetPixelsSize());
+		}
+	}
+
+	report._convertSeconds = timer.Tick();
+	{
+		ff::PngImageReader png(pngData->GetMem(), pngData->GetSize());
+		std::unique_ptr<DirectX::ScratchImage> scratch = png.Read(format, premultiply);
+		assertRetVal(scratch && scratch->GetMetadata().format == format, false);
+
+		report._directPeakBytes = scratch->GetPixelsSize();
+	}
+
+	report._directSeconds = timer.Tick();
+
+	return true;
+}
+
 // This method determines the rotation between the display device's native orientation and the
 // current display orientation.
 DXGI_MODE_ROTATION ff::ComputeDisplayRotation(DXGI_MODE_ROTATION nativeOrientation, DXGI_MODE_ROTATION currentOrientation)
@@ -5,6 +5,7 @@ namespace ff
 	class IGraphDevice;
 	class IPaletteData;
 	enum class SpriteType;
+	enum class TextureCompression;
 	enum class TextureFormat;
 
 	struct GraphCounters
@@ -43,6 +44,22 @@ namespace ff
 	TextureFormat ConvertTextureFormat(DXGI_FORMAT format);
 	UTIL_API DXGI_FORMAT ParseDxgiTextureFormat(StringRef szFormat);
 	UTIL_API TextureFormat ParseTextureFormat(StringRef szFormat);
+
+	// Multiplies color by alpha for a row of RGBA or BGRA pixels, alpha is the last byte of each pixel either way.
+	// The SIMD version is used when the CPU supports it, the results are the same as the scalar code.
+	UTIL_API void PremultiplyAlphaRow(BYTE* pixels, size_t count);
+
+	struct TextureDecodeReport
+	{
+		size_t _imageBytes; // decoded bytes
+		double _convertSeconds; // decode to RGBA, then convert the whole image
+		double _directSeconds; // decode rows straight into the final format
+		size_t _convertPeakBytes; // pixel buffers that are alive at the same time
+		size_t _directPeakBytes;
+	};
+
+	// Decodes a PNG file both ways, to measure the cost of full size temporary images
+	UTIL_API bool MeasureTextureDecode(StringRef path, DXGI_FORMAT format, bool premultiply, TextureDecodeReport& report);
 	ff::hash_t GetAdaptersHash(IDXGIFactoryX* factory);
 	ff::hash_t GetAdapterOutputsHash(IDXGIFactoryX* dxgi, IDXGIAdapterX* card);
 	ff::Vector<ff::ComPtr<IDXGIOutputX>> GetAdapterOutputs(IDXGIFactoryX* dxgi, IDXGIAdapterX* card);
@@ -80,8 +97,8 @@ namespace ff
 
 #ifdef UTIL_DLL
 	ff::ComPtr<ID3D11ShaderResourceView> CreateDefaultTextureView(ID3D11DeviceX* device, ID3D11Texture2D* texture);
-	DirectX::ScratchImage LoadTextureData(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch);
-	DirectX::ScratchImage ConvertTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, size_t mips);
+	DirectX::ScratchImage LoadTextureData(ff::StringRef path, DXGI_FORMAT format, size_t mips, DirectX::ScratchImage* paletteScratch, TextureCompression compression, bool premultiply);
+	DirectX::ScratchImage ConvertTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, size_t mips, TextureCompression compression);
 	ff::SpriteType GetSpriteTypeForImage(const DirectX::ScratchImage& scratch, const ff::RectSize* rect = nullptr);
 #endif
 }
@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "Data/DataPersist.h"
+#include "Graph/Font/CharGlyphTable.h"
+
+ff::CharGlyphTable::CharGlyphTable()
+{
+	Clear();
+}
+
+void ff::CharGlyphTable::SetGlyph(wchar_t ch, UINT16 glyph)
+{
+	if (ch < PAGE_SIZE)
+	{
+		_latin[ch] = glyph;
+		return;
+	}
+
+	BYTE& pageIndex = _pageIndexes[ch >> 8];
+	if (!pageIndex)
+	{
+		noAssertRet(glyph);
+
+		pageIndex = (BYTE)_pages.Size();
+		_pages.Push(Page{});
+	}
+
+	_pages[pageIndex][ch & 0xFF] = glyph;
+}
+
+void ff::CharGlyphTable::Clear()
+{
+	ff::ZeroObject(_latin);
+	ff::ZeroObject(_pageIndexes);
+
+	_pages.Clear();
+	_pages.Push(Page{});
+}
+
+size_t ff::CharGlyphTable::GetPageCount() const
+{
+	return _pages.Size() - 1;
+}
+
+size_t ff::CharGlyphTable::GetMemorySize() const
+{
+	return sizeof(*this) + _pages.ByteSize();
+}
+
+bool ff::CharGlyphTable::Save(IDataWriter* writer) const
+{
+	DWORD pageCount = (DWORD)GetPageCount();
+	assertRetVal(ff::SaveData(writer, _latin), false);
+	assertRetVal(ff::SaveData(writer, pageCount), false);
+
+	for (size_t i = 1; i < PAGE_COUNT; i++)
+	{
+		if (_pageIndexes[i])
+		{
+			BYTE page = (BYTE)i;
+			assertRetVal(ff::SaveData(writer, page), false);
+			assertRetVal(ff::SaveData(writer, _pages[_pageIndexes[i]]), false);
+		}
+	}
+
+	return true;
+}
+
+bool ff::CharGlyphTable::Load(IDataReader* reader)
+{
+	Clear();
+
+	DWORD pageCount = 0;
+	assertRetVal(ff::LoadData(reader, _latin), false);
+	assertRetVal(ff::LoadData(reader, pageCount), false);
+	assertRetVal(pageCount < PAGE_COUNT, false);
+
+	for (DWORD i = 0; i < pageCount; i++)
+	{
+		BYTE page = 0;
+		assertRetVal(ff::LoadData(reader, page), false);
+		assertRetVal(page && !_pageIndexes[page], false);
+
+		_pageIndexes[page] = (BYTE)_pages.Size();
+		_pages.Push(Page{});
+		assertRetVal(ff::LoadData(reader, _pages.GetLast()), false);
+	}
+
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+namespace ff
+{
+	class IDataReader;
+	class IDataWriter;
+
+	// Maps UTF-16 characters to font glyph indexes. Characters are grouped into pages of 256
+	// and only the pages that map to a glyph are allocated. Latin-1 is always a dense array.
+	class CharGlyphTable
+	{
+	public:
+		UTIL_API CharGlyphTable();
+
+		inline UINT16 GetGlyph(wchar_t ch) const;
+		UTIL_API void SetGlyph(wchar_t ch, UINT16 glyph);
+		UTIL_API void Clear();
+
+		UTIL_API size_t GetPageCount() const; // doesn't include Latin-1 or the shared empty page
+		UTIL_API size_t GetMemorySize() const;
+
+		UTIL_API bool Save(IDataWriter* writer) const;
+		UTIL_API bool Load(IDataReader* reader);
+
+	private:
+		static const size_t PAGE_SIZE = 0x100;
+		static const size_t PAGE_COUNT = 0x10000 / PAGE_SIZE;
+		typedef std::array<UINT16, PAGE_SIZE> Page;
+
+		Page _latin;
+		std::array<BYTE, PAGE_COUNT> _pageIndexes; // zero is the shared empty page
+		ff::Vector<Page> _pages;
+	};
+}
+
+UINT16 ff::CharGlyphTable::GetGlyph(wchar_t ch) const
+{
+	return (ch < PAGE_SIZE) ? _latin[ch] : _pages[_pageIndexes[ch >> 8]][ch & 0xFF];
+}
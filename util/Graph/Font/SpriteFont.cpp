@@ -1,14 +1,17 @@
 #include "pch.h"
 #include "COM/ComAlloc.h"
 #include "Data/Data.h"
+#include "Data/DataWriterReader.h"
 #include "Dict/Dict.h"
 #include "Globals/AppGlobals.h"
+#include "Globals/Log.h"
 #include "Globals/ProcessGlobals.h"
 #include "Graph/Anim/Transform.h"
 #include "Graph/Sprite/Sprite.h"
 #include "Graph/Sprite/SpriteList.h"
 #include "Graph/Sprite/SpriteOptimizer.h"
 #include "Graph/Sprite/SpriteType.h"
+#include "Graph/Font/CharGlyphTable.h"
 #include "Graph/Font/FontData.h"
 #include "Graph/Font/SpriteFont.h"
 #include "Graph/GraphDevice.h"
@@ -20,12 +23,15 @@
 #include "Resource/ResourcePersist.h"
 #include "Resource/ResourceValue.h"
 #include "String/StringUtil.h"
+#include "Thread/ThreadUtil.h"
 #include "Types/Timer.h"
 #include "Value/Values.h"
 
 static ff::StaticString PROP_AA(L"aa");
+static ff::StaticString PROP_CHAR_GLYPHS(L"charGlyphs");
 static ff::StaticString PROP_DATA(L"data");
 static ff::StaticString PROP_GLYPHS(L"glyphs");
+static ff::StaticString PROP_KERNING(L"kerning");
 static ff::StaticString PROP_OUTLINE(L"outline");
 static ff::StaticString PROP_SIZE(L"size");
 static ff::StaticString PROP_SPRITES(L"sprites");
@@ -34,6 +40,52 @@ static ff::StaticString PROP_OUTLINE_SPRITES(L"outlineSprites");
 static const DWRITE_GLYPH_OFFSET s_zeroOffset{ 0, 0 };
 static const DWRITE_MATRIX s_identityTransform{ 1.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
 
+// STATIC_DATA (pod)
+static std::atomic<bool> s_recordBuildTimes = false;
+
+// STATIC_DATA (object)
+static ff::Vector<ff::SpriteFontBuildTime> s_buildTimes;
+static bool s_initBuildTimesStatics;
+
+static ff::Mutex& GetStaticMutex()
+{
+	static ff::Mutex s_mutex;
+	return s_mutex;
+}
+
+// Kerning pairs between these characters (Basic Latin through Latin Extended-B) are precomputed
+static const size_t KERNING_CHAR_COUNT = 0x250;
+static const size_t MAX_CACHED_LAYOUTS = 256;
+static const size_t GLYPHS_PER_TASK = 64;
+
+// Caches used to save a glyph info for every UTF-16 character
+static const size_t LEGACY_GLYPH_COUNT = 0x10000;
+
+struct LegacyGlyphInfo
+{
+	UINT16 _glyphToSprite;
+	UINT16 _charToGlyph;
+	float _glyphWidth;
+};
+
+static ff::String GetFontFamilyName(IDWriteFontFaceX* fontFace)
+{
+	ff::ComPtr<IDWriteLocalizedStrings> names;
+	UINT32 length = 0;
+	if (SUCCEEDED(fontFace->GetFamilyNames(&names)) && names->GetCount() && SUCCEEDED(names->GetStringLength(0, &length)))
+	{
+		ff::String name;
+		name.resize(length + 1);
+		if (SUCCEEDED(names->GetString(0, &name[0], length + 1)))
+		{
+			name.resize(length);
+			return name;
+		}
+	}
+
+	return ff::String(L"Font");
+}
+
 class __declspec(uuid("c87f399b-5a75-4e0a-8b80-cebc58e2eaa2"))
 	SpriteFont
 	: public ff::ComBase
@@ -65,26 +117,73 @@ public:
 	virtual bool FinishLoadFromSource() override;
 
 private:
+	struct KerningPair
+	{
+		bool operator<(const KerningPair& rhs) const;
+
+		UINT32 _glyphs; // first glyph in the high word
+		INT32 _designKern;
+	};
+
+	struct TextLayoutGlyph
+	{
+		ff::PointFloat _offset;
+		DirectX::XMFLOAT4 _color;
+		UINT16 _sprite;
+		bool _customColor;
+	};
+
+	struct TextLayoutKey
+	{
+		bool operator==(const TextLayoutKey& rhs) const;
+
+		ff::hash_t _textHash;
+		ff::ISpriteList* _sprites;
+		ff::PointFloat _scale;
+		ff::SpriteFontOptions _options;
+	};
+
+	// Glyph positions are relative to the transform position, so a layout can be drawn anywhere
+	struct TextLayout
+	{
+		TextLayoutKey _key;
+		ff::hash_t _hash;
+		ff::String _text;
+		ff::PointFloat _size;
+		ff::Vector<TextLayoutGlyph> _glyphs;
+	};
+
 	bool InitSprites();
+	bool LoadLegacyGlyphs(ff::IData* data);
+	bool InitKerning(IDWriteFontFaceX* fontFace);
+	int GetKerning(IDWriteFontFaceX* fontFace, wchar_t first, wchar_t second) const;
+	bool LayoutText(IDWriteFontFaceX* fontFace, ff::ISpriteList* sprites, ff::StringRef text, ff::PointFloat scale, ff::SpriteFontOptions options, TextLayout& layout) const;
+	const TextLayout* GetTextLayout(IDWriteFontFaceX* fontFace, ff::ISpriteList* sprites, ff::StringRef text, ff::PointFloat scale, ff::SpriteFontOptions options);
+	void DrawTextLayout(ff::IRendererActive* render, ff::ISpriteList* sprites, const TextLayout& layout, const ff::Transform& transform) const;
 	ff::PointFloat InternalDrawText(ff::IRendererActive* render, ff::ISpriteList* sprites, ff::StringRef text, const ff::Transform& transform, ff::SpriteFontOptions options);
 
-	static const size_t MAX_GLYPH_COUNT = 0x10000;
-
-	struct CharAndGlyphInfo
+	struct GlyphInfo
 	{
-		UINT16 _glyphToSprite;
-		UINT16 _charToGlyph;
-		float _glyphWidth;
+		UINT16 _sprite;
+		float _width;
 	};
 
 	ff::ComPtr<ff::IGraphDevice> _device;
 	ff::ComPtr<ff::ISpriteList> _sprites;
 	ff::ComPtr<ff::ISpriteList> _outlineSprites;
 	ff::TypedResource<ff::IFontData> _data;
-	std::array<CharAndGlyphInfo, MAX_GLYPH_COUNT> _glyphs;
+	ff::CharGlyphTable _charToGlyph;
+	ff::Vector<GlyphInfo> _glyphs; // indexed by glyph
+	ff::Vector<KerningPair> _kerning;
+	bool _hasKerningTable;
 	float _size;
 	int _outlineThickness;
 	bool _antiAlias;
+
+	// Most recently used layouts are first in the list
+	ff::Mutex _layoutMutex;
+	ff::List<TextLayout> _layouts;
+	ff::Map<ff::hash_t, TextLayout*, ff::NonHasher<ff::hash_t>> _layoutMap;
 };
 
 BEGIN_INTERFACES(SpriteFont)
@@ -99,11 +198,11 @@ static ff::ModuleStartup Register([](ff::Module& module)
 	});
 
 SpriteFont::SpriteFont()
-	: _size(0)
+	: _hasKerningTable(false)
+	, _size(0)
 	, _outlineThickness(0)
 	, _antiAlias(false)
 {
-	ff::ZeroObject(_glyphs);
 }
 
 SpriteFont::~SpriteFont()
@@ -163,8 +262,13 @@ bool SpriteFont::InitSprites()
 	ff::Vector<SpriteInfo> spriteInfos;
 	spriteInfos.Reserve(fontFace->GetGlyphCount());
 
-	std::array<bool, MAX_GLYPH_COUNT> hasGlyph;
-	ff::ZeroObject(hasGlyph);
+	_charToGlyph.Clear();
+	_glyphs.Resize(fontFace->GetGlyphCount());
+	::ZeroMemory(_glyphs.Data(), _glyphs.ByteSize());
+
+	ff::Vector<bool> hasGlyph;
+	hasGlyph.Resize(_glyphs.Size());
+	::ZeroMemory(hasGlyph.Data(), hasGlyph.ByteSize());
 
 	// Map unicode characters to glyphs
 	{
@@ -175,97 +279,176 @@ bool SpriteFont::InitSprites()
 		unicodeRanges.Resize(unicodeRangeCount);
 		assertHrRetVal(fontFace->GetUnicodeRanges(unicodeRangeCount, unicodeRanges.Data(), &unicodeRangeCount), false);
 
-		ff::Vector<UINT16> unicodeToGlyph;
-		unicodeToGlyph.Reserve(MAX_GLYPH_COUNT);
+		ff::Vector<UINT32> rangeChars;
+		ff::Vector<UINT16> rangeGlyphs;
 		for (const DWRITE_UNICODE_RANGE& ur : unicodeRanges)
 		{
-			for (UINT32 ch = ur.first; ch < MAX_GLYPH_COUNT && ch <= ur.last; ch++)
+			// Only UTF-16 characters that fit in a single wchar_t can be drawn
+			UINT32 last = std::min<UINT32>(ur.last, 0xFFFF);
+			if (ur.first > last)
+			{
+				continue;
+			}
+
+			rangeChars.Resize(last - ur.first + 1);
+			rangeGlyphs.Resize(rangeChars.Size());
+
+			for (size_t i = 0; i < rangeChars.Size(); i++)
+			{
+				rangeChars[i] = ur.first + (UINT32)i;
+			}
+
+			if (SUCCEEDED(fontFace->GetGlyphIndices(rangeChars.ConstData(), (UINT32)rangeChars.Size(), rangeGlyphs.Data())))
 			{
-				UINT16 glyph;
-				if (SUCCEEDED(fontFace->GetGlyphIndices(&ch, 1, &glyph)))
+				for (size_t i = 0; i < rangeChars.Size(); i++)
 				{
-					_glyphs[ch]._charToGlyph = glyph;
-					hasGlyph[glyph] = true;
+					UINT16 glyph = rangeGlyphs[i];
+					if (glyph < hasGlyph.Size())
+					{
+						_charToGlyph.SetGlyph((wchar_t)rangeChars[i], glyph);
+						hasGlyph[glyph] = true;
+					}
 				}
 			}
 		}
 	}
 
-	ff::Vector<DirectX::ScratchImage> stagingScratches;
-	const ff::PointInt stagingTextureSize(1024, 1024);
-	ff::PointInt stagingPos(0, 0);
-	int stagingRowHeight = 0;
-
-	DirectX::ScratchImage stagingScratch;
-	assertHrRetVal(stagingScratch.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, stagingTextureSize.x, stagingTextureSize.y, 1, 1), false);
-	::ZeroMemory(stagingScratch.GetPixels(), stagingScratch.GetPixelsSize());
-
-	float glyphAdvances = 0;
-	ff::Vector<BYTE> glyphBytes;
-	ff::Map<ff::hash_t, UINT16, ff::NonHasher<ff::hash_t>> hashToSprite;
-	DWRITE_TEXTURE_TYPE glyphTextureType = _antiAlias ? DWRITE_TEXTURE_CLEARTYPE_3x1 : DWRITE_TEXTURE_ALIASED_1x1;
+	// Rasterize glyphs in parallel, each task handles a range of glyphs
 
-	UINT16 glyphId = 0;
-	DWRITE_GLYPH_RUN gr;
-	ff::ZeroObject(gr);
-	gr.fontEmSize = _size;
-	gr.fontFace = fontFace;
-	gr.glyphAdvances = &glyphAdvances;
-	gr.glyphCount = 1;
-	gr.glyphIndices = &glyphId;
-	gr.glyphOffsets = &s_zeroOffset;
+	struct RasterGlyph
+	{
+		ff::Vector<BYTE> _alpha;
+		ff::RectInt _blackBox;
+		ff::PointFloat _handle;
+		ff::hash_t _hash;
+	};
 
-	for (size_t i = 0; i < MAX_GLYPH_COUNT; i++)
+	ff::Vector<UINT16> glyphIds;
+	for (size_t i = 0; i < hasGlyph.Size(); i++)
 	{
-		if (!hasGlyph[i])
+		if (hasGlyph[i])
 		{
-			continue;
+			glyphIds.Push((UINT16)i);
 		}
+	}
 
-		glyphId = (UINT16)i;
+	ff::Vector<RasterGlyph> rasterGlyphs;
+	rasterGlyphs.Resize(glyphIds.Size());
 
-		DWRITE_GLYPH_METRICS gm;
-		if (FAILED(fontFace->GetDesignGlyphMetrics(&glyphId, 1, &gm)))
-		{
-			continue;
-		}
+	ff::Timer timer;
+	size_t taskCount = (glyphIds.Size() + ::GLYPHS_PER_TASK - 1) / ::GLYPHS_PER_TASK;
+	DWRITE_TEXTURE_TYPE glyphTextureType = _antiAlias ? DWRITE_TEXTURE_CLEARTYPE_3x1 : DWRITE_TEXTURE_ALIASED_1x1;
 
-		_glyphs[i]._glyphWidth = gm.advanceWidth * designUnitSize;
-
-		ff::ComPtr<IDWriteGlyphRunAnalysis> gra;
-		if (FAILED(factory->CreateGlyphRunAnalysis(
-			&gr,
-			&s_identityTransform,
-			_antiAlias ? DWRITE_RENDERING_MODE1_NATURAL : DWRITE_RENDERING_MODE1_ALIASED,
-			DWRITE_MEASURING_MODE_NATURAL,
-			DWRITE_GRID_FIT_MODE_DEFAULT,
-			DWRITE_TEXT_ANTIALIAS_MODE_CLEARTYPE,
-			0, 0,
-			&gra)))
+	ff::ParallelFor(taskCount, [this, factory, fontFace, designUnitSize, glyphTextureType, &glyphIds, &rasterGlyphs](size_t task)
+	{
+		float glyphAdvances = 0;
+		ff::Vector<BYTE> glyphBytes;
+
+		UINT16 glyphId = 0;
+		DWRITE_GLYPH_RUN gr;
+		ff::ZeroObject(gr);
+		gr.fontEmSize = _size;
+		gr.fontFace = fontFace;
+		gr.glyphAdvances = &glyphAdvances;
+		gr.glyphCount = 1;
+		gr.glyphIndices = &glyphId;
+		gr.glyphOffsets = &s_zeroOffset;
+
+		for (size_t i = task * ::GLYPHS_PER_TASK; i < glyphIds.Size() && i < (task + 1) * ::GLYPHS_PER_TASK; i++)
 		{
-			continue;
-		}
+			glyphId = glyphIds[i];
 
-		RECT bounds;
-		if (FAILED(gra->GetAlphaTextureBounds(glyphTextureType, &bounds)))
-		{
-			continue;
-		}
+			DWRITE_GLYPH_METRICS gm;
+			if (FAILED(fontFace->GetDesignGlyphMetrics(&glyphId, 1, &gm)))
+			{
+				continue;
+			}
 
-		ff::RectInt blackBox(bounds.left, bounds.top, bounds.right, bounds.bottom);
-		if (blackBox.IsEmpty())
-		{
-			continue;
+			_glyphs[glyphId]._width = gm.advanceWidth * designUnitSize;
+
+			ff::ComPtr<IDWriteGlyphRunAnalysis> gra;
+			if (FAILED(factory->CreateGlyphRunAnalysis(
+				&gr,
+				&s_identityTransform,
+				_antiAlias ? DWRITE_RENDERING_MODE1_NATURAL : DWRITE_RENDERING_MODE1_ALIASED,
+				DWRITE_MEASURING_MODE_NATURAL,
+				DWRITE_GRID_FIT_MODE_DEFAULT,
+				DWRITE_TEXT_ANTIALIAS_MODE_CLEARTYPE,
+				0, 0,
+				&gra)))
+			{
+				continue;
+			}
+
+			RECT bounds;
+			if (FAILED(gra->GetAlphaTextureBounds(glyphTextureType, &bounds)))
+			{
+				continue;
+			}
+
+			ff::RectInt blackBox(bounds.left, bounds.top, bounds.right, bounds.bottom);
+			if (blackBox.IsEmpty())
+			{
+				continue;
+			}
+
+			size_t pixelStride = _antiAlias ? 3 : 1;
+			glyphBytes.Resize(blackBox.Area() * pixelStride);
+			if (FAILED(gra->CreateAlphaTexture(glyphTextureType, &bounds, glyphBytes.Data(), (UINT32)glyphBytes.Size())))
+			{
+				continue;
+			}
+
+			RasterGlyph& raster = rasterGlyphs[i];
+			raster._alpha.Resize(blackBox.Area());
+			raster._blackBox = blackBox;
+			raster._handle = ff::PointFloat(-gm.leftSideBearing * designUnitSize, blackBox.Height() + gm.bottomSideBearing * designUnitSize);
+
+			for (size_t h = 0; h < raster._alpha.Size(); h++)
+			{
+				if (_antiAlias)
+				{
+					float value =
+						(float)glyphBytes[h * pixelStride + 0] +
+						(float)glyphBytes[h * pixelStride + 1] +
+						(float)glyphBytes[h * pixelStride + 2];
+					raster._alpha[h] = (BYTE)((size_t)(value / 3) & 0xFF);
+				}
+				else
+				{
+					raster._alpha[h] = glyphBytes[h];
+				}
+			}
+
+			raster._hash = ff::HashBytes(raster._alpha.ConstData(), raster._alpha.ByteSize());
 		}
+	});
+
+	double rasterizeSeconds = timer.Tick();
 
-		glyphBytes.Resize(blackBox.Area() * (_antiAlias ? 3 : 1));
-		if (FAILED(gra->CreateAlphaTexture(glyphTextureType, &bounds, glyphBytes.Data(), (UINT32)glyphBytes.Size())))
+	// Copy unique glyphs into staging textures, in glyph order so the output doesn't depend on thread timing
+
+	ff::Vector<DirectX::ScratchImage> stagingScratches;
+	const ff::PointInt stagingTextureSize(1024, 1024);
+	ff::PointInt stagingPos(0, 0);
+	int stagingRowHeight = 0;
+
+	DirectX::ScratchImage stagingScratch;
+	assertHrRetVal(stagingScratch.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, stagingTextureSize.x, stagingTextureSize.y, 1, 1), false);
+	::ZeroMemory(stagingScratch.GetPixels(), stagingScratch.GetPixelsSize());
+
+	ff::Map<ff::hash_t, UINT16, ff::NonHasher<ff::hash_t>> hashToSprite;
+
+	for (size_t i = 0; i < rasterGlyphs.Size(); i++)
+	{
+		const RasterGlyph& raster = rasterGlyphs[i];
+		const ff::RectInt& blackBox = raster._blackBox;
+		if (raster._alpha.IsEmpty())
 		{
 			continue;
 		}
 
-		ff::hash_t glyphBytesHash = ff::HashBytes(glyphBytes.ConstData(), glyphBytes.ByteSize());
-		auto iter = hashToSprite.GetKey(glyphBytesHash);
+		auto iter = hashToSprite.GetKey(raster._hash);
 		if (!iter)
 		{
 			if (stagingPos.x + blackBox.Width() > stagingTextureSize.x)
@@ -291,10 +474,9 @@ bool SpriteFont::InitSprites()
 
 			// Copy bits to the texture
 
-			size_t pixelStride = _antiAlias ? 3 : 1;
 			for (int y = 0; y < blackBox.Height(); y++)
 			{
-				LPBYTE pAlpha = &glyphBytes[y * blackBox.Width() * pixelStride];
+				const BYTE* pAlpha = &raster._alpha[y * blackBox.Width()];
 				LPBYTE pData = stagingScratch.GetImages()->pixels + (stagingPos.y + y) * stagingScratch.GetImages()->rowPitch + stagingPos.x * 4;
 
 				for (int x = 0; x < blackBox.Width(); x++)
@@ -302,19 +484,7 @@ bool SpriteFont::InitSprites()
 					pData[x * 4 + 0] = 255;
 					pData[x * 4 + 1] = 255;
 					pData[x * 4 + 2] = 255;
-
-					if (_antiAlias)
-					{
-						float value =
-							(float)pAlpha[x * pixelStride + 0] +
-							(float)pAlpha[x * pixelStride + 1] +
-							(float)pAlpha[x * pixelStride + 2];
-						pData[x * 4 + 3] = (BYTE)((size_t)(value / 3) & 0xFF);
-					}
-					else
-					{
-						pData[x * 4 + 3] = pAlpha[x * pixelStride];
-					}
+					pData[x * 4 + 3] = pAlpha[x];
 				}
 			}
 
@@ -324,19 +494,20 @@ bool SpriteFont::InitSprites()
 				{
 					stagingScratches.Size(),
 					ff::RectInt(stagingPos, stagingPos + blackBox.Size()).ToType<float>(),
-					ff::PointFloat(-gm.leftSideBearing * designUnitSize, blackBox.Height() + gm.bottomSideBearing * designUnitSize),
+					raster._handle,
 				});
 
 			stagingPos.x += blackBox.Width() + 1;
 			stagingRowHeight = std::max(stagingRowHeight, blackBox.Height());
 
-			iter = hashToSprite.SetKey(glyphBytesHash, (UINT16)(spriteInfos.Size() - 1));
+			iter = hashToSprite.SetKey(raster._hash, (UINT16)(spriteInfos.Size() - 1));
 		}
 
-		_glyphs[i]._glyphToSprite = iter->GetValue();
+		_glyphs[glyphIds[i]]._sprite = iter->GetValue();
 	}
 
 	stagingScratches.Push(std::move(stagingScratch));
+	assertRetVal(InitKerning(fontFace), false);
 
 	ff::Vector<ff::ComPtr<ff::ITextureView>> textures;
 	for (DirectX::ScratchImage& scratch : stagingScratches)
@@ -356,46 +527,177 @@ bool SpriteFont::InitSprites()
 
 	// Create optimized sprite list
 	assertRetVal(ff::OptimizeSprites(sprites, ff::TextureFormat::BC2, 1, &_sprites), false);
+	double optimizeSeconds = timer.Tick();
 
 	if (_outlineThickness)
 	{
 		assertRetVal(ff::CreateOutlineSprites(sprites, ff::TextureFormat::BC2, 1, &_outlineSprites), false);
 	}
 
+	// Each Tick() returns the time since the previous one
+	double outlineSeconds = timer.Tick();
+	double totalSeconds = rasterizeSeconds + optimizeSeconds + outlineSeconds;
+	ff::String fontName = ff::String::format_new(L"%s %g", ::GetFontFamilyName(fontFace).c_str(), _size);
+
+	ff::Log::GlobalTraceF(L"SpriteFont: %s: %lu glyphs, %lu threads, rasterize:%.3fms, optimize:%.3fms, outline:%.3fms, total:%.3fms\n",
+		fontName.c_str(),
+		glyphIds.Size(),
+		std::min(taskCount, ff::GetParallelThreadCount()),
+		rasterizeSeconds * 1000.0,
+		optimizeSeconds * 1000.0,
+		outlineSeconds * 1000.0,
+		totalSeconds * 1000.0);
+
+	if (s_recordBuildTimes)
+	{
+		ff::OutlineSpritesReport outlineReport;
+		ff::ZeroObject(outlineReport);
+
+		if (_outlineThickness)
+		{
+			assertRetVal(ff::MeasureOutlineSprites(sprites, ff::TextureFormat::BC2, outlineReport), false);
+		}
+
+		ff::LockMutex lock(::GetStaticMutex());
+		s_buildTimes.Push(ff::SpriteFontBuildTime
+			{
+				fontName, glyphIds.Size(), rasterizeSeconds, optimizeSeconds, outlineSeconds, totalSeconds,
+				outlineReport._perTextureSeconds, outlineReport._packedSeconds,
+				outlineReport._perTexturePeakTextures, outlineReport._packedPeakTextures,
+			});
+	}
+
 	return true;
 }
 
-ff::PointFloat SpriteFont::InternalDrawText(ff::IRendererActive* render, ff::ISpriteList* sprites, ff::StringRef text, const ff::Transform& transform, ff::SpriteFontOptions options)
+void ff::EnableSpriteFontBuildTimes(bool enable)
 {
-	noAssertRetVal(text.size() && transform._scale.x != 0 && transform._scale.y != 0, ff::PointFloat::Zeros());
+	if (enable)
+	{
+		ff::LockMutex lock(::GetStaticMutex());
 
-	ff::IFontData* data = _data.Flush();
-	assertRetVal(data, ff::PointFloat::Zeros());
+		if (!s_initBuildTimesStatics)
+		{
+			s_initBuildTimesStatics = true;
 
-	IDWriteFontFaceX* fontFace = data->GetFontFace();
+			ff::AtProgramShutdown([]()
+				{
+					ff::LockMutex lock(::GetStaticMutex());
+					s_buildTimes.ClearAndReduce();
+					s_initBuildTimesStatics = false;
+				});
+		}
+	}
+
+	s_recordBuildTimes = enable;
+}
+
+ff::Vector<ff::SpriteFontBuildTime> ff::TakeSpriteFontBuildTimes()
+{
+	ff::LockMutex lock(::GetStaticMutex());
+	ff::Vector<ff::SpriteFontBuildTime> buildTimes = std::move(s_buildTimes);
+	s_buildTimes.Clear();
+	return buildTimes;
+}
+
+bool SpriteFont::KerningPair::operator<(const KerningPair& rhs) const
+{
+	return _glyphs < rhs._glyphs;
+}
+
+bool SpriteFont::TextLayoutKey::operator==(const TextLayoutKey& rhs) const
+{
+	return _textHash == rhs._textHash && _sprites == rhs._sprites && _scale == rhs._scale && _options == rhs._options;
+}
+
+bool SpriteFont::InitKerning(IDWriteFontFaceX* fontFace)
+{
+	_kerning.Clear();
+	_hasKerningTable = true;
+	noAssertRetVal(fontFace->HasKerningPairs(), true);
+
+	ff::Vector<UINT16> glyphs;
+	for (size_t ch = 0; ch < ::KERNING_CHAR_COUNT; ch++)
+	{
+		UINT16 glyph = _charToGlyph.GetGlyph((wchar_t)ch);
+		if (glyph && !glyphs.Contains(glyph))
+		{
+			glyphs.Push(glyph);
+		}
+	}
+
+	// Each query gets adjustments for one first glyph against every second glyph: [first, g0, first, g1, ...]
+	ff::Vector<UINT16> pairGlyphs;
+	ff::Vector<INT32> pairKerns;
+	pairGlyphs.Resize(glyphs.Size() * 2);
+	pairKerns.Resize(glyphs.Size() * 2);
+
+	for (UINT16 first : glyphs)
+	{
+		for (size_t i = 0; i < glyphs.Size(); i++)
+		{
+			pairGlyphs[i * 2] = first;
+			pairGlyphs[i * 2 + 1] = glyphs[i];
+		}
+
+		assertHrRetVal(fontFace->GetKerningPairAdjustments((UINT32)pairGlyphs.Size(), pairGlyphs.ConstData(), pairKerns.Data()), false);
+
+		for (size_t i = 0; i < glyphs.Size(); i++)
+		{
+			if (pairKerns[i * 2])
+			{
+				_kerning.Push(KerningPair{ ((UINT32)first << 16) | glyphs[i], pairKerns[i * 2] });
+			}
+		}
+	}
+
+	std::sort(_kerning.begin(), _kerning.end());
+
+	return true;
+}
+
+int SpriteFont::GetKerning(IDWriteFontFaceX* fontFace, wchar_t first, wchar_t second) const
+{
+	UINT16 twoGlyphs[2] = { _charToGlyph.GetGlyph(first), _charToGlyph.GetGlyph(second) };
+
+	if (_hasKerningTable && (size_t)first < ::KERNING_CHAR_COUNT && (size_t)second < ::KERNING_CHAR_COUNT)
+	{
+		KerningPair key{ ((UINT32)twoGlyphs[0] << 16) | twoGlyphs[1], 0 };
+		auto iter = std::lower_bound(_kerning.begin(), _kerning.end(), key);
+		return (iter != _kerning.end() && iter->_glyphs == key._glyphs) ? iter->_designKern : 0;
+	}
+
+	int twoDesignKerns[2];
+	return SUCCEEDED(fontFace->GetKerningPairAdjustments(2, twoGlyphs, twoDesignKerns)) ? twoDesignKerns[0] : 0;
+}
+
+bool SpriteFont::LayoutText(IDWriteFontFaceX* fontFace, ff::ISpriteList* sprites, ff::StringRef text, ff::PointFloat scale, ff::SpriteFontOptions options, TextLayout& layout) const
+{
+	assertRetVal(fontFace, false);
 	bool hasKerning = fontFace->HasKerningPairs();
 
 	DWRITE_FONT_METRICS1 fm;
 	fontFace->GetMetrics(&fm);
 
 	float designUnitSize = _size / fm.designUnitsPerEm;
-	ff::PointFloat scaledDesignUnitSize = transform._scale * designUnitSize;
-	ff::Transform basePos = transform;
-	basePos._position.y += fm.ascent * scaledDesignUnitSize.y;
-	ff::PointFloat maxPos(transform._position.x, transform._position.y + (fm.ascent + fm.descent) * scaledDesignUnitSize.y);
+	ff::PointFloat scaledDesignUnitSize = scale * designUnitSize;
+	ff::PointFloat pos(0, fm.ascent * scaledDesignUnitSize.y);
+	ff::PointFloat maxPos(0, (fm.ascent + fm.descent) * scaledDesignUnitSize.y);
 	float lineSpacing = (fm.ascent + fm.descent + fm.lineGap) * scaledDesignUnitSize.y;
+	size_t spriteCount = sprites ? sprites->GetCount() : 0;
 
-	if (render)
-	{
-		render->PushNoOverlap();
-	}
+	DirectX::XMFLOAT4 customColor = ff::GetColorWhite();
+	bool hasCustomColor = false;
+
+	layout._glyphs.Clear();
+	layout._glyphs.Reserve(text.size());
 
 	for (const wchar_t* ch = text.c_str(), *chEnd = ch + text.size(); ch != chEnd; )
 	{
 		if (*ch == '\r' || *ch == '\n')
 		{
 			ch += (*ch == '\r' && ch + 1 != chEnd && ch[1] == '\n') ? 2 : 1;
-			basePos._position.SetPoint(transform._position.x, basePos._position.y + lineSpacing);
+			pos.SetPoint(0, pos.y + lineSpacing);
 			maxPos.y += lineSpacing;
 			continue;
 		}
@@ -418,7 +720,8 @@ ff::PointFloat SpriteFont::InternalDrawText(ff::IRendererActive* render, ff::ISp
 					if ((control == ff::SpriteFontControl::SetOutlineColor && sprites == _outlineSprites) ||
 						(control == ff::SpriteFontControl::SetTextColor && sprites == _sprites))
 					{
-						basePos._color = color;
+						customColor = color;
+						hasCustomColor = true;
 					}
 				}
 				break;
@@ -432,7 +735,8 @@ ff::PointFloat SpriteFont::InternalDrawText(ff::IRendererActive* render, ff::ISp
 					if ((control == ff::SpriteFontControl::SetOutlinePaletteColor && sprites == _outlineSprites) ||
 						(control == ff::SpriteFontControl::SetTextPaletteColor && sprites == _sprites))
 					{
-						basePos._color = color;
+						customColor = color;
+						hasCustomColor = true;
 					}
 				}
 				break;
@@ -440,36 +744,148 @@ ff::PointFloat SpriteFont::InternalDrawText(ff::IRendererActive* render, ff::ISp
 		}
 		else
 		{
-			const CharAndGlyphInfo& glyph = _glyphs[_glyphs[*ch]._charToGlyph];
-
-			if (render && sprites && glyph._glyphToSprite && glyph._glyphToSprite < sprites->GetCount())
+			UINT16 glyphId = _charToGlyph.GetGlyph(*ch);
+			if (glyphId < _glyphs.Size())
 			{
-				render->DrawSprite(sprites->Get(glyph._glyphToSprite), basePos);
-			}
+				const GlyphInfo& glyph = _glyphs[glyphId];
+
+				if (glyph._sprite && glyph._sprite < spriteCount)
+				{
+					layout._glyphs.Push(TextLayoutGlyph{ pos, customColor, glyph._sprite, hasCustomColor });
+				}
 
-			basePos._position.x += glyph._glyphWidth * basePos._scale.x;
-			maxPos.x = std::max(maxPos.x, basePos._position.x);
+				pos.x += glyph._width * scale.x;
+				maxPos.x = std::max(maxPos.x, pos.x);
+			}
 
 			if (hasKerning && ch + 1 != chEnd)
 			{
-				UINT16 twoGlyphs[2] = { ch[0], ch[1] };
-				int twoDesignKerns[2];
-				if (SUCCEEDED(fontFace->GetKerningPairAdjustments(2, twoGlyphs, twoDesignKerns)))
-				{
-					basePos._position.x += twoDesignKerns[0] * scaledDesignUnitSize.x;
-				}
+				pos.x += GetKerning(fontFace, ch[0], ch[1]) * scaledDesignUnitSize.x;
 			}
 
 			ch++;
 		}
 	}
 
-	if (render)
+	layout._size = maxPos;
+	return true;
+}
+
+const SpriteFont::TextLayout* SpriteFont::GetTextLayout(IDWriteFontFaceX* fontFace, ff::ISpriteList* sprites, ff::StringRef text, ff::PointFloat scale, ff::SpriteFontOptions options)
+{
+	TextLayoutKey key;
+	ff::ZeroObject(key);
+	key._textHash = ff::HashFunc(text);
+	key._sprites = sprites;
+	key._scale = scale;
+	key._options = options;
+
+	ff::hash_t hash = ff::HashFunc(key);
+	auto iter = _layoutMap.GetKey(hash);
+	if (iter)
+	{
+		TextLayout* layout = iter->GetValue();
+		if (layout->_key == key && layout->_text == text)
+		{
+			_layouts.MoveToFront(*layout);
+			return layout;
+		}
+
+		// Hash collision, replace the old layout
+		_layoutMap.DeleteKey(*iter);
+		_layouts.Delete(*layout);
+	}
+
+	if (_layouts.Size() >= ::MAX_CACHED_LAYOUTS)
+	{
+		_layoutMap.UnsetKey(_layouts.GetLast()->_hash);
+		_layouts.DeleteLast();
+	}
+
+	TextLayout& layout = _layouts.InsertFirst();
+	layout._key = key;
+	layout._hash = hash;
+	layout._text = text;
+
+	if (!LayoutText(fontFace, sprites, text, scale, options, layout))
+	{
+		_layouts.DeleteFirst();
+		assertRetVal(false, nullptr);
+	}
+
+	_layoutMap.SetKey(hash, &layout);
+	return &layout;
+}
+
+void SpriteFont::DrawTextLayout(ff::IRendererActive* render, ff::ISpriteList* sprites, const TextLayout& layout, const ff::Transform& transform) const
+{
+	noAssertRet(render && sprites && layout._glyphs.Size());
+
+	ff::Vector<ff::ISprite*, 256> drawSprites;
+	ff::Vector<ff::Transform, 256> drawTransforms;
+	drawSprites.Reserve(layout._glyphs.Size());
+	drawTransforms.Reserve(layout._glyphs.Size());
+
+	for (const TextLayoutGlyph& glyph : layout._glyphs)
+	{
+		drawSprites.Push(sprites->Get(glyph._sprite));
+		drawTransforms.Push(ff::Transform::Create(transform._position + glyph._offset, transform._scale, transform._rotation, glyph._customColor ? glyph._color : transform._color));
+	}
+
+	render->PushNoOverlap();
+	render->DrawSprites(drawSprites.Data(), drawTransforms.ConstData(), drawSprites.Size());
+	render->PopNoOverlap();
+}
+
+bool SpriteFont::LoadLegacyGlyphs(ff::IData* data)
+{
+	assertRetVal(data->GetSize() == ::LEGACY_GLYPH_COUNT * sizeof(LegacyGlyphInfo), false);
+	const LegacyGlyphInfo* legacyGlyphs = (const LegacyGlyphInfo*)data->GetMem();
+
+	size_t glyphCount = 0;
+	_charToGlyph.Clear();
+
+	for (size_t i = 0; i < ::LEGACY_GLYPH_COUNT; i++)
+	{
+		_charToGlyph.SetGlyph((wchar_t)i, legacyGlyphs[i]._charToGlyph);
+
+		if (legacyGlyphs[i]._glyphToSprite || legacyGlyphs[i]._glyphWidth != 0)
+		{
+			glyphCount = i + 1;
+		}
+	}
+
+	_glyphs.Resize(glyphCount);
+
+	for (size_t i = 0; i < _glyphs.Size(); i++)
+	{
+		_glyphs[i] = GlyphInfo{ legacyGlyphs[i]._glyphToSprite, legacyGlyphs[i]._glyphWidth };
+	}
+
+	return true;
+}
+
+ff::PointFloat SpriteFont::InternalDrawText(ff::IRendererActive* render, ff::ISpriteList* sprites, ff::StringRef text, const ff::Transform& transform, ff::SpriteFontOptions options)
+{
+	noAssertRetVal(text.size() && transform._scale.x != 0 && transform._scale.y != 0, ff::PointFloat::Zeros());
+
+	ff::IFontData* data = _data.Flush();
+	assertRetVal(data, ff::PointFloat::Zeros());
+	IDWriteFontFaceX* fontFace = data->GetFontFace();
+
+	if (ff::HasAllFlags(options, ff::SpriteFontOptions::NoCache))
 	{
-		render->PopNoOverlap();
+		TextLayout layout;
+		assertRetVal(LayoutText(fontFace, sprites, text, transform._scale, options, layout), ff::PointFloat::Zeros());
+		DrawTextLayout(render, sprites, layout, transform);
+		return layout._size;
 	}
 
-	return maxPos - transform._position;
+	ff::LockMutex lock(_layoutMutex);
+	const TextLayout* layout = GetTextLayout(fontFace, sprites, text, transform._scale, options);
+	assertRetVal(layout, ff::PointFloat::Zeros());
+	DrawTextLayout(render, sprites, *layout, transform);
+	return layout->_size;
 }
 
 static bool TextContainsOutlineControl(ff::StringRef text)
@@ -505,7 +921,7 @@ ff::PointFloat SpriteFont::DrawText(ff::IRendererActive* render, ff::StringRef t
 
 ff::PointFloat SpriteFont::MeasureText(ff::StringRef text, ff::PointFloat scale)
 {
-	return InternalDrawText(nullptr, nullptr, text, ff::Transform::Identity(), ff::SpriteFontOptions::NoControl);
+	return InternalDrawText(nullptr, nullptr, text, ff::Transform::Create(ff::PointFloat::Zeros(), scale), ff::SpriteFontOptions::NoControl);
 }
 
 float SpriteFont::GetLineSpacing()
@@ -556,8 +972,32 @@ bool SpriteFont::LoadFromCache(const ff::Dict& dict)
 	_antiAlias = dict.Get<ff::BoolValue>(PROP_AA);
 
 	ff::ComPtr<ff::IData> glyphsData = dict.Get<ff::DataValue>(PROP_GLYPHS);
-	assertRetVal(glyphsData && glyphsData->GetSize() == sizeof(_glyphs), false);
-	std::memcpy(_glyphs.data(), glyphsData->GetMem(), glyphsData->GetSize());
+	ff::ComPtr<ff::IData> charGlyphsData = dict.Get<ff::DataValue>(PROP_CHAR_GLYPHS);
+	assertRetVal(glyphsData, false);
+
+	if (charGlyphsData)
+	{
+		ff::ComPtr<ff::IDataReader> reader;
+		assertRetVal(ff::CreateDataReader(charGlyphsData, 0, &reader), false);
+		assertRetVal(_charToGlyph.Load(reader), false);
+
+		assertRetVal(glyphsData->GetSize() % sizeof(GlyphInfo) == 0, false);
+		_glyphs.Resize(glyphsData->GetSize() / sizeof(GlyphInfo));
+		std::memcpy(_glyphs.Data(), glyphsData->GetMem(), glyphsData->GetSize());
+	}
+	else
+	{
+		assertRetVal(LoadLegacyGlyphs(glyphsData), false);
+	}
+
+	// Older caches don't have a kerning table, so kerning will be queried from the font
+	ff::ComPtr<ff::IData> kerningData = dict.Get<ff::DataValue>(PROP_KERNING);
+	_hasKerningTable = kerningData && kerningData->GetSize() % sizeof(KerningPair) == 0;
+	if (_hasKerningTable)
+	{
+		_kerning.Resize(kerningData->GetSize() / sizeof(KerningPair));
+		std::memcpy(_kerning.Data(), kerningData->GetMem(), kerningData->GetSize());
+	}
 
 	ff::ValuePtr spritesValue = dict.GetValue(PROP_SPRITES);
 	assertRetVal(spritesValue && spritesValue->IsType<ff::ObjectValue>(), false);
@@ -581,7 +1021,21 @@ bool SpriteFont::SaveToCache(ff::Dict& dict)
 	dict.Set<ff::FloatValue>(PROP_SIZE, _size);
 	dict.Set<ff::IntValue>(PROP_OUTLINE, _outlineThickness);
 	dict.Set<ff::BoolValue>(PROP_AA, _antiAlias);
-	dict.Set<ff::DataValue>(PROP_GLYPHS, _glyphs.data(), sizeof(_glyphs));
+	dict.Set<ff::DataValue>(PROP_GLYPHS, _glyphs.ConstData(), _glyphs.ByteSize());
+
+	ff::ComPtr<ff::IDataVector> charGlyphsData;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&charGlyphsData, &writer), false);
+		assertRetVal(_charToGlyph.Save(writer), false);
+	}
+
+	dict.Set<ff::DataValue>(PROP_CHAR_GLYPHS, charGlyphsData);
+
+	if (_hasKerningTable)
+	{
+		dict.Set<ff::DataValue>(PROP_KERNING, _kerning.ConstData(), _kerning.ByteSize());
+	}
 
 	ff::Dict spritesDict;
 	assertRetVal(ff::SaveResourceToCache(_sprites, spritesDict), false);
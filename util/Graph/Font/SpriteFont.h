@@ -24,8 +24,29 @@ namespace ff
 		NoOutline = 0x01, // Only draw text
 		NoText = 0x02, // Only draw outline
 		NoControl = 0x04, // ignore any SpriteFontControl chars
+		NoCache = 0x08, // don't use or update the cached text layouts
 	};
 
+	struct SpriteFontBuildTime
+	{
+		String _name; // family and size
+		size_t _glyphs;
+		double _rasterizeSeconds;
+		double _optimizeSeconds;
+		double _outlineSeconds;
+		double _totalSeconds;
+
+		// Outlines built the old way (a texture per glyph, then packed) and the new way (drawn into packed textures)
+		double _outlinePerTextureSeconds;
+		double _outlinePackedSeconds;
+		size_t _outlinePerTexturePeakTextures;
+		size_t _outlinePackedPeakTextures;
+	};
+
+	// Lets tools like respack report how long each font took to build
+	UTIL_API void EnableSpriteFontBuildTimes(bool enable);
+	UTIL_API Vector<SpriteFontBuildTime> TakeSpriteFontBuildTimes();
+
 	class __declspec(uuid("b4356d2d-1b85-400c-b3d6-cbff44352305")) __declspec(novtable)
 		ISpriteFont : public IUnknown, public IGraphDeviceChild
 	{
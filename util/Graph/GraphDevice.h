@@ -27,6 +27,7 @@ namespace ff
 	class IRenderTargetSwapChain;
 	class IRenderTargetWindow;
 	class ITexture;
+	class TextureResidency;
 	enum class GraphBufferType;
 
 	class __declspec(uuid("1b26d121-cda5-4705-ae3d-4815b4a4115b")) __declspec(novtable)
@@ -55,6 +56,7 @@ namespace ff
 
 		virtual void AddChild(IGraphDeviceChild* child, int resetPriority = 0) = 0;
 		virtual void RemoveChild(IGraphDeviceChild* child) = 0;
+		virtual TextureResidency& GetTextureResidency() = 0;
 	};
 
 	class IGraphDeviceDxgi
@@ -6,6 +6,7 @@
 #include "Graph/GraphDeviceChild.h"
 #include "Graph/GraphFactory.h"
 #include "Graph/Texture/Texture.h"
+#include "Graph/Texture/TextureResidency.h"
 #include "Graph/Render/Renderer.h"
 #include "Graph/RenderTarget/RenderDepth.h"
 #include "Graph/RenderTarget/RenderTargetSwapChain.h"
@@ -49,6 +50,7 @@ public:
 #endif
 	virtual void AddChild(ff::IGraphDeviceChild* child, int resetPriority) override;
 	virtual void RemoveChild(ff::IGraphDeviceChild* child) override;
+	virtual ff::TextureResidency& GetTextureResidency() override;
 
 	// IGraphDeviceDxgi
 	virtual IDXGIDeviceX* GetDxgi() override;
@@ -77,6 +79,7 @@ private:
 	ff::Vector<std::pair<ff::IGraphDeviceChild*, int>> _children;
 	ff::GraphContext11 _stateContext;
 	ff::GraphStateCache11 _stateCache;
+	ff::TextureResidency _textureResidency;
 	ff::hash_t _dxgiAdaptersHash;
 	ff::hash_t _dxgiAdapterOutputsHash;
 };
@@ -357,6 +360,11 @@ void GraphDevice11::RemoveChild(ff::IGraphDeviceChild* child)
 	}
 }
 
+ff::TextureResidency& GraphDevice11::GetTextureResidency()
+{
+	return _textureResidency;
+}
+
 bool GraphDevice11::Reset(bool force)
 {
 	if (!force)
@@ -42,6 +42,12 @@ void ff::PixelRendererActive::DrawSprite(ff::ISprite* sprite, const PixelTransfo
 	_render->DrawSprite(sprite, pos2);
 }
 
+void ff::PixelRendererActive::DrawSprites(ff::ISprite** sprites, const PixelTransform* pos, size_t count) const
+{
+	// The renderer floors the positions while filling in sprite geometry
+	_render->DrawSprites(sprites, pos, count);
+}
+
 void ff::PixelRendererActive::DrawLineStrip(const ff::PointFixedInt* points, size_t count, const DirectX::XMFLOAT4& color, ff::FixedInt thickness) const
 {
 	ff::Vector<ff::PointFloat, 64> pointFloats;
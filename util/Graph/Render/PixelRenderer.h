@@ -22,6 +22,7 @@ namespace ff
 		UTIL_API IRendererActive11* GetRenderer11() const;
 
 		UTIL_API void DrawSprite(ISprite* sprite, const PixelTransform& pos) const;
+		UTIL_API void DrawSprites(ISprite** sprites, const PixelTransform* pos, size_t count) const;
 
 		UTIL_API void DrawLineStrip(const PointFixedInt* points, size_t count, const DirectX::XMFLOAT4& color, FixedInt thickness) const;
 		UTIL_API void DrawLine(PointFixedInt start, PointFixedInt end, const DirectX::XMFLOAT4& color, FixedInt thickness) const;
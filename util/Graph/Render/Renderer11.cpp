@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Data/Data.h"
+#include "Globals/Profiler.h"
 #include "Module/Module.h"
 #include "Graph/Anim/Transform.h"
 #include "Graph/GraphDevice.h"
@@ -28,6 +29,7 @@ static const size_t MAX_PALETTES = 128; // 256 color palettes only
 static const size_t MAX_PALETTE_REMAPS = 128; // 256 entries only
 static const size_t MAX_TRANSFORM_MATRIXES = 1024;
 static const size_t MAX_RENDER_COUNT = 524288; // 0x00080000
+static const size_t MAX_SPRITE_BATCH = 256;
 static const float MAX_RENDER_DEPTH = 1.0f;
 static const float RENDER_DEPTH_DELTA = MAX_RENDER_DEPTH / MAX_RENDER_COUNT;
 
@@ -183,6 +185,25 @@ public:
 		return result;
 	}
 
+	// Makes room for a batch of items with a single overflow check, returns the first new item
+	void* AddRange(size_t count)
+	{
+		size_t byteSize = count * _itemSize;
+
+		if (_dataCur + byteSize > _dataEnd)
+		{
+			size_t curSize = _dataCur - _dataStart;
+			size_t newSize = std::max<size_t>(std::max<size_t>((_dataEnd - _dataStart) * 2, _itemSize * 64), curSize + byteSize);
+			_dataStart = (BYTE*)_aligned_realloc(_dataStart, newSize, _itemAlign);
+			_dataCur = _dataStart + curSize;
+			_dataEnd = _dataStart + newSize;
+		}
+
+		void* result = _dataCur;
+		_dataCur += byteSize;
+		return result;
+	}
+
 	size_t GetItemByteSize() const
 	{
 		return _itemSize;
@@ -279,6 +300,19 @@ private:
 	BYTE* _dataEnd;
 };
 
+template<typename TransformType>
+struct SpriteBatch
+{
+	size_t _count;
+	unsigned int _matrixIndex;
+	std::array<const ff::SpriteData*, ::MAX_SPRITE_BATCH> _datas;
+	std::array<const TransformType*, ::MAX_SPRITE_BATCH> _transforms;
+	std::array<GeometryBucketType, ::MAX_SPRITE_BATCH> _bucketTypes;
+	std::array<unsigned int, ::MAX_SPRITE_BATCH> _textureIndexes;
+	std::array<float, ::MAX_SPRITE_BATCH> _depths;
+	std::array<ff::SpriteGeometryInput*, ::MAX_SPRITE_BATCH> _outputs;
+};
+
 struct AlphaGeometryEntry
 {
 	const GeometryBucket* _bucket;
@@ -336,6 +370,8 @@ public:
 	virtual ff::IRendererActive11* AsRendererActive11() override;
 
 	virtual void DrawSprite(ff::ISprite* sprite, const ff::Transform& transform) override;
+	virtual void DrawSprites(ff::ISprite** sprites, const ff::Transform* transforms, size_t count) override;
+	virtual void DrawSprites(ff::ISprite** sprites, const ff::PixelTransform* transforms, size_t count) override;
 
 	virtual void DrawLineStrip(const ff::PointFloat* points, const DirectX::XMFLOAT4* colors, size_t count, float thickness, bool pixelThickness) override;
 	virtual void DrawLineStrip(const ff::PointFloat* points, size_t count, const DirectX::XMFLOAT4& color, float thickness, bool pixelThickness) override;
@@ -408,6 +444,8 @@ private:
 	};
 
 	void DrawLineStrip(const ff::PointFloat* points, size_t pointCount, const DirectX::XMFLOAT4* colors, size_t colorCount, float thickness, bool pixelThickness);
+	template<typename TransformType> void InternalDrawSprites(ff::ISprite** sprites, const TransformType* transforms, size_t count);
+	template<typename TransformType> void AddSpriteBatch(SpriteBatch<TransformType>& batch);
 
 	void InitGeometryConstantBuffers0(ff::IRenderTarget* target, const ff::RectFloat& viewRect, const ff::RectFloat& worldRect);
 	void UpdateGeometryConstantBuffers0();
@@ -1219,6 +1257,8 @@ void Renderer11::SetShaderInput()
 
 void Renderer11::Flush()
 {
+	PROFILE_ZONE(L"Renderer flush");
+
 	if (_lastDepthType != LastDepthType::None && CreateGeometryBuffer())
 	{
 		UpdateGeometryConstantBuffers0();
@@ -1763,6 +1803,134 @@ void Renderer11::DrawSprite(ff::ISprite* sprite, const ff::Transform& transform)
 	input.rect = *(DirectX::XMFLOAT4*)&data._worldRect;
 }
 
+void Renderer11::DrawSprites(ff::ISprite** sprites, const ff::Transform* transforms, size_t count)
+{
+	InternalDrawSprites(sprites, transforms, count);
+}
+
+void Renderer11::DrawSprites(ff::ISprite** sprites, const ff::PixelTransform* transforms, size_t count)
+{
+	InternalDrawSprites(sprites, transforms, count);
+}
+
+template<typename TransformType>
+void Renderer11::InternalDrawSprites(ff::ISprite** sprites, const TransformType* transforms, size_t count)
+{
+	noAssertRet(count);
+
+	SpriteBatch<TransformType> batch;
+	batch._count = 0;
+	batch._matrixIndex = GetWorldMatrixIndex();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const ff::SpriteData& data = sprites[i]->GetSpriteData();
+		if (!data._textureView)
+		{
+			// an async sprite resource isn't done loading yet
+			continue;
+		}
+
+		AlphaType alphaType = ::GetAlphaType(data, transforms[i]._color, _forceOpaque);
+		if (alphaType == AlphaType::Invisible)
+		{
+			continue;
+		}
+
+		bool usePalette = ff::HasAllFlags(data._type, ff::SpriteType::Palette);
+		unsigned int textureIndex = GetTextureIndexNoFlush(data._textureView, usePalette);
+		if (textureIndex == ff::INVALID_DWORD)
+		{
+			// Out of texture slots, so render everything so far and start over
+			AddSpriteBatch(batch);
+			Flush();
+
+			batch._matrixIndex = GetWorldMatrixIndex();
+			textureIndex = GetTextureIndexNoFlush(data._textureView, usePalette);
+			assert(textureIndex != ff::INVALID_DWORD);
+		}
+
+		size_t index = batch._count++;
+		batch._datas[index] = &data;
+		batch._transforms[index] = &transforms[i];
+		batch._textureIndexes[index] = textureIndex;
+		batch._bucketTypes[index] = (alphaType == AlphaType::Transparent && !_targetRequiresPalette)
+			? (usePalette ? GeometryBucketType::PaletteSprites : GeometryBucketType::SpritesAlpha)
+			: (usePalette ? GeometryBucketType::PaletteSprites : GeometryBucketType::Sprites);
+
+		if (batch._count == ::MAX_SPRITE_BATCH)
+		{
+			AddSpriteBatch(batch);
+		}
+	}
+
+	AddSpriteBatch(batch);
+}
+
+template<typename TransformType>
+void Renderer11::AddSpriteBatch(SpriteBatch<TransformType>& batch)
+{
+	noAssertRet(batch._count);
+
+	// Reserve space in each bucket up front so that buckets don't grow while filling in geometry
+	std::array<size_t, (size_t)GeometryBucketType::Count> bucketCounts{};
+	std::array<size_t, (size_t)GeometryBucketType::Count> bucketIndexes{};
+	std::array<ff::SpriteGeometryInput*, (size_t)GeometryBucketType::Count> bucketData{};
+
+	for (size_t i = 0; i < batch._count; i++)
+	{
+		bucketCounts[(size_t)batch._bucketTypes[i]]++;
+	}
+
+	for (size_t i = 0; i < bucketCounts.size(); i++)
+	{
+		if (bucketCounts[i])
+		{
+			GeometryBucket& bucket = _geometryBuckets[i];
+			bucketIndexes[i] = bucket.GetCount();
+			bucketData[i] = (ff::SpriteGeometryInput*)bucket.AddRange(bucketCounts[i]);
+		}
+	}
+
+	LastDepthType depthType = _forceNoOverlap ? LastDepthType::SpriteNoOverlap : LastDepthType::Sprite;
+
+	for (size_t i = 0; i < batch._count; i++)
+	{
+		size_t bucketIndex = (size_t)batch._bucketTypes[i];
+		float depth = NudgeDepth(depthType);
+
+		batch._depths[i] = depth;
+		batch._outputs[i] = bucketData[bucketIndex]++;
+
+		if (batch._bucketTypes[i] >= GeometryBucketType::FirstAlpha)
+		{
+			assert(!_forceOpaque);
+
+			_alphaGeometry.Push(AlphaGeometryEntry
+				{
+					&_geometryBuckets[bucketIndex],
+					bucketIndexes[bucketIndex],
+					depth
+				});
+		}
+
+		bucketIndexes[bucketIndex]++;
+	}
+
+	ff::SpriteGeometryBatch geometryBatch
+	{
+		batch._outputs.data(),
+		batch._datas.data(),
+		batch._depths.data(),
+		batch._textureIndexes.data(),
+		batch._matrixIndex,
+		batch._count,
+	};
+
+	ff::FillSpriteGeometry(geometryBatch, batch._transforms.data());
+	batch._count = 0;
+}
+
 void Renderer11::DrawLineStrip(
 	const ff::PointFloat* points,
 	size_t pointCount,
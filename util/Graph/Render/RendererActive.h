@@ -7,6 +7,7 @@ namespace ff
 	class IPalette;
 	class ISprite;
 	class MatrixStack;
+	struct PixelTransform;
 	struct Transform;
 
 	typedef std::function<bool(GraphContext11& context, const std::type_info& vertexType, bool opaqueOnly)> CustomRenderContextFunc11;
@@ -19,6 +20,8 @@ namespace ff
 		virtual IRendererActive11* AsRendererActive11() = 0;
 
 		virtual void DrawSprite(ISprite* sprite, const Transform& transform) = 0;
+		virtual void DrawSprites(ISprite** sprites, const Transform* transforms, size_t count) = 0;
+		virtual void DrawSprites(ISprite** sprites, const PixelTransform* transforms, size_t count) = 0;
 
 		virtual void DrawLineStrip(const PointFloat* points, const DirectX::XMFLOAT4* colors, size_t count, float thickness, bool pixelThickness = false) = 0;
 		virtual void DrawLineStrip(const PointFloat* points, size_t count, const DirectX::XMFLOAT4& color, float thickness, bool pixelThickness = false) = 0;
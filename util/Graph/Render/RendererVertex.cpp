@@ -1,5 +1,19 @@
 #include "pch.h"
+#include "Graph/Anim/Transform.h"
 #include "Graph/Render/RendererVertex.h"
+#include "Graph/Sprite/Sprite.h"
+
+// The vector path writes each sprite record as five 16 byte chunks:
+// rect, uvrect, color, (scale, pos.xy), (pos.z, rotate, textureIndex, matrixIndex)
+static_assert(sizeof(ff::SpriteGeometryInput) == 80, "SpriteGeometryInput layout changed");
+static_assert(offsetof(ff::SpriteGeometryInput, scale) == 48 && offsetof(ff::SpriteGeometryInput, pos) == 56, "SpriteGeometryInput layout changed");
+static_assert(offsetof(ff::Transform, _scale) == offsetof(ff::Transform, _position) + 8, "Transform layout changed");
+static_assert(offsetof(ff::PixelTransform, _scale) == offsetof(ff::PixelTransform, _position) + 8, "PixelTransform layout changed");
+static_assert(sizeof(ff::FixedInt) == sizeof(int), "FixedInt layout changed");
+
+// Matches the 8 fraction bits of FixedInt, used to floor pixel positions to whole numbers
+static const int FIXED_INT_FRACTION_BITS = 8;
+static const float FIXED_INT_TO_FLOAT = 1.0f / (1 << ::FIXED_INT_FRACTION_BITS);
 
 const std::array<D3D11_INPUT_ELEMENT_DESC, 10>& ff::LineGeometryInput::GetLayout11()
 {
@@ -68,3 +82,117 @@ const std::array<D3D11_INPUT_ELEMENT_DESC, 8>& ff::SpriteGeometryInput::GetLayou
 
 	return layout;
 }
+
+static void FillSpriteGeometryScalar(ff::SpriteGeometryInput& input, const ff::SpriteData& data, const ff::Transform& transform, float depth, unsigned int textureIndex, unsigned int matrixIndex)
+{
+	input.rect = *(DirectX::XMFLOAT4*)&data._worldRect;
+	input.uvrect = *(DirectX::XMFLOAT4*)&data._textureUV;
+	input.color = transform._color;
+	input.scale = *(DirectX::XMFLOAT2*)&transform._scale;
+	input.pos.x = transform._position.x;
+	input.pos.y = transform._position.y;
+	input.pos.z = depth;
+	input.rotate = transform.GetRotationRadians();
+	input.textureIndex = textureIndex;
+	input.matrixIndex = matrixIndex;
+}
+
+static void FillSpriteGeometryScalar(ff::SpriteGeometryInput& input, const ff::SpriteData& data, const ff::PixelTransform& transform, float depth, unsigned int textureIndex, unsigned int matrixIndex)
+{
+	input.rect = *(DirectX::XMFLOAT4*)&data._worldRect;
+	input.uvrect = *(DirectX::XMFLOAT4*)&data._textureUV;
+	input.color = transform._color;
+	input.scale.x = (float)transform._scale.x;
+	input.scale.y = (float)transform._scale.y;
+	input.pos.x = (float)(int)transform._position.x;
+	input.pos.y = (float)(int)transform._position.y;
+	input.pos.z = depth;
+	input.rotate = transform.GetRotationRadians();
+	input.textureIndex = textureIndex;
+	input.matrixIndex = matrixIndex;
+}
+
+#if defined(_XM_SSE_INTRINSICS_)
+
+static inline __m128 GetSpriteGeometryTail(float depth, float rotate, unsigned int textureIndex, unsigned int matrixIndex)
+{
+	__m128i indexes = _mm_setr_epi32(0, 0, (int)textureIndex, (int)matrixIndex);
+	__m128 depthRotate = _mm_setr_ps(depth, rotate, 0, 0);
+	return _mm_or_ps(depthRotate, _mm_castsi128_ps(indexes));
+}
+
+static inline void StoreSpriteGeometry(ff::SpriteGeometryInput& input, const ff::SpriteData& data, const DirectX::XMFLOAT4& color, __m128 scalePos, __m128 tail)
+{
+	float* dest = &input.rect.x;
+	_mm_storeu_ps(dest + 0, _mm_loadu_ps(&data._worldRect.left));
+	_mm_storeu_ps(dest + 4, _mm_loadu_ps(&data._textureUV.left));
+	_mm_storeu_ps(dest + 8, _mm_loadu_ps(&color.x));
+	_mm_storeu_ps(dest + 12, scalePos);
+	_mm_storeu_ps(dest + 16, tail);
+}
+
+static void FillSpriteGeometryVector(ff::SpriteGeometryInput& input, const ff::SpriteData& data, const ff::Transform& transform, float depth, unsigned int textureIndex, unsigned int matrixIndex)
+{
+	// (pos.x, pos.y, scale.x, scale.y) -> (scale.x, scale.y, pos.x, pos.y)
+	__m128 posScale = _mm_loadu_ps(&transform._position.x);
+	__m128 scalePos = _mm_shuffle_ps(posScale, posScale, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128 tail = ::GetSpriteGeometryTail(depth, transform._rotation * ff::DEG_TO_RAD_F, textureIndex, matrixIndex);
+
+	::StoreSpriteGeometry(input, data, transform._color, scalePos, tail);
+}
+
+static void FillSpriteGeometryVector(ff::SpriteGeometryInput& input, const ff::SpriteData& data, const ff::PixelTransform& transform, float depth, unsigned int textureIndex, unsigned int matrixIndex)
+{
+	// Position is floored to whole pixels, scale keeps its fraction
+	__m128i raw = _mm_loadu_si128((const __m128i*)&transform._position.x);
+	__m128 whole = _mm_cvtepi32_ps(_mm_srai_epi32(raw, ::FIXED_INT_FRACTION_BITS));
+	__m128 exact = _mm_mul_ps(_mm_cvtepi32_ps(raw), _mm_set1_ps(::FIXED_INT_TO_FLOAT));
+	__m128 scalePos = _mm_shuffle_ps(exact, whole, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128 tail = ::GetSpriteGeometryTail(depth, transform._rotation.GetRaw() * ::FIXED_INT_TO_FLOAT * ff::DEG_TO_RAD_F, textureIndex, matrixIndex);
+
+	::StoreSpriteGeometry(input, data, transform._color, scalePos, tail);
+}
+
+#endif
+
+template<typename TransformType>
+static void FillSpriteGeometryScalar(const ff::SpriteGeometryBatch& batch, const TransformType* const* transforms)
+{
+	for (size_t i = 0; i < batch._count; i++)
+	{
+		::FillSpriteGeometryScalar(*batch._outputs[i], *batch._datas[i], *transforms[i], batch._depths[i], batch._textureIndexes[i], batch._matrixIndex);
+	}
+}
+
+template<typename TransformType>
+static void FillSpriteGeometry(const ff::SpriteGeometryBatch& batch, const TransformType* const* transforms)
+{
+#if defined(_XM_SSE_INTRINSICS_)
+	for (size_t i = 0; i < batch._count; i++)
+	{
+		::FillSpriteGeometryVector(*batch._outputs[i], *batch._datas[i], *transforms[i], batch._depths[i], batch._textureIndexes[i], batch._matrixIndex);
+	}
+#else
+	::FillSpriteGeometryScalar(batch, transforms);
+#endif
+}
+
+void ff::FillSpriteGeometry(const SpriteGeometryBatch& batch, const Transform* const* transforms)
+{
+	::FillSpriteGeometry(batch, transforms);
+}
+
+void ff::FillSpriteGeometry(const SpriteGeometryBatch& batch, const PixelTransform* const* transforms)
+{
+	::FillSpriteGeometry(batch, transforms);
+}
+
+void ff::FillSpriteGeometryScalar(const SpriteGeometryBatch& batch, const Transform* const* transforms)
+{
+	::FillSpriteGeometryScalar(batch, transforms);
+}
+
+void ff::FillSpriteGeometryScalar(const SpriteGeometryBatch& batch, const PixelTransform* const* transforms)
+{
+	::FillSpriteGeometryScalar(batch, transforms);
+}
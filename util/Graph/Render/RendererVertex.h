@@ -2,6 +2,10 @@
 
 namespace ff
 {
+	struct PixelTransform;
+	struct SpriteData;
+	struct Transform;
+
 	struct LineGeometryInput
 	{
 		DirectX::XMFLOAT2 pos[4]; // adjacency at 0 and 3
@@ -48,4 +52,21 @@ namespace ff
 
 		UTIL_API static const std::array<D3D11_INPUT_ELEMENT_DESC, 8>& GetLayout11();
 	};
+
+	// Input for filling in many sprite geometry records at once
+	struct SpriteGeometryBatch
+	{
+		SpriteGeometryInput** _outputs;
+		const SpriteData** _datas;
+		const float* _depths;
+		const unsigned int* _textureIndexes;
+		unsigned int _matrixIndex;
+		size_t _count;
+	};
+
+	// Uses SSE when available, the scalar versions are the reference implementation
+	UTIL_API void FillSpriteGeometry(const SpriteGeometryBatch& batch, const Transform* const* transforms);
+	UTIL_API void FillSpriteGeometry(const SpriteGeometryBatch& batch, const PixelTransform* const* transforms);
+	UTIL_API void FillSpriteGeometryScalar(const SpriteGeometryBatch& batch, const Transform* const* transforms);
+	UTIL_API void FillSpriteGeometryScalar(const SpriteGeometryBatch& batch, const PixelTransform* const* transforms);
 }
@@ -84,6 +84,7 @@ public:
 	virtual float GetFramesPerSecond() const override;
 	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
 	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
 	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
 	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
 
@@ -133,6 +134,7 @@ public:
 	virtual float GetFramesPerSecond() const override;
 	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
 	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
 	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
 	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
 
@@ -226,6 +228,18 @@ bool ff::CreateSpriteResource(SharedResourceValue spriteOrListRes, size_t index,
 	return CreateSpriteResource(spriteOrListRes, name, obj);
 }
 
+void ff::DrawSpriteFrames(IRendererActive* render, ISprite* sprite, const Transform* positions, size_t count)
+{
+	const size_t chunkSize = 256;
+	std::array<ISprite*, chunkSize> sprites;
+	sprites.fill(sprite);
+
+	for (size_t i = 0; i < count; i += chunkSize)
+	{
+		render->DrawSprites(sprites.data(), positions + i, std::min(count - i, chunkSize));
+	}
+}
+
 Sprite::Sprite()
 {
 }
@@ -269,6 +283,11 @@ void Sprite::RenderFrame(ff::IRendererActive* render, const ff::Transform& posit
 	render->DrawSprite(this, position);
 }
 
+void Sprite::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	ff::DrawSpriteFrames(render, this, positions, count);
+}
+
 ff::ValuePtr Sprite::GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params)
 {
 	return nullptr;
@@ -369,6 +388,11 @@ void SpriteResource::RenderFrame(ff::IRendererActive* render, const ff::Transfor
 	render->DrawSprite(this, position);
 }
 
+void SpriteResource::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	ff::DrawSpriteFrames(render, this, positions, count);
+}
+
 float SpriteResource::GetFrameLength() const
 {
 	return 0;
@@ -4,8 +4,10 @@
 
 namespace ff
 {
+	class IRendererActive;
 	class ITextureView;
 	class ISpriteList;
+	struct Transform;
 	enum class SpriteType;
 
 	struct SpriteData
@@ -43,4 +45,7 @@ namespace ff
 	UTIL_API bool CreateSpriteResource(SharedResourceValue spriteOrListRes, ISprite** obj);
 	UTIL_API bool CreateSpriteResource(SharedResourceValue spriteOrListRes, StringRef name, ISprite** obj);
 	UTIL_API bool CreateSpriteResource(SharedResourceValue spriteOrListRes, size_t index, ISprite** obj);
+
+	// Draws one sprite at many positions, for animations that render many instances at once
+	UTIL_API void DrawSpriteFrames(IRendererActive* render, ISprite* sprite, const Transform* positions, size_t count);
 }
@@ -8,16 +8,21 @@
 #include "Graph/Sprite/SpriteList.h"
 #include "Graph/Sprite/SpriteOptimizer.h"
 #include "Graph/Sprite/SpriteType.h"
+#include "Graph/DirectXUtil.h"
 #include "Graph/GraphDevice.h"
+#include "Graph/Texture/PaletteData.h"
 #include "Graph/Texture/Texture.h"
+#include "Graph/Texture/TextureCompress.h"
 #include "Graph/Texture/TextureView.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
 #include "Resource/ResourceValue.h"
 #include "String/StringUtil.h"
+#include "Thread/ThreadUtil.h"
 #include "Value/Values.h"
 #include "Windows/FileUtil.h"
 
+static ff::StaticString PROP_COMPRESSION(L"compression");
 static ff::StaticString PROP_COUNT(L"count");
 static ff::StaticString PROP_DATA(L"data");
 static ff::StaticString PROP_FILE(L"file");
@@ -32,6 +37,7 @@ static ff::StaticString PROP_SCALE(L"scale");
 static ff::StaticString PROP_SIZE(L"size");
 static ff::StaticString PROP_SPRITES(L"sprites");
 static ff::StaticString PROP_TEXTURES(L"textures");
+static ff::StaticString PROP_TRIM(L"trim");
 
 class __declspec(uuid("7ddb9bd1-c9e0-4788-b0b2-3bb252515013"))
 	SpriteList
@@ -236,9 +242,11 @@ bool SpriteList::Remove(size_t index)
 bool SpriteList::LoadFromSource(const ff::Dict& dict)
 {
 	bool optimize = dict.Get<ff::BoolValue>(PROP_OPTIMIZE, true);
+	bool trim = dict.Get<ff::BoolValue>(PROP_TRIM, false);
 	size_t mips = dict.Get<ff::SizeValue>(PROP_MIPS, 1);
 	ff::String formatProp = dict.Get<ff::StringValue>(PROP_FORMAT, ff::String(L"rgba32"));
 	ff::TextureFormat format = ff::ParseTextureFormat(formatProp);
+	ff::TextureCompression compression = ff::ParseTextureCompression(dict.Get<ff::StringValue>(PROP_COMPRESSION));
 	assertRetVal(format != ff::TextureFormat::Unknown, nullptr);
 
 	ff::ComPtr<ff::IResourceLoadListener> loadListener;
@@ -271,6 +279,57 @@ bool SpriteList::LoadFromSource(const ff::Dict& dict)
 	ff::ComPtr<ff::ISpriteList> origSprites;
 	assertRetVal(ff::CreateSpriteList(_device, &origSprites), false);
 
+	// Each PNG decodes on one thread, so all of the files are decoded at once
+
+	ff::Vector<ff::String> files;
+	for (ff::StringRef name : names)
+	{
+		ff::String fullFile = spritesDict.Get<ff::DictValue>(name).Get<ff::StringValue>(PROP_FILE);
+		if (!files.Contains(fullFile))
+		{
+			files.Push(fullFile);
+		}
+	}
+
+	DXGI_FORMAT textureFormat = ff::ConvertTextureFormat((optimize && ff::IsColorFormat(format)) ? ff::TextureFormat::RGBA32 : format);
+	size_t textureMips = optimize ? 1 : mips;
+	ff::Vector<DirectX::ScratchImage> textureScratches;
+	ff::Vector<DirectX::ScratchImage> paletteScratches;
+	textureScratches.Resize(files.Size());
+	paletteScratches.Resize(files.Size());
+
+	ff::ParallelFor(files.Size(), [&files, &textureScratches, &paletteScratches, textureFormat, textureMips, compression](size_t i)
+		{
+			textureScratches[i] = ff::LoadTextureData(files[i], textureFormat, textureMips, &paletteScratches[i], compression, false);
+		});
+
+	for (size_t i = 0; i < files.Size(); i++)
+	{
+		ff::ComPtr<ff::IPaletteData> paletteData;
+		if (paletteScratches[i].GetImageCount())
+		{
+			assertRetVal(ff::CreatePaletteData(_device, std::move(paletteScratches[i]), &paletteData), false);
+		}
+
+		ff::ComPtr<ff::ITexture> texture = textureScratches[i].GetImageCount()
+			? _device->AsGraphDeviceInternal()->CreateTexture(std::move(textureScratches[i]), paletteData)
+			: nullptr;
+
+		if (!texture)
+		{
+			if (loadListener)
+			{
+				loadListener->AddError(ff::String::format_new(L"Failed to load texture file: %s", files[i].c_str()));
+			}
+
+			assertRetVal(false, false);
+		}
+
+		ff::ComPtr<ff::ITextureView> textureView = texture->AsTextureView();
+		assertRetVal(textureView, false);
+		textureViews.SetKey(files[i], textureView);
+	}
+
 	for (ff::StringRef name : names)
 	{
 		ff::Dict spriteDict = spritesDict.Get<ff::DictValue>(name);
@@ -295,32 +354,9 @@ bool SpriteList::LoadFromSource(const ff::Dict& dict)
 		ff::PointFloat scale = spriteDict.Get<ff::PointFloatValue>(PROP_SCALE, ff::PointFloat(1, 1));
 		size_t repeat = spriteDict.Get<ff::SizeValue>(PROP_REPEAT, 1);
 
-		ff::ComPtr<ff::ITextureView> textureView;
 		auto iter = textureViews.GetKey(fullFile);
-		if (iter)
-		{
-			textureView = iter->GetValue();
-		}
-		else
-		{
-			ff::ComPtr<ff::ITexture> texture = _device->CreateTexture(fullFile,
-				(optimize && ff::IsColorFormat(format)) ? ff::TextureFormat::RGBA32 : format,
-				optimize ? 1 : mips);
-
-			if (!texture)
-			{
-				if (loadListener)
-				{
-					loadListener->AddError(ff::String::format_new(L"Failed to load texture file: %s", fullFile.c_str()));
-				}
-
-				assertRetVal(false, false);
-			}
-
-			textureView = texture->AsTextureView();
-			assertRetVal(textureView, false);
-			textureViews.SetKey(fullFile, textureView);
-		}
+		assertRetVal(iter, false);
+		ff::ComPtr<ff::ITextureView> textureView = iter->GetValue();
 
 		if (size.x == 0 && size.y == 0 && handle.x == 0 && handle.y == 0)
 		{
@@ -344,7 +380,7 @@ bool SpriteList::LoadFromSource(const ff::Dict& dict)
 	if (optimize)
 	{
 		ff::ISpriteList* finalSprites = this;
-		assertRetVal(ff::OptimizeSprites(origSprites, format, mips, &finalSprites), false);
+		assertRetVal(ff::OptimizeSprites(origSprites, format, mips, &finalSprites, trim, compression), false);
 	}
 	else for (size_t i = 0; i < origSprites->GetCount(); i++)
 	{
@@ -1,20 +1,24 @@
 #include "pch.h"
+#include "Globals/Log.h"
 #include "Graph/DirectXUtil.h"
 #include "Graph/Sprite/Sprite.h"
 #include "Graph/Sprite/SpriteList.h"
 #include "Graph/Sprite/SpriteOptimizer.h"
+#include "Graph/Sprite/SpritePacker.h"
 #include "Graph/Sprite/SpriteType.h"
 #include "Graph/GraphDevice.h"
 #include "Graph/RenderTarget/RenderTarget.h"
 #include "Graph/Texture/Palette.h"
 #include "Graph/Texture/PaletteData.h"
+#include "Graph/Texture/PaletteImage.h"
 #include "Graph/Texture/Texture.h"
 #include "Graph/Texture/TextureView.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
 
 // STATIC_DATA (pod)
 static const int TEXTURE_SIZE_MAX = 1024;
 static const int TEXTURE_SIZE_MIN = 128;
-static const int TEXTURE_GRID_SIZE = 8;
 
 // Info about where each sprite came from and where it's going
 struct OptimizedSpriteInfo
@@ -27,8 +31,10 @@ struct OptimizedSpriteInfo
 	ff::SpriteData _spriteData;
 	ff::RectInt _sourceRect;
 	ff::RectInt _destRect;
+	ff::PointInt _trimOffset;
 	size_t _destTexture;
 	size_t _spriteIndex;
+	size_t _duplicateOf; // original index of the first sprite with the same pixels
 };
 
 OptimizedSpriteInfo::OptimizedSpriteInfo()
@@ -41,8 +47,10 @@ OptimizedSpriteInfo::OptimizedSpriteInfo(ff::ISprite* sprite, size_t spriteIndex
 	: _spriteData(sprite->GetSpriteData())
 	, _sourceRect(sprite->GetSpriteData().GetTextureRect())
 	, _destRect(ff::RectInt::Zeros())
+	, _trimOffset(ff::PointInt::Zeros())
 	, _destTexture(ff::INVALID_SIZE)
 	, _spriteIndex(spriteIndex)
+	, _duplicateOf(spriteIndex)
 {
 }
 
@@ -114,26 +122,14 @@ struct OptimizedTextureInfo
 	OptimizedTextureInfo(const OptimizedTextureInfo& rhs);
 	OptimizedTextureInfo(OptimizedTextureInfo&& rhs);
 
-	ff::RectInt FindPlacement(ff::PointInt size);
-	bool PlaceRect(ff::RectInt rect);
-
 	ff::PointInt _size;
 	DirectX::ScratchImage _texture;
 	ff::ComPtr<ff::ITexture> _finalTexture;
-
-private:
-	BYTE _rowLeft[TEXTURE_SIZE_MAX / TEXTURE_GRID_SIZE];
-	BYTE _rowRight[TEXTURE_SIZE_MAX / TEXTURE_GRID_SIZE];
 };
 
 OptimizedTextureInfo::OptimizedTextureInfo(ff::PointInt size)
 	: _size(size)
 {
-	// Column indexes must fit within a byte (even one beyond the last column)
-	assert(TEXTURE_SIZE_MAX / TEXTURE_GRID_SIZE < 256 && _countof(_rowLeft) == _countof(_rowRight));
-
-	ff::ZeroObject(_rowLeft);
-	ff::ZeroObject(_rowRight);
 }
 
 OptimizedTextureInfo::OptimizedTextureInfo(const OptimizedTextureInfo& rhs)
@@ -141,9 +137,6 @@ OptimizedTextureInfo::OptimizedTextureInfo(const OptimizedTextureInfo& rhs)
 	, _finalTexture(rhs._finalTexture)
 {
 	assert(false);
-
-	std::memcpy(_rowLeft, rhs._rowLeft, sizeof(_rowLeft));
-	std::memcpy(_rowRight, rhs._rowRight, sizeof(_rowLeft));
 }
 
 OptimizedTextureInfo::OptimizedTextureInfo(OptimizedTextureInfo&& rhs)
@@ -151,230 +144,6 @@ OptimizedTextureInfo::OptimizedTextureInfo(OptimizedTextureInfo&& rhs)
 	, _texture(std::move(rhs._texture))
 	, _finalTexture(std::move(rhs._finalTexture))
 {
-	std::memcpy(_rowLeft, rhs._rowLeft, sizeof(_rowLeft));
-	std::memcpy(_rowRight, rhs._rowRight, sizeof(_rowLeft));
-}
-
-ff::RectInt OptimizedTextureInfo::FindPlacement(ff::PointInt size)
-{
-	ff::PointInt destPos(-1, -1);
-
-	if (size.x > 0 && size.x <= _size.x && size.y > 0 && size.y <= _size.y)
-	{
-		ff::PointInt cellSize(
-			(size.x + TEXTURE_GRID_SIZE - 1) / TEXTURE_GRID_SIZE,
-			(size.y + TEXTURE_GRID_SIZE - 1) / TEXTURE_GRID_SIZE);
-
-		for (int y = 0; y + cellSize.y <= _size.y / TEXTURE_GRID_SIZE; y++)
-		{
-			for (int attempt = 0; attempt < 2; attempt++)
-			{
-				// Try to put the sprite as far left as possible in each row
-				int x;
-
-				if (attempt)
-				{
-					x = _rowRight[y];
-
-#if FORCE_GAP
-					if (x)
-					{
-						// don't touch the previous sprite
-						x++;
-					}
-#endif
-				}
-				else
-				{
-					x = _rowLeft[y];
-#if FORCE_GAP
-					x -= cellSize.x + 1;
-#else
-					x -= cellSize.x;
-#endif
-				}
-
-				if (x >= 0 && x + cellSize.x <= _size.x / TEXTURE_GRID_SIZE)
-				{
-					bool found = true;
-
-#if FORCE_GAP
-					// Look for intersection with another sprite
-					for (int checkY = y + cellSize.y; checkY >= y - 1; checkY--)
-					{
-						if (checkY >= 0 &&
-							checkY < _size.y / TEXTURE_GRID_SIZE &&
-							checkY < _countof(_rowRight) &&
-							_rowRight[checkY] &&
-							_rowRight[checkY] + 1 > x &&
-							x + cellSize.x + 1 > _rowLeft[checkY])
-						{
-							found = false;
-							break;
-						}
-					}
-#else
-					// Look for intersection with another sprite
-					for (int checkY = y + cellSize.y - 1; checkY >= y; checkY--)
-					{
-						if (checkY >= 0 &&
-							checkY < _size.y / TEXTURE_GRID_SIZE &&
-							checkY < _countof(_rowRight) &&
-							_rowRight[checkY] &&
-							_rowRight[checkY] > x &&
-							x + cellSize.x > _rowLeft[checkY])
-						{
-							found = false;
-							break;
-						}
-					}
-#endif
-
-					// Prefer positions further to the left
-					if (found && (destPos.x == -1 || destPos.x > x * TEXTURE_GRID_SIZE))
-					{
-						destPos.SetPoint(x * TEXTURE_GRID_SIZE, y * TEXTURE_GRID_SIZE);
-					}
-				}
-			}
-		}
-	}
-
-	return (destPos.x == -1)
-		? ff::RectInt(0, 0, 0, 0)
-		: ff::RectInt(destPos.x, destPos.y, destPos.x + size.x, destPos.y + size.y);
-}
-
-bool OptimizedTextureInfo::PlaceRect(ff::RectInt rect)
-{
-	ff::RectInt rectCells(
-		rect.left / TEXTURE_GRID_SIZE,
-		rect.top / TEXTURE_GRID_SIZE,
-		(rect.right + TEXTURE_GRID_SIZE - 1) / TEXTURE_GRID_SIZE,
-		(rect.bottom + TEXTURE_GRID_SIZE - 1) / TEXTURE_GRID_SIZE);
-
-	assertRetVal(
-		rect.left >= 0 && rect.right <= _size.x &&
-		rect.top >= 0 && rect.bottom <= _size.y &&
-		rect.Width() > 0 &&
-		rect.Height() > 0, false);
-
-	// Validate that the sprite doesn't overlap anything
-
-#if FORCE_GAP
-	for (int y = rectCells.top - 1; y <= rectCells.bottom; y++)
-	{
-		if (y >= 0 && y < _size.y / TEXTURE_GRID_SIZE && y < _countof(_rowRight))
-		{
-			// Must be a one cell gap between sprites
-			assertRetVal(!_rowRight[y] ||
-				_rowRight[y] + 1 <= rectCells.left ||
-				rectCells.right + 1 <= _rowLeft[y], false);
-		}
-	}
-#else
-	for (int y = rectCells.top; y < rectCells.bottom; y++)
-	{
-		if (y >= 0 && y < _size.y / TEXTURE_GRID_SIZE && y < _countof(_rowRight))
-		{
-			// Must be a one cell gap between sprites
-			assertRetVal(!_rowRight[y] ||
-				_rowRight[y] <= rectCells.left ||
-				rectCells.right <= _rowLeft[y], false);
-		}
-	}
-#endif
-
-	// Invalidate the space taken up by the new sprite
-
-	for (int y = rectCells.top; y < rectCells.bottom; y++)
-	{
-		if (y >= 0 && y < _size.y / TEXTURE_GRID_SIZE && y < _countof(_rowRight))
-		{
-			if (_rowRight[y])
-			{
-				_rowLeft[y] = std::min<BYTE>(_rowLeft[y], rectCells.left);
-				_rowRight[y] = std::max<BYTE>(_rowRight[y], rectCells.right);
-			}
-			else
-			{
-				_rowLeft[y] = rectCells.left;
-				_rowRight[y] = rectCells.right;
-			}
-		}
-	}
-
-	return true;
-}
-
-// Returns true when all done (sprites will still be placed when false is returned)
-static bool PlaceSprites(ff::Vector<OptimizedSpriteInfo>& sprites, ff::Vector<OptimizedTextureInfo>& textureInfos, size_t startTexture)
-{
-	size_t nSpritesDone = 0;
-
-	for (size_t i = 0; i < sprites.Size(); i++)
-	{
-		OptimizedSpriteInfo& sprite = sprites[i];
-		bool bReusePrevious = (i > 0) && !(sprite < sprites[i - 1]) && !(sprites[i - 1] < sprite);
-
-		if (bReusePrevious)
-		{
-			sprite._destTexture = sprites[i - 1]._destTexture;
-			sprite._destRect = sprites[i - 1]._destRect;
-		}
-		else
-		{
-			if (sprite._destTexture == ff::INVALID_SIZE)
-			{
-				if (sprite._sourceRect.Width() > TEXTURE_SIZE_MAX ||
-					sprite._sourceRect.Height() > TEXTURE_SIZE_MAX)
-				{
-					ff::PointInt size = sprite._sourceRect.Size();
-
-					// Oversized, so make a new unshared texture
-					sprite._destTexture = textureInfos.Size();
-					sprite._destRect.SetRect(ff::PointInt(0, 0), size);
-
-					// texture sizes should be powers of 2 to support compression and mipmaps
-					size.x = (int)ff::NearestPowerOfTwo((size_t)size.x);
-					size.y = (int)ff::NearestPowerOfTwo((size_t)size.y);
-
-					OptimizedTextureInfo newTexture(size);
-					textureInfos.Push(newTexture);
-				}
-			}
-
-			if (sprite._destTexture == ff::INVALID_SIZE)
-			{
-				// Look for empty space in an existing texture
-				for (size_t h = startTexture; h < textureInfos.Size(); h++)
-				{
-					OptimizedTextureInfo& texture = textureInfos[h];
-
-					if (texture._size.x <= TEXTURE_SIZE_MAX &&
-						texture._size.y <= TEXTURE_SIZE_MAX)
-					{
-						sprite._destRect = texture.FindPlacement(sprite._sourceRect.Size());
-
-						if (!sprite._destRect.IsZeros())
-						{
-							verify(texture.PlaceRect(sprite._destRect));
-							sprite._destTexture = h;
-
-							break;
-						}
-					}
-				}
-			}
-		}
-
-		if (sprite._destTexture != ff::INVALID_SIZE)
-		{
-			nSpritesDone++;
-		}
-	}
-
-	return nSpritesDone == sprites.Size();
 }
 
 static ff::Vector<OptimizedSpriteInfo> CreateSpriteInfos(ff::ISpriteList* originalSprites)
@@ -406,7 +175,7 @@ static bool CreateOriginalTextures(ff::TextureFormat format, const ff::Vector<Op
 			ff::TextureFormat captureFormat = ff::IsColorFormat(format) ? ff::TextureFormat::RGBA32 : format;
 
 			OriginalTextureInfo textureInfo;
-			textureInfo._rgbTexture = texture->Convert(captureFormat, 1);
+			textureInfo._rgbTexture = texture->Convert(captureFormat, 1, ff::TextureCompression::Default);
 			assertRetVal(textureInfo._rgbTexture, false);
 
 			textureInfo._rgbScratch = textureInfo._rgbTexture->AsTextureDxgi()->Capture();
@@ -419,42 +188,123 @@ static bool CreateOriginalTextures(ff::TextureFormat format, const ff::Vector<Op
 	return true;
 }
 
-static bool ComputeOptimizedSprites(ff::Vector<OptimizedSpriteInfo>& sprites, ff::Vector<OptimizedTextureInfo>& textureInfos)
+// Must be called before sorting, so that sprite indexes match positions
+static bool ShareDuplicateSprites(ff::Vector<OptimizedSpriteInfo>& spriteInfos, const ff::Map<ff::ITexture*, OriginalTextureInfo>& originalTextures, bool trimSprites)
 {
-	for (bool bDone = false; !bDone && sprites.Size(); )
+	noAssertRetVal(spriteInfos.Size(), true);
+
+	ff::Vector<ff::SpriteImageRef> images;
+	ff::Vector<size_t> duplicateOf;
+	images.Reserve(spriteInfos.Size());
+	duplicateOf.Resize(spriteInfos.Size());
+	size_t pixelSize = 0;
+
+	for (const OptimizedSpriteInfo& spriteInfo : spriteInfos)
 	{
-		// Add a new texture, start with the smallest size and work up
-		for (ff::PointInt size(TEXTURE_SIZE_MIN, TEXTURE_SIZE_MIN); !bDone && size.x <= TEXTURE_SIZE_MAX; size *= 2)
-		{
-			size_t nTextureInfo = textureInfos.Size();
-			textureInfos.Push(OptimizedTextureInfo(size));
+		auto iter = originalTextures.GetKey(spriteInfo._spriteData._textureView->GetTexture());
+		assertRetVal(iter && spriteInfo._spriteIndex == images.Size(), false);
 
-			bDone = ::PlaceSprites(sprites, textureInfos, textureInfos.Size() - 1);
+		const DirectX::Image& image = *iter->GetValue()._rgbScratch->GetImages();
+		pixelSize = DirectX::BitsPerPixel(image.format) / 8;
+		images.Push(ff::SpriteImageRef{ image.pixels, image.rowPitch, spriteInfo._sourceRect });
+	}
 
-			if (!bDone && size.x < TEXTURE_SIZE_MAX)
-			{
-				// Remove this texture and use a bigger one instead
-				textureInfos.Delete(nTextureInfo);
+	ff::Timer timer;
+	size_t uniqueCount = ff::FindDuplicateSprites(images.Data(), images.Size(), pixelSize, trimSprites, duplicateOf.Data());
+	assertRetVal(uniqueCount, false);
 
-				for (OptimizedSpriteInfo& sprite : sprites)
-				{
-					if (sprite._destTexture != ff::INVALID_SIZE)
-					{
-						if (sprite._destTexture == nTextureInfo)
-						{
-							sprite._destTexture = ff::INVALID_SIZE;
-							sprite._destRect.SetRect(0, 0, 0, 0);
-						}
-						else if (sprite._destTexture > nTextureInfo)
-						{
-							sprite._destTexture--;
-						}
-					}
-				}
-			}
+	INT64 originalArea = 0;
+	INT64 uniqueArea = 0;
+
+	for (size_t i = 0; i < spriteInfos.Size(); i++)
+	{
+		OptimizedSpriteInfo& spriteInfo = spriteInfos[i];
+		originalArea += spriteInfo._sourceRect.Area();
+		uniqueArea += (duplicateOf[i] == i) ? images[i]._rect.Area() : 0;
+
+		spriteInfo._trimOffset = images[i]._rect.TopLeft() - spriteInfo._sourceRect.TopLeft();
+		spriteInfo._sourceRect = images[i]._rect;
+		spriteInfo._duplicateOf = duplicateOf[i];
+	}
+
+	ff::Log::GlobalTraceF(L"OptimizeSprites: %lu sprites, %lu with unique pixels%s, %.1fKB of pixels saved, %.1fms\n",
+		spriteInfos.Size(),
+		uniqueCount,
+		trimSprites ? L" after trimming" : L"",
+		(originalArea - uniqueArea) * pixelSize / 1024.0,
+		timer.Tick() * 1000.0);
+
+	return true;
+}
+
+static bool ComputeOptimizedSprites(ff::TextureFormat format, ff::Vector<OptimizedSpriteInfo>& sprites, ff::Vector<OptimizedTextureInfo>& textureInfos)
+{
+	noAssertRetVal(sprites.Size(), true);
+
+	// Only the first sprite with each image gets packed, the others share its spot
+	ff::Vector<ff::PointInt> packSizes;
+	ff::Vector<size_t> packSprites;
+	ff::Vector<size_t> sortedIndexes;
+	sortedIndexes.Resize(sprites.Size());
+
+	for (size_t i = 0; i < sprites.Size(); i++)
+	{
+		const OptimizedSpriteInfo& sprite = sprites[i];
+		assertRetVal(sprite._spriteIndex < sprites.Size(), false);
+		sortedIndexes[sprite._spriteIndex] = i;
+
+		if (sprite._duplicateOf == sprite._spriteIndex)
+		{
+			packSizes.Push(sprite._sourceRect.Size());
+			packSprites.Push(i);
 		}
 	}
 
+	// Block compressed textures need sprites on 4x4 block boundaries so that neighbors don't bleed into each other
+	ff::SpritePackOptions options;
+	options._minTextureSize.SetPoint(TEXTURE_SIZE_MIN, TEXTURE_SIZE_MIN);
+	options._maxTextureSize.SetPoint(TEXTURE_SIZE_MAX, TEXTURE_SIZE_MAX);
+	options._alignment = ff::IsCompressedFormat(format) ? 4 : 1;
+
+	ff::Timer timer;
+	ff::SpritePackResult result;
+	assertRetVal(ff::PackSprites(packSizes.Data(), packSizes.Size(), options, result), false);
+	double packTime = timer.Tick();
+
+	for (ff::PointInt size : result._textureSizes)
+	{
+		textureInfos.Push(OptimizedTextureInfo(size));
+	}
+
+	INT64 spriteArea = 0;
+	for (size_t h = 0; h < packSprites.Size(); h++)
+	{
+		OptimizedSpriteInfo& sprite = sprites[packSprites[h]];
+		sprite._destTexture = result._spriteTextures[h];
+		sprite._destRect.SetRect(result._spritePositions[h], result._spritePositions[h] + sprite._sourceRect.Size());
+		spriteArea += sprite._destRect.Area();
+	}
+
+	for (OptimizedSpriteInfo& sprite : sprites)
+	{
+		const OptimizedSpriteInfo& firstSprite = sprites[sortedIndexes[sprite._duplicateOf]];
+		sprite._destTexture = firstSprite._destTexture;
+		sprite._destRect = firstSprite._destRect;
+	}
+
+	INT64 textureArea = 0;
+	for (const OptimizedTextureInfo& texture : textureInfos)
+	{
+		textureArea += (INT64)texture._size.x * texture._size.y;
+	}
+
+	ff::Log::GlobalTraceF(L"OptimizeSprites: %lu sprites (%lu unique) into %lu textures, %.1f%% used, %.1fms\n",
+		sprites.Size(),
+		packSizes.Size(),
+		textureInfos.Size(),
+		textureArea ? spriteArea * 100.0 / textureArea : 0.0,
+		packTime * 1000.0);
+
 	return true;
 }
 
@@ -487,6 +337,11 @@ static bool CopyOptimizedSprites(
 		OriginalTextureInfo& originalInfo = iter->GetEditableValue();
 		sprite._spriteData._type = ff::GetSpriteTypeForImage(*originalInfo._rgbScratch, &sprite._sourceRect.ToType<size_t>());
 
+		if (sprite._duplicateOf != sprite._spriteIndex)
+		{
+			continue;
+		}
+
 		verifyHr(DirectX::CopyRectangle(
 			*originalInfo._rgbScratch->GetImages(),
 			DirectX::Rect(
@@ -503,21 +358,21 @@ static bool CopyOptimizedSprites(
 	return true;
 }
 
-static bool ConvertFinalTextures(ff::IGraphDevice* device, ff::TextureFormat format, size_t mipMapLevels, ff::Vector<OptimizedTextureInfo>& textureInfos, ff::IPaletteData* paletteData)
+static bool ConvertFinalTextures(ff::IGraphDevice* device, ff::TextureFormat format, size_t mipMapLevels, ff::TextureCompression compression, ff::Vector<OptimizedTextureInfo>& textureInfos, ff::IPaletteData* paletteData)
 {
 	for (OptimizedTextureInfo& textureInfo : textureInfos)
 	{
 		ff::ComPtr<ff::ITexture> rgbTexture = device->AsGraphDeviceInternal()->CreateTexture(std::move(textureInfo._texture), paletteData);
 		assertRetVal(rgbTexture, false);
 
-		textureInfo._finalTexture = rgbTexture->Convert(format, mipMapLevels);
+		textureInfo._finalTexture = rgbTexture->Convert(format, mipMapLevels, compression);
 		assertRetVal(textureInfo._finalTexture, false);
 	}
 
 	return true;
 }
 
-static bool CreateFinalSprites(const ff::Vector<OptimizedSpriteInfo>& spriteInfos, ff::Vector<OptimizedTextureInfo>& textureInfos, ff::ISpriteList* newSprites)
+static bool CreateFinalSprites(const ff::Vector<OptimizedSpriteInfo>& spriteInfos, ff::Vector<OptimizedTextureInfo>& textureInfos, ff::PointFloat handleOffset, ff::ISpriteList* newSprites)
 {
 	for (const OptimizedSpriteInfo& spriteInfo : spriteInfos)
 	{
@@ -525,7 +380,7 @@ static bool CreateFinalSprites(const ff::Vector<OptimizedSpriteInfo>& spriteInfo
 			textureInfos[spriteInfo._destTexture]._finalTexture->AsTextureView(),
 			spriteInfo._spriteData._name,
 			spriteInfo._destRect.ToType<float>(),
-			spriteInfo._spriteData.GetHandle(),
+			spriteInfo._spriteData.GetHandle() + handleOffset - spriteInfo._trimOffset.ToType<float>(),
 			spriteInfo._spriteData.GetScale(),
 			spriteInfo._spriteData._type), false);
 	}
@@ -544,20 +399,21 @@ static ff::ComPtr<ff::ISpriteList> CreateOutputSprites(ff::IGraphDevice* device,
 	return newSprites;
 }
 
-bool ff::OptimizeSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites)
+bool ff::OptimizeSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites, bool trimSprites, TextureCompression compression)
 {
 	assertRetVal(originalSprites && outSprites && (mipMapLevels == 1 || ff::IsColorFormat(format)), false);
 	ComPtr<ISpriteList> newSprites = ::CreateOutputSprites(originalSprites->GetDevice(), *outSprites);
 
 	Vector<OptimizedSpriteInfo> spriteInfos = ::CreateSpriteInfos(originalSprites);
-	std::sort(spriteInfos.begin(), spriteInfos.end());
 
 	Map<ITexture*, OriginalTextureInfo> originalTextures;
 	ComPtr<IPaletteData> paletteData;
 	assertRetVal(::CreateOriginalTextures(format, spriteInfos, originalTextures, paletteData), false);
+	assertRetVal(::ShareDuplicateSprites(spriteInfos, originalTextures, trimSprites), false);
+	std::sort(spriteInfos.begin(), spriteInfos.end());
 
 	Vector<OptimizedTextureInfo> textureInfos;
-	assertRetVal(::ComputeOptimizedSprites(spriteInfos, textureInfos), false);
+	assertRetVal(::ComputeOptimizedSprites(format, spriteInfos, textureInfos), false);
 	assertRetVal(::CreateOptimizedTextures(format, textureInfos), false);
 
 	// Go back to the original order
@@ -567,98 +423,161 @@ bool ff::OptimizeSprites(ISpriteList* originalSprites, TextureFormat format, siz
 		});
 
 	assertRetVal(::CopyOptimizedSprites(spriteInfos, originalTextures, textureInfos), false);
-	assertRetVal(::ConvertFinalTextures(originalSprites->GetDevice(), format, mipMapLevels, textureInfos, paletteData), false);
-	assertRetVal(::CreateFinalSprites(spriteInfos, textureInfos, newSprites), false);
+	assertRetVal(::ConvertFinalTextures(originalSprites->GetDevice(), format, mipMapLevels, compression, textureInfos, paletteData), false);
+	assertRetVal(::CreateFinalSprites(spriteInfos, textureInfos, ff::PointFloat::Zeros(), newSprites), false);
 
 	*outSprites = *outSprites ? *outSprites : newSprites.Detach();
 	return true;
 }
 
-static bool CreateOutlineSprites(
-	ff::TextureFormat format,
-	ff::Vector<OptimizedSpriteInfo>& spriteInfos,
+// Outlines are written straight into the packed textures, the packing was done with outline sized rects
+static bool CopyOutlineSprites(
+	const ff::Vector<OptimizedSpriteInfo>& spriteInfos,
 	const ff::Map<ff::ITexture*, OriginalTextureInfo>& originalTextures,
-	ff::Vector<ff::ComPtr<ff::ITexture>>& outlineTextures,
-	ff::ISpriteList* outlineSpriteList,
-	ff::IPaletteData* paletteData)
+	ff::Vector<OptimizedTextureInfo>& textureInfos)
 {
-	assertRetVal(outlineSpriteList, false);
-	bool usePalette = ff::IsPaletteFormat(format);
-	const int pixelSize = usePalette ? 1 : 4;
-	const int alphaOffset = usePalette ? 0 : 3;
+	ff::Vector<const DirectX::Image*> srcImages;
+	srcImages.Reserve(spriteInfos.Size());
 
-	for (OptimizedSpriteInfo& spriteInfo : spriteInfos)
+	for (const OptimizedSpriteInfo& spriteInfo : spriteInfos)
 	{
-		const ff::SpriteData& spriteData = spriteInfo._spriteData;
-		ff::ITexture* originalTexture = spriteData._textureView->GetTexture();
-		auto iter = originalTextures.GetKey(originalTexture);
-		assertRetVal(iter, false);
-
-		const OriginalTextureInfo& originalTextureInfo = iter->GetValue();
-		const ff::RectInt& srcRect = spriteInfo._sourceRect;
+		auto iter = originalTextures.GetKey(spriteInfo._spriteData._textureView->GetTexture());
+		assertRetVal(iter && spriteInfo._destTexture < textureInfos.Size(), false);
+		srcImages.Push(iter->GetValue()._rgbScratch->GetImages());
+	}
 
-		DirectX::ScratchImage outlineScratch;
-		assertHrRetVal(outlineScratch.Initialize2D(
-			usePalette ? DXGI_FORMAT_R8_UINT : DXGI_FORMAT_R8G8B8A8_UNORM,
-			srcRect.Width() + 2,
-			srcRect.Height() + 2,
-			1, 1), false);
-		::ZeroMemory(outlineScratch.GetPixels(), outlineScratch.GetPixelsSize());
+	// Each outline only depends on its own sprite and they don't overlap, so they are all created in parallel
+	std::atomic_bool failed = false;
 
-		const DirectX::Image& srcImage = *originalTextureInfo._rgbScratch->GetImages();
-		const DirectX::Image& destImage = *outlineScratch.GetImages();
+	ff::ParallelFor(spriteInfos.Size(), [&spriteInfos, &srcImages, &textureInfos, &failed](size_t i)
+	{
+		const OptimizedSpriteInfo& spriteInfo = spriteInfos[i];
 
-		for (ff::PointInt xy(srcRect.left, srcRect.top), destXY = ff::PointInt::Zeros(); xy.y < srcRect.bottom; xy.y++, destXY.y++)
+		// Identical sprites share a dest rect and the first one fills it
+		if (spriteInfo._duplicateOf != spriteInfo._spriteIndex)
 		{
-			const uint8_t* srcRow = srcImage.pixels + srcImage.rowPitch * xy.y + srcRect.left * pixelSize;
+			return;
+		}
 
-			for (xy.x = srcRect.left, destXY.x = 0; xy.x < srcRect.right; xy.x++, destXY.x++, srcRow += pixelSize)
-			{
-				if (srcRow[alphaOffset]) // alpha is set
-				{
-					uint8_t* dest = destImage.pixels + destImage.rowPitch * destXY.y + destXY.x * pixelSize;
-
-					if (usePalette)
-					{
-						dest[0] = 1;
-						dest[1] = 1;
-						dest[2] = 1;
-
-						dest += destImage.rowPitch;
-						dest[0] = 1;
-						dest[1] = 1;
-						dest[2] = 1;
-
-						dest += destImage.rowPitch;
-						dest[0] = 1;
-						dest[1] = 1;
-						dest[2] = 1;
-					}
-					else
-					{
-						((DWORD*)dest)[0] = 0xFFFFFFFF;
-						((DWORD*)dest)[1] = 0xFFFFFFFF;
-						((DWORD*)dest)[2] = 0xFFFFFFFF;
-
-						dest += destImage.rowPitch;
-						((DWORD*)dest)[0] = 0xFFFFFFFF;
-						((DWORD*)dest)[1] = 0xFFFFFFFF;
-						((DWORD*)dest)[2] = 0xFFFFFFFF;
-
-						dest += destImage.rowPitch;
-						((DWORD*)dest)[0] = 0xFFFFFFFF;
-						((DWORD*)dest)[1] = 0xFFFFFFFF;
-						((DWORD*)dest)[2] = 0xFFFFFFFF;
-					}
-				}
-			}
+		if (!ff::CreateOutlineImage(
+			*srcImages[i],
+			spriteInfo._sourceRect.Deflate(1, 1),
+			*textureInfos[spriteInfo._destTexture]._texture.GetImages(),
+			spriteInfo._destRect.TopLeft()))
+		{
+			failed = true;
 		}
+	});
+
+	assertRetVal(!failed, false);
+	return true;
+}
+
+bool ff::CreateOutlineSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites, TextureCompression compression)
+{
+	assertRetVal(originalSprites && outSprites && (ff::IsColorFormat(format) || ff::IsPaletteFormat(format)), false);
+	assertRetVal(mipMapLevels == 1 || ff::IsColorFormat(format), false);
+	ComPtr<ISpriteList> newSprites = ::CreateOutputSprites(originalSprites->GetDevice(), *outSprites);
+
+	ff::Timer timer;
+	Vector<OptimizedSpriteInfo> spriteInfos = ::CreateSpriteInfos(originalSprites);
+
+	Map<ITexture*, OriginalTextureInfo> originalTextures;
+	ComPtr<IPaletteData> paletteData;
+	assertRetVal(::CreateOriginalTextures(format, spriteInfos, originalTextures, paletteData), false);
+	assertRetVal(::ShareDuplicateSprites(spriteInfos, originalTextures, false), false);
+
+	// Outlines are one pixel larger on each side, so the packer places outline sized rects
+	for (OptimizedSpriteInfo& spriteInfo : spriteInfos)
+	{
+		spriteInfo._sourceRect = spriteInfo._sourceRect.Inflate(1, 1);
+	}
+
+	std::sort(spriteInfos.begin(), spriteInfos.end());
+
+	Vector<OptimizedTextureInfo> textureInfos;
+	assertRetVal(::ComputeOptimizedSprites(format, spriteInfos, textureInfos), false);
+	assertRetVal(::CreateOptimizedTextures(format, textureInfos), false);
+	assertRetVal(::CopyOutlineSprites(spriteInfos, originalTextures, textureInfos), false);
+
+	// Go back to the original order
+	std::sort(spriteInfos.begin(), spriteInfos.end(), [](const OptimizedSpriteInfo& info1, const OptimizedSpriteInfo& info2)
+		{
+			return info1._spriteIndex < info2._spriteIndex;
+		});
+
+	for (OptimizedSpriteInfo& spriteInfo : spriteInfos)
+	{
+		spriteInfo._spriteData._type = ff::GetSpriteTypeForImage(textureInfos[spriteInfo._destTexture]._texture, &spriteInfo._destRect.ToType<size_t>());
+	}
+
+	assertRetVal(::ConvertFinalTextures(originalSprites->GetDevice(), format, mipMapLevels, compression, textureInfos, paletteData), false);
+	// The outline's top left is one pixel up and left of the sprite
+	assertRetVal(::CreateFinalSprites(spriteInfos, textureInfos, ff::PointFloat(1, 1), newSprites), false);
+
+	ff::Log::GlobalTraceF(L"CreateOutlineSprites: %lu sprites into %lu textures, %.1fms\n",
+		spriteInfos.Size(),
+		textureInfos.Size(),
+		timer.Tick() * 1000.0);
+
+	*outSprites = *outSprites ? *outSprites : newSprites.Detach();
+	return true;
+}
+
+static size_t CountSpriteTextures(ff::ISpriteList* sprites)
+{
+	ff::Set<ff::ITexture*> textures;
+
+	for (size_t i = 0; i < sprites->GetCount(); i++)
+	{
+		textures.SetKey(sprites->Get(i)->GetSpriteData()._textureView->GetTexture());
+	}
+
+	return textures.Size();
+}
+
+// How outlines used to be created: a texture for every outline, then all of them optimized into packed textures
+static bool CreateOutlineSpritesPerTexture(ff::ISpriteList* originalSprites, ff::TextureFormat format, ff::ISpriteList** outSprites, size_t& peakTextures)
+{
+	ff::IGraphDevice* device = originalSprites->GetDevice();
+	ff::Vector<OptimizedSpriteInfo> spriteInfos = ::CreateSpriteInfos(originalSprites);
+
+	ff::Map<ff::ITexture*, OriginalTextureInfo> originalTextures;
+	ff::ComPtr<ff::IPaletteData> paletteData;
+	assertRetVal(::CreateOriginalTextures(format, spriteInfos, originalTextures, paletteData), false);
+
+	ff::Vector<const DirectX::Image*> srcImages;
+	srcImages.Reserve(spriteInfos.Size());
+
+	for (const OptimizedSpriteInfo& spriteInfo : spriteInfos)
+	{
+		auto iter = originalTextures.GetKey(spriteInfo._spriteData._textureView->GetTexture());
+		assertRetVal(iter, false);
+		srcImages.Push(iter->GetValue()._rgbScratch->GetImages());
+	}
 
-		ff::ComPtr<ff::ITexture> outlineTexture = originalTexture->GetDevice()->AsGraphDeviceInternal()->CreateTexture(std::move(outlineScratch), paletteData);
+	ff::Vector<DirectX::ScratchImage> outlineScratches;
+	outlineScratches.Resize(spriteInfos.Size());
+
+	ff::ParallelFor(spriteInfos.Size(), [&spriteInfos, &srcImages, &outlineScratches](size_t i)
+	{
+		outlineScratches[i] = ff::CreateOutlineImage(*srcImages[i], spriteInfos[i]._sourceRect);
+	});
+
+	ff::ComPtr<ff::ISpriteList> outlineSprites;
+	ff::Vector<ff::ComPtr<ff::ITexture>> outlineTextures;
+	assertRetVal(ff::CreateSpriteList(device, &outlineSprites), false);
+
+	for (size_t i = 0; i < spriteInfos.Size(); i++)
+	{
+		const ff::SpriteData& spriteData = spriteInfos[i]._spriteData;
+		assertRetVal(outlineScratches[i].GetImageCount(), false);
+
+		ff::ComPtr<ff::ITexture> outlineTexture = device->AsGraphDeviceInternal()->CreateTexture(std::move(outlineScratches[i]), paletteData);
 		assertRetVal(outlineTexture, false);
 		outlineTextures.Push(outlineTexture);
 
-		assertRetVal(outlineSpriteList->Add(
+		assertRetVal(outlineSprites->Add(
 			outlineTexture->AsTextureView(),
 			spriteData._name,
 			ff::RectInt(outlineTexture->GetSize()).ToType<float>(),
@@ -666,21 +585,146 @@ static bool CreateOutlineSprites(
 			spriteData.GetScale()), false);
 	}
 
+	assertRetVal(ff::OptimizeSprites(outlineSprites, format, 1, outSprites), false);
+
+	// Every outline texture is still alive when the packed textures are created
+	peakTextures = outlineTextures.Size() + ::CountSpriteTextures(*outSprites);
 	return true;
 }
 
-bool ff::CreateOutlineSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites)
+bool ff::MeasureOutlineSprites(ISpriteList* originalSprites, TextureFormat format, OutlineSpritesReport& report)
 {
-	assertRetVal(originalSprites && outSprites && (ff::IsColorFormat(format) || ff::IsPaletteFormat(format)), false);
-	ComPtr<ISpriteList> newSprites = ::CreateOutputSprites(originalSprites->GetDevice(), nullptr);
-	Vector<OptimizedSpriteInfo> spriteInfos = ::CreateSpriteInfos(originalSprites);
+	assertRetVal(originalSprites && (ff::IsColorFormat(format) || ff::IsPaletteFormat(format)), false);
+	ff::ZeroObject(report);
+	report._spriteCount = originalSprites->GetCount();
 
-	Map<ITexture*, OriginalTextureInfo> originalTextures;
-	ComPtr<IPaletteData> paletteData;
-	assertRetVal(::CreateOriginalTextures(format, spriteInfos, originalTextures, paletteData), false);
+	ff::Timer timer;
+	{
+		ComPtr<ISpriteList> outlineSprites;
+		assertRetVal(::CreateOutlineSpritesPerTexture(originalSprites, format, &outlineSprites, report._perTexturePeakTextures), false);
+		report._perTextureSeconds = timer.Tick();
+	}
+
+	{
+		ComPtr<ISpriteList> outlineSprites;
+		assertRetVal(ff::CreateOutlineSprites(originalSprites, format, 1, &outlineSprites), false);
+		report._packedSeconds = timer.Tick();
+		report._packedPeakTextures = ::CountSpriteTextures(outlineSprites);
+	}
+
+	return true;
+}
+
+static bool IsTransparentPixel(const BYTE* pixel, size_t pixelSize)
+{
+	return (pixelSize == 1) ? !pixel[0] : !pixel[3];
+}
+
+// Returns the original rect when every pixel is transparent, so that empty sprites stay the same
+static ff::RectInt TrimSpriteRect(const ff::SpriteImageRef& sprite, size_t pixelSize)
+{
+	const ff::RectInt& rect = sprite._rect;
+	ff::RectInt trimmed = rect;
+	bool found = false;
+
+	for (int y = rect.top; y < rect.bottom; y++)
+	{
+		const BYTE* row = sprite._pixels + y * sprite._rowPitch;
+
+		for (int x = rect.left; x < rect.right; x++)
+		{
+			if (!::IsTransparentPixel(row + x * pixelSize, pixelSize))
+			{
+				if (!found)
+				{
+					trimmed.SetRect(x, y, x + 1, y + 1);
+					found = true;
+				}
+				else
+				{
+					trimmed.left = std::min(trimmed.left, x);
+					trimmed.right = std::max(trimmed.right, x + 1);
+					trimmed.bottom = y + 1;
+				}
+			}
+		}
+	}
+
+	return trimmed;
+}
+
+static ff::hash_t HashSpritePixels(const ff::SpriteImageRef& sprite, size_t pixelSize)
+{
+	const size_t rowSize = sprite._rect.Width() * pixelSize;
 
-	Vector<ComPtr<ITexture>> outlineTextures;
-	assertRetVal(::CreateOutlineSprites(format, spriteInfos, originalTextures, outlineTextures, newSprites, paletteData), false);
+	ff::Vector<BYTE> bytes;
+	bytes.Resize(rowSize * sprite._rect.Height());
+
+	for (int y = 0; y < sprite._rect.Height(); y++)
+	{
+		const BYTE* row = sprite._pixels + (sprite._rect.top + y) * sprite._rowPitch + sprite._rect.left * pixelSize;
+		std::memcpy(bytes.Data() + y * rowSize, row, rowSize);
+	}
+
+	return ff::HashBytes(bytes.Data(), bytes.ByteSize());
+}
+
+static bool EqualSpritePixels(const ff::SpriteImageRef& sprite1, const ff::SpriteImageRef& sprite2, size_t pixelSize)
+{
+	noAssertRetVal(sprite1._rect.Size() == sprite2._rect.Size(), false);
+	const size_t rowSize = sprite1._rect.Width() * pixelSize;
+
+	for (int y = 0; y < sprite1._rect.Height(); y++)
+	{
+		const BYTE* row1 = sprite1._pixels + (sprite1._rect.top + y) * sprite1._rowPitch + sprite1._rect.left * pixelSize;
+		const BYTE* row2 = sprite2._pixels + (sprite2._rect.top + y) * sprite2._rowPitch + sprite2._rect.left * pixelSize;
+		noAssertRetVal(!std::memcmp(row1, row2, rowSize), false);
+	}
+
+	return true;
+}
+
+size_t ff::FindDuplicateSprites(SpriteImageRef* sprites, size_t count, size_t pixelSize, bool trimSprites, size_t* duplicateOf)
+{
+	assertRetVal((pixelSize == 1 || pixelSize == 4) && ((sprites && duplicateOf) || !count), 0);
+
+	// Trimming and hashing only look at one sprite at a time
+	ff::Vector<ff::hash_t> hashes;
+	hashes.Resize(count);
+
+	ff::ParallelFor(count, [sprites, pixelSize, trimSprites, &hashes](size_t i)
+	{
+		if (trimSprites)
+		{
+			sprites[i]._rect = ::TrimSpriteRect(sprites[i], pixelSize);
+		}
+
+		hashes[i] = ::HashSpritePixels(sprites[i], pixelSize);
+	});
+
+	// Sprites with the same hash are compared, so a hash collision can't share the wrong pixels
+	ff::Map<ff::hash_t, size_t> uniqueSprites;
+	size_t uniqueCount = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		duplicateOf[i] = i;
+
+		for (auto iter = uniqueSprites.GetKey(hashes[i]); iter; iter = uniqueSprites.GetNextDupeKey(*iter))
+		{
+			if (::EqualSpritePixels(sprites[iter->GetValue()], sprites[i], pixelSize))
+			{
+				duplicateOf[i] = iter->GetValue();
+				break;
+			}
+		}
+
+		if (duplicateOf[i] == i)
+		{
+			uniqueSprites.InsertKey(hashes[i], i);
+			uniqueCount++;
+		}
+	}
 
-	return ff::OptimizeSprites(newSprites, format, mipMapLevels, outSprites);
+	return uniqueCount;
 }
@@ -1,10 +1,40 @@
 #pragma once
 
+#include "Graph/Texture/TextureCompress.h"
+
 namespace ff
 {
 	class ISpriteList;
 	enum class TextureFormat;
 
-	UTIL_API bool OptimizeSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites);
-	UTIL_API bool CreateOutlineSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites);
+	// Pixels of one sprite within a larger image
+	struct SpriteImageRef
+	{
+		const BYTE* _pixels;
+		size_t _rowPitch;
+		ff::RectInt _rect;
+	};
+
+	// Sprites that are fully transparent around the edges can be trimmed, their handles are moved to match.
+	// The compression quality is used when the final textures are block compressed.
+	UTIL_API bool OptimizeSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites, bool trimSprites = false, TextureCompression compression = TextureCompression::Default);
+	UTIL_API bool CreateOutlineSprites(ISpriteList* originalSprites, TextureFormat format, size_t mipMapLevels, ISpriteList** outSprites, TextureCompression compression = TextureCompression::Default);
+
+	// Outlines used to get a texture each before being packed, now they are drawn straight into the packed textures.
+	// Peak textures counts the new textures that are alive at the same time, not the original sprite textures.
+	struct OutlineSpritesReport
+	{
+		size_t _spriteCount;
+		size_t _perTexturePeakTextures;
+		size_t _packedPeakTextures;
+		double _perTextureSeconds;
+		double _packedSeconds;
+	};
+
+	UTIL_API bool MeasureOutlineSprites(ISpriteList* originalSprites, TextureFormat format, OutlineSpritesReport& report);
+
+	// Finds sprites with identical pixels, even when they come from different images. pixelSize is 1 for palette
+	// images (index 0 is transparent) or 4 for RGBA. When trimming, the rects shrink to exclude transparent borders first.
+	// duplicateOf[i] is set to the first sprite with the same pixels, which is i for unique sprites. Returns the unique count.
+	UTIL_API size_t FindDuplicateSprites(SpriteImageRef* sprites, size_t count, size_t pixelSize, bool trimSprites, size_t* duplicateOf);
 }
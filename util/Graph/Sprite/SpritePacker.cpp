@@ -0,0 +1,455 @@
+#include "pch.h"
+#include "Graph/Sprite/SpritePacker.h"
+#include "Thread/ThreadUtil.h"
+
+enum class PackHeuristic
+{
+	BestShortSideFit,
+	BestAreaFit,
+	BottomLeft,
+
+	Count
+};
+
+enum class PackOrder
+{
+	Height,
+	Area,
+	LongSide,
+
+	Count
+};
+
+// Free space in a texture is tracked as a list of maximal free rectangles (MaxRects)
+struct PackBin
+{
+	PackBin(ff::PointInt size);
+
+	bool Find(ff::PointInt size, PackHeuristic heuristic, ff::RectInt& rect, int& bestScore1, int& bestScore2) const;
+	void Place(const ff::RectInt& rect);
+
+	ff::PointInt _size;
+	int _freeArea;
+	ff::Vector<ff::RectInt> _freeRects;
+};
+
+// The result of packing with one texture size, heuristic, and sort order
+struct PackAttempt
+{
+	bool IsBetterThan(const PackAttempt& rhs) const;
+
+	ff::Vector<ff::PointInt> _binSizes;
+	ff::Vector<size_t> _spriteBins;
+	ff::Vector<ff::PointInt> _spritePositions;
+	INT64 _binArea;
+	bool _valid;
+};
+
+PackBin::PackBin(ff::PointInt size)
+	: _size(size)
+	, _freeArea(size.x * size.y)
+{
+	_freeRects.Push(ff::RectInt(size));
+}
+
+bool PackBin::Find(ff::PointInt size, PackHeuristic heuristic, ff::RectInt& rect, int& bestScore1, int& bestScore2) const
+{
+	bool found = false;
+
+	for (const ff::RectInt& freeRect : _freeRects)
+	{
+		ff::PointInt leftover = freeRect.Size() - size;
+		if (leftover.x < 0 || leftover.y < 0)
+		{
+			continue;
+		}
+
+		int score1;
+		int score2;
+
+		switch (heuristic)
+		{
+		default:
+			score1 = std::min(leftover.x, leftover.y);
+			score2 = std::max(leftover.x, leftover.y);
+			break;
+
+		case PackHeuristic::BestAreaFit:
+			score1 = freeRect.Area() - size.x * size.y;
+			score2 = std::min(leftover.x, leftover.y);
+			break;
+
+		case PackHeuristic::BottomLeft:
+			score1 = freeRect.top + size.y;
+			score2 = freeRect.left;
+			break;
+		}
+
+		if (score1 < bestScore1 || (score1 == bestScore1 && score2 < bestScore2))
+		{
+			bestScore1 = score1;
+			bestScore2 = score2;
+			rect.SetRect(freeRect.TopLeft(), freeRect.TopLeft() + size);
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+void PackBin::Place(const ff::RectInt& rect)
+{
+	ff::Vector<ff::RectInt, 64> newRects;
+	_freeArea -= rect.Area();
+
+	// Split every free rect that intersects the placed rect
+
+	for (size_t i = 0; i < _freeRects.Size(); )
+	{
+		ff::RectInt freeRect = _freeRects[i];
+		if (!freeRect.DoesIntersect(rect))
+		{
+			i++;
+			continue;
+		}
+
+		if (rect.left > freeRect.left)
+		{
+			newRects.Push(ff::RectInt(freeRect.left, freeRect.top, rect.left, freeRect.bottom));
+		}
+
+		if (rect.right < freeRect.right)
+		{
+			newRects.Push(ff::RectInt(rect.right, freeRect.top, freeRect.right, freeRect.bottom));
+		}
+
+		if (rect.top > freeRect.top)
+		{
+			newRects.Push(ff::RectInt(freeRect.left, freeRect.top, freeRect.right, rect.top));
+		}
+
+		if (rect.bottom < freeRect.bottom)
+		{
+			newRects.Push(ff::RectInt(freeRect.left, rect.bottom, freeRect.right, freeRect.bottom));
+		}
+
+		_freeRects[i] = _freeRects.GetLast();
+		_freeRects.Pop();
+	}
+
+	// New rects are inside of removed rects, so they can't contain any remaining free rect.
+	// Only drop the new rects that are inside of another free rect.
+
+	for (size_t i = 0; i < newRects.Size(); i++)
+	{
+		bool contained = false;
+
+		for (size_t h = 0; !contained && h < newRects.Size(); h++)
+		{
+			contained = h != i && newRects[i].IsInside(newRects[h]) && (newRects[i] != newRects[h] || h < i);
+		}
+
+		for (size_t h = 0; !contained && h < _freeRects.Size(); h++)
+		{
+			contained = newRects[i].IsInside(_freeRects[h]);
+		}
+
+		if (!contained)
+		{
+			_freeRects.Push(newRects[i]);
+		}
+	}
+}
+
+bool PackAttempt::IsBetterThan(const PackAttempt& rhs) const
+{
+	if (_valid != rhs._valid)
+	{
+		return _valid;
+	}
+
+	if (_binSizes.Size() != rhs._binSizes.Size())
+	{
+		return _binSizes.Size() < rhs._binSizes.Size();
+	}
+
+	return _binArea < rhs._binArea;
+}
+
+static ff::PointInt AlignSize(ff::PointInt size, int alignment)
+{
+	return ff::PointInt(
+		(size.x + alignment - 1) / alignment * alignment,
+		(size.y + alignment - 1) / alignment * alignment);
+}
+
+static ff::Vector<size_t> SortSprites(const ff::Vector<ff::PointInt>& sizes, PackOrder order)
+{
+	ff::Vector<size_t> indexes;
+	indexes.Reserve(sizes.Size());
+
+	for (size_t i = 0; i < sizes.Size(); i++)
+	{
+		indexes.Push(i);
+	}
+
+	std::stable_sort(indexes.begin(), indexes.end(), [&sizes, order](size_t i1, size_t i2)
+		{
+			ff::PointInt s1 = sizes[i1];
+			ff::PointInt s2 = sizes[i2];
+
+			switch (order)
+			{
+			default:
+				return s1.y != s2.y ? s1.y > s2.y : s1.x > s2.x;
+
+			case PackOrder::Area:
+				return s1.x * s1.y > s2.x * s2.y;
+
+			case PackOrder::LongSide:
+				return std::max(s1.x, s1.y) > std::max(s2.x, s2.y);
+			}
+		});
+
+	return indexes;
+}
+
+// Places sprites into bins of binSize, opening new bins as needed. Returns false if a sprite can't fit in an empty bin.
+static bool PlaceSprites(
+	const ff::Vector<size_t>& order,
+	const ff::Vector<ff::PointInt>& sizes,
+	ff::PointInt binSize,
+	PackHeuristic heuristic,
+	size_t maxBins,
+	ff::Vector<PackBin>& bins,
+	ff::Vector<size_t>& spriteBins,
+	ff::Vector<ff::PointInt>& spritePositions)
+{
+	for (size_t spriteIndex : order)
+	{
+		ff::PointInt size = sizes[spriteIndex];
+		int area = size.x * size.y;
+		int bestScore1 = INT_MAX;
+		int bestScore2 = INT_MAX;
+		size_t bestBin = ff::INVALID_SIZE;
+		ff::RectInt bestRect;
+
+		for (size_t i = 0; i < bins.Size(); i++)
+		{
+			if (bins[i]._freeArea >= area && bins[i].Find(size, heuristic, bestRect, bestScore1, bestScore2))
+			{
+				bestBin = i;
+			}
+		}
+
+		if (bestBin == ff::INVALID_SIZE)
+		{
+			noAssertRetVal(bins.Size() < maxBins, false);
+			bins.Push(PackBin(binSize));
+			noAssertRetVal(bins.GetLast().Find(size, heuristic, bestRect, bestScore1, bestScore2), false);
+			bestBin = bins.Size() - 1;
+		}
+
+		bins[bestBin].Place(bestRect);
+		spriteBins[spriteIndex] = bestBin;
+		spritePositions[spriteIndex] = bestRect.TopLeft();
+	}
+
+	return true;
+}
+
+static PackAttempt PackAllSprites(
+	const ff::Vector<ff::PointInt>& sizes,
+	const ff::SpritePackOptions& options,
+	ff::PointInt textureSize,
+	PackHeuristic heuristic,
+	PackOrder order)
+{
+	PackAttempt attempt;
+	attempt._binArea = 0;
+	attempt._valid = false;
+	attempt._spriteBins.Resize(sizes.Size());
+	attempt._spritePositions.Resize(sizes.Size());
+
+	// Bins are bigger than the texture by the padding, so the padding of sprites at the right and bottom edges can hang off
+	ff::PointInt padding(options._padding, options._padding);
+	ff::Vector<size_t> sortedSprites = ::SortSprites(sizes, order);
+	ff::Vector<PackBin> bins;
+	noAssertRetVal(::PlaceSprites(sortedSprites, sizes, textureSize + padding, heuristic, ff::INVALID_SIZE, bins, attempt._spriteBins, attempt._spritePositions), attempt);
+
+	for (size_t i = 0; i < bins.Size(); i++)
+	{
+		attempt._binSizes.Push(textureSize);
+	}
+
+	// The last texture is usually not full, so try to shrink it
+
+	ff::Vector<size_t> lastSprites;
+	for (size_t spriteIndex : sortedSprites)
+	{
+		if (attempt._spriteBins[spriteIndex] == bins.Size() - 1)
+		{
+			lastSprites.Push(spriteIndex);
+		}
+	}
+
+	ff::Vector<ff::PointInt> smallerSizes;
+	for (int y = options._minTextureSize.y; y <= textureSize.y; y *= 2)
+	{
+		for (int x = options._minTextureSize.x; x <= textureSize.x; x *= 2)
+		{
+			if (x * y < textureSize.x * textureSize.y)
+			{
+				smallerSizes.Push(ff::PointInt(x, y));
+			}
+		}
+	}
+
+	std::stable_sort(smallerSizes.begin(), smallerSizes.end(), [](ff::PointInt s1, ff::PointInt s2)
+		{
+			return s1.x * s1.y < s2.x * s2.y;
+		});
+
+	for (ff::PointInt size : smallerSizes)
+	{
+		ff::Vector<PackBin> lastBins;
+		ff::Vector<size_t> lastSpriteBins = attempt._spriteBins;
+		ff::Vector<ff::PointInt> lastSpritePositions = attempt._spritePositions;
+
+		if (::PlaceSprites(lastSprites, sizes, size + padding, heuristic, 1, lastBins, lastSpriteBins, lastSpritePositions))
+		{
+			for (size_t spriteIndex : lastSprites)
+			{
+				attempt._spritePositions[spriteIndex] = lastSpritePositions[spriteIndex];
+			}
+
+			attempt._binSizes.GetLast() = size;
+			break;
+		}
+	}
+
+	for (ff::PointInt size : attempt._binSizes)
+	{
+		attempt._binArea += (INT64)size.x * size.y;
+	}
+
+	attempt._valid = true;
+	return attempt;
+}
+
+ff::SpritePackOptions::SpritePackOptions()
+	: _minTextureSize(128, 128)
+	, _maxTextureSize(1024, 1024)
+	, _padding(1)
+	, _alignment(1)
+{
+}
+
+bool ff::PackSprites(const PointInt* spriteSizes, size_t spriteCount, const SpritePackOptions& options, SpritePackResult& result)
+{
+	assertRetVal(options._alignment > 0 && options._padding >= 0, false);
+	assertRetVal(options._minTextureSize.x > 0 && options._minTextureSize.y > 0, false);
+	assertRetVal(options._minTextureSize.x <= options._maxTextureSize.x && options._minTextureSize.y <= options._maxTextureSize.y, false);
+
+	result._textureSizes.Clear();
+	result._spriteTextures.Resize(spriteCount);
+	result._spritePositions.Resize(spriteCount);
+
+	// Oversized sprites get their own textures, everything else is packed.
+	// Bins are the max texture size plus padding, so sprites that only get too big after padding and alignment are oversized too.
+
+	ff::Vector<size_t> packIndexes;
+	ff::Vector<ff::PointInt> packSizes;
+	ff::Vector<size_t> oversizedIndexes;
+	ff::PointInt maxPackSize = options._maxTextureSize + ff::PointInt(options._padding, options._padding);
+
+	for (size_t i = 0; i < spriteCount; i++)
+	{
+		ff::PointInt size = spriteSizes[i];
+		assertRetVal(size.x > 0 && size.y > 0, false);
+
+		ff::PointInt packSize = ::AlignSize(size + ff::PointInt(options._padding, options._padding), options._alignment);
+		if (packSize.x > maxPackSize.x || packSize.y > maxPackSize.y)
+		{
+			oversizedIndexes.Push(i);
+		}
+		else
+		{
+			packIndexes.Push(i);
+			packSizes.Push(packSize);
+		}
+	}
+
+	if (packIndexes.Size())
+	{
+		struct Candidate
+		{
+			ff::PointInt _textureSize;
+			PackHeuristic _heuristic;
+			PackOrder _order;
+		};
+
+		ff::Vector<Candidate> candidates;
+		for (ff::PointInt size = options._minTextureSize; ; size = ff::PointInt(
+			std::min(size.x * 2, options._maxTextureSize.x),
+			std::min(size.y * 2, options._maxTextureSize.y)))
+		{
+			for (int heuristic = 0; heuristic < (int)PackHeuristic::Count; heuristic++)
+			{
+				for (int order = 0; order < (int)PackOrder::Count; order++)
+				{
+					candidates.Push(Candidate{ size, (PackHeuristic)heuristic, (PackOrder)order });
+				}
+			}
+
+			if (size == options._maxTextureSize)
+			{
+				break;
+			}
+		}
+
+		ff::Vector<PackAttempt> attempts;
+		attempts.Resize(candidates.Size());
+
+		ff::ParallelFor(candidates.Size(), [&candidates, &attempts, &packSizes, &options](size_t i)
+			{
+				const Candidate& candidate = candidates[i];
+				attempts[i] = ::PackAllSprites(packSizes, options, candidate._textureSize, candidate._heuristic, candidate._order);
+			});
+
+		// Keep the first best attempt so that the result doesn't depend on thread timing
+		size_t best = 0;
+		for (size_t i = 1; i < attempts.Size(); i++)
+		{
+			if (attempts[i].IsBetterThan(attempts[best]))
+			{
+				best = i;
+			}
+		}
+
+		const PackAttempt& attempt = attempts[best];
+		assertRetVal(attempt._valid, false);
+
+		result._textureSizes = attempt._binSizes;
+
+		for (size_t i = 0; i < packIndexes.Size(); i++)
+		{
+			result._spriteTextures[packIndexes[i]] = attempt._spriteBins[i];
+			result._spritePositions[packIndexes[i]] = attempt._spritePositions[i];
+		}
+	}
+
+	for (size_t i : oversizedIndexes)
+	{
+		// texture sizes should be powers of 2 to support compression and mipmaps
+		ff::PointInt size = spriteSizes[i];
+		size.x = (int)ff::NearestPowerOfTwo((size_t)size.x);
+		size.y = (int)ff::NearestPowerOfTwo((size_t)size.y);
+
+		result._spriteTextures[i] = result._textureSizes.Size();
+		result._spritePositions[i] = ff::PointInt::Zeros();
+		result._textureSizes.Push(size);
+	}
+
+	return true;
+}
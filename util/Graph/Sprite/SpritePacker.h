@@ -0,0 +1,25 @@
+#pragma once
+
+namespace ff
+{
+	struct SpritePackOptions
+	{
+		UTIL_API SpritePackOptions();
+
+		PointInt _minTextureSize;
+		PointInt _maxTextureSize; // larger sprites get their own texture
+		int _padding; // empty pixels between sprites
+		int _alignment; // sprite positions are a multiple of this, use 4 for block compressed textures
+	};
+
+	struct SpritePackResult
+	{
+		Vector<PointInt> _textureSizes;
+		Vector<size_t> _spriteTextures; // texture index for each sprite
+		Vector<PointInt> _spritePositions; // top-left corner of each sprite in its texture
+	};
+
+	// Packs sprites into as few power of two textures as possible. Several texture sizes and
+	// placement heuristics are tried in parallel and the best packing is returned.
+	UTIL_API bool PackSprites(const PointInt* spriteSizes, size_t spriteCount, const SpritePackOptions& options, SpritePackResult& result);
+}
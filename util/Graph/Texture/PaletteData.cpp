@@ -6,6 +6,7 @@
 #include "Graph/Texture/Palette.h"
 #include "Graph/Texture/PaletteData.h"
 #include "Graph/Texture/Texture.h"
+#include "Graph/Texture/TextureCompress.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
 #include "Value/Values.h"
@@ -188,7 +189,7 @@ ff::hash_t PaletteData::GetRemapHash() const
 bool PaletteData::LoadFromSource(const ff::Dict& dict)
 {
 	ff::String path = dict.Get<ff::StringValue>(PROP_FILE);
-	DirectX::ScratchImage scratch = ff::LoadTextureData(path, DXGI_FORMAT_R8G8B8A8_UNORM, 1, nullptr);
+	DirectX::ScratchImage scratch = ff::LoadTextureData(path, DXGI_FORMAT_R8G8B8A8_UNORM, 1, nullptr, ff::TextureCompression::Default, false);
 	assertRetVal(scratch.GetImageCount(), false);
 
 	ff::Dict remaps = dict.Get<ff::DictValue>(::PROP_REMAPS);
@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "Graph/Texture/PaletteData.h"
+#include "Graph/Texture/PaletteImage.h"
+
+#ifdef _XM_SSE_INTRINSICS_
+#include <intrin.h>
+
+// SSE2 is always available, these are checked once at runtime
+
+static bool HasSsse3()
+{
+	static const bool s_hasSsse3 = []()
+	{
+		int info[4];
+		::__cpuid(info, 1);
+		return (info[2] & (1 << 9)) != 0;
+	}();
+
+	return s_hasSsse3;
+}
+
+static bool HasAvx2()
+{
+	static const bool s_hasAvx2 = []()
+	{
+		int info[4];
+		::__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// The OS must save the YMM registers too
+		::__cpuid(info, 1);
+		bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (::_xgetbv(0) & 6) == 6;
+
+		::__cpuidex(info, 7, 0);
+		return osAvx && (info[1] & (1 << 5)) != 0;
+	}();
+
+	return s_hasAvx2;
+}
+
+// The 256 byte table is split into 16 shuffle tables, the high nibble of each index picks the table
+static size_t RemapPaletteRowSsse3(const BYTE* source, BYTE* dest, size_t count, const BYTE* remap)
+{
+	__m128i tables[16];
+	for (size_t i = 0; i < 16; i++)
+	{
+		tables[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(remap + i * 16));
+	}
+
+	const __m128i lowMask = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i indexes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		__m128i low = _mm_and_si128(indexes, lowMask);
+		__m128i high = _mm_and_si128(_mm_srli_epi16(indexes, 4), lowMask);
+		__m128i result = _mm_setzero_si128();
+
+		for (int h = 0; h < 16; h++)
+		{
+			__m128i match = _mm_cmpeq_epi8(high, _mm_set1_epi8((char)h));
+			result = _mm_or_si128(result, _mm_and_si128(match, _mm_shuffle_epi8(tables[h], low)));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), result);
+	}
+
+	return i;
+}
+
+static size_t PaletteRowToColorsAvx2(const BYTE* source, DWORD* dest, size_t count, const DWORD* colors)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i)));
+		__m256i result = _mm256_i32gather_epi32(reinterpret_cast<const int*>(colors), indexes, 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+	}
+
+	_mm256_zeroupper();
+	return i;
+}
+
+static size_t ColorRowToAlphaSse2(const DWORD* source, BYTE* dest, size_t count)
+{
+	const __m128i* cur = reinterpret_cast<const __m128i*>(source);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16, cur += 4)
+	{
+		__m128i a0 = _mm_srli_epi32(_mm_loadu_si128(cur + 0), 24);
+		__m128i a1 = _mm_srli_epi32(_mm_loadu_si128(cur + 1), 24);
+		__m128i a2 = _mm_srli_epi32(_mm_loadu_si128(cur + 2), 24);
+		__m128i a3 = _mm_srli_epi32(_mm_loadu_si128(cur + 3), 24);
+
+		__m128i result = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), result);
+	}
+
+	return i;
+}
+
+static __m128i LoadMaskColumn(const BYTE* above, const BYTE* row, const BYTE* below)
+{
+	return _mm_or_si128(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(above)),
+		_mm_or_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(row)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(below))));
+}
+
+static size_t DilateAlphaRowSse2(const BYTE* above, const BYTE* row, const BYTE* below, BYTE* dest, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8((char)0xFF);
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i any = _mm_or_si128(
+			::LoadMaskColumn(above + i - 1, row + i - 1, below + i - 1),
+			_mm_or_si128(
+				::LoadMaskColumn(above + i, row + i, below + i),
+				::LoadMaskColumn(above + i + 1, row + i + 1, below + i + 1)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_xor_si128(_mm_cmpeq_epi8(any, zero), ones));
+	}
+
+	return i;
+}
+#endif
+
+void ff::RemapPaletteRow(const BYTE* source, BYTE* dest, size_t count, const BYTE* remap)
+{
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	if (::HasSsse3())
+	{
+		i = ::RemapPaletteRowSsse3(source, dest, count, remap);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = remap[source[i]];
+	}
+}
+
+void ff::PaletteRowToColors(const BYTE* source, DWORD* dest, size_t count, const DWORD* colors)
+{
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	if (::HasAvx2())
+	{
+		i = ::PaletteRowToColorsAvx2(source, dest, count, colors);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = colors[source[i]];
+	}
+}
+
+void ff::ColorRowToAlpha(const DWORD* source, BYTE* dest, size_t count)
+{
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	i = ::ColorRowToAlphaSse2(source, dest, count);
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = (BYTE)(source[i] >> 24);
+	}
+}
+
+void ff::DilateAlphaRow(const BYTE* above, const BYTE* row, const BYTE* below, BYTE* dest, size_t count)
+{
+	size_t i = 0;
+#ifdef _XM_SSE_INTRINSICS_
+	i = ::DilateAlphaRowSse2(above, row, below, dest, count);
+#endif
+
+	for (; i < count; i++)
+	{
+		bool any =
+			above[i - 1] || above[i] || above[i + 1] ||
+			row[i - 1] || row[i] || row[i + 1] ||
+			below[i - 1] || below[i] || below[i + 1];
+
+		dest[i] = any ? 0xFF : 0;
+	}
+}
+
+bool ff::RemapPaletteImage(const DirectX::Image& image, const BYTE* remap)
+{
+	assertRetVal(image.format == DXGI_FORMAT_R8_UINT && remap, false);
+
+	for (size_t y = 0; y < image.height; y++)
+	{
+		BYTE* row = image.pixels + y * image.rowPitch;
+		ff::RemapPaletteRow(row, row, image.width, remap);
+	}
+
+	return true;
+}
+
+DirectX::ScratchImage ff::PaletteImageToColors(const DirectX::Image& image, const DirectX::Image& palette, size_t paletteRow)
+{
+	DirectX::ScratchImage scratch;
+	assertRetVal(image.format == DXGI_FORMAT_R8_UINT, scratch);
+	assertRetVal(palette.format == DXGI_FORMAT_R8G8B8A8_UNORM && palette.width == ff::PALETTE_SIZE && paletteRow < palette.height, scratch);
+	assertHrRetVal(scratch.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, image.width, image.height, 1, 1), DirectX::ScratchImage());
+
+	const DWORD* colors = reinterpret_cast<const DWORD*>(palette.pixels + paletteRow * palette.rowPitch);
+	const DirectX::Image& dest = *scratch.GetImages();
+
+	for (size_t y = 0; y < image.height; y++)
+	{
+		ff::PaletteRowToColors(
+			image.pixels + y * image.rowPitch,
+			reinterpret_cast<DWORD*>(dest.pixels + y * dest.rowPitch),
+			image.width,
+			colors);
+	}
+
+	return scratch;
+}
+
+DirectX::ScratchImage ff::CreateOutlineImage(const DirectX::Image& image, const ff::RectInt& rect)
+{
+	DirectX::ScratchImage scratch;
+	DXGI_FORMAT format = (image.format == DXGI_FORMAT_R8_UINT) ? DXGI_FORMAT_R8_UINT : DXGI_FORMAT_R8G8B8A8_UNORM;
+	assertHrRetVal(scratch.Initialize2D(format, (size_t)rect.Width() + 2, (size_t)rect.Height() + 2, 1, 1), scratch);
+	assertRetVal(ff::CreateOutlineImage(image, rect, *scratch.GetImages(), ff::PointInt::Zeros()), DirectX::ScratchImage());
+
+	return scratch;
+}
+
+bool ff::CreateOutlineImage(const DirectX::Image& image, const ff::RectInt& rect, const DirectX::Image& outline, ff::PointInt outlinePos)
+{
+	bool usePalette = (image.format == DXGI_FORMAT_R8_UINT);
+	assertRetVal(usePalette || image.format == DXGI_FORMAT_R8G8B8A8_UNORM || image.format == DXGI_FORMAT_B8G8R8A8_UNORM, false);
+	assertRetVal(usePalette == (outline.format == DXGI_FORMAT_R8_UINT) && (usePalette || DirectX::BitsPerPixel(outline.format) == 32), false);
+	assertRetVal(rect.IsInside(ff::RectInt(0, 0, (int)image.width, (int)image.height)), false);
+	assertRetVal(ff::RectInt(outlinePos, outlinePos + rect.Size() + ff::PointInt(2, 2)).IsInside(ff::RectInt(0, 0, (int)outline.width, (int)outline.height)), false);
+
+	const size_t pixelSize = usePalette ? 1 : 4;
+	const size_t width = (size_t)rect.Width();
+	const size_t height = (size_t)rect.Height();
+
+	// The mask has a two pixel border of zeros, so that every outline pixel can read all of its neighbors
+	const size_t maskPitch = width + 4;
+	ff::Vector<BYTE> mask;
+	mask.Resize(maskPitch * (height + 4));
+	std::memset(mask.Data(), 0, mask.ByteSize());
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* source = image.pixels + (rect.top + y) * image.rowPitch + rect.left * pixelSize;
+		BYTE* dest = mask.Data() + (y + 2) * maskPitch + 2;
+
+		if (usePalette)
+		{
+			std::memcpy(dest, source, width);
+		}
+		else
+		{
+			ff::ColorRowToAlpha(reinterpret_cast<const DWORD*>(source), dest, width);
+		}
+	}
+
+	// The dilated mask is 0 or 0xFF, which is then expanded into the outline color
+
+	BYTE outlineRemap[256] = { 0 };
+	DWORD outlineColors[256] = { 0 };
+	outlineRemap[0xFF] = 1;
+	outlineColors[0xFF] = 0xFFFFFFFF;
+
+	ff::Vector<BYTE> outlineRow;
+	outlineRow.Resize(width + 2);
+
+	for (size_t y = 0; y < height + 2; y++)
+	{
+		const BYTE* above = mask.Data() + y * maskPitch + 1;
+		BYTE* dest = outline.pixels + (outlinePos.y + y) * outline.rowPitch + outlinePos.x * pixelSize;
+
+		ff::DilateAlphaRow(above, above + maskPitch, above + maskPitch * 2, outlineRow.Data(), outlineRow.Size());
+
+		if (usePalette)
+		{
+			ff::RemapPaletteRow(outlineRow.Data(), dest, outlineRow.Size(), outlineRemap);
+		}
+		else
+		{
+			ff::PaletteRowToColors(outlineRow.Data(), reinterpret_cast<DWORD*>(dest), outlineRow.Size(), outlineColors);
+		}
+	}
+
+	return true;
+}
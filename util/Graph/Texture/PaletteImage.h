@@ -0,0 +1,31 @@
+#pragma once
+
+namespace ff
+{
+	// CPU kernels for palette images, each one works on a single row of pixels so callers can split rows across threads.
+	// SIMD versions are used when the CPU supports them, the results are the same either way.
+
+	// dest[i] = remap[source[i]], source and dest can be the same row
+	UTIL_API void RemapPaletteRow(const BYTE* source, BYTE* dest, size_t count, const BYTE* remap);
+
+	// dest[i] = colors[source[i]], colors is a palette row of 256 RGBA colors
+	UTIL_API void PaletteRowToColors(const BYTE* source, DWORD* dest, size_t count, const DWORD* colors);
+
+	// dest[i] = alpha of RGBA source[i]
+	UTIL_API void ColorRowToAlpha(const DWORD* source, BYTE* dest, size_t count);
+
+	// dest[i] = 0xFF when any of the 3x3 mask bytes around i is set, otherwise 0.
+	// Mask rows are read from [-1] to [count], so they need a border on each side.
+	UTIL_API void DilateAlphaRow(const BYTE* above, const BYTE* row, const BYTE* below, BYTE* dest, size_t count);
+
+#ifdef UTIL_DLL
+	// Image versions of the kernels, palette images are R8_UINT and palettes are R8G8B8A8_UNORM rows of 256 colors
+	bool RemapPaletteImage(const DirectX::Image& image, const BYTE* remap);
+	DirectX::ScratchImage PaletteImageToColors(const DirectX::Image& image, const DirectX::Image& palette, size_t paletteRow = 0);
+
+	// The outline is one pixel larger than the rect on each side and it's set wherever the image has alpha within one pixel.
+	// Palette images use index 1 for the outline, color images use white.
+	DirectX::ScratchImage CreateOutlineImage(const DirectX::Image& image, const ff::RectInt& rect);
+	bool CreateOutlineImage(const DirectX::Image& image, const ff::RectInt& rect, const DirectX::Image& outline, ff::PointInt outlinePos);
+#endif
+}
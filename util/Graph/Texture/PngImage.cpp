@@ -3,12 +3,28 @@
 #include "Data/DataWriterReader.h"
 #include "Graph/Texture/PngImage.h"
 
+static bool IsColorFormat32(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
 ff::PngImageReader::PngImageReader(const unsigned char* bytes, size_t size)
 	: _png(nullptr)
 	, _info(nullptr)
 	, _endInfo(nullptr)
 	, _readPos(bytes)
 	, _endPos(bytes + size)
+	, _readHeader(false)
 	, _width(0)
 	, _height(0)
 	, _bitDepth(0)
@@ -32,13 +48,13 @@ ff::PngImageReader::~PngImageReader()
 	::png_destroy_read_struct(&_png, &_info, &_endInfo);
 }
 
-std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::Read(DXGI_FORMAT requestedFormat)
+std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::Read(DXGI_FORMAT requestedFormat, bool premultiply)
 {
 	std::unique_ptr<DirectX::ScratchImage> scratch;
 
 	try
 	{
-		scratch = InternalRead(requestedFormat);
+		scratch = InternalRead(requestedFormat, premultiply);
 		if (!scratch && _errorText.empty())
 		{
 			_errorText = L"Failed to read PNG data";
@@ -81,13 +97,36 @@ ff::StringRef ff::PngImageReader::GetError() const
 	return _errorText;
 }
 
-std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::InternalRead(DXGI_FORMAT requestedFormat)
+std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::InternalRead(DXGI_FORMAT requestedFormat, bool premultiply)
 {
-	if (::png_sig_cmp(_readPos, 0, _endPos - _readPos) != 0)
+	noAssertRetVal(InternalReadHeader(), nullptr);
+
+	DXGI_FORMAT format = InternalSetFormat(requestedFormat);
+	noAssertRetVal(format != DXGI_FORMAT_UNKNOWN, nullptr);
+
+	std::unique_ptr<DirectX::ScratchImage> scratch = std::make_unique<DirectX::ScratchImage>();
+	if (FAILED(scratch->Initialize2D(format, _width, _height, 1, 1)))
 	{
 		return nullptr;
 	}
 
+	InternalReadRows(*scratch->GetImage(0, 0, 0), premultiply);
+
+	return scratch;
+}
+
+bool ff::PngImageReader::InternalReadHeader()
+{
+	if (_readHeader)
+	{
+		return true;
+	}
+
+	if (::png_sig_cmp(_readPos, 0, _endPos - _readPos) != 0)
+	{
+		return false;
+	}
+
 	::png_set_read_fn(_png, this, &PngImageReader::PngReadCallback);
 	::png_set_keep_unknown_chunks(_png, PNG_HANDLE_CHUNK_NEVER, nullptr, 0);
 	::png_read_info(_png, _info);
@@ -104,19 +143,26 @@ std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::InternalRead(DXGI_FOR
 		nullptr,
 		nullptr))
 	{
-		return nullptr;
+		return false;
 	}
 
 	// Palette
 	_hasPalette = ::png_get_PLTE(_png, _info, &_palette, &_paletteSize) != 0;
 	_hasTransPalette = ::png_get_tRNS(_png, _info, &_transPalette, &_transPaletteSize, &_transColor) != 0;
+	_readHeader = true;
 
+	return true;
+}
+
+// Sets up libpng to convert pixels while each row is decoded, returns the format that rows will have
+DXGI_FORMAT ff::PngImageReader::InternalSetFormat(DXGI_FORMAT requestedFormat)
+{
 	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
 	switch (_colorType)
 	{
 	default:
 		_errorText = L"Invalid color type";
-		return nullptr;
+		return DXGI_FORMAT_UNKNOWN;
 
 	case PNG_COLOR_TYPE_GRAY:
 		format = (_bitDepth == 1) ? DXGI_FORMAT_R1_UNORM : DXGI_FORMAT_R8_UNORM;
@@ -170,27 +216,48 @@ std::unique_ptr<DirectX::ScratchImage> ff::PngImageReader::InternalRead(DXGI_FOR
 		break;
 	}
 
-	std::unique_ptr<DirectX::ScratchImage> scratch = std::make_unique<DirectX::ScratchImage>();
-	if (FAILED(scratch->Initialize2D(format, _width, _height, 1, 1)))
+	if (_bitDepth == 16)
 	{
-		return nullptr;
+		::png_set_strip_16(_png);
 	}
 
-	_rows.Resize(_height);
+	// The channel order and color space are chosen while decoding, not by converting the whole image later
+	if (format == DXGI_FORMAT_R8G8B8A8_UNORM && ::IsColorFormat32(requestedFormat))
 	{
-		const DirectX::Image& image = *scratch->GetImage(0, 0, 0);
-		BYTE* imagePixels = image.pixels;
+		if (requestedFormat == DXGI_FORMAT_B8G8R8A8_UNORM || requestedFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
+		{
+			::png_set_bgr(_png);
+		}
+
+		format = requestedFormat;
+	}
 
-		for (unsigned int i = 0; i < _height; i++)
+	return format;
+}
+
+void ff::PngImageReader::InternalReadRows(const DirectX::Image& target, bool premultiply)
+{
+	premultiply = premultiply && ::IsColorFormat32(target.format);
+
+	// Interlaced rows are only complete after the last pass
+	int passes = ::png_set_interlace_handling(_png);
+	::png_read_update_info(_png, _info);
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		BYTE* row = target.pixels;
+		for (unsigned int i = 0; i < _height; i++, row += target.rowPitch)
 		{
-			_rows[i] = &imagePixels[i * image.rowPitch];
+			::png_read_row(_png, row, nullptr);
+
+			if (premultiply && pass == passes - 1)
+			{
+				ff::PremultiplyAlphaRow(row, _width);
+			}
 		}
 	}
 
-	::png_read_image(_png, _rows.Data());
 	::png_read_end(_png, _endInfo);
-
-	return scratch;
 }
 
 void ff::PngImageReader::PngErrorCallback(png_struct* png, const char* text)
@@ -278,7 +345,7 @@ bool ff::PngImageWriter::InternalWrite(const DirectX::Image& image, const Direct
 
 	default:
 		_errorText = L"Unsupported texture format for saving to PNG";
-		break;
+		return false;
 	}
 
 	::png_set_write_fn(_png, this, &PngImageWriter::PngWriteCallback, &PngImageWriter::PngFlushCallback);
@@ -316,6 +383,7 @@ bool ff::PngImageWriter::InternalWrite(const DirectX::Image& image, const Direct
 			if (colorType == PNG_COLOR_TYPE_PALETTE)
 			{
 				trans[i] = src[3];
+				foundTrans |= (src[3] != 0xFF);
 			}
 		}
 
@@ -11,12 +11,15 @@ namespace ff
 		PngImageReader(const unsigned char* bytes, size_t size);
 		~PngImageReader();
 
-		std::unique_ptr<DirectX::ScratchImage> Read(DXGI_FORMAT requestedFormat = DXGI_FORMAT_UNKNOWN);
+		std::unique_ptr<DirectX::ScratchImage> Read(DXGI_FORMAT requestedFormat = DXGI_FORMAT_UNKNOWN, bool premultiply = false);
 		std::unique_ptr<DirectX::ScratchImage> GetPalette() const;
 		ff::StringRef GetError() const;
 
 	private:
-		std::unique_ptr<DirectX::ScratchImage> InternalRead(DXGI_FORMAT requestedFormat);
+		std::unique_ptr<DirectX::ScratchImage> InternalRead(DXGI_FORMAT requestedFormat, bool premultiply);
+		bool InternalReadHeader();
+		DXGI_FORMAT InternalSetFormat(DXGI_FORMAT requestedFormat);
+		void InternalReadRows(const DirectX::Image& target, bool premultiply);
 
 		static void PngErrorCallback(png_struct* png, const char* text);
 		static void PngWarningCallback(png_struct* png, const char* text);
@@ -35,7 +38,7 @@ namespace ff
 		// Reading
 		const unsigned char* _readPos;
 		const unsigned char* _endPos;
-		ff::Vector<BYTE*> _rows;
+		bool _readHeader;
 
 		// Properties
 		unsigned int _width;
@@ -16,6 +16,7 @@ namespace ff
 	class ITextureDxgi;
 	class ITextureView;
 	enum class SpriteType;
+	enum class TextureCompression;
 	enum class TextureFormat;
 
 	class __declspec(uuid("8d9fab28-83b4-4327-8bf1-87b75eb9235e")) __declspec(novtable)
@@ -30,9 +31,12 @@ namespace ff
 		virtual SpriteType GetSpriteType() const = 0;
 		virtual IPalette* GetPalette() const = 0;
 		virtual ComPtr<ITextureView> CreateView(size_t arrayStart, size_t arrayCount, size_t mipStart, size_t mipCount) = 0;
-		virtual ComPtr<ITexture> Convert(TextureFormat format, size_t mips) = 0;
+		virtual ComPtr<ITexture> Convert(TextureFormat format, size_t mips, TextureCompression compression) = 0;
 		virtual void Update(size_t arrayIndex, size_t mipIndex, const ff::RectSize& rect, const void* data, TextureFormat dataFormat, bool updateLocalCache) = 0;
 
+		// Starts reloading an evicted texture on the thread pool, so that rendering it soon won't have to wait as long
+		virtual void Prefetch() = 0;
+
 		virtual ISprite* AsSprite() = 0;
 		virtual ITextureView* AsTextureView() = 0;
 		virtual ITextureDxgi* AsTextureDxgi() = 0;
@@ -50,6 +54,8 @@ namespace ff
 	{
 	public:
 		virtual ID3D11Texture2D* GetTexture2d() = 0;
+		// Views of part of the texture belong to the texture, so that evicting it frees them too
+		virtual ID3D11ShaderResourceView* GetSubView(size_t arrayStart, size_t arrayCount, size_t mipStart, size_t mipCount) = 0;
 	};
 
 	class __declspec(uuid("cfbf8204-6c39-4c20-87c1-2ef7d4eeaa39")) __declspec(novtable)
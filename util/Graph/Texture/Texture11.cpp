@@ -3,6 +3,7 @@
 #include "Data/Data.h"
 #include "Data/DataFile.h"
 #include "Data/DataWriterReader.h"
+#include "Data/SavedData.h"
 #include "Dict/Dict.h"
 #include "Graph/DataBlob.h"
 #include "Graph/DirectXUtil.h"
@@ -16,8 +17,12 @@
 #include "Graph/State/GraphContext11.h"
 #include "Graph/Texture/Palette.h"
 #include "Graph/Texture/PaletteData.h"
+#include "Graph/Texture/PaletteImage.h"
 #include "Graph/Texture/PngImage.h"
 #include "Graph/Texture/Texture.h"
+#include "Graph/Texture/TextureCompress.h"
+#include "Graph/Texture/TextureResidency.h"
+#include "Graph/Texture/TextureUpdateBatch.h"
 #include "Graph/Texture/TextureView.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
@@ -25,6 +30,9 @@
 #include "Thread/ThreadDispatch.h"
 #include "Value/Values.h"
 
+D3D_SRV_DIMENSION GetDefaultDimension(const D3D11_TEXTURE2D_DESC& desc);
+
+static ff::StaticString PROP_COMPRESSION(L"compression");
 static ff::StaticString PROP_DATA(L"data");
 static ff::StaticString PROP_FILE(L"file");
 static ff::StaticString PROP_FORMAT(L"format");
@@ -48,6 +56,8 @@ class __declspec(uuid("67741046-5d2f-4bf6-a955-baa950401935"))
 	, public ff::ISprite
 	, public ff::IAnimation
 	, public ff::IAnimationPlayer
+	, public ff::ITextureResident
+	, public ff::ITextureUpdateTarget
 {
 public:
 	DECLARE_HEADER(Texture11);
@@ -74,8 +84,9 @@ public:
 	virtual ff::SpriteType GetSpriteType() const override;
 	virtual ff::IPalette* GetPalette() const override;
 	virtual ff::ComPtr<ff::ITextureView> CreateView(size_t arrayStart, size_t arrayCount, size_t mipStart, size_t mipCount) override;
-	virtual ff::ComPtr<ff::ITexture> Convert(ff::TextureFormat format, size_t mips) override;
+	virtual ff::ComPtr<ff::ITexture> Convert(ff::TextureFormat format, size_t mips, ff::TextureCompression compression) override;
 	virtual void Update(size_t arrayIndex, size_t mipIndex, const ff::RectSize& rect, const void* data, ff::TextureFormat dataFormat, bool updateLocalCache) override;
+	virtual void Prefetch() override;
 	virtual ff::ISprite* AsSprite() override;
 	virtual ff::ITextureView* AsTextureView() override;
 	virtual ff::ITextureDxgi* AsTextureDxgi() override;
@@ -87,6 +98,7 @@ public:
 
 	// ITexture11
 	virtual ID3D11Texture2D* GetTexture2d() override;
+	virtual ID3D11ShaderResourceView* GetSubView(size_t arrayStart, size_t arrayCount, size_t mipStart, size_t mipCount) override;
 
 	// IResourcePersist
 	virtual bool LoadFromSource(const ff::Dict& dict) override;
@@ -108,6 +120,7 @@ public:
 	virtual float GetFramesPerSecond() const override;
 	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
 	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
 	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
 	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
 
@@ -117,15 +130,49 @@ public:
 	virtual float GetCurrentFrame() const override;
 	virtual ff::IAnimation* GetAnimation() override;
 
+	// ITextureResident
+	virtual size_t GetResidentCpuBytes() const override;
+	virtual size_t GetResidentGpuBytes() const override;
+	virtual bool DropCpuCopy() override;
+	virtual bool Evict() override;
+	virtual bool Reload() override;
+
+	// ITextureUpdateTarget
+	virtual bool GetUpdateImage(size_t subresource, ff::TextureUpdateImage& image) override;
+	virtual void UploadRect(size_t subresource, const ff::RectSize& rect, const BYTE* data, size_t rowPitch) override;
+
 private:
+	struct SubView
+	{
+		size_t _arrayStart;
+		size_t _arrayCount;
+		size_t _mipStart;
+		size_t _mipCount;
+		ff::ComPtr<ID3D11ShaderResourceView> _view;
+	};
+
+	std::shared_ptr<DirectX::ScratchImage> GetScratch();
+	void SetScratch(std::shared_ptr<DirectX::ScratchImage> scratch);
+	bool CreateTexture2d(const DirectX::ScratchImage& scratch);
+	void ReleaseTexture();
+	void TouchResidency();
+	void FlushUpdates();
+
+	ff::Mutex _mutex;
 	ff::ComPtr<ff::IGraphDevice> _device;
 	ff::ComPtr<ID3D11Texture2D> _texture;
 	ff::ComPtr<ID3D11ShaderResourceView> _view;
+	ff::Vector<SubView> _subViews; // for texture views, released along with _texture
 	ff::ComPtr<ff::IPalette> _palette;
+	ff::ComPtr<ff::ISavedData> _source; // original DDS data, so the CPU copy can be freed and reloaded
 	ff::SpriteType _spriteType;
 	std::unique_ptr<ff::SpriteData> _spriteData;
 	std::shared_ptr<DirectX::ScratchImage> _scratch;
 	std::unique_ptr<D3D11_TEXTURE2D_DESC> _desc;
+	std::unique_ptr<ff::TextureUpdateBatch> _updates;
+	DirectX::TexMetadata _metadata; // still valid after _scratch is freed
+	size_t _gpuBytes;
+	size_t _residencyFrame;
 };
 
 BEGIN_INTERFACES(Texture11)
@@ -162,7 +209,7 @@ bool CreateTexture11(ff::IGraphDevice* device, ff::StringRef path, DXGI_FORMAT f
 	assertRetVal(texture, false);
 
 	DirectX::ScratchImage paletteScratch;
-	DirectX::ScratchImage data = ff::LoadTextureData(path, format, mips, &paletteScratch);
+	DirectX::ScratchImage data = ff::LoadTextureData(path, format, mips, &paletteScratch, ff::TextureCompression::Default, false);
 	assertRetVal(data.GetImageCount(), false);
 
 	ff::ComPtr<ff::IPaletteData> paletteData;
@@ -192,6 +239,9 @@ bool CreateTexture11(ff::IGraphDevice* device, const D3D11_TEXTURE2D_DESC& desc,
 
 Texture11::Texture11()
 	: _spriteType(ff::SpriteType::Unknown)
+	, _metadata{}
+	, _gpuBytes(0)
+	, _residencyFrame(0)
 {
 }
 
@@ -199,14 +249,19 @@ Texture11::~Texture11()
 {
 	if (_device)
 	{
+		// Waits for any prefetch reload of this texture to finish
+		_device->GetTextureResidency().Remove(this);
 		_device->RemoveChild(static_cast<ff::ITexture*>(this));
 	}
+
+	ReleaseTexture();
 }
 
 HRESULT Texture11::_Construct(IUnknown* unkOuter)
 {
 	assertRetVal(_device.QueryFrom(unkOuter), E_INVALIDARG);
 	_device->AddChild(static_cast<ff::ITexture*>(this));
+	_device->GetTextureResidency().Add(this);
 
 	return ff::ComBase::_Construct(unkOuter);
 }
@@ -214,7 +269,7 @@ HRESULT Texture11::_Construct(IUnknown* unkOuter)
 bool Texture11::Init(DirectX::ScratchImage&& data, ff::IPaletteData* paletteData)
 {
 	assertRetVal(data.GetImageCount(), false);
-	_scratch = std::make_shared<DirectX::ScratchImage>(std::move(data));
+	SetScratch(std::make_shared<DirectX::ScratchImage>(std::move(data)));
 	_spriteType = ff::GetSpriteTypeForImage(*_scratch);
 
 	if (paletteData && GetDxgiFormat() == DXGI_FORMAT_R8_UINT)
@@ -247,16 +302,16 @@ ff::IGraphDevice* Texture11::GetDevice() const
 
 bool Texture11::Reset()
 {
-	_texture = nullptr;
-	_view = nullptr;
+	ff::LockMutex lock(_mutex);
+	ReleaseTexture();
 	return true;
 }
 
 ff::PointInt Texture11::GetSize() const
 {
-	if (_scratch)
+	if (_metadata.width)
 	{
-		const DirectX::TexMetadata& md = _scratch->GetMetadata();
+		const DirectX::TexMetadata& md = _metadata;
 		return ff::PointSize(md.width, md.height).ToType<int>();
 	}
 
@@ -270,9 +325,9 @@ ff::PointInt Texture11::GetSize() const
 
 size_t Texture11::GetMipCount() const
 {
-	if (_scratch)
+	if (_metadata.width)
 	{
-		const DirectX::TexMetadata& md = _scratch->GetMetadata();
+		const DirectX::TexMetadata& md = _metadata;
 		return md.mipLevels;
 	}
 
@@ -286,9 +341,9 @@ size_t Texture11::GetMipCount() const
 
 size_t Texture11::GetArraySize() const
 {
-	if (_scratch)
+	if (_metadata.width)
 	{
-		const DirectX::TexMetadata& md = _scratch->GetMetadata();
+		const DirectX::TexMetadata& md = _metadata;
 		return md.arraySize;
 	}
 
@@ -302,7 +357,7 @@ size_t Texture11::GetArraySize() const
 
 size_t Texture11::GetSampleCount() const
 {
-	if (_scratch)
+	if (_metadata.width)
 	{
 		return 1;
 	}
@@ -360,9 +415,9 @@ ff::ITexture11* Texture11::AsTexture11()
 
 DXGI_FORMAT Texture11::GetDxgiFormat() const
 {
-	if (_scratch)
+	if (_metadata.width)
 	{
-		const DirectX::TexMetadata& md = _scratch->GetMetadata();
+		const DirectX::TexMetadata& md = _metadata;
 		return md.format;
 	}
 
@@ -379,25 +434,38 @@ ff::ITexture* Texture11::GetTexture()
 	return this;
 }
 
+static size_t ComputeTextureBytes(const D3D11_TEXTURE2D_DESC& desc)
+{
+	size_t bytes = 0;
+
+	for (UINT mip = 0; mip < desc.MipLevels; mip++)
+	{
+		size_t rowPitch, slicePitch;
+		DirectX::ComputePitch(desc.Format, std::max<size_t>(desc.Width >> mip, 1), std::max<size_t>(desc.Height >> mip, 1), rowPitch, slicePitch);
+		bytes += slicePitch;
+	}
+
+	return bytes * desc.ArraySize * desc.SampleDesc.Count;
+}
+
 ID3D11Texture2D* Texture11::GetTexture2d()
 {
+	TouchResidency();
+	ff::LockMutex lock(_mutex);
+
 	if (!_texture)
 	{
-		if (_scratch)
+		std::shared_ptr<DirectX::ScratchImage> scratch = GetScratch();
+
+		if (scratch)
 		{
-			ff::ComPtr<ID3D11Resource> resource;
-			assertHrRetVal(DirectX::CreateTexture(
-				_device->AsGraphDevice11()->Get3d(),
-				_scratch->GetImages(),
-				_scratch->GetImageCount(),
-				_scratch->GetMetadata(),
-				&resource), nullptr);
-
-			assertRetVal(_texture.QueryFrom(resource), nullptr);
+			assertRetVal(CreateTexture2d(*scratch), nullptr);
 		}
 		else if (_desc)
 		{
 			assertHrRetVal(_device->AsGraphDevice11()->Get3d()->CreateTexture2D(_desc.get(), nullptr, &_texture), false);
+			_gpuBytes = ::ComputeTextureBytes(*_desc);
+			ff::TrackMemoryAlloc(ff::MemoryTag::Texture, _gpuBytes);
 		}
 		else
 		{
@@ -405,9 +473,63 @@ ID3D11Texture2D* Texture11::GetTexture2d()
 		}
 	}
 
+	FlushUpdates();
+
 	return _texture;
 }
 
+ID3D11ShaderResourceView* Texture11::GetSubView(size_t arrayStart, size_t arrayCount, size_t mipStart, size_t mipCount)
+{
+	// Waits for an evicted texture to reload, which needs the mutex, so touch before locking
+	TouchResidency();
+	ff::LockMutex lock(_mutex);
+
+	ID3D11Texture2D* texture2d = GetTexture2d();
+	assertRetVal(texture2d, nullptr);
+
+	for (const SubView& subView : _subViews)
+	{
+		if (subView._arrayStart == arrayStart && subView._arrayCount == arrayCount && subView._mipStart == mipStart && subView._mipCount == mipCount)
+		{
+			return subView._view;
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC textureDesc;
+	texture2d->GetDesc(&textureDesc);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	ff::ZeroObject(viewDesc);
+	viewDesc.Format = textureDesc.Format;
+	viewDesc.ViewDimension = ::GetDefaultDimension(textureDesc);
+
+	switch (viewDesc.ViewDimension)
+	{
+	case D3D_SRV_DIMENSION_TEXTURE2DMSARRAY:
+		viewDesc.Texture2DMSArray.FirstArraySlice = (UINT)arrayStart;
+		viewDesc.Texture2DMSArray.ArraySize = (UINT)arrayCount;
+		break;
+
+	case D3D_SRV_DIMENSION_TEXTURE2DARRAY:
+		viewDesc.Texture2DArray.FirstArraySlice = (UINT)arrayStart;
+		viewDesc.Texture2DArray.ArraySize = (UINT)arrayCount;
+		viewDesc.Texture2DArray.MostDetailedMip = (UINT)mipStart;
+		viewDesc.Texture2DArray.MipLevels = (UINT)mipCount;
+		break;
+
+	case D3D_SRV_DIMENSION_TEXTURE2D:
+		viewDesc.Texture2D.MostDetailedMip = (UINT)mipStart;
+		viewDesc.Texture2D.MipLevels = (UINT)mipCount;
+		break;
+	}
+
+	SubView subView{ arrayStart, arrayCount, mipStart, mipCount };
+	assertHrRetVal(_device->AsGraphDevice11()->Get3d()->CreateShaderResourceView(texture2d, &viewDesc, &subView._view), nullptr);
+	_subViews.Push(std::move(subView));
+
+	return _subViews.GetLast()._view;
+}
+
 ff::ITextureView11* Texture11::AsTextureView11()
 {
 	return this;
@@ -415,6 +537,9 @@ ff::ITextureView11* Texture11::AsTextureView11()
 
 ID3D11ShaderResourceView* Texture11::GetView()
 {
+	TouchResidency();
+	FlushUpdates();
+
 	if (!_view)
 	{
 		_view = ff::CreateDefaultTextureView(_device->AsGraphDevice11()->Get3d(), GetTexture2d());
@@ -423,7 +548,7 @@ ID3D11ShaderResourceView* Texture11::GetView()
 	return _view;
 }
 
-ff::ComPtr<ff::ITexture> Texture11::Convert(ff::TextureFormat format, size_t mips)
+ff::ComPtr<ff::ITexture> Texture11::Convert(ff::TextureFormat format, size_t mips, ff::TextureCompression compression)
 {
 	DXGI_FORMAT dxgiFormat = ff::ConvertTextureFormat(format);
 	if (GetDxgiFormat() == dxgiFormat && mips && GetMipCount() >= mips)
@@ -432,7 +557,7 @@ ff::ComPtr<ff::ITexture> Texture11::Convert(ff::TextureFormat format, size_t mip
 	}
 
 	std::shared_ptr<DirectX::ScratchImage> scratch = Capture();
-	DirectX::ScratchImage data = ff::ConvertTextureData(*scratch, dxgiFormat, mips);
+	DirectX::ScratchImage data = ff::ConvertTextureData(*scratch, dxgiFormat, mips, compression);
 	return _device->AsGraphDeviceInternal()->CreateTexture(std::move(data), nullptr);
 }
 
@@ -443,10 +568,33 @@ void Texture11::Update(size_t arrayIndex, size_t mipIndex, const ff::RectSize& r
 	size_t rowPitch, slicePitch;
 	DirectX::ComputePitch(GetDxgiFormat(), rect.Width(), rect.Height(), rowPitch, slicePitch);
 
-	if (updateLocalCache || !_texture)
+	// Only textures without a CPU copy need to be read back, and only once
+	std::shared_ptr<DirectX::ScratchImage> scratch = GetScratch();
+	if (!scratch && (updateLocalCache || !_texture))
+	{
+		scratch = Capture();
+	}
+
+	ff::LockMutex lock(_mutex);
+	UINT subResource = ::D3D11CalcSubresource((UINT)mipIndex, (UINT)arrayIndex, (UINT)GetMipCount());
+
+	// The texture won't match its original data anymore
+	_source = nullptr;
+
+	if (scratch && !DirectX::IsCompressed(GetDxgiFormat()))
 	{
-		std::shared_ptr<DirectX::ScratchImage> scratch = Capture();
+		if (!_updates)
+		{
+			_updates = std::make_unique<ff::TextureUpdateBatch>(DirectX::BitsPerPixel(GetDxgiFormat()) / 8);
+		}
 
+		// The GPU copy is updated by FlushUpdates before the texture is used
+		verify(_updates->Update(*this, subResource, rect, data, rowPitch));
+		return;
+	}
+
+	if (scratch)
+	{
 		DirectX::Image image{};
 		image.width = rect.Width();
 		image.height = rect.Height();
@@ -460,25 +608,38 @@ void Texture11::Update(size_t arrayIndex, size_t mipIndex, const ff::RectSize& r
 	if (_texture)
 	{
 		CD3D11_BOX box((UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1);
-		UINT subResource = ::D3D11CalcSubresource((UINT)mipIndex, (UINT)arrayIndex, (UINT)GetMipCount());
 		_device->AsGraphDevice11()->GetStateContext().UpdateSubresource(_texture, subResource, &box, data, (UINT)rowPitch, 0);
 	}
 }
 
+void Texture11::Prefetch()
+{
+	_device->GetTextureResidency().Prefetch(this);
+}
+
 std::shared_ptr<DirectX::ScratchImage> Texture11::Capture(bool useLocalCache)
 {
-	if (!_scratch || !useLocalCache)
+	std::shared_ptr<DirectX::ScratchImage> localScratch = useLocalCache ? GetScratch() : nullptr;
+
+	if (!localScratch)
 	{
 		DirectX::ScratchImage scratch;
 		HRESULT hr = E_FAIL;
 
-		if (_texture)
+		ff::ComPtr<ID3D11Texture2D> texture;
+		{
+			ff::LockMutex lock(_mutex);
+			texture = _texture;
+		}
+
+		if (texture)
 		{
 			// Can't use the device context on background threads
-			ff::GetGameThreadDispatch()->Send([this, &scratch, &hr]()
+			ff::GetGameThreadDispatch()->Send([this, &texture, &scratch, &hr]()
 				{
+					FlushUpdates();
 					ff::IGraphDevice11* device = _device->AsGraphDevice11();
-					hr = DirectX::CaptureTexture(device->Get3d(), device->GetContext(), _texture, scratch);
+					hr = DirectX::CaptureTexture(device->Get3d(), device->GetContext(), texture, scratch);
 				});
 		}
 
@@ -489,10 +650,11 @@ std::shared_ptr<DirectX::ScratchImage> Texture11::Capture(bool useLocalCache)
 			std::memset(scratch.GetPixels(), 0, scratch.GetPixelsSize());
 		}
 
-		_scratch = std::make_shared<DirectX::ScratchImage>(std::move(scratch));
+		localScratch = std::make_shared<DirectX::ScratchImage>(std::move(scratch));
+		SetScratch(localScratch);
 	}
 
-	return _scratch;
+	return localScratch;
 }
 
 bool Texture11::LoadFromSource(const ff::Dict& dict)
@@ -500,22 +662,14 @@ bool Texture11::LoadFromSource(const ff::Dict& dict)
 	size_t mipsProp = dict.Get<ff::SizeValue>(PROP_MIPS, 1);
 	ff::String fullFile = dict.Get<ff::StringValue>(PROP_FILE);
 	DXGI_FORMAT format = ff::ParseDxgiTextureFormat(dict.Get<ff::StringValue>(PROP_FORMAT, ff::String(L"rgba32")));
+	ff::TextureCompression compression = ff::ParseTextureCompression(dict.Get<ff::StringValue>(PROP_COMPRESSION));
 	assertRetVal(format != DXGI_FORMAT_UNKNOWN, false);
 
-	DirectX::ScratchImage paletteScratch;
-	DirectX::ScratchImage data = ff::LoadTextureData(fullFile, format, mipsProp, &paletteScratch);
-
+	// Alpha is premultiplied while decoding, before mips are generated or blocks are compressed
 	bool pma = dict.Get<ff::BoolValue>(PROP_PMA);
-	for (size_t i = 0; pma && i < data.GetImageCount(); i++)
-	{
-		const DirectX::Image& image = data.GetImages()[i];
-		DirectX::ScratchImage scratch;
-		if (SUCCEEDED(DirectX::PremultiplyAlpha(image, DirectX::TEX_PMALPHA_DEFAULT, scratch)))
-		{
-			const DirectX::Image& pmaImage = *scratch.GetImages();
-			verifyHr(DirectX::CopyRectangle(pmaImage, DirectX::Rect(0, 0, image.width, image.height), image, DirectX::TEX_FILTER_DEFAULT, 0, 0));
-		}
-	}
+	DirectX::ScratchImage paletteScratch;
+	DirectX::ScratchImage data = ff::LoadTextureData(fullFile, format, mipsProp, &paletteScratch, compression, pma);
+	assertRetVal(data.GetImageCount(), false);
 
 	ff::ComPtr<ff::IPaletteData> paletteData;
 	if (paletteScratch.GetImageCount())
@@ -528,6 +682,19 @@ bool Texture11::LoadFromSource(const ff::Dict& dict)
 	return true;
 }
 
+static bool LoadScratchFromSource(ff::ISavedData* source, DirectX::ScratchImage& scratch)
+{
+	// Loading a clone leaves the source in its saved state, which may not use any memory
+	ff::ComPtr<ff::ISavedData> sourceClone;
+	assertRetVal(source->Clone(&sourceClone), false);
+
+	ff::IData* data = sourceClone->Load();
+	assertRetVal(data, false);
+	assertHrRetVal(DirectX::LoadFromDDSMemory(data->GetMem(), data->GetSize(), DirectX::DDS_FLAGS_NONE, nullptr, scratch), false);
+
+	return true;
+}
+
 bool Texture11::LoadFromCache(const ff::Dict& dict)
 {
 	_spriteType = (ff::SpriteType)dict.Get<ff::IntValue>(PROP_SPRITE_TYPE);
@@ -538,10 +705,13 @@ bool Texture11::LoadFromCache(const ff::Dict& dict)
 		_palette = paletteData->CreatePalette();
 	}
 
-	ff::ComPtr<ff::IData> data = dict.Get<ff::DataValue>(PROP_DATA);
+	// The saved data stays around, so the texture can be evicted and reloaded later
+	_source = dict.Get<ff::SavedDataValue>(PROP_DATA);
+	assertRetVal(_source, false);
+
 	DirectX::ScratchImage scratch;
-	assertHrRetVal(DirectX::LoadFromDDSMemory(data->GetMem(), data->GetSize(), DirectX::DDS_FLAGS_NONE, nullptr, scratch), false);
-	_scratch = std::make_shared<DirectX::ScratchImage>(std::move(scratch));
+	assertRetVal(::LoadScratchFromSource(_source, scratch), false);
+	SetScratch(std::make_shared<DirectX::ScratchImage>(std::move(scratch)));
 
 	return true;
 }
@@ -570,6 +740,17 @@ ff::String Texture11::GetFileExtension() const
 	return ff::String::from_static(L".png");
 }
 
+static bool SavePngFile(ff::StringRef file, const DirectX::Image& image, const DirectX::Image* paletteImage)
+{
+	ff::ComPtr<ff::IDataFile> dataFile;
+	ff::ComPtr<ff::IDataWriter> writer;
+	assertRetVal(ff::CreateDataFile(file, false, &dataFile), false);
+	assertRetVal(ff::CreateDataWriter(dataFile, 0, &writer), false);
+
+	ff::PngImageWriter png(writer);
+	return png.Write(image, paletteImage);
+}
+
 bool Texture11::SaveToFile(ff::StringRef file)
 {
 	std::shared_ptr<DirectX::ScratchImage> scratch = Capture();
@@ -577,21 +758,28 @@ bool Texture11::SaveToFile(ff::StringRef file)
 
 	if (scratch->GetMetadata().format != DXGI_FORMAT_R8_UINT)
 	{
-		*scratch = ff::ConvertTextureData(*scratch, DXGI_FORMAT_R8G8B8A8_UNORM, GetMipCount());
+		*scratch = ff::ConvertTextureData(*scratch, DXGI_FORMAT_R8G8B8A8_UNORM, GetMipCount(), ff::TextureCompression::Default);
 	}
 
 	for (size_t i = 0; i < scratch->GetImageCount(); i++)
 	{
+		const DirectX::Image& image = scratch->GetImages()[i];
+		const DirectX::Image* paletteImage = paletteScratch ? paletteScratch->GetImages() : nullptr;
+
 		ff::String file2 = file;
 		ff::ChangePathExtension(file2, ff::String::format_new(L".%lu.png", i));
+		assertRetVal(::SavePngFile(file2, image, paletteImage), false);
 
-		ff::ComPtr<ff::IDataFile> dataFile;
-		ff::ComPtr<ff::IDataWriter> writer;
-		assertRetVal(ff::CreateDataFile(file2, false, &dataFile), false);
-		assertRetVal(ff::CreateDataWriter(dataFile, 0, &writer), false);
+		// Palette indexes are saved as they are, plus a full color copy that's easier to look at
+		if (paletteImage && image.format == DXGI_FORMAT_R8_UINT)
+		{
+			DirectX::ScratchImage colorScratch = ff::PaletteImageToColors(image, *paletteImage);
+			assertRetVal(colorScratch.GetImageCount(), false);
 
-		ff::PngImageWriter png(writer);
-		png.Write(scratch->GetImages()[i], paletteScratch ? paletteScratch->GetImages() : nullptr);
+			ff::String colorFile = file;
+			ff::ChangePathExtension(colorFile, ff::String::format_new(L".%lu.color.png", i));
+			assertRetVal(::SavePngFile(colorFile, *colorScratch.GetImages(), nullptr), false);
+		}
 	}
 
 	return true;
@@ -643,6 +831,11 @@ void Texture11::RenderFrame(ff::IRendererActive* render, const ff::Transform& po
 	render->DrawSprite(this, position);
 }
 
+void Texture11::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	ff::DrawSpriteFrames(render, this, positions, count);
+}
+
 ff::ValuePtr Texture11::GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params)
 {
 	return nullptr;
@@ -671,3 +864,157 @@ ff::IAnimation* Texture11::GetAnimation()
 {
 	return this;
 }
+
+size_t Texture11::GetResidentCpuBytes() const
+{
+	ff::LockMutex lock(_mutex);
+	return _scratch ? _scratch->GetPixelsSize() : 0;
+}
+
+size_t Texture11::GetResidentGpuBytes() const
+{
+	ff::LockMutex lock(_mutex);
+	return _texture ? _gpuBytes : 0;
+}
+
+bool Texture11::DropCpuCopy()
+{
+	ff::LockMutex lock(_mutex);
+	noAssertRetVal(_scratch && _source, false);
+
+	_scratch = nullptr;
+	return true;
+}
+
+bool Texture11::Evict()
+{
+	ff::LockMutex lock(_mutex);
+
+	// Render targets can't be recreated, and neither can textures that only exist on the GPU
+	noAssertRetVal(!_desc && (_scratch || _source), false);
+	noAssertRetVal(_texture || (_scratch && _source), false);
+
+	ReleaseTexture();
+
+	if (_source)
+	{
+		_scratch = nullptr;
+	}
+
+	return true;
+}
+
+bool Texture11::Reload()
+{
+	std::shared_ptr<DirectX::ScratchImage> scratch = GetScratch();
+	assertRetVal(scratch, false);
+
+	// Direct3D 11 devices can create textures on any thread
+	ff::LockMutex lock(_mutex);
+	return _texture || CreateTexture2d(*scratch);
+}
+
+std::shared_ptr<DirectX::ScratchImage> Texture11::GetScratch()
+{
+	ff::LockMutex lock(_mutex);
+
+	if (!_scratch && _source)
+	{
+		DirectX::ScratchImage scratch;
+		if (::LoadScratchFromSource(_source, scratch))
+		{
+			SetScratch(std::make_shared<DirectX::ScratchImage>(std::move(scratch)));
+		}
+	}
+
+	return _scratch;
+}
+
+void Texture11::SetScratch(std::shared_ptr<DirectX::ScratchImage> scratch)
+{
+	ff::LockMutex lock(_mutex);
+	_scratch = scratch;
+	_metadata = scratch->GetMetadata();
+}
+
+bool Texture11::CreateTexture2d(const DirectX::ScratchImage& scratch)
+{
+	ff::ComPtr<ID3D11Resource> resource;
+	assertHrRetVal(DirectX::CreateTexture(
+		_device->AsGraphDevice11()->Get3d(),
+		scratch.GetImages(),
+		scratch.GetImageCount(),
+		scratch.GetMetadata(),
+		&resource), false);
+
+	assertRetVal(_texture.QueryFrom(resource), false);
+	_gpuBytes = scratch.GetPixelsSize();
+	ff::TrackMemoryAlloc(ff::MemoryTag::Texture, _gpuBytes);
+
+	if (_updates)
+	{
+		// The new texture already has every update
+		_updates->Clear();
+	}
+
+	return true;
+}
+
+void Texture11::ReleaseTexture()
+{
+	if (_texture)
+	{
+		ff::TrackMemoryFree(ff::MemoryTag::Texture, _gpuBytes);
+		_texture = nullptr;
+	}
+
+	_view = nullptr;
+	_subViews.Clear();
+}
+
+void Texture11::TouchResidency()
+{
+	// Only the first use in each frame needs to tell the residency manager
+	ff::TextureResidency& residency = _device->GetTextureResidency();
+	size_t frame = residency.GetFrame();
+
+	if (_residencyFrame != frame)
+	{
+		_residencyFrame = frame;
+		residency.Touch(this);
+	}
+}
+
+bool Texture11::GetUpdateImage(size_t subresource, ff::TextureUpdateImage& image)
+{
+	ff::LockMutex lock(_mutex);
+	noAssertRetVal(_scratch, false);
+
+	size_t mipCount = _metadata.mipLevels;
+	const DirectX::Image* source = _scratch->GetImage(subresource % mipCount, subresource / mipCount, 0);
+	assertRetVal(source, false);
+
+	image._pixels = source->pixels;
+	image._rowPitch = source->rowPitch;
+	image._size = ff::PointSize(source->width, source->height);
+
+	return true;
+}
+
+void Texture11::UploadRect(size_t subresource, const ff::RectSize& rect, const BYTE* data, size_t rowPitch)
+{
+	assert(_texture);
+
+	CD3D11_BOX box((UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1);
+	_device->AsGraphDevice11()->GetStateContext().UpdateSubresource(_texture, (UINT)subresource, &box, data, (UINT)rowPitch, 0);
+}
+
+void Texture11::FlushUpdates()
+{
+	ff::LockMutex lock(_mutex);
+
+	if (_texture && _updates && _updates->HasUpdates())
+	{
+		_updates->Flush(*this);
+	}
+}
@@ -0,0 +1,280 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/DirectXUtil.h"
+#include "Graph/Texture/TextureCompress.h"
+#include "String/StringUtil.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
+#include "Windows/FileUtil.h"
+
+// Change this when the encoder output changes, so that old cache files are ignored
+static const DWORD TEXTURE_CACHE_VERSION = 1;
+
+// Pixel rows per parallel work item, must be a multiple of the block size
+static const size_t STRIP_HEIGHT = 64;
+
+static std::atomic_bool s_cacheEnabled = false;
+
+typedef decltype(DirectX::TEX_COMPRESS_DEFAULT) CompressFlags;
+
+struct TextureCacheKey
+{
+	ff::hash_t _pixelsHash;
+	size_t _width;
+	size_t _height;
+	size_t _arraySize;
+	size_t _mipLevels;
+	DXGI_FORMAT _sourceFormat;
+	DXGI_FORMAT _format;
+	ff::TextureCompression _compression;
+	DWORD _version;
+};
+
+struct CompressStrip
+{
+	size_t _image;
+	size_t _top;
+	size_t _height;
+};
+
+static CompressFlags GetCompressFlags(ff::TextureCompression compression)
+{
+	switch (compression)
+	{
+	case ff::TextureCompression::Fast:
+		return DirectX::TEX_COMPRESS_BC7_QUICK;
+
+	case ff::TextureCompression::Best:
+		return DirectX::TEX_COMPRESS_BC7_USE_3SUBSETS;
+
+	default:
+		return DirectX::TEX_COMPRESS_DEFAULT;
+	}
+}
+
+static ff::String GetCacheFile(const DirectX::ScratchImage& data, DXGI_FORMAT format, ff::TextureCompression compression)
+{
+	const DirectX::TexMetadata& metadata = data.GetMetadata();
+
+	TextureCacheKey key;
+	std::memset(&key, 0, sizeof(key));
+	key._pixelsHash = ff::HashBytes(data.GetPixels(), data.GetPixelsSize());
+	key._width = metadata.width;
+	key._height = metadata.height;
+	key._arraySize = metadata.arraySize;
+	key._mipLevels = metadata.mipLevels;
+	key._sourceFormat = metadata.format;
+	key._format = format;
+	key._compression = compression;
+	key._version = ::TEXTURE_CACHE_VERSION;
+
+	ff::String path = ff::GetTempDirectory();
+	ff::AppendPathTail(path, ff::String(L"TextureCache"));
+	ff::AppendPathTail(path, ff::String::format_new(L"%016llx.dds", ff::HashFunc(key)));
+
+	return path;
+}
+
+static bool LoadCacheFile(ff::StringRef path, const DirectX::ScratchImage& data, DXGI_FORMAT format, DirectX::ScratchImage& output)
+{
+	noAssertRetVal(ff::FileExists(path), false);
+
+	DirectX::ScratchImage scratch;
+	noAssertRetVal(SUCCEEDED(DirectX::LoadFromDDSFile(path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, scratch)), false);
+
+	const DirectX::TexMetadata& metadata = scratch.GetMetadata();
+	const DirectX::TexMetadata& sourceMetadata = data.GetMetadata();
+	noAssertRetVal(
+		metadata.format == format &&
+		metadata.width == sourceMetadata.width &&
+		metadata.height == sourceMetadata.height &&
+		metadata.arraySize == sourceMetadata.arraySize &&
+		metadata.mipLevels == sourceMetadata.mipLevels, false);
+
+	output = std::move(scratch);
+	return true;
+}
+
+static void SaveCacheFile(ff::StringRef path, const DirectX::ScratchImage& scratch)
+{
+	ff::String dir = path;
+	ff::StripPathTail(dir);
+	noAssertRet(ff::DirectoryExists(dir) || ff::CreateDirectory(dir));
+
+	// Other processes might use the same cache file, so it only appears once it's complete
+	ff::String tempPath = ff::CreateTempFile(ff::String(L"TextureCache"), ff::String(L"dds"));
+	noAssertRet(SUCCEEDED(DirectX::SaveToDDSFile(scratch.GetImages(), scratch.GetImageCount(), scratch.GetMetadata(), DirectX::DDS_FLAGS_NONE, tempPath.c_str())));
+
+	if (!ff::MoveFile(tempPath, path, true))
+	{
+		ff::DeleteFile(tempPath);
+	}
+}
+
+DirectX::ScratchImage ff::CompressTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, TextureCompression compression, bool useCache)
+{
+	assertRetVal(data.GetImageCount() && DirectX::IsCompressed(format) && !DirectX::IsCompressed(data.GetMetadata().format), DirectX::ScratchImage());
+
+	ff::Timer timer;
+	useCache = useCache && s_cacheEnabled;
+	ff::String cacheFile = useCache ? ::GetCacheFile(data, format, compression) : ff::String();
+	DirectX::ScratchImage scratchFinal;
+
+	if (useCache && ::LoadCacheFile(cacheFile, data, format, scratchFinal))
+	{
+		ff::Log::GlobalTraceF(L"CompressTextureData: %lux%lu, %lu images, cached, %.1fms\n",
+			data.GetMetadata().width,
+			data.GetMetadata().height,
+			data.GetImageCount(),
+			timer.Tick() * 1000.0);
+
+		return scratchFinal;
+	}
+
+	DirectX::TexMetadata metadata = data.GetMetadata();
+	metadata.format = format;
+	assertHrRetVal(scratchFinal.Initialize(metadata), DirectX::ScratchImage());
+
+	// Large images are split into strips so that a single atlas can use every thread
+
+	ff::Vector<CompressStrip> strips;
+	for (size_t i = 0; i < data.GetImageCount(); i++)
+	{
+		size_t height = data.GetImages()[i].height;
+		for (size_t top = 0; top < height; top += ::STRIP_HEIGHT)
+		{
+			strips.Push(CompressStrip{ i, top, std::min(::STRIP_HEIGHT, height - top) });
+		}
+	}
+
+	CompressFlags flags = ::GetCompressFlags(compression);
+	std::atomic_bool failed = false;
+
+	ff::ParallelFor(strips.Size(), [&data, &scratchFinal, &strips, &failed, format, flags](size_t i)
+		{
+			const CompressStrip& strip = strips[i];
+			const DirectX::Image& source = data.GetImages()[strip._image];
+			const DirectX::Image& dest = scratchFinal.GetImages()[strip._image];
+
+			DirectX::Image sourceStrip = source;
+			sourceStrip.height = strip._height;
+			sourceStrip.slicePitch = source.rowPitch * strip._height;
+			sourceStrip.pixels = source.pixels + strip._top * source.rowPitch;
+
+			DirectX::ScratchImage destStrip;
+			if (FAILED(DirectX::Compress(sourceStrip, format, flags, 0, destStrip)))
+			{
+				failed = true;
+				return;
+			}
+
+			// Block rows have the same pitch in the strip and in the whole image
+			const DirectX::Image& destStripImage = *destStrip.GetImages();
+			assert(destStripImage.rowPitch == dest.rowPitch);
+			std::memcpy(dest.pixels + (strip._top / 4) * dest.rowPitch, destStripImage.pixels, destStripImage.slicePitch);
+		});
+
+	assertRetVal(!failed, DirectX::ScratchImage());
+
+	if (useCache)
+	{
+		::SaveCacheFile(cacheFile, scratchFinal);
+	}
+
+	ff::Log::GlobalTraceF(L"CompressTextureData: %lux%lu, %lu images in %lu strips, %.1fms\n",
+		data.GetMetadata().width,
+		data.GetMetadata().height,
+		data.GetImageCount(),
+		strips.Size(),
+		timer.Tick() * 1000.0);
+
+	return scratchFinal;
+}
+
+void ff::EnableTextureCompressionCache(bool enable)
+{
+	s_cacheEnabled = enable;
+}
+
+ff::TextureCompression ff::ParseTextureCompression(StringRef text)
+{
+	if (text == L"fast")
+	{
+		return TextureCompression::Fast;
+	}
+	else if (text == L"best")
+	{
+		return TextureCompression::Best;
+	}
+
+	return TextureCompression::Default;
+}
+
+bool ff::MeasureTextureCompression(StringRef path, DXGI_FORMAT format, TextureCompression compression, TextureCompressionReport& report)
+{
+	report = TextureCompressionReport{};
+	assertRetVal(DirectX::IsCompressed(format), false);
+
+	DirectX::ScratchImage source = ff::LoadTextureData(path, DXGI_FORMAT_R8G8B8A8_UNORM, 1, nullptr, compression, false);
+	assertRetVal(source.GetImageCount(), false);
+
+	const DirectX::Image& sourceImage = *source.GetImages();
+	noAssertRetVal(sourceImage.width % 4 == 0 && sourceImage.height % 4 == 0, false);
+
+	ff::Timer timer;
+	DirectX::ScratchImage compressed = ff::CompressTextureData(source, format, compression, false);
+	report._seconds = timer.Tick();
+	assertRetVal(compressed.GetImageCount(), false);
+
+	DirectX::ScratchImage decompressed;
+	assertHrRetVal(DirectX::Decompress(*compressed.GetImages(), DXGI_FORMAT_R8G8B8A8_UNORM, decompressed), false);
+
+	float mse = 0;
+	assertHrRetVal(DirectX::ComputeMSE(sourceImage, *decompressed.GetImages(), mse, nullptr), false);
+
+	// Colors are from 0 to 1, so the peak signal is 1
+	report._imageBytes = sourceImage.slicePitch;
+	report._psnr = (mse > 0) ? -10.0 * std::log10(mse) : 99.0;
+
+	return true;
+}
+
+bool ff::VerifyTextureCompressionStrips(const BYTE* pixels, size_t width, size_t height, size_t mips, DXGI_FORMAT format, TextureCompression compression)
+{
+	assertRetVal(pixels && width && height && DirectX::IsCompressed(format), false);
+
+	DirectX::ScratchImage source;
+	assertHrRetVal(source.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1), false);
+
+	const DirectX::Image& sourceImage = *source.GetImages();
+	for (size_t y = 0; y < height; y++)
+	{
+		std::memcpy(sourceImage.pixels + y * sourceImage.rowPitch, pixels + y * width * 4, width * 4);
+	}
+
+	if (mips != 1)
+	{
+		DirectX::ScratchImage mipSource;
+		assertHrRetVal(DirectX::GenerateMipMaps(sourceImage, DirectX::TEX_FILTER_DEFAULT, mips, mipSource), false);
+		source = std::move(mipSource);
+	}
+
+	DirectX::ScratchImage strips = ff::CompressTextureData(source, format, compression, false);
+	assertRetVal(strips.GetImageCount() == source.GetImageCount(), false);
+
+	DirectX::ScratchImage whole;
+	assertHrRetVal(DirectX::Compress(source.GetImages(), source.GetImageCount(), source.GetMetadata(), format, ::GetCompressFlags(compression), 0, whole), false);
+	assertRetVal(whole.GetImageCount() == strips.GetImageCount(), false);
+
+	for (size_t i = 0; i < whole.GetImageCount(); i++)
+	{
+		const DirectX::Image& stripImage = strips.GetImages()[i];
+		const DirectX::Image& wholeImage = whole.GetImages()[i];
+
+		assertRetVal(stripImage.width == wholeImage.width && stripImage.height == wholeImage.height, false);
+		assertRetVal(stripImage.slicePitch == wholeImage.slicePitch, false);
+		assertRetVal(!std::memcmp(stripImage.pixels, wholeImage.pixels, wholeImage.slicePitch), false);
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+namespace ff
+{
+	// Texture resources choose this with "compression": "fast", "default", or "best".
+	// Only BC7 has encoder modes that trade time for quality, other formats always encode the same way.
+	enum class TextureCompression
+	{
+		Fast,
+		Default,
+		Best,
+	};
+
+	struct TextureCompressionReport
+	{
+		size_t _imageBytes; // uncompressed bytes that were encoded
+		double _seconds;
+		double _psnr; // decibels, compared to the uncompressed image
+	};
+
+	UTIL_API TextureCompression ParseTextureCompression(StringRef text);
+
+	// The cache of compressed textures in the temp directory has no size limit, so it's off unless a build tool (respack) turns it on
+	UTIL_API void EnableTextureCompressionCache(bool enable);
+
+	// Encodes an image file without using the cache, to measure encoder speed and quality
+	UTIL_API bool MeasureTextureCompression(StringRef path, DXGI_FORMAT format, TextureCompression compression, TextureCompressionReport& report);
+
+	// Returns true when encoding in parallel strips gives the same blocks as encoding each whole image.
+	// The pixels are tightly packed RGBA32, mips of zero means the full chain down to 1x1.
+	UTIL_API bool VerifyTextureCompressionStrips(const BYTE* pixels, size_t width, size_t height, size_t mips, DXGI_FORMAT format, TextureCompression compression);
+
+#ifdef UTIL_DLL
+	// Encodes all mips and array slices in parallel strips of blocks.
+	// When the cache is enabled, results are cached by content hash in the temp directory so unchanged textures are only encoded once.
+	DirectX::ScratchImage CompressTextureData(const DirectX::ScratchImage& data, DXGI_FORMAT format, TextureCompression compression, bool useCache = true);
+#endif
+}
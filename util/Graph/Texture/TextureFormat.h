@@ -22,5 +22,8 @@ namespace ff
 		BC1_SRGB,
 		BC2_SRGB,
 		BC3_SRGB,
+
+		BC7,
+		BC7_SRGB,
 	};
 }
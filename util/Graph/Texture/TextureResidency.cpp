@@ -0,0 +1,344 @@
+#include "pch.h"
+#include "Graph/Texture/TextureResidency.h"
+#include "Thread/ThreadPool.h"
+
+static ff::StaticString DEBUG_PAGE_NAME(L"Textures");
+static ff::StaticString DEBUG_TOGGLE_EVICT_UNUSED(L"Evict textures that weren't just rendered");
+
+ff::TextureResidency::TextureResidency()
+	: _frame(1) // new textures start at frame zero, so their first Touch isn't skipped
+	, _budget(0)
+	, _pendingReloads(0)
+	, _evictUnused(false)
+	, _stats{}
+	, _debugStats{}
+{
+}
+
+ff::TextureResidency::~TextureResidency()
+{
+	ff::LockMutex lock(_mutex);
+
+	while (_pendingReloads)
+	{
+		_mutex.WaitForCondition(_reloadCondition);
+	}
+
+	assert(_entries.IsEmpty());
+}
+
+void ff::TextureResidency::SetBudget(size_t bytes)
+{
+	ff::LockMutex lock(_mutex);
+	_budget = bytes;
+}
+
+size_t ff::TextureResidency::GetBudget() const
+{
+	ff::LockMutex lock(_mutex);
+	return _budget;
+}
+
+void ff::TextureResidency::Add(ITextureResident* texture)
+{
+	assertRet(texture);
+
+	ff::LockMutex lock(_mutex);
+	_entries.SetKey(texture, Entry{ 0, 0, false, false });
+}
+
+void ff::TextureResidency::Remove(ITextureResident* texture)
+{
+	ff::LockMutex lock(_mutex);
+
+	// A reload on the thread pool might still be using the texture
+	WaitForReload(texture);
+
+	auto iter = _entries.GetKey(texture);
+	if (iter)
+	{
+		_entries.DeleteKey(*iter);
+	}
+}
+
+size_t ff::TextureResidency::GetFrame() const
+{
+	return _frame;
+}
+
+void ff::TextureResidency::Touch(ITextureResident* texture)
+{
+	ff::LockMutex lock(_mutex);
+	Entry* entry = GetEntry(texture);
+	assertRet(entry);
+
+	entry->_lastFrame = _frame;
+	noAssertRet(entry->_evicted);
+
+	if (entry->_reloading)
+	{
+		_stats._totalReloadWaits++;
+		WaitForReload(texture);
+	}
+	else
+	{
+		// Nobody is reloading it yet, so do it right away on this thread
+		StartReload(texture, *entry);
+		lock.Unlock();
+
+		FinishReload(texture, texture->Reload());
+	}
+}
+
+void ff::TextureResidency::Prefetch(ITextureResident* texture)
+{
+	ff::LockMutex lock(_mutex);
+	Entry* entry = GetEntry(texture);
+	noAssertRet(entry && entry->_evicted && !entry->_reloading);
+
+	StartReload(texture, *entry);
+
+	ff::GetThreadPool()->AddTask([this, texture]()
+		{
+			FinishReload(texture, texture->Reload());
+		});
+}
+
+void ff::TextureResidency::AdvanceFrame()
+{
+	ff::LockMutex lock(_mutex);
+	TextureResidencyStats stats = GetStats();
+	size_t totalBytes = stats._cpuBytes + stats._gpuBytes;
+	size_t oldEvictions = _stats._totalEvictions;
+
+	if ((_budget && totalBytes > _budget) || _evictUnused)
+	{
+		ff::Vector<EntryPair> order = GetEvictionOrder();
+
+		// Dropping CPU copies doesn't change what gets rendered, so try that first
+		for (size_t i = 0; i < order.Size() && _budget && totalBytes > _budget; i++)
+		{
+			ITextureResident* texture = order[i].first;
+			size_t oldBytes = texture->GetResidentCpuBytes();
+
+			if (texture->DropCpuCopy())
+			{
+				totalBytes -= oldBytes - texture->GetResidentCpuBytes();
+			}
+		}
+
+		// Textures from the frame that was just rendered are probably needed again next frame
+		for (size_t i = 0; i < order.Size() && order[i].second->_lastFrame != _frame && (_evictUnused || totalBytes > _budget); i++)
+		{
+			ITextureResident* texture = order[i].first;
+			size_t oldBytes = texture->GetResidentCpuBytes() + texture->GetResidentGpuBytes();
+
+			if (texture->Evict())
+			{
+				totalBytes -= oldBytes - texture->GetResidentCpuBytes() - texture->GetResidentGpuBytes();
+				order[i].second->_evicted = true;
+				order[i].second->_evictedBytes = oldBytes;
+				_stats._totalEvictions++;
+			}
+		}
+
+		_evictUnused = false;
+	}
+
+	// Bring back the most recently rendered textures while they fit, but not in a frame that just had to evict
+	if (_budget && _stats._totalEvictions == oldEvictions)
+	{
+		for (const EntryPair& pair : GetPrefetchOrder())
+		{
+			if (totalBytes + pair.second->_evictedBytes <= _budget)
+			{
+				totalBytes += pair.second->_evictedBytes;
+				Prefetch(pair.first);
+			}
+		}
+	}
+
+	_frame++;
+}
+
+ff::TextureResidencyStats ff::TextureResidency::GetStats() const
+{
+	ff::LockMutex lock(_mutex);
+
+	TextureResidencyStats stats = _stats;
+	stats._budgetBytes = _budget;
+
+	for (const ff::KeyValue<ITextureResident*, Entry>& kv : _entries)
+	{
+		const Entry& entry = kv.GetValue();
+		stats._textureCount++;
+		stats._evictedCount += entry._evicted ? 1 : 0;
+		stats._reloadingCount += entry._reloading ? 1 : 0;
+		stats._cpuBytes += kv.GetKey()->GetResidentCpuBytes();
+		stats._gpuBytes += kv.GetKey()->GetResidentGpuBytes();
+	}
+
+	return stats;
+}
+
+size_t ff::TextureResidency::GetDebugPageCount() const
+{
+	return 1;
+}
+
+void ff::TextureResidency::DebugUpdateStats(AppGlobals* globals, size_t page, bool updateFastNumbers)
+{
+	_debugStats = GetStats();
+}
+
+ff::String ff::TextureResidency::GetDebugName(size_t page) const
+{
+	return DEBUG_PAGE_NAME.GetString();
+}
+
+size_t ff::TextureResidency::GetDebugInfoCount(size_t page) const
+{
+	return 3;
+}
+
+ff::String ff::TextureResidency::GetDebugInfo(size_t page, size_t index, DirectX::XMFLOAT4& color) const
+{
+	const double megabyte = 1024.0 * 1024.0;
+
+	switch (index)
+	{
+	case 0:
+		return String::format_new(L"Textures:%lu, Evicted:%lu, Reloading:%lu",
+			_debugStats._textureCount,
+			_debugStats._evictedCount,
+			_debugStats._reloadingCount);
+
+	case 1:
+		color = (_debugStats._budgetBytes && _debugStats._cpuBytes + _debugStats._gpuBytes > _debugStats._budgetBytes) ? ff::GetColorRed() : ff::GetColorGreen();
+		return String::format_new(L"CPU:%.2fMB, GPU:%.2fMB, Budget:%.2fMB",
+			_debugStats._cpuBytes / megabyte,
+			_debugStats._gpuBytes / megabyte,
+			_debugStats._budgetBytes / megabyte);
+
+	case 2:
+		return String::format_new(L"Evictions:%lu, Reloads:%lu, Waits:%lu",
+			_debugStats._totalEvictions,
+			_debugStats._totalReloads,
+			_debugStats._totalReloadWaits);
+
+	default:
+		return ff::GetEmptyString();
+	}
+}
+
+size_t ff::TextureResidency::GetDebugToggleCount(size_t page) const
+{
+	return 1;
+}
+
+ff::String ff::TextureResidency::GetDebugToggle(size_t page, size_t index, int& value) const
+{
+	switch (index)
+	{
+	case 0:
+		return DEBUG_TOGGLE_EVICT_UNUSED.GetString();
+
+	default:
+		return ff::GetEmptyString();
+	}
+}
+
+void ff::TextureResidency::DebugToggle(size_t page, size_t index)
+{
+	switch (index)
+	{
+	case 0:
+		{
+			ff::LockMutex lock(_mutex);
+			_evictUnused = true;
+		}
+		break;
+	}
+}
+
+ff::TextureResidency::Entry* ff::TextureResidency::GetEntry(ITextureResident* texture)
+{
+	auto iter = _entries.GetKey(texture);
+	return iter ? &iter->GetEditableValue() : nullptr;
+}
+
+void ff::TextureResidency::StartReload(ITextureResident* texture, Entry& entry)
+{
+	assert(entry._evicted && !entry._reloading);
+
+	entry._reloading = true;
+	_pendingReloads++;
+}
+
+void ff::TextureResidency::FinishReload(ITextureResident* texture, bool success)
+{
+	ff::LockMutex lock(_mutex);
+	Entry* entry = GetEntry(texture);
+	assert(entry && entry->_reloading);
+
+	if (entry)
+	{
+		entry->_reloading = false;
+		entry->_evicted = !success;
+	}
+
+	_stats._totalReloads += success ? 1 : 0;
+	_pendingReloads--;
+	_reloadCondition.WakeAll();
+}
+
+void ff::TextureResidency::WaitForReload(ITextureResident* texture)
+{
+	for (Entry* entry = GetEntry(texture); entry && entry->_reloading; entry = GetEntry(texture))
+	{
+		_mutex.WaitForCondition(_reloadCondition);
+	}
+}
+
+ff::Vector<ff::TextureResidency::EntryPair> ff::TextureResidency::GetEvictionOrder()
+{
+	ff::Vector<EntryPair> order;
+	order.Reserve(_entries.Size());
+
+	for (const ff::KeyValue<ITextureResident*, Entry>& kv : _entries)
+	{
+		if (!kv.GetValue()._evicted && !kv.GetValue()._reloading)
+		{
+			order.Push(EntryPair(kv.GetKey(), &kv.GetEditableValue()));
+		}
+	}
+
+	// Least recently rendered first
+	std::stable_sort(order.begin(), order.end(), [](const EntryPair& lhs, const EntryPair& rhs)
+		{
+			return lhs.second->_lastFrame < rhs.second->_lastFrame;
+		});
+
+	return order;
+}
+
+ff::Vector<ff::TextureResidency::EntryPair> ff::TextureResidency::GetPrefetchOrder()
+{
+	ff::Vector<EntryPair> order;
+
+	for (const ff::KeyValue<ITextureResident*, Entry>& kv : _entries)
+	{
+		if (kv.GetValue()._evicted && !kv.GetValue()._reloading)
+		{
+			order.Push(EntryPair(kv.GetKey(), &kv.GetEditableValue()));
+		}
+	}
+
+	// Most recently rendered first
+	std::stable_sort(order.begin(), order.end(), [](const EntryPair& lhs, const EntryPair& rhs)
+		{
+			return lhs.second->_lastFrame > rhs.second->_lastFrame;
+		});
+
+	return order;
+}
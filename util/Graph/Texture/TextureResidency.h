@@ -0,0 +1,100 @@
+#pragma once
+
+#include "State/IDebugPages.h"
+
+namespace ff
+{
+	// A texture whose memory can be freed while it isn't rendered, and brought back later
+	class __declspec(novtable) ITextureResident
+	{
+	public:
+		virtual size_t GetResidentCpuBytes() const = 0;
+		virtual size_t GetResidentGpuBytes() const = 0;
+
+		// These return false when there was nothing that could be freed and recreated later.
+		// DropCpuCopy keeps the texture renderable, Evict frees everything it can.
+		virtual bool DropCpuCopy() = 0;
+		virtual bool Evict() = 0;
+
+		// Recreates what Evict freed, can be called on any thread
+		virtual bool Reload() = 0;
+	};
+
+	struct TextureResidencyStats
+	{
+		size_t _textureCount;
+		size_t _evictedCount;
+		size_t _reloadingCount;
+		size_t _cpuBytes;
+		size_t _gpuBytes;
+		size_t _budgetBytes;
+		size_t _totalEvictions;
+		size_t _totalReloads;
+		size_t _totalReloadWaits; // renders that had to wait for a reload
+	};
+
+	// Keeps the memory used by textures under a budget by freeing the least recently rendered ones.
+	// CPU copies that can be reloaded go first, then whole textures that weren't rendered in the current frame.
+	// Evicted textures are reloaded on the thread pool by Prefetch, or by AdvanceFrame once they fit in the budget again.
+	// Rendering a texture that is still evicted reloads it on the render thread, which blocks until it's done.
+	class TextureResidency : public IDebugPages
+	{
+	public:
+		UTIL_API TextureResidency();
+		UTIL_API virtual ~TextureResidency();
+
+		// Zero means there is no budget and nothing gets evicted. Apps set it with IAppGlobalsHelper::GetTextureBudget.
+		UTIL_API void SetBudget(size_t bytes);
+		UTIL_API size_t GetBudget() const;
+
+		UTIL_API void Add(ITextureResident* texture);
+		UTIL_API void Remove(ITextureResident* texture);
+
+		// Textures call Touch before rendering, once per frame is enough. It returns after evicted textures are reloaded.
+		UTIL_API size_t GetFrame() const;
+		UTIL_API void Touch(ITextureResident* texture);
+		UTIL_API void Prefetch(ITextureResident* texture);
+
+		// Call once per frame after rendering, this is when textures get evicted or prefetched
+		UTIL_API void AdvanceFrame();
+		UTIL_API TextureResidencyStats GetStats() const;
+
+		// IDebugPages
+		virtual size_t GetDebugPageCount() const override;
+		virtual void DebugUpdateStats(AppGlobals* globals, size_t page, bool updateFastNumbers) override;
+		virtual String GetDebugName(size_t page) const override;
+		virtual size_t GetDebugInfoCount(size_t page) const override;
+		virtual String GetDebugInfo(size_t page, size_t index, DirectX::XMFLOAT4& color) const override;
+		virtual size_t GetDebugToggleCount(size_t page) const override;
+		virtual String GetDebugToggle(size_t page, size_t index, int& value) const override;
+		virtual void DebugToggle(size_t page, size_t index) override;
+
+	private:
+		struct Entry
+		{
+			size_t _lastFrame;
+			size_t _evictedBytes; // what a reload will probably bring back
+			bool _evicted;
+			bool _reloading;
+		};
+
+		typedef std::pair<ITextureResident*, Entry*> EntryPair;
+
+		Entry* GetEntry(ITextureResident* texture);
+		void StartReload(ITextureResident* texture, Entry& entry);
+		void FinishReload(ITextureResident* texture, bool success);
+		void WaitForReload(ITextureResident* texture);
+		ff::Vector<EntryPair> GetEvictionOrder();
+		ff::Vector<EntryPair> GetPrefetchOrder();
+
+		Mutex _mutex;
+		Condition _reloadCondition;
+		ff::Map<ITextureResident*, Entry> _entries;
+		std::atomic<size_t> _frame;
+		size_t _budget;
+		size_t _pendingReloads;
+		bool _evictUnused;
+		TextureResidencyStats _stats;
+		TextureResidencyStats _debugStats;
+	};
+}
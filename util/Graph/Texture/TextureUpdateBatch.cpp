@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "Graph/Texture/TextureUpdateBatch.h"
+
+ff::TextureUpdateBatch::TextureUpdateBatch(size_t pixelSize)
+	: _pixelSize(pixelSize)
+	, _stats{}
+{
+	assert(pixelSize);
+}
+
+ff::TextureUpdateBatch::~TextureUpdateBatch()
+{
+}
+
+bool ff::TextureUpdateBatch::Update(ITextureUpdateTarget& target, size_t subresource, const ff::RectSize& rect, const void* data, size_t rowPitch)
+{
+	TextureUpdateImage image;
+	assertRetVal(data && target.GetUpdateImage(subresource, image), false);
+	assertRetVal(rect.right <= image._size.x && rect.bottom <= image._size.y && rect.left <= rect.right && rect.top <= rect.bottom, false);
+	noAssertRetVal(!rect.IsEmpty(), true);
+
+	const size_t rowBytes = rect.Width() * _pixelSize;
+	const BYTE* source = reinterpret_cast<const BYTE*>(data);
+	BYTE* dest = image._pixels + rect.top * image._rowPitch + rect.left * _pixelSize;
+
+	for (size_t y = 0; y < rect.Height(); y++, source += rowPitch, dest += image._rowPitch)
+	{
+		std::memcpy(dest, source, rowBytes);
+	}
+
+	AddDirtyRect(subresource, rect);
+
+	_stats._updateCount++;
+	_stats._updateBytes += rowBytes * rect.Height();
+
+	return true;
+}
+
+ff::TextureUpdateStats ff::TextureUpdateBatch::Flush(ITextureUpdateTarget& target)
+{
+	TextureUpdateStats stats = _stats;
+	_stats = TextureUpdateStats{};
+
+	for (const ff::KeyValue<size_t, ff::Vector<ff::RectSize>>& kv : _dirtyRects)
+	{
+		TextureUpdateImage image;
+		if (target.GetUpdateImage(kv.GetKey(), image))
+		{
+			for (const ff::RectSize& rect : kv.GetValue())
+			{
+				UploadRect(target, kv.GetKey(), rect, image, stats);
+			}
+		}
+	}
+
+	_dirtyRects.Clear();
+
+	return stats;
+}
+
+bool ff::TextureUpdateBatch::HasUpdates() const
+{
+	return !_dirtyRects.IsEmpty();
+}
+
+void ff::TextureUpdateBatch::Clear()
+{
+	_dirtyRects.Clear();
+	_stats = TextureUpdateStats{};
+}
+
+void ff::TextureUpdateBatch::AddDirtyRect(size_t subresource, ff::RectSize rect)
+{
+	auto iter = _dirtyRects.GetKey(subresource);
+	ff::Vector<ff::RectSize>& rects = iter ? iter->GetEditableValue() : _dirtyRects.SetKey(subresource, ff::Vector<ff::RectSize>())->GetEditableValue();
+
+	// Combine with any rect when the two of them cover their bound exactly, like when one is inside the other
+	// or they are side by side. Anything else would upload pixels that weren't updated. Each combine can
+	// grow the rect into others, so keep checking until nothing changes.
+	for (size_t i = 0; i < rects.Size(); )
+	{
+		ff::RectSize bound = rect.Bound(rects[i]);
+
+		if (bound.Area() + rect.Intersect(rects[i]).Area() == rect.Area() + rects[i].Area())
+		{
+			rect = bound;
+			rects.Delete(i);
+			i = 0;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	rects.Push(rect);
+}
+
+void ff::TextureUpdateBatch::UploadRect(ITextureUpdateTarget& target, size_t subresource, const ff::RectSize& rect, const TextureUpdateImage& image, TextureUpdateStats& stats)
+{
+	const BYTE* source = image._pixels + rect.top * image._rowPitch + rect.left * _pixelSize;
+
+	stats._uploadCount++;
+	stats._uploadBytes += rect.Area() * _pixelSize;
+
+	// The CPU copy is the source, the device makes its own copy during the call
+	target.UploadRect(subresource, rect, source, image._rowPitch);
+}
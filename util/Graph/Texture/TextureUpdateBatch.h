@@ -0,0 +1,54 @@
+#pragma once
+
+namespace ff
+{
+	// The CPU copy of one texture subresource
+	struct TextureUpdateImage
+	{
+		BYTE* _pixels;
+		size_t _rowPitch;
+		ff::PointSize _size;
+	};
+
+	class __declspec(novtable) ITextureUpdateTarget
+	{
+	public:
+		virtual bool GetUpdateImage(size_t subresource, TextureUpdateImage& image) = 0;
+
+		// Copies pixels into the GPU texture, data is only valid during the call
+		virtual void UploadRect(size_t subresource, const ff::RectSize& rect, const BYTE* data, size_t rowPitch) = 0;
+	};
+
+	struct TextureUpdateStats
+	{
+		size_t _updateCount;
+		size_t _uploadCount; // after rects were combined
+		size_t _updateBytes;
+		size_t _uploadBytes;
+	};
+
+	// Collects dirty rects for a texture so they can be uploaded together, once per frame.
+	// Updates go straight into the CPU copy, so it never has to be read back from the GPU, and uploads come from there too.
+	// Rects are only combined when together they fill the combined rect, other pixels on the GPU must not be overwritten.
+	class TextureUpdateBatch
+	{
+	public:
+		UTIL_API TextureUpdateBatch(size_t pixelSize);
+		UTIL_API ~TextureUpdateBatch();
+
+		UTIL_API bool Update(ITextureUpdateTarget& target, size_t subresource, const ff::RectSize& rect, const void* data, size_t rowPitch);
+		UTIL_API TextureUpdateStats Flush(ITextureUpdateTarget& target);
+		UTIL_API bool HasUpdates() const;
+
+		// Forget dirty rects after the whole texture was recreated from the CPU copy
+		UTIL_API void Clear();
+
+	private:
+		void AddDirtyRect(size_t subresource, ff::RectSize rect);
+		void UploadRect(ITextureUpdateTarget& target, size_t subresource, const ff::RectSize& rect, const TextureUpdateImage& image, TextureUpdateStats& stats);
+
+		ff::Map<size_t, ff::Vector<ff::RectSize>> _dirtyRects;
+		size_t _pixelSize;
+		TextureUpdateStats _stats;
+	};
+}
@@ -9,8 +9,6 @@
 #include "Graph/Texture/Texture.h"
 #include "Graph/Texture/TextureView.h"
 
-D3D_SRV_DIMENSION GetDefaultDimension(const D3D11_TEXTURE2D_DESC& desc);
-
 class __declspec(uuid("1a29f207-5a09-46e4-9888-17d1ac2eb9be"))
 	TextureView11
 	: public ff::ComBase
@@ -45,6 +43,7 @@ public:
 	virtual float GetFramesPerSecond() const override;
 	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
 	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
 	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
 	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
 
@@ -57,7 +56,6 @@ public:
 private:
 	ff::ComPtr<ff::IGraphDevice> _device;
 	ff::ComPtr<ff::ITexture> _texture;
-	ff::ComPtr<ID3D11ShaderResourceView> _view;
 	std::unique_ptr<ff::SpriteData> _spriteData;
 	size_t _arrayStart;
 	size_t _arrayCount;
@@ -112,7 +110,7 @@ bool TextureView11::Init(ff::ITexture* texture, size_t arrayStart, size_t arrayC
 {
 	assertRetVal(texture, false);
 
-	ID3D11Texture2D* texture2d = _texture->AsTexture11()->GetTexture2d();
+	ID3D11Texture2D* texture2d = texture->AsTexture11()->GetTexture2d();
 	assertRetVal(texture2d, false);
 
 	_texture = texture;
@@ -135,7 +133,6 @@ ff::IGraphDevice* TextureView11::GetDevice() const
 bool TextureView11::Reset()
 {
 	_texture = nullptr;
-	_view = nullptr;
 	return true;
 }
 
@@ -151,44 +148,10 @@ ff::ITextureView11* TextureView11::AsTextureView11()
 
 ID3D11ShaderResourceView* TextureView11::GetView()
 {
-	if (!_view)
-	{
-		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
-		ff::ZeroObject(viewDesc);
-
-		ID3D11Texture2D* texture2d = _texture->AsTexture11()->GetTexture2d();
-		assertRetVal(texture2d, nullptr);
-
-		D3D11_TEXTURE2D_DESC textureDesc;
-		texture2d->GetDesc(&textureDesc);
-
-		viewDesc.Format = textureDesc.Format;
-		viewDesc.ViewDimension = ::GetDefaultDimension(textureDesc);
-
-		switch (viewDesc.ViewDimension)
-		{
-		case D3D_SRV_DIMENSION_TEXTURE2DMSARRAY:
-			viewDesc.Texture2DMSArray.FirstArraySlice = (UINT)_arrayStart;
-			viewDesc.Texture2DMSArray.ArraySize = (UINT)_arrayCount;
-			break;
-
-		case D3D_SRV_DIMENSION_TEXTURE2DARRAY:
-			viewDesc.Texture2DArray.FirstArraySlice = (UINT)_arrayStart;
-			viewDesc.Texture2DArray.ArraySize = (UINT)_arrayCount;
-			viewDesc.Texture2DArray.MostDetailedMip = (UINT)_mipStart;
-			viewDesc.Texture2DArray.MipLevels = (UINT)_mipCount;
-			break;
-
-		case D3D_SRV_DIMENSION_TEXTURE2D:
-			viewDesc.Texture2D.MostDetailedMip = (UINT)_mipStart;
-			viewDesc.Texture2D.MipLevels = (UINT)_mipCount;
-			break;
-		}
-
-		assertHrRetVal(_device->AsGraphDevice11()->Get3d()->CreateShaderResourceView(texture2d, &viewDesc, &_view), nullptr);
-	}
+	assertRetVal(_texture, nullptr);
 
-	return _view;
+	// The texture owns the view, so that it goes away when the texture is evicted
+	return _texture->AsTexture11()->GetSubView(_arrayStart, _arrayCount, _mipStart, _mipCount);
 }
 
 const ff::SpriteData& TextureView11::GetSpriteData()
@@ -224,6 +187,11 @@ void TextureView11::RenderFrame(ff::IRendererActive* render, const ff::Transform
 	render->DrawSprite(this, position);
 }
 
+void TextureView11::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	ff::DrawSpriteFrames(render, this, positions, count);
+}
+
 ff::ValuePtr TextureView11::GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params)
 {
 	return nullptr;
@@ -12,6 +12,7 @@ ff::DeviceEvent::DeviceEvent(DeviceEventType type, unsigned int id, int count, P
 	, _id(id)
 	, _count(count)
 	, _pos(pos)
+	, _time(0)
 {
 }
 
@@ -24,6 +24,7 @@ namespace ff
 		unsigned int _id;
 		int _count;
 		PointInt _pos;
+		INT64 _time; // raw timer ticks when the window got the input, zero when unknown
 	};
 
 	struct DeviceEventKeyPress : public DeviceEvent
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Types/SpscRing.h"
+
+namespace ff
+{
+	struct InputEventQueueStats
+	{
+		size_t _pushed;
+		size_t _drained;
+		size_t _overflows; // events dropped because the queue was full
+		size_t _maxDrain; // most events drained by one call
+	};
+
+	// Raw input goes in on the window thread and gets drained in bulk by the game thread, without locks.
+	// When the game thread falls too far behind, new events are dropped and counted as overflows,
+	// the consumer should reset its state when the overflow count changes.
+	template<typename T>
+	class InputEventQueue
+	{
+	public:
+		InputEventQueue(size_t capacity)
+			: _ring(capacity)
+			, _pushed(0)
+			, _overflows(0)
+			, _drained(0)
+			, _maxDrain(0)
+		{
+		}
+
+		InputEventQueue(const InputEventQueue& rhs) = delete;
+		InputEventQueue& operator=(const InputEventQueue& rhs) = delete;
+
+		// Producer, the time is in raw timer ticks
+		bool Push(const T& event, INT64 time)
+		{
+			if (!_ring.Push(Entry{ event, time }))
+			{
+				_overflows.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			_pushed.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Consumer, calls func(const T& event, INT64 time) for everything that was pushed before the call
+		template<typename Func>
+		size_t Drain(Func&& func)
+		{
+			Entry entries[DRAIN_BATCH];
+			size_t total = 0;
+
+			for (size_t count = _ring.GetReadCount(); count; )
+			{
+				size_t read = _ring.Read(entries, std::min(count, DRAIN_BATCH));
+				for (size_t i = 0; i < read; i++)
+				{
+					func(entries[i]._event, entries[i]._time);
+				}
+
+				count -= read;
+				total += read;
+			}
+
+			_drained += total;
+			_maxDrain = std::max(_maxDrain, total);
+
+			return total;
+		}
+
+		// Any thread
+		size_t GetOverflowCount() const
+		{
+			return _overflows.load(std::memory_order_relaxed);
+		}
+
+		// Consumer
+		InputEventQueueStats GetStats() const
+		{
+			InputEventQueueStats stats;
+			stats._pushed = _pushed.load(std::memory_order_relaxed);
+			stats._drained = _drained;
+			stats._overflows = GetOverflowCount();
+			stats._maxDrain = _maxDrain;
+
+			return stats;
+		}
+
+	private:
+		struct Entry
+		{
+			T _event;
+			INT64 _time;
+		};
+
+		static const size_t DRAIN_BATCH = 64;
+
+		ff::SpscRing<Entry> _ring;
+		std::atomic<size_t> _pushed;
+		std::atomic<size_t> _overflows;
+		size_t _drained;
+		size_t _maxDrain;
+	};
+}
@@ -6,6 +6,7 @@
 #include "Dict/Dict.h"
 #include "Globals/ProcessGlobals.h"
 #include "Input/InputMapping.h"
+#include "Input/InputMappingTable.h"
 #include "Input/Joystick/JoystickDevice.h"
 #include "Input/Keyboard/KeyboardDevice.h"
 #include "Input/Pointer/PointerDevice.h"
@@ -65,6 +66,8 @@ private:
 
 	struct InputEventMappingInfo : public ff::InputEventMapping
 	{
+		size_t _slots[_countof(ff::InputEventMapping::_actions)]; // in _table
+		size_t _actionCount;
 		double _holdingSeconds;
 		int _eventCount;
 		bool _holding;
@@ -75,10 +78,12 @@ private:
 
 	ff::Vector<InputEventMappingInfo> _eventMappings;
 	ff::Vector<ff::InputValueMapping> _valueMappings;
+	ff::Vector<ff::InputValueMapping> _sortedValueMappings;
 	ff::Vector<ff::InputEvent> _currentEvents;
+	ff::InputMappingTable _table;
 
 	ff::Map<ff::hash_t, size_t> _eventToInfo;
-	ff::Map<ff::hash_t, size_t> _valueToInfo;
+	ff::Map<ff::hash_t, size_t, ff::NonHasher<ff::hash_t>> _valueToSorted; // first index for each value ID
 };
 
 BEGIN_INTERFACES(InputMapping)
@@ -108,6 +113,7 @@ InputMapping::~InputMapping()
 bool InputMapping::Advance(const ff::InputDevices& devices, double deltaTime)
 {
 	_currentEvents.Clear();
+	_table.Snapshot(devices);
 
 	for (size_t i = 0; i < _eventMappings.Size(); i++)
 	{
@@ -117,12 +123,12 @@ bool InputMapping::Advance(const ff::InputDevices& devices, double deltaTime)
 		int nTriggerCount = 0;
 
 		// Check each required button that needs to be pressed to trigger the current action
-		for (size_t h = 0; h < _countof(info._actions) && info._actions[h]._device != ff::INPUT_DEVICE_NULL; h++)
+		for (size_t h = 0; h < info._actionCount; h++)
 		{
-			int nCurTriggerCount = 0;
-			int nCurValue = GetDigitalValue(devices, info._actions[h], &nCurTriggerCount);
+			int nCurTriggerCount = _table.GetPressCount(info._slots[h]);
+			bool bCurValue = _table.GetDigitalValue(info._slots[h]);
 
-			if (!nCurValue)
+			if (!bCurValue)
 			{
 				bStillHolding = false;
 				nTriggerCount = 0;
@@ -203,6 +209,11 @@ bool InputMapping::MapEvents(const ff::InputEventMapping* pMappings, size_t nCou
 
 		::CopyMemory(&info, &pMappings[i], sizeof(pMappings[i]));
 
+		for (; info._actionCount < _countof(info._actions) && info._actions[info._actionCount]._device != ff::INPUT_DEVICE_NULL; info._actionCount++)
+		{
+			info._slots[info._actionCount] = _table.AddAction(info._actions[info._actionCount]);
+		}
+
 		_eventMappings.Push(info);
 		_eventToInfo.InsertKey(info._eventID, _eventMappings.Size() - 1);
 	}
@@ -214,12 +225,22 @@ bool InputMapping::MapValues(const ff::InputValueMapping* pMappings, size_t nCou
 {
 	bool status = true;
 
-	_valueMappings.Reserve(_valueMappings.Size() + nCount);
+	_valueMappings.Push(pMappings, nCount);
 
-	for (size_t i = 0; i < nCount; i++)
+	// Keep all actions for a value next to each other, so lookups don't need to walk a chain
+	_sortedValueMappings = _valueMappings;
+	std::stable_sort(_sortedValueMappings.begin(), _sortedValueMappings.end(), [](const ff::InputValueMapping& lhs, const ff::InputValueMapping& rhs)
+		{
+			return lhs._valueID < rhs._valueID;
+		});
+
+	_valueToSorted.Clear();
+	for (size_t i = 0; i < _sortedValueMappings.Size(); i++)
 	{
-		_valueMappings.Push(pMappings[i]);
-		_valueToInfo.InsertKey(pMappings[i]._valueID, _valueMappings.Size() - 1);
+		if (!i || _sortedValueMappings[i]._valueID != _sortedValueMappings[i - 1]._valueID)
+		{
+			_valueToSorted.SetKey(_sortedValueMappings[i]._valueID, i);
+		}
 	}
 
 	return status;
@@ -258,10 +279,11 @@ ff::Vector<ff::InputEventMapping> InputMapping::GetMappedEvents(ff::hash_t event
 ff::Vector<ff::InputValueMapping> InputMapping::GetMappedValues(ff::hash_t valueID) const
 {
 	ff::Vector<ff::InputValueMapping> mappings;
+	auto i = _valueToSorted.GetKey(valueID);
 
-	for (auto i = _valueToInfo.GetKey(valueID); i; i = _valueToInfo.GetNextDupeKey(*i))
+	for (size_t h = i ? i->GetValue() : _sortedValueMappings.Size(); h < _sortedValueMappings.Size() && _sortedValueMappings[h]._valueID == valueID; h++)
 	{
-		mappings.Push(_valueMappings[i->GetValue()]);
+		mappings.Push(_sortedValueMappings[h]);
 	}
 
 	return mappings;
@@ -328,9 +350,11 @@ int InputMapping::GetDigitalValue(const ff::InputDevices& devices, ff::hash_t va
 {
 	int ret = 0;
 
-	for (auto i = _valueToInfo.GetKey(valueID); i; i = _valueToInfo.GetNextDupeKey(*i))
+	auto i = _valueToSorted.GetKey(valueID);
+
+	for (size_t h = i ? i->GetValue() : _sortedValueMappings.Size(); h < _sortedValueMappings.Size() && _sortedValueMappings[h]._valueID == valueID; h++)
 	{
-		const ff::InputAction& action = _valueMappings[i->GetValue()]._action;
+		const ff::InputAction& action = _sortedValueMappings[h]._action;
 
 		int val = GetDigitalValue(devices, action, nullptr);
 
@@ -348,9 +372,11 @@ float InputMapping::GetAnalogValue(const ff::InputDevices& devices, ff::hash_t v
 {
 	float ret = 0;
 
-	for (auto i = _valueToInfo.GetKey(valueID); i; i = _valueToInfo.GetNextDupeKey(*i))
+	auto i = _valueToSorted.GetKey(valueID);
+
+	for (size_t h = i ? i->GetValue() : _sortedValueMappings.Size(); h < _sortedValueMappings.Size() && _sortedValueMappings[h]._valueID == valueID; h++)
 	{
-		const ff::InputAction& action = _valueMappings[i->GetValue()]._action;
+		const ff::InputAction& action = _sortedValueMappings[h]._action;
 
 		float val = GetAnalogValue(devices, action, false);
 
@@ -368,9 +394,11 @@ ff::String InputMapping::GetStringValue(const ff::InputDevices& devices, ff::has
 {
 	ff::String ret;
 
-	for (auto i = _valueToInfo.GetKey(valueID); i; i = _valueToInfo.GetNextDupeKey(*i))
+	auto i = _valueToSorted.GetKey(valueID);
+
+	for (size_t h = i ? i->GetValue() : _sortedValueMappings.Size(); h < _sortedValueMappings.Size() && _sortedValueMappings[h]._valueID == valueID; h++)
 	{
-		const ff::InputAction& action = _valueMappings[i->GetValue()]._action;
+		const ff::InputAction& action = _sortedValueMappings[h]._action;
 
 		ret += GetStringValue(devices, action);
 	}
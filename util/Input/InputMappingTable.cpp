@@ -0,0 +1,288 @@
+#include "pch.h"
+#include "Input/InputMappingTable.h"
+#include "Input/Joystick/JoystickDevice.h"
+#include "Input/Keyboard/KeyboardDevice.h"
+#include "Input/Pointer/PointerDevice.h"
+
+// Device state that's shared by all actions for the same button, stick, or trigger
+struct InputGroupState
+{
+	ff::PointFloat _digitalPos; // stick, dpad, or trigger in x
+	ff::RectInt _dirPresses; // stick or dpad
+	int _presses;
+	bool _down;
+};
+
+static bool IsSameGroup(const ff::InputAction& lhs, const ff::InputAction& rhs)
+{
+	return lhs._device == rhs._device && lhs._part == rhs._part && lhs._partIndex == rhs._partIndex;
+}
+
+static bool IsGroupOrder(const ff::InputAction& lhs, const ff::InputAction& rhs)
+{
+	if (lhs._device != rhs._device)
+	{
+		return lhs._device < rhs._device;
+	}
+
+	if (lhs._part != rhs._part)
+	{
+		return lhs._part < rhs._part;
+	}
+
+	if (lhs._partIndex != rhs._partIndex)
+	{
+		return lhs._partIndex < rhs._partIndex;
+	}
+
+	return lhs._partValue < rhs._partValue;
+}
+
+static void KeepLargest(float& value, float newValue)
+{
+	if (std::fabs(newValue) > std::fabs(value))
+	{
+		value = newValue;
+	}
+}
+
+static void AddDirPresses(ff::RectInt& presses, const ff::RectInt& newPresses)
+{
+	presses.left += newPresses.left;
+	presses.top += newPresses.top;
+	presses.right += newPresses.right;
+	presses.bottom += newPresses.bottom;
+}
+
+static InputGroupState ReadGroup(const ff::InputDevices& devices, const ff::InputAction& action)
+{
+	InputGroupState state{};
+	size_t index = action._partIndex;
+
+	switch (action._device)
+	{
+	case ff::INPUT_DEVICE_KEYBOARD:
+		for (ff::IKeyboardDevice* keys : devices._keys)
+		{
+			if (action._part == ff::INPUT_PART_BUTTON)
+			{
+				state._presses += keys->GetKeyPressCount((int)index);
+				state._down |= keys->GetKey((int)index);
+			}
+			else if (action._part == ff::INPUT_PART_TEXT && !state._down && keys->GetChars().size())
+			{
+				state._presses = 1;
+				state._down = true;
+			}
+		}
+		break;
+
+	case ff::INPUT_DEVICE_MOUSE:
+		for (ff::IPointerDevice* mouse : devices._mice)
+		{
+			if (action._part == ff::INPUT_PART_BUTTON)
+			{
+				state._presses += mouse->GetButtonClickCount((int)index);
+				state._down |= mouse->GetButton((int)index);
+			}
+		}
+		break;
+
+	case ff::INPUT_DEVICE_JOYSTICK:
+		for (ff::IJoystickDevice* joy : devices._joys)
+		{
+			if (!joy->IsConnected())
+			{
+				continue;
+			}
+
+			switch (action._part)
+			{
+			case ff::INPUT_PART_BUTTON:
+				{
+					size_t buttonCount = joy->GetButtonCount();
+					bool allButtons = (index == 0xFF);
+
+					if (allButtons || index < buttonCount)
+					{
+						for (size_t h = allButtons ? 0 : index, end = allButtons ? buttonCount : index + 1; h < end; h++)
+						{
+							state._presses += joy->GetButtonPressCount(h);
+							state._down |= joy->GetButton(h);
+						}
+					}
+				}
+				break;
+
+			case ff::INPUT_PART_KEY_BUTTON:
+				if (joy->HasKeyButton((int)index))
+				{
+					state._presses += joy->GetKeyButtonPressCount((int)index);
+					state._down |= joy->GetKeyButton((int)index);
+				}
+				break;
+
+			case ff::INPUT_PART_TRIGGER:
+				if (index < joy->GetTriggerCount())
+				{
+					state._presses += joy->GetTriggerPressCount(index);
+					::KeepLargest(state._digitalPos.x, joy->GetTrigger(index, true));
+				}
+				break;
+
+			case ff::INPUT_PART_STICK:
+				if (index < joy->GetStickCount())
+				{
+					ff::PointFloat pos = joy->GetStickPos(index, true);
+					::KeepLargest(state._digitalPos.x, pos.x);
+					::KeepLargest(state._digitalPos.y, pos.y);
+					::AddDirPresses(state._dirPresses, joy->GetStickPressCount(index));
+				}
+				break;
+
+			case ff::INPUT_PART_DPAD:
+				if (index < joy->GetDPadCount())
+				{
+					ff::PointFloat pos = joy->GetDPadPos(index).ToType<float>();
+					::KeepLargest(state._digitalPos.x, pos.x);
+					::KeepLargest(state._digitalPos.y, pos.y);
+					::AddDirPresses(state._dirPresses, joy->GetDPadPressCount(index));
+				}
+				break;
+			}
+		}
+		break;
+	}
+
+	return state;
+}
+
+static float GetDirValue(ff::PointFloat pos, ff::InputPartValue partValue)
+{
+	switch (partValue)
+	{
+	case ff::INPUT_VALUE_X_AXIS: return pos.x;
+	case ff::INPUT_VALUE_Y_AXIS: return pos.y;
+	case ff::INPUT_VALUE_LEFT: return (pos.x < 0) ? -pos.x : 0.0f;
+	case ff::INPUT_VALUE_RIGHT: return (pos.x > 0) ? pos.x : 0.0f;
+	case ff::INPUT_VALUE_UP: return (pos.y < 0) ? -pos.y : 0.0f;
+	case ff::INPUT_VALUE_DOWN: return (pos.y > 0) ? pos.y : 0.0f;
+	default: return 0;
+	}
+}
+
+static int GetDirPresses(const ff::RectInt& presses, ff::InputPartValue partValue)
+{
+	switch (partValue)
+	{
+	case ff::INPUT_VALUE_LEFT: return presses.left;
+	case ff::INPUT_VALUE_RIGHT: return presses.right;
+	case ff::INPUT_VALUE_UP: return presses.top;
+	case ff::INPUT_VALUE_DOWN: return presses.bottom;
+	default: return 0;
+	}
+}
+
+ff::InputMappingTable::InputMappingTable()
+	: _compiled(true)
+{
+}
+
+ff::InputMappingTable::~InputMappingTable()
+{
+}
+
+size_t ff::InputMappingTable::AddAction(const InputAction& action)
+{
+	auto i = _actionToSlot.GetKey(action);
+	if (i)
+	{
+		return i->GetValue();
+	}
+
+	size_t slot = _actions.Size();
+	_actions.Push(action);
+	_actionToSlot.SetKey(action, slot);
+	_compiled = false;
+
+	return slot;
+}
+
+size_t ff::InputMappingTable::GetActionCount() const
+{
+	return _actions.Size();
+}
+
+void ff::InputMappingTable::Clear()
+{
+	_actions.Clear();
+	_actionToSlot.Clear();
+	_compiled = false;
+}
+
+void ff::InputMappingTable::Snapshot(const InputDevices& devices)
+{
+	if (!_compiled)
+	{
+		Compile();
+	}
+
+	std::memset(_digital.Data(), 0, _digital.ByteSize());
+
+	for (size_t start = 0, end = 0; start < _order.Size(); start = end)
+	{
+		const ff::InputAction& groupAction = _actions[_order[start]];
+		InputGroupState state = ::ReadGroup(devices, groupAction);
+
+		for (end = start; end < _order.Size() && ::IsSameGroup(groupAction, _actions[_order[end]]); end++)
+		{
+			size_t slot = _order[end];
+			const ff::InputAction& action = _actions[slot];
+			bool down = false;
+
+			switch (action._part)
+			{
+			case ff::INPUT_PART_TRIGGER:
+				down = state._digitalPos.x >= 0.5f;
+				_presses[slot] = state._presses;
+				break;
+
+			case ff::INPUT_PART_STICK:
+			case ff::INPUT_PART_DPAD:
+				down = ::GetDirValue(state._digitalPos, action._partValue) >= 0.5f;
+				_presses[slot] = ::GetDirPresses(state._dirPresses, action._partValue);
+				break;
+
+			default:
+				down = state._down;
+				_presses[slot] = state._presses;
+				break;
+			}
+
+			if (down)
+			{
+				_digital[slot / 64] |= 1ULL << (slot % 64);
+			}
+		}
+	}
+}
+
+void ff::InputMappingTable::Compile()
+{
+	_order.Resize(_actions.Size());
+	for (size_t i = 0; i < _order.Size(); i++)
+	{
+		_order[i] = i;
+	}
+
+	std::sort(_order.begin(), _order.end(), [this](size_t lhs, size_t rhs)
+		{
+			return ::IsGroupOrder(_actions[lhs], _actions[rhs]);
+		});
+
+	_digital.Resize((_actions.Size() + 63) / 64);
+	_presses.Resize(_actions.Size());
+	std::memset(_presses.Data(), 0, _presses.ByteSize());
+
+	_compiled = true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Input/InputMapping.h"
+
+namespace ff
+{
+	// Flat table of every distinct action used by input mappings. Snapshot reads the devices once per frame,
+	// grouped by device and part, so actions that share a key, stick, or trigger only query it once.
+	// After that, mappings just look up their slots.
+	class InputMappingTable
+	{
+	public:
+		UTIL_API InputMappingTable();
+		UTIL_API ~InputMappingTable();
+
+		UTIL_API size_t AddAction(const InputAction& action); // returns the action's slot
+		UTIL_API size_t GetActionCount() const;
+		UTIL_API void Clear();
+
+		UTIL_API void Snapshot(const InputDevices& devices);
+
+		bool GetDigitalValue(size_t slot) const
+		{
+			return (_digital[slot / 64] & (1ULL << (slot % 64))) != 0;
+		}
+
+		int GetPressCount(size_t slot) const
+		{
+			return _presses[slot];
+		}
+
+	private:
+		void Compile();
+
+		Vector<InputAction> _actions;
+		Map<InputAction, size_t> _actionToSlot;
+		Vector<size_t> _order; // slots sorted by device, part, and index
+		Vector<uint64_t> _digital; // bitset
+		Vector<int> _presses;
+		bool _compiled;
+	};
+}
@@ -0,0 +1,852 @@
+#include "pch.h"
+#include "COM/ComAlloc.h"
+#include "Data/DataPersist.h"
+#include "Data/DataWriterReader.h"
+#include "Input/InputReplay.h"
+#include "Input/Joystick/JoystickDevice.h"
+#include "Input/Keyboard/KeyboardDevice.h"
+#include "Input/Pointer/PointerDevice.h"
+
+static const DWORD REPLAY_MAGIC = 0x52494646; // FFIR
+static const DWORD REPLAY_VERSION = 1;
+static const size_t MAX_DEVICES = 64;
+static const size_t KEY_COUNT = 256;
+static const size_t BUTTON_COUNT = VK_XBUTTON2 + 1;
+static const size_t MAX_STICKS = 4;
+static const size_t MAX_DPADS = 4;
+static const size_t MAX_BUTTONS = 32;
+static const size_t MAX_TRIGGERS = 4;
+static const int KEY_BUTTON_FIRST = VK_GAMEPAD_A;
+static const size_t KEY_BUTTON_COUNT = VK_GAMEPAD_RIGHT_THUMBSTICK_LEFT - VK_GAMEPAD_A + 1;
+static const int POINTER_BUTTONS[] = { VK_LBUTTON, VK_RBUTTON, VK_MBUTTON, VK_XBUTTON1, VK_XBUTTON2 };
+
+// Snapshots are compared byte by byte, so they must be zeroed before they are filled in
+
+struct KeyboardSnapshot
+{
+	bool _keys[KEY_COUNT];
+	BYTE _presses[KEY_COUNT];
+};
+
+struct PointerSnapshot
+{
+	ff::PointDouble _pos;
+	ff::PointDouble _relativePos;
+	ff::PointDouble _wheel;
+	bool _inWindow;
+	bool _buttons[BUTTON_COUNT];
+	BYTE _clicks[BUTTON_COUNT];
+	BYTE _releases[BUTTON_COUNT];
+	BYTE _doubleClicks[BUTTON_COUNT];
+};
+
+struct JoystickSnapshot
+{
+	ff::PointFloat _sticks[MAX_STICKS];
+	ff::PointFloat _digitalSticks[MAX_STICKS];
+	ff::RectInt _stickPresses[MAX_STICKS];
+	ff::PointInt _dpads[MAX_DPADS];
+	ff::RectInt _dpadPresses[MAX_DPADS];
+	float _triggers[MAX_TRIGGERS];
+	float _digitalTriggers[MAX_TRIGGERS];
+	BYTE _triggerPresses[MAX_TRIGGERS];
+	bool _buttons[MAX_BUTTONS];
+	BYTE _buttonPresses[MAX_BUTTONS];
+	bool _hasKeyButtons[KEY_BUTTON_COUNT];
+	bool _keyButtons[KEY_BUTTON_COUNT];
+	BYTE _keyButtonPresses[KEY_BUTTON_COUNT];
+	BYTE _stickCount;
+	BYTE _dpadCount;
+	BYTE _triggerCount;
+	BYTE _buttonCount;
+	bool _connected;
+};
+
+static BYTE ToByte(int value)
+{
+	return (BYTE)std::min(std::max(value, 0), 0xFF);
+}
+
+static size_t GetKeyButtonIndex(int vk)
+{
+	return (vk >= KEY_BUTTON_FIRST && vk < KEY_BUTTON_FIRST + (int)KEY_BUTTON_COUNT) ? (size_t)(vk - KEY_BUTTON_FIRST) : ff::INVALID_SIZE;
+}
+
+class __declspec(uuid("e6ae0e7e-a0bb-440c-86dc-52b47c904772"))
+	ReplayKeyboardDevice
+	: public ff::ComBase
+	, public ff::IKeyboardDevice
+{
+public:
+	DECLARE_HEADER(ReplayKeyboardDevice);
+
+	// IInputDevice
+	virtual void Advance() override;
+	virtual void KillPending() override;
+	virtual bool IsConnected() const override;
+
+	// IKeyboardDevice
+	virtual bool GetKey(int vk) const override;
+	virtual int GetKeyPressCount(int vk) const override;
+	virtual ff::String GetChars() const override;
+
+	KeyboardSnapshot _state;
+	ff::String _chars;
+};
+
+BEGIN_INTERFACES(ReplayKeyboardDevice)
+	HAS_INTERFACE(ff::IKeyboardDevice)
+	HAS_INTERFACE(ff::IInputDevice)
+END_INTERFACES()
+
+ReplayKeyboardDevice::ReplayKeyboardDevice()
+{
+	ff::ZeroObject(_state);
+}
+
+ReplayKeyboardDevice::~ReplayKeyboardDevice()
+{
+}
+
+void ReplayKeyboardDevice::Advance()
+{
+}
+
+void ReplayKeyboardDevice::KillPending()
+{
+}
+
+bool ReplayKeyboardDevice::IsConnected() const
+{
+	return true;
+}
+
+bool ReplayKeyboardDevice::GetKey(int vk) const
+{
+	assertRetVal(vk >= 0 && vk < KEY_COUNT, false);
+	return _state._keys[vk];
+}
+
+int ReplayKeyboardDevice::GetKeyPressCount(int vk) const
+{
+	assertRetVal(vk >= 0 && vk < KEY_COUNT, 0);
+	return _state._presses[vk];
+}
+
+ff::String ReplayKeyboardDevice::GetChars() const
+{
+	return _chars;
+}
+
+class __declspec(uuid("8339b54d-6a71-4700-85fa-3e25ffea0e43"))
+	ReplayPointerDevice
+	: public ff::ComBase
+	, public ff::IPointerDevice
+{
+public:
+	DECLARE_HEADER(ReplayPointerDevice);
+
+	// IInputDevice
+	virtual void Advance() override;
+	virtual void KillPending() override;
+	virtual bool IsConnected() const override;
+
+	// IPointerDevice
+	virtual bool IsInWindow() const override;
+	virtual ff::PointDouble GetPos() const override;
+	virtual ff::PointDouble GetRelativePos() const override;
+	virtual bool GetButton(int vkButton) const override;
+	virtual int GetButtonClickCount(int vkButton) const override;
+	virtual int GetButtonReleaseCount(int vkButton) const override;
+	virtual int GetButtonDoubleClickCount(int vkButton) const override;
+	virtual ff::PointDouble GetWheelScroll() const override;
+	virtual size_t GetTouchCount() const override;
+	virtual const ff::TouchInfo& GetTouchInfo(size_t index) const override;
+
+	PointerSnapshot _state;
+	ff::Vector<ff::TouchInfo> _touches;
+};
+
+BEGIN_INTERFACES(ReplayPointerDevice)
+	HAS_INTERFACE(ff::IPointerDevice)
+	HAS_INTERFACE(ff::IInputDevice)
+END_INTERFACES()
+
+ReplayPointerDevice::ReplayPointerDevice()
+{
+	ff::ZeroObject(_state);
+}
+
+ReplayPointerDevice::~ReplayPointerDevice()
+{
+}
+
+void ReplayPointerDevice::Advance()
+{
+}
+
+void ReplayPointerDevice::KillPending()
+{
+}
+
+bool ReplayPointerDevice::IsConnected() const
+{
+	return true;
+}
+
+bool ReplayPointerDevice::IsInWindow() const
+{
+	return _state._inWindow;
+}
+
+ff::PointDouble ReplayPointerDevice::GetPos() const
+{
+	return _state._pos;
+}
+
+ff::PointDouble ReplayPointerDevice::GetRelativePos() const
+{
+	return _state._relativePos;
+}
+
+bool ReplayPointerDevice::GetButton(int vkButton) const
+{
+	assertRetVal(vkButton >= 0 && vkButton < BUTTON_COUNT, false);
+	return _state._buttons[vkButton];
+}
+
+int ReplayPointerDevice::GetButtonClickCount(int vkButton) const
+{
+	assertRetVal(vkButton >= 0 && vkButton < BUTTON_COUNT, 0);
+	return _state._clicks[vkButton];
+}
+
+int ReplayPointerDevice::GetButtonReleaseCount(int vkButton) const
+{
+	assertRetVal(vkButton >= 0 && vkButton < BUTTON_COUNT, 0);
+	return _state._releases[vkButton];
+}
+
+int ReplayPointerDevice::GetButtonDoubleClickCount(int vkButton) const
+{
+	assertRetVal(vkButton >= 0 && vkButton < BUTTON_COUNT, 0);
+	return _state._doubleClicks[vkButton];
+}
+
+ff::PointDouble ReplayPointerDevice::GetWheelScroll() const
+{
+	return _state._wheel;
+}
+
+size_t ReplayPointerDevice::GetTouchCount() const
+{
+	return _touches.Size();
+}
+
+const ff::TouchInfo& ReplayPointerDevice::GetTouchInfo(size_t index) const
+{
+	return _touches[index];
+}
+
+class __declspec(uuid("a9ab39bd-367e-40c4-8c59-66fcb638dfa6"))
+	ReplayJoystickDevice
+	: public ff::ComBase
+	, public ff::IJoystickDevice
+{
+public:
+	DECLARE_HEADER(ReplayJoystickDevice);
+
+	// IInputDevice
+	virtual void Advance() override;
+	virtual void KillPending() override;
+	virtual bool IsConnected() const override;
+
+	// IJoystickDevice
+	virtual size_t GetStickCount() const override;
+	virtual ff::PointFloat GetStickPos(size_t nStick, bool bDigital) const override;
+	virtual ff::RectInt GetStickPressCount(size_t nStick) const override;
+	virtual ff::String GetStickName(size_t nStick) const override;
+	virtual size_t GetDPadCount() const override;
+	virtual ff::PointInt GetDPadPos(size_t nDPad) const override;
+	virtual ff::RectInt GetDPadPressCount(size_t nDPad) const override;
+	virtual ff::String GetDPadName(size_t nDPad) const override;
+	virtual size_t GetButtonCount() const override;
+	virtual bool GetButton(size_t nButton) const override;
+	virtual int GetButtonPressCount(size_t nButton) const override;
+	virtual ff::String GetButtonName(size_t nButton) const override;
+	virtual size_t GetTriggerCount() const override;
+	virtual float GetTrigger(size_t nTrigger, bool bDigital) const override;
+	virtual int GetTriggerPressCount(size_t nTrigger) const override;
+	virtual ff::String GetTriggerName(size_t nTrigger) const override;
+	virtual bool HasKeyButton(int vk) const override;
+	virtual bool GetKeyButton(int vk) const override;
+	virtual int GetKeyButtonPressCount(int vk) const override;
+	virtual ff::String GetKeyButtonName(int vk) const override;
+
+	JoystickSnapshot _state;
+};
+
+BEGIN_INTERFACES(ReplayJoystickDevice)
+	HAS_INTERFACE(ff::IJoystickDevice)
+	HAS_INTERFACE(ff::IInputDevice)
+END_INTERFACES()
+
+ReplayJoystickDevice::ReplayJoystickDevice()
+{
+	ff::ZeroObject(_state);
+}
+
+ReplayJoystickDevice::~ReplayJoystickDevice()
+{
+}
+
+void ReplayJoystickDevice::Advance()
+{
+}
+
+void ReplayJoystickDevice::KillPending()
+{
+}
+
+bool ReplayJoystickDevice::IsConnected() const
+{
+	return _state._connected;
+}
+
+size_t ReplayJoystickDevice::GetStickCount() const
+{
+	return _state._stickCount;
+}
+
+ff::PointFloat ReplayJoystickDevice::GetStickPos(size_t nStick, bool bDigital) const
+{
+	assertRetVal(nStick < _state._stickCount, ff::PointFloat::Zeros());
+	return bDigital ? _state._digitalSticks[nStick] : _state._sticks[nStick];
+}
+
+ff::RectInt ReplayJoystickDevice::GetStickPressCount(size_t nStick) const
+{
+	assertRetVal(nStick < _state._stickCount, ff::RectInt::Zeros());
+	return _state._stickPresses[nStick];
+}
+
+ff::String ReplayJoystickDevice::GetStickName(size_t nStick) const
+{
+	return ff::String();
+}
+
+size_t ReplayJoystickDevice::GetDPadCount() const
+{
+	return _state._dpadCount;
+}
+
+ff::PointInt ReplayJoystickDevice::GetDPadPos(size_t nDPad) const
+{
+	assertRetVal(nDPad < _state._dpadCount, ff::PointInt::Zeros());
+	return _state._dpads[nDPad];
+}
+
+ff::RectInt ReplayJoystickDevice::GetDPadPressCount(size_t nDPad) const
+{
+	assertRetVal(nDPad < _state._dpadCount, ff::RectInt::Zeros());
+	return _state._dpadPresses[nDPad];
+}
+
+ff::String ReplayJoystickDevice::GetDPadName(size_t nDPad) const
+{
+	return ff::String();
+}
+
+size_t ReplayJoystickDevice::GetButtonCount() const
+{
+	return _state._buttonCount;
+}
+
+bool ReplayJoystickDevice::GetButton(size_t nButton) const
+{
+	assertRetVal(nButton < _state._buttonCount, false);
+	return _state._buttons[nButton];
+}
+
+int ReplayJoystickDevice::GetButtonPressCount(size_t nButton) const
+{
+	assertRetVal(nButton < _state._buttonCount, 0);
+	return _state._buttonPresses[nButton];
+}
+
+ff::String ReplayJoystickDevice::GetButtonName(size_t nButton) const
+{
+	return ff::String();
+}
+
+size_t ReplayJoystickDevice::GetTriggerCount() const
+{
+	return _state._triggerCount;
+}
+
+float ReplayJoystickDevice::GetTrigger(size_t nTrigger, bool bDigital) const
+{
+	assertRetVal(nTrigger < _state._triggerCount, 0.0f);
+	return bDigital ? _state._digitalTriggers[nTrigger] : _state._triggers[nTrigger];
+}
+
+int ReplayJoystickDevice::GetTriggerPressCount(size_t nTrigger) const
+{
+	assertRetVal(nTrigger < _state._triggerCount, 0);
+	return _state._triggerPresses[nTrigger];
+}
+
+ff::String ReplayJoystickDevice::GetTriggerName(size_t nTrigger) const
+{
+	return ff::String();
+}
+
+bool ReplayJoystickDevice::HasKeyButton(int vk) const
+{
+	size_t index = ::GetKeyButtonIndex(vk);
+	return index != ff::INVALID_SIZE && _state._hasKeyButtons[index];
+}
+
+bool ReplayJoystickDevice::GetKeyButton(int vk) const
+{
+	size_t index = ::GetKeyButtonIndex(vk);
+	return index != ff::INVALID_SIZE && _state._keyButtons[index];
+}
+
+int ReplayJoystickDevice::GetKeyButtonPressCount(int vk) const
+{
+	size_t index = ::GetKeyButtonIndex(vk);
+	return index != ff::INVALID_SIZE ? _state._keyButtonPresses[index] : 0;
+}
+
+ff::String ReplayJoystickDevice::GetKeyButtonName(int vk) const
+{
+	return ff::String();
+}
+
+static void TakeSnapshot(ff::IKeyboardDevice* device, KeyboardSnapshot& state)
+{
+	ff::ZeroObject(state);
+
+	for (int i = 0; i < KEY_COUNT; i++)
+	{
+		state._keys[i] = device->GetKey(i);
+		state._presses[i] = ::ToByte(device->GetKeyPressCount(i));
+	}
+}
+
+static void TakeSnapshot(ff::IPointerDevice* device, PointerSnapshot& state)
+{
+	ff::ZeroObject(state);
+
+	state._pos = device->GetPos();
+	state._relativePos = device->GetRelativePos();
+	state._wheel = device->GetWheelScroll();
+	state._inWindow = device->IsInWindow();
+
+	for (int vk : ::POINTER_BUTTONS)
+	{
+		state._buttons[vk] = device->GetButton(vk);
+		state._clicks[vk] = ::ToByte(device->GetButtonClickCount(vk));
+		state._releases[vk] = ::ToByte(device->GetButtonReleaseCount(vk));
+		state._doubleClicks[vk] = ::ToByte(device->GetButtonDoubleClickCount(vk));
+	}
+}
+
+static void TakeSnapshot(ff::IJoystickDevice* device, JoystickSnapshot& state)
+{
+	ff::ZeroObject(state);
+
+	state._connected = device->IsConnected();
+	state._stickCount = (BYTE)std::min(device->GetStickCount(), MAX_STICKS);
+	state._dpadCount = (BYTE)std::min(device->GetDPadCount(), MAX_DPADS);
+	state._triggerCount = (BYTE)std::min(device->GetTriggerCount(), MAX_TRIGGERS);
+	state._buttonCount = (BYTE)std::min(device->GetButtonCount(), MAX_BUTTONS);
+
+	for (size_t i = 0; i < state._stickCount; i++)
+	{
+		state._sticks[i] = device->GetStickPos(i, false);
+		state._digitalSticks[i] = device->GetStickPos(i, true);
+		state._stickPresses[i] = device->GetStickPressCount(i);
+	}
+
+	for (size_t i = 0; i < state._dpadCount; i++)
+	{
+		state._dpads[i] = device->GetDPadPos(i);
+		state._dpadPresses[i] = device->GetDPadPressCount(i);
+	}
+
+	for (size_t i = 0; i < state._triggerCount; i++)
+	{
+		state._triggers[i] = device->GetTrigger(i, false);
+		state._digitalTriggers[i] = device->GetTrigger(i, true);
+		state._triggerPresses[i] = ::ToByte(device->GetTriggerPressCount(i));
+	}
+
+	for (size_t i = 0; i < state._buttonCount; i++)
+	{
+		state._buttons[i] = device->GetButton(i);
+		state._buttonPresses[i] = ::ToByte(device->GetButtonPressCount(i));
+	}
+
+	for (size_t i = 0; i < KEY_BUTTON_COUNT; i++)
+	{
+		int vk = KEY_BUTTON_FIRST + (int)i;
+		if (device->HasKeyButton(vk))
+		{
+			state._hasKeyButtons[i] = true;
+			state._keyButtons[i] = device->GetKeyButton(vk);
+			state._keyButtonPresses[i] = ::ToByte(device->GetKeyButtonPressCount(vk));
+		}
+	}
+}
+
+static void WriteSize(ff::Vector<BYTE>& buffer, size_t value)
+{
+	do
+	{
+		BYTE byte = (BYTE)(value & 0x7F);
+		value >>= 7;
+		buffer.Push(byte | (value ? 0x80 : 0));
+	}
+	while (value);
+}
+
+static void WriteBytes(ff::Vector<BYTE>& buffer, const void* data, size_t size)
+{
+	buffer.Push(reinterpret_cast<const BYTE*>(data), size);
+}
+
+static bool ReadSize(ff::IDataReader* reader, size_t& value)
+{
+	value = 0;
+
+	for (size_t shift = 0; shift < sizeof(size_t) * 8; shift += 7)
+	{
+		const BYTE* byte = reader->Read(1);
+		assertRetVal(byte, false);
+
+		value |= (size_t)(*byte & 0x7F) << shift;
+		noAssertRetVal(*byte & 0x80, true);
+	}
+
+	assertRetVal(false, false);
+}
+
+static bool ReadBytes(ff::IDataReader* reader, void* data, size_t size)
+{
+	const BYTE* bytes = size ? reader->Read(size) : nullptr;
+	assertRetVal(bytes || !size, false);
+
+	if (size)
+	{
+		std::memcpy(data, bytes, size);
+	}
+
+	return true;
+}
+
+// Writes runs of bytes that changed since the previous snapshot as (skip, count, bytes), and ends with a zero count.
+// Runs that are only split by a couple of unchanged bytes get merged.
+static void WriteDelta(ff::Vector<BYTE>& buffer, BYTE* prev, const void* cur, size_t size)
+{
+	const BYTE* bytes = reinterpret_cast<const BYTE*>(cur);
+
+	for (size_t pos = 0; pos < size; )
+	{
+		size_t start = pos;
+		while (start < size && prev[start] == bytes[start])
+		{
+			start++;
+		}
+
+		if (start == size)
+		{
+			break;
+		}
+
+		size_t end = start;
+		for (size_t same = 0; end + same < size && same < 3; )
+		{
+			if (prev[end + same] != bytes[end + same])
+			{
+				end += same + 1;
+				same = 0;
+			}
+			else
+			{
+				same++;
+			}
+		}
+
+		::WriteSize(buffer, start - pos);
+		::WriteSize(buffer, end - start);
+		::WriteBytes(buffer, bytes + start, end - start);
+		pos = end;
+	}
+
+	::WriteSize(buffer, 0);
+	::WriteSize(buffer, 0);
+
+	std::memcpy(prev, bytes, size);
+}
+
+static bool ReadDelta(ff::IDataReader* reader, void* state, size_t size)
+{
+	BYTE* bytes = reinterpret_cast<BYTE*>(state);
+
+	for (size_t pos = 0; ; )
+	{
+		size_t skip, count;
+		assertRetVal(::ReadSize(reader, skip) && ::ReadSize(reader, count), false);
+		noAssertRetVal(count, true);
+
+		pos += skip;
+		assertRetVal(pos + count <= size && ::ReadBytes(reader, bytes + pos, count), false);
+		pos += count;
+	}
+}
+
+template<typename TSnapshot>
+static BYTE* GetSnapshots(ff::Vector<BYTE>& snapshots, size_t count)
+{
+	// New devices are compared to a zeroed snapshot
+	size_t oldSize = snapshots.Size();
+	size_t newSize = count * sizeof(TSnapshot);
+	snapshots.Resize(newSize);
+
+	if (newSize > oldSize)
+	{
+		std::memset(snapshots.Data() + oldSize, 0, newSize - oldSize);
+	}
+
+	return snapshots.Data();
+}
+
+template<typename TDevice, typename TInterface>
+static bool ResizeDevices(ff::Vector<ff::ComPtr<TInterface>>& devices, size_t count)
+{
+	assertRetVal(count <= MAX_DEVICES, false);
+
+	while (devices.Size() > count)
+	{
+		devices.Pop();
+	}
+
+	while (devices.Size() < count)
+	{
+		ff::ComPtr<TDevice, TInterface> device;
+		assertHrRetVal(ff::ComAllocator<TDevice>::CreateInstance(&device), false);
+		devices.Push(device.Object());
+	}
+
+	return true;
+}
+
+ff::InputRecorder::InputRecorder(IDataWriter* writer)
+	: _writer(writer)
+	, _frameCount(0)
+{
+	assert(writer);
+}
+
+ff::InputRecorder::~InputRecorder()
+{
+}
+
+bool ff::InputRecorder::RecordFrame(const InputDevices& devices, const Vector<InputEvent>& events, double deltaTime)
+{
+	assertRetVal(_writer, false);
+	_buffer.Clear();
+
+	if (!_frameCount)
+	{
+		::WriteBytes(_buffer, &::REPLAY_MAGIC, sizeof(::REPLAY_MAGIC));
+		::WriteBytes(_buffer, &::REPLAY_VERSION, sizeof(::REPLAY_VERSION));
+	}
+
+	::WriteBytes(_buffer, &deltaTime, sizeof(deltaTime));
+	::WriteSize(_buffer, devices._keys.Size());
+	::WriteSize(_buffer, devices._mice.Size());
+	::WriteSize(_buffer, devices._joys.Size());
+
+	BYTE* keyboards = ::GetSnapshots<KeyboardSnapshot>(_keyboards, devices._keys.Size());
+	for (size_t i = 0; i < devices._keys.Size(); i++)
+	{
+		KeyboardSnapshot state;
+		::TakeSnapshot(devices._keys[i], state);
+		::WriteDelta(_buffer, keyboards + i * sizeof(state), &state, sizeof(state));
+
+		ff::String chars = devices._keys[i]->GetChars();
+		::WriteSize(_buffer, chars.size());
+		::WriteBytes(_buffer, chars.c_str(), chars.size() * sizeof(wchar_t));
+	}
+
+	BYTE* pointers = ::GetSnapshots<PointerSnapshot>(_pointers, devices._mice.Size());
+	for (size_t i = 0; i < devices._mice.Size(); i++)
+	{
+		PointerSnapshot state;
+		::TakeSnapshot(devices._mice[i], state);
+		::WriteDelta(_buffer, pointers + i * sizeof(state), &state, sizeof(state));
+
+		size_t touchCount = devices._mice[i]->GetTouchCount();
+		::WriteSize(_buffer, touchCount);
+
+		for (size_t h = 0; h < touchCount; h++)
+		{
+			// Copy field by field so the padding stays zero and the same input always writes the same bytes
+			const ff::TouchInfo& source = devices._mice[i]->GetTouchInfo(h);
+			ff::TouchInfo info;
+			ff::ZeroObject(info);
+			info.type = source.type;
+			info.startPos = source.startPos;
+			info.pos = source.pos;
+			info.id = source.id;
+			info.counter = source.counter;
+			info.vk = source.vk;
+			::WriteBytes(_buffer, &info, sizeof(info));
+		}
+	}
+
+	BYTE* joysticks = ::GetSnapshots<JoystickSnapshot>(_joysticks, devices._joys.Size());
+	for (size_t i = 0; i < devices._joys.Size(); i++)
+	{
+		JoystickSnapshot state;
+		::TakeSnapshot(devices._joys[i], state);
+		::WriteDelta(_buffer, joysticks + i * sizeof(state), &state, sizeof(state));
+	}
+
+	::WriteSize(_buffer, events.Size());
+	for (const ff::InputEvent& event : events)
+	{
+		::WriteBytes(_buffer, &event._eventID, sizeof(event._eventID));
+		::WriteSize(_buffer, (size_t)std::max(event._count, 0));
+	}
+
+	assertRetVal(_writer->Write(_buffer.Data(), _buffer.Size()), false);
+	_frameCount++;
+
+	return true;
+}
+
+size_t ff::InputRecorder::GetFrameCount() const
+{
+	return _frameCount;
+}
+
+ff::InputReplay::InputReplay(IDataReader* reader)
+	: _reader(reader)
+	, _frameCount(0)
+	, _deltaTime(0)
+	, _readHeader(false)
+	, _valid(reader != nullptr)
+{
+	assert(reader);
+}
+
+ff::InputReplay::~InputReplay()
+{
+}
+
+bool ff::InputReplay::Advance()
+{
+	noAssertRetVal(_valid, false);
+
+	if (!_readHeader)
+	{
+		_readHeader = true;
+		_valid = ReadHeader();
+		noAssertRetVal(_valid, false);
+	}
+
+	_events.Clear();
+	noAssertRetVal(_reader->GetPos() < _reader->GetSize(), false);
+
+	_valid = ReadFrame();
+	noAssertRetVal(_valid, false);
+
+	_frameCount++;
+	return true;
+}
+
+size_t ff::InputReplay::GetFrameCount() const
+{
+	return _frameCount;
+}
+
+double ff::InputReplay::GetDeltaTime() const
+{
+	return _deltaTime;
+}
+
+const ff::InputDevices& ff::InputReplay::GetDevices() const
+{
+	return _devices;
+}
+
+const ff::Vector<ff::InputEvent>& ff::InputReplay::GetRecordedEvents() const
+{
+	return _events;
+}
+
+bool ff::InputReplay::ReadHeader()
+{
+	DWORD magic = 0;
+	DWORD version = 0;
+	assertRetVal(ff::LoadData(_reader, magic) && ff::LoadData(_reader, version), false);
+	assertRetVal(magic == ::REPLAY_MAGIC && version == ::REPLAY_VERSION, false);
+
+	return true;
+}
+
+bool ff::InputReplay::ReadFrame()
+{
+	size_t keyCount, pointerCount, joyCount;
+	assertRetVal(ff::LoadData(_reader, _deltaTime), false);
+	assertRetVal(::ReadSize(_reader, keyCount) && ::ReadSize(_reader, pointerCount) && ::ReadSize(_reader, joyCount), false);
+
+	assertRetVal(::ResizeDevices<ReplayKeyboardDevice>(_devices._keys, keyCount), false);
+	for (size_t i = 0; i < keyCount; i++)
+	{
+		ReplayKeyboardDevice* device = static_cast<ReplayKeyboardDevice*>(_devices._keys[i].Object());
+		assertRetVal(::ReadDelta(_reader, &device->_state, sizeof(device->_state)), false);
+
+		size_t charCount;
+		assertRetVal(::ReadSize(_reader, charCount), false);
+		device->_chars.resize(charCount);
+		assertRetVal(::ReadBytes(_reader, &device->_chars[0], charCount * sizeof(wchar_t)), false);
+	}
+
+	assertRetVal(::ResizeDevices<ReplayPointerDevice>(_devices._mice, pointerCount), false);
+	for (size_t i = 0; i < pointerCount; i++)
+	{
+		ReplayPointerDevice* device = static_cast<ReplayPointerDevice*>(_devices._mice[i].Object());
+		assertRetVal(::ReadDelta(_reader, &device->_state, sizeof(device->_state)), false);
+
+		size_t touchCount;
+		assertRetVal(::ReadSize(_reader, touchCount), false);
+		device->_touches.Resize(touchCount);
+		assertRetVal(::ReadBytes(_reader, device->_touches.Data(), device->_touches.ByteSize()), false);
+	}
+
+	assertRetVal(::ResizeDevices<ReplayJoystickDevice>(_devices._joys, joyCount), false);
+	for (size_t i = 0; i < joyCount; i++)
+	{
+		ReplayJoystickDevice* device = static_cast<ReplayJoystickDevice*>(_devices._joys[i].Object());
+		assertRetVal(::ReadDelta(_reader, &device->_state, sizeof(device->_state)), false);
+	}
+
+	size_t eventCount;
+	assertRetVal(::ReadSize(_reader, eventCount), false);
+	for (size_t i = 0; i < eventCount; i++)
+	{
+		ff::InputEvent event;
+		size_t count;
+		assertRetVal(ff::LoadData(_reader, event._eventID) && ::ReadSize(_reader, count), false);
+
+		event._count = (int)count;
+		_events.Push(event);
+	}
+
+	return true;
+}
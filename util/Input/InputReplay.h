@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Input/InputMapping.h"
+
+namespace ff
+{
+	class IDataReader;
+	class IDataWriter;
+
+	// Writes the state of every input device once per advance, along with the events that an input mapping
+	// made from it. Each frame only stores the bytes that changed since the previous frame.
+	class InputRecorder
+	{
+	public:
+		UTIL_API InputRecorder(IDataWriter* writer);
+		UTIL_API ~InputRecorder();
+
+		// Call after the devices and the input mapping have advanced
+		UTIL_API bool RecordFrame(const InputDevices& devices, const Vector<InputEvent>& events, double deltaTime);
+		UTIL_API size_t GetFrameCount() const;
+
+	private:
+		ComPtr<IDataWriter> _writer;
+		Vector<BYTE> _buffer;
+		Vector<BYTE> _keyboards; // previous frame's snapshots
+		Vector<BYTE> _pointers;
+		Vector<BYTE> _joysticks;
+		size_t _frameCount;
+	};
+
+	// Plays back a recording through fake keyboards, pointers, and joysticks. Pass GetDevices() and
+	// GetDeltaTime() to the input mapping to get the same events that were recorded.
+	class InputReplay
+	{
+	public:
+		UTIL_API InputReplay(IDataReader* reader);
+		UTIL_API ~InputReplay();
+
+		// Returns false at the end of the recording
+		UTIL_API bool Advance();
+		UTIL_API size_t GetFrameCount() const;
+		UTIL_API double GetDeltaTime() const;
+		UTIL_API const InputDevices& GetDevices() const;
+		UTIL_API const Vector<InputEvent>& GetRecordedEvents() const;
+
+	private:
+		bool ReadHeader();
+		bool ReadFrame();
+
+		ComPtr<IDataReader> _reader;
+		InputDevices _devices;
+		Vector<InputEvent> _events;
+		size_t _frameCount;
+		double _deltaTime;
+		bool _readHeader;
+		bool _valid;
+	};
+}
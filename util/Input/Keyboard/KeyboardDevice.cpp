@@ -2,8 +2,10 @@
 #include "COM/ComAlloc.h"
 #include "Globals/ThreadGlobals.h"
 #include "Input/DeviceEvent.h"
+#include "Input/InputEventQueue.h"
 #include "Input/Keyboard/KeyboardDevice.h"
 #include "Module/Module.h"
+#include "Types/Timer.h"
 #include "Windows/WinUtil.h"
 
 #if !METRO_APP
@@ -41,19 +43,34 @@ public:
 private:
 	static const size_t KEY_COUNT = 256;
 
+	static const size_t QUEUE_SIZE = 256;
+
 	struct KeyInfo
 	{
 		BYTE _keys[KEY_COUNT];
 		BYTE _presses[KEY_COUNT];
 	};
 
-	ff::Mutex _mutex;
+	// Window messages are queued as-is and only looked at by the game thread
+	struct KeyEvent
+	{
+		UINT _msg; // WM_NULL means KillPending
+		WPARAM _wParam;
+		LPARAM _lParam;
+	};
+
+	void ApplyEvent(const KeyEvent& event, INT64 time);
+	void ReleaseKeys(INT64 time);
+	void AddSinkEvent(ff::DeviceEvent event, INT64 time);
+
+	ff::InputEventQueue<KeyEvent> _queue;
 	ff::ComPtr<ff::IDeviceEventSink> _sink;
 	HWND _hwnd;
 	KeyInfo _keyInfo;
 	KeyInfo _pendingKeyInfo;
 	ff::String _text;
 	ff::String _textPending;
+	size_t _overflowCount;
 };
 
 BEGIN_INTERFACES(KeyboardDevice)
@@ -76,7 +93,9 @@ bool ff::CreateKeyboardDevice(HWND hwnd, ff::IKeyboardDevice **ppInput)
 }
 
 KeyboardDevice::KeyboardDevice()
-	: _hwnd(nullptr)
+	: _queue(QUEUE_SIZE)
+	, _hwnd(nullptr)
+	, _overflowCount(0)
 {
 	ff::ZeroObject(_keyInfo);
 	ff::ZeroObject(_pendingKeyInfo);
@@ -108,7 +127,18 @@ void KeyboardDevice::Destroy()
 
 void KeyboardDevice::Advance()
 {
-	ff::LockMutex lock(_mutex);
+	_queue.Drain([this](const KeyEvent& event, INT64 time)
+		{
+			ApplyEvent(event, time);
+		});
+
+	// Key ups may have been dropped, so don't leave anything stuck down
+	size_t overflowCount = _queue.GetOverflowCount();
+	if (overflowCount != _overflowCount)
+	{
+		_overflowCount = overflowCount;
+		ReleaseKeys(ff::Timer::GetCurrentRawTime());
+	}
 
 	_text = std::move(_textPending);
 	_keyInfo = _pendingKeyInfo;
@@ -117,27 +147,7 @@ void KeyboardDevice::Advance()
 
 void KeyboardDevice::KillPending()
 {
-	ff::Vector<ff::DeviceEvent, 16> deviceEvents;
-	{
-		ff::LockMutex lock(_mutex);
-
-		for (unsigned int i = 0; i < _countof(_pendingKeyInfo._keys); i++)
-		{
-			if (_pendingKeyInfo._keys[i])
-			{
-				_pendingKeyInfo._keys[i] = false;
-				deviceEvents.Push(ff::DeviceEventKeyPress(i, 0));
-			}
-		}
-	}
-
-	if (_sink)
-	{
-		for (const ff::DeviceEvent& deviceEvent : deviceEvents)
-		{
-			_sink->AddEvent(deviceEvent);
-		}
-	}
+	_queue.Push(KeyEvent{ WM_NULL, 0, 0 }, ff::Timer::GetCurrentRawTime());
 }
 
 bool KeyboardDevice::IsConnected() const
@@ -181,55 +191,77 @@ bool KeyboardDevice::ListenWindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
 		break;
 
 	case WM_KEYDOWN:
-		if (wParam >= 0 && wParam < KEY_COUNT)
+	case WM_KEYUP:
+	case WM_CHAR:
+		_queue.Push(KeyEvent{ msg, wParam, lParam }, ff::Timer::GetCurrentRawTime());
+		break;
+	}
+
+	return false;
+}
+
+void KeyboardDevice::ApplyEvent(const KeyEvent& event, INT64 time)
+{
+	switch (event._msg)
+	{
+	case WM_NULL:
+		ReleaseKeys(time);
+		break;
+
+	case WM_KEYDOWN:
+		if (event._wParam >= 0 && event._wParam < KEY_COUNT)
 		{
-			if (_sink)
-			{
-				_sink->AddEvent(ff::DeviceEventKeyPress((unsigned int)wParam, (int)(lParam & 0xFFFF)));
-			}
+			AddSinkEvent(ff::DeviceEventKeyPress((unsigned int)event._wParam, (int)(event._lParam & 0xFFFF)), time);
 
-			if (!(lParam & 0x40000000)) // wasn't already down
+			if (!(event._lParam & 0x40000000)) // wasn't already down
 			{
-				ff::LockMutex lock(_mutex);
-
-				if (_pendingKeyInfo._presses[wParam] != 0xFF)
+				if (_pendingKeyInfo._presses[event._wParam] != 0xFF)
 				{
-					_pendingKeyInfo._presses[wParam]++;
+					_pendingKeyInfo._presses[event._wParam]++;
 				}
 
-				_pendingKeyInfo._keys[wParam] = true;
+				_pendingKeyInfo._keys[event._wParam] = true;
 			}
 		}
 		break;
 
 	case WM_KEYUP:
-		if (wParam >= 0 && wParam < KEY_COUNT)
+		if (event._wParam >= 0 && event._wParam < KEY_COUNT)
 		{
-			if (_sink)
-			{
-				_sink->AddEvent(ff::DeviceEventKeyPress((int)wParam, 0));
-			}
-
-			ff::LockMutex lock(_mutex);
-			_pendingKeyInfo._keys[wParam] = false;
+			AddSinkEvent(ff::DeviceEventKeyPress((unsigned int)event._wParam, 0), time);
+			_pendingKeyInfo._keys[event._wParam] = false;
 		}
 		break;
 
 	case WM_CHAR:
-		if (wParam)
+		if (event._wParam)
 		{
-			if (_sink)
-			{
-				_sink->AddEvent(ff::DeviceEventKeyChar((wchar_t)wParam));
-			}
-
-			ff::LockMutex lock(_mutex);
-			_textPending.append(1, (wchar_t)wParam);
+			AddSinkEvent(ff::DeviceEventKeyChar((wchar_t)event._wParam), time);
+			_textPending.append(1, (wchar_t)event._wParam);
 		}
 		break;
 	}
+}
 
-	return false;
+void KeyboardDevice::ReleaseKeys(INT64 time)
+{
+	for (unsigned int i = 0; i < _countof(_pendingKeyInfo._keys); i++)
+	{
+		if (_pendingKeyInfo._keys[i])
+		{
+			_pendingKeyInfo._keys[i] = false;
+			AddSinkEvent(ff::DeviceEventKeyPress(i, 0), time);
+		}
+	}
+}
+
+void KeyboardDevice::AddSinkEvent(ff::DeviceEvent event, INT64 time)
+{
+	if (_sink)
+	{
+		event._time = time;
+		_sink->AddEvent(event);
+	}
 }
 
 #endif // !METRO_APP
@@ -3,9 +3,11 @@
 #include "Globals/AppGlobals.h"
 #include "Globals/ThreadGlobals.h"
 #include "Input/DeviceEvent.h"
+#include "Input/InputEventQueue.h"
 #include "Input/InputMapping.h"
 #include "Input/Pointer/PointerDevice.h"
 #include "Module/Module.h"
+#include "Types/Timer.h"
 #include "Windows/WinUtil.h"
 
 #if !METRO_APP
@@ -51,8 +53,41 @@ public:
 	virtual bool ListenWindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam, LRESULT& nResult) override;
 
 private:
+	static const size_t QUEUE_SIZE = 1024;
+
+	enum class PointerEventType
+	{
+		KillPending,
+		MouseButton,
+		MouseMove,
+		MouseLeave,
+		MouseWheelX,
+		MouseWheelY,
+		TouchDown,
+		TouchUpdate,
+		TouchUp,
+	};
+
+	// Everything that needs the window is resolved on the window thread before the event is queued
+	struct PointerEvent
+	{
+		PointerEventType _type;
+		unsigned int _id; // mouse button or pointer ID
+		int _count; // presses or wheel delta
+		ff::PointInt _pos;
+		ff::InputDevice _device;
+		unsigned int _vk; // button held by a pointer
+	};
+
 	void OnMouseMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 	void OnPointerMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	bool GetPointerEvent(WPARAM wp, LPARAM lp, PointerEvent& event) const;
+	void PushEvent(const PointerEvent& event);
+
+	void ApplyEvent(const PointerEvent& event, INT64 time);
+	void ApplyTouchEvent(const PointerEvent& event, INT64 time);
+	void ReleaseAll(INT64 time);
+	void AddSinkEvent(ff::DeviceEvent event, INT64 time);
 
 	struct MouseInfo
 	{
@@ -77,16 +112,19 @@ private:
 		ff::TouchInfo info;
 	};
 
-	InternalTouchInfo* FindTouchInfo(WPARAM wp, LPARAM lp, bool allowCreate);
-	void UpdateTouchInfo(InternalTouchInfo& info, WPARAM wp, LPARAM lp);
+	// Window thread
+	ff::InputEventQueue<PointerEvent> _queue;
+	HWND _hwnd;
+	bool _windowButtons[MouseInfo::BUTTON_COUNT];
+	bool _windowInside;
 
-	ff::Mutex _mutex;
+	// Game thread
 	ff::ComPtr<ff::IDeviceEventSink> _sink;
-	HWND _hwnd;
 	MouseInfo _mouse;
 	MouseInfo _pendingMouse;
 	ff::Vector<InternalTouchInfo> _touches;
 	ff::Vector<InternalTouchInfo> _pendingTouches;
+	size_t _overflowCount;
 	bool _insideWindow;
 	bool _pendingInsideWindow;
 };
@@ -111,10 +149,14 @@ bool ff::CreatePointerDevice(HWND hwnd, ff::IPointerDevice** ppInput)
 }
 
 PointerDevice::PointerDevice()
-	: _hwnd(nullptr)
+	: _queue(QUEUE_SIZE)
+	, _hwnd(nullptr)
+	, _windowInside(false)
+	, _overflowCount(0)
 	, _insideWindow(false)
 	, _pendingInsideWindow(false)
 {
+	ff::ZeroObject(_windowButtons);
 	ff::ZeroObject(_mouse);
 	ff::ZeroObject(_pendingMouse);
 }
@@ -148,7 +190,18 @@ void PointerDevice::Destroy()
 
 void PointerDevice::Advance()
 {
-	ff::LockMutex lock(_mutex);
+	_queue.Drain([this](const PointerEvent& event, INT64 time)
+		{
+			ApplyEvent(event, time);
+		});
+
+	// Button and touch releases may have been dropped, so don't leave anything stuck down
+	size_t overflowCount = _queue.GetOverflowCount();
+	if (overflowCount != _overflowCount)
+	{
+		_overflowCount = overflowCount;
+		ReleaseAll(ff::Timer::GetCurrentRawTime());
+	}
 
 	for (InternalTouchInfo& info : _pendingTouches)
 	{
@@ -168,43 +221,11 @@ void PointerDevice::Advance()
 
 void PointerDevice::KillPending()
 {
-	ff::Vector<ff::DeviceEvent, 8> deviceEvents;
-	{
-		ff::LockMutex lock(_mutex);
-
-		for (unsigned int i = 0; i < MouseInfo::BUTTON_COUNT; i++)
-		{
-			if (_pendingMouse._buttons[i])
-			{
-				_pendingMouse._buttons[i] = false;
-
-				if (_pendingMouse._releases[i] != 0xFF)
-				{
-					_pendingMouse._releases[i]++;
-				}
-
-				deviceEvents.Push(ff::DeviceEventMousePress(i, 0, _pendingMouse._pos.ToType<int>()));
-			}
-		}
-
-		for (const InternalTouchInfo& info : _pendingTouches)
-		{
-			if (info.info.type != ff::INPUT_DEVICE_MOUSE)
-			{
-				deviceEvents.Push(ff::DeviceEventTouchPress(info.info.id, 0, info.info.pos.ToType<int>()));
-			}
-		}
-
-		_pendingTouches.Clear();
-	}
+	ff::ZeroObject(_windowButtons);
 
-	if (_sink)
-	{
-		for (const ff::DeviceEvent& deviceEvent : deviceEvents)
-		{
-			_sink->AddEvent(deviceEvent);
-		}
-	}
+	PointerEvent event{};
+	event._type = PointerEventType::KillPending;
+	PushEvent(event);
 }
 
 bool PointerDevice::IsConnected() const
@@ -316,10 +337,10 @@ void PointerDevice::OnMouseMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 	bool notifyMouseLeave = false;
 	unsigned int nPresses = 0;
 	unsigned int vkButton = 0;
-	ff::PointInt mousePos(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-	ff::DeviceEvent deviceEvent(ff::DeviceEventType::None);
 
-	ff::LockMutex lock(_mutex);
+	PointerEvent event{};
+	event._type = PointerEventType::MouseMove;
+	event._pos = ff::PointInt(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 
  	switch (msg)
 	{
@@ -409,85 +430,47 @@ void PointerDevice::OnMouseMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 		break;
 
 	case WM_MOUSEWHEEL:
-		_pendingMouse._wheel.y += GET_WHEEL_DELTA_WPARAM(wParam);
-		deviceEvent = ff::DeviceEventMouseWheelY(GET_WHEEL_DELTA_WPARAM(wParam), mousePos);
+		event._type = PointerEventType::MouseWheelY;
+		event._count = GET_WHEEL_DELTA_WPARAM(wParam);
 		break;
 
 	case WM_MOUSEHWHEEL:
-		_pendingMouse._wheel.x += GET_WHEEL_DELTA_WPARAM(wParam);
-		deviceEvent = ff::DeviceEventMouseWheelX(GET_WHEEL_DELTA_WPARAM(wParam), mousePos);
+		event._type = PointerEventType::MouseWheelX;
+		event._count = GET_WHEEL_DELTA_WPARAM(wParam);
 		break;
 
 	case WM_MOUSEMOVE:
-		deviceEvent = ff::DeviceEventMouseMove(mousePos);
-
-		if (!_pendingInsideWindow)
+		if (!_windowInside)
 		{
 			notifyMouseLeave = true;
-			_pendingInsideWindow = true;
+			_windowInside = true;
 		}
 		break;
 
 	case WM_MOUSELEAVE:
-		_pendingInsideWindow = false;
+		event._type = PointerEventType::MouseLeave;
+		_windowInside = false;
 		break;
-	}
-
-	if (vkButton)
-	{
-		switch (nPresses)
-		{
-		case 2:
-			if (_pendingMouse._doubleClicks[vkButton] != 0xFF)
-			{
-				_pendingMouse._doubleClicks[vkButton]++;
-			}
-			__fallthrough;
-
-		case 1:
-			_pendingMouse._buttons[vkButton] = true;
-
-			if (_pendingMouse._clicks[vkButton] != 0xFF)
-			{
-				_pendingMouse._clicks[vkButton]++;
-			}
-			break;
-
-		case 0:
-			_pendingMouse._buttons[vkButton] = false;
 
-			if (_pendingMouse._releases[vkButton] != 0xFF)
-			{
-				_pendingMouse._releases[vkButton]++;
-			}
-			break;
-		}
-
-		deviceEvent = ff::DeviceEventMousePress(vkButton, nPresses, mousePos);
+	default:
+		return;
 	}
 
-	if (vkButton || msg == WM_MOUSEMOVE)
+	if (!vkButton && event._type == PointerEventType::MouseMove && msg != WM_MOUSEMOVE)
 	{
-		_pendingMouse._pos = mousePos.ToType<double>();
-		_pendingMouse._posRelative = _pendingMouse._pos - _mouse._pos;
+		// X buttons that don't exist
+		return;
 	}
 
-	bool allButtonsUp = true;
-	for (size_t i = 0; i < MouseInfo::BUTTON_COUNT; i++)
+	if (vkButton)
 	{
-		if (_pendingMouse._buttons[i])
-		{
-			allButtonsUp = false;
-			break;
-		}
+		event._type = PointerEventType::MouseButton;
+		event._id = vkButton;
+		event._count = (int)nPresses;
+		_windowButtons[vkButton] = (nPresses != 0);
 	}
 
-	lock.Unlock();
-
-	if (_sink)
-	{
-		_sink->AddEvent(deviceEvent);
-	}
+	PushEvent(event);
 
 	if (notifyMouseLeave)
 	{
@@ -501,6 +484,16 @@ void PointerDevice::OnMouseMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 
 	if (vkButton)
 	{
+		bool allButtonsUp = true;
+		for (size_t i = 0; i < MouseInfo::BUTTON_COUNT; i++)
+		{
+			if (_windowButtons[i])
+			{
+				allButtonsUp = false;
+				break;
+			}
+		}
+
 		if (nPresses)
 		{
 			if (::GetCapture() != hwnd)
@@ -521,145 +514,260 @@ void PointerDevice::OnMouseMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 
 void PointerDevice::OnPointerMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-	ff::DeviceEvent deviceEvent(ff::DeviceEventType::None);
-	InternalTouchInfo* info = nullptr;
-
-	ff::LockMutex lock(_mutex);
+	PointerEvent event{};
 
 	switch (msg)
 	{
 	case WM_POINTERDOWN:
-		if ((info = FindTouchInfo(wParam, lParam, true)) != nullptr)
-		{
-			deviceEvent = ff::DeviceEventTouchPress(info->info.id, 1, info->info.pos.ToType<int>());
-		}
+		event._type = PointerEventType::TouchDown;
 		break;
 
 	case WM_POINTERUPDATE:
-		if ((info = FindTouchInfo(wParam, lParam, false)) != nullptr)
-		{
-			deviceEvent = ff::DeviceEventTouchMove(info->info.id, info->info.pos.ToType<int>());
-		}
+		event._type = PointerEventType::TouchUpdate;
 		break;
 
 	case WM_POINTERUP:
 	case WM_POINTERCAPTURECHANGED:
-		if ((info = FindTouchInfo(wParam, lParam, false)) != nullptr)
-		{
-			_pendingTouches.Delete(info - _pendingTouches.Data());
-			deviceEvent = ff::DeviceEventTouchPress(info->info.id, 0, info->info.pos.ToType<int>());
-		}
+		event._type = PointerEventType::TouchUp;
 		break;
-	}
-
-	lock.Unlock();
-
-	if (_sink && info && info->info.type != ff::INPUT_DEVICE_MOUSE)
-	{
-		_sink->AddEvent(deviceEvent);
-	}
-}
-
-size_t PointerDevice::GetTouchCount() const
-{
-	return _touches.Size();
-}
-
-const ff::TouchInfo& PointerDevice::GetTouchInfo(size_t index) const
-{
-	return _touches[index].info;
-}
-
-void PointerDevice::SetSink(ff::IDeviceEventSink* sink)
-{
-	_sink = sink;
-}
 
-PointerDevice::InternalTouchInfo* PointerDevice::FindTouchInfo(WPARAM wp, LPARAM lp, bool allowCreate)
-{
-	unsigned int id = GET_POINTERID_WPARAM(wp);
-
-	for (InternalTouchInfo& info : _pendingTouches)
-	{
-		if (id == info.info.id)
-		{
-			UpdateTouchInfo(info, wp, lp);
-			return &info;
-		}
+	default:
+		return;
 	}
 
-	if (allowCreate)
+	if (GetPointerEvent(wParam, lParam, event))
 	{
-		InternalTouchInfo newInfo;
-		UpdateTouchInfo(newInfo, wp, lp);
-		newInfo.info.startPos = newInfo.info.pos;
-		_pendingTouches.Push(newInfo);
-		return &_pendingTouches.GetLast();
+		PushEvent(event);
 	}
-
-	return nullptr;
 }
 
-void PointerDevice::UpdateTouchInfo(InternalTouchInfo& info, WPARAM wp, LPARAM lp)
+bool PointerDevice::GetPointerEvent(WPARAM wp, LPARAM lp, PointerEvent& event) const
 {
-	ff::InputDevice type = ff::INPUT_DEVICE_NULL;
-	unsigned int id = GET_POINTERID_WPARAM(wp);
-	unsigned int vk = 0;
-
-	ff::PointInt pos(GET_X_LPARAM(lp), GET_Y_LPARAM(lp));
-	assertRet(::ScreenToClient(_hwnd, (LPPOINT)&pos));
+	event._id = GET_POINTERID_WPARAM(wp);
+	event._pos = ff::PointInt(GET_X_LPARAM(lp), GET_Y_LPARAM(lp));
+	assertRetVal(::ScreenToClient(_hwnd, (LPPOINT)&event._pos), false);
 
 	POINTER_INFO idInfo;
-	assertRet(::GetPointerInfo(id, &idInfo));
+	assertRetVal(::GetPointerInfo(event._id, &idInfo), false);
 
 	switch (idInfo.pointerType)
 	{
 	case PT_POINTER:
-		type = ff::INPUT_DEVICE_POINTER;
+		event._device = ff::INPUT_DEVICE_POINTER;
 		break;
 
 	case PT_TOUCH:
-		type = ff::INPUT_DEVICE_TOUCH;
+		event._device = ff::INPUT_DEVICE_TOUCH;
 		break;
 
 	case PT_PEN:
-		type = ff::INPUT_DEVICE_PEN;
+		event._device = ff::INPUT_DEVICE_PEN;
 		break;
 
 	case PT_MOUSE:
-		type = ff::INPUT_DEVICE_MOUSE;
+		event._device = ff::INPUT_DEVICE_MOUSE;
 		break;
 
 	case PT_TOUCHPAD:
-		type = ff::INPUT_DEVICE_TOUCHPAD;
+		event._device = ff::INPUT_DEVICE_TOUCHPAD;
+		break;
+
+	default:
+		event._device = ff::INPUT_DEVICE_NULL;
 		break;
 	}
 
 	if (IS_POINTER_FIRSTBUTTON_WPARAM(wp))
 	{
-		vk = VK_LBUTTON;
+		event._vk = VK_LBUTTON;
 	}
 	else if (IS_POINTER_SECONDBUTTON_WPARAM(wp))
 	{
-		vk = VK_RBUTTON;
+		event._vk = VK_RBUTTON;
 	}
 	else if (IS_POINTER_THIRDBUTTON_WPARAM(wp))
 	{
-		vk = VK_MBUTTON;
+		event._vk = VK_MBUTTON;
 	}
 	else if (IS_POINTER_FOURTHBUTTON_WPARAM(wp))
 	{
-		vk = VK_XBUTTON1;
+		event._vk = VK_XBUTTON1;
 	}
 	else if (IS_POINTER_FIFTHBUTTON_WPARAM(wp))
 	{
-		vk = VK_XBUTTON2;
+		event._vk = VK_XBUTTON2;
+	}
+
+	return true;
+}
+
+void PointerDevice::PushEvent(const PointerEvent& event)
+{
+	_queue.Push(event, ff::Timer::GetCurrentRawTime());
+}
+
+void PointerDevice::ApplyEvent(const PointerEvent& event, INT64 time)
+{
+	switch (event._type)
+	{
+	case PointerEventType::KillPending:
+		ReleaseAll(time);
+		break;
+
+	case PointerEventType::MouseButton:
+		switch (event._count)
+		{
+		case 2:
+			if (_pendingMouse._doubleClicks[event._id] != 0xFF)
+			{
+				_pendingMouse._doubleClicks[event._id]++;
+			}
+			__fallthrough;
+
+		case 1:
+			_pendingMouse._buttons[event._id] = true;
+
+			if (_pendingMouse._clicks[event._id] != 0xFF)
+			{
+				_pendingMouse._clicks[event._id]++;
+			}
+			break;
+
+		case 0:
+			_pendingMouse._buttons[event._id] = false;
+
+			if (_pendingMouse._releases[event._id] != 0xFF)
+			{
+				_pendingMouse._releases[event._id]++;
+			}
+			break;
+		}
+
+		_pendingMouse._pos = event._pos.ToType<double>();
+		_pendingMouse._posRelative = _pendingMouse._pos - _mouse._pos;
+		AddSinkEvent(ff::DeviceEventMousePress(event._id, event._count, event._pos), time);
+		break;
+
+	case PointerEventType::MouseMove:
+		_pendingInsideWindow = true;
+		_pendingMouse._pos = event._pos.ToType<double>();
+		_pendingMouse._posRelative = _pendingMouse._pos - _mouse._pos;
+		AddSinkEvent(ff::DeviceEventMouseMove(event._pos), time);
+		break;
+
+	case PointerEventType::MouseLeave:
+		_pendingInsideWindow = false;
+		break;
+
+	case PointerEventType::MouseWheelX:
+		_pendingMouse._wheel.x += event._count;
+		AddSinkEvent(ff::DeviceEventMouseWheelX(event._count, event._pos), time);
+		break;
+
+	case PointerEventType::MouseWheelY:
+		_pendingMouse._wheel.y += event._count;
+		AddSinkEvent(ff::DeviceEventMouseWheelY(event._count, event._pos), time);
+		break;
+
+	default:
+		ApplyTouchEvent(event, time);
+		break;
+	}
+}
+
+void PointerDevice::ApplyTouchEvent(const PointerEvent& event, INT64 time)
+{
+	InternalTouchInfo* info = nullptr;
+	for (InternalTouchInfo& i : _pendingTouches)
+	{
+		if (i.info.id == event._id)
+		{
+			info = &i;
+			break;
+		}
+	}
+
+	if (!info)
+	{
+		// Updates for pointers that went down before a KillPending are ignored
+		noAssertRet(event._type == PointerEventType::TouchDown);
+
+		InternalTouchInfo newInfo;
+		newInfo.info.startPos = event._pos.ToType<double>();
+		_pendingTouches.Push(newInfo);
+		info = &_pendingTouches.GetLast();
+	}
+
+	info->info.type = event._device;
+	info->info.id = event._id;
+	info->info.vk = event._vk;
+	info->info.pos = event._pos.ToType<double>();
+
+	ff::DeviceEvent deviceEvent = (event._type == PointerEventType::TouchUpdate)
+		? ff::DeviceEventTouchMove(event._id, event._pos)
+		: ff::DeviceEventTouchPress(event._id, event._type == PointerEventType::TouchDown ? 1 : 0, event._pos);
+
+	if (event._device != ff::INPUT_DEVICE_MOUSE)
+	{
+		AddSinkEvent(deviceEvent, time);
+	}
+
+	if (event._type == PointerEventType::TouchUp)
+	{
+		_pendingTouches.Delete(info - _pendingTouches.Data());
+	}
+}
+
+void PointerDevice::ReleaseAll(INT64 time)
+{
+	for (unsigned int i = 0; i < MouseInfo::BUTTON_COUNT; i++)
+	{
+		if (_pendingMouse._buttons[i])
+		{
+			_pendingMouse._buttons[i] = false;
+
+			if (_pendingMouse._releases[i] != 0xFF)
+			{
+				_pendingMouse._releases[i]++;
+			}
+
+			AddSinkEvent(ff::DeviceEventMousePress(i, 0, _pendingMouse._pos.ToType<int>()), time);
+		}
+	}
+
+	for (const InternalTouchInfo& info : _pendingTouches)
+	{
+		if (info.info.type != ff::INPUT_DEVICE_MOUSE)
+		{
+			AddSinkEvent(ff::DeviceEventTouchPress(info.info.id, 0, info.info.pos.ToType<int>()), time);
+		}
+	}
+
+	_pendingTouches.Clear();
+}
+
+void PointerDevice::AddSinkEvent(ff::DeviceEvent event, INT64 time)
+{
+	if (_sink)
+	{
+		event._time = time;
+		_sink->AddEvent(event);
 	}
+}
+
+size_t PointerDevice::GetTouchCount() const
+{
+	return _touches.Size();
+}
+
+const ff::TouchInfo& PointerDevice::GetTouchInfo(size_t index) const
+{
+	return _touches[index].info;
+}
 
-	info.info.type = type;
-	info.info.id = id;
-	info.info.vk = vk;
-	info.info.pos = pos.ToType<double>();
+void PointerDevice::SetSink(ff::IDeviceEventSink* sink)
+{
+	_sink = sink;
 }
 
 #endif // !METRO_APP
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Globals/AppGlobals.h"
 #include "Globals/ProcessGlobals.h"
+#include "Globals/Profiler.h"
 #include "Module/ModuleFactory.h"
 #include "Resource/ResourcePersist.h"
 #include "Resource/Resources.h"
@@ -146,6 +147,7 @@ ff::SharedResourceValue Resources::GetResource(ff::StringRef name)
 
 		ff::GetThreadPool()->AddTask([this, keepAlive, keepName, keepInfo]()
 			{
+				PROFILE_ZONE(L"Load resource");
 				ff::ValuePtr newValue = CreateObjects(*keepInfo, keepInfo->_dictValue);
 				UpdateValueInfo(*keepInfo, std::make_shared<ff::ResourceValue>(newValue, keepName));
 			});
@@ -188,6 +190,7 @@ ff::SharedResourceValue Resources::FlushResource(ff::SharedResourceValue value)
 
 	if (loadEvent)
 	{
+		PROFILE_ZONE(L"Blocked on resource");
 		ff::WaitForHandle(loadEvent);
 
 		double seconds = timer.Tick();
@@ -1,5 +1,9 @@
 #include "pch.h"
+#include "Data/DataFile.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
 #include "Globals/MetroGlobals.h"
+#include "Globals/Profiler.h"
 #include "Graph/Anim/Transform.h"
 #include "Graph/Font/SpriteFont.h"
 #include "Graph/GraphDevice.h"
@@ -11,6 +15,7 @@
 #include "Input/Keyboard/KeyboardDevice.h"
 #include "Resource/ResourceValue.h"
 #include "Types/Timer.h"
+#include "Windows/FileUtil.h"
 
 static ff::hash_t EVENT_TOGGLE_NUMBERS = ff::HashStaticString(L"toggleNumbers");
 static ff::hash_t EVENT_NEXT_PAGE = ff::HashStaticString(L"nextPage");
@@ -28,7 +33,12 @@ static ff::hash_t EVENT_TOGGLE_9 = ff::HashStaticString(L"toggle9");
 static ff::hash_t EVENT_CUSTOM = ff::HashStaticString(L"customDebug");
 
 static ff::StaticString DEBUG_TOGGLE_CHARTS(L"Show FPS graph");
+static ff::StaticString DEBUG_TOGGLE_PROFILE(L"Profile zones");
+static ff::StaticString DEBUG_TOGGLE_PROFILE_CAPTURE(L"Capture frames to profile.json");
+static ff::StaticString DEBUG_TOGGLE_MEMORY_SNAPSHOT(L"Show changes since now");
 static ff::StaticString DEBUG_PAGE_NAME_0(L"Frame perf");
+static ff::StaticString DEBUG_PAGE_NAME_1(L"Profile zones");
+static ff::StaticString DEBUG_PAGE_NAME_2(L"Memory");
 
 ff::DebugPageState::DebugPageState(AppGlobals* globals)
 	: _globals(globals)
@@ -56,6 +66,10 @@ ff::DebugPageState::DebugPageState(AppGlobals* globals)
 	, _input(L"DebugPageInput")
 	, _render(globals->GetGraph()->CreateRenderer())
 	, _memStats{ 0 }
+	, _profileCapturePending(false)
+	, _memSnapshot{}
+	, _memBaseSnapshot{}
+	, _memHasBaseSnapshot(false)
 {
 	_inputDevices._keys.Push(globals->GetKeys());
 	_globals->AddDebugPage(this);
@@ -184,6 +198,11 @@ void ff::DebugPageState::OnFrameRendered(AppGlobals* globals, AdvanceType type,
 		break;
 	}
 
+	if (_profileCapturePending && !ff::IsProfileCapturing())
+	{
+		SaveProfileCaptureFile();
+	}
+
 	if (_enabledStats)
 	{
 		if (type != AdvanceType::Stopped)
@@ -253,7 +272,7 @@ void ff::DebugPageState::UpdateStats(AppGlobals* globals)
 	IDebugPages* page = ConvertPageToSubPage(_debugPage, pageIndex, subPageIndex);
 	if (page)
 	{
-		page->DebugUpdateStats(globals, pageIndex, updateFastNumbers);
+		page->DebugUpdateStats(globals, subPageIndex, updateFastNumbers);
 	}
 }
 
@@ -264,20 +283,60 @@ ff::State::Status ff::DebugPageState::GetStatus()
 
 size_t ff::DebugPageState::GetDebugPageCount() const
 {
-	return 1;
+	return 3;
 }
 
 void ff::DebugPageState::DebugUpdateStats(ff::AppGlobals* globals, size_t page, bool updateFastNumbers)
 {
+	if (page == 1 && updateFastNumbers)
+	{
+		_profileStats = ff::GetProfileZoneStats(PROFILE_ZONE_COUNT);
+	}
+	else if (page == 2 && updateFastNumbers)
+	{
+		_memSnapshot = ff::GetMemorySnapshot();
+		_memPoolStats = ff::GetMemoryPoolStats();
+
+		std::sort(_memPoolStats.begin(), _memPoolStats.end(), [](const ff::MemoryPoolStats& lhs, const ff::MemoryPoolStats& rhs)
+			{
+				return lhs.allocatedCount * lhs.itemBytes > rhs.allocatedCount * rhs.itemBytes;
+			});
+
+		if (_memPoolStats.Size() > MEMORY_POOL_COUNT)
+		{
+			_memPoolStats.Delete(MEMORY_POOL_COUNT, _memPoolStats.Size() - MEMORY_POOL_COUNT);
+		}
+	}
 }
 
 ff::String ff::DebugPageState::GetDebugName(size_t page) const
 {
-	return DEBUG_PAGE_NAME_0.GetString();
+	switch (page)
+	{
+	case 1:
+		return DEBUG_PAGE_NAME_1.GetString();
+
+	case 2:
+		return DEBUG_PAGE_NAME_2.GetString();
+
+	default:
+		return DEBUG_PAGE_NAME_0.GetString();
+	}
 }
 
 size_t ff::DebugPageState::GetDebugInfoCount(size_t page) const
 {
+	if (page == 1)
+	{
+		return _profileStats.Size() + 1;
+	}
+
+	if (page == 2)
+	{
+		// Header and tags (without None), then header and pools
+		return _memSnapshot.tags.size() + _memPoolStats.Size() + 1;
+	}
+
 #ifdef _DEBUG
 	return 4;
 #else
@@ -287,6 +346,62 @@ size_t ff::DebugPageState::GetDebugInfoCount(size_t page) const
 
 ff::String ff::DebugPageState::GetDebugInfo(size_t page, size_t index, DirectX::XMFLOAT4& color) const
 {
+	if (page == 1)
+	{
+		if (!index)
+		{
+			color = ff::GetColorMagenta();
+			return String::format_new(L"Zones:%s, Dropped:%lu, Self/Total ms per frame:", ff::IsProfilingEnabled() ? L"ON" : L"OFF", ff::GetProfileDroppedCount());
+		}
+
+		const ff::ProfileZoneStats& stats = _profileStats[index - 1];
+		return String::format_new(L"%s: %.3f/%.3f (#%.1f)", stats._zone->_name, stats._selfSeconds * 1000.0, stats._totalSeconds * 1000.0, stats._calls);
+	}
+
+	if (page == 2)
+	{
+		size_t tagCount = _memSnapshot.tags.size();
+
+		if (!index)
+		{
+			color = ff::GetColorMagenta();
+			return _memHasBaseSnapshot
+				? ff::String(L"Live KB (#), Peak KB, Change since snapshot:")
+				: ff::String(L"Live KB (#), Peak KB:");
+		}
+		else if (index < tagCount)
+		{
+			const ff::MemoryTagStats& stats = _memSnapshot.tags[index];
+			ff::String text = String::format_new(L"%s: %.1f (#%lu), %.1f",
+				ff::GetMemoryTagName((ff::MemoryTag)index),
+				stats.liveBytes / 1024.0,
+				stats.liveCount,
+				stats.peakBytes / 1024.0);
+
+			if (_memHasBaseSnapshot)
+			{
+				ff::MemoryTagDiff diff = ff::DiffMemorySnapshots(_memBaseSnapshot, _memSnapshot).tags[index];
+				text.append(String::format_new(L", %+.1f (#%+Id)", diff.liveBytes / 1024.0, diff.liveCount));
+			}
+
+			return text;
+		}
+		else if (index == tagCount)
+		{
+			color = ff::GetColorMagenta();
+			return ff::String(L"Pools, used/allocated:");
+		}
+
+		const ff::MemoryPoolStats& stats = _memPoolStats[index - tagCount - 1];
+		color = DirectX::XMFLOAT4(.5, .5, .5, 1);
+		return String::format_new(L"%s (%lu bytes): %lu/%lu (%.f%%)",
+			stats.name,
+			stats.itemBytes,
+			stats.usedCount,
+			stats.allocatedCount,
+			stats.allocatedCount ? stats.usedCount * 100.0 / stats.allocatedCount : 0.0);
+	}
+
 	switch (index)
 	{
 	case 0:
@@ -311,11 +426,34 @@ ff::String ff::DebugPageState::GetDebugInfo(size_t page, size_t index, DirectX::
 
 size_t ff::DebugPageState::GetDebugToggleCount(size_t page) const
 {
-	return 1;
+	return (page == 1) ? 2 : 1;
 }
 
 ff::String ff::DebugPageState::GetDebugToggle(size_t page, size_t index, int& value) const
 {
+	if (page == 1)
+	{
+		switch (index)
+		{
+		case 0:
+			value = ff::IsProfilingEnabled();
+			return DEBUG_TOGGLE_PROFILE.GetString();
+
+		case 1:
+			value = _profileCapturePending;
+			return DEBUG_TOGGLE_PROFILE_CAPTURE.GetString();
+
+		default:
+			return ff::GetEmptyString();
+		}
+	}
+
+	if (page == 2)
+	{
+		value = _memHasBaseSnapshot;
+		return (index == 0) ? DEBUG_TOGGLE_MEMORY_SNAPSHOT.GetString() : ff::GetEmptyString();
+	}
+
 	switch (index)
 	{
 	case 0:
@@ -329,6 +467,37 @@ ff::String ff::DebugPageState::GetDebugToggle(size_t page, size_t index, int& va
 
 void ff::DebugPageState::DebugToggle(size_t page, size_t index)
 {
+	if (page == 1)
+	{
+		switch (index)
+		{
+		case 0:
+			ff::EnableProfiling(!ff::IsProfilingEnabled());
+			break;
+
+		case 1:
+			if (!_profileCapturePending)
+			{
+				ff::StartProfileCapture(PROFILE_CAPTURE_FRAMES);
+				_profileCapturePending = true;
+			}
+			break;
+		}
+
+		return;
+	}
+
+	if (page == 2)
+	{
+		if (index == 0)
+		{
+			_memHasBaseSnapshot = !_memHasBaseSnapshot;
+			_memBaseSnapshot = ff::GetMemorySnapshot();
+		}
+
+		return;
+	}
+
 	switch (index)
 	{
 	case 0:
@@ -454,6 +623,21 @@ void ff::DebugPageState::Toggle(size_t index)
 	}
 }
 
+void ff::DebugPageState::SaveProfileCaptureFile()
+{
+	_profileCapturePending = false;
+
+	ff::String path = ff::GetTempDirectory();
+	ff::AppendPathTail(path, ff::String(L"profile.json"));
+
+	ff::ComPtr<ff::IDataFile> file;
+	ff::ComPtr<ff::IDataWriter> writer;
+	assertRet(ff::CreateDataFile(path, false, &file) && ff::CreateDataWriter(file, ff::INVALID_SIZE, &writer));
+	assertRet(ff::SaveProfileCapture(writer));
+
+	ff::Log::GlobalTraceF(L"Saved profile capture: %s\n", path.c_str());
+}
+
 size_t ff::DebugPageState::GetTotalPageCount() const
 {
 	size_t count = 0;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Globals/Profiler.h"
 #include "Input/InputMapping.h"
 #include "Input/Joystick/JoystickDevice.h"
 #include "Input/Keyboard/KeyboardDevice.h"
@@ -47,10 +48,14 @@ namespace ff
 		void RenderText(AppGlobals* globals, IRenderTarget* target, IRenderDepth* depth);
 		void RenderCharts(AppGlobals* globals, IRenderTarget* target);
 		void Toggle(size_t index);
+		void SaveProfileCaptureFile();
 		size_t GetTotalPageCount() const;
 		IDebugPages* ConvertPageToSubPage(size_t debugPage, size_t& outPage, size_t& outSubPage) const;
 
 		static const size_t MAX_QUEUE_SIZE = 60 * 6;
+		static const size_t PROFILE_ZONE_COUNT = 16;
+		static const size_t PROFILE_CAPTURE_FRAMES = 120;
+		static const size_t MEMORY_POOL_COUNT = 8;
 
 		bool _enabledStats;
 		bool _enabledCharts;
@@ -80,6 +85,12 @@ namespace ff
 		double _bankTime;
 		double _bankPercent;
 		ff::MemoryStats _memStats;
+		ff::Vector<ProfileZoneStats> _profileStats;
+		bool _profileCapturePending;
+		ff::MemorySnapshot _memSnapshot;
+		ff::MemorySnapshot _memBaseSnapshot;
+		ff::Vector<MemoryPoolStats> _memPoolStats;
+		bool _memHasBaseSnapshot;
 
 		struct FrameInfo
 		{
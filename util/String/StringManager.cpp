@@ -3,6 +3,11 @@
 #include "String/StringManager.h"
 
 ff::StringManager::StringManager()
+	: _pool_32(L"String 32", ff::MemoryTag::String)
+	, _pool_64(L"String 64", ff::MemoryTag::String)
+	, _pool_128(L"String 128", ff::MemoryTag::String)
+	, _pool_256(L"String 256", ff::MemoryTag::String)
+	, _vectorPool(L"String buffers", ff::MemoryTag::String)
 {
 }
 
@@ -16,10 +21,13 @@ wchar_t* ff::StringManager::New(size_t count)
 
 	if (count > 256)
 	{
-		// Need room before the actual string to store a null IPoolAllocator
-		BYTE* mem = new BYTE[sizeof(wchar_t) * count + sizeof(IPoolAllocator*)];
-		*(IPoolAllocator**)mem = nullptr;
-		str = (wchar_t*)(mem + sizeof(IPoolAllocator*));
+		// Need room before the actual string to store its size and a null IPoolAllocator
+		size_t byteSize = sizeof(wchar_t) * count + sizeof(size_t) + sizeof(IPoolAllocator*);
+		BYTE* mem = new BYTE[byteSize];
+		*(size_t*)mem = byteSize;
+		*(IPoolAllocator**)(mem + sizeof(size_t)) = nullptr;
+		str = (wchar_t*)(mem + sizeof(size_t) + sizeof(IPoolAllocator*));
+		ff::TrackMemoryAlloc(ff::MemoryTag::String, byteSize);
 	}
 	else if (count > 128)
 	{
@@ -59,6 +67,8 @@ void ff::StringManager::Delete(wchar_t* str)
 
 	if (pool == nullptr)
 	{
+		structStart -= sizeof(size_t);
+		ff::TrackMemoryFree(ff::MemoryTag::String, *(size_t*)structStart);
 		delete[] structStart;
 	}
 	else
@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "Audio/AudioMixer.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Types/Timer.h"
+
+static const size_t SAMPLE_RATE = 48000;
+static const UINT64 ONE_FRAME = (UINT64)1 << 32;
+
+static bool IsNear(float value, float expect)
+{
+	return std::abs(value - expect) < 0.0001f;
+}
+
+static WAVEFORMATEX CreateFloatFormat(size_t sampleRate, size_t channels)
+{
+	WAVEFORMATEX format{};
+	format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	format.nChannels = (WORD)channels;
+	format.nSamplesPerSec = (DWORD)sampleRate;
+	format.wBitsPerSample = 32;
+	format.nBlockAlign = (WORD)(channels * sizeof(float));
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+	return format;
+}
+
+static bool TestKernels()
+{
+	// Interleaved stereo source where each frame's value is its index, plus one for interpolation
+	float stereo[18];
+	float mono[9];
+	for (size_t i = 0; i < 9; i++)
+	{
+		stereo[i * 2] = (float)i;
+		stereo[i * 2 + 1] = -(float)i;
+		mono[i] = (float)i;
+	}
+
+	// Half speed, so every other output frame is between two source frames
+
+	float dest[16] = { 0 };
+	ff::ResampleMixRow(stereo, 2, 0, ::ONE_FRAME / 2, dest, 2, 8, 1, 0);
+	for (size_t i = 0; i < 8; i++)
+	{
+		assertRetVal(::IsNear(dest[i * 2], i * 0.5f) && ::IsNear(dest[i * 2 + 1], i * -0.5f), false);
+	}
+
+	// Mono goes to both channels, and the result is added to what's there
+
+	ff::ResampleMixRow(mono, 1, 0, ::ONE_FRAME / 2, dest, 2, 8, 1, 0);
+	for (size_t i = 0; i < 8; i++)
+	{
+		assertRetVal(::IsNear(dest[i * 2], i * 1.0f) && ::IsNear(dest[i * 2 + 1], 0), false);
+	}
+
+	// Stereo to mono averages, with a volume ramp
+
+	std::memset(dest, 0, sizeof(dest));
+	ff::ResampleMixRow(stereo, 2, 0, ::ONE_FRAME, dest, 1, 7, 1, -0.125f);
+	for (size_t i = 0; i < 7; i++)
+	{
+		assertRetVal(::IsNear(dest[i], 0), false);
+	}
+
+	ff::ResampleMixRow(mono, 1, 0, ::ONE_FRAME, dest, 1, 7, 1, -0.125f);
+	for (size_t i = 0; i < 7; i++)
+	{
+		assertRetVal(::IsNear(dest[i], i * (1 - i * 0.125f)), false);
+	}
+
+	std::memset(dest, 0, sizeof(dest));
+	ff::MixRow(mono, dest, 1, 7, 0.5f, 0);
+	ff::MixRow(mono, dest + 8, 1, 7, 1, -0.125f);
+	for (size_t i = 0; i < 7; i++)
+	{
+		assertRetVal(::IsNear(dest[i], i * 0.5f) && ::IsNear(dest[i + 8], i * (1 - i * 0.125f)), false);
+	}
+
+	return true;
+}
+
+static bool TestVoices()
+{
+	ff::Vector<float> wave;
+	wave.Resize(100);
+	std::fill(wave.begin(), wave.end(), 1.0f);
+
+	ff::AudioMixerSource source;
+	assertRetVal(source.Init(::CreateFloatFormat(::SAMPLE_RATE, 1), wave.Data(), wave.ByteSize()), false);
+	assertRetVal(source._frameCount == 100, false);
+
+	ff::AudioMixer mixer(1, ::SAMPLE_RATE, 4);
+	ff::AudioNullSink sink(1);
+
+	// Plays to the end, and then the voice is done
+
+	size_t voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1, 1);
+	assertRetVal(voice && !mixer.IsVoiceDone(voice), false);
+	assertRetVal(mixer.Render(&sink, 50) && !mixer.IsVoiceDone(voice), false);
+	assertRetVal(mixer.Render(&sink, 100) && mixer.IsVoiceDone(voice), false);
+	assertRetVal(sink.GetFrameCount() == 150 && ::IsNear(sink.GetPeak(), 1), false);
+
+	// Loops twice after the first time through
+
+	source._loopCount = 2;
+	voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1, 1);
+	assertRetVal(mixer.Render(&sink, 250) && !mixer.IsVoiceDone(voice), false);
+	assertRetVal(mixer.Render(&sink, 100) && mixer.IsVoiceDone(voice), false);
+
+	// Paused voices don't move, stopped ones are done
+
+	source._loopCount = ff::INVALID_SIZE;
+	voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1, 1, false);
+	assertRetVal(mixer.Render(&sink, 1000) && !mixer.IsVoiceDone(voice), false);
+	assertRetVal(mixer.Stop(voice) && mixer.Render(&sink, 1) && mixer.IsVoiceDone(voice), false);
+
+	// A full command queue fails the command instead of dropping it, until the commands run
+
+	voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1, 1);
+	size_t queued = 1;
+	for (; mixer.SetVolume(voice, 0.5f); queued++);
+	assertRetVal(queued > 1 && !mixer.Stop(voice) && !mixer.SetBusVolume(ff::AudioVoiceType::EFFECTS, 0.5f), false);
+	assertRetVal(::IsNear(mixer.GetBusVolume(ff::AudioVoiceType::EFFECTS), 1), false);
+
+	mixer.RunCommands();
+	assertRetVal(mixer.Stop(voice) && !mixer.IsVoiceDone(voice), false);
+	assertRetVal(mixer.Render(&sink, 1) && mixer.IsVoiceDone(voice), false);
+
+	// Bus and voice volumes, and a ramp down to silence
+
+	float output[200];
+	mixer.SetBusVolume(ff::AudioVoiceType::EFFECTS, 0.5f);
+	voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 0.5f, 1);
+	mixer.Render(output, 10);
+	assertRetVal(::IsNear(output[0], 0.25f) && ::IsNear(output[9], 0.25f), false);
+
+	mixer.SetVolume(voice, 0, 100.0 / ::SAMPLE_RATE);
+	mixer.Render(output, 200);
+	for (size_t i = 1; i < 100; i++)
+	{
+		assertRetVal(output[i] < output[i - 1], false);
+	}
+
+	assertRetVal(::IsNear(output[100], 0) && ::IsNear(output[199], 0), false);
+	mixer.Stop(voice);
+
+	// 16-bit PCM, at half speed
+
+	INT16 pcm[4] = { 0, 16384, -16384, 0 };
+	WAVEFORMATEX pcmFormat = ::CreateFloatFormat(::SAMPLE_RATE, 1);
+	pcmFormat.wFormatTag = WAVE_FORMAT_PCM;
+	pcmFormat.wBitsPerSample = 16;
+	pcmFormat.nBlockAlign = 2;
+	assertRetVal(source.Init(pcmFormat, pcm, sizeof(pcm)), false);
+	source._loopCount = 0;
+
+	mixer.SetBusVolume(ff::AudioVoiceType::EFFECTS, 1);
+	voice = mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1, 0.5f);
+	mixer.Render(output, 8);
+	assertRetVal(::IsNear(output[1], 0.25f) && ::IsNear(output[2], 0.5f) && ::IsNear(output[4], -0.5f) && ::IsNear(output[7], 0), false);
+	mixer.Render(output, 1);
+	assertRetVal(mixer.IsVoiceDone(voice), false);
+
+	return true;
+}
+
+static bool TestWavSink()
+{
+	ff::Vector<float> wave;
+	wave.Resize(1000);
+	std::fill(wave.begin(), wave.end(), 0.5f);
+
+	ff::AudioMixerSource source;
+	assertRetVal(source.Init(::CreateFloatFormat(::SAMPLE_RATE / 2, 2), wave.Data(), wave.ByteSize()), false);
+
+	ff::ComPtr<ff::IDataVector> data;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+
+		ff::AudioMixer mixer(2, ::SAMPLE_RATE);
+		ff::AudioWavSink sink(writer, 2, ::SAMPLE_RATE);
+		mixer.Play(source, ff::AudioVoiceType::MUSIC, 1, 1);
+		assertRetVal(mixer.Render(&sink, 1500), false);
+		assertRetVal(sink.Finish(), false);
+	}
+
+	const size_t headerSize = 58;
+	const BYTE* bytes = data->GetMem();
+	assertRetVal(data->GetSize() == headerSize + 1500 * 2 * sizeof(float), false);
+	assertRetVal(!std::memcmp(bytes, "RIFF", 4) && !std::memcmp(bytes + 8, "WAVE", 4) && !std::memcmp(bytes + 50, "data", 4), false);
+	assertRetVal(*reinterpret_cast<const DWORD*>(bytes + 54) == 1500 * 2 * sizeof(float), false);
+
+	// Half the sample rate, so the 500 source frames last 1000 output frames
+	const float* samples = reinterpret_cast<const float*>(bytes + headerSize);
+	assertRetVal(::IsNear(samples[0], 0.5f) && ::IsNear(samples[1999], 0.5f) && ::IsNear(samples[2000], 0), false);
+
+	return true;
+}
+
+bool AudioMixerTest()
+{
+	return ::TestKernels() && ::TestVoices() && ::TestWavSink();
+}
+
+bool AudioMixerPerfTest()
+{
+	// Mixes 44.1KHz stereo effects into a 48KHz stereo output, like a busy game would
+	const size_t voiceCount = 128;
+	const size_t seconds = 10;
+
+	ff::Vector<float> wave;
+	wave.Resize(44100 * 2);
+	for (size_t i = 0; i < wave.Size(); i++)
+	{
+		wave[i] = std::sin(i * 0.01f) * 0.25f;
+	}
+
+	ff::AudioMixerSource source;
+	assertRetVal(source.Init(::CreateFloatFormat(44100, 2), wave.Data(), wave.ByteSize()), false);
+	source._loopCount = ff::INVALID_SIZE;
+
+	ff::AudioMixer mixer(2, ::SAMPLE_RATE, voiceCount);
+	ff::AudioNullSink sink(2);
+
+	for (size_t i = 0; i < voiceCount; i++)
+	{
+		mixer.Play(source, ff::AudioVoiceType::EFFECTS, 1.0f / voiceCount, 1.0f + i * 0.001f);
+	}
+
+	ff::Timer timer;
+	assertRetVal(mixer.Render(&sink, ::SAMPLE_RATE * seconds), false);
+	double time = timer.Tick();
+
+	ff::String status = ff::String::format_new(
+		L"Audio mixer: %lu voices for %lu seconds in %.2fms, %.1fx real time, %.0f voices mixed per ms\r\n",
+		voiceCount,
+		seconds,
+		time * 1000.0,
+		seconds / time,
+		voiceCount * seconds / (time * 1000.0));
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return sink.GetFrameCount() == ::SAMPLE_RATE * seconds;
+}
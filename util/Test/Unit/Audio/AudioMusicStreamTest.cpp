@@ -0,0 +1,263 @@
+#include "pch.h"
+#include "Audio/AudioDecoder.h"
+#include "Audio/AudioMixer.h"
+#include "Audio/AudioMusicStream.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Types/SpscRing.h"
+#include "Types/Timer.h"
+
+#include <random>
+
+static const size_t SAMPLE_RATE = 48000;
+
+// Every sample is the index of its frame, so any gap or repeat in the stream is easy to see
+class RampDecoder : public ff::IAudioDecoder
+{
+public:
+	RampDecoder(size_t channels, size_t frameCount, size_t maxDecodeMilliseconds = 0)
+		: _channels(channels)
+		, _frameCount(frameCount)
+		, _frame(0)
+		, _maxDecodeMilliseconds(maxDecodeMilliseconds)
+		, _random(1234)
+	{
+	}
+
+	virtual size_t GetChannels() const override
+	{
+		return _channels;
+	}
+
+	virtual size_t GetSampleRate() const override
+	{
+		return ::SAMPLE_RATE;
+	}
+
+	virtual size_t GetFrameCount() const override
+	{
+		return _frameCount;
+	}
+
+	virtual size_t Decode(float* samples, size_t frameCount) override
+	{
+		if (_maxDecodeMilliseconds)
+		{
+			// Real decoders sometimes stall
+			::Sleep((DWORD)(_random() % (_maxDecodeMilliseconds + 1)));
+		}
+
+		frameCount = std::min(frameCount, _frameCount - _frame);
+		for (size_t i = 0; i < frameCount; i++, _frame++)
+		{
+			for (size_t ch = 0; ch < _channels; ch++)
+			{
+				*samples++ = (float)_frame;
+			}
+		}
+
+		return frameCount;
+	}
+
+	virtual bool SetPosition(size_t frame) override
+	{
+		_frame = std::min(frame, _frameCount);
+		return true;
+	}
+
+private:
+	size_t _channels;
+	size_t _frameCount;
+	size_t _frame;
+	size_t _maxDecodeMilliseconds;
+	std::mt19937 _random;
+};
+
+static bool TestRing()
+{
+	ff::SpscRing<int> ring(5);
+	assertRetVal(ring.GetCapacity() == 8 && ring.IsEmpty() && ring.GetWriteCount() == 8, false);
+
+	int value = 0;
+	assertRetVal(ring.Push(1) && ring.Push(2) && ring.GetReadCount() == 2, false);
+	assertRetVal(ring.Pop(value) && value == 1 && ring.Pop(value) && value == 2 && !ring.Pop(value), false);
+
+	// Writes and reads that wrap around the end
+
+	int items[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	int output[10] = { 0 };
+	assertRetVal(ring.Write(items, 10) == 8 && !ring.Push(8), false);
+	assertRetVal(ring.Read(output, 5) == 5 && output[4] == 4, false);
+	assertRetVal(ring.Write(items + 8, 2) == 2, false);
+	assertRetVal(ring.Read(output, 10) == 5 && output[0] == 5 && output[4] == 9 && ring.IsEmpty(), false);
+
+	return true;
+}
+
+static bool TestWavDecoder()
+{
+	// A float WAV file from the mixer's WAV sink
+
+	ff::Vector<float> wave;
+	wave.Resize(200);
+	for (size_t i = 0; i < wave.Size(); i++)
+	{
+		wave[i] = i / 200.0f;
+	}
+
+	WAVEFORMATEX format{};
+	format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	format.nChannels = 2;
+	format.nSamplesPerSec = ::SAMPLE_RATE;
+	format.wBitsPerSample = 32;
+	format.nBlockAlign = 2 * sizeof(float);
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+	ff::AudioMixerSource source;
+	assertRetVal(source.Init(format, wave.Data(), wave.ByteSize()), false);
+
+	ff::ComPtr<ff::IDataVector> data;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+
+		ff::AudioMixer mixer(2, ::SAMPLE_RATE);
+		ff::AudioWavSink sink(writer, 2, ::SAMPLE_RATE);
+		mixer.Play(source, ff::AudioVoiceType::MUSIC, 1, 1);
+		assertRetVal(mixer.Render(&sink, 100) && sink.Finish(), false);
+	}
+
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(ff::CreateDataReader(data, 0, &reader), false);
+
+	ff::AudioWavDecoder floatDecoder;
+	assertRetVal(floatDecoder.Init(reader), false);
+	assertRetVal(floatDecoder.GetChannels() == 2 && floatDecoder.GetSampleRate() == ::SAMPLE_RATE && floatDecoder.GetFrameCount() == 100, false);
+
+	float samples[16];
+	assertRetVal(floatDecoder.SetPosition(90) && floatDecoder.Decode(samples, 8) == 8, false);
+	assertRetVal(std::abs(samples[0] - wave[180]) < 0.0001f && std::abs(samples[15] - wave[195]) < 0.0001f, false);
+	assertRetVal(floatDecoder.Decode(samples, 8) == 2 && !floatDecoder.Decode(samples, 8), false);
+
+	// A hand-made mono 16-bit PCM file, with an extra chunk before the data
+
+	const BYTE pcmFile[] =
+	{
+		'R', 'I', 'F', 'F', 50, 0, 0, 0, 'W', 'A', 'V', 'E',
+		'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x44, 0xac, 0, 0, 0x88, 0x58, 1, 0, 2, 0, 16, 0,
+		'j', 'u', 'n', 'k', 3, 0, 0, 0, 1, 2, 3, 0,
+		'd', 'a', 't', 'a', 6, 0, 0, 0, 0, 0, 0, 0x40, 0, 0xc0,
+	};
+
+	assertRetVal(ff::CreateDataReader(pcmFile, sizeof(pcmFile), 0, &reader), false);
+
+	ff::AudioWavDecoder pcmDecoder;
+	assertRetVal(pcmDecoder.Init(reader), false);
+	assertRetVal(pcmDecoder.GetChannels() == 1 && pcmDecoder.GetSampleRate() == 44100 && pcmDecoder.GetFrameCount() == 3, false);
+	assertRetVal(pcmDecoder.Decode(samples, 8) == 3 && samples[0] == 0 && samples[1] == 0.5f && samples[2] == -0.5f, false);
+
+	return true;
+}
+
+static bool TestStream()
+{
+	const size_t frameCount = ::SAMPLE_RATE;
+	ff::Vector<float> samples;
+	samples.Resize(1000 * 2);
+
+	ff::AudioMusicStream stream(std::make_unique<::RampDecoder>(2, frameCount), 0.1);
+	assertRetVal(stream.GetChannels() == 2 && stream.GetSampleRate() == ::SAMPLE_RATE, false);
+
+	// Prefilled frames are ready as soon as it starts
+
+	stream.Start(1000);
+	assertRetVal(stream.GetFillLevel() > 0 && stream.Read(samples.Data(), 1000) == 1000, false);
+	assertRetVal(samples[0] == 0 && samples[1999] == 999 && stream.GetPosition() == 1000, false);
+
+	// Everything after that comes in order from the decoding thread
+
+	size_t frame = 1000;
+	while (!stream.IsDone())
+	{
+		size_t count = stream.Read(samples.Data(), 1000);
+		for (size_t i = 0; i < count; i++, frame++)
+		{
+			assertRetVal(samples[i * 2] == frame && samples[i * 2 + 1] == frame, false);
+		}
+
+		if (!count)
+		{
+			::Sleep(1);
+		}
+	}
+
+	assertRetVal(frame == frameCount && stream.GetStats()._readFrames == frameCount, false);
+
+	// Seeking back restarts the decoding
+
+	assertRetVal(stream.Seek(100, 10) && stream.GetPosition() == 100, false);
+	assertRetVal(stream.Read(samples.Data(), 10) == 10 && samples[0] == 100 && samples[19] == 109, false);
+	stream.Stop();
+
+	// Looping goes back to the first frame without a gap
+
+	ff::AudioMusicStream loopStream(std::make_unique<::RampDecoder>(1, 300), 0.1);
+	loopStream.SetLoop(true);
+	loopStream.Start(1000);
+	assertRetVal(loopStream.Read(samples.Data(), 1000) == 1000 && !loopStream.IsDone(), false);
+	assertRetVal(samples[299] == 299 && samples[300] == 0 && samples[999] == 99 && loopStream.GetPosition() == 100, false);
+
+	return true;
+}
+
+bool AudioMusicStreamTest()
+{
+	return ::TestRing() && ::TestWavDecoder() && ::TestStream();
+}
+
+bool AudioMusicStreamPerfTest()
+{
+	// The decoder and the consumer both stall randomly, like a busy game would make them
+	const size_t seconds = 2;
+	const size_t frameCount = ::SAMPLE_RATE * seconds;
+	const size_t maxReadFrames = 960; // 20ms
+
+	ff::AudioMusicStream stream(std::make_unique<::RampDecoder>(2, frameCount, 2), 0.5);
+	std::mt19937 random(5678);
+	ff::Vector<float> samples;
+	samples.Resize(maxReadFrames * 2);
+
+	ff::Timer timer;
+	stream.Start(maxReadFrames);
+
+	float minFill = 1;
+	size_t frame = 0;
+	while (!stream.IsDone())
+	{
+		minFill = std::min(minFill, stream.GetFillLevel());
+
+		size_t count = stream.Read(samples.Data(), random() % maxReadFrames + 1);
+		for (size_t i = 0; i < count; i++, frame++)
+		{
+			assertRetVal(samples[i * 2] == frame && samples[i * 2 + 1] == frame, false);
+		}
+
+		::Sleep((DWORD)(random() % 5));
+	}
+
+	double time = timer.Tick();
+	ff::AudioMusicStreamStats stats = stream.GetStats();
+
+	ff::String status = ff::String::format_new(
+		L"Music stream: %lu frames in %.2fms, %lu underruns, %lu missing frames, lowest fill %.0f%%\r\n",
+		frame,
+		time * 1000.0,
+		stats._underruns,
+		stats._underrunFrames,
+		minFill * 100.0f);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return frame == frameCount && stats._decodedFrames == frameCount;
+}
@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "Audio/AudioPcmCache.h"
+#include "Data/Data.h"
+#include "Data/SavedData.h"
+#include "Globals/Log.h"
+#include "Test/Unit/TestRandom.h"
+#include "Types/Timer.h"
+
+static WAVEFORMATEX CreatePcmFormat(size_t sampleRate)
+{
+	WAVEFORMATEX format{};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = 1;
+	format.nSamplesPerSec = (DWORD)sampleRate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = sizeof(INT16);
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+	return format;
+}
+
+// A tone with a little noise, so that it compresses about as badly as a real sound
+static ff::ComPtr<ff::IData> CreateSound(size_t frames, size_t seed)
+{
+	ff::ComPtr<ff::IDataVector> data;
+	assertRetVal(ff::CreateDataVector(frames * sizeof(INT16), &data), nullptr);
+
+	INT16* samples = reinterpret_cast<INT16*>(data->GetVector().Data());
+	TestRandom noise(seed);
+	for (size_t i = 0; i < frames; i++)
+	{
+		samples[i] = (INT16)(std::sin(i * (0.01 + seed * 0.0001)) * 8000 + noise.Next(256));
+	}
+
+	return data;
+}
+
+// Saved like a resource pack would save it, optionally compressed
+static ff::ComPtr<ff::ISavedData> CreateSavedSound(ff::IData* pcm, bool compress)
+{
+	ff::ComPtr<ff::ISavedData> loadedData;
+	assertRetVal(ff::CreateLoadedDataFromMemory(pcm, compress, &loadedData), nullptr);
+
+	ff::ComPtr<ff::IData> savedBytes = loadedData->SaveToMem();
+	assertRetVal(savedBytes, nullptr);
+
+	ff::ComPtr<ff::IDataVector> packCopy;
+	assertRetVal(ff::CreateDataVector(savedBytes->GetSize(), &packCopy), nullptr);
+	std::memcpy(packCopy->GetVector().Data(), savedBytes->GetMem(), savedBytes->GetSize());
+
+	ff::ComPtr<ff::ISavedData> savedData;
+	assertRetVal(ff::CreateSavedDataFromMemory(packCopy, pcm->GetSize(), compress, &savedData), nullptr);
+	return savedData;
+}
+
+static bool IsSameData(ff::IData* data1, ff::IData* data2)
+{
+	return data1 && data2 && data1->GetSize() == data2->GetSize() && !std::memcmp(data1->GetMem(), data2->GetMem(), data1->GetSize());
+}
+
+static bool TestSharing()
+{
+	ff::AudioPcmCache cache;
+	WAVEFORMATEX format = ::CreatePcmFormat(44100);
+	ff::ComPtr<ff::IData> sound1 = ::CreateSound(1000, 1);
+	ff::ComPtr<ff::IData> sound2 = ::CreateSound(1000, 2);
+
+	// Copies of the same sound from different packs share one clip
+
+	std::shared_ptr<ff::AudioPcmClip> clip1 = cache.Add(format, ::CreateSavedSound(sound1, false), false);
+	std::shared_ptr<ff::AudioPcmClip> clip1b = cache.Add(format, ::CreateSavedSound(sound1, false), false);
+	std::shared_ptr<ff::AudioPcmClip> clip2 = cache.Add(format, ::CreateSavedSound(sound2, false), false);
+	assertRetVal(clip1 && clip1 == clip1b && clip2 && clip1 != clip2, false);
+
+	// The same bytes with a different format is a different sound
+
+	std::shared_ptr<ff::AudioPcmClip> clip1c = cache.Add(::CreatePcmFormat(22050), ::CreateSavedSound(sound1, false), false);
+	assertRetVal(clip1c && clip1c != clip1, false);
+
+	cache.WaitForPreloads();
+
+	ff::AudioPcmCacheStats stats = cache.GetStats();
+	assertRetVal(stats._clipCount == 3 && stats._loadedCount == 3 && stats._sharedAdds == 1, false);
+	assertRetVal(stats._preloads == 3 && stats._demandLoads == 0 && stats._pcmBytes == 3 * sound1->GetSize(), false);
+	assertRetVal(::IsSameData(clip1->GetData(), sound1) && ::IsSameData(clip2->GetData(), sound2), false);
+
+	// Clips leave the cache when nothing uses them
+
+	clip1 = nullptr;
+	clip1b = nullptr;
+	assertRetVal(cache.GetStats()._clipCount == 2, false);
+
+	clip1 = cache.Add(format, ::CreateSavedSound(sound1, false), false);
+	assertRetVal(clip1 && cache.GetStats()._sharedAdds == 1, false);
+
+	return true;
+}
+
+static bool TestCompressed()
+{
+	ff::AudioPcmCache cache;
+	WAVEFORMATEX format = ::CreatePcmFormat(44100);
+	ff::ComPtr<ff::IData> sound = ::CreateSound(10000, 3);
+
+	// Kept-compressed clips only decompress when they play
+
+	std::shared_ptr<ff::AudioPcmClip> clip = cache.Add(format, ::CreateSavedSound(sound, true), true);
+	assertRetVal(clip && clip->IsKeptCompressed(), false);
+
+	cache.WaitForPreloads();
+	assertRetVal(!clip->IsLoaded() && cache.GetStats()._savedBytes < sound->GetSize(), false);
+
+	ff::ComPtr<ff::IData> data = clip->GetData();
+	assertRetVal(::IsSameData(data, sound) && cache.GetStats()._demandLoads == 1, false);
+
+	// Not freed while it's playing, or right after it was used
+
+	assertRetVal(cache.Trim() == 0 && cache.Trim() == 0 && clip->IsLoaded(), false);
+	data = nullptr;
+	assertRetVal(cache.Trim() == 1 && !clip->IsLoaded(), false);
+
+	data = clip->GetData();
+	assertRetVal(::IsSameData(data, sound), false);
+
+	ff::AudioPcmCacheStats stats = cache.GetStats();
+	assertRetVal(stats._demandLoads == 2 && stats._trimmed == 1 && stats._compressedCount == 1, false);
+
+	return true;
+}
+
+bool AudioPcmCacheTest()
+{
+	return ::TestSharing() && ::TestCompressed();
+}
+
+bool AudioPcmCachePerfTest()
+{
+	// Two packs with 300 sound effects between them. The second pack repeats 100 sounds from the first one,
+	// and the 50 least used sounds are kept compressed.
+	const size_t effectCount = 300;
+	const size_t uniqueCount = 200;
+	const size_t compressedCount = 50;
+	WAVEFORMATEX format = ::CreatePcmFormat(44100);
+
+	ff::Vector<ff::ComPtr<ff::IData>> sounds;
+	ff::Vector<ff::ComPtr<ff::ISavedData>> savedSounds;
+	for (size_t i = 0; i < effectCount; i++)
+	{
+		size_t sound = i % uniqueCount;
+		if (sound == sounds.Size())
+		{
+			sounds.Push(::CreateSound(22050 + sound * 441, sound));
+		}
+
+		savedSounds.Push(::CreateSavedSound(sounds[sound], sound < compressedCount));
+	}
+
+	// Before: every resource decompresses its own copy the first time it plays
+
+	size_t oldBytes = 0;
+	double oldMaxLatency = 0;
+	ff::Timer timer;
+
+	for (ff::ISavedData* savedSound : savedSounds)
+	{
+		ff::ComPtr<ff::ISavedData> clone;
+		assertRetVal(savedSound->Clone(&clone), false);
+
+		ff::Timer playTimer;
+		oldBytes += clone->Load()->GetSize();
+		oldMaxLatency = std::max(oldMaxLatency, playTimer.Tick());
+	}
+
+	double oldTime = timer.Tick();
+
+	// After: adding the resources starts decompression on the thread pool
+
+	ff::AudioPcmCache cache;
+	ff::Vector<std::shared_ptr<ff::AudioPcmClip>> clips;
+	for (size_t i = 0; i < effectCount; i++)
+	{
+		clips.Push(cache.Add(format, savedSounds[i], i % uniqueCount < compressedCount));
+	}
+
+	double addTime = timer.Tick();
+	cache.WaitForPreloads();
+	double preloadTime = timer.Tick();
+	ff::AudioPcmCacheStats preloadStats = cache.GetStats();
+
+	double newMaxLatency = 0;
+	double compressedMaxLatency = 0;
+	for (size_t i = 0; i < effectCount; i++)
+	{
+		ff::Timer playTimer;
+		assertRetVal(clips[i]->GetData(), false);
+		double latency = playTimer.Tick();
+
+		double& maxLatency = clips[i]->IsKeptCompressed() ? compressedMaxLatency : newMaxLatency;
+		maxLatency = std::max(maxLatency, latency);
+	}
+
+	ff::AudioPcmCacheStats stats = cache.GetStats();
+	cache.Trim();
+	cache.Trim();
+	ff::AudioPcmCacheStats trimStats = cache.GetStats();
+
+	ff::String status = ff::String::format_new(
+		L"PCM cache: %lu effects, %lu unique, %lu shared adds\r\n"
+		L"  Before: %luKB of PCM, %.2fms to load, %.3fms worst first play\r\n"
+		L"  After: %luKB of PCM after preload, %luKB after trim, %.2fms to add, %.2fms to preload\r\n"
+		L"  After: %.3fms worst first play, %.3fms worst kept-compressed first play, %lu demand loads\r\n",
+		effectCount,
+		stats._clipCount,
+		stats._sharedAdds,
+		oldBytes / 1024,
+		oldTime * 1000.0,
+		oldMaxLatency * 1000.0,
+		preloadStats._pcmBytes / 1024,
+		trimStats._pcmBytes / 1024,
+		addTime * 1000.0,
+		preloadTime * 1000.0,
+		newMaxLatency * 1000.0,
+		compressedMaxLatency * 1000.0,
+		stats._demandLoads);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return stats._clipCount == uniqueCount && stats._demandLoads == compressedCount && trimStats._trimmed == compressedCount;
+}
@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "Audio/AudioVoicePool.h"
+#include "Globals/Log.h"
+#include "Types/Timer.h"
+
+// Voices that don't play anything, so the pool can be tested without an audio device
+class FakeVoice : public ff::IAudioPoolVoice
+{
+public:
+	FakeVoice(size_t& liveCount)
+		: _liveCount(liveCount)
+		, _resetCount(0)
+		, _busy(false)
+	{
+		_liveCount++;
+	}
+
+	virtual void Reset() override
+	{
+		_resetCount++;
+	}
+
+	virtual bool IsDone() override
+	{
+		return !_busy;
+	}
+
+	virtual void Destroy() override
+	{
+		_liveCount--;
+		delete this;
+	}
+
+	size_t& _liveCount;
+	size_t _resetCount;
+	bool _busy; // like XAudio2 still reading buffers after a flush
+};
+
+class FakeVoiceBackend : public ff::IAudioVoicePoolBackend
+{
+public:
+	FakeVoiceBackend()
+		: _liveCount(0)
+	{
+	}
+
+	virtual ff::IAudioPoolVoice* CreateVoice(const WAVEFORMATEX& format) override
+	{
+		return new FakeVoice(_liveCount);
+	}
+
+	size_t _liveCount;
+};
+
+// Plays an effect on one voice, like AudioEffectPlaying
+class FakeEffect : public ff::IAudioPoolVoiceOwner
+{
+public:
+	FakeEffect()
+		: _voice(nullptr)
+		, _endTime(0)
+		, _stolen(false)
+	{
+	}
+
+	virtual void OnVoiceStolen(ff::IAudioPoolVoice* voice) override
+	{
+		assert(voice == _voice);
+		_voice = nullptr;
+		_stolen = true;
+	}
+
+	ff::IAudioPoolVoice* _voice;
+	double _endTime;
+	bool _stolen;
+};
+
+static WAVEFORMATEX CreateWaveFormat(DWORD sampleRate, WORD channels)
+{
+	WAVEFORMATEX format{};
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = channels;
+	format.nSamplesPerSec = sampleRate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = channels * 2;
+	format.nAvgBytesPerSec = sampleRate * format.nBlockAlign;
+
+	return format;
+}
+
+bool AudioVoicePoolTest()
+{
+	FakeVoiceBackend backend;
+	const WAVEFORMATEX mono = ::CreateWaveFormat(44100, 1);
+	const WAVEFORMATEX stereo = ::CreateWaveFormat(44100, 2);
+	{
+		ff::AudioVoicePool pool(&backend, 2);
+		pool.SetLimit(stereo, 1);
+		FakeEffect effects[6];
+
+		// New voices are created until the limit for the format
+
+		effects[0]._voice = pool.Acquire(mono, 0, &effects[0]);
+		effects[1]._voice = pool.Acquire(mono, 1, &effects[1]);
+		effects[2]._voice = pool.Acquire(stereo, 0, &effects[2]);
+		assertRetVal(effects[0]._voice && effects[1]._voice && effects[2]._voice && backend._liveCount == 3, false);
+
+		// Full formats steal the lowest priority voice, and never a higher priority one
+
+		effects[3]._voice = pool.Acquire(mono, 0, &effects[3]);
+		assertRetVal(effects[0]._stolen && !effects[1]._stolen && effects[3]._voice && backend._liveCount == 3, false);
+
+		assertRetVal(!pool.Acquire(stereo, -1, &effects[4]), false);
+
+		// With equal priority, the oldest voice is stolen
+
+		effects[4]._voice = pool.Acquire(mono, 1, &effects[4]);
+		assertRetVal(effects[3]._stolen && !effects[1]._stolen && effects[4]._voice, false);
+
+		effects[5]._voice = pool.Acquire(mono, 1, &effects[5]);
+		assertRetVal(effects[1]._stolen && !effects[4]._stolen && effects[5]._voice, false);
+
+		// Released voices are reused for the same format
+
+		ff::IAudioPoolVoice* released = effects[4]._voice;
+		pool.Release(effects[4]._voice);
+		effects[4]._voice = pool.Acquire(mono, 0, &effects[4]);
+		assertRetVal(effects[4]._voice == released && static_cast<FakeVoice*>(released)->_resetCount >= 1, false);
+
+		ff::AudioVoicePoolStats stats = pool.GetStats();
+		assertRetVal(stats._creates == 3 && stats._steals == 3 && stats._hits == 1 && stats._failures == 1, false);
+		assertRetVal(stats._activeCount == 3 && stats._idleCount == 0, false);
+
+		// Lowering a limit destroys extra idle voices
+
+		pool.Release(effects[4]._voice);
+		pool.Release(effects[5]._voice);
+		pool.SetLimit(mono, 1);
+		assertRetVal(pool.GetStats()._idleCount == 1 && backend._liveCount == 2, false);
+
+		// Voices still reading old buffers aren't reused or given to anyone else until they are done
+
+		FakeEffect drainEffects[3];
+		drainEffects[0]._voice = pool.Acquire(mono, 0, &drainEffects[0]);
+		FakeVoice* busyVoice = static_cast<FakeVoice*>(drainEffects[0]._voice);
+		busyVoice->_busy = true;
+		pool.Release(busyVoice);
+		stats = pool.GetStats();
+		assertRetVal(stats._drainingCount == 1 && stats._idleCount == 0, false);
+
+		drainEffects[1]._voice = pool.Acquire(mono, 0, &drainEffects[1]);
+		assertRetVal(drainEffects[1]._voice && drainEffects[1]._voice != busyVoice && backend._liveCount == 3, false);
+
+		FakeVoice* stolenVoice = static_cast<FakeVoice*>(drainEffects[1]._voice);
+		stolenVoice->_busy = true;
+		drainEffects[2]._voice = pool.Acquire(mono, 0, &drainEffects[2]);
+		assertRetVal(drainEffects[1]._stolen && drainEffects[2]._voice && backend._liveCount == 4, false);
+		assertRetVal(drainEffects[2]._voice != busyVoice && drainEffects[2]._voice != stolenVoice, false);
+		assertRetVal(pool.GetStats()._drainingCount == 2, false);
+
+		// Done voices go back to the idle list, or away when the format is full
+
+		busyVoice->_busy = false;
+		stolenVoice->_busy = false;
+		pool.Release(drainEffects[2]._voice);
+		stats = pool.GetStats();
+		assertRetVal(stats._drainingCount == 0 && stats._idleCount == 1 && backend._liveCount == 2, false);
+
+		// Clearing steals from everything that's still playing
+
+		pool.Clear();
+		assertRetVal(effects[2]._stolen && !backend._liveCount, false);
+	}
+
+	return true;
+}
+
+bool AudioVoicePoolPerfTest()
+{
+	// Simulates ten seconds of 500 effects per second at 60 FPS, each effect plays for 50-500ms
+	const size_t framesPerSecond = 60;
+	const size_t effectsPerSecond = 500;
+	const size_t seconds = 10;
+	const size_t formatCount = 4;
+
+	FakeVoiceBackend backend;
+	ff::AudioVoicePool pool(&backend, 64);
+	ff::Vector<WAVEFORMATEX> formats;
+	for (size_t i = 0; i < formatCount; i++)
+	{
+		formats.Push(::CreateWaveFormat(22050 * (DWORD)(i / 2 + 1), (WORD)(i % 2 + 1)));
+	}
+
+	ff::Vector<std::unique_ptr<FakeEffect>> effects;
+	size_t playCount = 0;
+	size_t randomState = 1;
+	ff::Timer timer;
+
+	for (size_t frame = 0; frame < framesPerSecond * seconds; frame++)
+	{
+		double now = (double)frame / framesPerSecond;
+
+		// Like AudioDevice::AdvanceEffects, finished effects give their voices back
+		for (size_t i = effects.Size(); i > 0; i--)
+		{
+			FakeEffect& effect = *effects[i - 1];
+			if (effect._stolen || effect._endTime <= now)
+			{
+				pool.Release(effect._voice);
+				effects.Delete(i - 1);
+			}
+		}
+
+		for (; playCount < (frame + 1) * effectsPerSecond / framesPerSecond; playCount++)
+		{
+			randomState = randomState * 6364136223846793005 + 1442695040888963407;
+
+			std::unique_ptr<FakeEffect> effect = std::make_unique<FakeEffect>();
+			effect->_endTime = now + 0.05 + (randomState >> 33) % 450 / 1000.0;
+			effect->_voice = pool.Acquire(formats[playCount % formatCount], (int)(randomState >> 62), effect.get());
+
+			if (effect->_voice)
+			{
+				effects.Push(std::move(effect));
+			}
+		}
+	}
+
+	double time = timer.Tick();
+	ff::AudioVoicePoolStats stats = pool.GetStats();
+
+	ff::String status = ff::String::format_new(
+		L"Voice pool: %lu effects, %lu voices created instead of %lu, %lu reused, %lu stolen, %lu dropped, %.2fus per effect\r\n",
+		playCount,
+		stats._creates,
+		playCount,
+		stats._hits,
+		stats._steals,
+		stats._failures,
+		time * 1000000.0 / playCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	pool.Clear();
+	return !backend._liveCount;
+}
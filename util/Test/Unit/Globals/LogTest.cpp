@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
+
+static ff::String GetLogText(ff::IDataVector* data)
+{
+	return ff::String((const wchar_t*)data->GetMem(), data->GetSize() / sizeof(wchar_t));
+}
+
+static void TraceFormats(ff::Log& log)
+{
+	// The string buffer changes after each call, so the log must copy it
+	wchar_t changing[32];
+	wcscpy_s(changing, L"first");
+	log.TraceLineF(L"%s %S %hs %ls [%-8s] [%8.3s]", changing, "narrow", "narrow2", L"wide", L"left", L"precision");
+	wcscpy_s(changing, L"second");
+	log.TraceLineF(L"%d %i %u %x %X %o %c %C %lu %ld", -12, 34, 56u, 0xabc, 0xdef, 8, L'w', 'n', 78ul, -90l);
+	log.TraceLineF(L"%I64d %lld %llu %zu %Iu %I32d", -1234567890123LL, 1234567890123LL, 18446744073709551615ULL, (size_t)42, (size_t)43, 44);
+	log.TraceLineF(L"%f %.2f %8.3f %-8.1f| %e %g %G %a", 1.5, 2.25, -3.125, 4.0, 12345.678, 0.0001, 1e20, 0.5);
+	log.TraceLineF(L"%*d [%-*d] %.*f %.*f %*.*f", 6, 7, 5, 8, 3, 3.14159, -1, 2.5, 10, 2, 9.876);
+	log.TraceLineF(L"100%% %s %p %s", changing, (void*)0x1234, (const wchar_t*)nullptr);
+	log.TraceF(L"No arguments\r\n");
+	log.Trace(L"Plain text\r\n");
+	log.TraceLine(L"Line");
+	log.TraceSpaces(4);
+	log.TraceLine(nullptr);
+}
+
+static ff::String GetLongText()
+{
+	ff::String text;
+	for (size_t i = 0; i < 1000; i++)
+	{
+		text.append(ff::String::format_new(L"%lu,", i));
+	}
+
+	return text;
+}
+
+static bool TestAsyncMatchesSync()
+{
+	ff::String longText = ::GetLongText();
+
+	ff::ComPtr<ff::IDataVector> syncData;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&syncData, &writer), false);
+
+		ff::Log log;
+		assertRetVal(log.AddWriter(writer), false);
+		::TraceFormats(log);
+		log.TraceLine(longText.c_str());
+	}
+
+	ff::ComPtr<ff::IDataVector> asyncData;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&asyncData, &writer), false);
+
+		ff::Log log;
+		assertRetVal(log.AddWriter(writer), false);
+		assertRetVal(log.StartFlushThread(), false);
+		::TraceFormats(log);
+		log.TraceLine(longText.c_str());
+		log.Flush();
+
+		assertRetVal(!log.GetDroppedCount(), false);
+		assertRetVal(log.RemoveWriter(writer), false);
+
+		// Nothing gets written after the writer is removed
+		log.TraceLine(L"Not written");
+		log.StopFlushThread();
+	}
+
+	ff::String syncText = ::GetLogText(syncData);
+	ff::String asyncText = ::GetLogText(asyncData);
+
+	assertRetVal(syncText.size() > longText.size(), false);
+	assertRetVal(syncText == asyncText, false);
+
+	return true;
+}
+
+static bool TestThreadOrder()
+{
+	const size_t threadCount = 4;
+	const size_t linesPerThread = 200;
+
+	ff::ComPtr<ff::IDataVector> data;
+	ff::ComPtr<ff::IDataWriter> writer;
+	assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+
+	ff::Log log;
+	assertRetVal(log.AddWriter(writer), false);
+	assertRetVal(log.StartFlushThread(), false);
+
+	std::atomic<size_t> threadsDone = 0;
+	ff::WinHandle doneEvent = ff::CreateEvent();
+
+	for (size_t thread = 0; thread < threadCount; thread++)
+	{
+		ff::GetThreadPool()->AddThread([&log, &threadsDone, &doneEvent, thread]()
+			{
+				for (size_t i = 0; i < linesPerThread; i++)
+				{
+					log.TraceLineF(L"%lu:%lu", thread, i);
+				}
+
+				if (++threadsDone == threadCount)
+				{
+					::SetEvent(doneEvent);
+				}
+			});
+	}
+
+	ff::WaitForHandle(doneEvent);
+	log.StopFlushThread();
+	assertRetVal(!log.GetDroppedCount(), false);
+
+	// Each thread's lines must be complete and in order
+	std::array<size_t, threadCount> next{};
+	size_t lines = 0;
+	ff::String text = ::GetLogText(data);
+
+	for (const wchar_t* line = text.c_str(); *line; lines++)
+	{
+		unsigned long thread, i;
+		assertRetVal(swscanf_s(line, L"%lu:%lu", &thread, &i) == 2 && thread < threadCount && i == next[thread]++, false);
+
+		line = wcschr(line, L'\n');
+		assertRetVal(line, false);
+		line++;
+	}
+
+	assertRetVal(lines == threadCount * linesPerThread, false);
+
+	return true;
+}
+
+bool LogTest()
+{
+	return ::TestAsyncMatchesSync() && ::TestThreadOrder();
+}
+
+struct LogPerfResult
+{
+	double _nsPerCall;
+	size_t _calls;
+	size_t _dropped;
+	size_t _lines;
+};
+
+static LogPerfResult RunLogPerf(bool async, size_t threadCount, size_t callsPerThread)
+{
+	ff::ComPtr<ff::IDataVector> data;
+	ff::ComPtr<ff::IDataWriter> writer;
+	verify(ff::CreateDataWriter(&data, &writer));
+
+	ff::Log log;
+	verify(log.AddWriter(writer));
+
+	if (async)
+	{
+		verify(log.StartFlushThread());
+	}
+
+	std::atomic<size_t> threadsReady = 0;
+	std::atomic<size_t> threadsDone = 0;
+	std::atomic<INT64> totalTime = 0;
+	ff::WinHandle startEvent = ff::CreateEvent();
+	ff::WinHandle doneEvent = ff::CreateEvent();
+
+	for (size_t thread = 0; thread < threadCount; thread++)
+	{
+		ff::GetThreadPool()->AddThread([&, thread]()
+			{
+				threadsReady++;
+				::WaitForSingleObject(startEvent, INFINITE);
+
+				INT64 start = ff::Timer::GetCurrentRawTime();
+				for (size_t i = 0; i < callsPerThread; i++)
+				{
+					log.TraceF(L"Thread %lu, message %lu, value %.2f, %s\r\n", thread, i, i * 0.5, L"text");
+				}
+
+				totalTime += ff::Timer::GetCurrentRawTime() - start;
+
+				if (++threadsDone == threadCount)
+				{
+					::SetEvent(doneEvent);
+				}
+			});
+	}
+
+	while (threadsReady != threadCount)
+	{
+		::Sleep(1);
+	}
+
+	::SetEvent(startEvent);
+	ff::WaitForHandle(doneEvent);
+	log.StopFlushThread();
+
+	ff::String text = ::GetLogText(data);
+	LogPerfResult result{};
+	result._calls = threadCount * callsPerThread;
+	result._nsPerCall = totalTime * 1000000000.0 / ff::Timer::GetRawFreqStatic() / result._calls;
+	result._dropped = log.GetDroppedCount();
+
+	// Skips the lines that report dropped messages
+	for (const wchar_t* line = text.c_str(); *line; line++)
+	{
+		if (!wcsncmp(line, L"Thread ", 7))
+		{
+			result._lines++;
+		}
+
+		line = wcschr(line, L'\n');
+		if (!line)
+		{
+			break;
+		}
+	}
+
+	return result;
+}
+
+bool LogPerfTest()
+{
+	const size_t callsPerThread = 20000;
+	bool valid = true;
+
+	for (size_t threadCount : { 1, 8 })
+	{
+		LogPerfResult syncResult = ::RunLogPerf(false, threadCount, callsPerThread);
+		LogPerfResult asyncResult = ::RunLogPerf(true, threadCount, callsPerThread);
+
+		valid &= (syncResult._lines == syncResult._calls);
+		valid &= (asyncResult._lines == asyncResult._calls - asyncResult._dropped);
+
+		ff::String status = ff::String::format_new(
+			L"Log, %lu thread(s): sync %.0fns/call, async %.0fns/call (%lu of %lu dropped)\r\n",
+			threadCount,
+			syncResult._nsPerCall,
+			asyncResult._nsPerCall,
+			asyncResult._dropped,
+			asyncResult._calls);
+		ff::Log::DebugTraceF(status.c_str());
+		std::wcout << status.c_str();
+	}
+
+	return valid;
+}
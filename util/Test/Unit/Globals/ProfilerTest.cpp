@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Globals/Profiler.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
+
+static const ff::ProfileZone* FindZone(const ff::Vector<ff::ProfileZoneStats>& stats, const wchar_t* name, ff::ProfileZoneStats& result)
+{
+	for (const ff::ProfileZoneStats& zoneStats : stats)
+	{
+		if (!wcscmp(zoneStats._zone->_name, name))
+		{
+			result = zoneStats;
+			return zoneStats._zone;
+		}
+	}
+
+	return nullptr;
+}
+
+static void RecordTestFrame()
+{
+	PROFILE_ZONE(L"ProfilerTest outer");
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		PROFILE_ZONE(L"ProfilerTest inner");
+		::Sleep(0);
+	}
+}
+
+static bool TestStats()
+{
+	// Covers two full stats windows, since one might have already started
+	for (size_t i = 0; i < 122; i++)
+	{
+		ff::ProfileFrame();
+		::RecordTestFrame();
+	}
+
+	ff::ProfileZoneStats outer, inner;
+	ff::Vector<ff::ProfileZoneStats> stats = ff::GetProfileZoneStats(100);
+	assertRetVal(::FindZone(stats, L"ProfilerTest outer", outer) && ::FindZone(stats, L"ProfilerTest inner", inner), false);
+
+	assertRetVal(outer._calls == 1 && inner._calls == 2, false);
+	assertRetVal(outer._totalSeconds >= inner._totalSeconds && inner._totalSeconds > 0, false);
+	assertRetVal(inner._selfSeconds == inner._totalSeconds, false);
+	assertRetVal(std::abs(outer._selfSeconds - (outer._totalSeconds - inner._totalSeconds)) < 0.000001, false);
+
+	for (size_t i = 1; i < stats.Size(); i++)
+	{
+		assertRetVal(stats[i - 1]._selfSeconds >= stats[i]._selfSeconds, false);
+	}
+
+	return true;
+}
+
+static bool TestDropped()
+{
+	size_t dropped = ff::GetProfileDroppedCount();
+	ff::WinHandle doneEvent = ff::CreateEvent();
+
+	// A new thread buffer fills up without any frames to read it
+	ff::GetThreadPool()->AddThread([&doneEvent]()
+		{
+			{
+				PROFILE_ZONE(L"ProfilerTest thread");
+
+				for (size_t i = 0; i < 20000; i++)
+				{
+					PROFILE_ZONE(L"ProfilerTest thread inner");
+				}
+			}
+
+			::SetEvent(doneEvent);
+		});
+
+	ff::WaitForHandle(doneEvent);
+	ff::ProfileFrame();
+
+	assertRetVal(ff::GetProfileDroppedCount() > dropped, false);
+
+	return true;
+}
+
+static bool TestCapture()
+{
+	const size_t frameCount = 3;
+	ff::EnableProfiling(false);
+	ff::StartProfileCapture(frameCount);
+	assertRetVal(ff::IsProfilingEnabled() && ff::IsProfileCapturing(), false);
+
+	for (size_t i = 0; i <= frameCount; i++)
+	{
+		ff::ProfileFrame();
+
+		ff::WinHandle doneEvent = ff::CreateEvent();
+		ff::GetThreadPool()->AddThread([&doneEvent]()
+			{
+				{
+					PROFILE_ZONE(L"ProfilerTest \"background\"");
+				}
+
+				::SetEvent(doneEvent);
+			});
+
+		::RecordTestFrame();
+		ff::WaitForHandle(doneEvent);
+	}
+
+	assertRetVal(!ff::IsProfileCapturing() && !ff::IsProfilingEnabled(), false);
+
+	ff::ComPtr<ff::IDataVector> data;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+		assertRetVal(ff::SaveProfileCapture(writer), false);
+	}
+
+	std::string json((const char*)data->GetMem(), data->GetSize());
+	auto countText = [&json](const char* text)
+	{
+		size_t count = 0;
+		for (size_t pos = json.find(text); pos != std::string::npos; pos = json.find(text, pos + 1))
+		{
+			count++;
+		}
+
+		return count;
+	};
+
+	assertRetVal(json.front() == '{' && json.find("]}") != std::string::npos, false);
+	assertRetVal(countText("\"name\":\"Frame\"") == frameCount, false);
+	assertRetVal(countText("\"name\":\"ProfilerTest outer\"") == frameCount, false);
+	assertRetVal(countText("\"name\":\"ProfilerTest inner\"") == frameCount * 2, false);
+	assertRetVal(countText("\"name\":\"ProfilerTest \\\"background\\\"\"") == frameCount, false);
+
+	return true;
+}
+
+bool ProfilerTest()
+{
+	ff::EnableProfiling(true);
+	bool result = ::TestStats() && ::TestDropped() && ::TestCapture();
+	ff::EnableProfiling(false);
+
+	return result;
+}
+
+static double MeasureZones(size_t count)
+{
+	const size_t zonesPerFrame = 4096;
+	INT64 time = 0;
+
+	for (size_t done = 0; done < count; done += zonesPerFrame)
+	{
+		ff::ProfileFrame();
+		INT64 start = ff::Timer::GetCurrentRawTime();
+
+		for (size_t i = 0; i < zonesPerFrame; i++)
+		{
+			PROFILE_ZONE(L"ProfilerPerfTest");
+		}
+
+		time += ff::Timer::GetCurrentRawTime() - start;
+	}
+
+	ff::ProfileFrame();
+
+	return time * 1000000000.0 / ff::Timer::GetRawFreqStatic() / count;
+}
+
+bool ProfilerPerfTest()
+{
+	const size_t zoneCount = 1024 * 1024;
+	size_t dropped = ff::GetProfileDroppedCount();
+
+	ff::EnableProfiling(false);
+	double disabledTime = ::MeasureZones(zoneCount);
+
+	ff::EnableProfiling(true);
+	double enabledTime = ::MeasureZones(zoneCount);
+	ff::EnableProfiling(false);
+
+	ff::String status = ff::String::format_new(
+		L"Profile zones: %.1fns each when enabled, %.1fns when disabled\r\n",
+		enabledTime,
+		disabledTime);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return ff::GetProfileDroppedCount() == dropped;
+}
@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "COM/ComAlloc.h"
+#include "Dict/Dict.h"
+#include "Graph/Anim/Animation.h"
+#include "Graph/Anim/AnimationBatch.h"
+#include "Graph/Anim/Transform.h"
+#include "Value/Values.h"
+
+static ff::StaticString PROP_VALUE(L"value");
+
+// Remembers each RenderFrames call instead of drawing
+class __declspec(uuid("cba8291b-c33e-4cd3-9e9e-b52a1c676990"))
+	RecordingAnimation
+	: public ff::ComBase
+	, public ff::IAnimation
+{
+public:
+	DECLARE_HEADER(RecordingAnimation);
+
+	struct RenderCall
+	{
+		size_t _count;
+		int _value;
+	};
+
+	// IAnimation
+	virtual float GetFrameLength() const override;
+	virtual float GetFramesPerSecond() const override;
+	virtual void GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events) override;
+	virtual void RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params) override;
+	virtual void RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params) override;
+	virtual ff::ValuePtr GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params) override;
+	virtual ff::ComPtr<ff::IAnimationPlayer> CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params) override;
+
+	ff::Vector<RenderCall> _calls;
+};
+
+BEGIN_INTERFACES(RecordingAnimation)
+	HAS_INTERFACE(ff::IAnimation)
+END_INTERFACES()
+
+RecordingAnimation::RecordingAnimation()
+{
+}
+
+RecordingAnimation::~RecordingAnimation()
+{
+}
+
+float RecordingAnimation::GetFrameLength() const
+{
+	return 60;
+}
+
+float RecordingAnimation::GetFramesPerSecond() const
+{
+	return ff::ADVANCES_PER_SECOND_F;
+}
+
+void RecordingAnimation::GetFrameEvents(float start, float end, bool includeStart, ff::ItemCollector<ff::AnimationEvent>& events)
+{
+}
+
+void RecordingAnimation::RenderFrame(ff::IRendererActive* render, const ff::Transform& position, float frame, const ff::Dict* params)
+{
+	RenderFrames(render, &position, &frame, 1, params);
+}
+
+void RecordingAnimation::RenderFrames(ff::IRendererActive* render, const ff::Transform* positions, const float* frames, size_t count, const ff::Dict* params)
+{
+	_calls.Push(RenderCall{ count, params ? params->Get<ff::IntValue>(::PROP_VALUE, -1) : -1 });
+}
+
+ff::ValuePtr RecordingAnimation::GetFrameValue(ff::hash_t name, float frame, const ff::Dict* params)
+{
+	return nullptr;
+}
+
+ff::ComPtr<ff::IAnimationPlayer> RecordingAnimation::CreateAnimationPlayer(float startFrame, float speed, const ff::Dict* params)
+{
+	return nullptr;
+}
+
+static bool CompareEvents(const ff::Vector<ff::AnimationEvent>& lhs, const ff::Vector<ff::AnimationEvent>& rhs)
+{
+	assertRetVal(lhs.Size() == rhs.Size(), false);
+
+	for (size_t i = 0; i < lhs.Size(); i++)
+	{
+		assertRetVal(lhs[i]._animation == rhs[i]._animation && lhs[i]._event == rhs[i]._event && lhs[i]._properties == rhs[i]._properties, false);
+	}
+
+	return true;
+}
+
+// The batch must advance frames and report events exactly like one AnimationPlayer per instance, also after removing some
+static bool TestAdvance()
+{
+	ff::CreateAnimation createAnim1(20, ff::ADVANCES_PER_SECOND_F, ff::KeyFrames::MethodType::BoundsLoop);
+	createAnim1.AddEvent(0, ff::String::from_static(L"start"), nullptr, nullptr);
+	createAnim1.AddEvent(5.5f, ff::String::from_static(L"middle"), nullptr, nullptr);
+	createAnim1.AddEvent(12, ff::String::from_static(L"end"), nullptr, nullptr);
+
+	ff::CreateAnimation createAnim2(8, ff::ADVANCES_PER_SECOND_F / 2, ff::KeyFrames::MethodType::BoundsClamp);
+	createAnim2.AddEvent(2, ff::String::from_static(L"other"), nullptr, nullptr);
+
+	ff::ComPtr<ff::IAnimation> anims[2] = { createAnim1.Create(), createAnim2.Create() };
+	assertRetVal(anims[0] && anims[1], false);
+
+	const float starts[] = { 0, 3.25f, 7, 1.5f, 0.5f };
+	const float speeds[] = { 1, 0.5f, 2.5f, 1, 3 };
+
+	ff::AnimationBatch batch;
+	ff::Vector<ff::ComPtr<ff::IAnimationPlayer>> players;
+
+	for (size_t i = 0; i < _countof(starts); i++)
+	{
+		ff::IAnimation* anim = anims[i % 2];
+		assertRetVal(batch.Add(anim, ff::Transform::Identity(), starts[i], speeds[i]) == i, false);
+		players.Push(anim->CreateAnimationPlayer(starts[i], speeds[i]));
+	}
+
+	ff::Vector<ff::AnimationEvent> batchEvents;
+	ff::Vector<ff::AnimationEvent> playerEvents;
+	ff::PushCollector<ff::AnimationEvent, ff::Vector<ff::AnimationEvent>> batchCollector(batchEvents);
+	ff::PushCollector<ff::AnimationEvent, ff::Vector<ff::AnimationEvent>> playerCollector(playerEvents);
+
+	for (size_t advance = 0; advance < 200; advance++)
+	{
+		if (advance == 50 || advance == 120)
+		{
+			// The last player moves into the removed index
+			size_t index = (advance == 50) ? 1 : players.Size() - 1;
+			batch.Remove(index);
+			players[index] = players.GetLast();
+			players.Pop();
+		}
+
+		batchEvents.Clear();
+		playerEvents.Clear();
+
+		batch.Advance(advance % 3 ? &batchCollector : nullptr);
+
+		for (ff::IAnimationPlayer* player : players)
+		{
+			player->AdvanceAnimation(advance % 3 ? &playerCollector : nullptr);
+		}
+
+		assertRetVal(batch.GetCount() == players.Size(), false);
+		assertRetVal(::CompareEvents(batchEvents, playerEvents), false);
+
+		for (size_t i = 0; i < players.Size(); i++)
+		{
+			assertRetVal(batch.GetCurrentFrame(i) == players[i]->GetCurrentFrame(), false);
+			assertRetVal(batch.GetAnimation(i) == players[i]->GetAnimation(), false);
+		}
+	}
+
+	assertRetVal(batch.GetCount() == 3, false);
+	return true;
+}
+
+// Players are grouped by the contents of their params, not by the params pointer
+static bool TestGroups()
+{
+	ff::ComPtr<RecordingAnimation, ff::IAnimation> anim;
+	assertHrRetVal(ff::ComAllocator<RecordingAnimation>::CreateInstance(&anim), false);
+
+	ff::Dict params;
+	params.Set<ff::IntValue>(::PROP_VALUE, 1);
+
+	ff::Dict sameParams;
+	sameParams.Set<ff::IntValue>(::PROP_VALUE, 1);
+
+	ff::Dict emptyParams;
+	ff::AnimationBatch batch;
+
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, &params);
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, nullptr);
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, &sameParams);
+
+	// Same pointer with new contents must not join the old group
+	params.Set<ff::IntValue>(::PROP_VALUE, 2);
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, &params);
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, &emptyParams);
+	batch.Add(anim, ff::Transform::Identity(), 0, 1, &sameParams);
+
+	batch.Render(nullptr);
+	assertRetVal(anim->_calls.Size() == 3, false);
+	assertRetVal(anim->_calls[0]._count == 3 && anim->_calls[0]._value == 1, false);
+	assertRetVal(anim->_calls[1]._count == 2 && anim->_calls[1]._value == -1, false);
+	assertRetVal(anim->_calls[2]._count == 1 && anim->_calls[2]._value == 2, false);
+
+	// Removing the only player of a group stops it from rendering
+	batch.Remove(3);
+	anim->_calls.Clear();
+	batch.Render(nullptr);
+	assertRetVal(batch.GetCount() == 5 && anim->_calls.Size() == 2, false);
+	assertRetVal(anim->_calls[0]._count == 3 && anim->_calls[1]._count == 2, false);
+
+	return true;
+}
+
+bool AnimationBatchTest()
+{
+	return ::TestAdvance() && ::TestGroups();
+}
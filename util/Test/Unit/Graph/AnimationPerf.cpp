@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Anim/Animation.h"
+#include "Graph/Anim/KeyFrames.h"
+#include "Graph/Anim/Transform.h"
+#include "Types/Timer.h"
+#include "Value/Values.h"
+
+bool AnimationPerfTest()
+{
+	const size_t visualCount = 64;
+	const size_t instanceCount = 10000;
+	const size_t frameCount = 60;
+
+	// A sprite sheet animation, each frame shows a different visual
+
+	ff::KeyFrames::MethodType method = ff::KeyFrames::MethodType::BoundsLoop;
+	ff::CreateKeyFrames createKeys(ff::String::from_static(L"visual"), 0, (float)visualCount, method);
+	ff::Vector<ff::ComPtr<ff::IAnimation>> visuals;
+	ff::Map<ff::ValuePtr, ff::ComPtr<ff::IAnimation>> cachedVisuals;
+	ff::Vector<ff::ComPtr<ff::IAnimation>> bakedVisuals;
+
+	for (size_t i = 0; i < visualCount; i++)
+	{
+		ff::ComPtr<ff::IAnimation> visual = ff::CreateAnimation(1).Create();
+		assertRetVal(visual, false);
+
+		ff::ValuePtr value = ff::Value::New<ff::ObjectValue>(visual);
+		createKeys.AddFrame((float)i, value);
+		visuals.Push(visual);
+	}
+
+	ff::KeyFrames keys = createKeys.Create();
+	for (size_t i = 0; i < keys.GetKeyCount(); i++)
+	{
+		ff::ComPtr<ff::IAnimation> visual;
+		assertRetVal(visual.QueryFrom(keys.GetKeyValue(i)->GetComObject()), false);
+		cachedVisuals.SetKey(keys.GetKeyValue(i), visual);
+		bakedVisuals.Push(visual);
+	}
+
+	ff::CreateAnimation createAnim((float)visualCount, ff::ADVANCES_PER_SECOND_F, method);
+	createAnim.AddKeys(createKeys);
+	createAnim.AddVisual(0, (float)visualCount, 1, method, ff::String::from_static(L"visual"), ff::String(), ff::String(), ff::String(), ff::String());
+	ff::ComPtr<ff::IAnimation> anim = createAnim.Create();
+	assertRetVal(anim, false);
+
+	// Visual lookup by value (hashed each time) vs. by baked key index
+
+	ff::Timer timer;
+	size_t cachedSum = 0;
+	size_t bakedSum = 0;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			float visualFrame = frame + (i % 128) * 0.5f;
+			auto iter = cachedVisuals.GetKey(keys.GetValue(visualFrame));
+			cachedSum += (size_t)(ff::IAnimation*)iter->GetValue();
+		}
+	}
+
+	double cachedTime = timer.Tick();
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			float visualFrame = frame + (i % 128) * 0.5f;
+			bakedSum += (size_t)(ff::IAnimation*)bakedVisuals[keys.GetStepKeyIndex(visualFrame)];
+		}
+	}
+
+	double bakedTime = timer.Tick();
+	assertRetVal(cachedSum == bakedSum, false);
+
+	// Whole frames, nothing is drawn since the visuals are empty
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			anim->RenderFrame(nullptr, ff::Transform::Identity(), frame + (i % 128) * 0.5f);
+		}
+	}
+
+	double renderTime = timer.Tick();
+
+	ff::String status = ff::String::format_new(
+		L"Animation: %lu instances of %lu visual frames, per frame lookup by value:%fms, by key index:%fms, RenderFrame:%fms\r\n",
+		instanceCount,
+		visualCount,
+		cachedTime * 1000.0 / frameCount,
+		bakedTime * 1000.0 / frameCount,
+		renderTime * 1000.0 / frameCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Graph/Font/CharGlyphTable.h"
+#include "Test/Unit/TestRandom.h"
+#include "Types/Timer.h"
+
+// Fills the table like a font would, using a flat array as the expected result
+static void FillCharGlyphTable(ff::CharGlyphTable& table, ff::Vector<UINT16>& flat, const ff::Vector<std::pair<wchar_t, wchar_t>>& ranges)
+{
+	UINT16 glyph = 1;
+	table.Clear();
+	flat.Resize(0x10000);
+	::ZeroMemory(flat.Data(), flat.ByteSize());
+
+	for (const std::pair<wchar_t, wchar_t>& range : ranges)
+	{
+		for (size_t ch = range.first; ch <= range.second; ch++)
+		{
+			table.SetGlyph((wchar_t)ch, glyph);
+			flat[ch] = glyph++;
+		}
+	}
+}
+
+static ff::Vector<std::pair<wchar_t, wchar_t>> GetLatinRanges()
+{
+	ff::Vector<std::pair<wchar_t, wchar_t>> ranges;
+	ranges.Push(std::make_pair(L'\x0020', L'\x007E'));
+	ranges.Push(std::make_pair(L'\x00A0', L'\x024F'));
+	ranges.Push(std::make_pair(L'\x2010', L'\x2027'));
+	return ranges;
+}
+
+static ff::Vector<std::pair<wchar_t, wchar_t>> GetCjkRanges()
+{
+	ff::Vector<std::pair<wchar_t, wchar_t>> ranges = ::GetLatinRanges();
+	ranges.Push(std::make_pair(L'\x3000', L'\x30FF'));
+	ranges.Push(std::make_pair(L'\x4E00', L'\x9FFF'));
+	ranges.Push(std::make_pair(L'\xFF00', L'\xFFEF'));
+	return ranges;
+}
+
+bool CharGlyphTableTest()
+{
+	ff::CharGlyphTable table;
+	ff::Vector<UINT16> flat;
+	::FillCharGlyphTable(table, flat, ::GetCjkRanges());
+
+	for (size_t ch = 0; ch < flat.Size(); ch++)
+	{
+		assertRetVal(table.GetGlyph((wchar_t)ch) == flat[ch], false);
+	}
+
+	// Save and load
+
+	ff::ComPtr<ff::IDataVector> data;
+	{
+		ff::ComPtr<ff::IDataWriter> writer;
+		assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+		assertRetVal(table.Save(writer), false);
+	}
+
+	ff::CharGlyphTable loadedTable;
+	{
+		ff::ComPtr<ff::IDataReader> reader;
+		assertRetVal(ff::CreateDataReader(data, 0, &reader), false);
+		assertRetVal(loadedTable.Load(reader), false);
+	}
+
+	assertRetVal(loadedTable.GetPageCount() == table.GetPageCount(), false);
+
+	for (size_t ch = 0; ch < flat.Size(); ch++)
+	{
+		assertRetVal(loadedTable.GetGlyph((wchar_t)ch) == flat[ch], false);
+	}
+
+	// Clearing a glyph doesn't allocate a page
+
+	ff::CharGlyphTable emptyTable;
+	emptyTable.SetGlyph(L'\x8000', 0);
+	assertRetVal(emptyTable.GetPageCount() == 0 && emptyTable.GetGlyph(L'\x8000') == 0, false);
+
+	return true;
+}
+
+static bool RunCharGlyphTablePerf(const wchar_t* name, const ff::Vector<std::pair<wchar_t, wchar_t>>& ranges)
+{
+	const size_t textSize = 1024 * 1024;
+	const size_t repeat = 20;
+
+	ff::CharGlyphTable table;
+	ff::Vector<UINT16> flat;
+	::FillCharGlyphTable(table, flat, ranges);
+
+	// Random text from the characters in the font
+	ff::Vector<wchar_t> chars;
+	for (const std::pair<wchar_t, wchar_t>& range : ranges)
+	{
+		for (size_t ch = range.first; ch <= range.second; ch++)
+		{
+			chars.Push((wchar_t)ch);
+		}
+	}
+
+	ff::Vector<wchar_t> text;
+	text.Reserve(textSize);
+	TestRandom random(1);
+	for (size_t i = 0; i < textSize; i++)
+	{
+		text.Push(chars[random.Next(chars.Size())]);
+	}
+
+	size_t tableSum = 0;
+	size_t flatSum = 0;
+
+	ff::Timer timer;
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (wchar_t ch : text)
+		{
+			tableSum += table.GetGlyph(ch);
+		}
+	}
+
+	double tableTime = timer.Tick();
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (wchar_t ch : text)
+		{
+			flatSum += flat[ch];
+		}
+	}
+
+	double flatTime = timer.Tick();
+	assertRetVal(tableSum == flatSum, false);
+
+	// The old table stored 8 bytes for every UTF-16 character
+	const size_t flatMemorySize = 0x10000 * 8;
+
+	ff::String status = ff::String::format_new(
+		L"Glyph table %s: %lu chars, %lu pages, %lu bytes (was %lu), lookup paged:%fns, flat:%fns\r\n",
+		name,
+		chars.Size(),
+		table.GetPageCount(),
+		table.GetMemorySize(),
+		flatMemorySize,
+		tableTime * 1000000000.0 / (textSize * repeat),
+		flatTime * 1000000000.0 / (textSize * repeat));
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
+
+bool CharGlyphTablePerfTest()
+{
+	assertRetVal(::RunCharGlyphTablePerf(L"Latin", ::GetLatinRanges()), false);
+	assertRetVal(::RunCharGlyphTablePerf(L"CJK", ::GetCjkRanges()), false);
+	return true;
+}
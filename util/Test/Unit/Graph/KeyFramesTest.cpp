@@ -0,0 +1,191 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Anim/KeyFrames.h"
+#include "Types/Timer.h"
+#include "Value/Values.h"
+
+static ff::KeyFrames CreatePositionKeys(ff::KeyFrames::MethodType method)
+{
+	ff::CreateKeyFrames create(ff::String::from_static(L"position"), 0, 60, method);
+	create.AddFrame(0, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0, 0)));
+	create.AddFrame(10, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(100, 50)));
+	create.AddFrame(30, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(-20, 80)));
+	create.AddFrame(60, ff::Value::New<ff::PointFloatValue>(ff::PointFloat(0, 0)));
+	return create.Create();
+}
+
+static ff::KeyFrames CreateRotateKeys(ff::KeyFrames::MethodType method)
+{
+	ff::CreateKeyFrames create(ff::String::from_static(L"rotate"), 0, 60, method, ff::Value::New<ff::FloatValue>(5.0f));
+	create.AddFrame(0, ff::Value::New<ff::FloatValue>(0.0f));
+	create.AddFrame(20, ff::Value::New<ff::FloatValue>(90.0f));
+	create.AddFrame(60, ff::Value::New<ff::FloatValue>(360.0f));
+	return create.Create();
+}
+
+static ff::KeyFrames CreateColorKeys(ff::KeyFrames::MethodType method)
+{
+	ff::CreateKeyFrames create(ff::String::from_static(L"color"), 0, 60, method);
+	create.AddFrame(0, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(1, 1, 1, 1)));
+	create.AddFrame(15, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(1, 0, 0, 0.5f)));
+	create.AddFrame(45, ff::Value::New<ff::RectFloatValue>(ff::RectFloat(0, 0, 1, 1)));
+	return create.Create();
+}
+
+static bool NearlyEqual(float lhs, float rhs)
+{
+	return std::abs(lhs - rhs) <= 0.001f * std::max(1.0f, std::abs(lhs));
+}
+
+template<typename T, typename ValueT>
+static bool CompareKeyFrames(ff::KeyFrames& keys)
+{
+	// Two players share the keys, one plays forward and the other backward with its own cursor
+	size_t forwardCursor = 0;
+	size_t backwardCursor = 0;
+
+	for (float frame = -10; frame < 130; frame += 0.25f)
+	{
+		ff::ValuePtrT<ValueT> boxedValue = keys.GetValue(frame);
+		T typedValue;
+		bool hasTypedValue = keys.GetValue(frame, typedValue);
+		assertRetVal(hasTypedValue != !boxedValue, false);
+
+		T forwardValue;
+		T backwardValue;
+		T backwardExpected;
+		float backwardFrame = 120 - frame;
+		bool hasBackwardValue = keys.GetValue(backwardFrame, backwardExpected);
+		assertRetVal(keys.GetValue(frame, forwardValue, nullptr, &forwardCursor) == hasTypedValue, false);
+		assertRetVal(keys.GetValue(backwardFrame, backwardValue, nullptr, &backwardCursor) == hasBackwardValue, false);
+		assertRetVal(!hasTypedValue || !std::memcmp(&forwardValue, &typedValue, sizeof(T)), false);
+		assertRetVal(!hasBackwardValue || !std::memcmp(&backwardValue, &backwardExpected, sizeof(T)), false);
+
+		if (hasTypedValue)
+		{
+			const float* boxed = reinterpret_cast<const float*>(&boxedValue.GetValue());
+			const float* typed = reinterpret_cast<const float*>(&typedValue);
+
+			for (size_t i = 0; i < sizeof(T) / sizeof(float); i++)
+			{
+				assertRetVal(::NearlyEqual(boxed[i], typed[i]), false);
+			}
+		}
+	}
+
+	return true;
+}
+
+bool KeyFramesTest()
+{
+	ff::KeyFrames::MethodType methods[] =
+	{
+		ff::KeyFrames::MethodType::Default,
+		ff::SetFlags(ff::KeyFrames::MethodType::BoundsLoop, ff::KeyFrames::MethodType::InterpolateSpline),
+		ff::SetFlags(ff::KeyFrames::MethodType::BoundsClamp, ff::KeyFrames::MethodType::InterpolateLinear),
+	};
+
+	for (ff::KeyFrames::MethodType method : methods)
+	{
+		ff::KeyFrames positionKeys = ::CreatePositionKeys(method);
+		ff::KeyFrames rotateKeys = ::CreateRotateKeys(method);
+		ff::KeyFrames colorKeys = ::CreateColorKeys(method);
+
+		assertRetVal((::CompareKeyFrames<ff::PointFloat, ff::PointFloatValue>(positionKeys)), false);
+		assertRetVal((::CompareKeyFrames<float, ff::FloatValue>(rotateKeys)), false);
+		assertRetVal((::CompareKeyFrames<ff::RectFloat, ff::RectFloatValue>(colorKeys)), false);
+	}
+
+	// Keys that can't be compiled still return typed values
+
+	ff::CreateKeyFrames create(ff::String::from_static(L"mixed"), 0, 10);
+	create.AddFrame(0, ff::Value::New<ff::FloatValue>(1.0f));
+	create.AddFrame(10, ff::Value::New<ff::IntValue>(2));
+	ff::KeyFrames mixedKeys = create.Create();
+
+	float value = 0;
+	assertRetVal(mixedKeys.GetValue(5.0f, value) && value == 1.0f, false);
+
+	// Keys that can't be interpolated can be found by index
+
+	ff::CreateKeyFrames createStep(ff::String::from_static(L"step"), 0, 30, ff::KeyFrames::MethodType::BoundsLoop);
+	createStep.AddFrame(0, ff::Value::New<ff::StringValue>(ff::String::from_static(L"a")));
+	createStep.AddFrame(10, ff::Value::New<ff::StringValue>(ff::String::from_static(L"b")));
+	createStep.AddFrame(20, ff::Value::New<ff::StringValue>(ff::String::from_static(L"c")));
+	ff::KeyFrames stepKeys = createStep.Create();
+
+	for (float frame = -10; frame < 70; frame += 0.5f)
+	{
+		size_t index = stepKeys.GetStepKeyIndex(frame);
+		assertRetVal(index < stepKeys.GetKeyCount() && stepKeys.GetKeyValue(index) == stepKeys.GetValue(frame), false);
+	}
+
+	return true;
+}
+
+bool KeyFramesPerfTest()
+{
+	const size_t visualCount = 10000;
+	const size_t frameCount = 60;
+
+	ff::KeyFrames::MethodType method = ff::SetFlags(ff::KeyFrames::MethodType::BoundsLoop, ff::KeyFrames::MethodType::InterpolateSpline);
+	ff::KeyFrames positionKeys = ::CreatePositionKeys(method);
+	ff::KeyFrames scaleKeys = ::CreatePositionKeys(method);
+	ff::KeyFrames rotateKeys = ::CreateRotateKeys(method);
+	ff::KeyFrames colorKeys = ::CreateColorKeys(method);
+
+	// Each visual plays the same animation at a different offset, like particles
+	float boxedSum = 0;
+	float typedSum = 0;
+	ff::Timer timer;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < visualCount; i++)
+		{
+			float visualFrame = frame + (i % 64) * 0.5f;
+
+			ff::ValuePtrT<ff::PointFloatValue> position = positionKeys.GetValue(visualFrame);
+			ff::ValuePtrT<ff::PointFloatValue> scale = scaleKeys.GetValue(visualFrame);
+			ff::ValuePtrT<ff::FloatValue> rotate = rotateKeys.GetValue(visualFrame);
+			ff::ValuePtrT<ff::RectFloatValue> color = colorKeys.GetValue(visualFrame);
+
+			boxedSum += position.GetValue().x + scale.GetValue().y + rotate.GetValue() + color.GetValue().right;
+		}
+	}
+
+	double boxedTime = timer.Tick();
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < visualCount; i++)
+		{
+			float visualFrame = frame + (i % 64) * 0.5f;
+
+			ff::PointFloat position;
+			ff::PointFloat scale;
+			float rotate;
+			ff::RectFloat color;
+
+			positionKeys.GetValue(visualFrame, position);
+			scaleKeys.GetValue(visualFrame, scale);
+			rotateKeys.GetValue(visualFrame, rotate);
+			colorKeys.GetValue(visualFrame, color);
+
+			typedSum += position.x + scale.y + rotate + color.right;
+		}
+	}
+
+	double typedTime = timer.Tick();
+	assertRetVal(::NearlyEqual(boxedSum, typedSum), false);
+
+	ff::String status = ff::String::format_new(
+		L"Key frames: %lu visuals x 4 tracks, per frame boxed:%fms, typed:%fms\r\n",
+		visualCount,
+		boxedTime * 1000.0 / frameCount,
+		typedTime * 1000.0 / frameCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
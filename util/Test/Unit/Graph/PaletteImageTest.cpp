@@ -0,0 +1,182 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Texture/PaletteImage.h"
+#include "Test/Unit/TestRandom.h"
+#include "Types/Timer.h"
+
+// Mostly empty like a sprite's alpha, so the dilation has edges to find
+static ff::Vector<BYTE> CreateRandomMask(size_t count, size_t seed)
+{
+	ff::Vector<BYTE> mask = TestRandom(seed).NextBytes(count);
+	for (BYTE& value : mask)
+	{
+		value = (value < 16) ? value : 0;
+	}
+
+	return mask;
+}
+
+bool PaletteImageTest()
+{
+	ff::Vector<BYTE> remap = TestRandom(1).NextBytes(256);
+	ff::Vector<BYTE> colorBytes = TestRandom(2).NextBytes(256 * 4);
+	const DWORD* colors = reinterpret_cast<const DWORD*>(colorBytes.Data());
+
+	// Odd sizes make sure that the scalar code after the SIMD loops is used too
+	for (size_t count : { 1, 15, 16, 17, 63, 64, 1000 })
+	{
+		ff::Vector<BYTE> indexes = TestRandom(count).NextBytes(count);
+		ff::Vector<BYTE> remapped;
+		ff::Vector<DWORD> expanded;
+		ff::Vector<BYTE> alpha;
+		remapped.Resize(count);
+		expanded.Resize(count);
+		alpha.Resize(count);
+
+		ff::RemapPaletteRow(indexes.Data(), remapped.Data(), count, remap.Data());
+		ff::PaletteRowToColors(indexes.Data(), expanded.Data(), count, colors);
+		ff::ColorRowToAlpha(expanded.Data(), alpha.Data(), count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			assertRetVal(remapped[i] == remap[indexes[i]], false);
+			assertRetVal(expanded[i] == colors[indexes[i]], false);
+			assertRetVal(alpha[i] == (BYTE)(colors[indexes[i]] >> 24), false);
+		}
+
+		// In place
+		ff::RemapPaletteRow(indexes.Data(), indexes.Data(), count, remap.Data());
+		assertRetVal(indexes == remapped, false);
+
+		// Three mask rows with a border byte on each side
+		ff::Vector<BYTE> mask = ::CreateRandomMask((count + 2) * 3, count);
+		const BYTE* above = mask.Data() + 1;
+		const BYTE* row = above + count + 2;
+		const BYTE* below = row + count + 2;
+		ff::Vector<BYTE> dilated;
+		dilated.Resize(count);
+
+		ff::DilateAlphaRow(above, row, below, dilated.Data(), count);
+
+		for (int i = 0; i < (int)count; i++)
+		{
+			bool any = false;
+			for (int x = i - 1; x <= i + 1; x++)
+			{
+				any |= above[x] || row[x] || below[x];
+			}
+
+			assertRetVal(dilated[i] == (any ? 0xFF : 0), false);
+		}
+	}
+
+	return true;
+}
+
+bool PaletteImagePerfTest()
+{
+	const size_t width = 2048;
+	const size_t height = 2048;
+	const size_t repeat = 4;
+	const double gigabyte = 1024.0 * 1024.0 * 1024.0;
+
+	ff::Vector<BYTE> remap = TestRandom(1).NextBytes(256);
+	ff::Vector<BYTE> colorBytes = TestRandom(2).NextBytes(256 * 4);
+	const DWORD* colors = reinterpret_cast<const DWORD*>(colorBytes.Data());
+
+	ff::Vector<BYTE> indexes = TestRandom(3).NextBytes(width * height);
+	ff::Vector<BYTE> mask = ::CreateRandomMask((width + 2) * height, 4);
+	ff::Vector<BYTE> scalarBytes;
+	ff::Vector<DWORD> scalarPixels;
+	ff::Vector<BYTE> bytes;
+	ff::Vector<DWORD> pixels;
+	scalarBytes.Resize(width * height);
+	scalarPixels.Resize(width * height);
+	bytes.Resize(width * height);
+	pixels.Resize(width * height);
+
+	ff::Timer timer;
+
+	// Scalar loops, like the code that was here before the kernels
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t i = 0; i < indexes.Size(); i++)
+		{
+			scalarBytes[i] = remap[indexes[i]];
+		}
+	}
+
+	double remapScalar = timer.Tick();
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t i = 0; i < indexes.Size(); i++)
+		{
+			scalarPixels[i] = colors[indexes[i]];
+		}
+	}
+
+	double colorsScalar = timer.Tick();
+
+	// Kernels
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t y = 0; y < height; y++)
+		{
+			ff::RemapPaletteRow(indexes.Data() + y * width, bytes.Data() + y * width, width, remap.Data());
+		}
+	}
+
+	double remapTime = timer.Tick();
+	assertRetVal(bytes == scalarBytes, false);
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t y = 0; y < height; y++)
+		{
+			ff::PaletteRowToColors(indexes.Data() + y * width, pixels.Data() + y * width, width, colors);
+		}
+	}
+
+	double colorsTime = timer.Tick();
+	assertRetVal(pixels == scalarPixels, false);
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t y = 0; y < height; y++)
+		{
+			ff::ColorRowToAlpha(pixels.Data() + y * width, bytes.Data() + y * width, width);
+		}
+	}
+
+	double alphaTime = timer.Tick();
+
+	for (size_t r = 0; r < repeat; r++)
+	{
+		for (size_t y = 1; y + 1 < height; y++)
+		{
+			const BYTE* row = mask.Data() + y * (width + 2) + 1;
+			ff::DilateAlphaRow(row - (width + 2), row, row + (width + 2), bytes.Data() + y * width, width);
+		}
+	}
+
+	double dilateTime = timer.Tick();
+
+	// Throughput counts the bytes that are read and written
+	const double pixelCount = (double)(width * height * repeat);
+
+	ff::String status = ff::String::format_new(
+		L"Palette kernels: remap:%.2fGB/s (scalar:%.2fGB/s), to colors:%.2fGB/s (scalar:%.2fGB/s), to alpha:%.2fGB/s, dilate:%.2fGB/s\r\n",
+		pixelCount * 2 / remapTime / gigabyte,
+		pixelCount * 2 / remapScalar / gigabyte,
+		pixelCount * 5 / colorsTime / gigabyte,
+		pixelCount * 5 / colorsScalar / gigabyte,
+		pixelCount * 5 / alphaTime / gigabyte,
+		pixelCount * 4 / dilateTime / gigabyte);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
@@ -0,0 +1,65 @@
+#include "pch.h"
+#include "Test/Unit/TestRandom.h"
+
+static ff::Vector<BYTE> CreateRandomPixels(size_t count, size_t seed)
+{
+	ff::Vector<BYTE> bytes = TestRandom(seed).NextBytes(count * 4);
+
+	// Fully transparent and fully opaque pixels are the common cases in sprites
+	for (size_t i = 0; i < count; i += 5)
+	{
+		bytes[i * 4 + 3] = (i % 2) ? 0 : 0xFF;
+	}
+
+	return bytes;
+}
+
+// Same math as the scalar code after the SIMD loop, one pixel at a time
+static void PremultiplyScalar(BYTE* pixel)
+{
+	unsigned int alpha = pixel[3];
+	for (size_t h = 0; h < 3; h++)
+	{
+		unsigned int value = pixel[h] * alpha + 128;
+		pixel[h] = (BYTE)((value + (value >> 8)) >> 8);
+	}
+}
+
+static void SwapRedBlue(ff::Vector<BYTE>& pixels)
+{
+	for (size_t i = 0; i < pixels.Size(); i += 4)
+	{
+		std::swap(pixels[i], pixels[i + 2]);
+	}
+}
+
+bool PremultiplyAlphaTest()
+{
+	// Odd sizes make sure that the scalar code after the SIMD loop is used too
+	for (size_t count : { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 63, 64, 65, 1001 })
+	{
+		ff::Vector<BYTE> source = ::CreateRandomPixels(count, count);
+		ff::Vector<BYTE> expected = source;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			::PremultiplyScalar(&expected[i * 4]);
+		}
+
+		// RGBA, starting one pixel in so that the SIMD loads aren't aligned
+		ff::Vector<BYTE> rgba;
+		rgba.Resize(4);
+		rgba.Push(source.ConstData(), source.Size());
+		ff::PremultiplyAlphaRow(rgba.Data() + 4, count);
+		assertRetVal(!std::memcmp(rgba.ConstData() + 4, expected.ConstData(), expected.Size()), false);
+
+		// BGRA gives the same colors in the other order
+		ff::Vector<BYTE> bgra = source;
+		::SwapRedBlue(bgra);
+		ff::PremultiplyAlphaRow(bgra.Data(), count);
+		::SwapRedBlue(bgra);
+		assertRetVal(bgra == expected, false);
+	}
+
+	return true;
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Anim/Transform.h"
+#include "Graph/Render/RendererVertex.h"
+#include "Graph/Sprite/Sprite.h"
+#include "Types/Timer.h"
+
+template<typename TransformType>
+static double RunSpriteGeometryPerf(const ff::SpriteGeometryBatch& batch, const TransformType* const* transforms, size_t repeat, bool vector)
+{
+	ff::Timer timer;
+
+	for (size_t i = 0; i < repeat; i++)
+	{
+		if (vector)
+		{
+			ff::FillSpriteGeometry(batch, transforms);
+		}
+		else
+		{
+			ff::FillSpriteGeometryScalar(batch, transforms);
+		}
+	}
+
+	return timer.Tick() * 1000000000.0 / (batch._count * repeat);
+}
+
+struct SpriteGeometryTestData
+{
+	SpriteGeometryTestData(size_t spriteCount)
+		: _data{}
+	{
+		_data._textureUV.SetRect(0, 0, 0.5f, 0.5f);
+		_data._worldRect.SetRect(-8, -8, 8, 8);
+
+		_outputs.Resize(spriteCount);
+		_transforms.Reserve(spriteCount);
+		_pixelTransforms.Reserve(spriteCount);
+
+		for (size_t i = 0; i < spriteCount; i++)
+		{
+			ff::PointFloat pos((float)(i * 7 % 1920) + 0.5f, (float)(i * 13 % 1080) + 0.25f);
+			_transforms.Push(ff::Transform::Create(pos, ff::PointFloat(1.5f, 2), (float)(i % 360)));
+			_pixelTransforms.Push(ff::PixelTransform::Create(_transforms.GetLast()));
+		}
+
+		for (size_t i = 0; i < spriteCount; i++)
+		{
+			_outputPointers.Push(&_outputs[i]);
+			_datas.Push(&_data);
+			_depths.Push(i / (float)spriteCount);
+			_textureIndexes.Push((unsigned int)(i % 32));
+			_transformPointers.Push(&_transforms[i]);
+			_pixelTransformPointers.Push(&_pixelTransforms[i]);
+		}
+
+		_batch = ff::SpriteGeometryBatch{ _outputPointers.Data(), _datas.Data(), _depths.ConstData(), _textureIndexes.ConstData(), 0, spriteCount };
+	}
+
+	// Both paths must produce the same records
+	template<typename TransformType>
+	bool Compare(const TransformType* const* transforms)
+	{
+		ff::Vector<ff::SpriteGeometryInput> scalarOutputs;
+		ff::FillSpriteGeometryScalar(_batch, transforms);
+		scalarOutputs = _outputs;
+		ff::FillSpriteGeometry(_batch, transforms);
+		return !std::memcmp(scalarOutputs.ConstData(), _outputs.ConstData(), _outputs.ByteSize());
+	}
+
+	ff::SpriteData _data;
+	ff::SpriteGeometryBatch _batch;
+	ff::Vector<ff::SpriteGeometryInput> _outputs;
+	ff::Vector<ff::SpriteGeometryInput*> _outputPointers;
+	ff::Vector<const ff::SpriteData*> _datas;
+	ff::Vector<float> _depths;
+	ff::Vector<unsigned int> _textureIndexes;
+	ff::Vector<ff::Transform> _transforms;
+	ff::Vector<ff::PixelTransform> _pixelTransforms;
+	ff::Vector<const ff::Transform*> _transformPointers;
+	ff::Vector<const ff::PixelTransform*> _pixelTransformPointers;
+
+private:
+	SpriteGeometryTestData(const SpriteGeometryTestData& rhs) = delete;
+	SpriteGeometryTestData& operator=(const SpriteGeometryTestData& rhs) = delete;
+};
+
+bool SpriteGeometryTest()
+{
+	// Each sprite is filled on its own, the counts just vary the depths and texture indexes (which wrap at 32)
+	for (size_t spriteCount : { 1, 3, 4, 5, 255, 256, 257 })
+	{
+		SpriteGeometryTestData test(spriteCount);
+		assertRetVal(test.Compare(test._transformPointers.ConstData()), false);
+		assertRetVal(test.Compare(test._pixelTransformPointers.ConstData()), false);
+	}
+
+	return true;
+}
+
+bool SpriteGeometryPerfTest()
+{
+	const size_t spriteCount = 256;
+	const size_t repeat = 20000;
+
+	SpriteGeometryTestData test(spriteCount);
+	const ff::SpriteGeometryBatch& batch = test._batch;
+
+	double scalarTime = ::RunSpriteGeometryPerf(batch, test._transformPointers.ConstData(), repeat, false);
+	double vectorTime = ::RunSpriteGeometryPerf(batch, test._transformPointers.ConstData(), repeat, true);
+	double scalarPixelTime = ::RunSpriteGeometryPerf(batch, test._pixelTransformPointers.ConstData(), repeat, false);
+	double vectorPixelTime = ::RunSpriteGeometryPerf(batch, test._pixelTransformPointers.ConstData(), repeat, true);
+
+	ff::String status = ff::String::format_new(
+		L"Sprite geometry per sprite: Transform scalar:%fns, vector:%fns, PixelTransform scalar:%fns, vector:%fns\r\n",
+		scalarTime,
+		vectorTime,
+		scalarPixelTime,
+		vectorPixelTime);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Sprite/SpriteOptimizer.h"
+#include "Types/Timer.h"
+
+// Like an animation sprite sheet: each sheet has a row of frames in equal sized cells and the frames
+// loop through a few shapes. Each sheet draws its shapes at a different offset within the cells.
+struct AnimationSheets
+{
+	ff::Vector<ff::Vector<DWORD>> _sheets;
+	ff::Vector<ff::SpriteImageRef> _sprites;
+	int _cellSize;
+};
+
+static int GetShapeSize(size_t frame, size_t shapeCount)
+{
+	return 4 + (int)(frame % shapeCount) * 2;
+}
+
+static void CreateAnimationSheets(AnimationSheets& sheets, size_t sheetCount, size_t frameCount, size_t shapeCount, int cellSize)
+{
+	sheets._cellSize = cellSize;
+	sheets._sheets.Resize(sheetCount);
+	sheets._sprites.Clear();
+
+	for (size_t s = 0; s < sheetCount; s++)
+	{
+		ff::Vector<DWORD>& pixels = sheets._sheets[s];
+		pixels.Resize(frameCount * cellSize * cellSize);
+		std::memset(pixels.Data(), 0, pixels.ByteSize());
+
+		const size_t rowPitch = frameCount * cellSize * sizeof(DWORD);
+		ff::PointInt offset(1 + (int)(s % 3), 1 + (int)(s % 2));
+
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			int size = ::GetShapeSize(f, shapeCount);
+			DWORD color = 0xFF000000 | (DWORD)((f % shapeCount) * 0x102030);
+
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					pixels[(offset.y + y) * frameCount * cellSize + f * cellSize + offset.x + x] = color;
+				}
+			}
+
+			ff::RectInt rect((int)f * cellSize, 0, (int)(f + 1) * cellSize, cellSize);
+			sheets._sprites.Push(ff::SpriteImageRef{ reinterpret_cast<const BYTE*>(pixels.Data()), rowPitch, rect });
+		}
+	}
+}
+
+static INT64 GetSavedBytes(const ff::Vector<ff::SpriteImageRef>& originalSprites, const ff::Vector<ff::SpriteImageRef>& sprites, const ff::Vector<size_t>& duplicateOf)
+{
+	INT64 saved = 0;
+
+	for (size_t i = 0; i < sprites.Size(); i++)
+	{
+		saved += originalSprites[i]._rect.Area() - ((duplicateOf[i] == i) ? sprites[i]._rect.Area() : 0);
+	}
+
+	return saved * sizeof(DWORD);
+}
+
+bool SpriteOptimizerTest()
+{
+	const size_t sheetCount = 4;
+	const size_t frameCount = 8;
+	const size_t shapeCount = 5;
+
+	AnimationSheets sheets;
+	::CreateAnimationSheets(sheets, sheetCount, frameCount, shapeCount, 32);
+
+	ff::Vector<ff::SpriteImageRef> sprites = sheets._sprites;
+	ff::Vector<size_t> duplicateOf;
+	duplicateOf.Resize(sprites.Size());
+
+	// Without trimming, frames only match within a sheet because the offsets differ
+
+	size_t uniqueCount = ff::FindDuplicateSprites(sprites.Data(), sprites.Size(), 4, false, duplicateOf.Data());
+	assertRetVal(uniqueCount == sheetCount * shapeCount, false);
+
+	for (size_t i = 0; i < sprites.Size(); i++)
+	{
+		size_t frame = i % frameCount;
+		size_t expect = i - frame + frame % shapeCount;
+		assertRetVal(duplicateOf[i] == expect && sprites[i]._rect == sheets._sprites[i]._rect, false);
+	}
+
+	// Trimming removes the offsets, so every sheet shares the first sheet's frames
+
+	uniqueCount = ff::FindDuplicateSprites(sprites.Data(), sprites.Size(), 4, true, duplicateOf.Data());
+	assertRetVal(uniqueCount == shapeCount, false);
+
+	for (size_t i = 0; i < sprites.Size(); i++)
+	{
+		int size = ::GetShapeSize(i % frameCount, shapeCount);
+		assertRetVal(duplicateOf[i] == (i % frameCount) % shapeCount, false);
+		assertRetVal(sprites[i]._rect.Size() == ff::PointInt(size, size), false);
+		assertRetVal(sprites[i]._rect.IsInside(sheets._sprites[i]._rect), false);
+	}
+
+	// Fully transparent sprites keep their rect and match each other
+
+	ff::SpriteImageRef emptySprites[2] = { sheets._sprites[0], sheets._sprites[1] };
+	emptySprites[0]._rect = ff::RectInt(20, 20, 30, 30);
+	emptySprites[1]._rect = ff::RectInt(50, 20, 60, 30);
+	size_t emptyDuplicateOf[2];
+
+	assertRetVal(ff::FindDuplicateSprites(emptySprites, 2, 4, true, emptyDuplicateOf) == 1, false);
+	assertRetVal(emptyDuplicateOf[1] == 0 && emptySprites[1]._rect == ff::RectInt(50, 20, 60, 30), false);
+
+	return true;
+}
+
+bool SpriteOptimizerPerfTest()
+{
+	const size_t sheetCount = 32;
+	const size_t frameCount = 48;
+	const size_t shapeCount = 12;
+
+	AnimationSheets sheets;
+	::CreateAnimationSheets(sheets, sheetCount, frameCount, shapeCount, 64);
+
+	ff::Vector<ff::SpriteImageRef> sprites = sheets._sprites;
+	ff::Vector<size_t> duplicateOf;
+	duplicateOf.Resize(sprites.Size());
+
+	ff::Timer timer;
+	size_t uniqueCount = ff::FindDuplicateSprites(sprites.Data(), sprites.Size(), 4, false, duplicateOf.Data());
+	double findTime = timer.Tick();
+	INT64 savedBytes = ::GetSavedBytes(sheets._sprites, sprites, duplicateOf);
+
+	timer.Tick();
+	size_t trimUniqueCount = ff::FindDuplicateSprites(sprites.Data(), sprites.Size(), 4, true, duplicateOf.Data());
+	double trimTime = timer.Tick();
+	INT64 trimSavedBytes = ::GetSavedBytes(sheets._sprites, sprites, duplicateOf);
+
+	ff::String status = ff::String::format_new(
+		L"Sprite duplicates: %lu frames, %.1fKB. Shared: %lu unique, %.1fKB saved, %.1fms. Trimmed: %lu unique, %.1fKB saved, %.1fms\r\n",
+		sprites.Size(),
+		sprites.Size() * 64 * 64 * sizeof(DWORD) / 1024.0,
+		uniqueCount,
+		savedBytes / 1024.0,
+		findTime * 1000.0,
+		trimUniqueCount,
+		trimSavedBytes / 1024.0,
+		trimTime * 1000.0);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
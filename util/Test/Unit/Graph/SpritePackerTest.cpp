@@ -0,0 +1,142 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Sprite/SpritePacker.h"
+#include "Test/Unit/TestRandom.h"
+#include "Types/Timer.h"
+
+// Random sprite sizes, mostly small with some large ones like a real game
+static ff::Vector<ff::PointInt> CreateSpriteSizes(size_t count, int minSize, int maxSize)
+{
+	ff::Vector<ff::PointInt> sizes;
+	sizes.Reserve(count);
+
+	TestRandom random(1);
+	for (size_t i = 0; i < count; i++)
+	{
+		int x = minSize + (int)random.Next(maxSize - minSize + 1);
+		int y = minSize + (int)random.Next(maxSize - minSize + 1);
+
+		sizes.Push(ff::PointInt(x, y));
+	}
+
+	return sizes;
+}
+
+static bool ValidatePackResult(const ff::Vector<ff::PointInt>& sizes, const ff::SpritePackOptions& options, const ff::SpritePackResult& result)
+{
+	assertRetVal(result._spriteTextures.Size() == sizes.Size() && result._spritePositions.Size() == sizes.Size(), false);
+
+	ff::Vector<ff::Vector<ff::RectInt>> textureRects;
+	textureRects.Resize(result._textureSizes.Size());
+
+	for (size_t i = 0; i < sizes.Size(); i++)
+	{
+		size_t texture = result._spriteTextures[i];
+		assertRetVal(texture < result._textureSizes.Size(), false);
+
+		ff::PointInt pos = result._spritePositions[i];
+		ff::RectInt rect(pos, pos + sizes[i]);
+		assertRetVal(rect.IsInside(ff::RectInt(result._textureSizes[texture])), false);
+		assertRetVal(pos.x % options._alignment == 0 && pos.y % options._alignment == 0, false);
+
+		// Padding must separate every pair of sprites
+		ff::RectInt paddedRect(rect.left, rect.top, rect.right + options._padding, rect.bottom + options._padding);
+		for (const ff::RectInt& otherRect : textureRects[texture])
+		{
+			assertRetVal(!paddedRect.DoesIntersect(otherRect), false);
+		}
+
+		textureRects[texture].Push(paddedRect);
+	}
+
+	return true;
+}
+
+bool SpritePackerTest()
+{
+	ff::SpritePackOptions options;
+	ff::SpritePackResult result;
+
+	// Simple packing
+
+	ff::Vector<ff::PointInt> sizes = ::CreateSpriteSizes(500, 1, 64);
+	assertRetVal(ff::PackSprites(sizes.Data(), sizes.Size(), options, result), false);
+	assertRetVal(::ValidatePackResult(sizes, options, result), false);
+
+	// Block compression alignment and extra padding
+
+	options._alignment = 4;
+	options._padding = 2;
+	assertRetVal(ff::PackSprites(sizes.Data(), sizes.Size(), options, result), false);
+	assertRetVal(::ValidatePackResult(sizes, options, result), false);
+
+	// A single small sprite uses the smallest texture
+
+	options = ff::SpritePackOptions();
+	ff::PointInt smallSize(10, 10);
+	assertRetVal(ff::PackSprites(&smallSize, 1, options, result), false);
+	assertRetVal(result._textureSizes.Size() == 1 && result._textureSizes[0] == options._minTextureSize, false);
+
+	// Oversized sprites get their own texture
+
+	ff::PointInt bigSizes[] = { ff::PointInt(2000, 100), ff::PointInt(16, 16) };
+	assertRetVal(ff::PackSprites(bigSizes, _countof(bigSizes), options, result), false);
+	assertRetVal(result._textureSizes.Size() == 2, false);
+	assertRetVal(result._textureSizes[result._spriteTextures[0]] == ff::PointInt(2048, 128), false);
+	assertRetVal(result._spriteTextures[0] != result._spriteTextures[1], false);
+
+	// Sprites at the max texture size only overflow after alignment, they still get packed or their own texture
+
+	options._alignment = 4;
+	options._padding = 2;
+	sizes.Clear();
+	sizes.Push(ff::PointInt(1024, 1024));
+	sizes.Push(ff::PointInt(1023, 1023));
+	sizes.Push(ff::PointInt(1022, 40));
+	sizes.Push(ff::PointInt(30, 30));
+	assertRetVal(ff::PackSprites(sizes.Data(), sizes.Size(), options, result), false);
+	assertRetVal(::ValidatePackResult(sizes, options, result), false);
+	assertRetVal(result._textureSizes[result._spriteTextures[0]] == options._maxTextureSize, false);
+	assertRetVal(result._textureSizes[result._spriteTextures[1]] == options._maxTextureSize, false);
+	assertRetVal(result._spriteTextures[0] != result._spriteTextures[1], false);
+
+	return true;
+}
+
+bool SpritePackerPerfTest()
+{
+	const size_t spriteCount = 10000;
+
+	ff::Vector<ff::PointInt> sizes = ::CreateSpriteSizes(spriteCount, 8, 96);
+	ff::SpritePackOptions options;
+	ff::SpritePackResult result;
+
+	ff::Timer timer;
+	assertRetVal(ff::PackSprites(sizes.Data(), sizes.Size(), options, result), false);
+	double packTime = timer.Tick();
+	assertRetVal(::ValidatePackResult(sizes, options, result), false);
+
+	INT64 spriteArea = 0;
+	INT64 textureArea = 0;
+
+	for (ff::PointInt size : sizes)
+	{
+		spriteArea += size.x * size.y;
+	}
+
+	for (ff::PointInt size : result._textureSizes)
+	{
+		textureArea += (INT64)size.x * size.y;
+	}
+
+	ff::String status = ff::String::format_new(
+		L"Sprite packer: %lu sprites, %lu textures, %.1f%% used, %.1fms\r\n",
+		spriteCount,
+		result._textureSizes.Size(),
+		spriteArea * 100.0 / textureArea,
+		packTime * 1000.0);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return true;
+}
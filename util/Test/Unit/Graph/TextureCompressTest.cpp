@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "Graph/Texture/TextureCompress.h"
+#include "Test/Unit/TestRandom.h"
+
+// Smooth gradients with some noise, so the encoders have real choices to make
+static ff::Vector<BYTE> CreateTestPixels(size_t width, size_t height, size_t seed)
+{
+	TestRandom random(seed);
+	ff::Vector<BYTE> pixels;
+	pixels.Resize(width * height * 4);
+
+	for (size_t y = 0, i = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++, i += 4)
+		{
+			size_t value = random.Next();
+			BYTE noise = (BYTE)(value & 0x1F);
+
+			pixels[i + 0] = (BYTE)(x * 255 / width) ^ noise;
+			pixels[i + 1] = (BYTE)(y * 255 / height) ^ noise;
+			pixels[i + 2] = (BYTE)((x + y) * 4);
+			pixels[i + 3] = (BYTE)(((x / 8 + y / 8) % 2) ? 255 : (value >> 8));
+		}
+	}
+
+	return pixels;
+}
+
+bool TextureCompressTest()
+{
+	struct TestCase
+	{
+		size_t _width;
+		size_t _height;
+		size_t _mips;
+		DXGI_FORMAT _format;
+		ff::TextureCompression _compression;
+	};
+
+	// Heights that aren't a multiple of the strip height, and full mip chains that end with 4x4 and smaller images
+	const TestCase testCases[] =
+	{
+		{ 256, 200, 1, DXGI_FORMAT_BC1_UNORM, ff::TextureCompression::Default },
+		{ 128, 100, 0, DXGI_FORMAT_BC3_UNORM, ff::TextureCompression::Default },
+		{ 64, 132, 0, DXGI_FORMAT_BC2_UNORM, ff::TextureCompression::Default },
+		{ 96, 68, 0, DXGI_FORMAT_BC7_UNORM, ff::TextureCompression::Fast },
+		{ 4, 4, 0, DXGI_FORMAT_BC3_UNORM, ff::TextureCompression::Default },
+	};
+
+	for (size_t i = 0; i < _countof(testCases); i++)
+	{
+		const TestCase& test = testCases[i];
+		ff::Vector<BYTE> pixels = ::CreateTestPixels(test._width, test._height, i + 1);
+		assertRetVal(ff::VerifyTextureCompressionStrips(pixels.ConstData(), test._width, test._height, test._mips, test._format, test._compression), false);
+	}
+
+	return true;
+}
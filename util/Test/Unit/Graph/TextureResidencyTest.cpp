@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "Graph/Texture/TextureResidency.h"
+
+// Stands in for a real texture, so that residency can be tested without a graphics device
+class FakeTexture : public ff::ITextureResident
+{
+public:
+	FakeTexture(size_t cpuBytes, size_t gpuBytes, bool canReload)
+		: _cpuBytes(cpuBytes)
+		, _gpuBytes(gpuBytes)
+		, _fullCpuBytes(cpuBytes)
+		, _fullGpuBytes(gpuBytes)
+		, _canReload(canReload)
+		, _reloadCount(0)
+	{
+	}
+
+	virtual size_t GetResidentCpuBytes() const override
+	{
+		return _cpuBytes;
+	}
+
+	virtual size_t GetResidentGpuBytes() const override
+	{
+		return _gpuBytes;
+	}
+
+	virtual bool DropCpuCopy() override
+	{
+		noAssertRetVal(_canReload && _cpuBytes, false);
+		_cpuBytes = 0;
+		return true;
+	}
+
+	virtual bool Evict() override
+	{
+		noAssertRetVal(_canReload && (_cpuBytes || _gpuBytes), false);
+		_cpuBytes = 0;
+		_gpuBytes = 0;
+		return true;
+	}
+
+	virtual bool Reload() override
+	{
+		::Sleep(1);
+		_gpuBytes = _fullGpuBytes;
+		_reloadCount++;
+		return true;
+	}
+
+	bool IsEvicted() const
+	{
+		return !_gpuBytes;
+	}
+
+	size_t _cpuBytes;
+	size_t _gpuBytes;
+	size_t _fullCpuBytes;
+	size_t _fullGpuBytes;
+	bool _canReload;
+	std::atomic<size_t> _reloadCount;
+};
+
+static void RenderFrame(ff::TextureResidency& residency, FakeTexture* const* textures, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		residency.Touch(textures[i]);
+	}
+
+	residency.AdvanceFrame();
+}
+
+bool TextureResidencyTest()
+{
+	ff::TextureResidency residency;
+	FakeTexture texture0(100, 100, true);
+	FakeTexture texture1(100, 100, true);
+	FakeTexture texture2(100, 100, true);
+	FakeTexture fixedTexture(100, 100, false);
+	FakeTexture* all[] = { &texture0, &texture1, &texture2, &fixedTexture };
+
+	for (FakeTexture* texture : all)
+	{
+		residency.Add(texture);
+	}
+
+	// Without a budget, nothing is freed
+
+	::RenderFrame(residency, all, _countof(all));
+	ff::TextureResidencyStats stats = residency.GetStats();
+	assertRetVal(stats._textureCount == 4 && stats._cpuBytes == 400 && stats._gpuBytes == 400 && !stats._totalEvictions, false);
+
+	// CPU copies are dropped first, and that's enough to fit the budget
+
+	residency.SetBudget(500);
+	::RenderFrame(residency, all, _countof(all));
+	stats = residency.GetStats();
+	assertRetVal(stats._cpuBytes == 100 && stats._gpuBytes == 400 && !stats._evictedCount, false);
+	assertRetVal(!texture0._cpuBytes && !texture1._cpuBytes && !texture2._cpuBytes && fixedTexture._cpuBytes, false);
+
+	// Textures rendered in the current frame are never evicted, even over budget
+
+	residency.SetBudget(250);
+	::RenderFrame(residency, all, _countof(all));
+	assertRetVal(!residency.GetStats()._evictedCount, false);
+
+	// The least recently rendered textures are evicted first
+
+	FakeTexture* recent[] = { &texture2, &texture1, &fixedTexture };
+	::RenderFrame(residency, recent, _countof(recent));
+	assertRetVal(texture0.IsEvicted() && residency.GetStats()._evictedCount == 1, false);
+
+	::RenderFrame(residency, recent + 1, 2);
+	stats = residency.GetStats();
+	assertRetVal(stats._evictedCount == 2 && stats._totalEvictions == 2 && stats._cpuBytes + stats._gpuBytes == 300, false);
+	assertRetVal(texture0.IsEvicted() && !texture1.IsEvicted() && texture2.IsEvicted() && !fixedTexture.IsEvicted(), false);
+
+	// Rendering an evicted texture reloads it right away
+
+	residency.SetBudget(0);
+	residency.Touch(&texture0);
+	assertRetVal(!texture0.IsEvicted() && texture0._reloadCount == 1, false);
+
+	// Prefetch reloads on the thread pool, and rendering waits for that to finish
+
+	residency.Prefetch(&texture2);
+	residency.Prefetch(&texture2);
+	residency.Touch(&texture2);
+	assertRetVal(!texture2.IsEvicted() && texture2._reloadCount == 1, false);
+
+	stats = residency.GetStats();
+	assertRetVal(!stats._evictedCount && !stats._reloadingCount && stats._totalReloads == 2, false);
+
+	// Evicted textures are prefetched once they fit in the budget, most recently rendered first
+
+	FakeTexture* kept[] = { &texture0, &fixedTexture };
+	::RenderFrame(residency, kept, _countof(kept));
+
+	residency.SetBudget(250);
+	::RenderFrame(residency, kept, _countof(kept));
+	assertRetVal(!texture0.IsEvicted() && texture1.IsEvicted() && texture2.IsEvicted(), false);
+
+	residency.SetBudget(400);
+	::RenderFrame(residency, kept, _countof(kept));
+	residency.Touch(&texture2);
+	assertRetVal(texture1.IsEvicted() && !texture2.IsEvicted() && texture2._reloadCount == 2, false);
+	assertRetVal(residency.GetStats()._evictedCount == 1, false);
+
+	for (FakeTexture* texture : all)
+	{
+		residency.Remove(texture);
+	}
+
+	assertRetVal(!residency.GetStats()._textureCount, false);
+
+	return true;
+}
@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Graph/Texture/TextureUpdateBatch.h"
+#include "Types/Timer.h"
+
+// Stands in for a texture on a graphics device, with a CPU copy and a "GPU" copy of each subresource
+class StubUpdateTarget : public ff::ITextureUpdateTarget
+{
+public:
+	StubUpdateTarget(size_t width, size_t height, size_t subresourceCount)
+		: _width(width)
+		, _height(height)
+		, _uploadCount(0)
+		, _uploadBytes(0)
+	{
+		_cpu.Resize(subresourceCount);
+		_gpu.Resize(subresourceCount);
+
+		for (size_t i = 0; i < subresourceCount; i++)
+		{
+			_cpu[i].Resize(width * height);
+			_gpu[i].Resize(width * height);
+			std::memset(_cpu[i].Data(), 0, _cpu[i].ByteSize());
+			std::memset(_gpu[i].Data(), 0, _gpu[i].ByteSize());
+		}
+	}
+
+	virtual bool GetUpdateImage(size_t subresource, ff::TextureUpdateImage& image) override
+	{
+		assertRetVal(subresource < _cpu.Size(), false);
+
+		image._pixels = reinterpret_cast<BYTE*>(_cpu[subresource].Data());
+		image._rowPitch = _width * sizeof(DWORD);
+		image._size = ff::PointSize(_width, _height);
+
+		return true;
+	}
+
+	virtual void UploadRect(size_t subresource, const ff::RectSize& rect, const BYTE* data, size_t rowPitch) override
+	{
+		for (size_t y = rect.top; y < rect.bottom; y++, data += rowPitch)
+		{
+			std::memcpy(&_gpu[subresource][y * _width + rect.left], data, rect.Width() * sizeof(DWORD));
+		}
+
+		_uploadCount++;
+		_uploadBytes += rect.Area() * sizeof(DWORD);
+	}
+
+	bool IsGpuCurrent() const
+	{
+		for (size_t i = 0; i < _cpu.Size(); i++)
+		{
+			noAssertRetVal(!std::memcmp(_cpu[i].Data(), _gpu[i].Data(), _cpu[i].ByteSize()), false);
+		}
+
+		return true;
+	}
+
+	void ResetCounts()
+	{
+		_uploadCount = 0;
+		_uploadBytes = 0;
+	}
+
+	size_t _width;
+	size_t _height;
+	size_t _uploadCount;
+	size_t _uploadBytes;
+	ff::Vector<ff::Vector<DWORD>> _cpu;
+	ff::Vector<ff::Vector<DWORD>> _gpu;
+};
+
+static void UpdateRect(ff::TextureUpdateBatch& batch, StubUpdateTarget& target, size_t subresource, const ff::RectSize& rect, DWORD color)
+{
+	ff::Vector<DWORD> pixels;
+	pixels.Resize(rect.Area());
+
+	for (size_t i = 0; i < pixels.Size(); i++)
+	{
+		pixels[i] = color + (DWORD)i;
+	}
+
+	batch.Update(target, subresource, rect, pixels.Data(), rect.Width() * sizeof(DWORD));
+}
+
+bool TextureUpdateBatchTest()
+{
+	StubUpdateTarget target(64, 64, 2);
+	ff::TextureUpdateBatch batch(sizeof(DWORD));
+
+	// Rects side by side, or inside each other, are uploaded once. The CPU copy is updated right away.
+
+	::UpdateRect(batch, target, 0, ff::RectSize(0, 0, 8, 8), 0x100);
+	::UpdateRect(batch, target, 0, ff::RectSize(8, 0, 16, 8), 0x200);
+	::UpdateRect(batch, target, 0, ff::RectSize(6, 2, 10, 6), 0x300);
+	assertRetVal(target._cpu[0][2 * 64 + 6] == 0x300 && !target._gpu[0][2 * 64 + 6] && batch.HasUpdates(), false);
+
+	ff::TextureUpdateStats stats = batch.Flush(target);
+	assertRetVal(!batch.HasUpdates() && target.IsGpuCurrent(), false);
+	assertRetVal(stats._updateCount == 3 && stats._uploadCount == 1 && target._uploadCount == 1, false);
+	assertRetVal(stats._updateBytes == (64 + 64 + 16) * 4 && stats._uploadBytes == 128 * 4 && target._uploadBytes == 128 * 4, false);
+
+	// Overlapping rects that don't fill their bound are uploaded separately, pixels between them stay as they are on the GPU
+
+	target.ResetCounts();
+	target._gpu[0][16 * 64 + 25] = 0xABCD;
+	::UpdateRect(batch, target, 0, ff::RectSize(16, 16, 24, 24), 0x380);
+	::UpdateRect(batch, target, 0, ff::RectSize(18, 18, 26, 26), 0x3C0);
+	stats = batch.Flush(target);
+	assertRetVal(stats._uploadCount == 2 && target._gpu[0][16 * 64 + 25] == 0xABCD, false);
+
+	target._gpu[0][16 * 64 + 25] = 0;
+	assertRetVal(target.IsGpuCurrent(), false);
+
+	// Rects that are far apart, or in different subresources, are uploaded separately
+
+	target.ResetCounts();
+	::UpdateRect(batch, target, 0, ff::RectSize(0, 0, 4, 4), 0x400);
+	::UpdateRect(batch, target, 0, ff::RectSize(40, 40, 44, 44), 0x500);
+	::UpdateRect(batch, target, 1, ff::RectSize(0, 0, 4, 4), 0x600);
+	stats = batch.Flush(target);
+	assertRetVal(target.IsGpuCurrent() && stats._uploadCount == 3 && target._uploadBytes == 3 * 16 * 4, false);
+
+	// Big rects and lots of flushes in a row
+
+	target.ResetCounts();
+	::UpdateRect(batch, target, 1, ff::RectSize(0, 0, 64, 32), 0x700);
+	stats = batch.Flush(target);
+	assertRetVal(target.IsGpuCurrent() && stats._uploadBytes == 64 * 32 * 4, false);
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		::UpdateRect(batch, target, 0, ff::RectSize(0, i * 8, 16, i * 8 + 8), 0x800 + (DWORD)i);
+		assertRetVal(batch.Flush(target)._uploadCount == 1 && target.IsGpuCurrent(), false);
+	}
+
+	// Nothing is uploaded after the texture was recreated from the CPU copy
+
+	target.ResetCounts();
+	::UpdateRect(batch, target, 0, ff::RectSize(0, 0, 4, 4), 0x900);
+	batch.Clear();
+	stats = batch.Flush(target);
+	assertRetVal(!stats._updateCount && !stats._uploadCount && !target._uploadCount, false);
+
+	return true;
+}
+
+bool TextureUpdateBatchPerfTest()
+{
+	// Like a glyph cache: lots of small rects each frame, many of them next to each other
+	const size_t frameCount = 60;
+	const size_t glyphsPerFrame = 200;
+
+	StubUpdateTarget target(1024, 1024, 1);
+	ff::TextureUpdateBatch batch(sizeof(DWORD));
+	ff::Vector<DWORD> glyph;
+	glyph.Resize(16 * 16);
+	std::memset(glyph.Data(), 0xFF, glyph.ByteSize());
+
+	size_t updateBytes = 0;
+	size_t uploadCount = 0;
+	ff::Timer timer;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < glyphsPerFrame; i++)
+		{
+			size_t cell = (frame * glyphsPerFrame + i) % (64 * 64);
+			ff::RectSize rect(cell % 64 * 16, cell / 64 * 16, cell % 64 * 16 + 16, cell / 64 * 16 + 16);
+			batch.Update(target, 0, rect, glyph.Data(), 16 * sizeof(DWORD));
+		}
+
+		ff::TextureUpdateStats stats = batch.Flush(target);
+		updateBytes += stats._updateBytes;
+		uploadCount += stats._uploadCount;
+	}
+
+	double time = timer.Tick();
+
+	ff::String status = ff::String::format_new(
+		L"Texture updates: %lu frames, %lu rects, %.1fKB/frame updated, %.1fKB/frame uploaded, %.1f uploads/frame, no readback. %.2fms/frame\r\n",
+		frameCount,
+		frameCount * glyphsPerFrame,
+		updateBytes / 1024.0 / frameCount,
+		target._uploadBytes / 1024.0 / frameCount,
+		(double)uploadCount / frameCount,
+		time * 1000.0 / frameCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return target.IsGpuCurrent();
+}
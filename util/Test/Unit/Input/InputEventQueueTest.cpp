@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Input/InputEventQueue.h"
+#include "Thread/ThreadPool.h"
+#include "Types/Timer.h"
+
+struct TestInputEvent
+{
+	size_t _sequence;
+	int _x;
+	int _y;
+};
+
+static bool TestOrder()
+{
+	ff::InputEventQueue<TestInputEvent> queue(16);
+	assertRetVal(queue.Drain([](const TestInputEvent&, INT64) {}) == 0, false);
+
+	for (size_t i = 0; i < 10; i++)
+	{
+		assertRetVal(queue.Push(TestInputEvent{ i, (int)i, -(int)i }, 1000 + i), false);
+	}
+
+	size_t next = 0;
+	bool valid = true;
+	size_t drained = queue.Drain([&next, &valid](const TestInputEvent& event, INT64 time)
+		{
+			valid &= (event._sequence == next && event._y == -(int)next && time == 1000 + next);
+			next++;
+		});
+
+	assertRetVal(valid && drained == 10 && next == 10, false);
+	assertRetVal(queue.Drain([](const TestInputEvent&, INT64) {}) == 0, false);
+
+	return true;
+}
+
+static bool TestOverflow()
+{
+	ff::InputEventQueue<TestInputEvent> queue(16);
+
+	// New events get dropped once the consumer falls behind
+	for (size_t i = 0; i < 20; i++)
+	{
+		queue.Push(TestInputEvent{ i }, 0);
+	}
+
+	assertRetVal(queue.GetOverflowCount() == 4, false);
+
+	size_t last = 0;
+	assertRetVal(queue.Drain([&last](const TestInputEvent& event, INT64) { last = event._sequence; }) == 16 && last == 15, false);
+	assertRetVal(queue.Push(TestInputEvent{ 20 }, 0), false);
+
+	ff::InputEventQueueStats stats = queue.GetStats();
+	assertRetVal(stats._pushed == 17 && stats._drained == 16 && stats._overflows == 4 && stats._maxDrain == 16, false);
+
+	return true;
+}
+
+static bool TestBulkDrain()
+{
+	ff::InputEventQueue<TestInputEvent> queue(1024);
+	size_t next = 0;
+	bool valid = true;
+
+	// Wraps around the ring a few times with drains that don't line up with the batch size
+	for (size_t round = 0, pushed = 0; round < 20; round++)
+	{
+		for (size_t i = 0; i < 300 + round * 13; i++, pushed++)
+		{
+			assertRetVal(queue.Push(TestInputEvent{ pushed }, (INT64)pushed), false);
+		}
+
+		queue.Drain([&next, &valid](const TestInputEvent& event, INT64 time)
+			{
+				valid &= (event._sequence == next && time == (INT64)next);
+				next++;
+			});
+	}
+
+	ff::InputEventQueueStats stats = queue.GetStats();
+	assertRetVal(valid && stats._drained == next && stats._pushed == next && !stats._overflows, false);
+
+	return true;
+}
+
+bool InputEventQueueTest()
+{
+	return ::TestOrder() && ::TestOverflow() && ::TestBulkDrain();
+}
+
+bool InputEventQueuePerfTest()
+{
+	// A high polling rate mouse on the window thread, and a 60hz game thread draining it
+	const size_t eventsPerMs = 10;
+	const size_t testMs = 2000;
+	const size_t frameMs = 16;
+
+	ff::InputEventQueue<TestInputEvent> queue(1024);
+	ff::Mutex mutex;
+	bool done = false;
+
+	ff::GetThreadPool()->AddThread([&queue, &mutex, &done]()
+		{
+			for (size_t ms = 0, sequence = 0; ms < testMs; ms++)
+			{
+				for (size_t i = 0; i < eventsPerMs; i++, sequence++)
+				{
+					queue.Push(TestInputEvent{ sequence, (int)sequence, (int)ms }, ff::Timer::GetCurrentRawTime());
+				}
+
+				::Sleep(1);
+			}
+
+			ff::LockMutex lock(mutex);
+			done = true;
+		});
+
+	size_t frames = 0;
+	size_t next = 0;
+	bool valid = true;
+	double maxDrainTime = 0;
+	double maxLatency = 0;
+	double rawFrequency = (double)ff::Timer::GetRawFreqStatic();
+
+	for (bool lastFrame = false; !lastFrame; frames++)
+	{
+		{
+			ff::LockMutex lock(mutex);
+			lastFrame = done;
+		}
+
+		::Sleep((DWORD)frameMs);
+
+		INT64 drainStart = ff::Timer::GetCurrentRawTime();
+		queue.Drain([&next, &valid, &maxLatency, drainStart, rawFrequency](const TestInputEvent& event, INT64 time)
+			{
+				valid &= (event._sequence == next);
+				maxLatency = std::max(maxLatency, (drainStart - time) / rawFrequency);
+				next = event._sequence + 1;
+			});
+
+		maxDrainTime = std::max(maxDrainTime, (ff::Timer::GetCurrentRawTime() - drainStart) / rawFrequency);
+	}
+
+	ff::InputEventQueueStats stats = queue.GetStats();
+	ff::String status = ff::String::format_new(
+		L"Input event queue: %lu events over %lu frames, %lu dropped\r\n"
+		L"  Most events in one frame: %lu, worst drain: %.3fms, worst latency: %.2fms\r\n",
+		stats._pushed,
+		frames,
+		stats._overflows,
+		stats._maxDrain,
+		maxDrainTime * 1000.0,
+		maxLatency * 1000.0);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return valid && !stats._overflows && stats._drained == eventsPerMs * testMs;
+}
@@ -0,0 +1,440 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Input/InputMappingTable.h"
+#include "Input/Joystick/JoystickDevice.h"
+#include "Types/Timer.h"
+
+// Gamepad with a made up state for each frame
+class TestJoystick : public ff::IJoystickDevice
+{
+public:
+	TestJoystick(size_t seed)
+		: _refs(0)
+		, _seed(seed)
+		, _frame(0)
+	{
+	}
+
+	void SetFrame(size_t frame)
+	{
+		_frame = frame;
+	}
+
+	// IUnknown
+	virtual HRESULT __stdcall QueryInterface(REFIID iid, void** obj) override
+	{
+		return E_NOINTERFACE;
+	}
+
+	virtual ULONG __stdcall AddRef() override
+	{
+		return ++_refs;
+	}
+
+	virtual ULONG __stdcall Release() override
+	{
+		ULONG refs = --_refs;
+		if (!refs)
+		{
+			delete this;
+		}
+
+		return refs;
+	}
+
+	// IInputDevice
+	virtual void Advance() override
+	{
+	}
+
+	virtual void KillPending() override
+	{
+	}
+
+	virtual bool IsConnected() const override
+	{
+		return _seed != 3 || _frame % 100 > 10;
+	}
+
+	// IJoystickDevice
+	virtual size_t GetStickCount() const override
+	{
+		return 2;
+	}
+
+	virtual ff::PointFloat GetStickPos(size_t nStick, bool bDigital) const override
+	{
+		ff::PointFloat pos(Wave(nStick * 2), Wave(nStick * 2 + 1));
+		return bDigital ? ff::PointFloat(std::round(pos.x), std::round(pos.y)) : pos;
+	}
+
+	virtual ff::RectInt GetStickPressCount(size_t nStick) const override
+	{
+		return ff::RectInt(Press(nStick * 4), Press(nStick * 4 + 1), Press(nStick * 4 + 2), Press(nStick * 4 + 3));
+	}
+
+	virtual ff::String GetStickName(size_t nStick) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetDPadCount() const override
+	{
+		return 1;
+	}
+
+	virtual ff::PointInt GetDPadPos(size_t nDPad) const override
+	{
+		return ff::PointInt((int)std::round(Wave(5)), (int)std::round(Wave(6)));
+	}
+
+	virtual ff::RectInt GetDPadPressCount(size_t nDPad) const override
+	{
+		return ff::RectInt(Press(8), Press(9), Press(10), Press(11));
+	}
+
+	virtual ff::String GetDPadName(size_t nDPad) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetButtonCount() const override
+	{
+		return 10;
+	}
+
+	virtual bool GetButton(size_t nButton) const override
+	{
+		return ((_frame + _seed * 7) / (nButton + 2)) % 3 == 0;
+	}
+
+	virtual int GetButtonPressCount(size_t nButton) const override
+	{
+		return Press(12 + nButton);
+	}
+
+	virtual ff::String GetButtonName(size_t nButton) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetTriggerCount() const override
+	{
+		return 2;
+	}
+
+	virtual float GetTrigger(size_t nTrigger, bool bDigital) const override
+	{
+		float value = std::fabs(Wave(7 + nTrigger));
+		return bDigital ? std::round(value) : value;
+	}
+
+	virtual int GetTriggerPressCount(size_t nTrigger) const override
+	{
+		return Press(22 + nTrigger);
+	}
+
+	virtual ff::String GetTriggerName(size_t nTrigger) const override
+	{
+		return ff::String();
+	}
+
+	virtual bool HasKeyButton(int vk) const override
+	{
+		return false;
+	}
+
+	virtual bool GetKeyButton(int vk) const override
+	{
+		return false;
+	}
+
+	virtual int GetKeyButtonPressCount(int vk) const override
+	{
+		return 0;
+	}
+
+	virtual ff::String GetKeyButtonName(int vk) const override
+	{
+		return ff::String();
+	}
+
+private:
+	float Wave(size_t axis) const
+	{
+		return (float)std::sin((_frame + _seed * 13) * (0.05 + axis * 0.01));
+	}
+
+	int Press(size_t part) const
+	{
+		return ((_frame + _seed + part) % 17) == 0 ? 1 : 0;
+	}
+
+	ULONG _refs;
+	size_t _seed;
+	size_t _frame;
+};
+
+static ff::InputAction CreateAction(ff::InputPart part, ff::InputPartValue partValue, size_t index)
+{
+	ff::InputAction action;
+	action._device = ff::INPUT_DEVICE_JOYSTICK;
+	action._part = part;
+	action._partValue = partValue;
+	action._partIndex = (BYTE)index;
+
+	return action;
+}
+
+// Actions on a gamepad, in the order that a game's input file would probably list them
+static ff::Vector<ff::InputAction> CreateActions(size_t count)
+{
+	const ff::InputPartValue dirs[] = { ff::INPUT_VALUE_LEFT, ff::INPUT_VALUE_RIGHT, ff::INPUT_VALUE_UP, ff::INPUT_VALUE_DOWN };
+	ff::Vector<ff::InputAction> actions;
+
+	for (size_t i = 0; actions.Size() < count; i++)
+	{
+		switch (i % 5)
+		{
+		case 0: actions.Push(::CreateAction(ff::INPUT_PART_BUTTON, ff::INPUT_VALUE_DEFAULT, (i / 5) % 11 == 10 ? 0xFF : (i / 5) % 11)); break;
+		case 1: actions.Push(::CreateAction(ff::INPUT_PART_STICK, dirs[(i / 5) % 4], (i / 20) % 2)); break;
+		case 2: actions.Push(::CreateAction(ff::INPUT_PART_DPAD, dirs[(i / 5) % 4], 0)); break;
+		case 3: actions.Push(::CreateAction(ff::INPUT_PART_TRIGGER, ff::INPUT_VALUE_DEFAULT, (i / 5) % 2)); break;
+		case 4: actions.Push(::CreateAction(ff::INPUT_PART_STICK, (i / 5) % 2 ? ff::INPUT_VALUE_X_AXIS : ff::INPUT_VALUE_Y_AXIS, (i / 5) % 2)); break;
+		}
+	}
+
+	return actions;
+}
+
+static float GetLargest(float value, float newValue)
+{
+	return std::fabs(newValue) > std::fabs(value) ? newValue : value;
+}
+
+// How mappings used to be evaluated, by asking every joystick about every action
+static bool GetDirectValue(const ff::InputDevices& devices, const ff::InputAction& action, int& presses)
+{
+	ff::PointFloat pos(0, 0);
+	presses = 0;
+
+	for (ff::IJoystickDevice* joy : devices._joys)
+	{
+		if (!joy->IsConnected())
+		{
+			continue;
+		}
+
+		ff::RectInt dirs(0, 0, 0, 0);
+
+		switch (action._part)
+		{
+		case ff::INPUT_PART_BUTTON:
+			for (size_t h = 0; h < joy->GetButtonCount(); h++)
+			{
+				if (action._partIndex == 0xFF || action._partIndex == h)
+				{
+					presses += joy->GetButtonPressCount(h);
+					pos.x = joy->GetButton(h) ? 1.0f : pos.x;
+				}
+			}
+			break;
+
+		case ff::INPUT_PART_TRIGGER:
+			presses += joy->GetTriggerPressCount(action._partIndex);
+			pos.x = ::GetLargest(pos.x, joy->GetTrigger(action._partIndex, true));
+			break;
+
+		case ff::INPUT_PART_STICK:
+			dirs = joy->GetStickPressCount(action._partIndex);
+			pos.x = ::GetLargest(pos.x, joy->GetStickPos(action._partIndex, true).x);
+			pos.y = ::GetLargest(pos.y, joy->GetStickPos(action._partIndex, true).y);
+			break;
+
+		case ff::INPUT_PART_DPAD:
+			dirs = joy->GetDPadPressCount(action._partIndex);
+			pos.x = ::GetLargest(pos.x, (float)joy->GetDPadPos(action._partIndex).x);
+			pos.y = ::GetLargest(pos.y, (float)joy->GetDPadPos(action._partIndex).y);
+			break;
+		}
+
+		switch (action._partValue)
+		{
+		case ff::INPUT_VALUE_LEFT: presses += dirs.left; break;
+		case ff::INPUT_VALUE_RIGHT: presses += dirs.right; break;
+		case ff::INPUT_VALUE_UP: presses += dirs.top; break;
+		case ff::INPUT_VALUE_DOWN: presses += dirs.bottom; break;
+		}
+	}
+
+	switch (action._partValue)
+	{
+	case ff::INPUT_VALUE_X_AXIS: return pos.x >= 0.5f;
+	case ff::INPUT_VALUE_Y_AXIS: return pos.y >= 0.5f;
+	case ff::INPUT_VALUE_LEFT: return -pos.x >= 0.5f;
+	case ff::INPUT_VALUE_RIGHT: return pos.x >= 0.5f;
+	case ff::INPUT_VALUE_UP: return -pos.y >= 0.5f;
+	case ff::INPUT_VALUE_DOWN: return pos.y >= 0.5f;
+	default: return pos.x >= 0.5f;
+	}
+}
+
+static ff::InputDevices CreateJoysticks(size_t count, ff::Vector<TestJoystick*>& joys)
+{
+	ff::InputDevices devices;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		joys.Push(new TestJoystick(i));
+		devices._joys.Push(joys.GetLast());
+	}
+
+	return devices;
+}
+
+static void SetFrame(const ff::Vector<TestJoystick*>& joys, size_t frame)
+{
+	for (TestJoystick* joy : joys)
+	{
+		joy->SetFrame(frame);
+	}
+}
+
+bool InputMappingTableTest()
+{
+	ff::Vector<TestJoystick*> joys;
+	ff::InputDevices devices = ::CreateJoysticks(4, joys);
+	ff::Vector<ff::InputAction> actions = ::CreateActions(60);
+
+	ff::InputMappingTable table;
+	ff::Vector<size_t> slots;
+	for (const ff::InputAction& action : actions)
+	{
+		slots.Push(table.AddAction(action));
+	}
+
+	// The same action always gets the same slot
+	assertRetVal(table.AddAction(actions[7]) == slots[7] && table.GetActionCount() < actions.Size(), false);
+
+	for (size_t frame = 0; frame < 300; frame++)
+	{
+		::SetFrame(joys, frame);
+		table.Snapshot(devices);
+
+		for (size_t i = 0; i < actions.Size(); i++)
+		{
+			int presses = 0;
+			bool value = ::GetDirectValue(devices, actions[i], presses);
+			assertRetVal(table.GetDigitalValue(slots[i]) == value && table.GetPressCount(slots[i]) == presses, false);
+		}
+	}
+
+	// New actions show up in the next snapshot
+	ff::InputAction newAction = ::CreateAction(ff::INPUT_PART_DPAD, ff::INPUT_VALUE_X_AXIS, 0);
+	size_t slot = table.AddAction(newAction);
+	assertRetVal(slot == table.GetActionCount() - 1, false);
+	table.Snapshot(devices);
+
+	int presses = 0;
+	assertRetVal(table.GetDigitalValue(slot) == ::GetDirectValue(devices, newAction, presses), false);
+
+	return true;
+}
+
+bool InputMappingTablePerfTest()
+{
+	// 500 mappings with up to two actions each, and four gamepads
+	const size_t mappingCount = 500;
+	const size_t frameCount = 1000;
+
+	ff::Vector<TestJoystick*> joys;
+	ff::InputDevices devices = ::CreateJoysticks(4, joys);
+	ff::Vector<ff::InputAction> actions = ::CreateActions(mappingCount * 3 / 2);
+
+	ff::Vector<ff::Vector<ff::InputAction>> mappings;
+	for (size_t i = 0, h = 0; i < mappingCount; i++)
+	{
+		mappings.Push(ff::Vector<ff::InputAction>());
+		mappings.GetLast().Push(actions[h++]);
+
+		if (i % 2)
+		{
+			mappings.GetLast().Push(actions[h++]);
+		}
+	}
+
+	// Before: every action of every mapping asks every joystick
+
+	size_t oldTriggered = 0;
+	ff::Timer timer;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		::SetFrame(joys, frame);
+
+		for (const ff::Vector<ff::InputAction>& mapping : mappings)
+		{
+			bool triggered = true;
+			for (const ff::InputAction& action : mapping)
+			{
+				int presses = 0;
+				triggered &= ::GetDirectValue(devices, action, presses);
+			}
+
+			oldTriggered += triggered ? 1 : 0;
+		}
+	}
+
+	double oldTime = timer.Tick();
+
+	// After: one snapshot per frame, then mappings just look at their slots
+
+	ff::InputMappingTable table;
+	ff::Vector<ff::Vector<size_t>> mappingSlots;
+	for (const ff::Vector<ff::InputAction>& mapping : mappings)
+	{
+		mappingSlots.Push(ff::Vector<size_t>());
+
+		for (const ff::InputAction& action : mapping)
+		{
+			mappingSlots.GetLast().Push(table.AddAction(action));
+		}
+	}
+
+	size_t newTriggered = 0;
+	timer.Tick();
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		::SetFrame(joys, frame);
+		table.Snapshot(devices);
+
+		for (const ff::Vector<size_t>& slots : mappingSlots)
+		{
+			bool triggered = true;
+			for (size_t slot : slots)
+			{
+				triggered &= table.GetDigitalValue(slot);
+			}
+
+			newTriggered += triggered ? 1 : 0;
+		}
+	}
+
+	double newTime = timer.Tick();
+
+	ff::String status = ff::String::format_new(
+		L"Input mapping: %lu mappings, %lu distinct actions, %lu joysticks, %lu frames\r\n"
+		L"  Before: %.2fus per frame\r\n"
+		L"  After: %.2fus per frame\r\n",
+		mappingCount,
+		table.GetActionCount(),
+		devices._joys.Size(),
+		frameCount,
+		oldTime * 1000000.0 / frameCount,
+		newTime * 1000000.0 / frameCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return oldTriggered == newTriggered;
+}
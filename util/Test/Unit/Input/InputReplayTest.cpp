@@ -0,0 +1,528 @@
+#include "pch.h"
+#include "Data/Data.h"
+#include "Data/DataWriterReader.h"
+#include "Globals/Log.h"
+#include "Input/InputReplay.h"
+#include "Input/Joystick/JoystickDevice.h"
+#include "Input/Keyboard/KeyboardDevice.h"
+#include "Input/Pointer/PointerDevice.h"
+#include "Types/Timer.h"
+
+// Input devices with a made up state for each frame
+template<typename TInterface>
+class TestDevice : public TInterface
+{
+public:
+	TestDevice()
+		: _refs(0)
+		, _frame(0)
+	{
+	}
+
+	virtual ~TestDevice()
+	{
+	}
+
+	void SetFrame(size_t frame)
+	{
+		_frame = frame;
+	}
+
+	// IUnknown
+	virtual HRESULT __stdcall QueryInterface(REFIID iid, void** obj) override
+	{
+		return E_NOINTERFACE;
+	}
+
+	virtual ULONG __stdcall AddRef() override
+	{
+		return ++_refs;
+	}
+
+	virtual ULONG __stdcall Release() override
+	{
+		ULONG refs = --_refs;
+		if (!refs)
+		{
+			delete this;
+		}
+
+		return refs;
+	}
+
+	// IInputDevice
+	virtual void Advance() override
+	{
+	}
+
+	virtual void KillPending() override
+	{
+	}
+
+	virtual bool IsConnected() const override
+	{
+		return _frame % 300 > 20;
+	}
+
+protected:
+	bool Bit(size_t part, size_t period) const
+	{
+		return ((_frame + part * 7) / period) % 3 == 0;
+	}
+
+	int Press(size_t part) const
+	{
+		return ((_frame + part) % 23) == 0 ? 1 : 0;
+	}
+
+	double Wave(size_t part) const
+	{
+		return std::sin(_frame * (0.03 + part * 0.01));
+	}
+
+	ULONG _refs;
+	size_t _frame;
+};
+
+class TestKeyboard : public TestDevice<ff::IKeyboardDevice>
+{
+public:
+	virtual bool GetKey(int vk) const override
+	{
+		return vk >= 'A' && vk <= 'Z' && Bit(vk, 11);
+	}
+
+	virtual int GetKeyPressCount(int vk) const override
+	{
+		return (vk >= 'A' && vk <= 'Z') ? Press(vk) : 0;
+	}
+
+	virtual ff::String GetChars() const override
+	{
+		return (_frame % 40 == 0) ? ff::String::format_new(L"frame %lu", _frame) : ff::String();
+	}
+};
+
+class TestPointer : public TestDevice<ff::IPointerDevice>
+{
+public:
+	TestPointer()
+	{
+		ff::ZeroObject(_touch);
+	}
+
+	virtual bool IsInWindow() const override
+	{
+		return _frame % 200 > 10;
+	}
+
+	virtual ff::PointDouble GetPos() const override
+	{
+		return ff::PointDouble(400 + Wave(0) * 300, 300 + Wave(1) * 200);
+	}
+
+	virtual ff::PointDouble GetRelativePos() const override
+	{
+		return ff::PointDouble(Wave(2), Wave(3));
+	}
+
+	virtual bool GetButton(int vkButton) const override
+	{
+		return Bit(vkButton, 17);
+	}
+
+	virtual int GetButtonClickCount(int vkButton) const override
+	{
+		return Press(vkButton);
+	}
+
+	virtual int GetButtonReleaseCount(int vkButton) const override
+	{
+		return Press(vkButton + 1);
+	}
+
+	virtual int GetButtonDoubleClickCount(int vkButton) const override
+	{
+		return Press(vkButton + 2) * Press(vkButton);
+	}
+
+	virtual ff::PointDouble GetWheelScroll() const override
+	{
+		return ff::PointDouble(0, (_frame % 13 == 0) ? 120 : 0);
+	}
+
+	virtual size_t GetTouchCount() const override
+	{
+		return (_frame % 50 < 10) ? 1 : 0;
+	}
+
+	virtual const ff::TouchInfo& GetTouchInfo(size_t index) const override
+	{
+		_touch.type = ff::INPUT_DEVICE_TOUCH;
+		_touch.id = 10;
+		_touch.vk = VK_LBUTTON;
+		_touch.counter = (unsigned int)(_frame % 50);
+		_touch.pos = GetPos();
+		_touch.startPos = ff::PointDouble(400, 300);
+		return _touch;
+	}
+
+private:
+	mutable ff::TouchInfo _touch;
+};
+
+class TestJoystick : public TestDevice<ff::IJoystickDevice>
+{
+public:
+	virtual size_t GetStickCount() const override
+	{
+		return 2;
+	}
+
+	virtual ff::PointFloat GetStickPos(size_t nStick, bool bDigital) const override
+	{
+		ff::PointFloat pos((float)Wave(nStick * 2), (float)Wave(nStick * 2 + 1));
+		return bDigital ? ff::PointFloat(std::round(pos.x), std::round(pos.y)) : pos;
+	}
+
+	virtual ff::RectInt GetStickPressCount(size_t nStick) const override
+	{
+		return ff::RectInt(Press(nStick * 4), Press(nStick * 4 + 1), Press(nStick * 4 + 2), Press(nStick * 4 + 3));
+	}
+
+	virtual ff::String GetStickName(size_t nStick) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetDPadCount() const override
+	{
+		return 1;
+	}
+
+	virtual ff::PointInt GetDPadPos(size_t nDPad) const override
+	{
+		return ff::PointInt(Bit(8, 19) ? 1 : 0, Bit(9, 29) ? -1 : 0);
+	}
+
+	virtual ff::RectInt GetDPadPressCount(size_t nDPad) const override
+	{
+		return ff::RectInt(Press(8), Press(9), Press(10), Press(11));
+	}
+
+	virtual ff::String GetDPadName(size_t nDPad) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetButtonCount() const override
+	{
+		return 10;
+	}
+
+	virtual bool GetButton(size_t nButton) const override
+	{
+		return Bit(nButton, 13);
+	}
+
+	virtual int GetButtonPressCount(size_t nButton) const override
+	{
+		return Press(12 + nButton);
+	}
+
+	virtual ff::String GetButtonName(size_t nButton) const override
+	{
+		return ff::String();
+	}
+
+	virtual size_t GetTriggerCount() const override
+	{
+		return 2;
+	}
+
+	virtual float GetTrigger(size_t nTrigger, bool bDigital) const override
+	{
+		float value = (float)std::fabs(Wave(4 + nTrigger));
+		return bDigital ? std::round(value) : value;
+	}
+
+	virtual int GetTriggerPressCount(size_t nTrigger) const override
+	{
+		return Press(22 + nTrigger);
+	}
+
+	virtual ff::String GetTriggerName(size_t nTrigger) const override
+	{
+		return ff::String();
+	}
+
+	virtual bool HasKeyButton(int vk) const override
+	{
+		return vk == VK_GAMEPAD_A || vk == VK_GAMEPAD_B;
+	}
+
+	virtual bool GetKeyButton(int vk) const override
+	{
+		return HasKeyButton(vk) && GetButton(vk - VK_GAMEPAD_A);
+	}
+
+	virtual int GetKeyButtonPressCount(int vk) const override
+	{
+		return HasKeyButton(vk) ? GetButtonPressCount(vk - VK_GAMEPAD_A) : 0;
+	}
+
+	virtual ff::String GetKeyButtonName(int vk) const override
+	{
+		return ff::String();
+	}
+};
+
+struct TestDevices
+{
+	ff::InputDevices _devices;
+	ff::Vector<TestKeyboard*> _keys;
+	ff::Vector<TestPointer*> _mice;
+	ff::Vector<TestJoystick*> _joys;
+
+	void SetFrame(size_t frame, size_t joyCount)
+	{
+		while (_joys.Size() < joyCount)
+		{
+			_joys.Push(new TestJoystick());
+			_devices._joys.Push(_joys.GetLast());
+		}
+
+		while (_joys.Size() > joyCount)
+		{
+			_joys.Pop();
+			_devices._joys.Pop();
+		}
+
+		for (TestKeyboard* device : _keys)
+		{
+			device->SetFrame(frame);
+		}
+
+		for (TestPointer* device : _mice)
+		{
+			device->SetFrame(frame);
+		}
+
+		for (TestJoystick* device : _joys)
+		{
+			device->SetFrame(frame);
+		}
+	}
+};
+
+static TestDevices CreateTestDevices()
+{
+	TestDevices devices;
+	devices._keys.Push(new TestKeyboard());
+	devices._devices._keys.Push(devices._keys.GetLast());
+	devices._mice.Push(new TestPointer());
+	devices._devices._mice.Push(devices._mice.GetLast());
+
+	return devices;
+}
+
+static ff::Vector<ff::InputEvent> CreateEvents(size_t frame)
+{
+	ff::Vector<ff::InputEvent> events;
+
+	for (size_t i = 0; i < frame % 4; i++)
+	{
+		ff::InputEvent event;
+		event._eventID = ff::HashFunc(frame % 10 + i);
+		event._count = (int)((frame + i) % 3);
+		events.Push(event);
+	}
+
+	return events;
+}
+
+static bool IsSameKeyboard(ff::IKeyboardDevice* device1, ff::IKeyboardDevice* device2)
+{
+	for (int vk = 0; vk < 256; vk++)
+	{
+		assertRetVal(device1->GetKey(vk) == device2->GetKey(vk) && device1->GetKeyPressCount(vk) == device2->GetKeyPressCount(vk), false);
+	}
+
+	return device1->GetChars() == device2->GetChars();
+}
+
+static bool IsSamePointer(ff::IPointerDevice* device1, ff::IPointerDevice* device2)
+{
+	assertRetVal(device1->IsInWindow() == device2->IsInWindow() && device1->GetPos() == device2->GetPos(), false);
+	assertRetVal(device1->GetRelativePos() == device2->GetRelativePos() && device1->GetWheelScroll() == device2->GetWheelScroll(), false);
+
+	for (int vk : { VK_LBUTTON, VK_RBUTTON, VK_MBUTTON, VK_XBUTTON1, VK_XBUTTON2 })
+	{
+		assertRetVal(device1->GetButton(vk) == device2->GetButton(vk) && device1->GetButtonClickCount(vk) == device2->GetButtonClickCount(vk), false);
+		assertRetVal(device1->GetButtonReleaseCount(vk) == device2->GetButtonReleaseCount(vk), false);
+		assertRetVal(device1->GetButtonDoubleClickCount(vk) == device2->GetButtonDoubleClickCount(vk), false);
+	}
+
+	assertRetVal(device1->GetTouchCount() == device2->GetTouchCount(), false);
+	for (size_t i = 0; i < device1->GetTouchCount(); i++)
+	{
+		const ff::TouchInfo& info1 = device1->GetTouchInfo(i);
+		const ff::TouchInfo& info2 = device2->GetTouchInfo(i);
+		assertRetVal(info1.id == info2.id && info1.type == info2.type && info1.vk == info2.vk && info1.counter == info2.counter, false);
+		assertRetVal(info1.pos == info2.pos && info1.startPos == info2.startPos, false);
+	}
+
+	return true;
+}
+
+static bool IsSameJoystick(ff::IJoystickDevice* device1, ff::IJoystickDevice* device2)
+{
+	assertRetVal(device1->IsConnected() == device2->IsConnected(), false);
+	assertRetVal(device1->GetStickCount() == device2->GetStickCount() && device1->GetDPadCount() == device2->GetDPadCount(), false);
+	assertRetVal(device1->GetButtonCount() == device2->GetButtonCount() && device1->GetTriggerCount() == device2->GetTriggerCount(), false);
+
+	for (size_t i = 0; i < device1->GetStickCount(); i++)
+	{
+		assertRetVal(device1->GetStickPos(i, false) == device2->GetStickPos(i, false) && device1->GetStickPos(i, true) == device2->GetStickPos(i, true), false);
+		assertRetVal(device1->GetStickPressCount(i) == device2->GetStickPressCount(i), false);
+	}
+
+	for (size_t i = 0; i < device1->GetDPadCount(); i++)
+	{
+		assertRetVal(device1->GetDPadPos(i) == device2->GetDPadPos(i) && device1->GetDPadPressCount(i) == device2->GetDPadPressCount(i), false);
+	}
+
+	for (size_t i = 0; i < device1->GetButtonCount(); i++)
+	{
+		assertRetVal(device1->GetButton(i) == device2->GetButton(i) && device1->GetButtonPressCount(i) == device2->GetButtonPressCount(i), false);
+	}
+
+	for (size_t i = 0; i < device1->GetTriggerCount(); i++)
+	{
+		assertRetVal(device1->GetTrigger(i, false) == device2->GetTrigger(i, false) && device1->GetTrigger(i, true) == device2->GetTrigger(i, true), false);
+		assertRetVal(device1->GetTriggerPressCount(i) == device2->GetTriggerPressCount(i), false);
+	}
+
+	for (int vk = VK_GAMEPAD_A; vk <= VK_GAMEPAD_RIGHT_THUMBSTICK_LEFT; vk++)
+	{
+		assertRetVal(device1->HasKeyButton(vk) == device2->HasKeyButton(vk) && device1->GetKeyButton(vk) == device2->GetKeyButton(vk), false);
+		assertRetVal(device1->GetKeyButtonPressCount(vk) == device2->GetKeyButtonPressCount(vk), false);
+	}
+
+	return true;
+}
+
+static bool IsSameEvents(const ff::Vector<ff::InputEvent>& events1, const ff::Vector<ff::InputEvent>& events2)
+{
+	assertRetVal(events1.Size() == events2.Size(), false);
+
+	for (size_t i = 0; i < events1.Size(); i++)
+	{
+		assertRetVal(events1[i]._eventID == events2[i]._eventID && events1[i]._count == events2[i]._count, false);
+	}
+
+	return true;
+}
+
+// Joysticks come and go during the recording
+static size_t GetJoystickCount(size_t frame)
+{
+	return (frame < 200) ? 2 : (frame < 400 ? 3 : 1);
+}
+
+bool InputReplayTest()
+{
+	const size_t frameCount = 600;
+	TestDevices devices = ::CreateTestDevices();
+
+	ff::ComPtr<ff::IDataVector> data;
+	ff::ComPtr<ff::IDataWriter> writer;
+	assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+
+	ff::InputRecorder recorder(writer);
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		devices.SetFrame(frame, ::GetJoystickCount(frame));
+		assertRetVal(recorder.RecordFrame(devices._devices, ::CreateEvents(frame), 1.0 / 60.0), false);
+	}
+
+	assertRetVal(recorder.GetFrameCount() == frameCount, false);
+
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(ff::CreateDataReader(data, 0, &reader), false);
+
+	ff::InputReplay replay(reader);
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		devices.SetFrame(frame, ::GetJoystickCount(frame));
+		assertRetVal(replay.Advance() && replay.GetDeltaTime() == 1.0 / 60.0, false);
+
+		const ff::InputDevices& replayDevices = replay.GetDevices();
+		assertRetVal(replayDevices._keys.Size() == 1 && replayDevices._mice.Size() == 1 && replayDevices._joys.Size() == devices._joys.Size(), false);
+		assertRetVal(::IsSameKeyboard(devices._keys[0], replayDevices._keys[0]) && ::IsSamePointer(devices._mice[0], replayDevices._mice[0]), false);
+
+		for (size_t i = 0; i < devices._joys.Size(); i++)
+		{
+			assertRetVal(::IsSameJoystick(devices._joys[i], replayDevices._joys[i]), false);
+		}
+
+		assertRetVal(::IsSameEvents(::CreateEvents(frame), replay.GetRecordedEvents()), false);
+	}
+
+	assertRetVal(!replay.Advance() && replay.GetFrameCount() == frameCount, false);
+
+	return true;
+}
+
+bool InputReplayPerfTest()
+{
+	// A keyboard, a mouse, and four gamepads for ten minutes at 60hz
+	const size_t frameCount = 36000;
+	const size_t joyCount = 4;
+	TestDevices devices = ::CreateTestDevices();
+
+	ff::ComPtr<ff::IDataVector> data;
+	ff::ComPtr<ff::IDataWriter> writer;
+	assertRetVal(ff::CreateDataWriter(&data, &writer), false);
+
+	ff::InputRecorder recorder(writer);
+	ff::Timer timer;
+
+	for (size_t frame = 0; frame < frameCount; frame++)
+	{
+		devices.SetFrame(frame, joyCount);
+		assertRetVal(recorder.RecordFrame(devices._devices, ::CreateEvents(frame), 1.0 / 60.0), false);
+	}
+
+	double recordTime = timer.Tick();
+
+	ff::ComPtr<ff::IDataReader> reader;
+	assertRetVal(ff::CreateDataReader(data, 0, &reader), false);
+
+	ff::InputReplay replay(reader);
+	size_t eventCount = 0;
+	timer.Tick();
+
+	while (replay.Advance())
+	{
+		eventCount += replay.GetRecordedEvents().Size();
+	}
+
+	double replayTime = timer.Tick();
+
+	ff::String status = ff::String::format_new(
+		L"Input replay: %lu frames, %lu events, %lu joysticks\r\n"
+		L"  Size: %luKB, %.1f bytes per frame\r\n"
+		L"  Record: %.2fus per frame, Replay: %.2fus per frame\r\n",
+		replay.GetFrameCount(),
+		eventCount,
+		joyCount,
+		data->GetSize() / 1024,
+		(double)data->GetSize() / frameCount,
+		recordTime * 1000000.0 / frameCount,
+		replayTime * 1000000.0 / frameCount);
+	ff::Log::DebugTraceF(status.c_str());
+	std::wcout << status.c_str();
+
+	return replay.GetFrameCount() == frameCount;
+}
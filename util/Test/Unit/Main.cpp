@@ -3,25 +3,64 @@
 #include "Globals/ProcessGlobals.h"
 #include "MainUtilInclude.h"
 
+bool AnimationPerfTest();
+bool AudioMixerPerfTest();
+bool AudioMusicStreamPerfTest();
+bool AudioPcmCachePerfTest();
+bool AudioVoicePoolPerfTest();
+bool CharGlyphTablePerfTest();
 bool DictPerfTest();
+bool InputEventQueuePerfTest();
+bool InputMappingTablePerfTest();
+bool InputReplayPerfTest();
+bool KeyFramesPerfTest();
+bool LogPerfTest();
 bool MapPerfTest();
+bool MemAllocPerfTest();
+bool PaletteImagePerfTest();
+bool ProfilerPerfTest();
+bool SpriteGeometryPerfTest();
+bool SpriteOptimizerPerfTest();
+bool SpritePackerPerfTest();
+bool TextureUpdateBatchPerfTest();
 
+bool AnimationBatchTest();
+bool AudioMixerTest();
+bool AudioMusicStreamTest();
+bool AudioPcmCacheTest();
+bool AudioVoicePoolTest();
+bool CharGlyphTableTest();
 bool EntityTest();
 bool FixedIntTest();
+bool InputEventQueueTest();
+bool InputMappingTableTest();
+bool InputReplayTest();
 bool JsonDeepValue();
 bool JsonParserTest();
 bool JsonPrintTest();
 bool JsonTokenizerTest();
+bool KeyFramesTest();
 bool ListTest();
+bool LogTest();
 bool MapTest();
+bool MemAllocTest();
+bool PaletteImageTest();
 bool PoolTest();
+bool PremultiplyAlphaTest();
 bool ProcessGlobalsTest();
+bool ProfilerTest();
 bool SmallDictTest();
 bool SmallDictPersistTest();
 bool SmartPtrTest();
+bool SpriteGeometryTest();
+bool SpriteOptimizerTest();
+bool SpritePackerTest();
 bool StringSortTest();
 bool StringTest();
 bool StringHashTest();
+bool TextureCompressTest();
+bool TextureResidencyTest();
+bool TextureUpdateBatchTest();
 bool ValueTest();
 bool VectorTest();
 
@@ -37,26 +76,65 @@ int wmain(int argc, wchar_t *argv[])
 
 	if (runPerfTests)
 	{
+		assertRetVal(AnimationPerfTest(), 1);
+		assertRetVal(AudioMixerPerfTest(), 1);
+		assertRetVal(AudioMusicStreamPerfTest(), 1);
+		assertRetVal(AudioPcmCachePerfTest(), 1);
+		assertRetVal(AudioVoicePoolPerfTest(), 1);
+		assertRetVal(CharGlyphTablePerfTest(), 1);
 		assertRetVal(DictPerfTest(), 1);
+		assertRetVal(InputEventQueuePerfTest(), 1);
+		assertRetVal(InputMappingTablePerfTest(), 1);
+		assertRetVal(InputReplayPerfTest(), 1);
+		assertRetVal(KeyFramesPerfTest(), 1);
+		assertRetVal(LogPerfTest(), 1);
 		assertRetVal(MapPerfTest(), 1);
+		assertRetVal(MemAllocPerfTest(), 1);
+		assertRetVal(PaletteImagePerfTest(), 1);
+		assertRetVal(ProfilerPerfTest(), 1);
+		assertRetVal(SpriteGeometryPerfTest(), 1);
+		assertRetVal(SpriteOptimizerPerfTest(), 1);
+		assertRetVal(SpritePackerPerfTest(), 1);
+		assertRetVal(TextureUpdateBatchPerfTest(), 1);
 	}
 	else
 	{
+		assertRetVal(AnimationBatchTest(), 1);
+		assertRetVal(AudioMixerTest(), 1);
+		assertRetVal(AudioMusicStreamTest(), 1);
+		assertRetVal(AudioPcmCacheTest(), 1);
+		assertRetVal(AudioVoicePoolTest(), 1);
+		assertRetVal(CharGlyphTableTest(), 1);
 		assertRetVal(EntityTest(), 1);
 		assertRetVal(FixedIntTest(), 1);
+		assertRetVal(InputEventQueueTest(), 1);
+		assertRetVal(InputMappingTableTest(), 1);
+		assertRetVal(InputReplayTest(), 1);
 		assertRetVal(JsonDeepValue(), 1);
 		assertRetVal(JsonParserTest(), 1);
 		assertRetVal(JsonPrintTest(), 1);
 		assertRetVal(JsonTokenizerTest(), 1);
+		assertRetVal(KeyFramesTest(), 1);
 		assertRetVal(ListTest(), 1);
+		assertRetVal(LogTest(), 1);
 		assertRetVal(MapTest(), 1);
+		assertRetVal(MemAllocTest(), 1);
+		assertRetVal(PaletteImageTest(), 1);
 		assertRetVal(PoolTest(), 1);
+		assertRetVal(PremultiplyAlphaTest(), 1);
+		assertRetVal(ProfilerTest(), 1);
 		assertRetVal(SmallDictTest(), 1);
 		assertRetVal(SmallDictPersistTest(), 1);
 		assertRetVal(SmartPtrTest(), 1);
+		assertRetVal(SpriteGeometryTest(), 1);
+		assertRetVal(SpriteOptimizerTest(), 1);
+		assertRetVal(SpritePackerTest(), 1);
 		assertRetVal(StringSortTest(), 1);
 		assertRetVal(StringTest(), 1);
 		assertRetVal(StringHashTest(), 1);
+		assertRetVal(TextureCompressTest(), 1);
+		assertRetVal(TextureResidencyTest(), 1);
+		assertRetVal(TextureUpdateBatchTest(), 1);
 		assertRetVal(ValueTest(), 1);
 		assertRetVal(VectorTest(), 1);
 	}
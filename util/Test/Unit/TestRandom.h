@@ -0,0 +1,38 @@
+#pragma once
+
+// Repeatable random numbers for test data, the same seed always gives the same values
+class TestRandom
+{
+public:
+	TestRandom(size_t seed)
+		: _seed(seed)
+	{
+	}
+
+	size_t Next()
+	{
+		_seed = _seed * 1103515245 + 12345;
+		return _seed >> 16;
+	}
+
+	size_t Next(size_t count)
+	{
+		return Next() % count;
+	}
+
+	ff::Vector<BYTE> NextBytes(size_t count)
+	{
+		ff::Vector<BYTE> bytes;
+		bytes.Resize(count);
+
+		for (BYTE& value : bytes)
+		{
+			value = (BYTE)Next();
+		}
+
+		return bytes;
+	}
+
+private:
+	size_t _seed;
+};
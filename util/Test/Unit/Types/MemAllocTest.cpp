@@ -0,0 +1,232 @@
+#include "pch.h"
+#include "Globals/Log.h"
+#include "Thread/ThreadPool.h"
+#include "Thread/ThreadUtil.h"
+#include "Types/Timer.h"
+
+static const wchar_t* TEST_POOL_NAME = L"MemAllocTest";
+
+static ff::MemoryTagDiff GetTagDiff(const ff::MemorySnapshot& before, ff::MemoryTag tag)
+{
+	return ff::DiffMemorySnapshots(before, ff::GetMemorySnapshot()).tags[(size_t)tag];
+}
+
+static bool GetTestPoolStats(ff::MemoryPoolStats& stats)
+{
+	for (const ff::MemoryPoolStats& i : ff::GetMemoryPoolStats())
+	{
+		if (i.name == TEST_POOL_NAME)
+		{
+			stats = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool TestPoolChurn()
+{
+	typedef std::array<size_t, 4> TestData;
+	ff::MemorySnapshot before = ff::GetMemorySnapshot();
+	ff::Vector<TestData*> live;
+	size_t totalAllocs = 0;
+	size_t totalFrees = 0;
+	{
+		ff::PoolAllocator<TestData, false> pool(TEST_POOL_NAME, ff::MemoryTag::Component);
+
+		for (size_t round = 0; round < 16; round++)
+		{
+			for (size_t i = 0; i < 500; i++, totalAllocs++)
+			{
+				live.Push(pool.New());
+			}
+
+			// Free every third item, so the pool's free list gets mixed up
+			for (size_t i = live.Size(); i > 0; i--)
+			{
+				if (i % 3 == round % 3)
+				{
+					pool.Delete(live[i - 1]);
+					live.Delete(i - 1);
+					totalFrees++;
+				}
+			}
+
+			ff::MemoryTagDiff diff = ::GetTagDiff(before, ff::MemoryTag::Component);
+			assertRetVal(diff.liveCount == (ptrdiff_t)live.Size(), false);
+			assertRetVal(diff.liveBytes == (ptrdiff_t)(live.Size() * sizeof(TestData)), false);
+			assertRetVal(diff.allocCount == totalAllocs && diff.freeCount == totalFrees, false);
+
+			ff::MemoryPoolStats stats;
+			assertRetVal(::GetTestPoolStats(stats), false);
+			assertRetVal(stats.tag == ff::MemoryTag::Component && stats.itemBytes == sizeof(TestData), false);
+			assertRetVal(stats.usedCount == live.Size() && stats.allocatedCount >= stats.usedCount, false);
+		}
+
+		for (TestData* data : live)
+		{
+			pool.Delete(data);
+			totalFrees++;
+		}
+
+		live.Clear();
+
+		ff::MemoryTagDiff diff = ::GetTagDiff(before, ff::MemoryTag::Component);
+		assertRetVal(!diff.liveCount && !diff.liveBytes, false);
+		assertRetVal(diff.allocCount == totalAllocs && diff.freeCount == totalFrees, false);
+
+		ff::MemoryPoolStats stats;
+		pool.Reduce();
+		assertRetVal(::GetTestPoolStats(stats) && !stats.usedCount && !stats.allocatedCount, false);
+	}
+
+	// The pool unregisters itself
+	ff::MemoryPoolStats stats;
+	assertRetVal(!::GetTestPoolStats(stats), false);
+
+	return true;
+}
+
+static bool TestThreadChurn()
+{
+	const size_t threadCount = 4;
+	const size_t allocsPerThread = 10000;
+
+	ff::BytePoolAllocator<48, 8> pool(TEST_POOL_NAME, ff::MemoryTag::Component);
+	ff::MemorySnapshot before = ff::GetMemorySnapshot();
+	ff::Mutex mutex;
+	ff::Vector<void*> kept;
+	std::atomic<size_t> threadsDone = 0;
+	ff::WinHandle doneEvent = ff::CreateEvent();
+
+	for (size_t thread = 0; thread < threadCount; thread++)
+	{
+		ff::GetThreadPool()->AddThread([&]()
+			{
+				for (size_t i = 0; i < allocsPerThread; i++)
+				{
+					void* data = pool.NewBytes();
+
+					if (i % 2)
+					{
+						pool.DeleteBytes(data);
+					}
+					else
+					{
+						// Freed on another thread later
+						ff::LockMutex lock(mutex);
+						kept.Push(data);
+					}
+				}
+
+				if (++threadsDone == threadCount)
+				{
+					::SetEvent(doneEvent);
+				}
+			});
+	}
+
+	ff::WaitForHandle(doneEvent);
+
+	ff::MemoryTagDiff diff = ::GetTagDiff(before, ff::MemoryTag::Component);
+	assertRetVal(kept.Size() == threadCount * allocsPerThread / 2, false);
+	assertRetVal(diff.liveCount == (ptrdiff_t)kept.Size() && diff.liveBytes == (ptrdiff_t)(kept.Size() * 48), false);
+	assertRetVal(diff.allocCount == threadCount * allocsPerThread && diff.freeCount == kept.Size(), false);
+
+	for (void* data : kept)
+	{
+		pool.DeleteBytes(data);
+	}
+
+	ff::MemoryTagDiff diffAfter = ::GetTagDiff(before, ff::MemoryTag::Component);
+	assertRetVal(!diffAfter.liveCount && !diffAfter.liveBytes && diffAfter.freeCount == diffAfter.allocCount, false);
+
+	return true;
+}
+
+static bool TestPeakAndStrings()
+{
+	const size_t blockSize = 1024;
+	const size_t blockCount = 200;
+	ff::MemorySnapshot before = ff::GetMemorySnapshot();
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		ff::TrackMemoryAlloc(ff::MemoryTag::Component, blockSize);
+	}
+
+	ff::MemorySnapshot middle = ff::GetMemorySnapshot();
+	const ff::MemoryTagStats& middleStats = middle.tags[(size_t)ff::MemoryTag::Component];
+	assertRetVal(middleStats.liveBytes == before.tags[(size_t)ff::MemoryTag::Component].liveBytes + blockSize * blockCount, false);
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		ff::TrackMemoryFree(ff::MemoryTag::Component, blockSize);
+	}
+
+	ff::MemorySnapshot after = ff::GetMemorySnapshot();
+	assertRetVal(after.tags[(size_t)ff::MemoryTag::Component].peakBytes >= middleStats.liveBytes, false);
+	assertRetVal(after.tags[(size_t)ff::MemoryTag::Component].liveBytes == before.tags[(size_t)ff::MemoryTag::Component].liveBytes, false);
+
+	// Long strings skip the string pools, they must still be counted
+	{
+		ff::String text(2000, L'x');
+
+		ff::MemoryTagDiff diff = ::GetTagDiff(after, ff::MemoryTag::String);
+		assertRetVal(diff.liveCount > 0 && diff.liveBytes >= (ptrdiff_t)(text.size() * sizeof(wchar_t)), false);
+	}
+
+	ff::MemoryTagDiff diff = ::GetTagDiff(after, ff::MemoryTag::String);
+	assertRetVal(!diff.liveCount && !diff.liveBytes, false);
+
+	return true;
+}
+
+bool MemAllocTest()
+{
+	return ::TestPoolChurn() && ::TestThreadChurn() && ::TestPeakAndStrings();
+}
+
+bool MemAllocPerfTest()
+{
+	const size_t count = 1000000;
+	const double nsScale = 1000000000.0 / ff::Timer::GetRawFreqStatic() / count;
+
+	INT64 start = ff::Timer::GetCurrentRawTime();
+	for (size_t i = 0; i < count; i++)
+	{
+		ff::TrackMemoryAlloc(ff::MemoryTag::Component, 64);
+		ff::TrackMemoryFree(ff::MemoryTag::Component, 64);
+	}
+
+	double trackNs = (ff::Timer::GetCurrentRawTime() - start) * nsScale;
+
+	ff::BytePoolAllocator<64, 8> untrackedPool;
+	ff::BytePoolAllocator<64, 8> trackedPool(TEST_POOL_NAME, ff::MemoryTag::Component);
+
+	start = ff::Timer::GetCurrentRawTime();
+	for (size_t i = 0; i < count; i++)
+	{
+		untrackedPool.DeleteBytes(untrackedPool.NewBytes());
+	}
+
+	double untrackedNs = (ff::Timer::GetCurrentRawTime() - start) * nsScale;
+
+	start = ff::Timer::GetCurrentRawTime();
+	for (size_t i = 0; i < count; i++)
+	{
+		trackedPool.DeleteBytes(trackedPool.NewBytes());
+	}
+
+	double trackedNs = (ff::Timer::GetCurrentRawTime() - start) * nsScale;
+
+	ff::String text = ff::String::format_new(
+		L"MemAllocPerfTest: Track alloc+free:%.1fns, Pool new+delete:%.1fns untracked, %.1fns tracked\r\n",
+		trackNs, untrackedNs, trackedNs);
+
+	ff::Log::DebugTraceF(text.c_str());
+	std::wcout << text.c_str();
+
+	return true;
+}
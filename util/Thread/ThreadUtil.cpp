@@ -2,10 +2,13 @@
 #include "Globals/ProcessGlobals.h"
 #include "Module/Module.h"
 #include "Thread/ThreadDispatch.h"
+#include "Thread/ThreadPool.h"
 #include "Thread/ThreadUtil.h"
 #include "Windows/Handles.h"
 #include "Windows/WinUtil.h"
 
+static std::atomic_size_t s_parallelThreadCount = 0;
+
 HANDLE ff::CreateEvent(bool initialSet, bool manualReset)
 {
 	return ::CreateEventEx(nullptr, nullptr,
@@ -68,3 +71,65 @@ size_t ff::WaitForAnyHandle(HANDLE* handles, size_t count)
 		}
 	}
 }
+
+void ff::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	ff::IThreadPool* threadPool = ff::GetThreadPool();
+	size_t threadCount = std::min(count, ff::GetParallelThreadCount());
+
+	if (threadCount < 2 || !threadPool)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			func(i);
+		}
+
+		return;
+	}
+
+	std::atomic_size_t nextIndex = 0;
+	std::atomic_size_t runningThreads = threadCount - 1;
+	ff::WinHandle doneEvent = ff::CreateEvent();
+
+	auto runFunc = [&nextIndex, count, &func]()
+	{
+		for (size_t i = nextIndex++; i < count; i = nextIndex++)
+		{
+			func(i);
+		}
+	};
+
+	for (size_t i = 1; i < threadCount; i++)
+	{
+		threadPool->AddThread([&runFunc, &runningThreads, &doneEvent]()
+			{
+				runFunc();
+
+				if (!--runningThreads)
+				{
+					::SetEvent(doneEvent);
+				}
+			});
+	}
+
+	runFunc();
+	ff::WaitForHandle(doneEvent);
+}
+
+size_t ff::GetParallelThreadCount()
+{
+	size_t count = s_parallelThreadCount;
+	if (!count)
+	{
+		SYSTEM_INFO info;
+		::GetNativeSystemInfo(&info);
+		count = std::max<size_t>(info.dwNumberOfProcessors, 1);
+	}
+
+	return count;
+}
+
+void ff::SetParallelThreadCount(size_t count)
+{
+	s_parallelThreadCount = count;
+}
@@ -7,4 +7,9 @@ namespace ff
 	UTIL_API bool WaitForEventAndReset(HANDLE handle);
 	UTIL_API bool WaitForHandle(HANDLE handle);
 	UTIL_API size_t WaitForAnyHandle(HANDLE* handles, size_t count);
+
+	// Calls func(index) for each index in [0, count) using up to GetParallelThreadCount() threads, including the calling thread
+	UTIL_API void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+	UTIL_API size_t GetParallelThreadCount();
+	UTIL_API void SetParallelThreadCount(size_t count); // zero uses one thread per processor
 }
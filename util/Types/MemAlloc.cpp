@@ -8,6 +8,147 @@ static std::atomic_size_t s_currentBytes;
 static std::atomic_size_t s_maxBytes;
 static std::atomic_size_t s_allocCount;
 
+static const size_t MEMORY_TAG_COUNT = (size_t)ff::MemoryTag::Count;
+static const size_t MEMORY_THREAD_SLOTS = 128;
+static const ptrdiff_t MEMORY_PUBLISH_BYTES = 16384;
+
+struct MemoryTagCounters
+{
+	std::atomic_size_t _allocBytes;
+	std::atomic_size_t _allocCount;
+	std::atomic_size_t _freeBytes;
+	std::atomic_size_t _freeCount;
+	ptrdiff_t _unpublishedBytes; // only used by the owner of the slot
+};
+
+// A thread owns a slot and is the only writer to its counters, so updating them doesn't need locked
+// instructions. When a thread exits, the next new thread takes over the slot and keeps adding to it.
+struct MemoryThreadSlot
+{
+	std::atomic_bool _owned;
+	std::array<MemoryTagCounters, MEMORY_TAG_COUNT> _tags;
+};
+
+// Releases the slot when a thread exits
+class MemoryThreadOwner
+{
+public:
+	MemoryThreadOwner();
+	~MemoryThreadOwner();
+
+	MemoryThreadSlot* _slot;
+};
+
+// Slot zero is shared by threads that didn't get their own, so it's always updated atomically
+static std::array<MemoryThreadSlot, MEMORY_THREAD_SLOTS> s_memorySlots;
+static std::array<std::atomic<ptrdiff_t>, MEMORY_TAG_COUNT> s_memoryPublishedBytes;
+static std::array<std::atomic_size_t, MEMORY_TAG_COUNT> s_memoryPeakBytes;
+static thread_local MemoryThreadSlot* s_memoryThreadSlot;
+static thread_local MemoryThreadOwner s_memoryThreadOwner;
+
+static const wchar_t* s_memoryTagNames[MEMORY_TAG_COUNT] =
+{
+	L"None",
+	L"String",
+	L"Value",
+	L"Dict",
+	L"Component",
+	L"Texture",
+};
+
+struct MemoryPoolRegistry
+{
+	ff::Mutex _mutex;
+	ff::Vector<ff::IBytePoolAllocator*> _pools;
+};
+
+MemoryThreadOwner::MemoryThreadOwner()
+	: _slot(nullptr)
+{
+}
+
+MemoryThreadOwner::~MemoryThreadOwner()
+{
+	if (_slot)
+	{
+		// Anything freed later in thread shutdown goes to the shared slot
+		s_memoryThreadSlot = &s_memorySlots[0];
+		_slot->_owned.store(false, std::memory_order_release);
+	}
+}
+
+static MemoryThreadSlot* GetMemoryThreadSlot()
+{
+	MemoryThreadSlot* slot = s_memoryThreadSlot;
+	if (!slot)
+	{
+		slot = &s_memorySlots[0];
+
+		for (size_t i = 1; i < s_memorySlots.size(); i++)
+		{
+			bool owned = false;
+			if (s_memorySlots[i]._owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+			{
+				slot = &s_memorySlots[i];
+				s_memoryThreadOwner._slot = slot;
+				break;
+			}
+		}
+
+		s_memoryThreadSlot = slot;
+	}
+
+	return slot;
+}
+
+static void AddToCounter(std::atomic_size_t& counter, size_t value, bool shared)
+{
+	if (shared)
+	{
+		counter.fetch_add(value, std::memory_order_acq_rel);
+	}
+	else
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_release);
+	}
+}
+
+static void UpdatePeakBytes(size_t tag, size_t bytes)
+{
+	for (size_t currentPeak = s_memoryPeakBytes[tag]; bytes > currentPeak; )
+	{
+		if (s_memoryPeakBytes[tag].compare_exchange_weak(currentPeak, bytes))
+		{
+			break;
+		}
+	}
+}
+
+// The peak is only checked once a thread's live bytes move by MEMORY_PUBLISH_BYTES, so it can be off by that much per thread
+static void AddLiveBytes(MemoryTagCounters& counters, size_t tag, ptrdiff_t bytes, bool shared)
+{
+	if (!shared)
+	{
+		counters._unpublishedBytes += bytes;
+		noAssertRet(std::abs(counters._unpublishedBytes) >= MEMORY_PUBLISH_BYTES);
+
+		bytes = counters._unpublishedBytes;
+		counters._unpublishedBytes = 0;
+	}
+
+	ptrdiff_t publishedBytes = s_memoryPublishedBytes[tag].fetch_add(bytes) + bytes;
+	if (bytes > 0 && publishedBytes > 0)
+	{
+		::UpdatePeakBytes(tag, (size_t)publishedBytes);
+	}
+}
+
+static MemoryPoolRegistry& GetMemoryPoolRegistry()
+{
+	static MemoryPoolRegistry s_registry;
+	return s_registry;
+}
+
 ff::AtScope::AtScope(AtScope&& rhs)
 	: _closeFunc(std::move(rhs._closeFunc))
 {
@@ -46,6 +187,123 @@ ff::MemoryStats ff::GetMemoryAllocationStats()
 	return stats;
 }
 
+void ff::TrackMemoryAlloc(MemoryTag tag, size_t bytes)
+{
+	noAssertRet(tag != MemoryTag::None);
+
+	MemoryThreadSlot* slot = ::GetMemoryThreadSlot();
+	MemoryTagCounters& counters = slot->_tags[(size_t)tag];
+	bool shared = (slot == &s_memorySlots[0]);
+
+	::AddToCounter(counters._allocCount, 1, shared);
+	::AddToCounter(counters._allocBytes, bytes, shared);
+	::AddLiveBytes(counters, (size_t)tag, (ptrdiff_t)bytes, shared);
+}
+
+void ff::TrackMemoryFree(MemoryTag tag, size_t bytes)
+{
+	noAssertRet(tag != MemoryTag::None);
+
+	MemoryThreadSlot* slot = ::GetMemoryThreadSlot();
+	MemoryTagCounters& counters = slot->_tags[(size_t)tag];
+	bool shared = (slot == &s_memorySlots[0]);
+
+	::AddToCounter(counters._freeCount, 1, shared);
+	::AddToCounter(counters._freeBytes, bytes, shared);
+	::AddLiveBytes(counters, (size_t)tag, -(ptrdiff_t)bytes, shared);
+}
+
+const wchar_t* ff::GetMemoryTagName(MemoryTag tag)
+{
+	assertRetVal((size_t)tag < MEMORY_TAG_COUNT, L"");
+	return s_memoryTagNames[(size_t)tag];
+}
+
+ff::MemorySnapshot ff::GetMemorySnapshot()
+{
+	ff::MemorySnapshot snapshot{};
+
+	for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+	{
+		ff::MemoryTagStats& stats = snapshot.tags[tag];
+		size_t freeBytes = 0;
+
+		// Frees are read before allocations so that live counts can't go below zero
+		for (const MemoryThreadSlot& slot : s_memorySlots)
+		{
+			freeBytes += slot._tags[tag]._freeBytes.load(std::memory_order_acquire);
+			stats.freeCount += slot._tags[tag]._freeCount.load(std::memory_order_acquire);
+		}
+
+		for (const MemoryThreadSlot& slot : s_memorySlots)
+		{
+			stats.allocBytes += slot._tags[tag]._allocBytes.load(std::memory_order_acquire);
+			stats.allocCount += slot._tags[tag]._allocCount.load(std::memory_order_acquire);
+		}
+
+		stats.liveBytes = (stats.allocBytes > freeBytes) ? stats.allocBytes - freeBytes : 0;
+		stats.liveCount = (stats.allocCount > stats.freeCount) ? stats.allocCount - stats.freeCount : 0;
+
+		::UpdatePeakBytes(tag, stats.liveBytes);
+		stats.peakBytes = s_memoryPeakBytes[tag];
+	}
+
+	return snapshot;
+}
+
+ff::MemorySnapshotDiff ff::DiffMemorySnapshots(const MemorySnapshot& before, const MemorySnapshot& after)
+{
+	ff::MemorySnapshotDiff diff{};
+
+	for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+	{
+		const ff::MemoryTagStats& statsBefore = before.tags[tag];
+		const ff::MemoryTagStats& statsAfter = after.tags[tag];
+		ff::MemoryTagDiff& tagDiff = diff.tags[tag];
+
+		tagDiff.liveBytes = (ptrdiff_t)statsAfter.liveBytes - (ptrdiff_t)statsBefore.liveBytes;
+		tagDiff.liveCount = (ptrdiff_t)statsAfter.liveCount - (ptrdiff_t)statsBefore.liveCount;
+		tagDiff.allocBytes = statsAfter.allocBytes - statsBefore.allocBytes;
+		tagDiff.allocCount = statsAfter.allocCount - statsBefore.allocCount;
+		tagDiff.freeCount = statsAfter.freeCount - statsBefore.freeCount;
+	}
+
+	return diff;
+}
+
+void ff::RegisterMemoryPool(IBytePoolAllocator* pool)
+{
+	MemoryPoolRegistry& registry = ::GetMemoryPoolRegistry();
+	ff::LockMutex lock(registry._mutex);
+	registry._pools.Push(pool);
+}
+
+void ff::UnregisterMemoryPool(IBytePoolAllocator* pool)
+{
+	MemoryPoolRegistry& registry = ::GetMemoryPoolRegistry();
+	ff::LockMutex lock(registry._mutex);
+
+	size_t i = registry._pools.Find(pool);
+	assertRet(i != ff::INVALID_SIZE);
+	registry._pools.Delete(i);
+}
+
+ff::Vector<ff::MemoryPoolStats> ff::GetMemoryPoolStats()
+{
+	MemoryPoolRegistry& registry = ::GetMemoryPoolRegistry();
+	ff::LockMutex lock(registry._mutex);
+
+	ff::Vector<ff::MemoryPoolStats> stats;
+	stats.Reserve(registry._pools.Size());
+
+	for (const ff::IBytePoolAllocator* pool : registry._pools)
+	{
+		stats.Push(pool->GetStats());
+	}
+
+	return stats;
+}
+
 #ifdef _DEBUG
 
 static int CrtAllocHook(
@@ -12,6 +12,57 @@ namespace ff
 
 	MemoryStats GetMemoryAllocationStats();
 
+	// Who owns tracked memory. Pools and other allocators report to a tag when
+	// they're given one, allocations tagged None aren't counted.
+	enum class MemoryTag
+	{
+		None,
+		String,
+		Value,
+		Dict,
+		Component,
+		Texture,
+
+		Count
+	};
+
+	struct MemoryTagStats
+	{
+		size_t liveBytes;
+		size_t liveCount;
+		size_t peakBytes; // within a few KB per thread, see TrackMemoryAlloc
+		size_t allocBytes;
+		size_t allocCount;
+		size_t freeCount;
+	};
+
+	struct MemoryTagDiff
+	{
+		ptrdiff_t liveBytes;
+		ptrdiff_t liveCount;
+		size_t allocBytes;
+		size_t allocCount;
+		size_t freeCount;
+	};
+
+	struct MemorySnapshot
+	{
+		std::array<MemoryTagStats, (size_t)MemoryTag::Count> tags;
+	};
+
+	struct MemorySnapshotDiff
+	{
+		std::array<MemoryTagDiff, (size_t)MemoryTag::Count> tags;
+	};
+
+	// Counters are per thread, so these are cheap enough to call for every allocation
+	UTIL_API void TrackMemoryAlloc(MemoryTag tag, size_t bytes);
+	UTIL_API void TrackMemoryFree(MemoryTag tag, size_t bytes);
+
+	UTIL_API const wchar_t* GetMemoryTagName(MemoryTag tag);
+	UTIL_API MemorySnapshot GetMemorySnapshot();
+	UTIL_API MemorySnapshotDiff DiffMemorySnapshots(const MemorySnapshot& before, const MemorySnapshot& after);
+
 	class AtScope
 	{
 	public:
@@ -2,6 +2,15 @@
 
 namespace ff
 {
+	struct MemoryPoolStats
+	{
+		const wchar_t* name;
+		MemoryTag tag;
+		size_t itemBytes;
+		size_t usedCount;
+		size_t allocatedCount;
+	};
+
 	struct IPoolAllocator
 	{
 		virtual ~IPoolAllocator() { }
@@ -12,8 +21,14 @@ namespace ff
 	{
 		virtual ~IBytePoolAllocator() override { }
 		virtual void* NewBytes() = 0;
+		virtual MemoryPoolStats GetStats() const = 0;
 	};
 
+	// Named pools register themselves so that their utilization shows up in GetMemoryPoolStats()
+	UTIL_API void RegisterMemoryPool(IBytePoolAllocator* pool);
+	UTIL_API void UnregisterMemoryPool(IBytePoolAllocator* pool);
+	UTIL_API Vector<MemoryPoolStats> GetMemoryPoolStats();
+
 	namespace details
 	{
 		template<size_t ByteSize, size_t ByteAlign>
@@ -58,24 +73,51 @@ namespace ff
 
 	public:
 		BytePoolAllocator()
-			: size(0)
+			: BytePoolAllocator(nullptr, MemoryTag::None)
+		{
+		}
+
+		BytePoolAllocator(const wchar_t* name, MemoryTag tag)
+			: name(name)
+			, tag(tag)
+			, size(0)
+			, allocated(0)
 		{
 			::InitializeSListHead(&this->freeList);
+
+			if (this->name)
+			{
+				ff::RegisterMemoryPool(this);
+			}
 		}
 
 		BytePoolAllocator(BytePoolAllocator&& rhs)
 			: pools(std::move(rhs.pools))
 			, freeList(rhs.freeList)
+			, name(rhs.name)
+			, tag(rhs.tag)
 			, size(rhs.size.load())
+			, allocated(rhs.allocated.load())
 		{
 			::InitializeSListHead(&rhs.freeList);
 			rhs.size = 0;
+			rhs.allocated = 0;
+
+			if (this->name)
+			{
+				ff::RegisterMemoryPool(this);
+			}
 		}
 
 		virtual ~BytePoolAllocator() override
 		{
 			assert(!this->size);
 			::InterlockedFlushSList(&this->freeList);
+
+			if (this->name)
+			{
+				ff::UnregisterMemoryPool(this);
+			}
 		}
 
 		// IBytePoolAllocator
@@ -92,11 +134,18 @@ namespace ff
 					PSLIST_ENTRY firstEntry, lastEntry;
 					this->pools.PushEmplace(lastSize * 2, firstEntry, lastEntry);
 
+					this->allocated.fetch_add(this->pools.GetLast().Size());
 					::InterlockedPushListSListEx(&this->freeList, firstEntry, lastEntry, (ULONG)this->pools.GetLast().Size());
 				}
 			}
 
 			this->size.fetch_add(1);
+
+			if (this->tag != MemoryTag::None)
+			{
+				ff::TrackMemoryAlloc(this->tag, ByteSize);
+			}
+
 			return freeEntry;
 		}
 
@@ -107,14 +156,25 @@ namespace ff
 				Pool::Node* node = (Pool::Node*)obj;
 				::InterlockedPushEntrySList(&this->freeList, &node->entry);
 				this->size.fetch_sub(1);
+
+				if (this->tag != MemoryTag::None)
+				{
+					ff::TrackMemoryFree(this->tag, ByteSize);
+				}
 			}
 		}
 
+		virtual MemoryPoolStats GetStats() const override
+		{
+			return MemoryPoolStats{ this->name, this->tag, ByteSize, this->size.load(), this->allocated.load() };
+		}
+
 		void Reduce()
 		{
 			noAssertRet(!this->size);
 			::InterlockedFlushSList(&this->freeList);
 			this->pools.ClearAndReduce();
+			this->allocated = 0;
 		}
 
 	private:
@@ -124,7 +184,10 @@ namespace ff
 		ff::Mutex mutex;
 		ff::Vector<Pool> pools;
 		SLIST_HEADER freeList;
+		const wchar_t* name;
+		MemoryTag tag;
 		std::atomic_size_t size;
+		std::atomic_size_t allocated;
 	};
 
 	template<size_t ByteSize, size_t ByteAlign>
@@ -134,23 +197,49 @@ namespace ff
 
 	public:
 		BytePoolAllocator()
+			: BytePoolAllocator(nullptr, MemoryTag::None)
+		{
+		}
+
+		BytePoolAllocator(const wchar_t* name, MemoryTag tag)
 			: firstFree(nullptr)
+			, name(name)
+			, tag(tag)
 			, size(0)
+			, allocated(0)
 		{
+			if (this->name)
+			{
+				ff::RegisterMemoryPool(this);
+			}
 		}
 
 		BytePoolAllocator(BytePoolAllocator&& rhs)
 			: pools(std::move(rhs.pools))
 			, firstFree(rhs.firstFree)
-			, size(rhs.size)
+			, name(rhs.name)
+			, tag(rhs.tag)
+			, size(rhs.size.load(std::memory_order_relaxed))
+			, allocated(rhs.allocated.load(std::memory_order_relaxed))
 		{
 			rhs.firstFree = nullptr;
-			rhs.size = 0;
+			rhs.size.store(0, std::memory_order_relaxed);
+			rhs.allocated.store(0, std::memory_order_relaxed);
+
+			if (this->name)
+			{
+				ff::RegisterMemoryPool(this);
+			}
 		}
 
 		virtual ~BytePoolAllocator() override
 		{
-			assert(!this->size);
+			assert(!this->size.load(std::memory_order_relaxed));
+
+			if (this->name)
+			{
+				ff::UnregisterMemoryPool(this);
+			}
 		}
 
 		// IBytePoolAllocator
@@ -161,11 +250,17 @@ namespace ff
 				size_t lastSize = !this->pools.IsEmpty() ? this->pools.GetLast().Size() : 0;
 				PSLIST_ENTRY lastEntry;
 				this->pools.PushEmplace(lastSize * 2, this->firstFree, lastEntry);
+				this->allocated.store(this->allocated.load(std::memory_order_relaxed) + this->pools.GetLast().Size(), std::memory_order_relaxed);
 			}
 
 			PSLIST_ENTRY freeEntry = this->firstFree;
 			this->firstFree = this->firstFree->Next;
-			this->size++;
+			this->size.store(this->size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+			if (this->tag != MemoryTag::None)
+			{
+				ff::TrackMemoryAlloc(this->tag, ByteSize);
+			}
 
 			return freeEntry;
 		}
@@ -177,15 +272,27 @@ namespace ff
 				Pool::Node* node = (Pool::Node*)obj;
 				node->entry.Next = this->firstFree;
 				this->firstFree = &node->entry;
-				this->size--;
+				this->size.store(this->size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+
+				if (this->tag != MemoryTag::None)
+				{
+					ff::TrackMemoryFree(this->tag, ByteSize);
+				}
 			}
 		}
 
+		// Can be called from any thread, the counts may be slightly out of date
+		virtual MemoryPoolStats GetStats() const override
+		{
+			return MemoryPoolStats{ this->name, this->tag, ByteSize, this->size.load(std::memory_order_relaxed), this->allocated.load(std::memory_order_relaxed) };
+		}
+
 		void Reduce()
 		{
-			noAssertRet(!this->size);
+			noAssertRet(!this->size.load(std::memory_order_relaxed));
 			this->firstFree = nullptr;
 			this->pools.ClearAndReduce();
+			this->allocated.store(0, std::memory_order_relaxed);
 		}
 
 	private:
@@ -194,7 +301,12 @@ namespace ff
 
 		ff::Vector<Pool> pools;
 		PSLIST_ENTRY firstFree;
-		size_t size;
+		const wchar_t* name;
+		MemoryTag tag;
+
+		// Only written by the thread that uses the pool, atomic so that GetMemoryPoolStats() can read them from any thread
+		std::atomic_size_t size;
+		std::atomic_size_t allocated;
 	};
 
 	template<typename T, bool ThreadSafe = true>
@@ -205,6 +317,11 @@ namespace ff
 		{
 		}
 
+		PoolAllocator(const wchar_t* name, MemoryTag tag)
+			: byteAllocator(name, tag)
+		{
+		}
+
 		PoolAllocator(PoolAllocator&& rhs)
 			: byteAllocator(std::move(rhs.byteAllocator))
 		{
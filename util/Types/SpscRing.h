@@ -0,0 +1,112 @@
+#pragma once
+
+namespace ff
+{
+	// Lock-free ring for exactly one producer thread and one consumer thread.
+	// The capacity is rounded up to a power of two. Nothing ever blocks, writes
+	// and reads move as many items as they can and return how many that was.
+	template<typename T>
+	class SpscRing
+	{
+	public:
+		SpscRing(size_t capacity)
+			: _capacity(ff::NearestPowerOfTwo(std::max<size_t>(capacity, 2)))
+			, _items(std::make_unique<T[]>(_capacity))
+			, _read(0)
+			, _write(0)
+		{
+		}
+
+		SpscRing(const SpscRing& rhs) = delete;
+		SpscRing& operator=(const SpscRing& rhs) = delete;
+
+		size_t GetCapacity() const
+		{
+			return _capacity;
+		}
+
+		// Safe on either thread, but only exact on the consumer thread
+		size_t GetReadCount() const
+		{
+			return _write.load(std::memory_order_acquire) - _read.load(std::memory_order_relaxed);
+		}
+
+		// Safe on either thread, but only exact on the producer thread
+		size_t GetWriteCount() const
+		{
+			return _capacity - (_write.load(std::memory_order_relaxed) - _read.load(std::memory_order_acquire));
+		}
+
+		bool IsEmpty() const
+		{
+			return !GetReadCount();
+		}
+
+		// Producer
+		bool Push(const T& item)
+		{
+			size_t write = _write.load(std::memory_order_relaxed);
+			noAssertRetVal(write - _read.load(std::memory_order_acquire) < _capacity, false);
+
+			_items[write & (_capacity - 1)] = item;
+			_write.store(write + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		// Producer
+		size_t Write(const T* items, size_t count)
+		{
+			size_t write = _write.load(std::memory_order_relaxed);
+			count = std::min(count, _capacity - (write - _read.load(std::memory_order_acquire)));
+
+			size_t start = write & (_capacity - 1);
+			size_t firstCount = std::min(count, _capacity - start);
+			std::copy(items, items + firstCount, _items.get() + start);
+			std::copy(items + firstCount, items + count, _items.get());
+
+			_write.store(write + count, std::memory_order_release);
+			return count;
+		}
+
+		// Consumer
+		bool Pop(T& item)
+		{
+			size_t read = _read.load(std::memory_order_relaxed);
+			noAssertRetVal(read != _write.load(std::memory_order_acquire), false);
+
+			item = std::move(_items[read & (_capacity - 1)]);
+			_read.store(read + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		// Consumer
+		size_t Read(T* items, size_t count)
+		{
+			size_t read = _read.load(std::memory_order_relaxed);
+			count = std::min(count, _write.load(std::memory_order_acquire) - read);
+
+			size_t start = read & (_capacity - 1);
+			size_t firstCount = std::min(count, _capacity - start);
+			std::copy(_items.get() + start, _items.get() + start + firstCount, items);
+			std::copy(_items.get(), _items.get() + count - firstCount, items + firstCount);
+
+			_read.store(read + count, std::memory_order_release);
+			return count;
+		}
+
+		// Only when neither thread is using the ring
+		void Clear()
+		{
+			_read = 0;
+			_write = 0;
+		}
+
+	private:
+		size_t _capacity;
+		std::unique_ptr<T[]> _items;
+		std::atomic<size_t> _read;
+		std::atomic<size_t> _write;
+	};
+}
@@ -11,15 +11,15 @@ ff::Map<DWORD, ff::Value::TypeEntry*, ff::NonHasher<DWORD>> ff::Value::s_idToEnt
 
 static ff::IBytePoolAllocator* GetValuePool(size_t typeSize)
 {
-	static ff::BytePoolAllocator<sizeof(size_t) * 2, alignof(size_t)> pool2;
-	static ff::BytePoolAllocator<sizeof(size_t) * 3, alignof(size_t)> pool3;
-	static ff::BytePoolAllocator<sizeof(size_t) * 4, alignof(size_t)> pool4;
-	static ff::BytePoolAllocator<sizeof(size_t) * 5, alignof(size_t)> pool5;
-	static ff::BytePoolAllocator<sizeof(size_t) * 6, alignof(size_t)> pool6;
-	static ff::BytePoolAllocator<sizeof(size_t) * 7, alignof(size_t)> pool7;
-	static ff::BytePoolAllocator<sizeof(size_t) * 8, alignof(size_t)> pool8;
-	static ff::BytePoolAllocator<sizeof(size_t) * 9, alignof(size_t)> pool9;
-	static ff::BytePoolAllocator<sizeof(size_t) * 10, alignof(size_t)> pool10;
+	static ff::BytePoolAllocator<sizeof(size_t) * 2, alignof(size_t)> pool2(L"Value 2 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 3, alignof(size_t)> pool3(L"Value 3 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 4, alignof(size_t)> pool4(L"Value 4 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 5, alignof(size_t)> pool5(L"Value 5 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 6, alignof(size_t)> pool6(L"Value 6 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 7, alignof(size_t)> pool7(L"Value 7 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 8, alignof(size_t)> pool8(L"Value 8 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 9, alignof(size_t)> pool9(L"Value 9 words", ff::MemoryTag::Value);
+	static ff::BytePoolAllocator<sizeof(size_t) * 10, alignof(size_t)> pool10(L"Value 10 words", ff::MemoryTag::Value);
 
 	if (typeSize <= sizeof(size_t) * 2) return &pool2;
 	if (typeSize <= sizeof(size_t) * 3) return &pool3;